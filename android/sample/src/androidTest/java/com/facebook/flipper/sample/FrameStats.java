@@ -0,0 +1,106 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+package com.facebook.flipper.sample;
+
+import android.os.Build;
+import android.os.Bundle;
+import android.os.Debug;
+import android.view.Choreographer;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+
+/**
+ * Frame times and allocations on the main thread while a benchmark runs. Frame times are the
+ * intervals between the vsync timestamps of consecutive frames, so a dropped frame shows up as an
+ * interval of two or more refresh periods.
+ */
+class FrameStats implements Choreographer.FrameCallback {
+
+  // 1.5 refresh periods at 60Hz.
+  private static final long JANK_NANOS = 25_000_000;
+
+  private final List<Long> mFrameNanos = new ArrayList<>();
+  private long mLastFrameTimeNanos;
+  private boolean mRunning;
+  private long mStartAllocatedBytes;
+  private long mAllocatedBytes;
+  private long mStartNanos;
+  private long mElapsedNanos;
+
+  /** Call on the main thread. */
+  void start() {
+    mFrameNanos.clear();
+    mLastFrameTimeNanos = 0;
+    mRunning = true;
+    mStartAllocatedBytes = allocatedBytes();
+    mStartNanos = System.nanoTime();
+    Choreographer.getInstance().postFrameCallback(this);
+  }
+
+  /** Call on the main thread. */
+  void stop() {
+    mRunning = false;
+    mElapsedNanos = System.nanoTime() - mStartNanos;
+    mAllocatedBytes = allocatedBytes() - mStartAllocatedBytes;
+    Choreographer.getInstance().removeFrameCallback(this);
+  }
+
+  @Override
+  public void doFrame(long frameTimeNanos) {
+    if (!mRunning) {
+      return;
+    }
+    if (mLastFrameTimeNanos != 0) {
+      mFrameNanos.add(frameTimeNanos - mLastFrameTimeNanos);
+    }
+    mLastFrameTimeNanos = frameTimeNanos;
+    Choreographer.getInstance().postFrameCallback(this);
+  }
+
+  int frames() {
+    return mFrameNanos.size();
+  }
+
+  /** Frame time percentiles in milliseconds, jank counts and allocation rate, by key. */
+  Bundle toBundle(String prefix) {
+    final List<Long> sorted = new ArrayList<>(mFrameNanos);
+    Collections.sort(sorted);
+    int janky = 0;
+    for (long nanos : sorted) {
+      if (nanos > JANK_NANOS) {
+        janky++;
+      }
+    }
+    final Bundle bundle = new Bundle();
+    bundle.putInt(prefix + "frames", sorted.size());
+    bundle.putInt(prefix + "jankyFrames", janky);
+    bundle.putDouble(prefix + "frameMsP50", percentileMs(sorted, 50));
+    bundle.putDouble(prefix + "frameMsP90", percentileMs(sorted, 90));
+    bundle.putDouble(prefix + "frameMsP99", percentileMs(sorted, 99));
+    bundle.putDouble(prefix + "frameMsMax", percentileMs(sorted, 100));
+    if (mAllocatedBytes >= 0) {
+      bundle.putDouble(
+          prefix + "allocatedKBPerSecond", mAllocatedBytes / 1024.0 / (mElapsedNanos / 1e9));
+    }
+    return bundle;
+  }
+
+  private static double percentileMs(List<Long> sorted, int percentile) {
+    if (sorted.isEmpty()) {
+      return 0;
+    }
+    final int index = (int) Math.ceil(sorted.size() * percentile / 100.0) - 1;
+    return sorted.get(Math.max(0, Math.min(sorted.size() - 1, index))) / 1e6;
+  }
+
+  /** Bytes allocated by the whole process so far, or -1 where it can't be told. */
+  @SuppressWarnings("deprecation")
+  private static long allocatedBytes() {
+    if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.M) {
+      final String bytes = Debug.getRuntimeStat("art.gc.bytes-allocated");
+      return bytes != null ? Long.parseLong(bytes) : -1;
+    }
+    return -1;
+  }
+}
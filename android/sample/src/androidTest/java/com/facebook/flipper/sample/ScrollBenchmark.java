@@ -0,0 +1,148 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+package com.facebook.flipper.sample;
+
+import android.app.Instrumentation;
+import android.content.Intent;
+import android.os.Bundle;
+import android.os.SystemClock;
+import android.support.test.InstrumentationRegistry;
+import android.support.test.runner.AndroidJUnit4;
+import android.support.v7.widget.RecyclerView;
+import android.util.Log;
+import com.facebook.sonar.android.AndroidSonarClient;
+import com.facebook.sonar.core.SonarClient;
+import com.facebook.sonar.core.SonarObject;
+import com.facebook.sonar.core.SonarPlugin;
+import com.facebook.sonar.testing.SonarConnectionMock;
+import com.facebook.sonar.testing.SonarResponderMock;
+import org.junit.After;
+import org.junit.Assert;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * What Flipper costs the sample app while a list is scrolled: frame time percentiles and
+ * allocation rate with Flipper stopped, with the client running but no plugin open, and with the
+ * inspector open and tracking the hierarchy. Results are reported as instrumentation status, e.g.
+ *
+ * <pre>
+ * ./gradlew :sample:connectedAndroidTest \
+ *   -Pandroid.testInstrumentationRunnerArguments.class=com.facebook.flipper.sample.ScrollBenchmark
+ * </pre>
+ *
+ * and in logcat under the ScrollBenchmark tag. Compare runs on the same device, with animations
+ * enabled and the screen on.
+ */
+@RunWith(AndroidJUnit4.class)
+public class ScrollBenchmark {
+
+  private static final String TAG = "ScrollBenchmark";
+  private static final long WARMUP_MS = 2_000;
+  private static final long MEASURE_MS = 10_000;
+  // Pixels per fling, alternating direction so the list never runs out.
+  private static final int FLING_VELOCITY = 8_000;
+  private static final long FLING_INTERVAL_MS = 500;
+
+  private Instrumentation mInstrumentation;
+  private ScrollBenchmarkActivity mActivity;
+  private SonarClient mClient;
+
+  @Before
+  public void setUp() {
+    mInstrumentation = InstrumentationRegistry.getInstrumentation();
+    mClient = AndroidSonarClient.getInstance(mInstrumentation.getTargetContext());
+    final Intent intent =
+        new Intent(mInstrumentation.getTargetContext(), ScrollBenchmarkActivity.class)
+            .addFlags(Intent.FLAG_ACTIVITY_NEW_TASK);
+    mActivity = (ScrollBenchmarkActivity) mInstrumentation.startActivitySync(intent);
+    mInstrumentation.waitForIdleSync();
+  }
+
+  @After
+  public void tearDown() {
+    mActivity.finish();
+    mClient.start();
+  }
+
+  @Test
+  public void flipperOff() {
+    mClient.stop();
+    measure("off.");
+  }
+
+  @Test
+  public void flipperIdle() {
+    mClient.start();
+    measure("idle.");
+  }
+
+  @Test
+  public void inspectorOpen() throws Exception {
+    mClient.start();
+    // Stands in for the desktop, which isn't there on a test device: the inspector is connected
+    // to a mock and asked for the hierarchy, after which it tracks changes as it would.
+    final SonarPlugin inspector = mClient.getPlugin("Inspector");
+    Assert.assertNotNull(inspector);
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    inspector.onConnect(connection);
+    try {
+      connection
+          .receivers
+          .get("getRoot")
+          .onReceive(new SonarObject.Builder().build(), new SonarResponderMock());
+      mInstrumentation.waitForIdleSync();
+      measure("inspector.");
+    } finally {
+      inspector.onDisconnect();
+    }
+  }
+
+  private void measure(String prefix) {
+    scroll(WARMUP_MS);
+    final FrameStats stats = new FrameStats();
+    mInstrumentation.runOnMainSync(
+        new Runnable() {
+          @Override
+          public void run() {
+            stats.start();
+          }
+        });
+    scroll(MEASURE_MS);
+    mInstrumentation.runOnMainSync(
+        new Runnable() {
+          @Override
+          public void run() {
+            stats.stop();
+          }
+        });
+    Assert.assertTrue("No frames were drawn", stats.frames() > 0);
+
+    final Bundle results = stats.toBundle(prefix);
+    for (String key : results.keySet()) {
+      Log.i(TAG, key + ": " + results.get(key));
+    }
+    mInstrumentation.sendStatus(0, results);
+  }
+
+  private void scroll(long durationMs) {
+    final RecyclerView list = mActivity.getRecyclerView();
+    final long end = SystemClock.uptimeMillis() + durationMs;
+    int direction = 1;
+    while (SystemClock.uptimeMillis() < end) {
+      final int velocity = FLING_VELOCITY * direction;
+      mInstrumentation.runOnMainSync(
+          new Runnable() {
+            @Override
+            public void run() {
+              list.fling(0, velocity);
+            }
+          });
+      SystemClock.sleep(FLING_INTERVAL_MS);
+      if (!list.canScrollVertically(direction)) {
+        direction = -direction;
+      }
+    }
+  }
+}
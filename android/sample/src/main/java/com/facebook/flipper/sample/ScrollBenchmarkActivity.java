@@ -0,0 +1,89 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+package com.facebook.flipper.sample;
+
+import android.app.Activity;
+import android.graphics.Color;
+import android.os.Bundle;
+import android.support.v7.widget.LinearLayoutManager;
+import android.support.v7.widget.RecyclerView;
+import android.view.View;
+import android.view.ViewGroup;
+import android.widget.LinearLayout;
+import android.widget.TextView;
+
+/**
+ * A long list of rows a few views deep, for ScrollBenchmark to scroll. Rows are rebound as they
+ * scroll into view, which is what the inspector has to keep up with.
+ */
+public class ScrollBenchmarkActivity extends Activity {
+
+  private static final int ROWS = 1000;
+  private static final int LINES_PER_ROW = 3;
+
+  private RecyclerView mRecyclerView;
+
+  @Override
+  protected void onCreate(Bundle savedInstanceState) {
+    super.onCreate(savedInstanceState);
+    mRecyclerView = new RecyclerView(this);
+    mRecyclerView.setLayoutManager(new LinearLayoutManager(this));
+    mRecyclerView.setAdapter(new RowAdapter());
+    setContentView(mRecyclerView);
+  }
+
+  public RecyclerView getRecyclerView() {
+    return mRecyclerView;
+  }
+
+  private static class RowHolder extends RecyclerView.ViewHolder {
+    final View badge;
+    final TextView[] lines = new TextView[LINES_PER_ROW];
+
+    RowHolder(LinearLayout row, View badge, LinearLayout text) {
+      super(row);
+      this.badge = badge;
+      for (int i = 0; i < LINES_PER_ROW; i++) {
+        lines[i] = (TextView) text.getChildAt(i);
+      }
+    }
+  }
+
+  private static class RowAdapter extends RecyclerView.Adapter<RowHolder> {
+
+    @Override
+    public RowHolder onCreateViewHolder(ViewGroup parent, int viewType) {
+      final LinearLayout row = new LinearLayout(parent.getContext());
+      row.setOrientation(LinearLayout.HORIZONTAL);
+      row.setPadding(16, 16, 16, 16);
+      row.setLayoutParams(
+          new RecyclerView.LayoutParams(
+              ViewGroup.LayoutParams.MATCH_PARENT, ViewGroup.LayoutParams.WRAP_CONTENT));
+
+      final View badge = new View(parent.getContext());
+      row.addView(badge, new LinearLayout.LayoutParams(96, 96));
+
+      final LinearLayout text = new LinearLayout(parent.getContext());
+      text.setOrientation(LinearLayout.VERTICAL);
+      text.setPadding(16, 0, 0, 0);
+      for (int i = 0; i < LINES_PER_ROW; i++) {
+        text.addView(new TextView(parent.getContext()));
+      }
+      row.addView(text);
+      return new RowHolder(row, badge, text);
+    }
+
+    @Override
+    public void onBindViewHolder(RowHolder holder, int position) {
+      holder.badge.setBackgroundColor(Color.HSVToColor(new float[] {position % 360, 0.5f, 0.9f}));
+      for (int i = 0; i < LINES_PER_ROW; i++) {
+        holder.lines[i].setText("Row " + position + ", line " + i);
+      }
+    }
+
+    @Override
+    public int getItemCount() {
+      return ROWS;
+    }
+  }
+}
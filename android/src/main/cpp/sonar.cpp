@@ -6,21 +6,38 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #ifdef SONAR_OSS
+#include <fbjni/ByteBuffer.h>
+#include <fbjni/ReadableByteChannel.h>
 #include <fbjni/fbjni.h>
 #else
 #include <fb/fbjni.h>
+#include <fb/fbjni/ByteBuffer.h>
+#include <fb/fbjni/ReadableByteChannel.h>
+#include <lyra/lyra.h>
 #endif
 
 #include <folly/json.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/io/async/EventBaseManager.h>
 
+#include <Sonar/SonarBase64.h>
 #include <Sonar/SonarClient.h>
 #include <Sonar/SonarWebSocket.h>
 #include <Sonar/SonarConnection.h>
+#include <Sonar/SonarEventBuffer.h>
+#include <Sonar/SonarNetworkReporter.h>
 #include <Sonar/SonarResponder.h>
 #include <Sonar/SonarStateUpdateListener.h>
 #include <Sonar/SonarState.h>
@@ -30,6 +47,201 @@ using namespace facebook::sonar;
 
 namespace {
 
+// Counts and times the bridge's calls into Java, so that JNI chatter on hot
+// paths shows up on the diagnostics screen.
+class JniCallStats {
+ public:
+  explicit JniCallStats(const char* name): name_(name) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().push_back(this);
+  }
+
+  void record(std::chrono::steady_clock::duration duration) {
+    calls_.fetch_add(1, std::memory_order_relaxed);
+    nanos_.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+        std::memory_order_relaxed);
+  }
+
+  // One line per call site, the most expensive first.
+  static std::string dump() {
+    std::vector<JniCallStats*> stats;
+    {
+      std::lock_guard<std::mutex> lock(registryMutex());
+      stats = registry();
+    }
+    std::sort(stats.begin(), stats.end(), [](JniCallStats* a, JniCallStats* b) {
+      return a->nanos_.load() > b->nanos_.load();
+    });
+    std::string result;
+    for (const auto stat : stats) {
+      const auto calls = stat->calls_.load();
+      const auto nanos = stat->nanos_.load();
+      char line[160];
+      snprintf(line, sizeof(line), "%s: %llu calls, %.3f ms, %.1f us each\n",
+          stat->name_,
+          static_cast<unsigned long long>(calls),
+          nanos / 1e6,
+          calls ? nanos / 1e3 / calls : 0.0);
+      result += line;
+    }
+    return result;
+  }
+
+ private:
+  static std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static std::vector<JniCallStats*>& registry() {
+    static std::vector<JniCallStats*> registry;
+    return registry;
+  }
+
+  const char* name_;
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> nanos_{0};
+};
+
+class JniCallTimer {
+ public:
+  explicit JniCallTimer(JniCallStats& stats)
+      : stats_(stats), start_(std::chrono::steady_clock::now()) {}
+
+  ~JniCallTimer() {
+    stats_.record(std::chrono::steady_clock::now() - start_);
+  }
+
+ private:
+  JniCallStats& stats_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Local references a call from a native thread into Java is expected to need.
+constexpr jint kLocalFrameCapacity = 16;
+
+// Java passes the same handful of method and plugin names on every call, and
+// converting each to UTF-8 allocates a new string. Short strings are looked
+// up by their UTF-16 contents instead, which JNI copies out without
+// converting or allocating, and the interned string is shared. The table is
+// replaced, never modified, so lookups don't lock. Strings past kMaxLength,
+// or once kCapacity / 2 are interned, are converted as usual.
+class JniStringInterner {
+ public:
+  static constexpr jsize kMaxLength = 64;
+  static constexpr size_t kCapacity = 1024;
+
+  static std::shared_ptr<const std::string> get(jni::alias_ref<jstring> string) {
+    if (!string) {
+      return std::make_shared<const std::string>();
+    }
+    auto env = jni::Environment::current();
+    const auto length = env->GetStringLength(string.get());
+    if (length > kMaxLength) {
+      return std::make_shared<const std::string>(string->toStdString());
+    }
+    jchar chars[kMaxLength];
+    env->GetStringRegion(string.get(), 0, length, chars);
+    const auto hash = hashOf(chars, length);
+    auto table = std::atomic_load(&instance().table_);
+    if (table) {
+      if (auto interned = find(*table, hash, chars, length)) {
+        return interned;
+      }
+    }
+    auto converted = std::make_shared<const std::string>(string->toStdString());
+    instance().insert(hash, chars, length, converted);
+    return converted;
+  }
+
+ private:
+  struct Entry {
+    size_t hash = 0;
+    std::u16string chars;
+    std::shared_ptr<const std::string> value;
+  };
+  // Open addressing, kCapacity slots.
+  using Table = std::vector<Entry>;
+
+  static JniStringInterner& instance() {
+    static JniStringInterner interner;
+    return interner;
+  }
+
+  static size_t hashOf(const jchar* chars, jsize length) {
+    size_t hash = 14695981039346656037ULL;
+    for (jsize i = 0; i < length; i++) {
+      hash = (hash ^ chars[i]) * 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  static std::shared_ptr<const std::string>
+  find(const Table& table, size_t hash, const jchar* chars, jsize length) {
+    for (size_t i = hash % kCapacity;; i = (i + 1) % kCapacity) {
+      const auto& entry = table[i];
+      if (!entry.value) {
+        return nullptr;
+      }
+      if (entry.hash == hash && entry.chars.size() == size_t(length) &&
+          std::equal(chars, chars + length, entry.chars.begin())) {
+        return entry.value;
+      }
+    }
+  }
+
+  void insert(
+      size_t hash,
+      const jchar* chars,
+      jsize length,
+      std::shared_ptr<const std::string> value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Kept at most half full, so probes stay short.
+    if (size_ >= kCapacity / 2) {
+      return;
+    }
+    auto table = table_ ? std::make_shared<Table>(*table_)
+                        : std::make_shared<Table>(kCapacity);
+    if (find(*table, hash, chars, length)) {
+      return;
+    }
+    size_t i = hash % kCapacity;
+    while ((*table)[i].value) {
+      i = (i + 1) % kCapacity;
+    }
+    (*table)[i] = {hash, std::u16string(chars, chars + length), std::move(value)};
+    size_++;
+    std::atomic_store(&table_, std::shared_ptr<const Table>(std::move(table)));
+  }
+
+  std::mutex mutex_;
+  size_t size_ = 0;
+  std::shared_ptr<const Table> table_;
+};
+
+constexpr jsize JniStringInterner::kMaxLength;
+constexpr size_t JniStringInterner::kCapacity;
+
+// Records the rest of the enclosing scope as a call of the given name.
+#define SONAR_JNI_CALL(name) \
+  static JniCallStats jniCallStats{name}; \
+  JniCallTimer jniCallTimer{jniCallStats}
+
+// Frames of the watchdog's stack captures. Reserved up front, lyra only
+// fills what is reserved, so that unwinding in the signal handler doesn't
+// allocate.
+std::vector<facebook::lyra::InstructionPointer> gWatchdogFrames;
+
+size_t unwindWithLyra(uintptr_t* frames, size_t max) {
+  facebook::lyra::getStackTrace(gWatchdogFrames);
+  const auto count = std::min(gWatchdogFrames.size(), max);
+  for (size_t i = 0; i < count; i++) {
+    frames[i] = reinterpret_cast<uintptr_t>(gWatchdogFrames[i]);
+  }
+  return count;
+}
+
 class JEventBase : public jni::HybridClass<JEventBase> {
  public:
   constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/EventBase;";
@@ -62,17 +274,301 @@ class JEventBase : public jni::HybridClass<JEventBase> {
   folly::EventBase eventBase_;
 };
 
+// Plugin receivers call into Java, so the threads they run on stay attached
+// to the JVM (with the app's class loader) for their whole lifetime.
+class JniThreadFactory : public folly::ThreadFactory {
+ public:
+  std::thread newThread(folly::Func&& func) override {
+    return namedThreadFactory_.newThread([func = std::move(func)]() mutable {
+      jni::ThreadScope::WithClassLoader([&func]() { func(); });
+    });
+  }
+
+ private:
+  folly::NamedThreadFactory namedThreadFactory_{"SonarPlugin"};
+};
+
+// The classes and members the bridge uses are looked up once, each class's in
+// its Lookups, and all of them are resolved in JNI_OnLoad (see
+// prewarmLookups). Otherwise the first call of each would pay for the lookup
+// on whichever thread made it, often the UI thread, and a missing member would
+// only show up when first used.
+
+// Payloads are converted directly between folly::dynamic and the org.json
+// objects SonarObject and SonarArray wrap, rather than serialized to a JSON
+// string that the other side then has to parse.
+class JJSONArray : public jni::JavaClass<JJSONArray> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lorg/json/JSONArray;";
+
+  struct Lookups {
+    jni::JConstructor<javaobject()> constructor =
+        javaClassStatic()->getConstructor<javaobject()>();
+    jni::JMethod<javaobject(jni::alias_ref<jobject>)> put =
+        javaClassStatic()->getMethod<javaobject(jni::alias_ref<jobject>)>("put");
+    jni::JMethod<jobject(jint)> get = javaClassStatic()->getMethod<jobject(jint)>("get");
+    jni::JMethod<jint()> length = javaClassStatic()->getMethod<jint()>("length");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  static jni::local_ref<javaobject> create() {
+    return javaClassStatic()->newObject(lookups().constructor);
+  }
+
+  void put(jni::alias_ref<jobject> value) {
+    lookups().put(self(), value);
+  }
+
+  jni::local_ref<jobject> get(jint index) const {
+    return lookups().get(self(), index);
+  }
+
+  jint length() const {
+    return lookups().length(self());
+  }
+};
+
+class JJSONObject : public jni::JavaClass<JJSONObject> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lorg/json/JSONObject;";
+
+  struct Lookups {
+    jni::JConstructor<javaobject()> constructor =
+        javaClassStatic()->getConstructor<javaobject()>();
+    // JSONObject.NULL, which stands in for null values.
+    jni::global_ref<jobject> null = jni::make_global(javaClassStatic()->getStaticFieldValue(
+        javaClassStatic()->getStaticField<jobject>("NULL")));
+    jni::JMethod<javaobject(std::string, jni::alias_ref<jobject>)> put =
+        javaClassStatic()->getMethod<javaobject(std::string, jni::alias_ref<jobject>)>("put");
+    jni::JMethod<jobject(std::string)> get =
+        javaClassStatic()->getMethod<jobject(std::string)>("get");
+    jni::JMethod<JJSONArray::javaobject()> names =
+        javaClassStatic()->getMethod<JJSONArray::javaobject()>("names");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  static jni::local_ref<javaobject> create() {
+    return javaClassStatic()->newObject(lookups().constructor);
+  }
+
+  static jni::alias_ref<jobject> null() {
+    return lookups().null;
+  }
+
+  void put(const std::string& name, jni::alias_ref<jobject> value) {
+    lookups().put(self(), name, value);
+  }
+
+  jni::local_ref<jobject> get(const std::string& name) const {
+    return lookups().get(self(), name);
+  }
+
+  // null if the object is empty.
+  jni::local_ref<JJSONArray::javaobject> names() const {
+    return lookups().names(self());
+  }
+};
+
+class JNumber : public jni::JavaClass<JNumber> {
+ public:
+  constexpr static auto kJavaDescriptor = "Ljava/lang/Number;";
+
+  struct Lookups {
+    jni::JMethod<jlong()> longValue = javaClassStatic()->getMethod<jlong()>("longValue");
+    jni::JMethod<jdouble()> doubleValue =
+        javaClassStatic()->getMethod<jdouble()>("doubleValue");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  jlong longValue() const {
+    return lookups().longValue(self());
+  }
+
+  jdouble doubleValue() const {
+    return lookups().doubleValue(self());
+  }
+};
+
+jni::local_ref<jobject> toJava(const folly::dynamic& value);
+
+jni::local_ref<JJSONObject::javaobject> toJSONObject(const folly::dynamic& object) {
+  auto result = JJSONObject::create();
+  for (const auto& item : object.items()) {
+    result->put(item.first.asString(), toJava(item.second));
+  }
+  return result;
+}
+
+jni::local_ref<JJSONArray::javaobject> toJSONArray(const folly::dynamic& array) {
+  auto result = JJSONArray::create();
+  for (const auto& item : array) {
+    result->put(toJava(item));
+  }
+  return result;
+}
+
+jni::local_ref<jobject> toJava(const folly::dynamic& value) {
+  switch (value.type()) {
+    case folly::dynamic::NULLT:
+      return jni::make_local(JJSONObject::null());
+    case folly::dynamic::BOOL:
+      return jni::autobox(static_cast<jboolean>(value.getBool()));
+    case folly::dynamic::INT64:
+      return jni::autobox(static_cast<jlong>(value.getInt()));
+    case folly::dynamic::DOUBLE:
+      return jni::autobox(static_cast<jdouble>(value.getDouble()));
+    case folly::dynamic::STRING:
+      return jni::make_jstring(value.getString());
+    case folly::dynamic::ARRAY:
+      return toJSONArray(value);
+    case folly::dynamic::OBJECT:
+      return toJSONObject(value);
+  }
+  throw std::invalid_argument("Unknown folly::dynamic type");
+}
+
+folly::dynamic fromJava(jni::alias_ref<jobject> value);
+
+folly::dynamic fromJSONObject(jni::alias_ref<JJSONObject::javaobject> object) {
+  auto result = folly::dynamic::object();
+  const auto names = object->names();
+  const auto length = names ? names->length() : 0;
+  for (jint i = 0; i < length; i++) {
+    const auto name = jni::static_ref_cast<jstring>(names->get(i))->toStdString();
+    result[name] = fromJava(object->get(name));
+  }
+  return result;
+}
+
+folly::dynamic fromJSONArray(jni::alias_ref<JJSONArray::javaobject> array) {
+  auto result = folly::dynamic::array();
+  const auto length = array->length();
+  for (jint i = 0; i < length; i++) {
+    result.push_back(fromJava(array->get(i)));
+  }
+  return result;
+}
+
+folly::dynamic fromJava(jni::alias_ref<jobject> value) {
+  if (!value || jni::isSameObject(value, JJSONObject::null())) {
+    return nullptr;
+  }
+  if (value->isInstanceOf(jni::JString::javaClassStatic())) {
+    return jni::static_ref_cast<jstring>(value)->toStdString();
+  }
+  if (value->isInstanceOf(jni::JBoolean::javaClassStatic())) {
+    return static_cast<bool>(jni::static_ref_cast<jni::JBoolean::javaobject>(value)->value());
+  }
+  if (value->isInstanceOf(jni::JDouble::javaClassStatic()) ||
+      value->isInstanceOf(jni::JFloat::javaClassStatic())) {
+    return jni::static_ref_cast<JNumber::javaobject>(value)->doubleValue();
+  }
+  if (value->isInstanceOf(JNumber::javaClassStatic())) {
+    return static_cast<int64_t>(jni::static_ref_cast<JNumber::javaobject>(value)->longValue());
+  }
+  if (value->isInstanceOf(JJSONObject::javaClassStatic())) {
+    return fromJSONObject(jni::static_ref_cast<JJSONObject::javaobject>(value));
+  }
+  if (value->isInstanceOf(JJSONArray::javaClassStatic())) {
+    return fromJSONArray(jni::static_ref_cast<JJSONArray::javaobject>(value));
+  }
+  // Anything else is serialized the way JSONObject.toString() would.
+  return value->toString();
+}
+
+class JSonarObjectSource : public jni::JavaClass<JSonarObjectSource> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarObject$Source;";
+};
+
+// Keeps a call's params native. Java converts fields one at a time as they
+// are read, so large params don't have to become a whole Java object graph.
+class JSonarObjectSourceImpl : public jni::HybridClass<JSonarObjectSourceImpl, JSonarObjectSource> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/SonarObjectSourceImpl;";
+
+  static void registerNatives() {
+    registerHybrid({
+      makeNativeMethod("get", JSonarObjectSourceImpl::get),
+      makeNativeMethod("materialize", JSonarObjectSourceImpl::materialize),
+    });
+  }
+
+  jni::local_ref<jobject> get(const std::string name) {
+    SONAR_JNI_CALL("SonarObjectSourceImpl.get");
+    const auto value = params_.isObject() ? params_.get_ptr(name) : nullptr;
+    return value ? toJava(*value) : nullptr;
+  }
+
+  jni::local_ref<JJSONObject::javaobject> materialize() {
+    SONAR_JNI_CALL("SonarObjectSourceImpl.materialize");
+    return toJSONObject(params_.isObject() ? params_ : folly::dynamic::object());
+  }
+
+  const folly::dynamic& params() const {
+    return params_;
+  }
+
+ private:
+  friend HybridBase;
+  folly::dynamic params_;
+
+  JSonarObjectSourceImpl(folly::dynamic params): params_(std::move(params)) {}
+};
+
 class JSonarObject : public jni::JavaClass<JSonarObject> {
  public:
   constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarObject;";
 
+  struct Lookups {
+    jni::JConstructor<javaobject(JJSONObject::javaobject)> constructor =
+        javaClassStatic()->getConstructor<javaobject(JJSONObject::javaobject)>();
+    jni::JConstructor<javaobject(JSonarObjectSource::javaobject)> sourceConstructor =
+        javaClassStatic()->getConstructor<javaobject(JSonarObjectSource::javaobject)>();
+    jni::JField<JSonarObjectSource::javaobject> source =
+        javaClassStatic()->getField<JSonarObjectSource::javaobject>("mSource");
+    jni::JMethod<JJSONObject::javaobject()> json =
+        javaClassStatic()->getMethod<JJSONObject::javaobject()>("json");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
   static jni::local_ref<JSonarObject> create(const folly::dynamic& json) {
-    return newInstance(folly::toJson(json));
+    SONAR_JNI_CALL("SonarObject.<init>");
+    return javaClassStatic()->newObject(lookups().constructor, toJSONObject(json).get());
   }
 
-  std::string toJsonString() {
-    static const auto method = javaClassStatic()->getMethod<std::string()>("toJsonString");
-    return method(self())->toStdString();
+  static jni::local_ref<JSonarObject> createLazy(folly::dynamic json) {
+    SONAR_JNI_CALL("SonarObject.<init>(Source)");
+    auto source = JSonarObjectSourceImpl::newObjectCxxArgs(std::move(json));
+    return javaClassStatic()->newObject(
+        lookups().sourceConstructor,
+        static_cast<JSonarObjectSource::javaobject>(source.get()));
+  }
+
+  folly::dynamic toDynamic() const {
+    SONAR_JNI_CALL("SonarObject to dynamic");
+    // Objects still backed by a call's params go back as they came.
+    const auto source = getFieldValue(lookups().source);
+    if (source && source->isInstanceOf(JSonarObjectSourceImpl::javaClassStatic())) {
+      return jni::static_ref_cast<JSonarObjectSourceImpl::javaobject>(source)->cthis()->params();
+    }
+    return fromJSONObject(lookups().json(self()));
   }
 };
 
@@ -80,13 +576,26 @@ class JSonarArray : public jni::JavaClass<JSonarArray> {
  public:
   constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarArray;";
 
+  struct Lookups {
+    jni::JConstructor<javaobject(JJSONArray::javaobject)> constructor =
+        javaClassStatic()->getConstructor<javaobject(JJSONArray::javaobject)>();
+    jni::JField<JJSONArray::javaobject> json =
+        javaClassStatic()->getField<JJSONArray::javaobject>("mJson");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
   static jni::local_ref<JSonarArray> create(const folly::dynamic& json) {
-    return newInstance(folly::toJson(json));
+    SONAR_JNI_CALL("SonarArray.<init>");
+    return javaClassStatic()->newObject(lookups().constructor, toJSONArray(json).get());
   }
 
-  std::string toJsonString() {
-    static const auto method = javaClassStatic()->getMethod<std::string()>("toJsonString");
-    return method(self())->toStdString();
+  folly::dynamic toDynamic() const {
+    SONAR_JNI_CALL("SonarArray to dynamic");
+    return fromJSONArray(getFieldValue(lookups().json));
   }
 };
 
@@ -95,44 +604,187 @@ class JSonarResponder : public jni::JavaClass<JSonarResponder> {
   constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarResponder;";
 };
 
-class JSonarResponderImpl : public jni::HybridClass<JSonarResponderImpl, JSonarResponder> {
+/**
+ * Native half of a responder. Peers are pooled and reused across calls, each
+ * use is a new generation. Java gets a SonarResponderImpl that only records
+ * the peer and the generation it was handed out for; the first response
+ * completes that generation and returns the peer to the pool, so any later
+ * call through the same SonarResponderImpl is ignored. A peer the pool has no
+ * room for is freed by Java right after it responds, rather than whenever
+ * the GC gets to it. One whose call is never answered is freed along with its
+ * Java object, like any hybrid.
+ */
+class JSonarResponderPeer : public jni::HybridClass<JSonarResponderPeer> {
  public:
-  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/SonarResponderImpl;";
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/SonarResponderImpl$Peer;";
 
   static void registerNatives() {
     registerHybrid({
-      makeNativeMethod("successObject", JSonarResponderImpl::successObject),
-      makeNativeMethod("successArray", JSonarResponderImpl::successArray),
-      makeNativeMethod("error", JSonarResponderImpl::error),
+      makeNativeMethod("successObject", JSonarResponderPeer::successObject),
+      makeNativeMethod("successArray", JSonarResponderPeer::successArray),
+      makeNativeMethod("errorObject", JSonarResponderPeer::error),
     });
   }
 
-  void successObject(jni::alias_ref<JSonarObject> json) {
-    _responder->success(json ? folly::parseJson(json->toJsonString()) : folly::dynamic::object());
+  // Takes an idle peer, or makes a new one, and lends it out for responder.
+  static jni::local_ref<jhybridobject> obtain(std::shared_ptr<SonarResponder> responder, jint* generation) {
+    jni::local_ref<jhybridobject> peer;
+    {
+      std::lock_guard<std::mutex> lock(pool().mutex);
+      if (!pool().idle.empty()) {
+        peer = jni::make_local(pool().idle.back());
+        pool().idle.pop_back();
+      }
+    }
+    if (!peer) {
+      peer = newObjectCxxArgs();
+    }
+    auto cxx = peer->cthis();
+    std::lock_guard<std::mutex> lock(cxx->mutex_);
+    cxx->responder_ = std::move(responder);
+    *generation = cxx->generation_;
+    return peer;
+  }
+
+  static jboolean successObject(jni::alias_ref<jhybridobject> self, jint generation, jni::alias_ref<JSonarObject> json) {
+    auto response = json ? json->toDynamic() : folly::dynamic::object();
+    bool release = false;
+    if (auto responder = complete(self, generation, &release)) {
+      responder->success(response);
+    }
+    return release;
   }
 
-  void successArray(jni::alias_ref<JSonarArray> json) {
-    _responder->success(json ? folly::parseJson(json->toJsonString()) : folly::dynamic::object());
+  static jboolean successArray(jni::alias_ref<jhybridobject> self, jint generation, jni::alias_ref<JSonarArray> json) {
+    auto response = json ? json->toDynamic() : folly::dynamic::object();
+    bool release = false;
+    if (auto responder = complete(self, generation, &release)) {
+      responder->success(response);
+    }
+    return release;
   }
 
-  void error(jni::alias_ref<JSonarObject> json) {
-    _responder->error(json ? folly::parseJson(json->toJsonString()) : folly::dynamic::object());
+  static jboolean error(jni::alias_ref<jhybridobject> self, jint generation, jni::alias_ref<JSonarObject> json) {
+    auto response = json ? json->toDynamic() : folly::dynamic::object();
+    bool release = false;
+    if (auto responder = complete(self, generation, &release)) {
+      responder->error(response);
+    }
+    return release;
   }
 
  private:
   friend HybridBase;
-  std::shared_ptr<SonarResponder> _responder;
 
-  JSonarResponderImpl(std::shared_ptr<SonarResponder> responder): _responder(std::move(responder)) {}
+  // Idle peers kept for reuse, enough for the calls usually in flight.
+  static constexpr size_t kMaxIdlePeers = 32;
+
+  struct Pool {
+    std::mutex mutex;
+    std::vector<jni::global_ref<jhybridobject>> idle;
+  };
+
+  static Pool& pool() {
+    // Never destroyed, global references can't be released at exit.
+    static Pool* pool = new Pool();
+    return *pool;
+  }
+
+  // Returns the responder if generation is still current, null if the peer
+  // already responded for it. release is set if the pool had no room for
+  // the peer, which can then be freed.
+  static std::shared_ptr<SonarResponder> complete(jni::alias_ref<jhybridobject> self, jint generation, bool* release) {
+    auto cxx = self->cthis();
+    std::shared_ptr<SonarResponder> responder;
+    {
+      std::lock_guard<std::mutex> lock(cxx->mutex_);
+      if (generation != cxx->generation_ || !cxx->responder_) {
+        return nullptr;
+      }
+      responder = std::move(cxx->responder_);
+      cxx->responder_ = nullptr;
+      ++cxx->generation_;
+    }
+    std::lock_guard<std::mutex> lock(pool().mutex);
+    if (pool().idle.size() < kMaxIdlePeers) {
+      pool().idle.push_back(jni::make_global(self));
+    } else {
+      *release = true;
+    }
+    return responder;
+  }
+
+  JSonarResponderPeer() {}
+
+  std::mutex mutex_;
+  std::shared_ptr<SonarResponder> responder_;
+  jint generation_ = 0;
+};
+
+class JSonarResponderImpl : public jni::JavaClass<JSonarResponderImpl, JSonarResponder> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/SonarResponderImpl;";
+
+  struct Lookups {
+    jni::JConstructor<javaobject(JSonarResponderPeer::jhybridobject, jint)> constructor =
+        javaClassStatic()->getConstructor<javaobject(JSonarResponderPeer::jhybridobject, jint)>();
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  static jni::local_ref<javaobject> create(std::shared_ptr<SonarResponder> responder) {
+    jint generation;
+    auto peer = JSonarResponderPeer::obtain(std::move(responder), &generation);
+    return javaClassStatic()->newObject(lookups().constructor, peer.get(), generation);
+  }
 };
 
 class JSonarReceiver : public jni::JavaClass<JSonarReceiver> {
  public:
   constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarReceiver;";
 
-  void receive(const folly::dynamic params, std::shared_ptr<SonarResponder> responder) const {
-    static const auto method = javaClassStatic()->getMethod<void(jni::alias_ref<JSonarObject::javaobject>, jni::alias_ref<JSonarResponder::javaobject>)>("onReceive");
-    method(self(), JSonarObject::create(std::move(params)), JSonarResponderImpl::newObjectCxxArgs(responder));
+  struct Lookups {
+    jni::JMethod<void(jni::alias_ref<JSonarObject::javaobject>, jni::alias_ref<JSonarResponder::javaobject>)> onReceive =
+        javaClassStatic()->getMethod<void(jni::alias_ref<JSonarObject::javaobject>, jni::alias_ref<JSonarResponder::javaobject>)>("onReceive");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  void receive(const folly::dynamic& params, std::shared_ptr<SonarResponder> responder) const {
+    SONAR_JNI_CALL("SonarReceiver.onReceive");
+    // Receivers run on threads that stay attached for good, where local
+    // references only go away with a frame of their own.
+    jni::JniLocalScope scope(kLocalFrameCapacity);
+    lookups().onReceive(self(), JSonarObject::createLazy(params), JSonarResponderImpl::create(std::move(responder)));
+  }
+};
+
+class JSonarParamsBuilder : public jni::JavaClass<JSonarParamsBuilder> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarParamsBuilder;";
+
+  struct Lookups {
+    jni::JMethod<JSonarObject::javaobject()> build =
+        javaClassStatic()->getMethod<JSonarObject::javaobject()>("build");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  folly::dynamic build() const {
+    SONAR_JNI_CALL("SonarParamsBuilder.build");
+    // Builders run on the plugin's threads, which stay attached for good.
+    jni::JniLocalScope scope(kLocalFrameCapacity);
+    auto params = lookups().build(self());
+    return params ? params->toDynamic() : folly::dynamic::object();
   }
 };
 
@@ -149,76 +801,461 @@ class JSonarConnectionImpl : public jni::HybridClass<JSonarConnectionImpl, JSona
     registerHybrid({
       makeNativeMethod("sendObject", JSonarConnectionImpl::sendObject),
       makeNativeMethod("sendArray", JSonarConnectionImpl::sendArray),
+      makeNativeMethod("sendDirectBytes", JSonarConnectionImpl::sendDirectBytes),
       makeNativeMethod("reportError", JSonarConnectionImpl::reportError),
       makeNativeMethod("receive", JSonarConnectionImpl::receive),
+      makeNativeMethod("setSendLimit", JSonarConnectionImpl::setSendLimit),
+      makeNativeMethod("isSubscribed", JSonarConnectionImpl::isSubscribed),
+      makeNativeMethod("sendLazy", JSonarConnectionImpl::sendLazy),
     });
   }
 
-  void sendObject(const std::string method, jni::alias_ref<JSonarObject> json) {
-    _connection->send(std::move(method), json ? folly::parseJson(json->toJsonString()) : folly::dynamic::object());
+  // Dropped events are never converted from Java.
+  void sendObject(jni::alias_ref<jstring> name, jni::alias_ref<JSonarObject> json) {
+    const auto connection = this->connection();
+    const auto method = JniStringInterner::get(name);
+    if (connection && connection->admit(*method)) {
+      connection->sendAdmitted(*method, json ? json->toDynamic() : folly::dynamic::object());
+    }
+  }
+
+  void sendArray(jni::alias_ref<jstring> name, jni::alias_ref<JSonarArray> json) {
+    const auto connection = this->connection();
+    const auto method = JniStringInterner::get(name);
+    if (connection && connection->admit(*method)) {
+      connection->sendAdmitted(*method, json ? json->toDynamic() : folly::dynamic::object());
+    }
+  }
+
+  void sendDirectBytes(jni::alias_ref<jstring> name, jni::alias_ref<jni::JByteBuffer> bytes, jint offset, jint length) {
+    const auto connection = this->connection();
+    if (!connection) {
+      return;
+    }
+    // The frame refers to the buffer's memory directly, so the buffer is kept
+    // alive until the frame has been sent.
+    auto buffer = new jni::global_ref<jni::JByteBuffer>(jni::make_global(bytes));
+    auto data = folly::IOBuf::takeOwnership(
+        bytes->getDirectBytes() + offset,
+        length,
+        [](void*, void* userData) {
+          // Frames are released on the connection thread.
+          jni::ThreadScope scope;
+          delete static_cast<jni::global_ref<jni::JByteBuffer>*>(userData);
+        },
+        buffer);
+    connection->sendRaw(*JniStringInterner::get(name), std::move(data));
+  }
+
+  // Null once closed.
+  std::shared_ptr<SonarConnection> connection() const {
+    return std::atomic_load(&_connection);
+  }
+
+  // Called once the plugin is disconnected. Plugins may hold on to their
+  // connection for a while, this lets go of the native one, and with it the
+  // socket, right away rather than once the GC frees the Java object. Later
+  // calls do nothing.
+  void close() {
+    std::atomic_store(&_connection, std::shared_ptr<SonarConnection>());
+  }
+
+  void setSendLimit(const std::string method, jdouble maxPerSecond, jdouble sampleRate) {
+    const auto connection = this->connection();
+    if (!connection) {
+      return;
+    }
+    SonarSendLimit limit;
+    limit.maxPerSecond = maxPerSecond;
+    limit.sampleRate = sampleRate;
+    connection->setSendLimit(method, limit);
+  }
+
+  jboolean isSubscribed(jni::alias_ref<jstring> method) {
+    const auto connection = this->connection();
+    return connection && connection->isSubscribed(*JniStringInterner::get(method));
   }
 
-  void sendArray(const std::string method, jni::alias_ref<JSonarArray> json) {
-    _connection->send(std::move(method), json ? folly::parseJson(json->toJsonString()) : folly::dynamic::object());
+  void sendLazy(jni::alias_ref<jstring> method, jni::alias_ref<JSonarParamsBuilder> builder) {
+    const auto connection = this->connection();
+    if (!connection) {
+      return;
+    }
+    auto global = make_global(builder);
+    connection->sendLazy(*JniStringInterner::get(method), [global]() { return global->build(); });
   }
 
   void reportError(jni::alias_ref<jni::JThrowable> throwable) {
-    _connection->error(throwable->toString(), throwable->getStackTrace()->toString());
+    if (const auto connection = this->connection()) {
+      connection->error(throwable->toString(), throwable->getStackTrace()->toString());
+    }
   }
 
-  void receive(const std::string method, jni::alias_ref<JSonarReceiver> receiver) {
+  void receive(jni::alias_ref<jstring> method, jni::alias_ref<JSonarReceiver> receiver) {
+    const auto connection = this->connection();
+    if (!connection) {
+      return;
+    }
     auto global = make_global(receiver);
-    _connection->receive(std::move(method), [global] (const folly::dynamic& params, std::unique_ptr<SonarResponder> responder) {
+    // Params are parsed natively and only converted to Java as the receiver
+    // reads them.
+    connection->receive(*JniStringInterner::get(method), [global] (const folly::dynamic& params, std::unique_ptr<SonarResponder> responder) {
       global->receive(params, std::move(responder));
     });
   }
 
  private:
   friend HybridBase;
+  // Accessed atomically, see close.
   std::shared_ptr<SonarConnection> _connection;
 
   JSonarConnectionImpl(std::shared_ptr<SonarConnection> connection): _connection(std::move(connection)) {}
 };
 
-class JSonarPlugin : public jni::JavaClass<JSonarPlugin> {
+class JSonarEventBuffer : public jni::HybridClass<JSonarEventBuffer> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/SonarEventBuffer;";
+
+  static void registerNatives() {
+    registerHybrid({
+        makeNativeMethod("initHybrid", JSonarEventBuffer::initHybrid),
+        makeNativeMethod("append", JSonarEventBuffer::append),
+        makeNativeMethod("drainTo", JSonarEventBuffer::drainTo),
+        makeNativeMethod("takeAll", JSonarEventBuffer::takeAll),
+    });
+  }
+
+ private:
+  friend HybridBase;
+
+  explicit JSonarEventBuffer(jint maxBytes): buffer_(maxBytes) {}
+
+  static void initHybrid(jni::alias_ref<jhybridobject> o, jint maxBytes) {
+    return setCxxInstance(o, maxBytes);
+  }
+
+  void append(jni::alias_ref<jstring> method, jni::alias_ref<JSonarObject> params) {
+    SONAR_JNI_CALL("SonarEventBuffer.append");
+    auto json = folly::toJson(params ? params->toDynamic() : folly::dynamic::object());
+    buffer_.append(*JniStringInterner::get(method), folly::IOBuf::copyBuffer(json));
+  }
+
+  // Events go straight from the buffer to the socket.
+  void drainTo(jni::alias_ref<JSonarConnectionImpl::javaobject> connection) {
+    if (auto native = connection->cthis()->connection()) {
+      buffer_.drainTo(*native);
+    }
+  }
+
+  // For connections not backed by native code: methods and params alternate.
+  jni::local_ref<jni::JArrayClass<jstring>> takeAll() {
+    auto events = buffer_.takeAll();
+    auto result = jni::JArrayClass<jstring>::newArray(events.size() * 2);
+    for (size_t i = 0; i < events.size(); i++) {
+      result->setElement(2 * i, jni::make_jstring(events[i].method).get());
+      result->setElement(2 * i + 1, jni::make_jstring(events[i].params->moveToFbString().toStdString()).get());
+    }
+    return result;
+  }
+
+  SonarEventBuffer buffer_;
+};
+
+// Network bodies are streamed into native memory and encoded there, so that
+// capturing a large download doesn't keep a second copy of it on the Java
+// heap. Only the first maxBytes are kept.
+class JNetworkBodyCapture : public jni::HybridClass<JNetworkBodyCapture> {
  public:
-  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/SonarPlugin;";
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/plugins/network/NetworkBodyCapture;";
+
+  static void registerNatives() {
+    registerHybrid({
+        makeNativeMethod("initHybrid", JNetworkBodyCapture::initHybrid),
+        makeNativeMethod("readFrom", JNetworkBodyCapture::readFrom),
+        makeNativeMethod("isTruncated", JNetworkBodyCapture::isTruncated),
+        makeNativeMethod("totalBytes", JNetworkBodyCapture::totalBytes),
+        makeNativeMethod("toBase64", JNetworkBodyCapture::base64),
+        makeNativeMethod("toByteArray", JNetworkBodyCapture::toByteArray),
+    });
+  }
+
+ private:
+  friend HybridBase;
+
+  explicit JNetworkBodyCapture(jint maxBytes): maxBytes_(maxBytes) {}
+
+  static void initHybrid(jni::alias_ref<jhybridobject> o, jint maxBytes) {
+    return setCxxInstance(o, maxBytes);
+  }
+
+  // Reads channel until it has no more bytes, returns how many were read.
+  // The pooled reader's buffer saves a ByteBuffer per body.
+  jlong readFrom(jni::alias_ref<jni::JReadableByteChannel> channel) {
+    SONAR_JNI_CALL("NetworkBodyCapture.readFrom");
+    jni::DirectByteBufferReader reader;
+    return reader.readAll(channel, [this](const uint8_t* data, size_t size) {
+      append(data, size);
+    });
+  }
 
-  std::string identifier() const {
-    static const auto method = javaClassStatic()->getMethod<std::string()>("getId");
-    return method(self())->toStdString();
+  void append(const uint8_t* data, size_t size) {
+    totalBytes_ += size;
+    if (data_.size() < maxBytes_) {
+      data_.append(
+          reinterpret_cast<const char*>(data),
+          std::min(size, maxBytes_ - data_.size()));
+    }
+  }
+
+  bool isTruncated() {
+    return totalBytes_ > data_.size();
+  }
+
+  jlong totalBytes() {
+    return static_cast<jlong>(totalBytes_);
+  }
+
+  std::string base64() {
+    return toBase64(folly::ByteRange(folly::StringPiece(data_)));
   }
 
-  void didConnect(std::shared_ptr<SonarConnection> conn) {
-    static const auto method = javaClassStatic()->getMethod<void(jni::alias_ref<JSonarConnection::javaobject>)>("onConnect");
-    method(self(), JSonarConnectionImpl::newObjectCxxArgs(conn));
+  jni::local_ref<jni::JArrayByte> toByteArray() {
+    auto bytes = jni::JArrayByte::newArray(data_.size());
+    bytes->setRegion(0, data_.size(), reinterpret_cast<const jbyte*>(data_.data()));
+    return bytes;
   }
 
-  void didDisconnect() {
-    static const auto method = javaClassStatic()->getMethod<void()>("onDisconnect");
-    method(self());
+ public:
+  const std::string& data() const {
+    return data_;
   }
+
+ private:
+  const size_t maxBytes_;
+  std::string data_;
+  uint64_t totalBytes_ = 0;
 };
 
-class JSonarStateUpdateListener : public jni::JavaClass<JSonarStateUpdateListener> {
+// The network plugin's requests and responses are formatted and buffered by
+// SonarNetworkReporter, the same as on iOS. Java only hands over their fields,
+// captured bodies are read where they already are in native memory.
+class JSonarNetworkReporter : public jni::HybridClass<JSonarNetworkReporter> {
  public:
-  constexpr static auto  kJavaDescriptor = "Lcom/facebook/sonar/core/SonarStateUpdateListener;";
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/SonarNetworkReporter;";
 
-  void onUpdate() {
-    static const auto method = javaClassStatic()->getMethod<void()>("onUpdate");
-    method(self());
+  static void registerNatives() {
+    registerHybrid({
+        makeNativeMethod("initHybrid", JSonarNetworkReporter::initHybrid),
+        makeNativeMethod("setNativeConnection", JSonarNetworkReporter::setNativeConnection),
+        makeNativeMethod("reportRequestNative", JSonarNetworkReporter::reportRequest),
+        makeNativeMethod("reportResponseNative", JSonarNetworkReporter::reportResponse),
+        makeNativeMethod("takeBuffered", JSonarNetworkReporter::takeBuffered),
+        makeNativeMethod("enableHeaderTable", JSonarNetworkReporter::enableHeaderTable),
+        makeNativeMethod("setUrlFilterNative", JSonarNetworkReporter::setUrlFilter),
+        makeNativeMethod("shouldCaptureNative", JSonarNetworkReporter::shouldCapture),
+    });
+  }
+
+ private:
+  friend HybridBase;
+
+  using Header = SonarNetworkReporter::Header;
+
+  static SonarNetworkReporter::Options options(jint maxBufferedBytes, jint maxBodyBytes, jint maxRequestsPerSecond) {
+    SonarNetworkReporter::Options options;
+    options.maxBufferedBytes = maxBufferedBytes;
+    options.maxBodyBytes = maxBodyBytes;
+    options.maxRequestsPerSecond = maxRequestsPerSecond;
+    if (auto client = SonarClient::instance()) {
+      options.memoryBudget = client->memoryBudget();
+    }
+    return options;
   }
-  void onStepStarted(std::string step) {
-    static const auto method = javaClassStatic()->getMethod<void(std::string)>("onStepStarted");
-    method(self(), step);
+
+  JSonarNetworkReporter(jint maxBufferedBytes, jint maxBodyBytes, jint maxRequestsPerSecond)
+      : reporter_(options(maxBufferedBytes, maxBodyBytes, maxRequestsPerSecond)) {}
+
+  static void initHybrid(jni::alias_ref<jhybridobject> o, jint maxBufferedBytes, jint maxBodyBytes, jint maxRequestsPerSecond) {
+    return setCxxInstance(o, maxBufferedBytes, maxBodyBytes, maxRequestsPerSecond);
+  }
+
+  // Null buffers events until the next connection.
+  void setNativeConnection(jni::alias_ref<JSonarConnectionImpl::javaobject> connection) {
+    reporter_.setConnection(connection ? connection->cthis()->connection() : nullptr);
+  }
+
+  void reportRequest(
+      const std::string id,
+      jlong timestamp,
+      jni::alias_ref<jni::JString> method,
+      jni::alias_ref<jni::JString> url,
+      jni::alias_ref<jni::JArrayClass<jstring>> headers,
+      jni::alias_ref<jni::JArrayByte> body,
+      jni::alias_ref<JNetworkBodyCapture::javaobject> capture) {
+    SONAR_JNI_CALL("SonarNetworkReporter.reportRequest");
+    SonarNetworkReporter::Request request;
+    request.id = id;
+    request.timestamp = timestamp;
+    request.method = optionalString(method);
+    request.url = optionalString(url);
+    request.headers = toHeaders(headers);
+    withBody(body, capture, [&](folly::Optional<folly::ByteRange> bytes) {
+      request.body = bytes;
+      reporter_.reportRequest(request);
+    });
+  }
+
+  void reportResponse(
+      const std::string id,
+      jlong timestamp,
+      jint status,
+      jni::alias_ref<jni::JString> reason,
+      jni::alias_ref<jni::JArrayClass<jstring>> headers,
+      jni::alias_ref<jni::JArrayByte> body,
+      jni::alias_ref<JNetworkBodyCapture::javaobject> capture,
+      jboolean bodyPending) {
+    SONAR_JNI_CALL("SonarNetworkReporter.reportResponse");
+    SonarNetworkReporter::Response response;
+    response.id = id;
+    response.timestamp = timestamp;
+    response.status = status;
+    response.reason = optionalString(reason);
+    response.headers = toHeaders(headers);
+    response.bodyPending = bodyPending;
+    withBody(body, capture, [&](folly::Optional<folly::ByteRange> bytes) {
+      response.body = bytes;
+      reporter_.reportResponse(response);
+    });
+  }
+
+  jlong enableHeaderTable() {
+    return reporter_.enableHeaderTable();
+  }
+
+  // The desktop's params as JSON, see SonarUrlFilter::patternsFromDynamic.
+  // Returns whether there is a filter now.
+  jboolean setUrlFilter(const std::string params) {
+    auto filter = std::make_shared<SonarUrlFilter>(
+        SonarUrlFilter::patternsFromDynamic(folly::parseJson(params)));
+    const bool filtering = !filter->empty();
+    reporter_.setUrlFilter(std::move(filter));
+    return filtering;
+  }
+
+  jboolean shouldCapture(const std::string url) {
+    return reporter_.shouldCapture(url);
+  }
+
+  // For connections not backed by native code: methods and params alternate.
+  jni::local_ref<jni::JArrayClass<jstring>> takeBuffered() {
+    auto events = reporter_.takeBuffered();
+    auto result = jni::JArrayClass<jstring>::newArray(events.size() * 2);
+    for (size_t i = 0; i < events.size(); i++) {
+      result->setElement(2 * i, jni::make_jstring(events[i].method).get());
+      result->setElement(2 * i + 1, jni::make_jstring(events[i].params->moveToFbString().toStdString()).get());
+    }
+    return result;
+  }
+
+  static folly::Optional<std::string> optionalString(jni::alias_ref<jni::JString> string) {
+    return string ? folly::Optional<std::string>(string->toStdString()) : folly::none;
+  }
+
+  // Names and values alternate.
+  static std::vector<Header> toHeaders(jni::alias_ref<jni::JArrayClass<jstring>> headers) {
+    std::vector<Header> result;
+    if (!headers) {
+      return result;
+    }
+    const size_t size = headers->size();
+    result.reserve(size / 2);
+    for (size_t i = 0; i + 1 < size; i += 2) {
+      result.push_back({headers->getElement(i)->toStdString(), headers->getElement(i + 1)->toStdString()});
+    }
+    return result;
+  }
+
+  // The bytes are only valid during report, the array stays pinned until then.
+  template <typename Report>
+  static void withBody(
+      jni::alias_ref<jni::JArrayByte> body,
+      jni::alias_ref<JNetworkBodyCapture::javaobject> capture,
+      Report report) {
+    if (body) {
+      auto pinned = body->pin();
+      report(folly::ByteRange(reinterpret_cast<const uint8_t*>(pinned.get()), pinned.size()));
+    } else if (capture) {
+      report(folly::ByteRange(folly::StringPiece(capture->cthis()->data())));
+    } else {
+      report(folly::none);
+    }
   }
-  void onStepSuccess(std::string step) {
-    static const auto method = javaClassStatic()->getMethod<void(std::string)>("onStepSuccess");
-    method(self(), step);
+
+  SonarNetworkReporter reporter_;
+};
+
+// The Java side of the client's plugins, see PluginRegistry.java. Plugins are
+// only known here by their handle in it, so no JNI references are made per
+// plugin.
+class JPluginRegistry : public jni::JavaClass<JPluginRegistry> {
+ public:
+  // PluginRegistry.NO_HANDLE.
+  static constexpr jint kNoHandle = -1;
+
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/android/PluginRegistry;";
+
+  struct Lookups {
+    jni::JStaticMethod<jboolean(jint)> create =
+        javaClassStatic()->getStaticMethod<jboolean(jint)>("create");
+    jni::JStaticMethod<void(jint, jni::alias_ref<JSonarConnection::javaobject>)> onConnect =
+        javaClassStatic()->getStaticMethod<void(jint, jni::alias_ref<JSonarConnection::javaobject>)>("onConnect");
+    jni::JStaticMethod<void(jint)> onDisconnect =
+        javaClassStatic()->getStaticMethod<void(jint)>("onDisconnect");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
+  }
+
+  // Builds the plugin if it was added with a factory, false if that failed.
+  static bool create(jint handle) {
+    SONAR_JNI_CALL("SonarPluginFactory.create");
+    return lookups().create(javaClassStatic(), handle);
+  }
+
+  // Returns the connection handed to the plugin.
+  static jni::global_ref<JSonarConnectionImpl::javaobject> didConnect(jint handle, std::shared_ptr<SonarConnection> conn) {
+    SONAR_JNI_CALL("SonarPlugin.onConnect");
+    jni::JniLocalScope scope(kLocalFrameCapacity);
+    auto connection = JSonarConnectionImpl::newObjectCxxArgs(std::move(conn));
+    lookups().onConnect(javaClassStatic(), handle, connection);
+    return jni::make_global(connection);
+  }
+
+  static void didDisconnect(jint handle) {
+    SONAR_JNI_CALL("SonarPlugin.onDisconnect");
+    jni::JniLocalScope scope(kLocalFrameCapacity);
+    lookups().onDisconnect(javaClassStatic(), handle);
+  }
+};
+
+class JSonarStateUpdateListener : public jni::JavaClass<JSonarStateUpdateListener> {
+ public:
+  constexpr static auto  kJavaDescriptor = "Lcom/facebook/sonar/core/SonarStateUpdateListener;";
+
+  struct Lookups {
+    jni::JMethod<void()> onUpdate = javaClassStatic()->getMethod<void()>("onUpdate");
+  };
+
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
   }
-  void onStepFailed(std::string step, std::string errorMessage) {
-    static const auto method = javaClassStatic()->getMethod<void(std::string, std::string)>("onStepFailed");
-    method(self(), step, errorMessage);
+
+  void onUpdate() {
+    SONAR_JNI_CALL("SonarStateUpdateListener.onUpdate");
+    lookups().onUpdate(self());
   }
 };
 
@@ -233,36 +1270,86 @@ class AndroidSonarStateUpdateListener : public SonarStateUpdateListener {
 
 class JSonarPluginWrapper : public SonarPlugin {
  public:
-  jni::global_ref<JSonarPlugin> jplugin;
-
   virtual std::string identifier() const override {
-    return jplugin->identifier();
+    return identifier_;
   }
 
   virtual void didConnect(std::shared_ptr<SonarConnection> conn) override {
-    jplugin->didConnect(conn);
+    auto connection = JPluginRegistry::didConnect(handle_, std::move(conn));
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_ = std::move(connection);
   }
 
   virtual void didDisconnect() override {
-    jplugin->didDisconnect();
+    JPluginRegistry::didDisconnect(handle_);
+    jni::global_ref<JSonarConnectionImpl::javaobject> connection;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      connection = std::move(connection_);
+    }
+    if (connection) {
+      connection->cthis()->close();
+    }
   }
 
-  JSonarPluginWrapper(jni::global_ref<JSonarPlugin> plugin): jplugin(plugin) {}
+  JSonarPluginWrapper(std::string identifier, jint handle)
+      : identifier_(std::move(identifier)), handle_(handle) {}
+
+  ~JSonarPluginWrapper() override {
+    if (connection_) {
+      // Plugins may be removed on any thread.
+      jni::ThreadScope scope;
+      connection_.reset();
+    }
+  }
+
+ private:
+  const std::string identifier_;
+  const jint handle_;
+  std::mutex mutex_;
+  // The plugin's current connection, closed once it is disconnected.
+  jni::global_ref<JSonarConnectionImpl::javaobject> connection_;
 };
 
 struct JStateSummary : public jni::JavaClass<JStateSummary> {
 public:
   constexpr static auto kJavaDescriptor = "Lcom/facebook/sonar/core/StateSummary;";
 
-  static jni::local_ref<JStateSummary> create() {
-    return newInstance();
-  }
+  struct Lookups {
+    jni::JConstructor<javaobject(jlong, jstring, jbyteArray)> constructor =
+        javaClassStatic()->getConstructor<javaobject(jlong, jstring, jbyteArray)>();
+  };
 
-  void addEntry(std::string name, std::string state) {
-    static const auto method = javaClassStatic()->getMethod<void(std::string, std::string)>("addEntry");
-    return method(self(), name, state);
+  static const Lookups& lookups() {
+    static const Lookups lookups;
+    return lookups;
   }
 
+  // The whole summary crosses over in one call: the names joined by newlines
+  // and each element's state as the ordinal of StateSummary.State.
+  static jni::local_ref<JStateSummary> create(
+      jlong version,
+      const std::vector<StateElement>& elements) {
+    SONAR_JNI_CALL("StateSummary.<init>");
+    std::string names;
+    std::vector<jbyte> states;
+    states.reserve(elements.size());
+    for (const auto& element : elements) {
+      if (!names.empty()) {
+        names += '\n';
+      }
+      names += element.name_;
+      switch (element.state_) {
+        case State::in_progress: states.push_back(0); break;
+        case State::success: states.push_back(1); break;
+        case State::failed: states.push_back(2); break;
+      }
+    }
+    auto jstates = jni::JArrayByte::newArray(states.size());
+    jstates->setRegion(0, states.size(), states.data());
+    return javaClassStatic()->newObject(
+        lookups().constructor, version, jni::make_jstring(names).get(), jstates.get());
+  }
 };
 
 class JSonarClient : public jni::HybridClass<JSonarClient> {
@@ -275,13 +1362,18 @@ class JSonarClient : public jni::HybridClass<JSonarClient> {
       makeNativeMethod("getInstance", JSonarClient::getInstance),
       makeNativeMethod("start", JSonarClient::start),
       makeNativeMethod("stop", JSonarClient::stop),
+      makeNativeMethod("connectivityChanged", JSonarClient::connectivityChanged),
+      makeNativeMethod("onAppBackground", JSonarClient::onAppBackground),
+      makeNativeMethod("onAppForeground", JSonarClient::onAppForeground),
+      makeNativeMethod("onMemoryPressure", JSonarClient::onMemoryPressure),
       makeNativeMethod("addPlugin", JSonarClient::addPlugin),
+      makeNativeMethod("addPluginFactory", JSonarClient::addPluginFactory),
       makeNativeMethod("removePlugin", JSonarClient::removePlugin),
       makeNativeMethod("subscribeForUpdates", JSonarClient::subscribeForUpdates),
       makeNativeMethod("unsubscribe", JSonarClient::unsubscribe),
-      makeNativeMethod("getPlugin", JSonarClient::getPlugin),
       makeNativeMethod("getState", JSonarClient::getState),
-      makeNativeMethod("getStateSummary", JSonarClient::getStateSummary),
+      makeNativeMethod("getStateSummarySince", JSonarClient::getStateSummarySince),
+      makeNativeMethod("getNativeCallStats", JSonarClient::getNativeCallStats),
     });
   }
 
@@ -298,14 +1390,57 @@ class JSonarClient : public jni::HybridClass<JSonarClient> {
   	SonarClient::instance()->stop();
   }
 
-  void addPlugin(jni::alias_ref<JSonarPlugin> plugin) {
-    auto wrapper = std::make_shared<JSonarPluginWrapper>(make_global(plugin));
-    SonarClient::instance()->addPlugin(wrapper);
+  void connectivityChanged() {
+    SonarClient::instance()->connectivityChanged();
+  }
+
+  void onAppBackground() {
+    SonarClient::instance()->onAppBackground();
+  }
+
+  void onAppForeground() {
+    SonarClient::instance()->onAppForeground();
+  }
+
+  void onMemoryPressure(jint level) {
+    SonarClient::instance()->onMemoryPressure(
+        static_cast<SonarMemoryPressure>(level));
   }
 
-  void removePlugin(jni::alias_ref<JSonarPlugin> plugin) {
+  // handle is the plugin's in PluginRegistry.java, which is NO_HANDLE if one
+  // was added under identifier already: the client reports it then.
+  void addPlugin(const std::string identifier, jint handle) {
+    addHandle(identifier, handle);
+    SonarClient::instance()->addPlugin(
+        std::make_shared<JSonarPluginWrapper>(identifier, handle));
+  }
+
+  // The Java plugin is only created once the desktop opens it.
+  void addPluginFactory(const std::string identifier, jint handle) {
+    addHandle(identifier, handle);
+    SonarClient::instance()->addPluginFactory(identifier, [identifier, handle]() -> std::shared_ptr<SonarPlugin> {
+      if (!JPluginRegistry::create(handle)) {
+        return nullptr;
+      }
+      return std::make_shared<JSonarPluginWrapper>(identifier, handle);
+    });
+  }
+
+  void removePlugin(jint handle) {
+    std::string identifier;
+    {
+      std::lock_guard<std::mutex> lock(mHandlesMutex);
+      auto it = mHandles.find(handle);
+      if (it == mHandles.end()) {
+        return;
+      }
+      identifier = std::move(it->second);
+      mHandles.erase(it);
+    }
     auto client = SonarClient::instance();
-    client->removePlugin(client->getPlugin(plugin->identifier()));
+    if (auto plugin = client->getPlugin(identifier)) {
+      client->removePlugin(plugin);
+    }
   }
 
   void subscribeForUpdates(jni::alias_ref<JSonarStateUpdateListener> stateListener) {
@@ -324,44 +1459,51 @@ class JSonarClient : public jni::HybridClass<JSonarClient> {
     return SonarClient::instance()->getState();
   }
 
-  jni::global_ref<JStateSummary::javaobject> getStateSummary() {
-    auto summary = jni::make_global(JStateSummary::create());
+  std::string getNativeCallStats() {
+    return JniCallStats::dump();
+  }
+
+  // Returns null if the summary hasn't changed since knownVersion. The
+  // summary includes counters, which change without bumping the state's
+  // version, so it is versioned by its contents instead.
+  jni::local_ref<JStateSummary::javaobject> getStateSummarySince(jlong knownVersion) {
     auto elements = SonarClient::instance()->getStateElements();
-    for (auto&& element : elements) {
-      std::string status;
-      switch (element.state_) {
-        case State::in_progress: status = "IN_PROGRESS"; break;
-        case State::failed: status = "FAILED"; break;
-        case State::success: status = "SUCCESS"; break;
+    jlong version;
+    {
+      std::lock_guard<std::mutex> lock(mSummaryMutex);
+      const bool changed = elements.size() != mSummary.size() ||
+          !std::equal(elements.begin(), elements.end(), mSummary.begin(),
+              [](const StateElement& a, const StateElement& b) {
+                return a.state_ == b.state_ && a.name_ == b.name_;
+              });
+      if (changed) {
+        mSummary = elements;
+        mSummaryVersion++;
       }
-      summary->addEntry(element.name_, status);
+      version = mSummaryVersion;
     }
-    return summary;
-  }
-
-  jni::alias_ref<JSonarPlugin> getPlugin(const std::string& identifier) {
-    auto plugin = SonarClient::instance()->getPlugin(identifier);
-    if (plugin) {
-      auto wrapper = std::static_pointer_cast<JSonarPluginWrapper>(plugin);
-      return wrapper->jplugin;
-    } else {
+    if (version == knownVersion) {
       return nullptr;
     }
+    return JStateSummary::create(version, elements);
   }
 
   static void init(
       jni::alias_ref<jclass>,
-      JEventBase* callbackWorker,
-      JEventBase* connectionWorker,
+      jni::alias_ref<JEventBase::jhybridobject> callbackWorker,
+      jni::alias_ref<JEventBase::jhybridobject> connectionWorker,
       const std::string host,
       const std::string os,
       const std::string device,
       const std::string deviceId,
       const std::string app,
       const std::string appId,
-      const std::string privateAppDirectory) {
+      const std::string privateAppDirectory,
+      const std::string brokerPath,
+      jboolean brokerOwner,
+      jboolean nativeWorkers) {
 
-    SonarClient::init({
+    SonarInitConfig config{
       {
         std::move(host),
         std::move(os),
@@ -371,25 +1513,92 @@ class JSonarClient : public jni::HybridClass<JSonarClient> {
         std::move(appId),
         std::move(privateAppDirectory)
       },
-      callbackWorker->eventBase(),
-      connectionWorker->eventBase()
-    });
+      callbackWorker ? callbackWorker->cthis()->eventBase() : nullptr,
+      connectionWorker ? connectionWorker->cthis()->eventBase() : nullptr,
+      std::make_shared<JniThreadFactory>()
+    };
+    if (nativeWorkers) {
+      // Callbacks call into Java, so the workers' threads are attached too.
+      // Both stay off the big cores the UI and render threads want.
+      config.nativeWorkers = true;
+      config.callbackThread.littleCores = true;
+      config.connectionThread.littleCores = true;
+      config.workerThreadFactory = std::make_shared<JniThreadFactory>();
+    }
+    config.brokerPath = std::move(brokerPath);
+    config.brokerOwner = brokerOwner;
+    gWatchdogFrames.reserve(64);
+    config.stackUnwinder = unwindWithLyra;
+    // SonarConnectivityReceiver retries as soon as a desktop may be back.
+    config.idleReconnectInterval = std::chrono::minutes(15);
+    if (config.deviceData.host != "localhost") {
+      // Emulators may also reach the desktop through adb reverse.
+      config.hostCandidates = {"localhost"};
+    }
+    SonarClient::init(std::move(config));
   }
 
  private:
   friend HybridBase;
   std::shared_ptr<SonarStateUpdateListener> mStateListener = nullptr;
+  std::mutex mSummaryMutex;
+  std::vector<StateElement> mSummary;
+  jlong mSummaryVersion = 0;
+  // The identifiers of the plugins added, by their handle.
+  std::mutex mHandlesMutex;
+  std::unordered_map<jint, std::string> mHandles;
+
+  void addHandle(const std::string& identifier, jint handle) {
+    if (handle != JPluginRegistry::kNoHandle) {
+      std::lock_guard<std::mutex> lock(mHandlesMutex);
+      mHandles[handle] = identifier;
+    }
+  }
+
   JSonarClient() {}
 };
 
+// Resolves everything in each class's Lookups up front, throwing if any of it
+// is missing.
+void prewarmLookups() {
+  JJSONArray::lookups();
+  JJSONObject::lookups();
+  JNumber::lookups();
+  JSonarObject::lookups();
+  JSonarArray::lookups();
+  JSonarReceiver::lookups();
+  JPluginRegistry::lookups();
+  JSonarStateUpdateListener::lookups();
+  JStateSummary::lookups();
+  JSonarResponderImpl::lookups();
+  // Classes only used for type checks, or whose members fbjni looks up.
+  jni::JString::javaClassStatic();
+  jni::JBoolean::javaClassStatic();
+  jni::JDouble::javaClassStatic();
+  jni::JFloat::javaClassStatic();
+  jni::JByteBuffer::javaClassStatic();
+  jni::JReadableByteChannel::javaClassStatic();
+  JSonarObjectSourceImpl::javaClassStatic();
+  JSonarResponderPeer::javaClassStatic();
+  JSonarConnectionImpl::javaClassStatic();
+}
+
 } // namespace
 
 jint JNI_OnLoad(JavaVM* vm, void*) {
   return jni::initialize(vm, [] {
+    // Plugins can throw at high rates, and the C++ frames are rarely looked
+    // at, so only symbolicate them once Java reads the trace.
+    jni::setLazyCppStackTraces(true);
     JSonarClient::registerNatives();
     JSonarConnectionImpl::registerNatives();
-    JSonarResponderImpl::registerNatives();
+    JSonarResponderPeer::registerNatives();
+    JSonarObjectSourceImpl::registerNatives();
+    JSonarEventBuffer::registerNatives();
+    JNetworkBodyCapture::registerNatives();
+    JSonarNetworkReporter::registerNatives();
     JEventBase::registerNatives();
+    prewarmLookups();
   });
 }
 
@@ -398,5 +1607,6 @@ AndroidSonarStateUpdateListener::AndroidSonarStateUpdateListener(jni::alias_ref<
 }
 
 void AndroidSonarStateUpdateListener::onUpdate() {
-  jStateListener->onUpdate();
+  // Updates are delivered on SonarState's own notification thread.
+  jni::ThreadScope::WithClassLoader([this]() { jStateListener->onUpdate(); });
 }
@@ -7,6 +7,7 @@
  */
 package com.facebook.sonar.android;
 
+import android.app.ActivityManager;
 import android.content.Context;
 import android.content.pm.PackageManager;
 import android.net.wifi.WifiInfo;
@@ -18,41 +19,105 @@ import com.facebook.sonar.core.SonarClient;
 
 public final class AndroidSonarClient {
   private static boolean sIsInitialized = false;
+  private static LazySonarClient sClient;
   private static SonarThread sSonarThread;
   private static SonarThread sConnectionThread;
   private static final String[] REQUIRED_PERMISSIONS =
       new String[] {"android.permission.INTERNET", "android.permission.ACCESS_WIFI_STATE"};
 
   public static synchronized SonarClient getInstance(Context context) {
+    return getInstance(context, false);
+  }
+
+  /**
+   * @param singleThread Run the connection on the same thread as the client's callbacks rather
+   *     than on a thread of its own, for devices where an extra thread costs more than the
+   *     connection being held up by slow callbacks. Only honored by the first call.
+   */
+  public static synchronized SonarClient getInstance(Context context, boolean singleThread) {
+    return getInstance(context, singleThread, false);
+  }
+
+  /**
+   * @param shareAcrossProcesses For apps running in several processes: the app's main process
+   *     connects to the desktop and the other processes reach it through a local socket, so that
+   *     the desktop sees one app and the connection is only set up once. Every process has to
+   *     opt in. Only honored by the first call.
+   */
+  public static synchronized SonarClient getInstance(
+      Context context, boolean singleThread, boolean shareAcrossProcesses) {
+    return getInstance(context, singleThread, shareAcrossProcesses, false);
+  }
+
+  /**
+   * @param nativeThreads Create the client's threads natively, at background priority and kept
+   *     to the device's little cores where it has any, rather than as Java threads. How they
+   *     were set up is reported by the diagnostics plugin. Always creates two threads, so
+   *     singleThread isn't honored. Only honored by the first call.
+   */
+  public static synchronized SonarClient getInstance(
+      Context context,
+      final boolean singleThread,
+      final boolean shareAcrossProcesses,
+      final boolean nativeThreads) {
     if (!sIsInitialized) {
       checkRequiredPermissions(context);
-      sSonarThread = new SonarThread("SonarEventBaseThread");
-      sSonarThread.start();
-      sConnectionThread = new SonarThread("SonarConnectionThread");
-      sConnectionThread.start();
-
       final Context app =
           context.getApplicationContext() == null ? context : context.getApplicationContext();
-      SonarClientImpl.init(
-          sSonarThread.getEventBase(),
-          sConnectionThread.getEventBase(),
-          getServerHost(app),
-          "Android",
-          getFriendlyDeviceName(),
-          getId(),
-          getRunningAppName(app),
-          getPackageName(app),
-          context.getFilesDir().getAbsolutePath());
+      final String host = getServerHost(app);
+      sClient =
+          LazySonarClient.create(
+              host,
+              new Runnable() {
+                @Override
+                public void run() {
+                  initNative(app, host, singleThread, shareAcrossProcesses, nativeThreads);
+                }
+              });
+      SonarConnectivityReceiver.register(app, sClient);
+      SonarAppLifecycle.register(app, sClient);
       sIsInitialized = true;
     }
-    return SonarClientImpl.getInstance();
+    return sClient;
+  }
+
+  // Once the native library is loaded, see LazySonarClient.
+  private static void initNative(
+      Context app,
+      String host,
+      boolean singleThread,
+      boolean shareAcrossProcesses,
+      boolean nativeThreads) {
+    if (!nativeThreads) {
+      sSonarThread = new SonarThread("SonarEventBaseThread");
+      sSonarThread.start();
+      if (singleThread) {
+        sConnectionThread = sSonarThread;
+      } else {
+        sConnectionThread = new SonarThread("SonarConnectionThread");
+        sConnectionThread.start();
+      }
+    }
+    SonarClientImpl.init(
+        nativeThreads ? null : sSonarThread.getEventBase(),
+        nativeThreads ? null : sConnectionThread.getEventBase(),
+        host,
+        "Android",
+        getFriendlyDeviceName(),
+        getId(),
+        getRunningAppName(app),
+        getPackageName(app),
+        app.getFilesDir().getAbsolutePath(),
+        shareAcrossProcesses ? "@sonar-broker-" + getPackageName(app) : "",
+        !shareAcrossProcesses || isMainProcess(app),
+        nativeThreads);
   }
 
   public static synchronized SonarClient getInstanceIfInitialized() {
     if (!sIsInitialized) {
       return null;
     }
-    return SonarClientImpl.getInstance();
+    return sClient;
   }
 
   static void checkRequiredPermissions(Context context) {
@@ -108,4 +173,19 @@ public final class AndroidSonarClient {
   static String getPackageName(Context context) {
     return context.getPackageName();
   }
+
+  // The main process is named after the package, the others add a suffix.
+  static boolean isMainProcess(Context context) {
+    final ActivityManager manager =
+        (ActivityManager) context.getSystemService(Context.ACTIVITY_SERVICE);
+    final int pid = android.os.Process.myPid();
+    if (manager != null && manager.getRunningAppProcesses() != null) {
+      for (ActivityManager.RunningAppProcessInfo info : manager.getRunningAppProcesses()) {
+        if (info.pid == pid) {
+          return getPackageName(context).equals(info.processName);
+        }
+      }
+    }
+    return true;
+  }
 }
@@ -9,15 +9,11 @@ package com.facebook.sonar.android;
 
 import com.facebook.jni.HybridClassBase;
 import com.facebook.proguard.annotations.DoNotStrip;
-import com.facebook.soloader.SoLoader;
-import com.facebook.sonar.BuildConfig;
 
 @DoNotStrip
 class EventBase extends HybridClassBase {
   static {
-    if (BuildConfig.IS_INTERNAL_BUILD) {
-      SoLoader.loadLibrary("sonar");
-    }
+    SonarNativeLibrary.load();
   }
 
   EventBase() {
@@ -0,0 +1,387 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import android.os.SystemClock;
+import android.util.Log;
+import com.facebook.sonar.core.SonarClient;
+import com.facebook.sonar.core.SonarPlugin;
+import com.facebook.sonar.core.SonarPluginFactory;
+import com.facebook.sonar.core.SonarStateUpdateListener;
+import com.facebook.sonar.core.StateSummary;
+import java.io.IOException;
+import java.net.InetSocketAddress;
+import java.net.Socket;
+import java.util.ArrayList;
+import java.util.List;
+import javax.annotation.Nullable;
+
+/**
+ * The client apps get, which leaves loading the native library and setting up the native client
+ * out of app startup. Until a desktop answers on its ports, or something else loads the library,
+ * e.g. a plugin reporting through native code, plugins are only added to the registry and calls to
+ * the native client are queued. They are made in order once it exists. Safe to use from any
+ * thread.
+ */
+final class LazySonarClient implements SonarClient {
+  private static final String TAG = "Sonar";
+  // The desktop's ports, for certificate exchange and for connections with a certificate.
+  private static final int[] DESKTOP_PORTS = {8088, 8089};
+  private static final int PROBE_TIMEOUT_MS = 500;
+  private static final long MIN_PROBE_INTERVAL_MS = 1000;
+  private static final long MAX_PROBE_INTERVAL_MS = 30000;
+
+  private interface Call {
+    void run(SonarClientImpl client);
+  }
+
+  private final String mHost;
+  private final Runnable mInitializer;
+  private final PluginRegistry mPlugins = PluginRegistry.INSTANCE;
+  private final long mCreatedAt = SystemClock.elapsedRealtime();
+
+  // Guarded by this.
+  private @Nullable SonarClientImpl mClient;
+  private final List<Call> mPending = new ArrayList<>();
+  private boolean mStarted;
+  private boolean mInBackground;
+  private boolean mProbing;
+  private boolean mConnectivityChanged;
+
+  private LazySonarClient(String host, Runnable initializer) {
+    mHost = host;
+    mInitializer = initializer;
+  }
+
+  /**
+   * initializer sets up the native client, on the thread that loads the library. It runs right
+   * away if that already happened.
+   */
+  static LazySonarClient create(String host, Runnable initializer) {
+    final LazySonarClient client = new LazySonarClient(host, initializer);
+    SonarNativeLibrary.whenLoaded(
+        new Runnable() {
+          @Override
+          public void run() {
+            client.onLoaded();
+          }
+        });
+    return client;
+  }
+
+  private void onLoaded() {
+    final long start = SystemClock.elapsedRealtime();
+    mInitializer.run();
+    final SonarClientImpl client = SonarClientImpl.getInstance();
+    synchronized (this) {
+      if (mInBackground) {
+        mPending.add(
+            0,
+            new Call() {
+              @Override
+              public void run(SonarClientImpl client) {
+                client.onAppBackground();
+              }
+            });
+      }
+    }
+    // Calls made while the queue is replayed are queued behind it.
+    while (true) {
+      final List<Call> pending;
+      synchronized (this) {
+        if (mPending.isEmpty()) {
+          mClient = client;
+          notifyAll();
+          break;
+        }
+        pending = new ArrayList<>(mPending);
+        mPending.clear();
+      }
+      for (Call call : pending) {
+        call.run(client);
+      }
+    }
+    Log.i(
+        TAG,
+        String.format(
+            "Loaded the native library in %d ms and set up the client in %d ms, "
+                + "%d ms after it was created",
+            SonarNativeLibrary.getLoadMillis(),
+            SystemClock.elapsedRealtime() - start,
+            start - mCreatedAt));
+  }
+
+  private synchronized @Nullable SonarClientImpl client() {
+    return mClient;
+  }
+
+  private void call(Call call) {
+    final SonarClientImpl client;
+    synchronized (this) {
+      if (mClient == null) {
+        mPending.add(call);
+        return;
+      }
+      client = mClient;
+    }
+    call.run(client);
+  }
+
+  @Override
+  public void addPlugin(SonarPlugin plugin) {
+    final String id = plugin.getId();
+    final int handle = mPlugins.add(plugin);
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.addPlugin(id, handle);
+          }
+        });
+  }
+
+  @Override
+  public void addPluginFactory(final String id, SonarPluginFactory factory) {
+    final int handle = mPlugins.addFactory(id, factory);
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.addPluginFactory(id, handle);
+          }
+        });
+  }
+
+  @Override
+  @SuppressWarnings("unchecked")
+  public <T extends SonarPlugin> T getPlugin(String id) {
+    return (T) mPlugins.get(id);
+  }
+
+  @Override
+  public void removePlugin(SonarPlugin plugin) {
+    final int handle = mPlugins.handle(plugin.getId());
+    final SonarClientImpl client = client();
+    if (client != null) {
+      // The native client disconnects it first, through the registry.
+      client.removePlugin(handle);
+      mPlugins.remove(handle);
+      return;
+    }
+    // Not connected yet, the native client only gets to add and remove the handle.
+    mPlugins.remove(handle);
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.removePlugin(handle);
+          }
+        });
+  }
+
+  @Override
+  public void start() {
+    synchronized (this) {
+      mStarted = true;
+    }
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.start();
+          }
+        });
+    startProbing();
+  }
+
+  @Override
+  public void stop() {
+    synchronized (this) {
+      mStarted = false;
+    }
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.stop();
+          }
+        });
+  }
+
+  @Override
+  public void subscribeForUpdates(final SonarStateUpdateListener stateListener) {
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.subscribeForUpdates(stateListener);
+          }
+        });
+  }
+
+  @Override
+  public void unsubscribe() {
+    call(
+        new Call() {
+          @Override
+          public void run(SonarClientImpl client) {
+            client.unsubscribe();
+          }
+        });
+  }
+
+  @Override
+  public String getState() {
+    final SonarClientImpl client = client();
+    return client != null ? client.getState() : "Waiting for a desktop to load the client\n";
+  }
+
+  @Override
+  public StateSummary getStateSummary() {
+    return getStateSummary(null);
+  }
+
+  @Override
+  public StateSummary getStateSummary(@Nullable StateSummary previous) {
+    final SonarClientImpl client = client();
+    if (client != null) {
+      return client.getStateSummary(previous);
+    }
+    final StateSummary summary = new StateSummary();
+    summary.addEntry("Wait for a desktop to load the client", "IN_PROGRESS");
+    return summary;
+  }
+
+  @Override
+  public String getNativeCallStats() {
+    final SonarClientImpl client = client();
+    return client != null ? client.getNativeCallStats() : "";
+  }
+
+  // Called by SonarConnectivityReceiver and SonarAppLifecycle.
+
+  void connectivityChanged() {
+    final SonarClientImpl client;
+    synchronized (this) {
+      client = mClient;
+      if (client == null) {
+        // A desktop may have become reachable.
+        mConnectivityChanged = true;
+        notifyAll();
+        return;
+      }
+    }
+    client.connectivityChanged();
+  }
+
+  void onAppBackground() {
+    setInBackground(true);
+  }
+
+  void onAppForeground() {
+    setInBackground(false);
+  }
+
+  void onMemoryPressure(int level) {
+    // Before the native client exists there is nothing native to release.
+    final SonarClientImpl client = client();
+    if (client != null) {
+      client.onMemoryPressure(level);
+    }
+  }
+
+  private void setInBackground(boolean inBackground) {
+    final SonarClientImpl client;
+    synchronized (this) {
+      mInBackground = inBackground;
+      client = mClient;
+    }
+    if (client == null) {
+      // Told once it exists.
+      return;
+    }
+    if (inBackground) {
+      client.onAppBackground();
+    } else {
+      client.onAppForeground();
+    }
+  }
+
+  private synchronized void startProbing() {
+    if (mProbing || mClient != null) {
+      return;
+    }
+    mProbing = true;
+    final Thread thread =
+        new Thread(
+            new Runnable() {
+              @Override
+              public void run() {
+                probe();
+              }
+            },
+            "SonarDesktopProbe");
+    thread.setDaemon(true);
+    thread.start();
+  }
+
+  // Checks whether a desktop is around, backing off while none is and starting over when
+  // connectivity changes, until one is, the client is stopped, or the library is loaded.
+  private void probe() {
+    long interval = MIN_PROBE_INTERVAL_MS;
+    while (true) {
+      synchronized (this) {
+        if (!mStarted || mClient != null) {
+          mProbing = false;
+          return;
+        }
+      }
+      if (isDesktopReachable()) {
+        synchronized (this) {
+          mProbing = false;
+        }
+        SonarNativeLibrary.load();
+        return;
+      }
+      synchronized (this) {
+        if (!mConnectivityChanged && mClient == null) {
+          try {
+            wait(interval);
+          } catch (InterruptedException e) {
+            // Probe again.
+          }
+        }
+        if (mConnectivityChanged) {
+          mConnectivityChanged = false;
+          interval = MIN_PROBE_INTERVAL_MS;
+        } else {
+          interval = Math.min(interval * 2, MAX_PROBE_INTERVAL_MS);
+        }
+      }
+    }
+  }
+
+  private boolean isDesktopReachable() {
+    for (int port : DESKTOP_PORTS) {
+      final Socket socket = new Socket();
+      try {
+        socket.connect(new InetSocketAddress(mHost, port), PROBE_TIMEOUT_MS);
+        return true;
+      } catch (IOException e) {
+        // Not on this port.
+      } finally {
+        try {
+          socket.close();
+        } catch (IOException e) {
+          // Nothing to do.
+        }
+      }
+    }
+    return false;
+  }
+}
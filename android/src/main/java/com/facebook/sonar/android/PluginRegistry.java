@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import android.util.SparseArray;
+import com.facebook.proguard.annotations.DoNotStrip;
+import com.facebook.sonar.core.SonarConnection;
+import com.facebook.sonar.core.SonarPlugin;
+import com.facebook.sonar.core.SonarPluginFactory;
+import java.util.HashMap;
+import java.util.Map;
+import javax.annotation.Nullable;
+
+/**
+ * The Java side of the client's plugins. Each plugin, or factory until it has built its plugin, is
+ * held here under an int handle, which is all the native client keeps of it. The native client
+ * calls back in with the handle, so no JNI references are made per plugin, and plugins are looked
+ * up by id without going through JNI at all. Safe to use from any thread.
+ */
+@DoNotStrip
+final class PluginRegistry {
+  static final int NO_HANDLE = -1;
+
+  private static final class Entry {
+    final String id;
+    private @Nullable SonarPluginFactory mFactory;
+    private @Nullable SonarPlugin mPlugin;
+
+    Entry(String id, @Nullable SonarPlugin plugin, @Nullable SonarPluginFactory factory) {
+      this.id = id;
+      mPlugin = plugin;
+      mFactory = factory;
+    }
+
+    // Built under the entry's lock rather than the registry's, a factory may well add or look up
+    // other plugins.
+    synchronized @Nullable SonarPlugin plugin() {
+      if (mPlugin == null && mFactory != null) {
+        mPlugin = mFactory.create();
+        mFactory = null;
+      }
+      return mPlugin;
+    }
+  }
+
+  // The client is a singleton, and so is its registry: the native client calls back statically.
+  static final PluginRegistry INSTANCE = new PluginRegistry();
+
+  private final SparseArray<Entry> mEntries = new SparseArray<>();
+  private final Map<String, Integer> mHandles = new HashMap<>();
+  private int mNextHandle;
+
+  /** The plugin's handle, or NO_HANDLE if one was added under its id already. */
+  synchronized int add(SonarPlugin plugin) {
+    return add(new Entry(plugin.getId(), plugin, null));
+  }
+
+  synchronized int addFactory(String id, SonarPluginFactory factory) {
+    return add(new Entry(id, null, factory));
+  }
+
+  /** The plugin added under id, building it if it was added with a factory. */
+  @Nullable
+  SonarPlugin get(String id) {
+    final Entry entry;
+    synchronized (this) {
+      final Integer handle = mHandles.get(id);
+      entry = handle == null ? null : mEntries.get(handle);
+    }
+    return entry == null ? null : entry.plugin();
+  }
+
+  @Nullable
+  SonarPlugin get(int handle) {
+    final Entry entry;
+    synchronized (this) {
+      entry = mEntries.get(handle);
+    }
+    return entry == null ? null : entry.plugin();
+  }
+
+  /** The handle of the plugin or factory added under id, or NO_HANDLE. */
+  synchronized int handle(String id) {
+    final Integer handle = mHandles.get(id);
+    return handle == null ? NO_HANDLE : handle;
+  }
+
+  synchronized void remove(int handle) {
+    final Entry entry = mEntries.get(handle);
+    if (entry != null) {
+      mEntries.remove(handle);
+      mHandles.remove(entry.id);
+    }
+  }
+
+  // Like the native client, the plugin already added under an id stays.
+  private int add(Entry entry) {
+    if (mHandles.containsKey(entry.id)) {
+      return NO_HANDLE;
+    }
+    final int handle = mNextHandle++;
+    mEntries.put(handle, entry);
+    mHandles.put(entry.id, handle);
+    return handle;
+  }
+
+  // Called by the native client.
+
+  @DoNotStrip
+  static boolean create(int handle) {
+    return INSTANCE.get(handle) != null;
+  }
+
+  @DoNotStrip
+  static void onConnect(int handle, SonarConnection connection) throws Exception {
+    final SonarPlugin plugin = INSTANCE.get(handle);
+    if (plugin != null) {
+      plugin.onConnect(connection);
+    }
+  }
+
+  @DoNotStrip
+  static void onDisconnect(int handle) throws Exception {
+    final SonarPlugin plugin = INSTANCE.get(handle);
+    if (plugin != null) {
+      plugin.onDisconnect();
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import android.app.Activity;
+import android.app.Application;
+import android.content.ComponentCallbacks2;
+import android.content.Context;
+import android.content.res.Configuration;
+import android.os.Bundle;
+
+/**
+ * Tells the client when the app goes to the background, i.e. none of its activities are started
+ * anymore, and when it comes back, so that it can hold events back meanwhile. Also tells it when
+ * the system is short of memory, so that it can release what it holds.
+ */
+class SonarAppLifecycle implements Application.ActivityLifecycleCallbacks, ComponentCallbacks2 {
+  // SonarMemoryPressure's levels.
+  private static final int MEMORY_PRESSURE_LOW = 0;
+  private static final int MEMORY_PRESSURE_MODERATE = 1;
+  private static final int MEMORY_PRESSURE_CRITICAL = 2;
+
+  private final LazySonarClient mClient;
+  // Only accessed on the main thread.
+  private int mStartedActivities = 0;
+
+  private SonarAppLifecycle(LazySonarClient client) {
+    mClient = client;
+  }
+
+  static void register(Context context, LazySonarClient client) {
+    final SonarAppLifecycle lifecycle = new SonarAppLifecycle(client);
+    if (context instanceof Application) {
+      ((Application) context).registerActivityLifecycleCallbacks(lifecycle);
+    }
+    context.registerComponentCallbacks(lifecycle);
+  }
+
+  @Override
+  public void onTrimMemory(int level) {
+    if (level >= TRIM_MEMORY_COMPLETE || level == TRIM_MEMORY_RUNNING_CRITICAL) {
+      mClient.onMemoryPressure(MEMORY_PRESSURE_CRITICAL);
+    } else if (level >= TRIM_MEMORY_MODERATE || level == TRIM_MEMORY_RUNNING_LOW) {
+      mClient.onMemoryPressure(MEMORY_PRESSURE_MODERATE);
+    } else if (level >= TRIM_MEMORY_BACKGROUND || level == TRIM_MEMORY_RUNNING_MODERATE) {
+      mClient.onMemoryPressure(MEMORY_PRESSURE_LOW);
+    }
+    // TRIM_MEMORY_UI_HIDDEN only means the app went to the background.
+  }
+
+  @Override
+  public void onLowMemory() {
+    mClient.onMemoryPressure(MEMORY_PRESSURE_CRITICAL);
+  }
+
+  @Override
+  public void onConfigurationChanged(Configuration newConfig) {}
+
+  @Override
+  public void onActivityStarted(Activity activity) {
+    if (mStartedActivities++ == 0) {
+      mClient.onAppForeground();
+    }
+  }
+
+  @Override
+  public void onActivityStopped(Activity activity) {
+    // Activities started before the client was created aren't counted.
+    if (mStartedActivities > 0 && --mStartedActivities == 0) {
+      mClient.onAppBackground();
+    }
+  }
+
+  @Override
+  public void onActivityCreated(Activity activity, Bundle savedInstanceState) {}
+
+  @Override
+  public void onActivityResumed(Activity activity) {}
+
+  @Override
+  public void onActivityPaused(Activity activity) {}
+
+  @Override
+  public void onActivitySaveInstanceState(Activity activity, Bundle outState) {}
+
+  @Override
+  public void onActivityDestroyed(Activity activity) {}
+}
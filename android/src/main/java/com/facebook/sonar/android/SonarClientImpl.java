@@ -9,19 +9,17 @@ package com.facebook.sonar.android;
 
 import com.facebook.jni.HybridData;
 import com.facebook.proguard.annotations.DoNotStrip;
-import com.facebook.soloader.SoLoader;
-import com.facebook.sonar.BuildConfig;
 import com.facebook.sonar.core.SonarClient;
 import com.facebook.sonar.core.SonarPlugin;
+import com.facebook.sonar.core.SonarPluginFactory;
 import com.facebook.sonar.core.SonarStateUpdateListener;
 import com.facebook.sonar.core.StateSummary;
+import javax.annotation.Nullable;
 
 @DoNotStrip
 class SonarClientImpl implements SonarClient {
   static {
-    if (BuildConfig.IS_INTERNAL_BUILD) {
-      SoLoader.loadLibrary("sonar");
-    }
+    SonarNativeLibrary.load();
   }
 
   private final HybridData mHybridData;
@@ -39,18 +37,57 @@ class SonarClientImpl implements SonarClient {
       String deviceId,
       String app,
       String appId,
-      String privateAppDirectory);
+      String privateAppDirectory,
+      String brokerPath,
+      boolean brokerOwner,
+      boolean nativeWorkers);
 
   public static native SonarClientImpl getInstance();
 
+  /** Retry reaching the desktop right away, see SonarConnectivityReceiver. */
+  native void connectivityChanged();
+
+  /** See SonarAppLifecycle. */
+  native void onAppBackground();
+
+  native void onAppForeground();
+
+  /** level is one of SonarMemoryPressure's levels, see SonarAppLifecycle. */
+  native void onMemoryPressure(int level);
+
+  // The native client only knows plugins by their handle in the registry.
+  private final PluginRegistry mPlugins = PluginRegistry.INSTANCE;
+
   @Override
-  public native void addPlugin(SonarPlugin plugin);
+  public void addPlugin(SonarPlugin plugin) {
+    addPlugin(plugin.getId(), mPlugins.add(plugin));
+  }
 
   @Override
-  public native <T extends SonarPlugin> T getPlugin(String id);
+  public void addPluginFactory(String id, SonarPluginFactory factory) {
+    addPluginFactory(id, mPlugins.addFactory(id, factory));
+  }
 
   @Override
-  public native void removePlugin(SonarPlugin plugin);
+  @SuppressWarnings("unchecked")
+  public <T extends SonarPlugin> T getPlugin(String id) {
+    return (T) mPlugins.get(id);
+  }
+
+  @Override
+  public void removePlugin(SonarPlugin plugin) {
+    final int handle = mPlugins.handle(plugin.getId());
+    // The native client disconnects it first, through the registry.
+    removePlugin(handle);
+    mPlugins.remove(handle);
+  }
+
+  /** handle is PluginRegistry.NO_HANDLE if id was added already, for the native client to report. */
+  native void addPlugin(String id, int handle);
+
+  native void addPluginFactory(String id, int handle);
+
+  native void removePlugin(int handle);
 
   @Override
   public native void start();
@@ -68,5 +105,19 @@ class SonarClientImpl implements SonarClient {
   public native String getState();
 
   @Override
-  public native StateSummary getStateSummary();
+  public StateSummary getStateSummary() {
+    return getStateSummary(null);
+  }
+
+  @Override
+  public StateSummary getStateSummary(@Nullable StateSummary previous) {
+    final StateSummary summary =
+        getStateSummarySince(previous == null ? -1 : previous.getVersion());
+    return summary == null ? previous : summary;
+  }
+
+  private native @Nullable StateSummary getStateSummarySince(long version);
+
+  @Override
+  public native String getNativeCallStats();
 }
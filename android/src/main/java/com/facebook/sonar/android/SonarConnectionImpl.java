@@ -9,19 +9,17 @@ package com.facebook.sonar.android;
 
 import com.facebook.jni.HybridData;
 import com.facebook.proguard.annotations.DoNotStrip;
-import com.facebook.soloader.SoLoader;
-import com.facebook.sonar.BuildConfig;
 import com.facebook.sonar.core.SonarArray;
 import com.facebook.sonar.core.SonarConnection;
 import com.facebook.sonar.core.SonarObject;
+import com.facebook.sonar.core.SonarParamsBuilder;
 import com.facebook.sonar.core.SonarReceiver;
+import java.nio.ByteBuffer;
 
 @DoNotStrip
 class SonarConnectionImpl implements SonarConnection {
   static {
-    if (BuildConfig.IS_INTERNAL_BUILD) {
-      SoLoader.loadLibrary("sonar");
-    }
+    SonarNativeLibrary.load();
   }
 
   private final HybridData mHybridData;
@@ -40,10 +38,33 @@ class SonarConnectionImpl implements SonarConnection {
     sendArray(method, params);
   }
 
+  @Override
+  public void sendBytes(String method, ByteBuffer params) {
+    if (!params.isDirect()) {
+      // Native code can only read direct buffers in place.
+      final ByteBuffer direct = ByteBuffer.allocateDirect(params.remaining());
+      direct.put(params.duplicate());
+      direct.flip();
+      params = direct;
+    }
+    sendDirectBytes(method, params, params.position(), params.remaining());
+  }
+
   public native void sendObject(String method, SonarObject params);
 
+  public native void sendDirectBytes(String method, ByteBuffer params, int offset, int length);
+
   public native void sendArray(String method, SonarArray params);
 
+  @Override
+  public native void setSendLimit(String method, double maxPerSecond, double sampleRate);
+
+  @Override
+  public native boolean isSubscribed(String method);
+
+  @Override
+  public native void sendLazy(String method, SonarParamsBuilder builder);
+
   @Override
   public native void reportError(Throwable throwable);
 
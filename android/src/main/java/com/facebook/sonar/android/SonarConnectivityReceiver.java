@@ -0,0 +1,45 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import android.content.BroadcastReceiver;
+import android.content.Context;
+import android.content.Intent;
+import android.content.IntentFilter;
+import android.net.ConnectivityManager;
+
+/**
+ * Tells the client when the network or USB state changes, which is when a desktop that couldn't
+ * be reached may have become reachable, so that it can retry right away instead of polling.
+ */
+class SonarConnectivityReceiver extends BroadcastReceiver {
+  // UsbManager.ACTION_USB_STATE is hidden, it covers cables and adb being plugged in.
+  private static final String ACTION_USB_STATE = "android.hardware.usb.action.USB_STATE";
+
+  private final LazySonarClient mClient;
+
+  private SonarConnectivityReceiver(LazySonarClient client) {
+    mClient = client;
+  }
+
+  static void register(Context context, LazySonarClient client) {
+    final IntentFilter filter = new IntentFilter();
+    filter.addAction(ConnectivityManager.CONNECTIVITY_ACTION);
+    filter.addAction(ACTION_USB_STATE);
+    context.registerReceiver(new SonarConnectivityReceiver(client), filter);
+  }
+
+  @Override
+  public void onReceive(Context context, Intent intent) {
+    // Both are sticky, the state at registration isn't a change.
+    if (isInitialStickyBroadcast()) {
+      return;
+    }
+    mClient.connectivityChanged();
+  }
+}
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import com.facebook.jni.HybridClassBase;
+import com.facebook.proguard.annotations.DoNotStrip;
+import com.facebook.sonar.core.SonarConnection;
+import com.facebook.sonar.core.SonarObject;
+
+/**
+ * Events sent while no desktop is connected, kept serialized in native memory rather than as
+ * SonarObjects on the Java heap. Once they take up more than maxBytes the oldest ones are dropped.
+ */
+@DoNotStrip
+public class SonarEventBuffer extends HybridClassBase {
+  static {
+    SonarNativeLibrary.load();
+  }
+
+  public SonarEventBuffer(int maxBytes) {
+    initHybrid(maxBytes);
+  }
+
+  /** Serializes params right away, so the object can be collected. */
+  @DoNotStrip
+  public native void append(String method, SonarObject params);
+
+  /** Sends all buffered events to connection, oldest first, and empties the buffer. */
+  public void sendTo(SonarConnection connection) {
+    if (connection instanceof SonarConnectionImpl) {
+      drainTo((SonarConnectionImpl) connection);
+      return;
+    }
+    final String[] events = takeAll();
+    for (int i = 0; i + 1 < events.length; i += 2) {
+      connection.send(events[i], new SonarObject(events[i + 1]));
+    }
+  }
+
+  @DoNotStrip
+  private native void drainTo(SonarConnectionImpl connection);
+
+  @DoNotStrip
+  private native String[] takeAll();
+
+  @DoNotStrip
+  private native void initHybrid(int maxBytes);
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import android.os.SystemClock;
+import com.facebook.soloader.SoLoader;
+import com.facebook.sonar.BuildConfig;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Loads the sonar library, and with it folly and rsocket, the first time a class with natives is
+ * used. Loading relocates and registers all of them, which is why the client only gets to it once
+ * there is a desktop to connect to, see LazySonarClient. Safe to use from any thread.
+ */
+public final class SonarNativeLibrary {
+  // Guarded by the class.
+  private static boolean sLoaded;
+  private static long sLoadMillis = -1;
+  private static final List<Runnable> sListeners = new ArrayList<>();
+
+  private SonarNativeLibrary() {}
+
+  public static void load() {
+    final List<Runnable> listeners;
+    synchronized (SonarNativeLibrary.class) {
+      if (sLoaded) {
+        return;
+      }
+      final long start = SystemClock.elapsedRealtime();
+      if (BuildConfig.IS_INTERNAL_BUILD) {
+        SoLoader.loadLibrary("sonar");
+      }
+      sLoadMillis = SystemClock.elapsedRealtime() - start;
+      sLoaded = true;
+      listeners = new ArrayList<>(sListeners);
+      sListeners.clear();
+    }
+    // Listeners may well use classes with natives, which load() again.
+    for (Runnable listener : listeners) {
+      listener.run();
+    }
+  }
+
+  public static synchronized boolean isLoaded() {
+    return sLoaded;
+  }
+
+  /** How long loading the library took, -1 until it is loaded. */
+  public static synchronized long getLoadMillis() {
+    return sLoadMillis;
+  }
+
+  /** Runs listener once the library is loaded, on the thread loading it, or now if it is. */
+  static void whenLoaded(Runnable listener) {
+    synchronized (SonarNativeLibrary.class) {
+      if (!sLoaded) {
+        sListeners.add(listener);
+        return;
+      }
+    }
+    listener.run();
+  }
+}
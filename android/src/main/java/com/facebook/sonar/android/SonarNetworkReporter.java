@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import com.facebook.jni.HybridClassBase;
+import com.facebook.proguard.annotations.DoNotStrip;
+import com.facebook.sonar.core.SonarConnection;
+import com.facebook.sonar.core.SonarObject;
+import com.facebook.sonar.plugins.network.NetworkBodyCapture;
+import javax.annotation.Nullable;
+
+/**
+ * Formats, buffers and sends the network plugin's events in native code, shared with iOS. Events
+ * are written straight to JSON without building SonarObjects, and kept serialized in native memory
+ * while no desktop is connected. Bodies over maxBodyBytes are truncated and, with
+ * maxRequestsPerSecond above 0, requests beyond that rate are dropped with their responses.
+ */
+@DoNotStrip
+public class SonarNetworkReporter extends HybridClassBase {
+  static {
+    SonarNativeLibrary.load();
+  }
+
+  private @Nullable SonarConnection mJavaConnection;
+  // Spares a native call per request while there is no URL filter.
+  private volatile boolean mFiltering;
+
+  public SonarNetworkReporter(int maxBufferedBytes, int maxBodyBytes, int maxRequestsPerSecond) {
+    initHybrid(maxBufferedBytes, maxBodyBytes, maxRequestsPerSecond);
+  }
+
+  /** Events are sent to connection from now on, buffered ones first. Null buffers them again. */
+  public synchronized void setConnection(@Nullable SonarConnection connection) {
+    // The native side drops the URL filter along with the connection.
+    mFiltering = false;
+    if (connection instanceof SonarConnectionImpl) {
+      mJavaConnection = null;
+      setNativeConnection((SonarConnectionImpl) connection);
+      return;
+    }
+    setNativeConnection(null);
+    mJavaConnection = connection;
+    sendBufferedToJava();
+  }
+
+  /** Headers are given as alternating names and values, the body as bytes or as a capture. */
+  public synchronized void reportRequest(
+      String id,
+      long timestamp,
+      @Nullable String method,
+      @Nullable String url,
+      String[] headers,
+      @Nullable byte[] body,
+      @Nullable NetworkBodyCapture capture) {
+    reportRequestNative(id, timestamp, method, url, headers, body, capture);
+    sendBufferedToJava();
+  }
+
+  /**
+   * With bodyPending, the response is reported again once its body has been read, the desktop shows
+   * the latest report.
+   */
+  public synchronized void reportResponse(
+      String id,
+      long timestamp,
+      int status,
+      @Nullable String reason,
+      String[] headers,
+      @Nullable byte[] body,
+      @Nullable NetworkBodyCapture capture,
+      boolean bodyPending) {
+    reportResponseNative(id, timestamp, status, reason, headers, body, capture, bodyPending);
+    sendBufferedToJava();
+  }
+
+  /**
+   * Sends headers through a new string table from now on, until the connection changes. Returns
+   * the table's generation.
+   */
+  @DoNotStrip
+  public native long enableHeaderTable();
+
+  /**
+   * Only reports requests the desktop's filter matches from now on, until the connection changes.
+   * See SonarUrlFilter for the params. Null captures all of them again.
+   */
+  public void setUrlFilter(@Nullable SonarObject params) {
+    mFiltering = setUrlFilterNative(params == null ? "{}" : params.toJsonString());
+  }
+
+  /** Whether requests to url are reported, checked before capturing their headers and bodies. */
+  public boolean shouldCapture(String url) {
+    return !mFiltering || shouldCaptureNative(url);
+  }
+
+  // Connections not backed by native code get events through the buffer.
+  private void sendBufferedToJava() {
+    if (mJavaConnection == null) {
+      return;
+    }
+    final String[] events = takeBuffered();
+    for (int i = 0; i + 1 < events.length; i += 2) {
+      mJavaConnection.send(events[i], new SonarObject(events[i + 1]));
+    }
+  }
+
+  @DoNotStrip
+  private native void setNativeConnection(@Nullable SonarConnectionImpl connection);
+
+  @DoNotStrip
+  private native void reportRequestNative(
+      String id,
+      long timestamp,
+      @Nullable String method,
+      @Nullable String url,
+      String[] headers,
+      @Nullable byte[] body,
+      @Nullable NetworkBodyCapture capture);
+
+  @DoNotStrip
+  private native void reportResponseNative(
+      String id,
+      long timestamp,
+      int status,
+      @Nullable String reason,
+      String[] headers,
+      @Nullable byte[] body,
+      @Nullable NetworkBodyCapture capture,
+      boolean bodyPending);
+
+  @DoNotStrip
+  private native String[] takeBuffered();
+
+  @DoNotStrip
+  private native boolean setUrlFilterNative(String params);
+
+  @DoNotStrip
+  private native boolean shouldCaptureNative(String url);
+
+  @DoNotStrip
+  private native void initHybrid(int maxBufferedBytes, int maxBodyBytes, int maxRequestsPerSecond);
+}
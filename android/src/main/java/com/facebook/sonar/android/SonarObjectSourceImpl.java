@@ -0,0 +1,34 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import com.facebook.jni.HybridData;
+import com.facebook.proguard.annotations.DoNotStrip;
+import com.facebook.sonar.core.SonarObject;
+import javax.annotation.Nullable;
+import org.json.JSONObject;
+
+/** Fields of a call's params, converted from their native form as they are read. */
+@DoNotStrip
+class SonarObjectSourceImpl implements SonarObject.Source {
+  static {
+    SonarNativeLibrary.load();
+  }
+
+  private final HybridData mHybridData;
+
+  private SonarObjectSourceImpl(HybridData hd) {
+    mHybridData = hd;
+  }
+
+  @Override
+  public native @Nullable Object get(String name);
+
+  @Override
+  public native JSONObject materialize();
+}
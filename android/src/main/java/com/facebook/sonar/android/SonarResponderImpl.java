@@ -9,45 +9,83 @@ package com.facebook.sonar.android;
 
 import com.facebook.jni.HybridData;
 import com.facebook.proguard.annotations.DoNotStrip;
-import com.facebook.soloader.SoLoader;
-import com.facebook.sonar.BuildConfig;
 import com.facebook.sonar.core.SonarArray;
 import com.facebook.sonar.core.SonarObject;
 import com.facebook.sonar.core.SonarResponder;
 
+/**
+ * Responds to a single call. The native peer is reused for later calls, or freed, once this has
+ * responded, so only the first response is sent and any further ones are ignored.
+ */
 @DoNotStrip
 class SonarResponderImpl implements SonarResponder {
   static {
-    if (BuildConfig.IS_INTERNAL_BUILD) {
-      SoLoader.loadLibrary("sonar");
-    }
+    SonarNativeLibrary.load();
   }
 
-  private final HybridData mHybridData;
+  private final Peer mPeer;
+  private final int mGeneration;
 
-  private SonarResponderImpl(HybridData hd) {
-    mHybridData = hd;
+  @DoNotStrip
+  private SonarResponderImpl(Peer peer, int generation) {
+    mPeer = peer;
+    mGeneration = generation;
   }
 
   @Override
   public void success(SonarObject params) {
-    successObject(params);
+    mPeer.success(mGeneration, params);
   }
 
   @Override
   public void success(SonarArray params) {
-    successArray(params);
+    mPeer.success(mGeneration, params);
   }
 
   @Override
   public void success() {
-    successObject(new SonarObject.Builder().build());
+    mPeer.success(mGeneration, new SonarObject.Builder().build());
   }
 
-  public native void successObject(SonarObject response);
+  @Override
+  public void error(SonarObject response) {
+    mPeer.error(mGeneration, response);
+  }
 
-  public native void successArray(SonarArray response);
+  @DoNotStrip
+  static class Peer {
+    private final HybridData mHybridData;
 
-  @Override
-  public native void error(SonarObject response);
+    private Peer(HybridData hd) {
+      mHybridData = hd;
+    }
+
+    // A peer the native pool has no room for is freed as soon as it has responded. Responses are
+    // made under the peer's lock so that none races with that, and later ones are ignored.
+
+    synchronized void success(int generation, SonarObject response) {
+      if (mHybridData.isValid() && successObject(generation, response)) {
+        mHybridData.resetNative();
+      }
+    }
+
+    synchronized void success(int generation, SonarArray response) {
+      if (mHybridData.isValid() && successArray(generation, response)) {
+        mHybridData.resetNative();
+      }
+    }
+
+    synchronized void error(int generation, SonarObject response) {
+      if (mHybridData.isValid() && errorObject(generation, response)) {
+        mHybridData.resetNative();
+      }
+    }
+
+    /** These return whether the peer is done with and can be freed. */
+    private native boolean successObject(int generation, SonarObject response);
+
+    private native boolean successArray(int generation, SonarArray response);
+
+    private native boolean errorObject(int generation, SonarObject response);
+  }
 }
@@ -19,6 +19,8 @@ public class SonarDiagnosticActivity extends Activity implements SonarStateUpdat
   private TextView summaryView;
   private TextView logView;
   private ScrollView scrollView;
+  private StateSummary lastSummary;
+  private String lastSummaryText;
 
   @Override
   protected void onCreate(Bundle savedInstanceState) {
@@ -43,7 +45,7 @@ public class SonarDiagnosticActivity extends Activity implements SonarStateUpdat
     client.subscribeForUpdates(this);
 
     summaryView.setText(getSummary());
-    logView.setText(client.getState());
+    logView.setText(client.getState() + "\n" + client.getNativeCallStats());
   }
 
   protected void onResume() {
@@ -53,7 +55,8 @@ public class SonarDiagnosticActivity extends Activity implements SonarStateUpdat
 
 @Override
   public void onUpdate() {
-    final String state = AndroidSonarClient.getInstance(this).getState();
+    final SonarClient client = AndroidSonarClient.getInstance(this);
+    final String state = client.getState() + "\n" + client.getNativeCallStats();
     final String summary = getSummary();
 
    runOnUiThread(new Runnable() {
@@ -66,9 +69,13 @@ public class SonarDiagnosticActivity extends Activity implements SonarStateUpdat
     });
   }
 
-  private String getSummary() {
+  private synchronized String getSummary() {
     final Context context = this;
-    final StateSummary summary = AndroidSonarClient.getInstance(context).getStateSummary();
+    final StateSummary summary =
+        AndroidSonarClient.getInstance(context).getStateSummary(lastSummary);
+    if (summary == lastSummary && lastSummaryText != null) {
+      return lastSummaryText;
+    }
     final StringBuilder stateText = new StringBuilder();
     for (StateElement e: summary.mList) {
       final String status;
@@ -80,7 +87,9 @@ public class SonarDiagnosticActivity extends Activity implements SonarStateUpdat
       }
       stateText.append(status).append(e.getName()).append("\n");
     }
-    return stateText.toString();
+    lastSummary = summary;
+    lastSummaryText = stateText.toString();
+    return lastSummaryText;
   }
 
   protected void onStop() {
@@ -7,9 +7,17 @@
  */
 package com.facebook.sonar.core;
 
+import javax.annotation.Nullable;
+
 public interface SonarClient {
   void addPlugin(SonarPlugin plugin);
 
+  /**
+   * Adds a plugin that is only built once the desktop opens it, or once it is asked for with {@link
+   * #getPlugin(String)}, leaving its setup out of app startup.
+   */
+  void addPluginFactory(String id, SonarPluginFactory factory);
+
   <T extends SonarPlugin> T getPlugin(String id);
 
   void removePlugin(SonarPlugin plugin);
@@ -25,4 +33,13 @@ public interface SonarClient {
   String getState();
 
   StateSummary getStateSummary();
+
+  /**
+   * Like {@link #getStateSummary()}, but returns previous itself if the summary hasn't changed
+   * since it was read, so pollers don't pay for rebuilding an identical summary.
+   */
+  StateSummary getStateSummary(@Nullable StateSummary previous);
+
+  /** How often and for how long the native bridge called into Java, per call site. */
+  String getNativeCallStats();
 }
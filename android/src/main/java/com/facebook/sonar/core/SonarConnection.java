@@ -7,6 +7,8 @@
  */
 package com.facebook.sonar.core;
 
+import java.nio.ByteBuffer;
+
 /**
  * A connection between a SonarPlugin and the desktop Sonar application. Register request handlers
  * to respond to calls made by the desktop application or directly send messages to the desktop
@@ -26,6 +28,35 @@ public interface SonarConnection {
    */
   void send(String method, SonarArray params);
 
+  /**
+   * Call a remote method on the Sonar desktop application, passing a parameter that is already
+   * serialized as UTF-8 encoded JSON. The bytes between the buffer's position and limit are sent
+   * without being copied or parsed, which makes this the cheapest way to send large payloads such
+   * as network bodies. The buffer must not be modified afterwards. Direct buffers avoid a copy.
+   */
+  void sendBytes(String method, ByteBuffer params);
+
+  /**
+   * Limit how often events of the given method are sent. Events beyond maxPerSecond, or outside
+   * the sampled fraction sampleRate, are dropped before they are serialized. 0 and 1 don't limit.
+   * The desktop can override the limit while it is connected.
+   */
+  void setSendLimit(String method, double maxPerSecond, double sampleRate);
+
+  /**
+   * Whether the desktop wants events of the given method. Desktops that don't declare which
+   * methods they want get all of them. Events the desktop doesn't want are dropped anyway, plugins
+   * can ask first to skip building their params.
+   */
+  boolean isSubscribed(String method);
+
+  /**
+   * Same as send, but params are only built if the event would be sent to a connected desktop.
+   * The builder is called later on a Sonar thread, not the calling thread, so it must only read
+   * state that is safe to read from there.
+   */
+  void sendLazy(String method, SonarParamsBuilder builder);
+
   /** Report client error */
   void reportError(Throwable throwable);
 
@@ -8,15 +8,37 @@
 package com.facebook.sonar.core;
 
 import java.util.Arrays;
+import javax.annotation.Nullable;
 import org.json.JSONArray;
 import org.json.JSONException;
 import org.json.JSONObject;
 
 public class SonarObject {
-  final JSONObject mJson;
+  /**
+   * Supplies the fields of an object that hasn't been converted to a JSONObject, such as the
+   * params of a call from the desktop that are still held natively.
+   */
+  public interface Source {
+    /**
+     * The value of a field, in the form JSONObject holds it (JSONObject.NULL for nulls), or null if
+     * there is no such field.
+     */
+    @Nullable
+    Object get(String name);
+
+    /** The whole object, for operations that need all of it. */
+    JSONObject materialize();
+  }
+
+  // Null until all fields are needed, if the object has a source.
+  private @Nullable JSONObject mJson;
+  private final @Nullable Source mSource;
+  // The fields read from mSource so far.
+  private @Nullable JSONObject mFetched;
 
   public SonarObject(JSONObject json) {
     mJson = (json != null ? json : new JSONObject());
+    mSource = null;
   }
 
   public SonarObject(String json) {
@@ -25,51 +47,86 @@ public class SonarObject {
     } catch (JSONException e) {
       throw new RuntimeException(e);
     }
+    mSource = null;
+  }
+
+  /** An object whose fields are only fetched from source when they are read. */
+  public SonarObject(Source source) {
+    mSource = source;
+    mFetched = new JSONObject();
+  }
+
+  /** All of this object's fields. */
+  synchronized JSONObject json() {
+    if (mJson == null) {
+      mJson = mSource.materialize();
+      mFetched = null;
+    }
+    return mJson;
+  }
+
+  /** A JSONObject holding field name, if this object has it. */
+  private synchronized JSONObject fields(String name) {
+    if (mJson != null) {
+      return mJson;
+    }
+    if (!mFetched.has(name)) {
+      final Object value = mSource.get(name);
+      if (value != null) {
+        try {
+          mFetched.put(name, value);
+        } catch (JSONException e) {
+          throw new RuntimeException(e);
+        }
+      }
+    }
+    return mFetched;
   }
 
   public SonarDynamic getDynamic(String name) {
-    return new SonarDynamic(mJson.opt(name));
+    return new SonarDynamic(fields(name).opt(name));
   }
 
   public String getString(String name) {
-    if (mJson.isNull(name)) {
+    final JSONObject json = fields(name);
+    if (json.isNull(name)) {
       return null;
     }
-    return mJson.optString(name);
+    return json.optString(name);
   }
 
   public int getInt(String name) {
-    return mJson.optInt(name);
+    return fields(name).optInt(name);
   }
 
   public long getLong(String name) {
-    return mJson.optLong(name);
+    return fields(name).optLong(name);
   }
 
   public float getFloat(String name) {
-    return (float) mJson.optDouble(name);
+    return (float) fields(name).optDouble(name);
   }
 
   public double getDouble(String name) {
-    return mJson.optDouble(name);
+    return fields(name).optDouble(name);
   }
 
   public boolean getBoolean(String name) {
-    return mJson.optBoolean(name);
+    return fields(name).optBoolean(name);
   }
 
   public SonarObject getObject(String name) {
-    final Object o = mJson.opt(name);
+    final Object o = fields(name).opt(name);
     return new SonarObject((JSONObject) o);
   }
 
   public SonarArray getArray(String name) {
-    final Object o = mJson.opt(name);
+    final Object o = fields(name).opt(name);
     return new SonarArray((JSONArray) o);
   }
 
   public boolean contains(String name) {
-    return mJson.has(name);
+    return fields(name).has(name);
   }
 
   public String toJsonString() {
@@ -78,17 +135,17 @@ public class SonarObject {
 
   @Override
   public String toString() {
-    return mJson.toString();
+    return json().toString();
   }
 
   @Override
   public boolean equals(Object o) {
-    return mJson.toString().equals(o.toString());
+    return json().toString().equals(o.toString());
   }
 
   @Override
   public int hashCode() {
-    return mJson.hashCode();
+    return json().hashCode();
   }
 
   public static class Builder {
@@ -203,7 +260,7 @@ public class SonarObject {
 
     public Builder put(String name, SonarObject o) {
       try {
-        mJson.put(name, o == null ? null : o.mJson);
+        mJson.put(name, o == null ? null : o.json());
       } catch (JSONException e) {
         throw new RuntimeException(e);
       }
@@ -214,6 +271,16 @@ public class SonarObject {
       return put(name, b.build());
     }
 
+    /** Puts an explicit null, putting null values leaves the field out. */
+    public Builder putNull(String name) {
+      try {
+        mJson.put(name, JSONObject.NULL);
+      } catch (JSONException e) {
+        throw new RuntimeException(e);
+      }
+      return this;
+    }
+
     public SonarObject build() {
       return new SonarObject(mJson);
     }
@@ -0,0 +1,15 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.core;
+
+/** Builds the params of an event passed to SonarConnection.sendLazy, only once it is sent. */
+public interface SonarParamsBuilder {
+
+  /** Called on a Sonar thread rather than the thread that sent the event. */
+  SonarObject build();
+}
@@ -0,0 +1,19 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.core;
+
+/**
+ * Builds a plugin once it is needed, see {@link SonarClient#addPluginFactory(String,
+ * SonarPluginFactory)}. Called at most once, on a Sonar plugin thread or the thread calling {@link
+ * SonarClient#getPlugin(String)}.
+ */
+public interface SonarPluginFactory {
+
+  /** @return The plugin, whose id must be the one the factory was added with. */
+  SonarPlugin create();
+}
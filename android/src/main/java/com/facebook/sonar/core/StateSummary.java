@@ -25,6 +25,35 @@ public class StateSummary {
   }
 
   public final List<StateElement> mList = new ArrayList<>();
+  private final long mVersion;
+
+  public StateSummary() {
+    mVersion = -1;
+  }
+
+  /**
+   * Built by the native client in one call. names holds the element names separated by newlines,
+   * states the ordinal of each element's state.
+   */
+  StateSummary(long version, String names, byte[] states) {
+    mVersion = version;
+    if (states.length == 0) {
+      return;
+    }
+    final String[] splitNames = names.split("\n", -1);
+    final State[] values = State.values();
+    for (int i = 0; i < states.length; i++) {
+      final int state = states[i];
+      mList.add(
+          new StateElement(
+              splitNames[i], state >= 0 && state < values.length ? values[state] : State.UNKNOWN));
+    }
+  }
+
+  /** Identifies this summary's contents, -1 for summaries not built by the native client. */
+  public long getVersion() {
+    return mVersion;
+  }
 
   public void addEntry(String name, String state) {
     State s;
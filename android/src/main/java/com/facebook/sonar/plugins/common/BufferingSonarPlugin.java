@@ -7,6 +7,7 @@
  */
 package com.facebook.sonar.plugins.common;
 
+import com.facebook.sonar.android.SonarEventBuffer;
 import com.facebook.sonar.core.SonarConnection;
 import com.facebook.sonar.core.SonarObject;
 import com.facebook.sonar.core.SonarPlugin;
@@ -17,12 +18,15 @@ import javax.annotation.Nullable;
  *
  * <p>In order to send data to the {@link SonarConnection}, use {@link #send(String, SonarObject)}
  * instead of {@link SonarConnection#send(String, SonarObject)}.
+ *
+ * <p>Buffered events are kept serialized in native memory, up to {@link #BUFFER_BYTES} bytes, and
+ * the oldest ones are dropped first.
  */
 public abstract class BufferingSonarPlugin implements SonarPlugin {
 
-  private static final int BUFFER_SIZE = 500;
+  private static final int BUFFER_BYTES = 1024 * 1024;
 
-  private @Nullable RingBuffer<CachedSonarEvent> mEventQueue;
+  private @Nullable SonarEventBuffer mEventQueue;
   private @Nullable SonarConnection mConnection;
 
   @Override
@@ -47,31 +51,18 @@ public abstract class BufferingSonarPlugin implements SonarPlugin {
 
   public synchronized void send(String method, SonarObject sonarObject) {
     if (mEventQueue == null) {
-      mEventQueue = new RingBuffer<>(BUFFER_SIZE);
+      mEventQueue = new SonarEventBuffer(BUFFER_BYTES);
     }
     if (mConnection != null) {
       mConnection.send(method, sonarObject);
     } else {
-      mEventQueue.enqueue(new CachedSonarEvent(method, sonarObject));
+      mEventQueue.append(method, sonarObject);
     }
   }
 
   private synchronized void sendBufferedEvents() {
     if (mEventQueue != null && mConnection != null) {
-      for (CachedSonarEvent cachedSonarEvent : mEventQueue.asList()) {
-        mConnection.send(cachedSonarEvent.method, cachedSonarEvent.sonarObject);
-      }
-      mEventQueue.clear();
-    }
-  }
-
-  private static class CachedSonarEvent {
-    final String method;
-    final SonarObject sonarObject;
-
-    private CachedSonarEvent(String method, SonarObject sonarObject) {
-      this.method = method;
-      this.sonarObject = sonarObject;
+      mEventQueue.sendTo(mConnection);
     }
   }
 }
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+package com.facebook.sonar.plugins.common;
+
+import android.os.Handler;
+import android.os.Looper;
+import android.os.SystemClock;
+import java.util.ArrayDeque;
+
+/**
+ * Runs calls from the desktop on the main thread in batches, one batch per Handler message, instead
+ * of as a message each. A batch stops once it has taken FRAME_BUDGET_MS, what is left over runs in
+ * a message posted behind whatever else is waiting, such as the next frame, so that a burst of
+ * calls doesn't hold up rendering. Batches don't wait for frames, which aren't produced while
+ * nothing on screen changes. Calls run in the order they were added.
+ */
+final class MainThreadCallQueue {
+  // About half of a frame at 60 fps, leaving the rest for the app.
+  static final long FRAME_BUDGET_MS = 8;
+
+  private static final MainThreadCallQueue sInstance =
+      new MainThreadCallQueue(Looper.getMainLooper(), FRAME_BUDGET_MS);
+
+  private final Handler mHandler;
+  private final long mBudgetMs;
+  private final ArrayDeque<Runnable> mPending = new ArrayDeque<>();
+  private boolean mScheduled;
+
+  private final Runnable mRunBatch =
+      new Runnable() {
+        @Override
+        public void run() {
+          runBatch();
+        }
+      };
+
+  MainThreadCallQueue(Looper looper, long budgetMs) {
+    mHandler = new Handler(looper);
+    mBudgetMs = budgetMs;
+  }
+
+  static MainThreadCallQueue get() {
+    return sInstance;
+  }
+
+  void add(Runnable call) {
+    final boolean onLooper = Looper.myLooper() == mHandler.getLooper();
+    synchronized (this) {
+      // Nothing to batch with.
+      if (onLooper && !mScheduled && mPending.isEmpty()) {
+        call.run();
+        return;
+      }
+      mPending.add(call);
+      if (mScheduled) {
+        return;
+      }
+      mScheduled = true;
+    }
+    mHandler.post(mRunBatch);
+  }
+
+  private void runBatch() {
+    final long deadline = SystemClock.uptimeMillis() + mBudgetMs;
+    while (true) {
+      final Runnable call;
+      synchronized (this) {
+        call = mPending.poll();
+        if (call == null) {
+          mScheduled = false;
+          return;
+        }
+      }
+      call.run();
+      if (SystemClock.uptimeMillis() >= deadline) {
+        break;
+      }
+    }
+    synchronized (this) {
+      if (mPending.isEmpty()) {
+        mScheduled = false;
+        return;
+      }
+    }
+    mHandler.post(mRunBatch);
+  }
+}
@@ -7,8 +7,6 @@
  */
 package com.facebook.sonar.plugins.common;
 
-import android.os.Handler;
-import android.os.Looper;
 import com.facebook.sonar.core.ErrorReportingRunnable;
 import com.facebook.sonar.core.SonarConnection;
 import com.facebook.sonar.core.SonarObject;
@@ -22,17 +20,21 @@ public abstract class MainThreadSonarReceiver implements SonarReceiver {
   }
 
   private final SonarConnection mConnection;
-  private final Handler mHandler = new Handler(Looper.getMainLooper());
 
+  /**
+   * Calls are run on the main thread in batches with those of other receivers, each within a time
+   * budget. Calls left over run in the next batch.
+   */
   @Override
   public final void onReceive(final SonarObject params, final SonarResponder responder) {
-    mHandler.post(
-        new ErrorReportingRunnable(mConnection) {
-          @Override
-          public void runOrThrow() throws Exception {
-            onReceiveOnMainThread(params, responder);
-          }
-        });
+    MainThreadCallQueue.get()
+        .add(
+            new ErrorReportingRunnable(mConnection) {
+              @Override
+              public void runOrThrow() throws Exception {
+                onReceiveOnMainThread(params, responder);
+              }
+            });
   }
 
   public abstract void onReceiveOnMainThread(SonarObject params, SonarResponder responder)
@@ -10,6 +10,7 @@ package com.facebook.sonar.plugins.console;
 import com.facebook.sonar.plugins.console.iface.ScriptingEnvironment;
 import java.util.HashMap;
 import java.util.Map;
+import java.util.concurrent.Executor;
 import org.mozilla.javascript.Context;
 import org.mozilla.javascript.ContextFactory;
 
@@ -17,8 +18,14 @@ public class JavascriptEnvironment implements ScriptingEnvironment {
 
   private final Map<String, Object> mBoundVariables;
   private final ContextFactory mContextFactory;
+  private final Executor mEvaluateExecutor;
 
   public JavascriptEnvironment() {
+    this(JavascriptSession.sEvaluateExecutor);
+  }
+
+  JavascriptEnvironment(Executor evaluateExecutor) {
+    mEvaluateExecutor = evaluateExecutor;
     mBoundVariables = new HashMap<>();
     mContextFactory =
         new ContextFactory() {
@@ -31,7 +38,7 @@ public class JavascriptEnvironment implements ScriptingEnvironment {
 
   @Override
   public JavascriptSession startSession() {
-    return new JavascriptSession(mContextFactory, mBoundVariables);
+    return new JavascriptSession(mContextFactory, mBoundVariables, mEvaluateExecutor);
   }
 
   /**
@@ -9,8 +9,12 @@ package com.facebook.sonar.plugins.console;
 
 import com.facebook.sonar.plugins.console.iface.ScriptingSession;
 import java.io.Closeable;
+import java.util.LinkedHashMap;
 import java.util.Map;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Executors;
 import java.util.concurrent.atomic.AtomicInteger;
+import javax.annotation.Nullable;
 import org.json.JSONException;
 import org.json.JSONObject;
 import org.json.JSONTokener;
@@ -20,6 +24,7 @@ import org.mozilla.javascript.Function;
 import org.mozilla.javascript.NativeJSON;
 import org.mozilla.javascript.NativeJavaMethod;
 import org.mozilla.javascript.NativeJavaObject;
+import org.mozilla.javascript.Script;
 import org.mozilla.javascript.Scriptable;
 import org.mozilla.javascript.ScriptableObject;
 import org.mozilla.javascript.Undefined;
@@ -29,13 +34,33 @@ public class JavascriptSession implements Closeable, ScriptingSession {
   private static final String TYPE = "type";
   private static final String VALUE = "value";
   public static final String JSON = "json";
+  // Compiled scripts kept for commands sent again, e.g. from the desktop's history.
+  static final int MAX_CACHED_SCRIPTS = 32;
+  // Sessions are started per connection and never closed, so they share one worker rather than
+  // each having their own.
+  static final Executor sEvaluateExecutor = Executors.newSingleThreadExecutor();
   private final Context mContext;
   private final ContextFactory mContextFactory;
+  private final Executor mEvaluateExecutor;
   private final Scriptable mScope;
   private final AtomicInteger lineNumber = new AtomicInteger(0);
+  // By their source, least recently evaluated first. Guarded by itself.
+  private final Map<String, Script> mScripts =
+      new LinkedHashMap<String, Script>(16, 0.75f, true) {
+        @Override
+        protected boolean removeEldestEntry(Map.Entry<String, Script> eldest) {
+          return size() > MAX_CACHED_SCRIPTS;
+        }
+      };
 
   JavascriptSession(ContextFactory contextFactory, Map<String, Object> globals) {
+    this(contextFactory, globals, sEvaluateExecutor);
+  }
+
+  JavascriptSession(
+      ContextFactory contextFactory, Map<String, Object> globals, Executor evaluateExecutor) {
     mContextFactory = contextFactory;
+    mEvaluateExecutor = evaluateExecutor;
     mContext = contextFactory.enterContext();
 
     // Interpreted mode, or it will produce Dalvik incompatible bytecode.
@@ -69,19 +94,61 @@ public class JavascriptSession implements Closeable, ScriptingSession {
     return evaluateCommand(userScript, scope);
   }
 
+  @Override
+  public void evaluateCommandAsync(
+      final String userScript, final @Nullable Object context, final Callback callback) {
+    mEvaluateExecutor.execute(
+        new Runnable() {
+          @Override
+          public void run() {
+            final JSONObject result;
+            try {
+              result =
+                  context == null
+                      ? evaluateCommand(userScript)
+                      : evaluateCommand(userScript, context);
+            } catch (Exception e) {
+              callback.onError(e);
+              return;
+            }
+            callback.onSuccess(result);
+          }
+        });
+  }
+
   private JSONObject evaluateCommand(String command, Scriptable scope) throws JSONException {
     try {
       // This may be called by any thread, and contexts have to be entered in the current thread
       // before being used, so enter/exit every time.
       mContextFactory.enterContext();
-      return toJson(
-          mContext.evaluateString(
-              scope, command, "sonar-console", lineNumber.incrementAndGet(), null));
+      return toJson(compile(command).exec(mContext, scope));
     } finally {
       Context.exit();
     }
   }
 
+  private Script compile(String command) {
+    synchronized (mScripts) {
+      final Script script = mScripts.get(command);
+      if (script != null) {
+        return script;
+      }
+    }
+    // Compiled scripts don't hold on to a scope, so one can be run in any of them.
+    final Script script =
+        mContext.compileString(command, "sonar-console", lineNumber.incrementAndGet(), null);
+    synchronized (mScripts) {
+      mScripts.put(command, script);
+    }
+    return script;
+  }
+
+  int cachedScriptCount() {
+    synchronized (mScripts) {
+      return mScripts.size();
+    }
+  }
+
   private JSONObject toJson(Object result) throws JSONException {
 
     if (result instanceof String) {
@@ -41,20 +41,28 @@ public class ConsoleCommandReceiver {
     final SonarReceiver executeCommandReceiver =
         new MainThreadSonarReceiver(connection) {
           @Override
-          public void onReceiveOnMainThread(SonarObject params, SonarResponder responder)
+          public void onReceiveOnMainThread(SonarObject params, final SonarResponder responder)
               throws Exception {
             final String command = params.getString("command");
             final String contextObjectId = params.getString("context");
             final Object contextObject = contextProvider.getObjectForId(contextObjectId);
-            try {
-              JSONObject o =
-                  contextObject == null
-                      ? session.evaluateCommand(command)
-                      : session.evaluateCommand(command, contextObject);
-              responder.success(new SonarObject(o));
-            } catch (Exception e) {
-              responder.error(new SonarObject.Builder().put("message", e.getMessage()).build());
-            }
+            // Only the context is looked up on the main thread, the command is evaluated on the
+            // session's worker so heavy scripts don't block it.
+            session.evaluateCommandAsync(
+                command,
+                contextObject,
+                new ScriptingSession.Callback() {
+                  @Override
+                  public void onSuccess(JSONObject result) {
+                    responder.success(new SonarObject(result));
+                  }
+
+                  @Override
+                  public void onError(Exception e) {
+                    responder.error(
+                        new SonarObject.Builder().put("message", e.getMessage()).build());
+                  }
+                });
           }
         };
     final SonarReceiver isEnabledReceiver =
@@ -7,6 +7,7 @@
  */
 package com.facebook.sonar.plugins.console.iface;
 
+import javax.annotation.Nullable;
 import org.json.JSONException;
 import org.json.JSONObject;
 
@@ -32,6 +33,12 @@ public class NullScriptingEnvironment implements ScriptingEnvironment {
       return evaluateCommand(userScript);
     }
 
+    @Override
+    public void evaluateCommandAsync(
+        String userScript, @Nullable Object context, Callback callback) {
+      callback.onError(new UnsupportedOperationException("Console plugin not enabled in this app"));
+    }
+
     @Override
     public void close() {}
   }
@@ -7,14 +7,28 @@
  */
 package com.facebook.sonar.plugins.console.iface;
 
+import javax.annotation.Nullable;
 import org.json.JSONException;
 import org.json.JSONObject;
 
 public interface ScriptingSession {
 
+  /** Called on the thread the command was evaluated on. */
+  interface Callback {
+    void onSuccess(JSONObject result);
+
+    void onError(Exception e);
+  }
+
   JSONObject evaluateCommand(String userScript) throws JSONException;
 
   JSONObject evaluateCommand(String userScript, Object context) throws JSONException;
 
+  /**
+   * Evaluates the command on a worker of the session's rather than the calling thread, so that heavy
+   * scripts don't block it. Commands are evaluated in the order they were passed in.
+   */
+  void evaluateCommandAsync(String userScript, @Nullable Object context, Callback callback);
+
   void close();
 }
@@ -31,14 +31,18 @@ import com.facebook.sonar.plugins.inspector.descriptors.ViewGroupDescriptor;
 import com.facebook.sonar.plugins.inspector.descriptors.WindowDescriptor;
 import java.util.HashMap;
 import java.util.Map;
+import javax.annotation.Nullable;
 
 /**
  * A mapping from classes to the object use to describe instances of a class. When looking for a
  * descriptor to describe an object this classs will traverse the object's class hierarchy until it
- * finds a matching descriptor instance.
+ * finds a matching descriptor instance. What a class resolves to is remembered, so the hierarchy is
+ * only traversed once per class until another descriptor is registered.
  */
 public class DescriptorMapping {
   private Map<Class<?>, NodeDescriptor<?>> mMapping = new HashMap<>();
+  // What each class looked up resolved to, including through its superclasses.
+  private final Map<Class<?>, NodeDescriptor<?>> mResolved = new HashMap<>();
 
   /**
    * @return A DescriptorMapping initialized with default descriptors for java and Android classes.
@@ -65,25 +69,39 @@ public class DescriptorMapping {
   /** Register a descriptor for a given class. */
   public <T> void register(Class<T> clazz, NodeDescriptor<T> descriptor) {
     mMapping.put(clazz, descriptor);
+    mResolved.clear();
   }
 
   NodeDescriptor<?> descriptorForClass(Class<?> clazz) {
-    while (!mMapping.containsKey(clazz)) {
-      clazz = clazz.getSuperclass();
+    NodeDescriptor<?> descriptor = mResolved.get(clazz);
+    if (descriptor != null) {
+      return descriptor;
     }
-    return mMapping.get(clazz);
+    Class<?> registered = clazz;
+    while (!mMapping.containsKey(registered)) {
+      registered = registered.getSuperclass();
+    }
+    descriptor = mMapping.get(registered);
+    mResolved.put(clazz, descriptor);
+    return descriptor;
   }
 
   void onConnect(SonarConnection connection) {
+    onConnect(connection, null);
+  }
+
+  void onConnect(SonarConnection connection, @Nullable NodeDescriptor.Invalidator invalidator) {
     for (NodeDescriptor descriptor : mMapping.values()) {
       descriptor.setConnection(connection);
       descriptor.setDescriptorMapping(this);
+      descriptor.setInvalidator(invalidator);
     }
   }
 
   void onDisconnect() {
     for (NodeDescriptor descriptor : mMapping.values()) {
       descriptor.setConnection(null);
+      descriptor.setInvalidator(null);
     }
   }
 }
@@ -0,0 +1,164 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+package com.facebook.sonar.plugins.inspector;
+
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import javax.annotation.Nullable;
+
+/**
+ * Remembers where hit tests ended up, so that taps where an earlier one landed don't walk the
+ * descriptors again. A hit test ends up at the same path for every point that each of its bounds
+ * checks answers the same for, so each path is kept with those checks, in the coordinates of the
+ * root, and filed in a grid under the cells its hit bounds overlap. Finding a path then only looks
+ * at the paths of one cell. Paths are only valid until the layout changes, the index has to be
+ * cleared then. Safe to use from any thread.
+ */
+final class HitTestIndex {
+  static final int CELL_SIZE = 64;
+  // Past this many paths the index starts over, rather than track which are still useful.
+  static final int MAX_PATHS = 256;
+
+  private static final class Check {
+    final int left;
+    final int top;
+    final int right;
+    final int bottom;
+    final boolean contained;
+
+    Check(int left, int top, int right, int bottom, boolean contained) {
+      this.left = left;
+      this.top = top;
+      this.right = right;
+      this.bottom = bottom;
+      this.contained = contained;
+    }
+
+    boolean matches(int x, int y) {
+      return (x >= left && x <= right && y >= top && y <= bottom) == contained;
+    }
+  }
+
+  private static final class Entry {
+    final List<Check> checks;
+    final List<String> path;
+
+    Entry(List<Check> checks, List<String> path) {
+      this.checks = checks;
+      this.path = path;
+    }
+
+    boolean matches(int x, int y) {
+      for (Check check : checks) {
+        if (!check.matches(x, y)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  /** The bounds checks of one hit test, in the order they were made. */
+  final class Recording {
+    private final List<Check> mChecks = new ArrayList<>();
+    private final int mGeneration;
+
+    private Recording(int generation) {
+      mGeneration = generation;
+    }
+
+    void check(int left, int top, int right, int bottom, boolean contained) {
+      mChecks.add(new Check(left, top, right, bottom, contained));
+    }
+
+    /** The hit test ended up at path, file it unless the index was cleared in the meantime. */
+    void finish(List<String> path) {
+      add(this, path);
+    }
+  }
+
+  private final Map<Long, List<Entry>> mCells = new HashMap<>();
+  private int mPaths;
+  private int mGeneration;
+
+  synchronized Recording record() {
+    return new Recording(mGeneration);
+  }
+
+  /** The path of an earlier hit test that the point would end up at too, if any. */
+  synchronized @Nullable List<String> find(int x, int y) {
+    final List<Entry> entries = mCells.get(cell(x / CELL_SIZE, y / CELL_SIZE));
+    if (entries == null) {
+      return null;
+    }
+    for (Entry entry : entries) {
+      if (entry.matches(x, y)) {
+        return entry.path;
+      }
+    }
+    return null;
+  }
+
+  synchronized void clear() {
+    mCells.clear();
+    mPaths = 0;
+    mGeneration++;
+  }
+
+  private synchronized void add(Recording recording, List<String> path) {
+    if (recording.mGeneration != mGeneration) {
+      return;
+    }
+    // The points it holds for are within every bounds that contained the touch.
+    int left = Integer.MIN_VALUE;
+    int top = Integer.MIN_VALUE;
+    int right = Integer.MAX_VALUE;
+    int bottom = Integer.MAX_VALUE;
+    for (Check check : recording.mChecks) {
+      if (check.contained) {
+        left = Math.max(left, check.left);
+        top = Math.max(top, check.top);
+        right = Math.min(right, check.right);
+        bottom = Math.min(bottom, check.bottom);
+      }
+    }
+    // Unbounded, e.g. nothing was hit at all: not worth filing everywhere.
+    if (left == Integer.MIN_VALUE
+        || top == Integer.MIN_VALUE
+        || right == Integer.MAX_VALUE
+        || bottom == Integer.MAX_VALUE
+        || left > right
+        || top > bottom) {
+      return;
+    }
+    if (mPaths >= MAX_PATHS) {
+      mCells.clear();
+      mPaths = 0;
+    }
+    final Entry entry = new Entry(recording.mChecks, new ArrayList<>(path));
+    for (int cellX = Math.max(left, 0) / CELL_SIZE; cellX <= right / CELL_SIZE; cellX++) {
+      for (int cellY = Math.max(top, 0) / CELL_SIZE; cellY <= bottom / CELL_SIZE; cellY++) {
+        final long key = cell(cellX, cellY);
+        List<Entry> entries = mCells.get(key);
+        if (entries == null) {
+          entries = new ArrayList<>();
+          mCells.put(key, entries);
+        }
+        entries.add(entry);
+      }
+    }
+    mPaths++;
+  }
+
+  private static long cell(int cellX, int cellY) {
+    return ((long) cellX << 32) | (cellY & 0xffffffffL);
+  }
+}
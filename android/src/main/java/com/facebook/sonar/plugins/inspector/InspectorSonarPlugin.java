@@ -10,11 +10,15 @@ package com.facebook.sonar.plugins.inspector;
 
 import android.app.Application;
 import android.content.Context;
+import android.os.Handler;
+import android.os.Looper;
+import android.os.MessageQueue;
 import android.support.v4.view.ViewCompat;
 import android.view.accessibility.AccessibilityEvent;
 import android.view.MotionEvent;
 import android.view.View;
 import android.view.ViewGroup;
+import android.view.ViewTreeObserver;
 import com.facebook.sonar.core.ErrorReportingRunnable;
 import com.facebook.sonar.core.SonarArray;
 import com.facebook.sonar.core.SonarConnection;
@@ -30,12 +34,25 @@ import com.facebook.sonar.plugins.console.iface.ScriptingEnvironment;
 import com.facebook.sonar.plugins.inspector.descriptors.ApplicationDescriptor;
 import com.facebook.sonar.plugins.inspector.descriptors.utils.AccessibilityUtil;
 
+import java.util.ArrayDeque;
 import java.util.ArrayList;
+import java.util.HashMap;
 import java.util.List;
+import java.util.Map;
+import java.util.concurrent.Callable;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Executors;
 import javax.annotation.Nullable;
 
 public class InspectorSonarPlugin implements SonarPlugin {
 
+  // Nodes list at most this many children, Sonar asks for more with getChildren as it needs them.
+  static final int CHILD_PAGE_SIZE = 200;
+  // getSubtree describes at most this many nodes, Sonar fetches the rest as usual.
+  static final int SUBTREE_MAX_NODES = 1000;
+  // Prefetching sends at most this many nodes each time the main thread goes idle.
+  static final int PREFETCH_NODES_PER_IDLE = 50;
+
   private ApplicationWrapper mApplication;
   private DescriptorMapping mDescriptorMapping;
   private ObjectTracker mObjectTracker;
@@ -44,6 +61,88 @@ public class InspectorSonarPlugin implements SonarPlugin {
   private TouchOverlayView mTouchOverlay;
   private SonarConnection mConnection;
   private @Nullable List<ExtensionCommand> mExtensionCommands;
+  // What each node was last sent to Sonar as, to send invalidations as diffs.
+  private final Map<String, NodeSummary> mNodeSummaries = new HashMap<>();
+  // Where taps landed, until the layout changes.
+  private final HitTestIndex mHitTests = new HitTestIndex();
+  private final HitTestIndex mAXHitTests = new HitTestIndex();
+  // Set by Sonar with setPrefetch. Main thread only, like the queue.
+  private boolean mPrefetch;
+  private boolean mPrefetchScheduled;
+  private final ArrayDeque<Prefetch> mPrefetchQueue = new ArrayDeque<>();
+  // Runs the work returned by NodeDescriptor#captureData for getNodes.
+  private static final Executor sDescribeExecutor = Executors.newSingleThreadExecutor();
+  private final Executor mDescribeExecutor;
+  private final Handler mMainHandler = new Handler(Looper.getMainLooper());
+  // Counts invalidations, to tell whether nodes described off the main thread changed meanwhile.
+  private int mInvalidationCount;
+
+  /**
+   * A node described on the main thread, except for the data its descriptor captured to describe on
+   * a background thread.
+   */
+  private static final class PendingNode {
+    final Object obj;
+    final String id;
+    String name;
+    String decoration;
+    List<String> children;
+    int childCount;
+    boolean paged;
+    SonarArray attributes;
+    SonarObject extraInfo;
+    @Nullable List<Named<SonarObject>> data;
+    @Nullable Callable<List<Named<SonarObject>>> capturedData;
+
+    PendingNode(Object obj, String id) {
+      this.obj = obj;
+      this.id = id;
+    }
+  }
+
+  /** A node fetched by Sonar, whose children are sent from next on while the app is idle. */
+  private static final class Prefetch {
+    final String id;
+    int next;
+
+    Prefetch(String id) {
+      this.id = id;
+    }
+  }
+
+  private final MessageQueue.IdleHandler mPrefetchIdle =
+      new MessageQueue.IdleHandler() {
+        @Override
+        public boolean queueIdle() {
+          new ErrorReportingRunnable(mConnection) {
+            @Override
+            protected void runOrThrow() throws Exception {
+              prefetch();
+            }
+          }.run();
+          // Kept until the queue is empty.
+          mPrefetchScheduled = !mPrefetchQueue.isEmpty();
+          return mPrefetchScheduled;
+        }
+      };
+
+  private final NodeDescriptor.Invalidator mInvalidator =
+      new NodeDescriptor.Invalidator() {
+        @Override
+        public void invalidate(Object node) throws Exception {
+          InspectorSonarPlugin.this.invalidate(node);
+        }
+      };
+
+  // Package visible for testing
+  final InvalidationBatcher mInvalidations =
+      new InvalidationBatcher(
+          new InvalidationBatcher.Flush() {
+            @Override
+            public void flush(List<Object> nodes) {
+              sendInvalidations(nodes);
+            }
+          });
 
   /** An interface for extensions to the Inspector Sonar plugin */
   public interface ExtensionCommand {
@@ -104,7 +203,18 @@ public class InspectorSonarPlugin implements SonarPlugin {
       DescriptorMapping descriptorMapping,
       ScriptingEnvironment scriptingEnvironment,
       @Nullable List<ExtensionCommand> extensions) {
+    this(wrapper, descriptorMapping, scriptingEnvironment, extensions, sDescribeExecutor);
+  }
+
+  // Package visible for testing
+  InspectorSonarPlugin(
+      ApplicationWrapper wrapper,
+      DescriptorMapping descriptorMapping,
+      ScriptingEnvironment scriptingEnvironment,
+      @Nullable List<ExtensionCommand> extensions,
+      Executor describeExecutor) {
     mDescriptorMapping = descriptorMapping;
+    mDescribeExecutor = describeExecutor;
 
     mObjectTracker = new ObjectTracker();
     mApplication = wrapper;
@@ -120,7 +230,8 @@ public class InspectorSonarPlugin implements SonarPlugin {
   @Override
   public void onConnect(SonarConnection connection) throws Exception {
     mConnection = connection;
-    mDescriptorMapping.onConnect(connection);
+    mNodeSummaries.clear();
+    mDescriptorMapping.onConnect(connection, mInvalidator);
 
     ConsoleCommandReceiver.listenForCommands(
         connection,
@@ -134,6 +245,9 @@ public class InspectorSonarPlugin implements SonarPlugin {
         });
     connection.receive("getRoot", mGetRoot);
     connection.receive("getNodes", mGetNodes);
+    connection.receive("getChildren", mGetChildren);
+    connection.receive("getSubtree", mGetSubtree);
+    connection.receive("setPrefetch", mSetPrefetch);
     connection.receive("setData", mSetData);
     connection.receive("setHighlighted", mSetHighlighted);
     connection.receive("setSearchActive", mSetSearchActive);
@@ -162,6 +276,11 @@ public class InspectorSonarPlugin implements SonarPlugin {
     ApplicationDescriptor.clearEditedDelegates();
 
     mObjectTracker.clear();
+    mNodeSummaries.clear();
+    mInvalidations.clear();
+    mPrefetch = false;
+    mPrefetchQueue.clear();
+    clearHitTests();
     mDescriptorMapping.onDisconnect();
     mConnection = null;
   }
@@ -185,19 +304,26 @@ public class InspectorSonarPlugin implements SonarPlugin {
         }
       };
 
+  /**
+   * Nodes whose descriptors capture their data, see NodeDescriptor#captureData, have it described
+   * on a background thread. They are sent from the main thread once it is, in order with any
+   * invalidations.
+   */
   final SonarReceiver mGetNodes =
       new MainThreadSonarReceiver(mConnection) {
         @Override
         public void onReceiveOnMainThread(final SonarObject params, final SonarResponder responder)
             throws Exception {
           final SonarArray ids = params.getArray("ids");
-          final SonarArray.Builder result = new SonarArray.Builder();
+          final List<PendingNode> nodes = new ArrayList<>();
+          boolean captured = false;
 
           for (int i = 0, count = ids.length(); i < count; i++) {
             final String id = ids.getString(i);
-            final SonarObject node = getNode(id);
+            final PendingNode node = describeNode(id, CHILD_PAGE_SIZE, true);
             if (node != null) {
-              result.put(node);
+              nodes.add(node);
+              captured |= node.capturedData != null;
             } else {
               responder.error(
                   new SonarObject.Builder()
@@ -208,7 +334,170 @@ public class InspectorSonarPlugin implements SonarPlugin {
             }
           }
 
-          responder.success(new SonarObject.Builder().put("elements", result).build());
+          if (!captured) {
+            sendNodes(ids, nodes, responder, true);
+            return;
+          }
+          final SonarConnection connection = mConnection;
+          final int invalidationCount = mInvalidationCount;
+          mDescribeExecutor.execute(
+              new Runnable() {
+                @Override
+                public void run() {
+                  for (PendingNode node : nodes) {
+                    describeCapturedData(connection, node);
+                  }
+                  runOnMainThread(
+                      new ErrorReportingRunnable(connection) {
+                        @Override
+                        protected void runOrThrow() throws Exception {
+                          sendNodes(
+                              ids, nodes, responder, mInvalidationCount == invalidationCount);
+                        }
+                      });
+                }
+              });
+        }
+      };
+
+  /**
+   * Answers getNodes. Nodes described from what may have been invalidated since aren't summarized
+   * but invalidated again, so that Sonar fetches them anew once it has them.
+   */
+  private void sendNodes(
+      SonarArray ids, List<PendingNode> nodes, SonarResponder responder, boolean current)
+      throws Exception {
+    final SonarArray.Builder result = new SonarArray.Builder();
+    for (PendingNode node : nodes) {
+      result.put(finishNode(node, current));
+      if (!current && mConnection != null) {
+        mInvalidations.add(node.id, node.obj);
+      }
+    }
+
+    responder.success(new SonarObject.Builder().put("elements", result).build());
+    if (mPrefetch) {
+      for (int i = 0, count = ids.length(); i < count; i++) {
+        mPrefetchQueue.add(new Prefetch(ids.getString(i)));
+      }
+      schedulePrefetch();
+    }
+  }
+
+  private void runOnMainThread(Runnable runnable) {
+    if (Looper.myLooper() == Looper.getMainLooper()) {
+      runnable.run();
+    } else {
+      mMainHandler.post(runnable);
+    }
+  }
+
+  /**
+   * Describes a node and its descendants down to depth levels below it, breadth first, in one
+   * response rather than a getNodes per level. Only the first page of each node's children is
+   * described, and at most SUBTREE_MAX_NODES nodes, "complete" tells whether that was all of them.
+   */
+  final SonarReceiver mGetSubtree =
+      new MainThreadSonarReceiver(mConnection) {
+        @Override
+        public void onReceiveOnMainThread(final SonarObject params, final SonarResponder responder)
+            throws Exception {
+          final String id = params.getString("id");
+          final int depth = params.getInt("depth");
+
+          final SonarObject root = getNode(id);
+          if (root == null) {
+            responder.error(
+                new SonarObject.Builder()
+                    .put("message", "No node with given id")
+                    .put("id", id)
+                    .build());
+            return;
+          }
+
+          final SonarArray.Builder elements = new SonarArray.Builder().put(root);
+          List<SonarObject> level = new ArrayList<>();
+          level.add(root);
+          int described = 1;
+          boolean complete = true;
+          for (int d = 0; d < depth && !level.isEmpty() && complete; d++) {
+            final List<SonarObject> next = new ArrayList<>();
+            for (SonarObject node : level) {
+              final SonarArray children = node.getArray("children");
+              for (int i = 0, count = children.length(); i < count; i++) {
+                if (described == SUBTREE_MAX_NODES) {
+                  complete = false;
+                  break;
+                }
+                final SonarObject child = getNode(children.getString(i));
+                if (child != null) {
+                  elements.put(child);
+                  next.add(child);
+                  described++;
+                }
+              }
+            }
+            level = next;
+          }
+
+          responder.success(
+              new SonarObject.Builder()
+                  .put("id", id)
+                  .put("elements", elements)
+                  .put("complete", complete)
+                  .build());
+        }
+      };
+
+  /**
+   * While enabled, the children of nodes fetched with getNodes are sent unasked as "prefetched"
+   * whenever the main thread goes idle, so they are there once Sonar expands those nodes.
+   */
+  final SonarReceiver mSetPrefetch =
+      new MainThreadSonarReceiver(mConnection) {
+        @Override
+        public void onReceiveOnMainThread(final SonarObject params, final SonarResponder responder)
+            throws Exception {
+          mPrefetch = params.getBoolean("enabled");
+          if (!mPrefetch) {
+            mPrefetchQueue.clear();
+          }
+          responder.success(null);
+        }
+      };
+
+  /** Lists the children of a node past those its element lists, tracking only those. */
+  final SonarReceiver mGetChildren =
+      new MainThreadSonarReceiver(mConnection) {
+        @Override
+        public void onReceiveOnMainThread(final SonarObject params, final SonarResponder responder)
+            throws Exception {
+          final String id = params.getString("id");
+          final int offset = params.getInt("offset");
+          final int count = params.getInt("count");
+
+          final Object obj = mObjectTracker.get(id);
+          final NodeDescriptor<Object> descriptor = obj == null ? null : descriptorForObject(obj);
+          if (descriptor == null) {
+            responder.error(
+                new SonarObject.Builder()
+                    .put("message", "No node with given id")
+                    .put("id", id)
+                    .build());
+            return;
+          }
+
+          final SonarArray.Builder childIds = new SonarArray.Builder();
+          for (String child : getChildren(obj, descriptor, offset, count)) {
+            childIds.put(child);
+          }
+          responder.success(
+              new SonarObject.Builder()
+                  .put("id", id)
+                  .put("offset", offset)
+                  .put("childCount", getChildCount(obj, descriptor))
+                  .put("children", childIds)
+                  .build());
         }
       };
 
@@ -381,12 +670,103 @@ public class InspectorSonarPlugin implements SonarPlugin {
         }
       };
 
+  private void schedulePrefetch() {
+    if (!mPrefetchScheduled && !mPrefetchQueue.isEmpty()) {
+      mPrefetchScheduled = true;
+      Looper.myQueue().addIdleHandler(mPrefetchIdle);
+    }
+  }
+
+  /**
+   * Sends up to PREFETCH_NODES_PER_IDLE children of queued nodes that Sonar doesn't have yet, as far
+   * as their first page. Package visible for testing.
+   */
+  void prefetch() throws Exception {
+    if (mConnection == null) {
+      mPrefetchQueue.clear();
+      return;
+    }
+    final SonarArray.Builder elements = new SonarArray.Builder();
+    int sent = 0;
+    while (!mPrefetchQueue.isEmpty() && sent < PREFETCH_NODES_PER_IDLE) {
+      final Prefetch prefetch = mPrefetchQueue.peek();
+      final Object obj = mObjectTracker.get(prefetch.id);
+      final NodeDescriptor<Object> descriptor = obj == null ? null : descriptorForObject(obj);
+      if (descriptor == null) {
+        mPrefetchQueue.poll();
+        continue;
+      }
+      final List<String> children =
+          getChildren(obj, descriptor, prefetch.next, CHILD_PAGE_SIZE - prefetch.next);
+      boolean done = true;
+      for (String child : children) {
+        if (sent == PREFETCH_NODES_PER_IDLE) {
+          done = false;
+          break;
+        }
+        prefetch.next++;
+        if (mNodeSummaries.containsKey(child)) {
+          // Fetched already, and invalidated if it changes.
+          continue;
+        }
+        final SonarObject node = getNode(child);
+        if (node != null) {
+          elements.put(node);
+          sent++;
+        }
+      }
+      if (done) {
+        mPrefetchQueue.poll();
+      }
+    }
+    if (sent > 0) {
+      mConnection.send("prefetched", new SonarObject.Builder().put("elements", elements).build());
+    }
+  }
+
+  private void clearHitTests() {
+    mHitTests.clear();
+    mAXHitTests.clear();
+  }
+
   class TouchOverlayView extends View implements HiddenNode {
+    // Views move without being invalidated, e.g. when scrolled.
+    private final ViewTreeObserver.OnGlobalLayoutListener mLayoutListener =
+        new ViewTreeObserver.OnGlobalLayoutListener() {
+          @Override
+          public void onGlobalLayout() {
+            clearHitTests();
+          }
+        };
+    private final ViewTreeObserver.OnScrollChangedListener mScrollListener =
+        new ViewTreeObserver.OnScrollChangedListener() {
+          @Override
+          public void onScrollChanged() {
+            clearHitTests();
+          }
+        };
+
     public TouchOverlayView(Context context) {
       super(context);
       setBackgroundColor(BoundsDrawable.COLOR_HIGHLIGHT_CONTENT);
     }
 
+    @Override
+    protected void onAttachedToWindow() {
+      super.onAttachedToWindow();
+      clearHitTests();
+      getViewTreeObserver().addOnGlobalLayoutListener(mLayoutListener);
+      getViewTreeObserver().addOnScrollChangedListener(mScrollListener);
+    }
+
+    @Override
+    protected void onDetachedFromWindow() {
+      // Removed from the window's observer, as this view's own may have been merged into it.
+      getViewTreeObserver().removeGlobalOnLayoutListener(mLayoutListener);
+      getViewTreeObserver().removeOnScrollChangedListener(mScrollListener);
+      super.onDetachedFromWindow();
+    }
+
     @Override
     public boolean onHoverEvent(MotionEvent event) {
 
@@ -433,9 +813,14 @@ public class InspectorSonarPlugin implements SonarPlugin {
     }
   }
 
-  private Touch createTouch(final int touchX, final int touchY, final boolean ax) throws Exception {
-    final SonarArray.Builder path = new SonarArray.Builder();
-    path.put(trackObject(mApplication));
+  private Touch createTouch(
+      final int touchX,
+      final int touchY,
+      final boolean ax,
+      final HitTestIndex.Recording recording)
+      throws Exception {
+    final List<String> path = new ArrayList<>();
+    path.add(trackObject(mApplication));
 
     return new Touch() {
       int x = touchX;
@@ -445,7 +830,8 @@ public class InspectorSonarPlugin implements SonarPlugin {
 
       @Override
       public void finish() {
-        mConnection.send(ax ? "selectAX" : "select", new SonarObject.Builder().put("path", path).build());
+        recording.finish(path);
+        sendSelect(path, ax);
       }
 
       @Override
@@ -465,7 +851,7 @@ public class InspectorSonarPlugin implements SonarPlugin {
               node = assertNotNull(descriptorForObject(node).getChildAt(node, childIndex));
             }
 
-            path.put(trackObject(node));
+            path.add(trackObject(node));
             final NodeDescriptor<Object> descriptor = descriptorForObject(node);
 
             if (ax) {
@@ -479,15 +865,56 @@ public class InspectorSonarPlugin implements SonarPlugin {
 
       @Override
       public boolean containedIn(int l, int t, int r, int b) {
-        return x >= l && x <= r && y >= t && y <= b;
+        final boolean contained = x >= l && x <= r && y >= t && y <= b;
+        // In the root's coordinates, like the touch.
+        final int offsetX = touchX - x;
+        final int offsetY = touchY - y;
+        recording.check(l + offsetX, t + offsetY, r + offsetX, b + offsetY, contained);
+        return contained;
       }
     };
   }
 
   void hitTest(final int touchX, final int touchY) throws Exception {
+    hitTest(touchX, touchY, false);
+    hitTest(touchX, touchY, true);
+  }
+
+  /**
+   * Taps where an earlier one landed are answered from the index, as long as the nodes of its path
+   * are still tracked. Descriptors are only walked for the others.
+   */
+  private void hitTest(final int touchX, final int touchY, final boolean ax) throws Exception {
+    final HitTestIndex index = ax ? mAXHitTests : mHitTests;
+    final List<String> known = index.find(touchX, touchY);
+    if (known != null && isTracked(known)) {
+      sendSelect(known, ax);
+      return;
+    }
     final NodeDescriptor<Object> descriptor = descriptorForObject(mApplication);
-    descriptor.hitTest(mApplication, createTouch(touchX, touchY, false));
-    descriptor.axHitTest(mApplication, createTouch(touchX, touchY, true));
+    final Touch touch = createTouch(touchX, touchY, ax, index.record());
+    if (ax) {
+      descriptor.axHitTest(mApplication, touch);
+    } else {
+      descriptor.hitTest(mApplication, touch);
+    }
+  }
+
+  private boolean isTracked(List<String> path) {
+    for (String id : path) {
+      if (mObjectTracker.get(id) == null) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  private void sendSelect(List<String> path, boolean ax) {
+    final SonarArray.Builder ids = new SonarArray.Builder();
+    for (String id : path) {
+      ids.put(id);
+    }
+    mConnection.send(ax ? "selectAX" : "select", new SonarObject.Builder().put("path", ids).build());
   }
 
   private void setHighlighted(final String id, final boolean highlighted, final boolean isAlignmentMode) throws Exception {
@@ -527,13 +954,32 @@ public class InspectorSonarPlugin implements SonarPlugin {
 
     if (isMatch || childTrees != null) {
       final String id = trackObject(obj);
-      SonarObject node = getNode(id);
+      // Every child, matches can be past the first page.
+      SonarObject node = getNode(id, Integer.MAX_VALUE);
       return new SearchResultNode(id, isMatch, node, childTrees, axEnabled && hasAXNode(node) ? getAXNode(id) : null);
     }
     return null;
   }
 
   private @Nullable SonarObject getNode(String id) throws Exception {
+    return getNode(id, CHILD_PAGE_SIZE);
+  }
+
+  /**
+   * Lists at most maxChildren children, along with how many there are if that is more. Sonar pages
+   * in the others, so its copy of such a node isn't diffed against but fetched again.
+   */
+  private @Nullable SonarObject getNode(String id, int maxChildren) throws Exception {
+    final PendingNode node = describeNode(id, maxChildren, false);
+    return node == null ? null : finishNode(node, true);
+  }
+
+  /**
+   * Describes a node on the main thread. With capture, its data may be left to describe later, see
+   * NodeDescriptor#captureData.
+   */
+  private @Nullable PendingNode describeNode(String id, int maxChildren, boolean capture)
+      throws Exception {
     final Object obj = mObjectTracker.get(id);
     if (obj == null) {
       return null;
@@ -544,27 +990,131 @@ public class InspectorSonarPlugin implements SonarPlugin {
       return null;
     }
 
-    final SonarArray.Builder children = new SonarArray.Builder();
+    final PendingNode node = new PendingNode(obj, descriptor.getId(obj));
+    node.childCount = getChildCount(obj, descriptor);
+    node.paged = node.childCount > maxChildren;
+    node.children = getChildren(obj, descriptor, 0, maxChildren);
+    if (capture) {
+      node.capturedData = captureData(obj, descriptor);
+    }
+    if (node.capturedData == null) {
+      node.data = getData(obj, descriptor);
+    }
+    node.attributes = getAttributes(obj, descriptor);
+    node.name = descriptor.getName(obj);
+    node.decoration = descriptor.getDecoration(obj);
+    node.extraInfo = descriptor.getExtraInfo(obj);
+    return node;
+  }
+
+  /** Runs on a background thread. Data that fails to be described is left empty. */
+  private static void describeCapturedData(SonarConnection connection, final PendingNode node) {
+    final List<Named<SonarObject>> data = new ArrayList<>();
+    new ErrorReportingRunnable(connection) {
+      @Override
+      protected void runOrThrow() throws Exception {
+        data.addAll(node.capturedData.call());
+      }
+    }.run();
+    node.data = data;
+  }
+
+  /**
+   * Builds what is sent for a described node, on the main thread. Sonar's copy is only summarized,
+   * to diff invalidations against, if it is current.
+   */
+  private SonarObject finishNode(PendingNode node, boolean current) {
+    if (node.paged || !current) {
+      mNodeSummaries.remove(node.id);
+    } else {
+      mNodeSummaries.put(
+          node.id,
+          new NodeSummary(
+              node.name,
+              node.decoration,
+              node.children,
+              node.attributes,
+              node.data,
+              node.extraInfo));
+    }
+
+    final SonarArray.Builder childIds = new SonarArray.Builder();
+    for (String child : node.children) {
+      childIds.put(child);
+    }
+    final SonarObject.Builder dataSections = new SonarObject.Builder();
+    for (Named<SonarObject> props : node.data) {
+      dataSections.put(props.getName(), props.getValue());
+    }
+
+    final SonarObject.Builder result =
+        new SonarObject.Builder()
+            .put("id", node.id)
+            .put("name", node.name)
+            .put("data", dataSections)
+            .put("children", childIds)
+            .put("attributes", node.attributes)
+            .put("decoration", node.decoration)
+            .put("extraInfo", node.extraInfo);
+    if (node.paged) {
+      result.put("childCount", node.childCount);
+    }
+    return result.build();
+  }
+
+  private int getChildCount(final Object obj, final NodeDescriptor<Object> descriptor) {
+    final int[] count = new int[1];
     new ErrorReportingRunnable(mConnection) {
       @Override
       protected void runOrThrow() throws Exception {
-        for (int i = 0, count = descriptor.getChildCount(obj); i < count; i++) {
+        count[0] = descriptor.getChildCount(obj);
+      }
+    }.run();
+    return count[0];
+  }
+
+  /** Tracks and lists at most count children from offset on, the others aren't asked for. */
+  private List<String> getChildren(
+      final Object obj, final NodeDescriptor<Object> descriptor, final int offset, final int count) {
+    final List<String> children = new ArrayList<>();
+    new ErrorReportingRunnable(mConnection) {
+      @Override
+      protected void runOrThrow() throws Exception {
+        final int end = (int) Math.min((long) offset + count, descriptor.getChildCount(obj));
+        for (int i = offset; i < end; i++) {
           final Object child = assertNotNull(descriptor.getChildAt(obj, i));
-          children.put(trackObject(child));
+          children.add(trackObject(child));
         }
       }
     }.run();
+    return children;
+  }
 
-    final SonarObject.Builder data = new SonarObject.Builder();
+  private List<Named<SonarObject>> getData(
+      final Object obj, final NodeDescriptor<Object> descriptor) {
+    final List<Named<SonarObject>> data = new ArrayList<>();
     new ErrorReportingRunnable(mConnection) {
       @Override
       protected void runOrThrow() throws Exception {
-        for (Named<SonarObject> props : descriptor.getData(obj)) {
-          data.put(props.getName(), props.getValue());
-        }
+        data.addAll(descriptor.getData(obj));
       }
     }.run();
+    return data;
+  }
 
+  private @Nullable Callable<List<Named<SonarObject>>> captureData(
+      final Object obj, final NodeDescriptor<Object> descriptor) {
+    final List<Callable<List<Named<SonarObject>>>> captured = new ArrayList<>(1);
+    new ErrorReportingRunnable(mConnection) {
+      @Override
+      protected void runOrThrow() throws Exception {
+        captured.add(descriptor.captureData(obj));
+      }
+    }.run();
+    return captured.isEmpty() ? null : captured.get(0);
+  }
+
+  private SonarArray getAttributes(final Object obj, final NodeDescriptor<Object> descriptor) {
     final SonarArray.Builder attributes = new SonarArray.Builder();
     new ErrorReportingRunnable(mConnection) {
       @Override
@@ -578,16 +1128,87 @@ public class InspectorSonarPlugin implements SonarPlugin {
         }
       }
     }.run();
+    return attributes.build();
+  }
 
-    return new SonarObject.Builder()
-        .put("id", descriptor.getId(obj))
-        .put("name", descriptor.getName(obj))
-        .put("data", data)
-        .put("children", children)
-        .put("attributes", attributes)
-        .put("decoration", descriptor.getDecoration(obj))
-        .put("extraInfo", descriptor.getExtraInfo(obj))
-        .build();
+  /**
+   * Invalidations are sent once per frame, or less often while nodes keep changing, with every node
+   * invalidated since the last one, see InvalidationBatcher.
+   */
+  private void invalidate(Object obj) throws Exception {
+    if (mConnection == null) {
+      return;
+    }
+    clearHitTests();
+    mInvalidationCount++;
+    mInvalidations.add(descriptorForObject(obj).getId(obj), obj);
+  }
+
+  private void sendInvalidations(List<Object> nodes) {
+    if (mConnection == null) {
+      return;
+    }
+    final SonarArray.Builder invalidated = new SonarArray.Builder();
+    int count = 0;
+    for (final Object obj : nodes) {
+      final SonarObject[] node = new SonarObject[1];
+      new ErrorReportingRunnable(mConnection) {
+        @Override
+        protected void runOrThrow() throws Exception {
+          node[0] = describeInvalidation(obj);
+        }
+      }.run();
+      if (node[0] != null) {
+        invalidated.put(node[0]);
+        count++;
+      }
+    }
+    if (count > 0) {
+      mConnection.send("invalidate", new SonarObject.Builder().put("nodes", invalidated).build());
+    }
+  }
+
+  /**
+   * Nodes Sonar has been sent before are invalidated with the changes since then, and not at all if
+   * nothing changed. Sonar fetches other nodes again. Runs on the main thread, which the summaries
+   * are confined to.
+   */
+  private @Nullable SonarObject describeInvalidation(Object obj) throws Exception {
+    final NodeDescriptor<Object> descriptor = descriptorForObject(obj);
+    final String id = descriptor.getId(obj);
+    final SonarObject.Builder node = new SonarObject.Builder().put("id", id);
+
+    final NodeSummary previous = mNodeSummaries.get(id);
+    if (previous != null
+        && mObjectTracker.get(id) == obj
+        && getChildCount(obj, descriptor) > CHILD_PAGE_SIZE) {
+      // Grown past a page, Sonar has to fetch it again to page in the rest.
+      mNodeSummaries.remove(id);
+    } else if (previous != null && mObjectTracker.get(id) == obj) {
+      final List<String> children = getChildren(obj, descriptor, 0, CHILD_PAGE_SIZE);
+      final List<Named<SonarObject>> data = getData(obj, descriptor);
+      final SonarArray attributes = getAttributes(obj, descriptor);
+      final NodeSummary next =
+          new NodeSummary(
+              descriptor.getName(obj),
+              descriptor.getDecoration(obj),
+              children,
+              attributes,
+              data,
+              descriptor.getExtraInfo(obj));
+      if (previous.canDiffTo(next)) {
+        final SonarObject changes = previous.changesTo(next, attributes, data);
+        if (changes == null) {
+          return null;
+        }
+        mNodeSummaries.put(id, next);
+        node.put("changes", changes);
+      } else {
+        mNodeSummaries.remove(id);
+      }
+    }
+
+    return node.build();
   }
 
   private @Nullable SonarObject getAXNode(String id) throws Exception {
@@ -656,6 +1277,9 @@ public class InspectorSonarPlugin implements SonarPlugin {
     final String id = descriptor.getId(obj);
     final Object curr = mObjectTracker.get(id);
     if (obj != curr) {
+      for (String released : mObjectTracker.expungeReleased()) {
+        mNodeSummaries.remove(released);
+      }
       mObjectTracker.put(id, obj);
       descriptor.init(obj);
     }
@@ -0,0 +1,150 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+package com.facebook.sonar.plugins.inspector;
+
+import android.annotation.TargetApi;
+import android.os.Build;
+import android.os.Handler;
+import android.os.Looper;
+import android.os.SystemClock;
+import android.view.Choreographer;
+import java.util.ArrayList;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Map;
+import javax.annotation.Nullable;
+
+/**
+ * Coalesces the inspector's invalidations into one batch per frame, holding each node once however
+ * often it was invalidated. While nodes keep being invalidated frame after frame, e.g. during an
+ * animation, batches are flushed less and less often, down to one every MAX_INTERVAL_MS. Once a
+ * frame goes by with nothing to flush, they are flushed at every frame again. Nodes can be added
+ * from any thread, batches are flushed on the main thread.
+ */
+final class InvalidationBatcher {
+  interface Flush {
+    /** The nodes invalidated since the last batch, in the order they were first invalidated. */
+    void flush(List<Object> nodes);
+  }
+
+  static final long FRAME_MS = 16;
+  static final long MAX_INTERVAL_MS = 250;
+
+  private final Flush mFlush;
+  private final Handler mHandler = new Handler(Looper.getMainLooper());
+  // Guarded by this.
+  private final Map<String, Object> mPending = new LinkedHashMap<>();
+  private boolean mScheduled;
+  // Main thread only.
+  private long mIntervalMs;
+  private long mLastFlushMs = -MAX_INTERVAL_MS;
+
+  private final Runnable mSchedule =
+      new Runnable() {
+        @Override
+        public void run() {
+          scheduleFrame();
+        }
+      };
+
+  private final Runnable mOnFrame =
+      new Runnable() {
+        @Override
+        public void run() {
+          onFrame();
+        }
+      };
+
+  // A Choreographer.FrameCallback, which doesn't exist before Jelly Bean.
+  private @Nullable Object mFrameCallback;
+
+  InvalidationBatcher(Flush flush) {
+    mFlush = flush;
+  }
+
+  void add(String id, Object node) {
+    synchronized (this) {
+      // The latest object wins, as it is the one the id now stands for.
+      mPending.put(id, node);
+      if (mScheduled) {
+        return;
+      }
+      mScheduled = true;
+    }
+    if (Looper.myLooper() == Looper.getMainLooper()) {
+      scheduleFrame();
+    } else {
+      mHandler.post(mSchedule);
+    }
+  }
+
+  /** Flush what is pending right away. Main thread only. */
+  void flush() {
+    final List<Object> nodes;
+    synchronized (this) {
+      nodes = new ArrayList<>(mPending.values());
+      mPending.clear();
+    }
+    if (!nodes.isEmpty()) {
+      mFlush.flush(nodes);
+    }
+  }
+
+  /** Drop what is pending, e.g. when the desktop disconnects. */
+  synchronized void clear() {
+    mPending.clear();
+  }
+
+  private void onFrame() {
+    final long now = SystemClock.uptimeMillis();
+    synchronized (this) {
+      if (mPending.isEmpty()) {
+        mScheduled = false;
+        return;
+      }
+    }
+    final long sinceLastFlush = now - mLastFlushMs;
+    if (sinceLastFlush < mIntervalMs) {
+      scheduleFrame();
+      return;
+    }
+    // Flushed in the last frame or so of the interval too: still busy, wait longer next time.
+    if (sinceLastFlush <= mIntervalMs + 2 * FRAME_MS) {
+      mIntervalMs = Math.min(Math.max(mIntervalMs * 2, FRAME_MS), MAX_INTERVAL_MS);
+    } else {
+      mIntervalMs = 0;
+    }
+    mLastFlushMs = now;
+    flush();
+    // A frame later, so that one without anything to flush stops the callbacks.
+    scheduleFrame();
+  }
+
+  private void scheduleFrame() {
+    if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.JELLY_BEAN) {
+      postFrameCallback();
+    } else {
+      mHandler.postDelayed(mOnFrame, FRAME_MS);
+    }
+  }
+
+  @TargetApi(Build.VERSION_CODES.JELLY_BEAN)
+  private void postFrameCallback() {
+    if (mFrameCallback == null) {
+      mFrameCallback =
+          new Choreographer.FrameCallback() {
+            @Override
+            public void doFrame(long frameTimeNanos) {
+              onFrame();
+            }
+          };
+    }
+    Choreographer.getInstance().postFrameCallback((Choreographer.FrameCallback) mFrameCallback);
+  }
+}
@@ -14,6 +14,7 @@ import com.facebook.sonar.core.SonarDynamic;
 import com.facebook.sonar.core.SonarObject;
 import java.util.Collections;
 import java.util.List;
+import java.util.concurrent.Callable;
 import javax.annotation.Nullable;
 
 /**
@@ -24,11 +25,21 @@ import javax.annotation.Nullable;
 public abstract class NodeDescriptor<T> {
   protected SonarConnection mConnection;
   private DescriptorMapping mDescriptorMapping;
+  private @Nullable Invalidator mInvalidator;
+
+  /** Sends invalidations in place of the descriptor, for instance as diffs of what changed. */
+  interface Invalidator {
+    void invalidate(Object node) throws Exception;
+  }
 
   void setConnection(SonarConnection connection) {
     mConnection = connection;
   }
 
+  void setInvalidator(@Nullable Invalidator invalidator) {
+    mInvalidator = invalidator;
+  }
+
   void setDescriptorMapping(DescriptorMapping descriptorMapping) {
     mDescriptorMapping = descriptorMapping;
   }
@@ -52,6 +63,10 @@ public abstract class NodeDescriptor<T> {
       new ErrorReportingRunnable() {
         @Override
         protected void runOrThrow() throws Exception {
+          if (mInvalidator != null) {
+            mInvalidator.invalidate(node);
+            return;
+          }
           SonarArray array =
               new SonarArray.Builder()
                   .put(new SonarObject.Builder().put("id", getId(node)).build())
@@ -139,6 +154,16 @@ public abstract class NodeDescriptor<T> {
    */
   public abstract List<Named<SonarObject>> getData(T node) throws Exception;
 
+  /**
+   * For nodes that don't change once built, such as the components of a committed Litho layout:
+   * takes what describing the node needs, quickly and on the main thread, and returns the work of
+   * turning it into what {@link #getData(Object)} would return, which the inspector may then run
+   * on a background thread. The default of null has getData called on the main thread instead.
+   */
+  public @Nullable Callable<List<Named<SonarObject>>> captureData(T node) throws Exception {
+    return null;
+  }
+
   /** Gets data for AX tree */
   public List<Named<SonarObject>> getAXData(T node) throws Exception {
     return Collections.EMPTY_LIST;
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+package com.facebook.sonar.plugins.inspector;
+
+import com.facebook.sonar.core.SonarArray;
+import com.facebook.sonar.core.SonarObject;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import javax.annotation.Nullable;
+
+/**
+ * What was last sent to Sonar about a node, kept small: attributes, data sections and extra info
+ * are only remembered as hashes. Used to send invalidations as the changes since then instead of
+ * having Sonar fetch the whole node again.
+ */
+class NodeSummary {
+  private final @Nullable String mName;
+  private final @Nullable String mDecoration;
+  private final List<String> mChildren;
+  private final int mAttributesHash;
+  private final Map<String, Integer> mDataHashes;
+  private final int mExtraInfoHash;
+
+  NodeSummary(
+      @Nullable String name,
+      @Nullable String decoration,
+      List<String> children,
+      SonarArray attributes,
+      List<Named<SonarObject>> data,
+      @Nullable SonarObject extraInfo) {
+    mName = name;
+    mDecoration = decoration;
+    mChildren = children;
+    mAttributesHash = attributes.toJsonString().hashCode();
+    mDataHashes = new HashMap<>();
+    for (Named<SonarObject> section : data) {
+      mDataHashes.put(section.getName(), hash(section.getValue()));
+    }
+    mExtraInfoHash = hash(extraInfo);
+  }
+
+  /** Sonar can't be told about changed extra info, the node has to be fetched again. */
+  boolean canDiffTo(NodeSummary next) {
+    return mExtraInfoHash == next.mExtraInfoHash;
+  }
+
+  /**
+   * @return The fields of next that differ from this summary, in the shape the desktop applies to
+   *     the node it has, or null if nothing changed. Removed data sections are null, children are
+   *     described as a single splice.
+   */
+  @Nullable
+  SonarObject changesTo(NodeSummary next, SonarArray attributes, List<Named<SonarObject>> data) {
+    final SonarObject.Builder changes = new SonarObject.Builder();
+    boolean changed = false;
+
+    if (next.mName != null && !next.mName.equals(mName)) {
+      changes.put("name", next.mName);
+      changed = true;
+    }
+    if (next.mDecoration != null && !next.mDecoration.equals(mDecoration)) {
+      changes.put("decoration", next.mDecoration);
+      changed = true;
+    }
+    if (mAttributesHash != next.mAttributesHash) {
+      changes.put("attributes", attributes);
+      changed = true;
+    }
+
+    final SonarObject.Builder dataChanges = new SonarObject.Builder();
+    boolean dataChanged = false;
+    for (Named<SonarObject> section : data) {
+      final Integer previous = mDataHashes.get(section.getName());
+      if (previous == null || !previous.equals(next.mDataHashes.get(section.getName()))) {
+        dataChanges.put(section.getName(), section.getValue());
+        dataChanged = true;
+      }
+    }
+    for (String section : mDataHashes.keySet()) {
+      if (!next.mDataHashes.containsKey(section)) {
+        dataChanges.putNull(section);
+        dataChanged = true;
+      }
+    }
+    if (dataChanged) {
+      changes.put("data", dataChanges);
+      changed = true;
+    }
+
+    final List<String> before = mChildren;
+    final List<String> after = next.mChildren;
+    int start = 0;
+    while (start < before.size()
+        && start < after.size()
+        && before.get(start).equals(after.get(start))) {
+      start++;
+    }
+    int end = 0;
+    while (end < before.size() - start
+        && end < after.size() - start
+        && before.get(before.size() - 1 - end).equals(after.get(after.size() - 1 - end))) {
+      end++;
+    }
+    if (start + end < before.size() || start + end < after.size()) {
+      final SonarArray.Builder items = new SonarArray.Builder();
+      for (String child : after.subList(start, after.size() - end)) {
+        items.put(child);
+      }
+      changes.put(
+          "childrenSplice",
+          new SonarObject.Builder()
+              .put("start", start)
+              .put("deleteCount", before.size() - start - end)
+              .put("items", items));
+      changed = true;
+    }
+
+    return changed ? changes.build() : null;
+  }
+
+  private static int hash(@Nullable SonarObject object) {
+    return object == null ? 0 : object.toJsonString().hashCode();
+  }
+}
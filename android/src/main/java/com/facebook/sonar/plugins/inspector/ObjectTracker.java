@@ -8,18 +8,37 @@
 
 package com.facebook.sonar.plugins.inspector;
 
+import java.lang.ref.ReferenceQueue;
 import java.lang.ref.WeakReference;
+import java.util.ArrayList;
+import java.util.Collections;
 import java.util.HashMap;
+import java.util.List;
 import java.util.Map;
 import javax.annotation.Nullable;
 
+/**
+ * Maps the ids sent to Sonar to the objects they describe. Objects are held weakly, and the entries
+ * of objects that have been garbage collected are removed as the tracker is used, so it doesn't
+ * grow with every view visited over a long session.
+ */
 public class ObjectTracker {
   ObjectTracker() {}
 
-  private final Map<String, WeakReference<Object>> mObjects = new HashMap<>();
+  private static class TrackedReference extends WeakReference<Object> {
+    final String id;
+
+    TrackedReference(String id, Object obj, ReferenceQueue<Object> queue) {
+      super(obj, queue);
+      this.id = id;
+    }
+  }
+
+  private final Map<String, TrackedReference> mObjects = new HashMap<>();
+  private final ReferenceQueue<Object> mReleased = new ReferenceQueue<>();
 
   void put(String id, Object obj) {
-    mObjects.put(id, new WeakReference<>(obj));
+    mObjects.put(id, new TrackedReference(id, obj, mReleased));
   }
 
   @Nullable
@@ -37,8 +56,31 @@ public class ObjectTracker {
     return obj;
   }
 
+  /**
+   * Removes the entries of objects that have been garbage collected since the last call.
+   *
+   * @return The ids of the removed entries.
+   */
+  List<String> expungeReleased() {
+    List<String> released = null;
+    TrackedReference ref;
+    while ((ref = (TrackedReference) mReleased.poll()) != null) {
+      final TrackedReference current = mObjects.get(ref.id);
+      // The id may have been given to another object since.
+      if (current == ref || current == null) {
+        mObjects.remove(ref.id);
+        if (released == null) {
+          released = new ArrayList<>();
+        }
+        released.add(ref.id);
+      }
+    }
+    return released == null ? Collections.<String>emptyList() : released;
+  }
+
   void clear() {
     mObjects.clear();
+    while (mReleased.poll() != null) {}
   }
 
   boolean contains(String id) {
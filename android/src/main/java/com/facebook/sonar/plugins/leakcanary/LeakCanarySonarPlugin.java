@@ -8,29 +8,61 @@
 
 package com.facebook.sonar.plugins.leakcanary;
 
-import android.util.Log;
 import com.facebook.sonar.core.SonarConnection;
 import com.facebook.sonar.core.SonarObject;
 import com.facebook.sonar.core.SonarPlugin;
 import com.facebook.sonar.core.SonarReceiver;
 import com.facebook.sonar.core.SonarResponder;
 import java.util.ArrayList;
+import java.util.HashMap;
 import java.util.List;
-import org.json.JSONArray;
-import org.json.JSONException;
-import org.json.JSONObject;
+import java.util.Map;
+import javax.annotation.Nullable;
 
+/**
+ * Reports leaks as they are found, one small summary each. A leak found again with the same path
+ * to its GC root only bumps the count of the one already reported. The whole trace of a leak,
+ * which can be large, is only sent when the desktop asks for it.
+ */
 public class LeakCanarySonarPlugin implements SonarPlugin {
 
-  private static final String TAG = "LeakCanarySonarPlugin";
-
-  private static final String REPORT_LEAK_EVENT = "reportLeak";
+  private static final String LEAK_EVENT = "leak";
+  private static final String GET_LEAK_METHOD = "getLeak";
   private static final String CLEAR_EVENT = "clear";
-  private static final String LEAKS_KEY = "leaks";
 
-  private SonarConnection mConnection;
+  // Lines of LeakCanary's leak info, see LeakCanary.leakInfo.
+  private static final String LEAK_BEGIN_INDICATOR = "has leaked:";
+  private static final String RETAINED_SIZE_INDICATOR = "* Retaining: ";
 
-  private final List<String> leakList = new ArrayList<>();
+  private static final class Leak {
+    final int id;
+    final String title;
+    final String retainedSize;
+    final String info;
+    int count = 1;
+
+    Leak(int id, String title, String retainedSize, String info) {
+      this.id = id;
+      this.title = title;
+      this.retainedSize = retainedSize;
+      this.info = info;
+    }
+
+    SonarObject summary() {
+      return new SonarObject.Builder()
+          .put("id", id)
+          .put("title", title)
+          .put("retainedSize", retainedSize)
+          .put("count", count)
+          .build();
+    }
+  }
+
+  // Guarded by this.
+  private @Nullable SonarConnection mConnection;
+  private final Map<String, Leak> mLeaksBySignature = new HashMap<>();
+  private final List<Leak> mLeaks = new ArrayList<>();
+  private int mNextId;
 
   @Override
   public String getId() {
@@ -39,38 +71,125 @@ public class LeakCanarySonarPlugin implements SonarPlugin {
 
   @Override
   public void onConnect(SonarConnection connection) {
-    mConnection = connection;
-    sendLeakList();
+    final List<SonarObject> summaries = new ArrayList<>();
+    synchronized (this) {
+      mConnection = connection;
+      for (Leak leak : mLeaks) {
+        summaries.add(leak.summary());
+      }
+    }
+    for (SonarObject summary : summaries) {
+      connection.send(LEAK_EVENT, summary);
+    }
 
-    mConnection.receive(
+    connection.receive(
+        GET_LEAK_METHOD,
+        new SonarReceiver() {
+          @Override
+          public void onReceive(SonarObject params, SonarResponder responder) throws Exception {
+            final Leak leak = getLeak(params.getInt("id"));
+            if (leak == null) {
+              responder.error(new SonarObject.Builder().put("message", "No such leak").build());
+              return;
+            }
+            responder.success(
+                new SonarObject.Builder().put("id", leak.id).put("info", leak.info).build());
+          }
+        });
+    connection.receive(
         CLEAR_EVENT,
         new SonarReceiver() {
           @Override
           public void onReceive(SonarObject params, SonarResponder responder) throws Exception {
-            leakList.clear();
+            clear();
           }
         });
   }
 
   @Override
-  public void onDisconnect() throws Exception {
+  public synchronized void onDisconnect() throws Exception {
     mConnection = null;
   }
 
-  private void sendLeakList() {
-    if (mConnection != null) {
-      JSONObject obj = new JSONObject();
-      try {
-        obj.put(LEAKS_KEY, new JSONArray(leakList));
-        mConnection.send(REPORT_LEAK_EVENT, new SonarObject(obj));
-      } catch (JSONException e) {
-        Log.w(TAG, "Failure to serialize leak list: ", e);
+  public void reportLeak(String leakInfo) {
+    final String signature = signature(leakInfo);
+    if (signature == null) {
+      // Not a leak, e.g. the analysis failed.
+      return;
+    }
+    final SonarConnection connection;
+    final SonarObject summary;
+    synchronized (this) {
+      Leak leak = mLeaksBySignature.get(signature);
+      if (leak != null) {
+        leak.count++;
+      } else {
+        leak = new Leak(mNextId++, title(signature), retainedSize(leakInfo), leakInfo);
+        mLeaksBySignature.put(signature, leak);
+        mLeaks.add(leak);
       }
+      connection = mConnection;
+      summary = leak.summary();
+    }
+    if (connection != null) {
+      connection.send(LEAK_EVENT, summary);
     }
   }
 
-  public void reportLeak(String leakInfo) {
-    leakList.add(leakInfo);
-    sendLeakList();
+  private synchronized @Nullable Leak getLeak(int id) {
+    for (Leak leak : mLeaks) {
+      if (leak.id == id) {
+        return leak;
+      }
+    }
+    return null;
+  }
+
+  private synchronized void clear() {
+    mLeaksBySignature.clear();
+    mLeaks.clear();
+  }
+
+  /**
+   * The path to the leak's GC root, which is the same for every time the same leak is found, or
+   * null if leakInfo isn't a leak.
+   */
+  static @Nullable String signature(String leakInfo) {
+    final String[] lines = leakInfo.split("\n");
+    int i = 0;
+    while (i < lines.length && !lines[i].endsWith(LEAK_BEGIN_INDICATOR)) {
+      i++;
+    }
+    i++;
+    final StringBuilder signature = new StringBuilder();
+    // The path is every line starting with '*' up to the retained size or the details.
+    while (i < lines.length
+        && lines[i].startsWith("*")
+        && !lines[i].startsWith(RETAINED_SIZE_INDICATOR)) {
+      signature.append(lines[i]).append('\n');
+      i++;
+    }
+    return signature.length() == 0 ? null : signature.toString();
+  }
+
+  // The last line of the path, which is the leaked object.
+  private static String title(String signature) {
+    final int end = signature.length() - 1;
+    final int start = signature.lastIndexOf('\n', end - 1) + 1;
+    final String line = signature.substring(start, end);
+    return line.startsWith("* ") ? line.substring(2) : line;
+  }
+
+  private static String retainedSize(String leakInfo) {
+    final int start = leakInfo.indexOf(RETAINED_SIZE_INDICATOR);
+    if (start < 0) {
+      return "unknown size";
+    }
+    final int end = leakInfo.indexOf('\n', start);
+    final String size =
+        leakInfo.substring(
+            start + RETAINED_SIZE_INDICATOR.length(), end < 0 ? leakInfo.length() : end);
+    // It ends with a period.
+    return size.endsWith(".") ? size.substring(0, size.length() - 1) : size;
   }
 }
@@ -0,0 +1,176 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+package com.facebook.litho.sonar;
+
+import com.facebook.litho.ComponentLifecycle;
+import com.facebook.litho.DebugComponent;
+import com.facebook.litho.annotations.Prop;
+import com.facebook.litho.annotations.ResType;
+import com.facebook.litho.annotations.State;
+import java.lang.reflect.Field;
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.Collections;
+import java.util.HashSet;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.Set;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Executors;
+import javax.annotation.Nullable;
+
+/**
+ * The @Prop fields of component classes and the @State fields of state container classes, looked
+ * up by reflection once per class and reused for every component inspected after that.
+ */
+final class ComponentFields {
+
+  static final class PropField {
+    final Field field;
+    final ResType resType;
+    final boolean mutable;
+
+    PropField(Field field, ResType resType) {
+      this.field = field;
+      this.resType = resType;
+      this.mutable = isTypeMutable(field.getType());
+    }
+  }
+
+  static final class StateField {
+    final Field field;
+    final boolean mutable;
+
+    StateField(Field field) {
+      this.field = field;
+      this.mutable = isTypeMutable(field.getType());
+    }
+  }
+
+  private static final Map<Class<?>, List<PropField>> sProps = new ConcurrentHashMap<>();
+  private static final Map<Class<?>, List<StateField>> sState = new ConcurrentHashMap<>();
+  // Declared fields by name, for overrides.
+  private static final Map<Class<?>, Map<String, Field>> sFields = new ConcurrentHashMap<>();
+
+  private static final Executor sPrecomputeExecutor = Executors.newSingleThreadExecutor();
+
+  private ComponentFields() {}
+
+  static List<PropField> props(Class<?> componentClass) {
+    List<PropField> props = sProps.get(componentClass);
+    if (props == null) {
+      props = new ArrayList<>();
+      for (Field f : fields(componentClass).values()) {
+        final Prop annotation = f.getAnnotation(Prop.class);
+        if (annotation != null) {
+          props.add(new PropField(f, annotation.resType()));
+        }
+      }
+      props = Collections.unmodifiableList(props);
+      sProps.put(componentClass, props);
+    }
+    return props;
+  }
+
+  static List<StateField> state(Class<?> stateContainerClass) {
+    List<StateField> state = sState.get(stateContainerClass);
+    if (state == null) {
+      state = new ArrayList<>();
+      for (Field f : fields(stateContainerClass).values()) {
+        if (f.getAnnotation(State.class) != null) {
+          state.add(new StateField(f));
+        }
+      }
+      state = Collections.unmodifiableList(state);
+      sState.put(stateContainerClass, state);
+    }
+    return state;
+  }
+
+  /** @return The accessible field declared by clazz with that name, or null. */
+  @Nullable
+  static Field field(Class<?> clazz, String name) {
+    return fields(clazz).get(name);
+  }
+
+  /**
+   * Looks up the fields of the components below root and of their state containers on a
+   * background thread, so that the first inspection of them doesn't have to. Walks the hierarchy
+   * on the calling thread, which has to be the main thread.
+   */
+  static void precompute(@Nullable DebugComponent root) {
+    if (root == null) {
+      return;
+    }
+    final Set<Class<?>> componentClasses = new HashSet<>();
+    final Set<Class<?>> stateContainerClasses = new HashSet<>();
+    collectClasses(root, componentClasses, stateContainerClasses);
+    sPrecomputeExecutor.execute(
+        new Runnable() {
+          @Override
+          public void run() {
+            for (Class<?> componentClass : componentClasses) {
+              props(componentClass);
+            }
+            for (Class<?> stateContainerClass : stateContainerClasses) {
+              state(stateContainerClass);
+            }
+          }
+        });
+  }
+
+  private static void collectClasses(
+      DebugComponent node,
+      Collection<Class<?>> componentClasses,
+      Collection<Class<?>> stateContainerClasses) {
+    if (!node.canResolve()) {
+      final Class<?> componentClass = node.getComponent().getClass();
+      if (!sProps.containsKey(componentClass)) {
+        componentClasses.add(componentClass);
+      }
+      final ComponentLifecycle.StateContainer stateContainer = node.getStateContainer();
+      if (stateContainer != null && !sState.containsKey(stateContainer.getClass())) {
+        stateContainerClasses.add(stateContainer.getClass());
+      }
+    }
+    for (DebugComponent child : node.getChildComponents()) {
+      collectClasses(child, componentClasses, stateContainerClasses);
+    }
+  }
+
+  private static Map<String, Field> fields(Class<?> clazz) {
+    Map<String, Field> fields = sFields.get(clazz);
+    if (fields == null) {
+      fields = new LinkedHashMap<>();
+      for (Field f : clazz.getDeclaredFields()) {
+        try {
+          f.setAccessible(true);
+          fields.put(f.getName(), f);
+        } catch (SecurityException ignored) {
+        }
+      }
+      fields = Collections.unmodifiableMap(fields);
+      sFields.put(clazz, fields);
+    }
+    return fields;
+  }
+
+  private static boolean isTypeMutable(Class<?> type) {
+    if (type == int.class || type == Integer.class) {
+      return true;
+    } else if (type == long.class || type == Long.class) {
+      return true;
+    } else if (type == float.class || type == Float.class) {
+      return true;
+    } else if (type == double.class || type == Double.class) {
+      return true;
+    } else if (type == boolean.class || type == Boolean.class) {
+      return true;
+    } else if (type.isAssignableFrom(String.class)) {
+      return true;
+    }
+    return false;
+  }
+}
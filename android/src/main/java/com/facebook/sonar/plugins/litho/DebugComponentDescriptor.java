@@ -19,8 +19,6 @@ import com.facebook.litho.ComponentLifecycle;
 import com.facebook.litho.DebugComponent;
 import com.facebook.litho.DebugLayoutNode;
 import com.facebook.litho.LithoView;
-import com.facebook.litho.annotations.Prop;
-import com.facebook.litho.annotations.State;
 import com.facebook.litho.reference.Reference;
 import com.facebook.sonar.core.SonarDynamic;
 import com.facebook.sonar.core.SonarObject;
@@ -45,6 +43,7 @@ import java.util.Arrays;
 import java.util.HashMap;
 import java.util.List;
 import java.util.Map;
+import java.util.concurrent.Callable;
 import javax.annotation.Nullable;
 
 public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
@@ -158,29 +157,58 @@ public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
       return componentDescriptor.getData(node.getComponent());
     }
 
-    final List<Named<SonarObject>> data = new ArrayList<>();
+    return captureData(node).call();
+  }
 
-    final SonarObject layoutData = getLayoutData(node);
-    if (layoutData != null) {
-      data.add(new Named<>("Layout", layoutData));
+  /**
+   * The committed layout a DebugComponent belongs to doesn't change, changing a component lays it
+   * out anew. So only references to its parts are taken here, the work returned reads them on
+   * whatever thread it runs. The background reference and what the host view says about
+   * accessibility are read right away, as they need the main thread.
+   */
+  @Override
+  public @Nullable Callable<List<Named<SonarObject>>> captureData(DebugComponent node)
+      throws Exception {
+    NodeDescriptor componentDescriptor = descriptorForClass(node.getComponent().getClass());
+    if (componentDescriptor.getClass() != ObjectDescriptor.class) {
+      return null;
     }
 
-    final SonarObject propData = getPropData(node);
-    if (propData != null) {
-      data.add(new Named<>("Props", propData));
-    }
+    final DebugLayoutNode layout = node.getLayoutNode();
+    final InspectorValue background =
+        layout == null ? null : fromReference(node.getContext(), layout.getBackground());
+    final boolean canResolve = node.canResolve();
+    final Component component = node.getComponent();
+    final ComponentLifecycle.StateContainer stateContainer = node.getStateContainer();
+    final SonarObject accessibilityData = getAccessibilityData(node);
 
-    final SonarObject stateData = getStateData(node);
-    if (stateData != null) {
-      data.add(new Named<>("State", stateData));
-    }
+    return new Callable<List<Named<SonarObject>>>() {
+      @Override
+      public List<Named<SonarObject>> call() {
+        final List<Named<SonarObject>> data = new ArrayList<>();
 
-    final SonarObject accessibilityData = getAccessibilityData(node);
-    if (accessibilityData != null) {
-      data.add(new Named<>("Accessibility", accessibilityData));
-    }
+        if (layout != null) {
+          data.add(new Named<>("Layout", getLayoutData(layout, background)));
+        }
+
+        final SonarObject propData = canResolve ? null : getPropData(component);
+        if (propData != null) {
+          data.add(new Named<>("Props", propData));
+        }
+
+        final SonarObject stateData =
+            canResolve || stateContainer == null ? null : getStateData(stateContainer);
+        if (stateData != null) {
+          data.add(new Named<>("State", stateData));
+        }
+
+        if (accessibilityData != null) {
+          data.add(new Named<>("Accessibility", accessibilityData));
+        }
 
-    return data;
+        return data;
+      }
+    };
   }
 
   @Override
@@ -267,15 +295,9 @@ public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
     return props.build();
   }
 
-  @Nullable
-  private static SonarObject getLayoutData(DebugComponent node) {
-    final DebugLayoutNode layout = node.getLayoutNode();
-    if (layout == null) {
-      return null;
-    }
-
+  private static SonarObject getLayoutData(DebugLayoutNode layout, InspectorValue background) {
     final SonarObject.Builder data = new SonarObject.Builder();
-    data.put("background", fromReference(node.getContext(), layout.getBackground()));
+    data.put("background", background);
     data.put("foreground", fromDrawable(layout.getForeground()));
 
     data.put("direction", InspectorValue.mutable(Enum, layout.getLayoutDirection().toString()));
@@ -357,57 +379,46 @@ public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
   }
 
   @Nullable
-  private static SonarObject getPropData(DebugComponent node) {
-    if (node.canResolve()) {
-      return null;
-    }
-
-    final Component component = node.getComponent();
+  private static SonarObject getPropData(Component component) {
     final SonarObject.Builder props = new SonarObject.Builder();
 
     boolean hasProps = false;
-    for (Field f : component.getClass().getDeclaredFields()) {
+    for (ComponentFields.PropField prop : ComponentFields.props(component.getClass())) {
+      final Field f = prop.field;
       try {
-        f.setAccessible(true);
-
-        final Prop annotation = f.getAnnotation(Prop.class);
-        if (annotation != null) {
-          switch (annotation.resType()) {
-            case COLOR:
-              props.put(f.getName(), fromColor((Integer) f.get(component)));
-              break;
-            case DRAWABLE:
-              props.put(f.getName(), fromDrawable((Drawable) f.get(component)));
-              break;
-            default:
-              if (f.get(component) != null
-                  && PropWithDescription.class.isAssignableFrom(f.get(component).getClass())) {
-                final Object description =
-                    ((PropWithDescription) f.get(component))
-                        .getSonarLayoutInspectorPropDescription();
-                // Treat the description as immutable for now, because it's a "translation" of the
-                // actual prop,
-                // mutating them is not going to change the original prop.
-                if (description instanceof Map<?, ?>) {
-                  final Map<?, ?> descriptionMap = (Map<?, ?>) description;
-                  for (Map.Entry<?, ?> entry : descriptionMap.entrySet()) {
-                    props.put(
-                        entry.getKey().toString(), InspectorValue.immutable(entry.getValue()));
-                  }
-                } else {
-                  props.put(f.getName(), InspectorValue.immutable(description));
+        switch (prop.resType) {
+          case COLOR:
+            props.put(f.getName(), fromColor((Integer) f.get(component)));
+            break;
+          case DRAWABLE:
+            props.put(f.getName(), fromDrawable((Drawable) f.get(component)));
+            break;
+          default:
+            final Object value = f.get(component);
+            if (value instanceof PropWithDescription) {
+              final Object description =
+                  ((PropWithDescription) value).getSonarLayoutInspectorPropDescription();
+              // Treat the description as immutable for now, because it's a "translation" of the
+              // actual prop,
+              // mutating them is not going to change the original prop.
+              if (description instanceof Map<?, ?>) {
+                final Map<?, ?> descriptionMap = (Map<?, ?>) description;
+                for (Map.Entry<?, ?> entry : descriptionMap.entrySet()) {
+                  props.put(entry.getKey().toString(), InspectorValue.immutable(entry.getValue()));
                 }
               } else {
-                if (isTypeMutable(f.getType())) {
-                  props.put(f.getName(), InspectorValue.mutable(f.get(component)));
-                } else {
-                  props.put(f.getName(), InspectorValue.immutable(f.get(component)));
-                }
+                props.put(f.getName(), InspectorValue.immutable(description));
               }
-              break;
-          }
-          hasProps = true;
+            } else {
+              if (prop.mutable) {
+                props.put(f.getName(), InspectorValue.mutable(value));
+              } else {
+                props.put(f.getName(), InspectorValue.immutable(value));
+              }
+            }
+            break;
         }
+        hasProps = true;
       } catch (Exception ignored) {
       }
     }
@@ -416,32 +427,19 @@ public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
   }
 
   @Nullable
-  private static SonarObject getStateData(DebugComponent node) {
-    if (node.canResolve()) {
-      return null;
-    }
-
-    final ComponentLifecycle.StateContainer stateContainer = node.getStateContainer();
-    if (stateContainer == null) {
-      return null;
-    }
-
+  private static SonarObject getStateData(ComponentLifecycle.StateContainer stateContainer) {
     final SonarObject.Builder state = new SonarObject.Builder();
 
     boolean hasState = false;
-    for (Field f : stateContainer.getClass().getDeclaredFields()) {
+    for (ComponentFields.StateField stateField : ComponentFields.state(stateContainer.getClass())) {
+      final Field f = stateField.field;
       try {
-        f.setAccessible(true);
-
-        final State annotation = f.getAnnotation(State.class);
-        if (annotation != null) {
-          if (isTypeMutable(f.getType())) {
-            state.put(f.getName(), InspectorValue.mutable(f.get(stateContainer)));
-          } else {
-            state.put(f.getName(), InspectorValue.immutable(f.get(stateContainer)));
-          }
-          hasState = true;
+        if (stateField.mutable) {
+          state.put(f.getName(), InspectorValue.mutable(f.get(stateContainer)));
+        } else {
+          state.put(f.getName(), InspectorValue.immutable(f.get(stateContainer)));
         }
+        hasState = true;
       } catch (Exception ignored) {
       }
     }
@@ -449,23 +447,6 @@ public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
     return hasState ? state.build() : null;
   }
 
-  private static boolean isTypeMutable(Class<?> type) {
-    if (type == int.class || type == Integer.class) {
-      return true;
-    } else if (type == long.class || type == Long.class) {
-      return true;
-    } else if (type == float.class || type == Float.class) {
-      return true;
-    } else if (type == double.class || type == Double.class) {
-      return true;
-    } else if (type == boolean.class || type == Boolean.class) {
-      return true;
-    } else if (type.isAssignableFrom(String.class)) {
-      return true;
-    }
-    return false;
-  }
-
   @Nullable
   private static SonarObject getAccessibilityData(DebugComponent node) {
     final DebugLayoutNode layout = node.getLayoutNode();
@@ -755,8 +736,10 @@ public class DebugComponentDescriptor extends NodeDescriptor<DebugComponent> {
 
   private static void applyReflectiveOverride(Object o, String key, SonarDynamic dynamic) {
     try {
-      final Field field = o.getClass().getDeclaredField(key);
-      field.setAccessible(true);
+      final Field field = ComponentFields.field(o.getClass(), key);
+      if (field == null) {
+        return;
+      }
 
       final Class type = field.getType();
 
@@ -9,7 +9,16 @@ import com.facebook.sonar.plugins.inspector.DescriptorMapping;
 public final class LithoSonarDescriptors {
 
   public static void add(DescriptorMapping descriptorMapping) {
-    descriptorMapping.register(LithoView.class, new LithoViewDescriptor());
+    add(descriptorMapping, false);
+  }
+
+  /**
+   * @param precomputeFields Look up the props and state fields of the components in a LithoView
+   *     on a background thread as soon as the inspector comes across the view, instead of on its
+   *     first inspection.
+   */
+  public static void add(DescriptorMapping descriptorMapping, boolean precomputeFields) {
+    descriptorMapping.register(LithoView.class, new LithoViewDescriptor(precomputeFields));
     descriptorMapping.register(DebugComponent.class, new DebugComponentDescriptor());
   }
 }
@@ -17,8 +17,21 @@ import javax.annotation.Nullable;
 
 public class LithoViewDescriptor extends NodeDescriptor<LithoView> {
 
+  private final boolean mPrecomputeFields;
+
+  public LithoViewDescriptor() {
+    this(false);
+  }
+
+  public LithoViewDescriptor(boolean precomputeFields) {
+    mPrecomputeFields = precomputeFields;
+  }
+
   @Override
   public void init(LithoView node) throws Exception {
+    if (mPrecomputeFields) {
+      ComponentFields.precompute(DebugComponent.getRootInstance(node));
+    }
     node.setOnDirtyMountListener(
         new LithoView.OnDirtyMountListener() {
           @Override
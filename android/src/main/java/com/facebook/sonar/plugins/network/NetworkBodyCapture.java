@@ -0,0 +1,49 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.plugins.network;
+
+import com.facebook.jni.HybridClassBase;
+import com.facebook.proguard.annotations.DoNotStrip;
+import com.facebook.sonar.android.SonarNativeLibrary;
+import java.nio.channels.ReadableByteChannel;
+
+/**
+ * A request or response body, streamed into native memory as it is read so that it isn't held on
+ * the Java heap a second time. Only the first maxBytes are kept. Not thread safe.
+ */
+@DoNotStrip
+public class NetworkBodyCapture extends HybridClassBase {
+  static {
+    SonarNativeLibrary.load();
+  }
+
+  public NetworkBodyCapture(int maxBytes) {
+    initHybrid(maxBytes);
+  }
+
+  /** Reads channel until it has no more bytes available, returns how many were read. */
+  @DoNotStrip
+  public native long readFrom(ReadableByteChannel channel);
+
+  /** Whether more than maxBytes were read, and only the first maxBytes were kept. */
+  @DoNotStrip
+  public native boolean isTruncated();
+
+  @DoNotStrip
+  public native long totalBytes();
+
+  /** The kept bytes, base64 encoded. */
+  @DoNotStrip
+  public native String toBase64();
+
+  @DoNotStrip
+  public native byte[] toByteArray();
+
+  @DoNotStrip
+  private native void initHybrid(int maxBytes);
+}
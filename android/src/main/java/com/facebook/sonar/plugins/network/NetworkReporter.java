@@ -10,6 +10,7 @@ package com.facebook.sonar.plugins.network;
 
 import java.util.ArrayList;
 import java.util.List;
+import javax.annotation.Nullable;
 
 public interface NetworkReporter {
   void reportRequest(RequestInfo requestInfo);
@@ -38,6 +39,8 @@ public interface NetworkReporter {
     public String method;
     public String uri;
     public byte[] body;
+    // Set instead of body when the body was streamed into native memory.
+    public @Nullable NetworkBodyCapture capturedBody;
 
     public Header getFirstHeader(final String name) {
       for (Header header : headers) {
@@ -56,6 +59,11 @@ public interface NetworkReporter {
     public String statusReason;
     public List<Header> headers = new ArrayList<>();
     public byte[] body;
+    // Set instead of body when the body was streamed into native memory.
+    public @Nullable NetworkBodyCapture capturedBody;
+    // Set when the response is reported before its body has been read. It is reported again with
+    // the body once it has.
+    public boolean bodyPending;
 
     public Header getFirstHeader(final String name) {
       for (Header header : headers) {
@@ -8,24 +8,43 @@
 
 package com.facebook.sonar.plugins.network;
 
-import android.util.Base64;
+import com.facebook.sonar.android.SonarNetworkReporter;
 import com.facebook.sonar.core.ErrorReportingRunnable;
-import com.facebook.sonar.core.SonarArray;
+import com.facebook.sonar.core.SonarConnection;
 import com.facebook.sonar.core.SonarObject;
+import com.facebook.sonar.core.SonarReceiver;
+import com.facebook.sonar.core.SonarResponder;
 import com.facebook.sonar.plugins.common.BufferingSonarPlugin;
 import java.util.List;
 
+/**
+ * Requests and responses are formatted, buffered and sent by a {@link SonarNetworkReporter}, which
+ * iOS shares. Only the response formatters run in Java.
+ */
 public class NetworkSonarPlugin extends BufferingSonarPlugin implements NetworkReporter {
   public static final String ID = "Network";
 
+  private static final int BUFFER_BYTES = 1024 * 1024;
+  private static final int MAX_BODY_BYTES = 1024 * 1024;
+
   private final List<NetworkResponseFormatter> mFormatters;
+  private final SonarNetworkReporter mReporter;
 
   public NetworkSonarPlugin() {
     this(null);
   }
 
   public NetworkSonarPlugin(List<NetworkResponseFormatter> formatters) {
+    this(formatters, 0);
+  }
+
+  /**
+   * @param maxRequestsPerSecond requests beyond this rate are dropped together with their
+   *     responses, 0 doesn't limit the rate.
+   */
+  public NetworkSonarPlugin(List<NetworkResponseFormatter> formatters, int maxRequestsPerSecond) {
     this.mFormatters = formatters;
+    this.mReporter = new SonarNetworkReporter(BUFFER_BYTES, MAX_BODY_BYTES, maxRequestsPerSecond);
   }
 
   @Override
@@ -33,19 +52,56 @@ public class NetworkSonarPlugin extends BufferingSonarPlugin implements NetworkR
     return ID;
   }
 
+  @Override
+  public synchronized void onConnect(SonarConnection connection) {
+    super.onConnect(connection);
+    mReporter.setConnection(connection);
+    connection.receive(
+        "enableHeaderTable",
+        new SonarReceiver() {
+          @Override
+          public void onReceive(SonarObject params, SonarResponder responder) {
+            responder.success(
+                new SonarObject.Builder()
+                    .put("generation", mReporter.enableHeaderTable())
+                    .build());
+          }
+        });
+    connection.receive(
+        "setUrlFilter",
+        new SonarReceiver() {
+          @Override
+          public void onReceive(SonarObject params, SonarResponder responder) {
+            mReporter.setUrlFilter(params);
+            responder.success();
+          }
+        });
+  }
+
+  @Override
+  public synchronized void onDisconnect() {
+    super.onDisconnect();
+    mReporter.setConnection(null);
+  }
+
+  /**
+   * Whether the desktop wants requests to url. Interceptors check before capturing a request, so
+   * that filtered out ones cost next to nothing.
+   */
+  public boolean shouldCapture(String url) {
+    return mReporter.shouldCapture(url);
+  }
+
   @Override
   public void reportRequest(RequestInfo requestInfo) {
-    final SonarObject request =
-        new SonarObject.Builder()
-            .put("id", requestInfo.requestId)
-            .put("timestamp", requestInfo.timeStamp)
-            .put("method", requestInfo.method)
-            .put("url", requestInfo.uri)
-            .put("headers", toSonarObject(requestInfo.headers))
-            .put("data", toBase64(requestInfo.body))
-            .build();
-
-    send("newRequest", request);
+    mReporter.reportRequest(
+        requestInfo.requestId,
+        requestInfo.timeStamp,
+        requestInfo.method,
+        requestInfo.uri,
+        toHeaderArray(requestInfo.headers),
+        requestInfo.body,
+        requestInfo.capturedBody);
   }
 
   @Override
@@ -56,23 +112,28 @@ public class NetworkSonarPlugin extends BufferingSonarPlugin implements NetworkR
           protected void runOrThrow() throws Exception {
             if (shouldStripResponseBody(responseInfo)) {
               responseInfo.body = null;
+              responseInfo.capturedBody = null;
             }
 
-            final SonarObject response =
-                new SonarObject.Builder()
-                    .put("id", responseInfo.requestId)
-                    .put("timestamp", responseInfo.timeStamp)
-                    .put("status", responseInfo.statusCode)
-                    .put("reason", responseInfo.statusReason)
-                    .put("headers", toSonarObject(responseInfo.headers))
-                    .put("data", toBase64(responseInfo.body))
-                    .build();
-
-            send("newResponse", response);
+            mReporter.reportResponse(
+                responseInfo.requestId,
+                responseInfo.timeStamp,
+                responseInfo.statusCode,
+                responseInfo.statusReason,
+                toHeaderArray(responseInfo.headers),
+                responseInfo.body,
+                responseInfo.capturedBody,
+                responseInfo.bodyPending);
           }
         };
 
-    if (mFormatters != null) {
+    // Formatters only get the response once it has its body.
+    if (mFormatters != null && !responseInfo.bodyPending) {
+      // Formatters work on the body's bytes.
+      if (responseInfo.body == null && responseInfo.capturedBody != null) {
+        responseInfo.body = responseInfo.capturedBody.toByteArray();
+        responseInfo.capturedBody = null;
+      }
       for (NetworkResponseFormatter formatter : mFormatters) {
         if (formatter.shouldFormat(responseInfo)) {
           formatter.format(
@@ -92,21 +153,14 @@ public class NetworkSonarPlugin extends BufferingSonarPlugin implements NetworkR
     job.run();
   }
 
-  private String toBase64(byte[] bytes) {
-    if (bytes == null) {
-      return null;
-    }
-    return new String(Base64.encode(bytes, Base64.DEFAULT));
-  }
-
-  private SonarArray toSonarObject(List<Header> headers) {
-    final SonarArray.Builder list = new SonarArray.Builder();
-
-    for (Header header : headers) {
-      list.put(new SonarObject.Builder().put("key", header.name).put("value", header.value));
+  // Names and values alternate.
+  private static String[] toHeaderArray(List<Header> headers) {
+    final String[] array = new String[headers.size() * 2];
+    for (int i = 0; i < headers.size(); i++) {
+      array[2 * i] = headers.get(i).name;
+      array[2 * i + 1] = headers.get(i).value;
     }
-
-    return list.build();
+    return array;
   }
 
   private static boolean shouldStripResponseBody(ResponseInfo responseInfo) {
@@ -7,14 +7,17 @@
  */
 package com.facebook.sonar.plugins.network;
 
-import android.util.Log;
 import com.facebook.sonar.plugins.network.NetworkReporter.RequestInfo;
 import com.facebook.sonar.plugins.network.NetworkReporter.ResponseInfo;
 import java.io.IOException;
+import java.nio.channels.Channels;
+import java.nio.channels.ReadableByteChannel;
 import java.util.ArrayList;
 import java.util.List;
 import java.util.Random;
 import java.util.Set;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Executors;
 import javax.annotation.Nullable;
 import okhttp3.Headers;
 import okhttp3.Interceptor;
@@ -22,48 +25,103 @@ import okhttp3.Request;
 import okhttp3.Response;
 import okhttp3.ResponseBody;
 import okio.Buffer;
+import okio.ForwardingSource;
+import okio.Okio;
+import okio.Source;
 
 public class SonarOkhttpInterceptor implements Interceptor {
 
+  // Bodies are captured up to this size, anything after it is dropped.
+  private static final int MAX_BODY_BYTES = 1024 * 1024;
+
+  // Response bodies are reported from here rather than from the app's thread that read them.
+  private static final Executor sReportExecutor = Executors.newSingleThreadExecutor();
+
   public @Nullable NetworkSonarPlugin plugin;
 
+  // Set instead of plugin in tests, which also keep bodies on the Java heap, since they can't load
+  // the native library NetworkBodyCapture needs.
+  private final @Nullable NetworkReporter mReporter;
+  private final Executor mReportExecutor;
+
   public SonarOkhttpInterceptor() {
-    this.plugin = null;
+    this((NetworkSonarPlugin) null);
   }
 
   public SonarOkhttpInterceptor(NetworkSonarPlugin plugin) {
     this.plugin = plugin;
+    this.mReporter = null;
+    this.mReportExecutor = sReportExecutor;
+  }
+
+  SonarOkhttpInterceptor(NetworkReporter reporter, Executor reportExecutor) {
+    this.plugin = null;
+    this.mReporter = reporter;
+    this.mReportExecutor = reportExecutor;
   }
 
   @Override
   public Response intercept(Interceptor.Chain chain) throws IOException {
     Request request = chain.request();
+    // Neither headers nor bodies of requests the desktop filters out are read.
+    if (mReporter == null && !plugin.shouldCapture(request.url().toString())) {
+      return chain.proceed(request);
+    }
+    final NetworkReporter reporter = mReporter != null ? mReporter : plugin;
     int randInt = randInt(1, Integer.MAX_VALUE);
-    plugin.reportRequest(convertRequest(request, randInt));
+    reporter.reportRequest(convertRequest(request, randInt));
     Response response = chain.proceed(request);
-    ResponseBody body = response.body();
-    ResponseInfo responseInfo = convertResponse(response, body, randInt);
-    plugin.reportResponse(responseInfo);
-    // Creating new response as can't used response.body() more than once
-    if (responseInfo.body != null) {
-      return response
-          .newBuilder()
-          .body(ResponseBody.create(body.contentType(), responseInfo.body))
-          .build();
-    } else {
+    final ResponseBody body = response.body();
+    final ResponseInfo headersInfo = convertResponse(response, randInt);
+    if (body == null) {
+      reporter.reportResponse(headersInfo);
       return response;
     }
+    // Reported as soon as it arrives, so that responses whose body the app never reads show up too,
+    // and again with the body once the app has read it to the end or closed it.
+    headersInfo.bodyPending = true;
+    reporter.reportResponse(headersInfo);
+    final ResponseInfo bodyInfo = convertResponse(response, randInt);
+    final BodySink sink = newSink();
+    final Source source =
+        new CapturingSource(
+            body.source(),
+            sink,
+            new Runnable() {
+              @Override
+              public void run() {
+                mReportExecutor.execute(
+                    new Runnable() {
+                      @Override
+                      public void run() {
+                        bodyInfo.body = sink.bytes();
+                        bodyInfo.capturedBody = sink.capture();
+                        reporter.reportResponse(bodyInfo);
+                      }
+                    });
+              }
+            });
+    return response
+        .newBuilder()
+        .body(ResponseBody.create(body.contentType(), body.contentLength(), Okio.buffer(source)))
+        .build();
   }
 
-  private static byte[] bodyToByteArray(final Request request) {
+  private BodySink newSink() {
+    return mReporter == null ? new NativeBodySink() : new HeapBodySink();
+  }
 
+  private void captureBody(final Request request, final RequestInfo info) {
     try {
       final Request copy = request.newBuilder().build();
       final Buffer buffer = new Buffer();
       copy.body().writeTo(buffer);
-      return buffer.readByteArray();
+      final BodySink sink = newSink();
+      sink.write(buffer, 0, Math.min(buffer.size(), MAX_BODY_BYTES + 1));
+      info.body = sink.bytes();
+      info.capturedBody = sink.capture();
     } catch (final IOException e) {
-      return e.getMessage().getBytes();
+      info.body = e.getMessage().getBytes();
     }
   }
 
@@ -76,13 +134,13 @@ public class SonarOkhttpInterceptor implements Interceptor {
     info.method = request.method();
     info.uri = request.url().toString();
     if (request.body() != null) {
-      info.body = bodyToByteArray(request);
+      captureBody(request, info);
     }
 
     return info;
   }
 
-  private ResponseInfo convertResponse(Response response, ResponseBody body, int identifier) {
+  private ResponseInfo convertResponse(Response response, int identifier) {
 
     List<NetworkReporter.Header> headers = convertHeader(response.headers());
     ResponseInfo info = new ResponseInfo();
@@ -90,11 +148,6 @@ public class SonarOkhttpInterceptor implements Interceptor {
     info.timeStamp = response.receivedResponseAtMillis();
     info.statusCode = response.code();
     info.headers = headers;
-    try {
-      info.body = body.bytes();
-    } catch (IOException e) {
-      Log.e("Sonar", e.toString());
-    }
     return info;
   }
 
@@ -108,6 +161,110 @@ public class SonarOkhttpInterceptor implements Interceptor {
     return list;
   }
 
+  /** Keeps the first MAX_BODY_BYTES of a body until it is reported. Not thread safe. */
+  private interface BodySink {
+    void write(Buffer buffer, long offset, long byteCount) throws IOException;
+
+    /** The kept bytes, if they are kept on the Java heap. */
+    @Nullable
+    byte[] bytes();
+
+    /** The kept bytes, if they are kept in native memory. */
+    @Nullable
+    NetworkBodyCapture capture();
+  }
+
+  private static class NativeBodySink implements BodySink {
+    private final NetworkBodyCapture mCapture = new NetworkBodyCapture(MAX_BODY_BYTES);
+    private final Buffer mPending = new Buffer();
+    private final ReadableByteChannel mPendingChannel = Channels.newChannel(mPending.inputStream());
+
+    @Override
+    public void write(Buffer buffer, long offset, long byteCount) throws IOException {
+      buffer.copyTo(mPending, offset, byteCount);
+      mCapture.readFrom(mPendingChannel);
+    }
+
+    @Override
+    public @Nullable byte[] bytes() {
+      return null;
+    }
+
+    @Override
+    public NetworkBodyCapture capture() {
+      return mCapture;
+    }
+  }
+
+  private static class HeapBodySink implements BodySink {
+    private final Buffer mBytes = new Buffer();
+
+    @Override
+    public void write(Buffer buffer, long offset, long byteCount) {
+      buffer.copyTo(mBytes, offset, Math.min(byteCount, MAX_BODY_BYTES - mBytes.size()));
+    }
+
+    @Override
+    public byte[] bytes() {
+      return mBytes.readByteArray();
+    }
+
+    @Override
+    public @Nullable NetworkBodyCapture capture() {
+      return null;
+    }
+  }
+
+  /**
+   * Passes a body through to the app, copying what's read into a sink. Only the first chunk past
+   * the limit is copied, so that a native capture knows it was truncated.
+   */
+  private static class CapturingSource extends ForwardingSource {
+    private final BodySink mSink;
+    private final Runnable mOnDone;
+    private long mCopiedBytes = 0;
+    private boolean mDone = false;
+
+    CapturingSource(Source delegate, BodySink sink, Runnable onDone) {
+      super(delegate);
+      mSink = sink;
+      mOnDone = onDone;
+    }
+
+    @Override
+    public long read(Buffer sink, long byteCount) throws IOException {
+      final long read;
+      try {
+        read = super.read(sink, byteCount);
+      } catch (IOException e) {
+        done();
+        throw e;
+      }
+      if (read == -1) {
+        done();
+        return -1;
+      }
+      if (mCopiedBytes <= MAX_BODY_BYTES) {
+        mSink.write(sink, sink.size() - read, read);
+        mCopiedBytes += read;
+      }
+      return read;
+    }
+
+    @Override
+    public void close() throws IOException {
+      super.close();
+      done();
+    }
+
+    private void done() {
+      if (!mDone) {
+        mDone = true;
+        mOnDone.run();
+      }
+    }
+  }
+
   private int randInt(int min, int max) {
     Random rand = new Random();
     int randomNum = rand.nextInt((max - min) + 1) + min;
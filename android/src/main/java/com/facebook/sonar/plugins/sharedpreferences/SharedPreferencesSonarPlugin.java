@@ -18,26 +18,38 @@ import com.facebook.sonar.core.SonarPlugin;
 import com.facebook.sonar.core.SonarReceiver;
 import com.facebook.sonar.core.SonarResponder;
 import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.atomic.AtomicInteger;
+import javax.annotation.Nullable;
 
 public class SharedPreferencesSonarPlugin implements SonarPlugin {
 
   private SonarConnection mConnection;
   private final SharedPreferences mSharedPreferences;
+  // Counts changes, so that the desktop can tell which changes a snapshot already has and whether
+  // it missed any.
+  private final AtomicInteger mVersion = new AtomicInteger();
+  // The type each preference was last seen with, to read single values without copying the whole
+  // file with getAll.
+  private final Map<String, Class<?>> mValueTypes = new ConcurrentHashMap<>();
   private final SharedPreferences.OnSharedPreferenceChangeListener
       onSharedPreferenceChangeListener =
           new SharedPreferences.OnSharedPreferenceChangeListener() {
             @Override
             public void onSharedPreferenceChanged(SharedPreferences sharedPreferences, String key) {
+              final int version = mVersion.incrementAndGet();
               if (mConnection == null) {
                 return;
               }
+              final boolean deleted = !mSharedPreferences.contains(key);
               mConnection.send(
                   "sharedPreferencesChange",
                   new SonarObject.Builder()
                       .put("name", key)
-                      .put("deleted", !mSharedPreferences.contains(key))
+                      .put("deleted", deleted)
                       .put("time", System.currentTimeMillis())
-                      .put("value", mSharedPreferences.getAll().get(key))
+                      .put("value", deleted ? null : getValue(key))
+                      .put("version", version)
                       .build());
             }
           };
@@ -87,11 +99,48 @@ public class SharedPreferencesSonarPlugin implements SonarPlugin {
     for (Map.Entry<String, ?> entry : map.entrySet()) {
       final Object val = entry.getValue();
       builder.put(entry.getKey(), val);
+      if (val != null) {
+        mValueTypes.put(entry.getKey(), val.getClass());
+      }
     }
 
     return builder.build();
   }
 
+  private SonarObject getSnapshot() {
+    // Read first, so the snapshot has at least the changes up to this version.
+    final int version = mVersion.get();
+    return new SonarObject.Builder()
+        .put("version", version)
+        .put("preferences", getSharedPreferencesObject())
+        .build();
+  }
+
+  @Nullable
+  private Object getValue(String key) {
+    final Class<?> type = mValueTypes.get(key);
+    try {
+      if (type == String.class) {
+        return mSharedPreferences.getString(key, null);
+      } else if (type == Boolean.class) {
+        return mSharedPreferences.getBoolean(key, false);
+      } else if (type == Integer.class) {
+        return mSharedPreferences.getInt(key, 0);
+      } else if (type == Long.class) {
+        return mSharedPreferences.getLong(key, 0);
+      } else if (type == Float.class) {
+        return mSharedPreferences.getFloat(key, 0);
+      }
+    } catch (ClassCastException e) {
+      // Stored with another type since, found out below.
+    }
+    final Object value = mSharedPreferences.getAll().get(key);
+    if (value != null) {
+      mValueTypes.put(key, value.getClass());
+    }
+    return value;
+  }
+
   @Override
   public void onConnect(SonarConnection connection) {
     mConnection = connection;
@@ -105,6 +154,15 @@ public class SharedPreferencesSonarPlugin implements SonarPlugin {
           }
         });
 
+    connection.receive(
+        "getSharedPreferencesSnapshot",
+        new SonarReceiver() {
+          @Override
+          public void onReceive(SonarObject params, SonarResponder responder) {
+            responder.success(getSnapshot());
+          }
+        });
+
     connection.receive(
         "setSharedPreference",
         new SonarReceiver() {
@@ -132,7 +190,13 @@ public class SharedPreferencesSonarPlugin implements SonarPlugin {
 
             editor.apply();
 
-            responder.success(getSharedPreferencesObject());
+            // The change is sent as a sharedPreferencesChange, desktops that apply those don't
+            // need the whole file again.
+            if (params.getBoolean("incremental")) {
+              responder.success();
+            } else {
+              responder.success(getSharedPreferencesObject());
+            }
           }
         });
   }
@@ -10,7 +10,9 @@ package com.facebook.sonar.testing;
 import com.facebook.sonar.core.SonarArray;
 import com.facebook.sonar.core.SonarConnection;
 import com.facebook.sonar.core.SonarObject;
+import com.facebook.sonar.core.SonarParamsBuilder;
 import com.facebook.sonar.core.SonarReceiver;
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 import java.util.HashMap;
 import java.util.List;
@@ -19,6 +21,8 @@ import java.util.Map;
 public class SonarConnectionMock implements SonarConnection {
   public final Map<String, SonarReceiver> receivers = new HashMap<>();
   public final Map<String, List<Object>> sent = new HashMap<>();
+  // Max per second and sample rate, by method.
+  public final Map<String, double[]> sendLimits = new HashMap<>();
 
   @Override
   public void send(String method, SonarObject params) {
@@ -46,6 +50,34 @@ public class SonarConnectionMock implements SonarConnection {
     paramList.add(params);
   }
 
+  @Override
+  public void sendBytes(String method, ByteBuffer params) {
+    final List<Object> paramList;
+    if (sent.containsKey(method)) {
+      paramList = sent.get(method);
+    } else {
+      paramList = new ArrayList<>();
+      sent.put(method, paramList);
+    }
+
+    paramList.add(params);
+  }
+
+  @Override
+  public void setSendLimit(String method, double maxPerSecond, double sampleRate) {
+    sendLimits.put(method, new double[] {maxPerSecond, sampleRate});
+  }
+
+  @Override
+  public boolean isSubscribed(String method) {
+    return true;
+  }
+
+  @Override
+  public void sendLazy(String method, SonarParamsBuilder builder) {
+    send(method, builder.build());
+  }
+
   @Override
   public void reportError(Throwable throwable) {}
 
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.android;
+
+import static org.hamcrest.CoreMatchers.equalTo;
+import static org.hamcrest.CoreMatchers.not;
+import static org.hamcrest.CoreMatchers.nullValue;
+import static org.hamcrest.CoreMatchers.sameInstance;
+import static org.hamcrest.MatcherAssert.assertThat;
+
+import com.facebook.sonar.core.SonarConnection;
+import com.facebook.sonar.core.SonarPlugin;
+import com.facebook.sonar.core.SonarPluginFactory;
+import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+@RunWith(WithTestDefaultsRunner.class)
+public class PluginRegistryTest {
+
+  private static class Plugin implements SonarPlugin {
+    private final String mId;
+
+    Plugin(String id) {
+      mId = id;
+    }
+
+    @Override
+    public String getId() {
+      return mId;
+    }
+
+    @Override
+    public void onConnect(SonarConnection connection) {}
+
+    @Override
+    public void onDisconnect() {}
+  }
+
+  private static class Factory implements SonarPluginFactory {
+    int created;
+
+    @Override
+    public SonarPlugin create() {
+      created++;
+      return new Plugin("Lazy");
+    }
+  }
+
+  @Test
+  public void testLooksUpByIdAndHandle() {
+    final PluginRegistry registry = new PluginRegistry();
+    final Plugin plugin = new Plugin("Test");
+    final int handle = registry.add(plugin);
+
+    assertThat(registry.handle("Test"), equalTo(handle));
+    assertThat(registry.get("Test"), sameInstance((SonarPlugin) plugin));
+    assertThat(registry.get(handle), sameInstance((SonarPlugin) plugin));
+    assertThat(registry.get("Other"), nullValue());
+  }
+
+  @Test
+  public void testKeepsFirstPluginAddedUnderId() {
+    final PluginRegistry registry = new PluginRegistry();
+    final Plugin plugin = new Plugin("Test");
+    registry.add(plugin);
+
+    assertThat(registry.add(new Plugin("Test")), equalTo(PluginRegistry.NO_HANDLE));
+    assertThat(registry.get("Test"), sameInstance((SonarPlugin) plugin));
+  }
+
+  @Test
+  public void testBuildsFactoryPluginOnce() {
+    final PluginRegistry registry = new PluginRegistry();
+    final Factory factory = new Factory();
+    final int handle = registry.addFactory("Lazy", factory);
+    assertThat(factory.created, equalTo(0));
+
+    final SonarPlugin plugin = registry.get("Lazy");
+    assertThat(plugin, not(nullValue()));
+    assertThat(registry.get(handle), sameInstance(plugin));
+    assertThat(factory.created, equalTo(1));
+  }
+
+  @Test
+  public void testRemoveFreesId() {
+    final PluginRegistry registry = new PluginRegistry();
+    final int handle = registry.add(new Plugin("Test"));
+    registry.remove(handle);
+
+    assertThat(registry.get("Test"), nullValue());
+    assertThat(registry.get(handle), nullValue());
+    assertThat(registry.handle("Test"), equalTo(PluginRegistry.NO_HANDLE));
+    assertThat(registry.add(new Plugin("Test")), not(equalTo(handle)));
+  }
+}
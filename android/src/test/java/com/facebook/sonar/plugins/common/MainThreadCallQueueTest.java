@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.plugins.common;
+
+import static org.hamcrest.CoreMatchers.equalTo;
+import static org.hamcrest.MatcherAssert.assertThat;
+
+import android.os.Looper;
+import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+import org.robolectric.shadows.ShadowLooper;
+
+@RunWith(WithTestDefaultsRunner.class)
+public class MainThreadCallQueueTest {
+
+  private final List<String> mCalls = new ArrayList<>();
+
+  @Before
+  public void setup() {
+    ShadowLooper.pauseMainLooper();
+  }
+
+  @Test
+  public void runsCallsInOrder() {
+    final MainThreadCallQueue queue =
+        new MainThreadCallQueue(Looper.getMainLooper(), MainThreadCallQueue.FRAME_BUDGET_MS);
+    // Runs right away, there is nothing to batch it with.
+    queue.add(record("a"));
+    queue.add(
+        new Runnable() {
+          @Override
+          public void run() {
+            mCalls.add("b");
+            queue.add(record("d"));
+          }
+        });
+    queue.add(record("c"));
+    assertThat(mCalls, equalTo(Arrays.asList("a")));
+
+    ShadowLooper.runUiThreadTasks();
+    assertThat(mCalls, equalTo(Arrays.asList("a", "b", "c", "d")));
+  }
+
+  @Test
+  public void carriesOverCallsPastTheBudget() {
+    // Every call uses up the budget.
+    final MainThreadCallQueue queue = new MainThreadCallQueue(Looper.getMainLooper(), 0);
+    queue.add(record("a"));
+    queue.add(record("b"));
+    queue.add(record("c"));
+
+    ShadowLooper.getShadowMainLooper().runOneTask();
+    assertThat(mCalls, equalTo(Arrays.asList("a", "b")));
+    ShadowLooper.getShadowMainLooper().runOneTask();
+    assertThat(mCalls, equalTo(Arrays.asList("a", "b", "c")));
+    ShadowLooper.runUiThreadTasks();
+    assertThat(mCalls, equalTo(Arrays.asList("a", "b", "c")));
+  }
+
+  private Runnable record(final String name) {
+    return new Runnable() {
+      @Override
+      public void run() {
+        mCalls.add(name);
+      }
+    };
+  }
+}
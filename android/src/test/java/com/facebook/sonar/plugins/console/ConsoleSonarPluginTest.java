@@ -14,6 +14,7 @@ import com.facebook.sonar.core.SonarObject;
 import com.facebook.sonar.testing.SonarConnectionMock;
 import com.facebook.sonar.testing.SonarResponderMock;
 import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
+import java.util.concurrent.Executor;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -26,7 +27,15 @@ public class ConsoleSonarPluginTest {
 
   @Before
   public void setup() throws Exception {
-    JavascriptEnvironment jsEnvironment = new JavascriptEnvironment();
+    // Evaluate right away rather than on the worker.
+    JavascriptEnvironment jsEnvironment =
+        new JavascriptEnvironment(
+            new Executor() {
+              @Override
+              public void execute(Runnable command) {
+                command.run();
+              }
+            });
     final ConsoleSonarPlugin plugin = new ConsoleSonarPlugin(jsEnvironment);
     connection = new SonarConnectionMock();
     responder = new SonarResponderMock();
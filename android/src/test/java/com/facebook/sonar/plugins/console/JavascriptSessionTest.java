@@ -8,11 +8,16 @@
 package com.facebook.sonar.plugins.console;
 
 import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
 
+import com.facebook.sonar.plugins.console.iface.ScriptingSession;
 import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
 import com.google.common.collect.ImmutableMap;
+import java.util.ArrayList;
 import java.util.Collections;
 import java.util.HashMap;
+import java.util.List;
+import java.util.concurrent.Executor;
 import org.json.JSONObject;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -97,6 +102,64 @@ public class JavascriptSessionTest {
     assertEquals("null", evaluateWithNoGlobals("undefined").getString("type"));
   }
 
+  @Test
+  public void testRepeatedCommandsAreCompiledOnce() throws Exception {
+    JavascriptSession session =
+        new JavascriptSession(mContextFactory, Collections.<String, Object>emptyMap());
+    session.evaluateCommand("var x = 1;");
+    session.evaluateCommand("x = x + 1;");
+    JSONObject json = session.evaluateCommand("x = x + 1;");
+    assertEquals(3, json.getInt("value"));
+    assertEquals(2, session.cachedScriptCount());
+  }
+
+  @Test
+  public void testScriptCacheIsBounded() throws Exception {
+    JavascriptSession session =
+        new JavascriptSession(mContextFactory, Collections.<String, Object>emptyMap());
+    for (int i = 0; i < JavascriptSession.MAX_CACHED_SCRIPTS + 8; i++) {
+      session.evaluateCommand(Integer.toString(i));
+    }
+    assertEquals(JavascriptSession.MAX_CACHED_SCRIPTS, session.cachedScriptCount());
+  }
+
+  @Test
+  public void testAsyncEvaluationReportsOnExecutor() throws Exception {
+    final List<Runnable> queued = new ArrayList<>();
+    JavascriptSession session =
+        new JavascriptSession(
+            mContextFactory,
+            Collections.<String, Object>emptyMap(),
+            new Executor() {
+              @Override
+              public void execute(Runnable command) {
+                queued.add(command);
+              }
+            });
+    final List<Object> results = new ArrayList<>();
+    final ScriptingSession.Callback callback =
+        new ScriptingSession.Callback() {
+          @Override
+          public void onSuccess(JSONObject result) {
+            results.add(result);
+          }
+
+          @Override
+          public void onError(Exception e) {
+            results.add(e);
+          }
+        };
+    session.evaluateCommandAsync("1+1", null, callback);
+    session.evaluateCommandAsync("throw 'oops'", null, callback);
+    assertEquals(0, results.size());
+
+    for (Runnable command : queued) {
+      command.run();
+    }
+    assertEquals(2, ((JSONObject) results.get(0)).getInt("value"));
+    assertTrue(results.get(1) instanceof Exception);
+  }
+
   private static String removeWhitespace(String input) {
     return input.replaceAll("\\s", "");
   }
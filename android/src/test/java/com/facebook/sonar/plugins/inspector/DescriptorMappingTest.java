@@ -102,6 +102,20 @@ public class DescriptorMappingTest {
     assertThat(descriptorMapping.descriptorForClass(TestSubClass.class), equalTo(descriptor));
   }
 
+  @Test
+  public void testRegisteringAfterLookupTakesEffect() {
+    final DescriptorMapping descriptorMapping = new DescriptorMapping();
+    final NodeDescriptor descriptor1 = new TestDescriptor<>();
+    final NodeDescriptor descriptor2 = new TestDescriptor<>();
+
+    descriptorMapping.register(TestClass.class, descriptor1);
+    assertThat(descriptorMapping.descriptorForClass(TestSubClass.class), equalTo(descriptor1));
+
+    descriptorMapping.register(TestSubClass.class, descriptor2);
+    assertThat(descriptorMapping.descriptorForClass(TestSubClass.class), equalTo(descriptor2));
+    assertThat(descriptorMapping.descriptorForClass(TestClass.class), equalTo(descriptor1));
+  }
+
   @Test
   public void testOnConnect() {
     final DescriptorMapping descriptorMapping = new DescriptorMapping();
@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.plugins.inspector;
+
+import static org.hamcrest.CoreMatchers.equalTo;
+import static org.hamcrest.CoreMatchers.nullValue;
+import static org.hamcrest.MatcherAssert.assertThat;
+
+import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
+import java.util.Arrays;
+import java.util.List;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+@RunWith(WithTestDefaultsRunner.class)
+public class HitTestIndexTest {
+
+  // A tap at (50, 50) in a 200x200 root, missing a sibling drawn on top at (100, 100, 150, 150)
+  // and landing in a child at (0, 0, 120, 120).
+  private static void recordTap(HitTestIndex index) {
+    final HitTestIndex.Recording recording = index.record();
+    recording.check(0, 0, 200, 200, true);
+    recording.check(100, 100, 150, 150, false);
+    recording.check(0, 0, 120, 120, true);
+    recording.finish(Arrays.asList("root", "child"));
+  }
+
+  @Test
+  public void testFindsPathWhereChecksAnswerTheSame() {
+    final HitTestIndex index = new HitTestIndex();
+    recordTap(index);
+
+    final List<String> path = Arrays.asList("root", "child");
+    assertThat(index.find(50, 50), equalTo(path));
+    assertThat(index.find(110, 10), equalTo(path));
+    // Within the sibling on top, or outside the child.
+    assertThat(index.find(110, 110), nullValue());
+    assertThat(index.find(130, 50), nullValue());
+  }
+
+  @Test
+  public void testClearDropsPathsAndRecordingsInFlight() {
+    final HitTestIndex index = new HitTestIndex();
+    recordTap(index);
+    final HitTestIndex.Recording recording = index.record();
+    recording.check(0, 0, 200, 200, true);
+
+    index.clear();
+    recording.finish(Arrays.asList("root"));
+    assertThat(index.find(50, 50), nullValue());
+  }
+}
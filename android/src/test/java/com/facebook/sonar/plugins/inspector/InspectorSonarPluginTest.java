@@ -31,6 +31,8 @@ import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.Collections;
 import java.util.List;
+import java.util.concurrent.Callable;
+import java.util.concurrent.Executor;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -144,6 +146,101 @@ public class InspectorSonarPluginTest {
                 .build()));
   }
 
+  @Test
+  public void testGetNodesDescribesCapturedDataInBackground() throws Exception {
+    final List<Runnable> background = new ArrayList<>();
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(
+            mApp, mDescriptorMapping, mScriptingEnvironment, null, queueExecutor(background));
+    final SonarResponderMock responder = new SonarResponderMock();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.name = "test";
+    root.data = new SonarObject.Builder().put("prop", "value").build();
+    root.captureData = true;
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    assertThat(responder.successes.size(), equalTo(1));
+    assertThat(background.size(), equalTo(1));
+
+    background.get(0).run();
+    assertThat(
+        responder.successes,
+        hasItem(
+            new SonarObject.Builder()
+                .put(
+                    "elements",
+                    new SonarArray.Builder()
+                        .put(
+                            new SonarObject.Builder()
+                                .put("id", "test")
+                                .put("name", "test")
+                                .put(
+                                    "data",
+                                    new SonarObject.Builder()
+                                        .put(
+                                            "data",
+                                            new SonarObject.Builder().put("prop", "value")))
+                                .put("children", new SonarArray.Builder())
+                                .put("attributes", new SonarArray.Builder())
+                                .put("decoration", (String) null)
+                                .put("extraInfo", new SonarObject.Builder())))
+                .build()));
+  }
+
+  @Test
+  public void testInvalidatesNodesChangedWhileDescribed() throws Exception {
+    final List<Runnable> background = new ArrayList<>();
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(
+            mApp, mDescriptorMapping, mScriptingEnvironment, null, queueExecutor(background));
+    final SonarResponderMock responder = new SonarResponderMock();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.data = new SonarObject.Builder().put("prop", "value").build();
+    root.captureData = true;
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    plugin.mSetData.onReceive(
+        new SonarObject.Builder()
+            .put("id", "test")
+            .put("path", new SonarArray.Builder().put("data"))
+            .put("value", new SonarObject.Builder().put("prop", "updated_value"))
+            .build(),
+        responder);
+    plugin.mInvalidations.flush();
+    background.get(0).run();
+    plugin.mInvalidations.flush();
+
+    // Invalidated again after the outdated node was sent, without changes to diff against.
+    final List<Object> invalidations = connection.sent.get("invalidate");
+    assertThat(
+        invalidations.get(invalidations.size() - 1),
+        equalTo(
+            (Object)
+                new SonarObject.Builder()
+                    .put(
+                        "nodes",
+                        new SonarArray.Builder()
+                            .put(new SonarObject.Builder().put("id", "test").build())
+                            .build())
+                    .build()));
+  }
+
   @Test
   public void testGetNodesThatDontExist() throws Exception {
     final InspectorSonarPlugin plugin =
@@ -192,6 +289,7 @@ public class InspectorSonarPluginTest {
             .put("value", new SonarObject.Builder().put("prop", "updated_value"))
             .build(),
         responder);
+    plugin.mInvalidations.flush();
 
     assertThat(root.data.getString("prop"), equalTo("updated_value"));
     assertThat(
@@ -206,6 +304,95 @@ public class InspectorSonarPluginTest {
                 .build()));
   }
 
+  @Test
+  public void testInvalidatesSentNodesWithChanges() throws Exception {
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(mApp, mDescriptorMapping, mScriptingEnvironment, null);
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    final SonarResponderMock responder = new SonarResponderMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.data = new SonarObject.Builder().put("prop", "value").build();
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    plugin.mSetData.onReceive(
+        new SonarObject.Builder()
+            .put("id", "test")
+            .put("path", new SonarArray.Builder().put("data"))
+            .put("value", new SonarObject.Builder().put("prop", "updated_value"))
+            .build(),
+        responder);
+    plugin.mInvalidations.flush();
+
+    assertThat(
+        connection.sent.get("invalidate"),
+        hasItem(
+            new SonarObject.Builder()
+                .put(
+                    "nodes",
+                    new SonarArray.Builder()
+                        .put(
+                            new SonarObject.Builder()
+                                .put("id", "test")
+                                .put(
+                                    "changes",
+                                    new SonarObject.Builder()
+                                        .put(
+                                            "data",
+                                            new SonarObject.Builder()
+                                                .put(
+                                                    "data",
+                                                    new SonarObject.Builder()
+                                                        .put("prop", "updated_value")))))
+                        .build())
+                .build()));
+  }
+
+  @Test
+  public void testCoalescesInvalidations() throws Exception {
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(mApp, mDescriptorMapping, mScriptingEnvironment, null);
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    final SonarResponderMock responder = new SonarResponderMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.data = new SonarObject.Builder().put("prop", "value").build();
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    for (int i = 0; i < 3; i++) {
+      plugin.mSetData.onReceive(
+          new SonarObject.Builder()
+              .put("id", "test")
+              .put("path", new SonarArray.Builder().put("data"))
+              .put("value", new SonarObject.Builder().put("prop", "value " + i))
+              .build(),
+          responder);
+    }
+    assertThat(connection.sent.get("invalidate"), equalTo(null));
+
+    plugin.mInvalidations.flush();
+    assertThat(
+        connection.sent.get("invalidate"),
+        equalTo(
+            Arrays.<Object>asList(
+                new SonarObject.Builder()
+                    .put(
+                        "nodes",
+                        new SonarArray.Builder()
+                            .put(new SonarObject.Builder().put("id", "test").build())
+                            .build())
+                    .build())));
+  }
+
   @Test
   public void testSetHighlighted() throws Exception {
     final InspectorSonarPlugin plugin =
@@ -270,6 +457,12 @@ public class InspectorSonarPluginTest {
                 .put(
                     "path", new SonarArray.Builder().put("com.facebook.sonar").put("test").put("3"))
                 .build()));
+
+    // Answered from the hit test index, the same.
+    plugin.hitTest(12, 12);
+    final List<Object> selected = connection.sent.get("select");
+    assertThat(selected.size(), equalTo(2));
+    assertThat(selected.get(1), equalTo(selected.get(0)));
   }
 
   @Test
@@ -294,6 +487,138 @@ public class InspectorSonarPluginTest {
     Mockito.verify(decorView, Mockito.times(1)).removeView(Mockito.any(TouchOverlayView.class));
   }
 
+  @Test
+  public void testGetChildrenPages() throws Exception {
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(mApp, mDescriptorMapping, mScriptingEnvironment, null);
+    final SonarResponderMock responder = new SonarResponderMock();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.name = "test";
+    final int childCount = InspectorSonarPlugin.CHILD_PAGE_SIZE + 2;
+    for (int i = 0; i < childCount; i++) {
+      final TestNode child = new TestNode();
+      child.id = "child" + i;
+      child.name = "child";
+      root.children.add(child);
+    }
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    final SonarObject element =
+        ((SonarObject) responder.successes.get(1)).getArray("elements").getObject(0);
+    assertThat(element.getInt("childCount"), equalTo(childCount));
+    assertThat(
+        element.getArray("children").length(), equalTo(InspectorSonarPlugin.CHILD_PAGE_SIZE));
+
+    plugin.mGetChildren.onReceive(
+        new SonarObject.Builder()
+            .put("id", "test")
+            .put("offset", InspectorSonarPlugin.CHILD_PAGE_SIZE)
+            .put("count", InspectorSonarPlugin.CHILD_PAGE_SIZE)
+            .build(),
+        responder);
+    assertThat(
+        responder.successes,
+        hasItem(
+            new SonarObject.Builder()
+                .put("id", "test")
+                .put("offset", InspectorSonarPlugin.CHILD_PAGE_SIZE)
+                .put("childCount", childCount)
+                .put(
+                    "children",
+                    new SonarArray.Builder()
+                        .put("child" + InspectorSonarPlugin.CHILD_PAGE_SIZE)
+                        .put("child" + (InspectorSonarPlugin.CHILD_PAGE_SIZE + 1)))
+                .build()));
+  }
+
+  @Test
+  public void testGetSubtree() throws Exception {
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(mApp, mDescriptorMapping, mScriptingEnvironment, null);
+    final SonarResponderMock responder = new SonarResponderMock();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.name = "test";
+    final TestNode child = new TestNode();
+    child.id = "child";
+    child.name = "child";
+    final TestNode grandchild = new TestNode();
+    grandchild.id = "grandchild";
+    grandchild.name = "grandchild";
+    child.children.add(grandchild);
+    root.children.add(child);
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    plugin.mGetSubtree.onReceive(
+        new SonarObject.Builder().put("id", "test").put("depth", 1).build(), responder);
+    SonarObject subtree = (SonarObject) responder.successes.get(1);
+    assertThat(subtree.getArray("elements").length(), equalTo(2));
+    assertThat(subtree.getArray("elements").getObject(1).getString("id"), equalTo("child"));
+    assertThat(subtree.getBoolean("complete"), equalTo(true));
+
+    plugin.mGetSubtree.onReceive(
+        new SonarObject.Builder().put("id", "test").put("depth", 5).build(), responder);
+    subtree = (SonarObject) responder.successes.get(2);
+    assertThat(subtree.getArray("elements").length(), equalTo(3));
+    assertThat(subtree.getArray("elements").getObject(2).getString("id"), equalTo("grandchild"));
+  }
+
+  @Test
+  public void testPrefetchesChildrenOfFetchedNodes() throws Exception {
+    final InspectorSonarPlugin plugin =
+        new InspectorSonarPlugin(mApp, mDescriptorMapping, mScriptingEnvironment, null);
+    final SonarResponderMock responder = new SonarResponderMock();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    final TestNode root = new TestNode();
+    root.id = "test";
+    root.name = "test";
+    for (int i = 0; i < 2; i++) {
+      final TestNode child = new TestNode();
+      child.id = "child" + i;
+      child.name = "child";
+      root.children.add(child);
+    }
+    mApplicationDescriptor.root = root;
+
+    plugin.mGetRoot.onReceive(null, responder);
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    plugin.prefetch();
+    assertThat(connection.sent.get("prefetched"), equalTo(null));
+
+    plugin.mSetPrefetch.onReceive(new SonarObject.Builder().put("enabled", true).build(), responder);
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    plugin.prefetch();
+    final SonarArray prefetched =
+        ((SonarObject) connection.sent.get("prefetched").get(0)).getArray("elements");
+    assertThat(prefetched.length(), equalTo(2));
+    assertThat(prefetched.getObject(0).getString("id"), equalTo("child0"));
+
+    // Sent once only.
+    plugin.mGetNodes.onReceive(
+        new SonarObject.Builder().put("ids", new SonarArray.Builder().put("test")).build(),
+        responder);
+    plugin.prefetch();
+    assertThat(connection.sent.get("prefetched").size(), equalTo(1));
+  }
+
   @Test(expected = AssertionError.class)
   public void testNullChildThrows() throws Exception {
     final InspectorSonarPlugin plugin =
@@ -315,6 +640,15 @@ public class InspectorSonarPluginTest {
         responder);
   }
 
+  private static Executor queueExecutor(final List<Runnable> queue) {
+    return new Executor() {
+      @Override
+      public void execute(Runnable runnable) {
+        queue.add(runnable);
+      }
+    };
+  }
+
   private class TestNode {
     String id;
     String name;
@@ -324,6 +658,8 @@ public class InspectorSonarPluginTest {
     String decoration;
     boolean highlighted;
     Rect bounds = new Rect();
+    // Whether its descriptor leaves describing its data to a background thread.
+    boolean captureData;
   }
 
   private class TestNodeDescriptor extends NodeDescriptor<TestNode> {
@@ -356,6 +692,20 @@ public class InspectorSonarPluginTest {
       return Collections.singletonList(new Named<>("data", node.data));
     }
 
+    @Override
+    public Callable<List<Named<SonarObject>>> captureData(final TestNode node) {
+      if (!node.captureData) {
+        return null;
+      }
+      final SonarObject data = node.data;
+      return new Callable<List<Named<SonarObject>>>() {
+        @Override
+        public List<Named<SonarObject>> call() {
+          return Collections.singletonList(new Named<>("data", data));
+        }
+      };
+    }
+
     @Override
     public void setValue(TestNode node, String[] path, SonarDynamic value) throws Exception {
       if (path[0].equals("data")) {
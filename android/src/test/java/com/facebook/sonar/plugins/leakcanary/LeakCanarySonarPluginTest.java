@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.plugins.leakcanary;
+
+import static org.hamcrest.CoreMatchers.equalTo;
+import static org.hamcrest.CoreMatchers.nullValue;
+import static org.hamcrest.MatcherAssert.assertThat;
+
+import com.facebook.sonar.core.SonarObject;
+import com.facebook.sonar.testing.SonarConnectionMock;
+import com.facebook.sonar.testing.SonarResponderMock;
+import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
+import java.util.List;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+@RunWith(WithTestDefaultsRunner.class)
+public class LeakCanarySonarPluginTest {
+
+  private static String leakInfo(String leaked, String key) {
+    return "In com.example:1.0:1.\n"
+        + "* com.example." + leaked + " has leaked:\n"
+        + "* GC ROOT static com.example.Cache.sInstance\n"
+        + "* references com.example.Cache.mItems\n"
+        + "* leaks com.example." + leaked + " instance\n"
+        + "* Retaining: 12 KB.\n"
+        + "* Reference Key: " + key + "\n"
+        + "* Details:\n"
+        + "* Instance of com.example." + leaked + "\n"
+        + "|   mField = 1\n";
+  }
+
+  @Test
+  public void testSendsSummaryPerLeak() throws Exception {
+    final LeakCanarySonarPlugin plugin = new LeakCanarySonarPlugin();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    plugin.reportLeak(leakInfo("MainActivity", "1"));
+    plugin.reportLeak(leakInfo("OtherActivity", "2"));
+
+    final List<Object> sent = connection.sent.get("leak");
+    assertThat(sent.size(), equalTo(2));
+    final SonarObject summary = (SonarObject) sent.get(0);
+    assertThat(summary.getInt("id"), equalTo(0));
+    assertThat(summary.getString("title"), equalTo("leaks com.example.MainActivity instance"));
+    assertThat(summary.getString("retainedSize"), equalTo("12 KB"));
+    assertThat(summary.getInt("count"), equalTo(1));
+    assertThat(((SonarObject) sent.get(1)).getInt("id"), equalTo(1));
+  }
+
+  @Test
+  public void testCountsRepeatedLeaks() throws Exception {
+    final LeakCanarySonarPlugin plugin = new LeakCanarySonarPlugin();
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+
+    plugin.reportLeak(leakInfo("MainActivity", "1"));
+    plugin.reportLeak(leakInfo("MainActivity", "2"));
+
+    final List<Object> sent = connection.sent.get("leak");
+    assertThat(sent.size(), equalTo(2));
+    final SonarObject summary = (SonarObject) sent.get(1);
+    assertThat(summary.getInt("id"), equalTo(0));
+    assertThat(summary.getInt("count"), equalTo(2));
+  }
+
+  @Test
+  public void testSendsTraceOnDemand() throws Exception {
+    final LeakCanarySonarPlugin plugin = new LeakCanarySonarPlugin();
+    final String info = leakInfo("MainActivity", "1");
+    plugin.reportLeak(info);
+    // Leaks found while disconnected are summarized on connect.
+    final SonarConnectionMock connection = new SonarConnectionMock();
+    plugin.onConnect(connection);
+    assertThat(connection.sent.get("leak").size(), equalTo(1));
+
+    final SonarResponderMock responder = new SonarResponderMock();
+    connection
+        .receivers
+        .get("getLeak")
+        .onReceive(new SonarObject.Builder().put("id", 0).build(), responder);
+    assertThat(((SonarObject) responder.successes.get(0)).getString("info"), equalTo(info));
+
+    connection
+        .receivers
+        .get("getLeak")
+        .onReceive(new SonarObject.Builder().put("id", 1).build(), responder);
+    assertThat(responder.errors.size(), equalTo(1));
+  }
+
+  @Test
+  public void testIgnoresNonLeaks() throws Exception {
+    assertThat(LeakCanarySonarPlugin.signature("In com.example:1.0:1.\nNo leak.\n"), nullValue());
+  }
+}
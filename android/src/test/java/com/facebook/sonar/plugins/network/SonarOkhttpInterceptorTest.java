@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.sonar.plugins.network;
+
+import static org.hamcrest.CoreMatchers.equalTo;
+import static org.hamcrest.CoreMatchers.nullValue;
+import static org.hamcrest.MatcherAssert.assertThat;
+
+import com.facebook.sonar.plugins.network.NetworkReporter.RequestInfo;
+import com.facebook.sonar.plugins.network.NetworkReporter.ResponseInfo;
+import com.facebook.testing.robolectric.v3.WithTestDefaultsRunner;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.Executor;
+import okhttp3.Interceptor;
+import okhttp3.MediaType;
+import okhttp3.OkHttpClient;
+import okhttp3.Protocol;
+import okhttp3.Request;
+import okhttp3.Response;
+import okhttp3.ResponseBody;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+@RunWith(WithTestDefaultsRunner.class)
+public class SonarOkhttpInterceptorTest {
+
+  private final List<ResponseInfo> mResponses = new ArrayList<>();
+  private OkHttpClient mClient;
+
+  @Before
+  public void setup() {
+    final NetworkReporter reporter =
+        new NetworkReporter() {
+          @Override
+          public void reportRequest(RequestInfo requestInfo) {}
+
+          @Override
+          public void reportResponse(ResponseInfo responseInfo) {
+            mResponses.add(responseInfo);
+          }
+        };
+    // Report right away rather than on the executor.
+    final Executor executor =
+        new Executor() {
+          @Override
+          public void execute(Runnable command) {
+            command.run();
+          }
+        };
+    // Answers every request without going to the network.
+    final Interceptor server =
+        new Interceptor() {
+          @Override
+          public Response intercept(Chain chain) throws IOException {
+            return new Response.Builder()
+                .request(chain.request())
+                .protocol(Protocol.HTTP_1_1)
+                .code(200)
+                .message("OK")
+                .header("Content-Type", "text/plain")
+                .body(ResponseBody.create(MediaType.parse("text/plain"), "hello"))
+                .build();
+          }
+        };
+    mClient =
+        new OkHttpClient.Builder()
+            .addInterceptor(new SonarOkhttpInterceptor(reporter, executor))
+            .addInterceptor(server)
+            .build();
+  }
+
+  @Test
+  public void reportsResponseBeforeItsBodyIsRead() throws Exception {
+    final Response response = execute();
+
+    assertThat(mResponses.size(), equalTo(1));
+    assertThat(mResponses.get(0).statusCode, equalTo(200));
+    assertThat(mResponses.get(0).bodyPending, equalTo(true));
+    assertThat(mResponses.get(0).body, nullValue());
+    assertThat(mResponses.get(0).getFirstHeader("content-type").value, equalTo("text/plain"));
+    response.close();
+  }
+
+  @Test
+  public void reportsBodyOnceRead() throws Exception {
+    final Response response = execute();
+    assertThat(response.body().string(), equalTo("hello"));
+
+    assertThat(mResponses.size(), equalTo(2));
+    final ResponseInfo withBody = mResponses.get(1);
+    assertThat(withBody.requestId, equalTo(mResponses.get(0).requestId));
+    assertThat(withBody.bodyPending, equalTo(false));
+    assertThat(new String(withBody.body), equalTo("hello"));
+  }
+
+  private Response execute() throws IOException {
+    return mClient.newCall(new Request.Builder().url("https://example.com/").build()).execute();
+  }
+}
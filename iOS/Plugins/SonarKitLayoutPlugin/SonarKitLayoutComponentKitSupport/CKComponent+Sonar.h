@@ -14,6 +14,11 @@ FB_LINK_REQUIRE(CKComponent_Sonar)
 @interface CKComponent (Sonar)
 
 - (NSArray<SKNamed<NSDictionary<NSString *, NSObject *> *> *> *)sonar_getData;
+/**
+ Same as sonar_getData, but with the view context captured on the main
+ thread beforehand, which makes it safe to call from any thread.
+ */
+- (NSArray<SKNamed<NSDictionary<NSString *, NSObject *> *> *> *)sonar_getDataWithViewContext:(const CKComponentViewContext &)viewContext;
 - (NSDictionary<NSString *, SKNodeUpdateData> *)sonar_getDataMutations;
 - (NSString *)sonar_getName;
 - (NSString *)sonar_getDecoration;
@@ -71,6 +71,11 @@ FB_LINKABLE(CKComponent_Sonar)
 }
 
 - (NSArray<SKNamed<NSDictionary<NSString *, NSObject *> *> *> *)sonar_getData
+{
+  return [self sonar_getDataWithViewContext: self.viewContext];
+}
+
+- (NSArray<SKNamed<NSDictionary<NSString *, NSObject *> *> *> *)sonar_getDataWithViewContext:(const CKComponentViewContext &)viewContext
 {
   static NSDictionary<NSNumber *, NSString *> *UIControlEventsEnumMap = @{
                                                                           @(UIControlEventTouchDown): @"UIControlEventTouchDown",
@@ -97,11 +102,11 @@ FB_LINKABLE(CKComponent_Sonar)
 
   [data addObject: [SKNamed newWithName: @"CKComponent"
                                          withValue: @{
-                                                      @"frame": SKObject(self.viewContext.frame),
+                                                      @"frame": SKObject(viewContext.frame),
                                                       @"controller": SKObject(NSStringFromClass([self.controller class])),
                                                       }]];
 
-  if (self.viewContext.view) {
+  if (viewContext.view) {
     auto _actions = _CKComponentDebugControlActionsForComponent(self);
     if (_actions.size() > 0) {
       NSMutableDictionary<NSString *, NSObject *> *actions = [NSMutableDictionary new];
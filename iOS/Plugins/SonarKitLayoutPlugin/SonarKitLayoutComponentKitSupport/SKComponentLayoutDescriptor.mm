@@ -92,7 +92,7 @@
     [data addObject: [SKNamed newWithName:@"Layout" withValue:[self propsForFlexboxChild:node.flexboxChild]]];
   }
 
-  [data addObjectsFromArray:[node.component sonar_getData]];
+  [data addObjectsFromArray:[node.component sonar_getDataWithViewContext: node.viewContext]];
 
   return data;
 }
@@ -129,10 +129,16 @@
 - (NSArray<SKNamed<NSString *> *> *)attributesForNode:(SKComponentLayoutWrapper *)node {
   return @[
            [SKNamed newWithName: @"responder"
-                      withValue: SKObject(NSStringFromClass([node.component.nextResponder class]))]
+                      withValue: SKObject(NSStringFromClass(node.nextResponderClass))]
            ];
 }
 
+- (BOOL)canDescribeNodeOffMainThread:(SKComponentLayoutWrapper *)node {
+  // Everything but the children comes from the component and its layout,
+  // which are immutable once mounted.
+  return YES;
+}
+
 - (void)setHighlighted:(BOOL)highlighted forNode:(SKComponentLayoutWrapper *)node {
   SKHighlightOverlay *overlay = [SKHighlightOverlay sharedInstance];
   if (highlighted) {
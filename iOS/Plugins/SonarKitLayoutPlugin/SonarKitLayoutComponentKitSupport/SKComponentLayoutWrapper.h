@@ -20,6 +20,11 @@
 @property (nonatomic, readonly) CGPoint position;
 @property (nonatomic, readonly) std::vector<SKComponentLayoutWrapper *> children;
 
+// Captured on the main thread when the wrapper is created, so that the
+// layout can be described from other threads.
+@property (nonatomic, readonly) CKComponentViewContext viewContext;
+@property (nonatomic, readonly) Class nextResponderClass;
+
 // Null for layouts which are not direct children of a CKFlexboxComponent
 @property (nonatomic, readonly) BOOL isFlexboxChild;
 @property (nonatomic, readonly) CKFlexboxComponentChild flexboxChild;
@@ -54,6 +54,8 @@ static CKFlexboxComponentChild findFlexboxLayoutParams(CKComponent *parent, CKCo
   if (self = [super init]) {
     _component = layout.component;
     _size = layout.size;
+    _viewContext = layout.component.viewContext;
+    _nextResponderClass = [layout.component.nextResponder class];
     _position = position;
     _identifier = [parentKey stringByAppendingString:layout.component ? NSStringFromClass([layout.component class]) : @"(null)"];
 
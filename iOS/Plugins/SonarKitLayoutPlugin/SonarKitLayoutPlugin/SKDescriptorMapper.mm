@@ -15,9 +15,15 @@
 #import "SKViewControllerDescriptor.h"
 #import "SKViewDescriptor.h"
 
+#include <unordered_map>
+
 @implementation SKDescriptorMapper
 {
   NSMutableDictionary<NSString *, SKNodeDescriptor *> *_descriptors;
+  // What each class looked up resolved to, including through its superclasses
+  // and to nil, so that tree walks don't go up the hierarchy for every node.
+  // Cleared when a descriptor is registered.
+  std::unordered_map<Class, SKNodeDescriptor *> _resolved;
 }
 
 - (instancetype)initWithDefaults {
@@ -40,19 +46,27 @@
 }
 
 - (SKNodeDescriptor *)descriptorForClass:(Class)cls {
+  const auto resolved = _resolved.find(cls);
+  if (resolved != _resolved.end()) {
+    return resolved->second;
+  }
+
   SKNodeDescriptor *classDescriptor = nil;
+  Class registered = cls;
 
-  while (classDescriptor == nil && cls != nil) {
-    classDescriptor = [_descriptors objectForKey: NSStringFromClass(cls)];
-    cls = [cls superclass];
+  while (classDescriptor == nil && registered != nil) {
+    classDescriptor = [_descriptors objectForKey: NSStringFromClass(registered)];
+    registered = [registered superclass];
   }
 
+  _resolved[cls] = classDescriptor;
   return classDescriptor;
 }
 
 - (void)registerDescriptor:(SKNodeDescriptor *)descriptor forClass:(Class)cls {
   NSString *className = NSStringFromClass(cls);
   _descriptors[className] = descriptor;
+  _resolved.clear();
 }
 
 - (NSArray<SKNodeDescriptor *> *)allDescriptors {
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#pragma once
+
+#import <UIKit/UIKit.h>
+
+#import <unordered_map>
+#import <utility>
+#import <vector>
+
+@class SKDescriptorMapper;
+
+/**
+ The views below some roots, read in a single pass on the main thread into
+ one array per field, and encoded for the desktop later on any thread. The
+ pass only copies raw values: frames, alphas, flags, classes and the texts of
+ labels, fields and buttons, which are immutable copies. Formatting ids,
+ naming classes and building the response all happen in encode.
+
+ Views are walked in depth first order, parents first, skipping hidden ones
+ as SKViewDescriptor does, but without listing view controllers in between.
+ Views with a descriptor other than the UIKit ones, such as ComponentKit's,
+ are captured without their children, the desktop expands those with
+ getNodes.
+ */
+class SKHierarchyCapture
+{
+public:
+  // Bits of the flags of a view.
+  static const uint8_t kUserInteractionEnabled = 1 << 0;
+  static const uint8_t kClipsToBounds = 1 << 1;
+  static const uint8_t kChildrenNotCaptured = 1 << 2;
+
+  /**
+   Main thread only. Captures at most maxNodes views.
+   */
+  SKHierarchyCapture(NSArray<UIView *> *roots, SKDescriptorMapper *mapper, NSUInteger maxNodes);
+
+  /**
+   Any thread. The response to getViewHierarchy: ids, parents (as indexes,
+   -1 for roots), classes (as indexes into classNames), frames (4 numbers per
+   view), alphas and flags, one of each per view, the texts of the views at
+   textIndexes, and whether it was complete.
+   */
+  NSDictionary *encode() const;
+
+  /**
+   The captured views, to track them with the ids encode gave them. Main
+   thread only, views must not be deallocated off it, which is also why they
+   are released with releaseViews rather than along with the capture.
+   */
+  const std::vector<UIView *> &views() const
+  {
+    return _views;
+  }
+
+  void releaseViews();
+
+private:
+  enum class Kind : uint8_t {
+    // Walked like SKViewDescriptor walks them, id from the address.
+    view,
+    // No children, id from the address, e.g. buttons.
+    leaf,
+    // Described by some other descriptor, id from it.
+    other,
+  };
+
+  enum class Text : uint8_t {
+    none,
+    label,
+    field,
+    textView,
+    button,
+  };
+
+  struct ClassInfo {
+    __unsafe_unretained Class cls;
+    Kind kind;
+    Text text;
+  };
+
+  uint32_t classIndex(Class cls, SKDescriptorMapper *mapper);
+
+  std::vector<ClassInfo> _classes;
+  std::unordered_map<const void *, uint32_t> _classIndexes;
+
+  std::vector<UIView *> _views;
+  std::vector<int32_t> _parents;
+  std::vector<uint32_t> _classOfView;
+  std::vector<CGRect> _frames;
+  std::vector<float> _alphas;
+  std::vector<uint8_t> _flags;
+  std::vector<std::pair<uint32_t, NSString *>> _texts;
+  // Of views of Kind::other only.
+  std::vector<std::pair<uint32_t, NSString *>> _identifiers;
+  bool _complete = true;
+};
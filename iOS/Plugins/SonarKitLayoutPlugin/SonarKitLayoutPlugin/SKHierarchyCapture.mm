@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#if FB_SONARKIT_ENABLED
+
+#import "SKHierarchyCapture.h"
+
+#import "SKButtonDescriptor.h"
+#import "SKDescriptorMapper.h"
+#import "SKNodeDescriptor.h"
+#import "SKScrollViewDescriptor.h"
+#import "SKViewDescriptor.h"
+
+SKHierarchyCapture::SKHierarchyCapture(NSArray<UIView *> *roots, SKDescriptorMapper *mapper, NSUInteger maxNodes)
+{
+  std::vector<std::pair<UIView *, int32_t>> pending;
+  for (UIView *root in [roots reverseObjectEnumerator]) {
+    pending.emplace_back(root, -1);
+  }
+  while (!pending.empty()) {
+    if (_views.size() == maxNodes) {
+      _complete = false;
+      break;
+    }
+    UIView *view = pending.back().first;
+    const int32_t parent = pending.back().second;
+    pending.pop_back();
+
+    const int32_t index = (int32_t)_views.size();
+    const uint32_t cls = classIndex([view class], mapper);
+    const ClassInfo &info = _classes[cls];
+    _views.push_back(view);
+    _parents.push_back(parent);
+    _classOfView.push_back(cls);
+    _frames.push_back(view.frame);
+    _alphas.push_back((float)view.alpha);
+    uint8_t flags = 0;
+    if (view.userInteractionEnabled) {
+      flags |= kUserInteractionEnabled;
+    }
+    if (view.clipsToBounds) {
+      flags |= kClipsToBounds;
+    }
+
+    NSString *text = nil;
+    switch (info.text) {
+      case Text::none:
+        break;
+      case Text::label:
+        text = ((UILabel *)view).text;
+        break;
+      case Text::field:
+        text = ((UITextField *)view).text;
+        break;
+      case Text::textView:
+        text = ((UITextView *)view).text;
+        break;
+      case Text::button:
+        text = ((UIButton *)view).currentTitle;
+        break;
+    }
+    if (text != nil) {
+      // Only copies mutable strings, immutable ones are just retained.
+      _texts.emplace_back(index, [text copy]);
+    }
+
+    switch (info.kind) {
+      case Kind::view:
+        for (UIView *child in [view.subviews reverseObjectEnumerator]) {
+          if (!child.isHidden) {
+            pending.emplace_back(child, index);
+          }
+        }
+        break;
+      case Kind::leaf:
+        break;
+      case Kind::other:
+        flags |= kChildrenNotCaptured;
+        _identifiers.emplace_back(index, [[mapper descriptorForClass: info.cls] identifierForNode: view]);
+        break;
+    }
+    _flags.push_back(flags);
+  }
+}
+
+uint32_t SKHierarchyCapture::classIndex(Class cls, SKDescriptorMapper *mapper)
+{
+  const auto found = _classIndexes.find((__bridge const void *)cls);
+  if (found != _classIndexes.end()) {
+    return found->second;
+  }
+  SKNodeDescriptor *descriptor = [mapper descriptorForClass: cls];
+  Kind kind = Kind::other;
+  if ([descriptor isMemberOfClass: [SKViewDescriptor class]] || [descriptor isMemberOfClass: [SKScrollViewDescriptor class]]) {
+    kind = Kind::view;
+  } else if ([descriptor isMemberOfClass: [SKButtonDescriptor class]]) {
+    kind = Kind::leaf;
+  }
+  Text text = Text::none;
+  if ([cls isSubclassOfClass: [UILabel class]]) {
+    text = Text::label;
+  } else if ([cls isSubclassOfClass: [UITextField class]]) {
+    text = Text::field;
+  } else if ([cls isSubclassOfClass: [UITextView class]]) {
+    text = Text::textView;
+  } else if ([cls isSubclassOfClass: [UIButton class]]) {
+    text = Text::button;
+  }
+  const uint32_t index = (uint32_t)_classes.size();
+  _classes.push_back(ClassInfo{cls, kind, text});
+  _classIndexes[(__bridge const void *)cls] = index;
+  return index;
+}
+
+NSDictionary *SKHierarchyCapture::encode() const
+{
+  const NSUInteger count = _views.size();
+  NSMutableArray<NSString *> *ids = [NSMutableArray arrayWithCapacity: count];
+  NSMutableArray<NSNumber *> *parents = [NSMutableArray arrayWithCapacity: count];
+  NSMutableArray<NSNumber *> *classes = [NSMutableArray arrayWithCapacity: count];
+  NSMutableArray<NSNumber *> *frames = [NSMutableArray arrayWithCapacity: count * 4];
+  NSMutableArray<NSNumber *> *alphas = [NSMutableArray arrayWithCapacity: count];
+  NSMutableArray<NSNumber *> *flags = [NSMutableArray arrayWithCapacity: count];
+  auto identifier = _identifiers.begin();
+  for (NSUInteger i = 0; i < count; i++) {
+    if (identifier != _identifiers.end() && identifier->first == i) {
+      [ids addObject: identifier->second ?: @"(unknown)"];
+      ++identifier;
+    } else {
+      // As SKViewDescriptor identifies them, the view itself isn't messaged.
+      [ids addObject: [NSString stringWithFormat: @"%p", (__bridge void *)_views[i]]];
+    }
+    [parents addObject: @(_parents[i])];
+    [classes addObject: @(_classOfView[i])];
+    const CGRect &frame = _frames[i];
+    [frames addObject: @(frame.origin.x)];
+    [frames addObject: @(frame.origin.y)];
+    [frames addObject: @(frame.size.width)];
+    [frames addObject: @(frame.size.height)];
+    [alphas addObject: @(_alphas[i])];
+    [flags addObject: @(_flags[i])];
+  }
+
+  NSMutableArray<NSString *> *classNames = [NSMutableArray arrayWithCapacity: _classes.size()];
+  for (const auto &info : _classes) {
+    [classNames addObject: NSStringFromClass(info.cls)];
+  }
+
+  NSMutableArray<NSNumber *> *textIndexes = [NSMutableArray arrayWithCapacity: _texts.size()];
+  NSMutableArray<NSString *> *texts = [NSMutableArray arrayWithCapacity: _texts.size()];
+  for (const auto &text : _texts) {
+    [textIndexes addObject: @(text.first)];
+    [texts addObject: text.second];
+  }
+
+  return @{
+           @"ids": ids,
+           @"parents": parents,
+           @"classes": classes,
+           @"classNames": classNames,
+           @"frames": frames,
+           @"alphas": alphas,
+           @"flags": flags,
+           @"textIndexes": textIndexes,
+           @"texts": texts,
+           @"complete": @(_complete),
+           };
+}
+
+void SKHierarchyCapture::releaseViews()
+{
+  _views.clear();
+  _views.shrink_to_fit();
+}
+
+#endif
@@ -112,4 +112,11 @@ typedef void (^SKNodeUpdateData)(id value);
  */
 - (BOOL)matchesQuery:(NSString *)query forNode:(T)node;
 
+/**
+ Whether the name, decoration, attributes and data of this node may be read
+ off the main thread, concurrently with other nodes. Children are always
+ listed on the main thread. Defaults to NO.
+ */
+- (BOOL)canDescribeNodeOffMainThread:(T)node;
+
 @end
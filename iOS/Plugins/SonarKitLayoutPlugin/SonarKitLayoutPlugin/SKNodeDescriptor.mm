@@ -74,6 +74,10 @@
   return [self string:name contains:query] || [self string:[self identifierForNode: node] contains: query];
 }
 
+- (BOOL)canDescribeNodeOffMainThread:(id)node {
+  return NO;
+}
+
 - (BOOL)string:(NSString *)string contains:(NSString *)substring {
   return string != nil && substring != nil && [string rangeOfString: substring options: NSCaseInsensitiveSearch].location != NSNotFound;
 }
@@ -12,23 +12,183 @@
 #import <SonarKit/SonarClient.h>
 #import <SonarKit/SonarConnection.h>
 #import <SonarKit/SonarResponder.h>
+#import <SonarKit/SonarStreamResponder.h>
 #import <SonarKit/SKMacros.h>
 #import "SKDescriptorMapper.h"
+#import "SKHierarchyCapture.h"
 #import "SKNodeDescriptor.h"
 #import "SKTapListener.h"
 #import "SKTapListenerImpl.h"
 #import "SKSearchResultNode.h"
-#import <mutex>
+#import "UIView+SKInvalidation.h"
+#import <FBCxxUtils/FBCxxFollyDynamicConvert.h>
+#import <QuartzCore/QuartzCore.h>
+#import <folly/hash/Hash.h>
+#import <algorithm>
+#import <atomic>
+#import <memory>
+#import <string>
+#import <unordered_map>
+#import <vector>
+
+/**
+ What the desktop was last sent for a node. Attributes and data are only
+ kept as hashes of their JSON.
+ */
+struct SKSentNode {
+  NSString *name;
+  NSString *decoration;
+  NSArray<NSString *> *children;
+  uint64_t attributesHash;
+  std::unordered_map<std::string, uint64_t> dataHashes;
+};
+
+static uint64_t SKContentHash(id value)
+{
+  auto json = facebook::cxxutils::convertIdToJSON(value, true);
+  json->coalesce();
+  return folly::hash::fnv64_buf(json->data(), json->length());
+}
+
+static SKSentNode SKSentNodeForElement(NSDictionary *element)
+{
+  SKSentNode sent;
+  sent.name = element[@"name"];
+  sent.decoration = element[@"decoration"];
+  sent.children = element[@"children"];
+  sent.attributesHash = SKContentHash(element[@"attributes"]);
+  NSDictionary *data = element[@"data"];
+  for (NSString *section in data) {
+    sent.dataHashes[[section UTF8String]] = SKContentHash(data[section]);
+  }
+  return sent;
+}
+
+/**
+ What search knows about a node without asking its descriptor again. The
+ descriptor is only kept for nodes whose descriptor overrides
+ matchesQuery:forNode:, those are still asked on every query.
+ */
+struct SKSearchIndexEntry {
+  NSString *nodeId;
+  NSString *name;
+  NSString *parentId;
+  NSArray<NSString *> *children;
+  SKNodeDescriptor *matcher;
+};
+
+static BOOL SKStringContains(NSString *string, NSString *substring)
+{
+  return string != nil && substring != nil && [string rangeOfString: substring options: NSCaseInsensitiveSearch].location != NSNotFound;
+}
+
+/**
+ Ids of invalidated nodes, pushed from any thread without locking and
+ drained on the main thread. Ids may be pushed more than once.
+ */
+class SKPendingInvalidations
+{
+public:
+  ~SKPendingInvalidations()
+  {
+    drain(nil);
+  }
+
+  /**
+   Returns whether the list was empty, in which case whoever drains it
+   needs to be woken up.
+   */
+  bool push(NSString *nodeId)
+  {
+    Node *node = new Node{nodeId, _head.load(std::memory_order_relaxed)};
+    while (!_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) { }
+    return node->next == nullptr;
+  }
+
+  void drain(NSMutableSet<NSString *> *into)
+  {
+    Node *node = _head.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+      Node *next = node->next;
+      [into addObject: node->nodeId];
+      delete node;
+      node = next;
+    }
+  }
+
+private:
+  struct Node {
+    NSString *nodeId;
+    Node *next;
+  };
+
+  std::atomic<Node *> _head{nullptr};
+};
+
+// Invalidations are sent at most once every this many frames. The interval
+// grows while sending them takes more than kInvalidationFrameBudget of the
+// frames in between, and shrinks back once it's cheap again.
+static const NSInteger kMinFramesPerInvalidation = 6;
+static const NSInteger kMaxFramesPerInvalidation = 60;
+static const CFTimeInterval kInvalidationFrameBudget = 0.25;
+
+// Released objects are swept from the tracking table once it has grown to
+// twice the size it had after the previous sweep.
+static const NSUInteger kMinTrackedObjectsBeforePruning = 256;
+
+// Elements list at most this many children, the desktop asks for more with
+// getChildren as they're needed. Lists of cells can be long.
+static const NSUInteger kChildPageSize = 200;
+
+// getSubtree describes at most this many nodes, the desktop fetches the rest
+// as usual.
+static const NSUInteger kSubtreeMaxNodes = 1000;
+
+// getViewHierarchy captures at most this many views, unless asked for fewer.
+static const NSUInteger kViewHierarchyMaxNodes = 10000;
+
+// Prefetching sends at most this many nodes per turn of the main run loop.
+static const NSUInteger kPrefetchNodesPerTurn = 50;
+
+// Streamed searches match the index in slices of the main thread this long,
+// sending what each slice found.
+static const CFTimeInterval kSearchSliceDuration = 0.008;
+
+/**
+ Forwards display link callbacks without the display link retaining the
+ plugin.
+ */
+@interface SKInvalidationDisplayLinkTarget : NSObject
+@property (nonatomic, weak) SonarKitLayoutPlugin *plugin;
+@end
+
+@interface SonarKitLayoutPlugin ()
+- (void)onDisplayLink:(CADisplayLink *)displayLink;
+@end
+
+@implementation SKInvalidationDisplayLinkTarget
+
+- (void)onDisplayLink:(CADisplayLink *)displayLink {
+  [_plugin onDisplayLink: displayLink];
+}
+
+@end
 
 @implementation SonarKitLayoutPlugin
 {
 
+  // Holds objects weakly, but NSMapTable keeps the entries of released ones
+  // until they are swept out by pruneTrackedObjects.
   NSMapTable<NSString *, id> *_trackedObjects;
+  NSUInteger _trackedObjectsPruneThreshold;
   NSString *_lastHighlightedNode;
-  NSMutableSet *_invalidObjects;
-  Boolean _invalidateMessageQueued;
-  NSDate *_lastInvalidateMessage;
-  std::mutex invalidObjectsMutex;
+  SKPendingInvalidations _pendingInvalidations;
+  // Drained from _pendingInvalidations, waiting for the next flush. Only
+  // accessed on the main thread, like everything below.
+  NSMutableSet<NSString *> *_invalidObjects;
+  CADisplayLink *_invalidationDisplayLink;
+  NSInteger _framesPerInvalidation;
+  NSInteger _framesSinceInvalidation;
 
   id<NSObject> _rootNode;
   id<SKTapListener> _tapListener;
@@ -36,6 +196,26 @@
   id<SonarConnection> _connection;
 
   NSMutableSet *_registeredDelegates;
+
+  // Nodes the desktop has been sent, by id. Invalidations of these only
+  // carry what changed since. Only accessed on the main thread.
+  std::unordered_map<std::string, SKSentNode> _sentNodes;
+
+  // Every node below the root by id, built by the first search and then only
+  // updated where nodes were invalidated. Only accessed on the main thread.
+  std::unordered_map<std::string, SKSearchIndexEntry> _searchIndex;
+  // Nodes invalidated since the index was last updated.
+  NSMutableSet<NSString *> *_staleSearchNodes;
+  // Bumped by every search, streamed searches stop once it moves on.
+  NSUInteger _searchGeneration;
+
+  // Set by the desktop with setPrefetch. Nodes it fetched, whose children
+  // are sent from _prefetchNext on of the first. Only accessed on the main
+  // thread.
+  BOOL _prefetch;
+  BOOL _prefetchScheduled;
+  NSMutableArray<NSString *> *_prefetchQueue;
+  NSUInteger _prefetchNext;
 }
 
 - (instancetype)initWithRootNode:(id<NSObject>)rootNode
@@ -51,10 +231,19 @@
   if (self = [super init]) {
     _descriptorMapper = mapper;
     _trackedObjects = [NSMapTable strongToWeakObjectsMapTable];
+    _trackedObjectsPruneThreshold = kMinTrackedObjectsBeforePruning;
     _lastHighlightedNode = nil;
     _invalidObjects = [NSMutableSet new];
-    _invalidateMessageQueued = false;
-    _lastInvalidateMessage = [NSDate date];
+    _staleSearchNodes = [NSMutableSet new];
+    _prefetchQueue = [NSMutableArray new];
+    _framesPerInvalidation = kMinFramesPerInvalidation;
+    _framesSinceInvalidation = kMinFramesPerInvalidation;
+
+    SKInvalidationDisplayLinkTarget *target = [SKInvalidationDisplayLinkTarget new];
+    target.plugin = self;
+    _invalidationDisplayLink = [CADisplayLink displayLinkWithTarget: target selector: @selector(onDisplayLink:)];
+    _invalidationDisplayLink.paused = YES;
+    [_invalidationDisplayLink addToRunLoop: [NSRunLoop mainRunLoop] forMode: NSRunLoopCommonModes];
     _rootNode = rootNode;
     _tapListener = tapListener;
 
@@ -65,6 +254,11 @@
   return self;
 }
 
+- (void)dealloc
+{
+  [_invalidationDisplayLink invalidate];
+}
+
 - (NSString *)identifier
 {
   return @"Inspector";
@@ -72,6 +266,7 @@
 
 - (void)didConnect:(id<SonarConnection>)connection {
   _connection = connection;
+  SonarPerformBlockOnMainThread(^{ self->_sentNodes.clear(); });
 
   [SKInvalidation enableInvalidations];
 
@@ -83,6 +278,12 @@
   // In order to avoid a retain cycle (Connection -> Block -> SonarKitLayoutPlugin -> Connection ...)
   __weak SonarKitLayoutPlugin *weakSelf = self;
 
+  // Nodes are described the same until they are invalidated.
+  if ([connection respondsToSelector:@selector(cacheResponsesForMethod:)]) {
+    [connection cacheResponsesForMethod:@"getRoot"];
+    [connection cacheResponsesForMethod:@"getNodes"];
+  }
+
   [connection receive:@"getRoot" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
     SonarPerformBlockOnMainThread(^{ [weakSelf onCallGetRoot: responder]; });
   }];
@@ -91,6 +292,38 @@
     SonarPerformBlockOnMainThread(^{ [weakSelf onCallGetNodes: params[@"ids"] withResponder: responder]; });
   }];
 
+  [connection receive:@"getChildren" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
+    SonarPerformBlockOnMainThread(^{
+      [weakSelf onCallGetChildren: params[@"id"]
+                       fromOffset: [params[@"offset"] unsignedIntegerValue]
+                            count: [params[@"count"] unsignedIntegerValue]
+                    withResponder: responder];
+    });
+  }];
+
+  [connection receive:@"getSubtree" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
+    SonarPerformBlockOnMainThread(^{
+      [weakSelf onCallGetSubtree: params[@"id"]
+                           depth: [params[@"depth"] unsignedIntegerValue]
+                   withResponder: responder];
+    });
+  }];
+
+  [connection receive:@"getViewHierarchy" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
+    SonarPerformBlockOnMainThread(^{
+      [weakSelf onCallGetViewHierarchy: params[@"id"]
+                              maxNodes: [params[@"maxNodes"] unsignedIntegerValue]
+                         withResponder: responder];
+    });
+  }];
+
+  [connection receive:@"setPrefetch" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
+    SonarPerformBlockOnMainThread(^{
+      [weakSelf onCallSetPrefetch: [params[@"enabled"] boolValue]];
+      [responder success: @{}];
+    });
+  }];
+
   [connection receive:@"setData" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
     SonarPerformBlockOnMainThread(^{
       [weakSelf onCallSetData: params[@"id"]
@@ -115,6 +348,12 @@
   [connection receive:@"getSearchResults" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
     SonarPerformBlockOnMainThread(^{ [weakSelf onCallGetSearchResults: params[@"query"] withResponder: responder]; });
   }];
+
+  if ([connection respondsToSelector:@selector(receiveStream:withBlock:)]) {
+    [connection receiveStream:@"getSearchResultsStream" withBlock:^(NSDictionary *params, id<SonarStreamResponder> responder) {
+      SonarPerformBlockOnMainThread(^{ [weakSelf onCallStreamSearchResults: params[@"query"] withResponder: responder]; });
+    }];
+  }
 }
 
 - (void)didDisconnect {
@@ -122,25 +361,299 @@
   [self onCallSetHighlighted: nil withResponder: nil];
   // Disable search if it is active
   [self onCallSetSearchActive: NO withConnection: nil];
+  SonarPerformBlockOnMainThread(^{ [self onCallSetPrefetch: NO]; });
 }
 
 - (void)onCallGetRoot:(id<SonarResponder>)responder {
+  // The desktop refetches everything from the root, e.g. on refresh, when
+  // changes that aren't tracked per view should show up too.
+  [UIView sk_invalidateAllViews];
   const auto rootNode= [self getNode: [self trackObject: _rootNode]];
+  [self recordSentElement: rootNode];
 
   [responder success: rootNode];
 }
 
+/**
+ Nodes whose descriptors allow it, typically ComponentKit layouts, are
+ described concurrently off the main thread. Their children are still
+ listed and tracked here, as is everything about the other nodes.
+ */
 - (void)onCallGetNodes:(NSArray<NSDictionary *> *)nodeIds withResponder:(id<SonarResponder>)responder {
-  NSMutableArray<NSDictionary *> *elements = [NSMutableArray new];
+  if (_prefetch && nodeIds.count > 0) {
+    [_prefetchQueue addObjectsFromArray: nodeIds];
+    [self schedulePrefetch];
+  }
+  NSMutableArray *elements = [NSMutableArray new];
+  NSMutableArray<NSNumber *> *offMainThread = [NSMutableArray new];
+  NSMutableArray *offMainThreadNodes = [NSMutableArray new];
+  NSMutableArray<SKNodeDescriptor *> *offMainThreadDescriptors = [NSMutableArray new];
+  NSMutableArray<NSArray<NSString *> *> *offMainThreadChildren = [NSMutableArray new];
+  NSMutableArray<NSNumber *> *offMainThreadChildCounts = [NSMutableArray new];
 
   for (id nodeId in nodeIds) {
-    const auto node = [self getNode: nodeId];
+    id<NSObject> node = [self trackedNode: nodeId];
     if (node == nil) {
       continue;
     }
-    [elements addObject: node];
+    SKNodeDescriptor *descriptor = [_descriptorMapper descriptorForClass: [node class]];
+    NSUInteger childCount = 0;
+    NSArray<NSString *> *children = [self trackChildrenOfNode: node
+                                               withDescriptor: descriptor
+                                                    fromIndex: 0
+                                                        count: kChildPageSize
+                                                   childCount: &childCount];
+    if ([descriptor canDescribeNodeOffMainThread: node]) {
+      [offMainThread addObject: @(elements.count)];
+      [offMainThreadNodes addObject: node];
+      [offMainThreadDescriptors addObject: descriptor];
+      [offMainThreadChildren addObject: children];
+      [offMainThreadChildCounts addObject: @(childCount)];
+      [elements addObject: [NSNull null]];
+    } else {
+      [elements addObject: [SonarKitLayoutPlugin elementForNode: node
+                                                 withDescriptor: descriptor
+                                                   withChildren: children
+                                                     childCount: childCount]];
+    }
+  }
+
+  if (offMainThread.count == 0) {
+    [self sendElements: elements withResponder: responder];
+    return;
+  }
+
+  __weak SonarKitLayoutPlugin *weakSelf = self;
+  dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+  dispatch_async(queue, ^{
+    // Slots are distinct, but NSMutableArray isn't safe to write to
+    // concurrently, so results are collected in a plain buffer first.
+    const size_t count = offMainThread.count;
+    std::vector<__strong NSDictionary *> described(count);
+    NSDictionary * __strong *slots = described.data();
+    dispatch_apply(count, queue, ^(size_t i) {
+      slots[i] = [SonarKitLayoutPlugin elementForNode: offMainThreadNodes[i]
+                                       withDescriptor: offMainThreadDescriptors[i]
+                                         withChildren: offMainThreadChildren[i]
+                                           childCount: [offMainThreadChildCounts[i] unsignedIntegerValue]];
+    });
+    for (size_t i = 0; i < count; i++) {
+      elements[[offMainThread[i] unsignedIntegerValue]] = described[i];
+    }
+    SonarPerformBlockOnMainThread(^{
+      [weakSelf sendElements: elements withResponder: responder];
+    });
+  });
+}
+
+/**
+ Lists count of node's children from offset on, for nodes with more children
+ than their elements list. Only these are tracked, the rest stay untouched.
+ */
+- (void)onCallGetChildren:(NSString *)nodeId
+               fromOffset:(NSUInteger)offset
+                    count:(NSUInteger)count
+            withResponder:(id<SonarResponder>)responder {
+  id<NSObject> node = [self trackedNode: nodeId];
+  if (node == nil) {
+    [responder error: @{ @"message": @"No such node" }];
+    return;
+  }
+  SKNodeDescriptor *descriptor = [_descriptorMapper descriptorForClass: [node class]];
+  NSUInteger childCount = 0;
+  NSArray<NSString *> *children = [self trackChildrenOfNode: node
+                                             withDescriptor: descriptor
+                                                  fromIndex: offset
+                                                      count: count
+                                                 childCount: &childCount];
+  [responder success: @{
+                        @"id": nodeId,
+                        @"offset": @(offset),
+                        @"childCount": @(childCount),
+                        @"children": children,
+                        }];
+}
+
+/**
+ Describes a node and its descendants down to depth levels below it, breadth
+ first, in one response rather than a getNodes per level. Only the first
+ page of each node's children is described, and at most kSubtreeMaxNodes
+ nodes, complete tells whether that was all of them.
+ */
+- (void)onCallGetSubtree:(NSString *)nodeId
+                   depth:(NSUInteger)depth
+           withResponder:(id<SonarResponder>)responder {
+  NSDictionary *root = [self getNode: nodeId];
+  if (root == nil) {
+    [responder error: @{ @"message": @"No such node" }];
+    return;
+  }
+  NSMutableArray<NSDictionary *> *elements = [NSMutableArray arrayWithObject: root];
+  NSArray<NSDictionary *> *level = @[ root ];
+  BOOL complete = YES;
+  for (NSUInteger d = 0; d < depth && level.count > 0 && complete; d++) {
+    NSMutableArray<NSDictionary *> *next = [NSMutableArray new];
+    for (NSDictionary *element in level) {
+      for (NSString *childId in element[@"children"]) {
+        if (elements.count == kSubtreeMaxNodes) {
+          complete = NO;
+          break;
+        }
+        NSDictionary *child = [self getNode: childId];
+        if (child != nil) {
+          [elements addObject: child];
+          [next addObject: child];
+        }
+      }
+    }
+    level = next;
+  }
+  for (NSDictionary *element in elements) {
+    [self recordSentElement: element];
+  }
+  [responder success: @{
+                        @"id": nodeId,
+                        @"elements": elements,
+                        @"complete": @(complete),
+                        }];
+}
+
+/**
+ Lists every view below a node, or below the root without one, with only
+ their frames, classes, flags and texts, for an overview of a whole screen at
+ once. The views are read in a single pass here, and encoded for the desktop
+ off the main thread, see SKHierarchyCapture. They are tracked like the
+ children of described nodes, so the desktop can fetch them with getNodes.
+ */
+- (void)onCallGetViewHierarchy:(NSString *)nodeId
+                      maxNodes:(NSUInteger)maxNodes
+                 withResponder:(id<SonarResponder>)responder {
+  id<NSObject> node = nodeId != nil ? [self trackedNode: nodeId] : _rootNode;
+  if (node == nil) {
+    [responder error: @{ @"message": @"No such node" }];
+    return;
+  }
+  if (maxNodes == 0 || maxNodes > kViewHierarchyMaxNodes) {
+    maxNodes = kViewHierarchyMaxNodes;
+  }
+  auto capture = std::make_shared<SKHierarchyCapture>([self viewsOfNode: node], _descriptorMapper, maxNodes);
+
+  __weak SonarKitLayoutPlugin *weakSelf = self;
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    NSDictionary *hierarchy = capture->encode();
+    // Queued before the desktop gets the ids, so any call it makes with them
+    // finds them tracked. The views are only released on the main thread.
+    SonarPerformBlockOnMainThread(^{
+      [weakSelf trackViews: capture->views() withIdentifiers: hierarchy[@"ids"]];
+      capture->releaseViews();
+    });
+    [responder success: hierarchy];
+  });
+}
+
+/**
+ The node itself if it's a view, otherwise the views among its children,
+ those of view controllers included.
+ */
+- (NSArray<UIView *> *)viewsOfNode:(id<NSObject>)node {
+  if ([node isKindOfClass: [UIView class]]) {
+    return @[ (UIView *)node ];
+  }
+  SKNodeDescriptor *descriptor = [_descriptorMapper descriptorForClass: [node class]];
+  NSMutableArray<UIView *> *views = [NSMutableArray new];
+  const NSUInteger count = [descriptor childCountForNode: node];
+  for (NSUInteger i = 0; i < count; i++) {
+    id child = [descriptor childForNode: node atIndex: i];
+    if ([child isKindOfClass: [UIViewController class]]) {
+      UIViewController *controller = child;
+      child = controller.isViewLoaded ? controller.view : nil;
+    }
+    if ([child isKindOfClass: [UIView class]]) {
+      [views addObject: child];
+    }
+  }
+  return views;
+}
+
+- (void)trackViews:(const std::vector<UIView *> &)views withIdentifiers:(NSArray<NSString *> *)identifiers {
+  for (size_t i = 0; i < views.size(); i++) {
+    [self trackObject: views[i] withIdentifier: identifiers[i]];
+  }
+}
+
+/**
+ While enabled, the children of nodes fetched with getNodes are sent unasked
+ as prefetched, a few at a time while the main run loop is idle in its
+ default mode, so not while the user scrolls.
+ */
+- (void)onCallSetPrefetch:(BOOL)enabled {
+  _prefetch = enabled;
+  if (!enabled) {
+    [_prefetchQueue removeAllObjects];
+    _prefetchNext = 0;
+  }
+}
+
+- (void)schedulePrefetch {
+  if (_prefetchScheduled || _prefetchQueue.count == 0) {
+    return;
+  }
+  _prefetchScheduled = YES;
+  [self performSelector: @selector(prefetch)
+             withObject: nil
+             afterDelay: 0
+                inModes: @[ NSDefaultRunLoopMode ]];
+}
+
+- (void)prefetch {
+  _prefetchScheduled = NO;
+  if (!_prefetch || _connection == nil) {
+    return;
+  }
+  NSMutableArray<NSDictionary *> *elements = [NSMutableArray new];
+  while (_prefetchQueue.count > 0 && elements.count < kPrefetchNodesPerTurn) {
+    id<NSObject> node = [self trackedNode: _prefetchQueue[0]];
+    BOOL done = YES;
+    if (node != nil) {
+      SKNodeDescriptor *descriptor = [_descriptorMapper descriptorForClass: [node class]];
+      NSUInteger childCount = 0;
+      NSArray<NSString *> *children = [self trackChildrenOfNode: node
+                                                 withDescriptor: descriptor
+                                                      fromIndex: _prefetchNext
+                                                          count: kChildPageSize - _prefetchNext
+                                                     childCount: &childCount];
+      for (NSString *childId in children) {
+        if (elements.count == kPrefetchNodesPerTurn) {
+          done = NO;
+          break;
+        }
+        _prefetchNext++;
+        if (_sentNodes.count([childId UTF8String]) > 0) {
+          // Sent already, and invalidated if it changes.
+          continue;
+        }
+        NSDictionary *element = [self getNode: childId];
+        if (element != nil) {
+          [self recordSentElement: element];
+          [elements addObject: element];
+        }
+      }
+    }
+    if (done) {
+      [_prefetchQueue removeObjectAtIndex: 0];
+      _prefetchNext = 0;
+    }
+  }
+  if (elements.count > 0) {
+    [_connection send: @"prefetched" withParams: @{ @"elements": elements }];
   }
+  [self schedulePrefetch];
+}
 
+- (void)sendElements:(NSArray<NSDictionary *> *)elements withResponder:(id<SonarResponder>)responder {
+  for (NSDictionary *element in elements) {
+    [self recordSentElement: element];
+  }
   [responder success: @{ @"elements": elements }];
 }
 
@@ -170,13 +683,19 @@
   SKNodeUpdateData updateDataForPath = [[descriptor dataMutationsForNode: node] objectForKey: dotJoinedPath];
   if (updateDataForPath != nil) {
     updateDataForPath(value);
+    [UIView sk_invalidateAllViews];
+    [self invalidateCachedNodes];
     [connection send: @"invalidate" withParams: @{ @"id": [descriptor identifierForNode: node] }];
   }
 }
 
 - (void)onCallGetSearchResults:(NSString *)query withResponder:(id<SonarResponder>)responder {
-  const auto alreadyAddedElements = [NSMutableSet<NSString *> new];
-  SKSearchResultNode *matchTree = [self searchForQuery:(NSString *)[query lowercaseString] fromNode:(id)_rootNode withElementsAlreadyAdded: alreadyAddedElements];
+  // Search results only list some of each node's children, after which the
+  // desktop's copies can't be diffed against.
+  _sentNodes.clear();
+  _searchGeneration++;
+  [self updateSearchIndex];
+  SKSearchResultNode *matchTree = [self searchForQuery: [query lowercaseString]];
 
   [responder success: @{
                         @"results": [matchTree toNSDictionary] ?: [NSNull null],
@@ -185,6 +704,72 @@
   return;
 }
 
+/**
+ Like onCallGetSearchResults:, but matches are sent as they are found. The
+ index is matched in slices of the main thread, and each slice that found
+ any sends the result tree down to those, which the desktop merges into
+ what it has. A newer search ends this one with an error.
+ */
+- (void)onCallStreamSearchResults:(NSString *)query withResponder:(id<SonarStreamResponder>)responder {
+  _sentNodes.clear();
+  const NSUInteger generation = ++_searchGeneration;
+  [self updateSearchIndex];
+  NSMutableArray<NSString *> *nodeIds = [NSMutableArray arrayWithCapacity: _searchIndex.size()];
+  for (const auto &indexed : _searchIndex) {
+    [nodeIds addObject: indexed.second.nodeId];
+  }
+  [self searchNodes: nodeIds
+          fromIndex: 0
+           forQuery: query
+         generation: generation
+      withResponder: responder];
+}
+
+- (void)searchNodes:(NSArray<NSString *> *)nodeIds
+          fromIndex:(NSUInteger)index
+           forQuery:(NSString *)query
+         generation:(NSUInteger)generation
+      withResponder:(id<SonarStreamResponder>)responder {
+  if (generation != _searchGeneration || _connection == nil) {
+    [responder error: @{ @"message": @"Superseded by a newer search" }];
+    return;
+  }
+  NSString *lowercaseQuery = [query lowercaseString];
+  NSMutableSet<NSString *> *matches = [NSMutableSet new];
+  const CFTimeInterval deadline = CACurrentMediaTime() + kSearchSliceDuration;
+  while (index < nodeIds.count && CACurrentMediaTime() < deadline) {
+    const auto entry = _searchIndex.find([nodeIds[index++] UTF8String]);
+    if (entry != _searchIndex.end() && [self searchIndexEntry: entry->second matchesQuery: lowercaseQuery]) {
+      [matches addObject: entry->second.nodeId];
+    }
+  }
+  SKSearchResultNode *matchTree = [self searchResultForMatches: matches];
+  if (matchTree != nil) {
+    [responder next: @{
+                       @"results": [matchTree toNSDictionary],
+                       @"query": query
+                       }];
+  }
+  if (index == nodeIds.count) {
+    [responder complete];
+    return;
+  }
+
+  __weak SonarKitLayoutPlugin *weakSelf = self;
+  dispatch_async(dispatch_get_main_queue(), ^{
+    SonarKitLayoutPlugin *strongSelf = weakSelf;
+    if (strongSelf == nil) {
+      [responder complete];
+      return;
+    }
+    [strongSelf searchNodes: nodeIds
+                  fromIndex: index
+                   forQuery: query
+                 generation: generation
+              withResponder: responder];
+  });
+}
+
 - (void)onCallSetHighlighted:(NSString *)objectId withResponder:(id<SonarResponder>)responder {
   if (_lastHighlightedNode != nil) {
     id lastHighlightedObject = [_trackedObjects objectForKey: _lastHighlightedNode];
@@ -249,33 +834,160 @@
     return;
   }
   [descriptor invalidateNode: node];
+  [self invalidateCachedNodes];
+
+  // Collected and sent in batches by the display link, which only runs while
+  // there is something to send.
+  if (_pendingInvalidations.push(nodeId)) {
+    CADisplayLink *displayLink = _invalidationDisplayLink;
+    SonarPerformBlockOnMainThread(^{ displayLink.paused = NO; });
+  }
+}
+
+- (void)invalidateCachedNodes {
+  id<SonarConnection> connection = _connection;
+  if ([connection respondsToSelector:@selector(invalidateCachedResponsesForMethod:)]) {
+    [connection invalidateCachedResponsesForMethod:@"getRoot"];
+    [connection invalidateCachedResponsesForMethod:@"getNodes"];
+  }
+}
+
+/**
+ Moves invalidations pushed from any thread to the sets of the main thread.
+ */
+- (void)drainPendingInvalidations {
+  NSMutableSet<NSString *> *drained = [NSMutableSet new];
+  _pendingInvalidations.drain(drained);
+  [_invalidObjects unionSet: drained];
+  [_staleSearchNodes unionSet: drained];
+}
 
-  // Collect invalidate messages before sending in a batch
-  std::lock_guard<std::mutex> lock(invalidObjectsMutex);
-  [_invalidObjects addObject:nodeId];
-  if (_invalidateMessageQueued) {
+- (void)onDisplayLink:(CADisplayLink *)displayLink {
+  if (++_framesSinceInvalidation < _framesPerInvalidation) {
+    return;
+  }
+  [self drainPendingInvalidations];
+  if (_invalidObjects.count == 0) {
+    displayLink.paused = YES;
     return;
   }
-  _invalidateMessageQueued = true;
 
-  if (_lastInvalidateMessage.timeIntervalSinceNow < -1) {
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 500 * NSEC_PER_MSEC), dispatch_get_main_queue(), ^{
-      [self reportInvalidatedObjects];
-    });
+  const CFTimeInterval start = CACurrentMediaTime();
+  [self reportInvalidatedObjects];
+  const CFTimeInterval cost = CACurrentMediaTime() - start;
+  _framesSinceInvalidation = 0;
+
+  const CFTimeInterval budget = displayLink.duration * _framesPerInvalidation * kInvalidationFrameBudget;
+  if (cost > budget) {
+    _framesPerInvalidation = std::min(_framesPerInvalidation * 2, kMaxFramesPerInvalidation);
+  } else if (cost < budget / 2) {
+    _framesPerInvalidation = std::max(_framesPerInvalidation - 1, kMinFramesPerInvalidation);
   }
 }
 
 - (void)reportInvalidatedObjects {
-  std::lock_guard<std::mutex> lock(invalidObjectsMutex);
+  NSSet *invalidObjects = _invalidObjects;
+  _invalidObjects = [NSMutableSet new];
+
+  // Describing nodes may invalidate others, those go out with the next batch.
   NSMutableArray *nodes = [NSMutableArray new];
-  for (NSString *nodeId in self->_invalidObjects) {
-   [nodes addObject: [NSDictionary dictionaryWithObject: nodeId forKey: @"id"]];
+  for (NSString *nodeId in invalidObjects) {
+    const auto sent = _sentNodes.find([nodeId UTF8String]);
+    NSDictionary *element = sent == _sentNodes.end() ? nil : [self getNode: nodeId];
+    if (element == nil || element[@"childCount"] != nil) {
+      // Not sent before, the desktop fetches it again if it needs it.
+      if (sent != _sentNodes.end()) {
+        _sentNodes.erase(sent);
+      }
+      [nodes addObject: [NSDictionary dictionaryWithObject: nodeId forKey: @"id"]];
+      continue;
+    }
+    NSDictionary *changes = [self changesToElement: element since: sent->second];
+    if (changes.count > 0) {
+      [nodes addObject: @{ @"id": nodeId, @"changes": changes }];
+    }
   }
-  [self->_connection send: @"invalidate" withParams: [NSDictionary dictionaryWithObject: nodes forKey: @"nodes"]];
-  self->_lastInvalidateMessage = [NSDate date];
-  self->_invalidObjects = [NSMutableSet new];
-  self->_invalidateMessageQueued = false;
-  return;
+  if (nodes.count > 0) {
+    [self->_connection send: @"invalidate" withParams: [NSDictionary dictionaryWithObject: nodes forKey: @"nodes"]];
+  }
+}
+
+- (void)recordSentElement:(NSDictionary *)element {
+  NSString *nodeId = element[@"id"];
+  if (element == nil || nodeId == nil) {
+    return;
+  }
+  if (element[@"childCount"] != nil) {
+    // The desktop pages in the rest of the children, so what it has can't
+    // be diffed against. Invalidations of it are refetched instead.
+    _sentNodes.erase([nodeId UTF8String]);
+    return;
+  }
+  _sentNodes[[nodeId UTF8String]] = SKSentNodeForElement(element);
+}
+
+/**
+ The fields of element that differ from what was sent, which is updated to
+ element. Data sections are compared one by one, removed ones are sent as
+ null. Children come as a splice of the sent list: deleteCount ids from
+ start replaced with items.
+ */
+- (NSDictionary *)changesToElement:(NSDictionary *)element since:(SKSentNode &)sent {
+  NSMutableDictionary *changes = [NSMutableDictionary new];
+  SKSentNode current = SKSentNodeForElement(element);
+
+  if (![current.name isEqualToString: sent.name]) {
+    changes[@"name"] = element[@"name"];
+  }
+  if (![current.decoration isEqualToString: sent.decoration]) {
+    changes[@"decoration"] = element[@"decoration"];
+  }
+  if (current.attributesHash != sent.attributesHash) {
+    changes[@"attributes"] = element[@"attributes"];
+  }
+
+  NSMutableDictionary *data = [NSMutableDictionary new];
+  NSDictionary *currentData = element[@"data"];
+  for (const auto &section : current.dataHashes) {
+    const auto sentSection = sent.dataHashes.find(section.first);
+    if (sentSection == sent.dataHashes.end() || sentSection->second != section.second) {
+      NSString *name = [NSString stringWithUTF8String: section.first.c_str()];
+      data[name] = currentData[name];
+    }
+  }
+  for (const auto &section : sent.dataHashes) {
+    if (current.dataHashes.find(section.first) == current.dataHashes.end()) {
+      data[[NSString stringWithUTF8String: section.first.c_str()]] = [NSNull null];
+    }
+  }
+  if (data.count > 0) {
+    changes[@"data"] = data;
+  }
+
+  NSArray<NSString *> *oldChildren = sent.children;
+  NSArray<NSString *> *newChildren = current.children;
+  NSUInteger start = 0;
+  while (start < oldChildren.count && start < newChildren.count &&
+         [oldChildren[start] isEqualToString: newChildren[start]]) {
+    start++;
+  }
+  NSUInteger oldEnd = oldChildren.count;
+  NSUInteger newEnd = newChildren.count;
+  while (oldEnd > start && newEnd > start &&
+         [oldChildren[oldEnd - 1] isEqualToString: newChildren[newEnd - 1]]) {
+    oldEnd--;
+    newEnd--;
+  }
+  if (oldEnd > start || newEnd > start) {
+    changes[@"childrenSplice"] = @{
+                                   @"start": @(start),
+                                   @"deleteCount": @(oldEnd - start),
+                                   @"items": [newChildren subarrayWithRange: NSMakeRange(start, newEnd - start)],
+                                   };
+  }
+
+  sent = std::move(current);
+  return changes;
 }
 
 - (void)updateNodeReference:(id<NSObject>)node {
@@ -286,58 +998,251 @@
 
   NSString *nodeId = [descriptor identifierForNode: node];
   [_trackedObjects setObject:node forKey:nodeId];
+  [self markTracked: node];
+}
+
+/**
+ Brings the search index up to date. Invalidations are reported for the
+ nodes whose children changed, so only those are described again. Children
+ they gained are indexed with their whole subtree, those they lost are
+ dropped with theirs.
+ */
+- (void)updateSearchIndex {
+  NSString *rootId = [self trackObject: _rootNode];
+  [self drainPendingInvalidations];
+  NSSet<NSString *> *staleNodes = _staleSearchNodes;
+  _staleSearchNodes = [NSMutableSet new];
+
+  if (rootId == nil) {
+    _searchIndex.clear();
+    return;
+  }
+  const auto root = _searchIndex.find([rootId UTF8String]);
+  if (root == _searchIndex.end()) {
+    _searchIndex.clear();
+    [self indexNode: _rootNode withParent: nil];
+    return;
+  }
+
+  for (NSString *nodeId in staleNodes) {
+    const auto entry = _searchIndex.find([nodeId UTF8String]);
+    if (entry == _searchIndex.end()) {
+      // Not part of the tree yet, it is indexed with its parent.
+      continue;
+    }
+    NSString *parentId = entry->second.parentId;
+    id node = [_trackedObjects objectForKey: nodeId];
+    SKNodeDescriptor *descriptor = [_descriptorMapper descriptorForClass: [node class]];
+    if (node == nil || descriptor == nil) {
+      [self removeNodeFromSearchIndex: nodeId withParent: parentId];
+      continue;
+    }
+
+    const auto oldChildren = [NSSet setWithArray: entry->second.children];
+    NSArray<NSString *> *children = [self indexEntryForNode: node withDescriptor: descriptor withParent: parentId];
+    const auto newChildren = [NSSet setWithArray: children];
+    for (NSString *childId in oldChildren) {
+      if (![newChildren containsObject: childId]) {
+        [self removeNodeFromSearchIndex: childId withParent: nodeId];
+      }
+    }
+    for (NSString *childId in children) {
+      const auto child = _searchIndex.find([childId UTF8String]);
+      if (child != _searchIndex.end()) {
+        // Possibly moved here from another parent.
+        child->second.parentId = nodeId;
+      } else {
+        [self indexNode: [_trackedObjects objectForKey: childId] withParent: nodeId];
+      }
+    }
+  }
 }
 
-- (SKSearchResultNode *)searchForQuery:(NSString *)query fromNode:(id)node withElementsAlreadyAdded:(NSMutableSet<NSString *> *)alreadyAdded {
+/**
+ Indexes node and everything below it.
+ */
+- (void)indexNode:(id)node withParent:(NSString *)parentId {
   SKNodeDescriptor *descriptor = [_descriptorMapper descriptorForClass: [node class]];
   if (node == nil || descriptor == nil) {
-    return nil;
+    return;
   }
+  NSString *nodeId = [descriptor identifierForNode: node];
+  if (nodeId == nil || _searchIndex.find([nodeId UTF8String]) != _searchIndex.end()) {
+    // Already reached through another parent.
+    return;
+  }
+  NSArray<NSString *> *children = [self indexEntryForNode: node withDescriptor: descriptor withParent: parentId];
+  for (NSString *childId in children) {
+    [self indexNode: [_trackedObjects objectForKey: childId] withParent: nodeId];
+  }
+}
 
-  NSMutableArray<SKSearchResultNode *> *childTrees = nil;
-  BOOL isMatch = [descriptor matchesQuery: query forNode: node];
-
+/**
+ Describes node for the search index, replacing any previous entry, and
+ returns its children.
+ */
+- (NSArray<NSString *> *)indexEntryForNode:(id)node withDescriptor:(SKNodeDescriptor *)descriptor withParent:(NSString *)parentId {
   NSString *nodeId = [self trackObject: node];
+  NSMutableArray<NSString *> *children = [NSMutableArray new];
+  for (NSUInteger i = 0; i < [descriptor childCountForNode: node]; i++) {
+    NSString *childId = [self trackObject: [descriptor childForNode: node atIndex: i]];
+    if (childId) {
+      [children addObject: childId];
+    }
+  }
 
-  for (auto i = 0; i < [descriptor childCountForNode: node]; i++) {
-    id child = [descriptor childForNode: node atIndex: i];
-    if (child) {
-      SKSearchResultNode *childTree = [self searchForQuery: query fromNode: child withElementsAlreadyAdded:alreadyAdded];
-      if (childTree != nil) {
-        if (childTrees == nil) {
-          childTrees = [NSMutableArray new];
-        }
-        [childTrees addObject: childTree];
-      }
+  static const IMP defaultMatcher = [SKNodeDescriptor instanceMethodForSelector: @selector(matchesQuery:forNode:)];
+  SKSearchIndexEntry entry;
+  entry.nodeId = nodeId;
+  entry.name = [descriptor nameForNode: node];
+  entry.parentId = parentId;
+  entry.children = children;
+  entry.matcher = [descriptor methodForSelector: @selector(matchesQuery:forNode:)] == defaultMatcher ? nil : descriptor;
+  _searchIndex[[nodeId UTF8String]] = entry;
+  return children;
+}
+
+/**
+ Drops node and everything below it from the search index. Nodes that have
+ moved to another parent in the meantime are left alone.
+ */
+- (void)removeNodeFromSearchIndex:(NSString *)nodeId withParent:(NSString *)parentId {
+  std::vector<std::pair<NSString *, NSString *>> pending = {{nodeId, parentId}};
+  while (!pending.empty()) {
+    NSString *currentId = pending.back().first;
+    NSString *currentParentId = pending.back().second;
+    pending.pop_back();
+    const auto entry = _searchIndex.find([currentId UTF8String]);
+    if (entry == _searchIndex.end() ||
+        !(entry->second.parentId == currentParentId || [entry->second.parentId isEqualToString: currentParentId])) {
+      continue;
+    }
+    for (NSString *childId in entry->second.children) {
+      pending.push_back({childId, currentId});
+    }
+    _searchIndex.erase(entry);
+  }
+}
+
+/**
+ Answers query from the search index. Only the nodes that match and their
+ ancestors are described, and each of those only lists children that aren't
+ already listed elsewhere in the result.
+ */
+- (SKSearchResultNode *)searchForQuery:(NSString *)query {
+  NSMutableSet<NSString *> *matches = [NSMutableSet new];
+  for (const auto &indexed : _searchIndex) {
+    if ([self searchIndexEntry: indexed.second matchesQuery: query]) {
+      [matches addObject: indexed.second.nodeId];
     }
   }
+  return [self searchResultForMatches: matches];
+}
 
-  if (isMatch || childTrees != nil) {
+- (BOOL)searchIndexEntry:(const SKSearchIndexEntry &)entry matchesQuery:(NSString *)query {
+  if (entry.matcher != nil) {
+    id node = [_trackedObjects objectForKey: entry.nodeId];
+    return node != nil && [entry.matcher matchesQuery: query forNode: node];
+  }
+  return SKStringContains(entry.name, query) || SKStringContains(entry.nodeId, query);
+}
 
-    NSDictionary *element = [self getNode: nodeId];
-    if (nodeId == nil || element == nil) {
-      return nil;
+/**
+ The result tree from the root down to matches, nil if there are none.
+ */
+- (SKSearchResultNode *)searchResultForMatches:(NSSet<NSString *> *)matches {
+  if (matches.count == 0) {
+    return nil;
+  }
+  NSMutableSet<NSString *> *onPath = [NSMutableSet new];
+  for (NSString *matchId in matches) {
+    for (NSString *ancestorId = matchId; ancestorId != nil && ![onPath containsObject: ancestorId];) {
+      [onPath addObject: ancestorId];
+      const auto ancestor = _searchIndex.find([ancestorId UTF8String]);
+      ancestorId = ancestor == _searchIndex.end() ? nil : ancestor->second.parentId;
     }
-    NSMutableArray<NSString *> *descriptorChildElements = [element objectForKey: @"children"];
-    NSMutableDictionary *newElement = [element mutableCopy];
+  }
+
+  NSString *rootId = [self trackObject: _rootNode];
+  if (rootId == nil || ![onPath containsObject: rootId]) {
+    return nil;
+  }
+  const auto alreadyAdded = [NSMutableSet<NSString *> new];
+  return [self searchResultForNode: rootId withMatches: matches onPath: onPath withElementsAlreadyAdded: alreadyAdded];
+}
+
+- (SKSearchResultNode *)searchResultForNode:(NSString *)nodeId
+                                withMatches:(NSSet<NSString *> *)matches
+                                     onPath:(NSSet<NSString *> *)onPath
+                   withElementsAlreadyAdded:(NSMutableSet<NSString *> *)alreadyAdded {
+  const auto entry = _searchIndex.find([nodeId UTF8String]);
+  if (entry == _searchIndex.end()) {
+    return nil;
+  }
 
-    NSMutableArray<NSString *> *childElementsToReturn = [NSMutableArray new];
-    for (NSString *child in descriptorChildElements) {
-      if (![alreadyAdded containsObject: child]) {
-        [alreadyAdded addObject: child]; //todo add all at end
-        [childElementsToReturn addObject: child];
+  NSMutableArray<SKSearchResultNode *> *childTrees = nil;
+  for (NSString *childId in entry->second.children) {
+    if (![onPath containsObject: childId]) {
+      continue;
+    }
+    SKSearchResultNode *childTree = [self searchResultForNode: childId withMatches: matches onPath: onPath withElementsAlreadyAdded: alreadyAdded];
+    if (childTree != nil) {
+      if (childTrees == nil) {
+        childTrees = [NSMutableArray new];
       }
+      [childTrees addObject: childTree];
+    }
+  }
+
+  BOOL isMatch = [matches containsObject: nodeId];
+  if (!isMatch && childTrees == nil) {
+    return nil;
+  }
+  NSDictionary *element = [self getNode: nodeId];
+  if (element == nil) {
+    return nil;
+  }
+  // All of the children, paged ones included: matches can be anywhere.
+  NSArray<NSString *> *descriptorChildElements = entry->second.children;
+  NSMutableDictionary *newElement = [element mutableCopy];
+  [newElement removeObjectForKey: @"childCount"];
+
+  NSMutableArray<NSString *> *childElementsToReturn = [NSMutableArray new];
+  for (NSString *child in descriptorChildElements) {
+    if (![alreadyAdded containsObject: child]) {
+      [alreadyAdded addObject: child]; //todo add all at end
+      [childElementsToReturn addObject: child];
     }
-    [newElement setObject: childElementsToReturn forKey: @"children"];
-    return [[SKSearchResultNode alloc] initWithNode: nodeId
-                                            asMatch: isMatch
-                                        withElement: newElement
-                                        andChildren: childTrees];
   }
-  return nil;
+  [newElement setObject: childElementsToReturn forKey: @"children"];
+  return [[SKSearchResultNode alloc] initWithNode: nodeId
+                                          asMatch: isMatch
+                                      withElement: newElement
+                                      andChildren: childTrees];
 }
 
 - (NSDictionary *)getNode:(NSString *)nodeId {
+  id<NSObject> node = [self trackedNode: nodeId];
+  if (node == nil) {
+    return nil;
+  }
+  SKNodeDescriptor *nodeDescriptor = [_descriptorMapper descriptorForClass: [node class]];
+  NSUInteger childCount = 0;
+  NSArray<NSString *> *children = [self trackChildrenOfNode: node
+                                             withDescriptor: nodeDescriptor
+                                                  fromIndex: 0
+                                                      count: kChildPageSize
+                                                 childCount: &childCount];
+  return [SonarKitLayoutPlugin elementForNode: node
+                               withDescriptor: nodeDescriptor
+                                 withChildren: children
+                                   childCount: childCount];
+}
+
+/**
+ The tracked node with this id if it has a descriptor, nil otherwise.
+ */
+- (id<NSObject>)trackedNode:(NSString *)nodeId {
   id<NSObject> node = [_trackedObjects objectForKey: nodeId];
   if (node == nil) {
     SKLog(@"node is nil, no tracked node found for nodeId: %@", nodeId);
@@ -349,7 +1254,41 @@
     SKLog(@"No registered descriptor for class: %@", [node class]);
     return nil;
   }
+  return node;
+}
+
+/**
+ Tracks and lists up to count of node's children from index on. The others
+ aren't asked for, childCount is set to how many there are in all.
+ */
+- (NSArray<NSString *> *)trackChildrenOfNode:(id)node
+                              withDescriptor:(SKNodeDescriptor *)nodeDescriptor
+                                   fromIndex:(NSUInteger)index
+                                       count:(NSUInteger)count
+                                  childCount:(NSUInteger *)childCount {
+  const NSUInteger total = [nodeDescriptor childCountForNode: node];
+  *childCount = total;
+  NSMutableArray *children = [NSMutableArray new];
+  for (NSUInteger i = index; i < total && i - index < count; i++) {
+    id childNode = [nodeDescriptor childForNode: node atIndex: i];
+
+    NSString *childIdentifier = [self trackObject: childNode];
+    if (childIdentifier) {
+      [children addObject: childIdentifier];
+    }
+  }
+  return children;
+}
 
+/**
+ Describes node for the desktop. Only asks the descriptor, which makes it
+ safe to call off the main thread where the descriptor allows it. When
+ children is only the first page, the element says how many there are.
+ */
++ (NSDictionary *)elementForNode:(id)node
+                  withDescriptor:(SKNodeDescriptor *)nodeDescriptor
+                    withChildren:(NSArray<NSString *> *)children
+                      childCount:(NSUInteger)childCount {
   NSMutableArray *attributes = [NSMutableArray new];
   NSMutableDictionary *data = [NSMutableDictionary new];
 
@@ -370,18 +1309,8 @@
     data[namedPair.name] = namedPair.value;
   }
 
-  NSMutableArray *children = [NSMutableArray new];
-  for (NSUInteger i = 0; i < [nodeDescriptor childCountForNode: node]; i++) {
-    id childNode = [nodeDescriptor childForNode: node atIndex: i];
-
-    NSString *childIdentifier = [self trackObject: childNode];
-    if (childIdentifier) {
-      [children addObject: childIdentifier];
-    }
-  }
-
-  NSDictionary *nodeDic =
-  @{
+  NSMutableDictionary *nodeDic =
+  [@{
     // We shouldn't get nil for id/name/decoration, but let's not crash if we do.
     @"id": [nodeDescriptor identifierForNode: node] ?: @"(unknown)",
     @"name": [nodeDescriptor nameForNode: node] ?: @"(unknown)",
@@ -389,7 +1318,10 @@
     @"attributes": attributes,
     @"data": data,
     @"decoration": [nodeDescriptor decorationForNode: node] ?: @"(unknown)",
-    };
+    } mutableCopy];
+  if (childCount > kChildPageSize) {
+    nodeDic[@"childCount"] = @(childCount);
+  }
 
   return nodeDic;
 }
@@ -402,11 +1334,46 @@
     return nil;
   }
 
+  [self trackObject: object withIdentifier: objectIdentifier];
+  return objectIdentifier;
+}
+
+- (void)trackObject:(id)object withIdentifier:(NSString *)objectIdentifier {
   if (! [_trackedObjects objectForKey: objectIdentifier]) {
     [_trackedObjects setObject:object forKey:objectIdentifier];
+    [self markTracked: object];
+    if (_trackedObjects.count >= _trackedObjectsPruneThreshold) {
+      [self pruneTrackedObjects];
+    }
   }
+}
 
-  return objectIdentifier;
+/**
+ Lets the swizzled UIView methods skip invalidateNode: for the views that
+ aren't tracked, without looking them up.
+ */
+- (void)markTracked:(id)object {
+  if ([object isKindOfClass: [UIView class]]) {
+    [(UIView *)object sk_markTracked];
+  }
+}
+
+/**
+ Removes the entries of released objects from the tracking table, along
+ with what was remembered about them for diffing.
+ */
+- (void)pruneTrackedObjects {
+  NSMutableArray<NSString *> *released = [NSMutableArray new];
+  for (NSString *identifier in _trackedObjects) {
+    if ([_trackedObjects objectForKey: identifier] == nil) {
+      [released addObject: identifier];
+    }
+  }
+  for (NSString *identifier in released) {
+    [_trackedObjects removeObjectForKey: identifier];
+    _sentNodes.erase([identifier UTF8String]);
+  }
+  _trackedObjectsPruneThreshold = MAX(kMinTrackedObjectsBeforePruning, _trackedObjects.count * 2);
 }
 
 @end
@@ -11,6 +11,7 @@
 
 #import "SKInvalidation.h"
 #import "SKSwizzle.h"
+#import "UIView+SKInvalidation.h"
 
 FB_LINKABLE(UICollectionView_SKInvalidation)
 @implementation UICollectionView (SKInvalidation)
@@ -23,9 +24,13 @@ FB_LINKABLE(UICollectionView_SKInvalidation)
 }
 
 - (UICollectionViewCell *)swizzle_cellForItemAtIndexPath:(NSIndexPath *)indexPath {
-  dispatch_async(dispatch_get_main_queue(), ^{
-    [[SKInvalidation sharedInstance].delegate invalidateNode: self];
-  });
+  // Called for every cell while scrolling, most collection views were never
+  // sent to the desktop.
+  if ([SKInvalidation sharedInstance].delegate != nil && [self sk_isTracked]) {
+    dispatch_async(dispatch_get_main_queue(), ^{
+      [[SKInvalidation sharedInstance].delegate invalidateNode: self];
+    });
+  }
 
   return [self swizzle_cellForItemAtIndexPath: indexPath];
 }
@@ -12,4 +12,33 @@ FB_LINK_REQUIRE(UIView_SKInvalidation)
 
 + (void)enableInvalidation;
 
+/**
+ Whether enableInvalidation was called. Before that sk_invalidationGeneration
+ never changes, so it can't tell that anything did.
+ */
++ (BOOL)sk_invalidationEnabled;
+
+/**
+ Make every view's sk_invalidationGeneration change, e.g. after a change that
+ isn't tracked per view.
+ */
++ (void)sk_invalidateAllViews;
+
+/**
+ Marks the view as one the inspector knows about, e.g. once it was sent to
+ the desktop or described. Only the views marked so are invalidated, the
+ others are never looked up. Stays marked for as long as the view lives.
+ */
+- (void)sk_markTracked;
+
+- (BOOL)sk_isTracked;
+
+/**
+ Changes whenever the view is invalidated, or its frame, bounds, center,
+ alpha or background color is set, and when sk_invalidateAllViews is called.
+ Only while the view is tracked, see sk_markTracked. Descriptors use it to tell whether what they last described the view as
+ still holds.
+ */
+- (NSUInteger)sk_invalidationGeneration;
+
 @end
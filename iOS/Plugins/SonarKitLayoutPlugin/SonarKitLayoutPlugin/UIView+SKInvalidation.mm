@@ -14,6 +14,22 @@
 #import "SKSwizzle.h"
 #import "UIView+SKInvalidation.h"
 
+// Views are only described and changed on the main thread.
+static BOOL sInvalidationEnabled = NO;
+static NSUInteger sAllViewsGeneration = 0;
+static char kTrackingKey;
+
+// Only views the inspector tracks have one, the swizzled methods return
+// right away for all others.
+@interface SKViewTracking : NSObject {
+ @public
+  NSUInteger _generation;
+}
+@end
+
+@implementation SKViewTracking
+@end
+
 FB_LINKABLE(UIView_SKInvalidation)
 @implementation UIView (SKInvalidation)
 
@@ -23,31 +39,105 @@ FB_LINKABLE(UIView_SKInvalidation)
     swizzleMethods([self class], @selector(setHidden:), @selector(swizzle_setHidden:));
     swizzleMethods([self class], @selector(addSubview:), @selector(swizzle_addSubview:));
     swizzleMethods([self class], @selector(removeFromSuperview), @selector(swizzle_removeFromSuperview));
+    // Not sent to the desktop, they change far too often, only so that
+    // descriptors don't show them stale.
+    swizzleMethods([self class], @selector(setFrame:), @selector(swizzle_setFrame:));
+    swizzleMethods([self class], @selector(setBounds:), @selector(swizzle_setBounds:));
+    swizzleMethods([self class], @selector(setCenter:), @selector(swizzle_setCenter:));
+    swizzleMethods([self class], @selector(setAlpha:), @selector(swizzle_setAlpha:));
+    swizzleMethods([self class], @selector(setBackgroundColor:), @selector(swizzle_setBackgroundColor:));
+    sInvalidationEnabled = YES;
   });
 }
 
++ (BOOL)sk_invalidationEnabled {
+  return sInvalidationEnabled;
+}
+
++ (void)sk_invalidateAllViews {
+  sAllViewsGeneration++;
+}
+
+- (void)sk_markTracked {
+  if (objc_getAssociatedObject(self, &kTrackingKey) == nil) {
+    objc_setAssociatedObject(self, &kTrackingKey, [SKViewTracking new], OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+  }
+}
+
+- (BOOL)sk_isTracked {
+  return objc_getAssociatedObject(self, &kTrackingKey) != nil;
+}
+
+- (NSUInteger)sk_invalidationGeneration {
+  // Both counters only grow, so their sum changes whenever either does.
+  SKViewTracking *tracking = objc_getAssociatedObject(self, &kTrackingKey);
+  return sAllViewsGeneration + (tracking != nil ? tracking->_generation : 0);
+}
+
+- (void)sk_bumpInvalidationGeneration {
+  // Nothing was described for an untracked view, so there is nothing to
+  // make stale either.
+  SKViewTracking *tracking = objc_getAssociatedObject(self, &kTrackingKey);
+  if (tracking != nil) {
+    tracking->_generation++;
+  }
+}
+
+- (void)swizzle_setFrame:(CGRect)frame {
+  [self swizzle_setFrame: frame];
+  [self sk_bumpInvalidationGeneration];
+}
+
+- (void)swizzle_setBounds:(CGRect)bounds {
+  [self swizzle_setBounds: bounds];
+  [self sk_bumpInvalidationGeneration];
+}
+
+- (void)swizzle_setCenter:(CGPoint)center {
+  [self swizzle_setCenter: center];
+  [self sk_bumpInvalidationGeneration];
+}
+
+- (void)swizzle_setAlpha:(CGFloat)alpha {
+  [self swizzle_setAlpha: alpha];
+  [self sk_bumpInvalidationGeneration];
+}
+
+- (void)swizzle_setBackgroundColor:(UIColor *)color {
+  [self swizzle_setBackgroundColor: color];
+  [self sk_bumpInvalidationGeneration];
+}
+
 - (void)swizzle_setHidden:(BOOL)hidden {
   [self swizzle_setHidden: hidden];
+  [self sk_bumpInvalidationGeneration];
+  [self.superview sk_bumpInvalidationGeneration];
 
   id<SKInvalidationDelegate> delegate = [SKInvalidation sharedInstance].delegate;
-  if (delegate != nil) {
+  if (delegate != nil && [self.superview sk_isTracked]) {
     [delegate invalidateNode: self.superview];
   }
 }
 
 - (void)swizzle_addSubview:(UIView *)view {
   [self swizzle_addSubview: view];
+  [self sk_bumpInvalidationGeneration];
+  [view sk_bumpInvalidationGeneration];
 
   id<SKInvalidationDelegate> delegate = [SKInvalidation sharedInstance].delegate;
-  if (delegate != nil) {
+  if (delegate != nil && [view sk_isTracked]) {
     [delegate invalidateNode: view];
   }
 }
 
 - (void)swizzle_removeFromSuperview {
-  id<SKInvalidationDelegate> delegate = [SKInvalidation sharedInstance].delegate;
-  if (delegate != nil && self.superview != nil) {
-    [delegate invalidateNode: self.superview];
+  UIView *superview = self.superview;
+  if ([superview sk_isTracked]) {
+    [superview sk_bumpInvalidationGeneration];
+    id<SKInvalidationDelegate> delegate = [SKInvalidation sharedInstance].delegate;
+    if (delegate != nil) {
+      [delegate invalidateNode: superview];
+    }
   }
 
   [self swizzle_removeFromSuperview];
@@ -14,9 +14,30 @@
 #import "SKNamed.h"
 #import "SKObject.h"
 #import "SKYogaKitHelper.h"
+#import "SKYogaSerializer.h"
 #import "UIColor+SKSonarValueCoder.h"
+#import "UIView+SKInvalidation.h"
+#import <objc/runtime.h>
+#import <FBCxxUtils/FBCxxFollyDynamicConvert.h>
 #import <YogaKit/UIView+Yoga.h>
 
+// YogaKit only declares this in its private YGLayout+Private.h.
+@interface YGLayout (SKYogaNode)
+@property (nonatomic, assign, readonly) YGNodeRef node;
+@end
+
+// What a view was last described as, valid while its
+// sk_invalidationGeneration is still the one it was described at.
+@interface SKDescribedView : NSObject
+@property (nonatomic, assign) NSUInteger generation;
+@property (nonatomic, strong) NSArray<SKNamed<NSDictionary *> *> *data;
+@end
+
+@implementation SKDescribedView
+@end
+
+static char kDescribedViewKey;
+
 @implementation SKViewDescriptor
 
 static NSDictionary *YGDirectionEnumMap = nil;
@@ -70,6 +91,25 @@ static NSDictionary *YGUnitEnumMap = nil;
 }
 
 - (NSArray<SKNamed<NSDictionary *> *> *)dataForNode:(UIView *)node {
+  // Without invalidations the generation never changes.
+  if (![UIView sk_invalidationEnabled]) {
+    return [self describeView: node];
+  }
+  // Its generation only changes once it is tracked.
+  [node sk_markTracked];
+  const NSUInteger generation = [node sk_invalidationGeneration];
+  SKDescribedView *described = objc_getAssociatedObject(node, &kDescribedViewKey);
+  if (described != nil && described.generation == generation) {
+    return described.data;
+  }
+  described = [SKDescribedView new];
+  described.generation = generation;
+  described.data = [self describeView: node];
+  objc_setAssociatedObject(node, &kDescribedViewKey, described, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+  return described.data;
+}
+
+- (NSArray<SKNamed<NSDictionary *> *> *)describeView:(UIView *)node {
   return [NSArray arrayWithObjects:
           [SKNamed newWithName: @"UIView"
                      withValue: @{
@@ -106,74 +146,7 @@ static NSDictionary *YGUnitEnumMap = nil;
                                   }],
           !node.isYogaEnabled ? nil :
           [SKNamed newWithName: @"YGLayout"
-                     withValue: @{
-                                  @"direction": SKMutableObject(YGDirectionEnumMap[@(node.yoga.direction)]),
-                                  @"justifyContent": SKMutableObject(YGJustifyEnumMap[@(node.yoga.justifyContent)]),
-                                  @"aligns": @{
-                                      @"alignContent": SKMutableObject(YGAlignEnumMap[@(node.yoga.alignContent)]),
-                                      @"alignItems": SKMutableObject(YGAlignEnumMap[@(node.yoga.alignItems)]),
-                                      @"alignSelf": SKMutableObject(YGAlignEnumMap[@(node.yoga.alignSelf)]),
-                                      },
-                                  @"position": @{
-                                      @"type": SKMutableObject(YGPositionTypeEnumMap[@(node.yoga.position)]),
-                                      @"left": SKYGValueObject(node.yoga.left),
-                                      @"top": SKYGValueObject(node.yoga.top),
-                                      @"right": SKYGValueObject(node.yoga.right),
-                                      @"bottom": SKYGValueObject(node.yoga.bottom),
-                                      @"start": SKYGValueObject(node.yoga.start),
-                                      @"end": SKYGValueObject(node.yoga.end),
-                                      },
-                                  @"overflow": SKMutableObject(YGOverflowEnumMap[@(node.yoga.overflow)]),
-                                  @"display": SKMutableObject(YGDisplayEnumMap[@(node.yoga.display)]),
-                                  @"flex": @{
-                                      @"flexDirection": SKMutableObject(YGFlexDirectionEnumMap[@(node.yoga.flexDirection)]),
-                                      @"flexWrap": SKMutableObject(YGWrapEnumMap[@(node.yoga.flexWrap)]),
-                                      @"flexGrow": SKMutableObject(@(node.yoga.flexGrow)),
-                                      @"flexShrink": SKMutableObject(@(node.yoga.flexShrink)),
-                                      @"flexBasis": SKYGValueObject(node.yoga.flexBasis),
-                                      },
-                                  @"margin": @{
-                                      @"left": SKYGValueObject(node.yoga.marginLeft),
-                                      @"top": SKYGValueObject(node.yoga.marginTop),
-                                      @"right": SKYGValueObject(node.yoga.marginRight),
-                                      @"bottom": SKYGValueObject(node.yoga.marginBottom),
-                                      @"start": SKYGValueObject(node.yoga.marginStart),
-                                      @"end": SKYGValueObject(node.yoga.marginEnd),
-                                      @"horizontal": SKYGValueObject(node.yoga.marginHorizontal),
-                                      @"vertical": SKYGValueObject(node.yoga.marginVertical),
-                                      @"all": SKYGValueObject(node.yoga.margin),
-                                      },
-                                  @"padding": @{
-                                      @"left": SKYGValueObject(node.yoga.paddingLeft),
-                                      @"top": SKYGValueObject(node.yoga.paddingTop),
-                                      @"right": SKYGValueObject(node.yoga.paddingRight),
-                                      @"bottom": SKYGValueObject(node.yoga.paddingBottom),
-                                      @"start": SKYGValueObject(node.yoga.paddingStart),
-                                      @"end": SKYGValueObject(node.yoga.paddingEnd),
-                                      @"horizontal": SKYGValueObject(node.yoga.paddingHorizontal),
-                                      @"vertical": SKYGValueObject(node.yoga.paddingVertical),
-                                      @"all": SKYGValueObject(node.yoga.padding),
-                                      },
-                                  @"border": @{
-                                      @"leftWidth": SKMutableObject(@(node.yoga.borderLeftWidth)),
-                                      @"topWidth": SKMutableObject(@(node.yoga.borderTopWidth)),
-                                      @"rightWidth": SKMutableObject(@(node.yoga.borderRightWidth)),
-                                      @"bottomWidth": SKMutableObject(@(node.yoga.borderBottomWidth)),
-                                      @"startWidth": SKMutableObject(@(node.yoga.borderStartWidth)),
-                                      @"endWidth": SKMutableObject(@(node.yoga.borderEndWidth)),
-                                      @"all": SKMutableObject(@(node.yoga.borderWidth)),
-                                      },
-                                  @"dimensions": @{
-                                      @"width": SKYGValueObject(node.yoga.width),
-                                      @"height": SKYGValueObject(node.yoga.height),
-                                      @"minWidth": SKYGValueObject(node.yoga.minWidth),
-                                      @"minHeight": SKYGValueObject(node.yoga.minHeight),
-                                      @"maxWidth": SKYGValueObject(node.yoga.maxWidth),
-                                      @"maxHeight": SKYGValueObject(node.yoga.maxHeight),
-                                      },
-                                  @"aspectRatio": SKMutableObject(@(node.yoga.aspectRatio)),
-                                  @"resolvedDirection": SKObject(YGDirectionEnumMap[@(node.yoga.resolvedDirection)]),
-                                  }],
+                     withValue: YogaLayoutData(node)],
           nil];
 }
 
@@ -524,11 +497,11 @@ static void initEnumDictionaries() {
   });
 }
 
-static NSDictionary *SKYGValueObject(YGValue value) {
-  return @{
-           @"value": SKMutableObject(@(value.value)),
-           @"unit": SKMutableObject(YGUnitEnumMap[@(value.unit)]),
-           };
+static NSDictionary *YogaLayoutData(UIView *view) {
+  // Built in C++ straight from the YGNodeRef and converted back to JSON as is,
+  // without going through Obj-C objects on the way.
+  auto data = std::make_shared<folly::dynamic>(SKYogaLayoutData(view.yoga.node));
+  return facebook::cxxutils::convertFollyDynamicToLazyId(std::move(data));
 }
 
 /*
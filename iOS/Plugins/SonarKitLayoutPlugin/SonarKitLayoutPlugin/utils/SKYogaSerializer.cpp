@@ -0,0 +1,183 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#if FB_SONARKIT_ENABLED
+
+#include "SKYogaSerializer.h"
+
+#include <cmath>
+
+static const char *SKDirectionName(YGDirection direction) {
+  switch (direction) {
+    case YGDirectionInherit: return "inherit";
+    case YGDirectionLTR: return "LTR";
+    case YGDirectionRTL: return "RTL";
+  }
+  return nullptr;
+}
+
+static const char *SKFlexDirectionName(YGFlexDirection flexDirection) {
+  switch (flexDirection) {
+    case YGFlexDirectionColumn: return "column";
+    case YGFlexDirectionColumnReverse: return "column-reverse";
+    case YGFlexDirectionRow: return "row";
+    case YGFlexDirectionRowReverse: return "row-reverse";
+  }
+  return nullptr;
+}
+
+static const char *SKJustifyName(YGJustify justify) {
+  switch (justify) {
+    case YGJustifyFlexStart: return "flex-start";
+    case YGJustifyCenter: return "center";
+    case YGJustifyFlexEnd: return "flex-end";
+    case YGJustifySpaceBetween: return "space-between";
+    case YGJustifySpaceAround: return "space-around";
+    default: return nullptr;
+  }
+}
+
+static const char *SKAlignName(YGAlign align) {
+  switch (align) {
+    case YGAlignAuto: return "auto";
+    case YGAlignFlexStart: return "flex-start";
+    // Same as YGAlignEnumMap, which mutations are mapped back through.
+    case YGAlignCenter: return "end";
+    case YGAlignFlexEnd: return "flex-end";
+    case YGAlignStretch: return "stretch";
+    case YGAlignBaseline: return "baseline";
+    case YGAlignSpaceBetween: return "space-between";
+    case YGAlignSpaceAround: return "space-around";
+  }
+  return nullptr;
+}
+
+static const char *SKPositionTypeName(YGPositionType positionType) {
+  switch (positionType) {
+    case YGPositionTypeRelative: return "relative";
+    case YGPositionTypeAbsolute: return "absolute";
+  }
+  return nullptr;
+}
+
+static const char *SKWrapName(YGWrap wrap) {
+  switch (wrap) {
+    case YGWrapNoWrap: return "no-wrap";
+    case YGWrapWrap: return "wrap";
+    case YGWrapWrapReverse: return "wrap-reverse";
+  }
+  return nullptr;
+}
+
+static const char *SKOverflowName(YGOverflow overflow) {
+  switch (overflow) {
+    case YGOverflowVisible: return "visible";
+    case YGOverflowHidden: return "hidden";
+    case YGOverflowScroll: return "scroll";
+  }
+  return nullptr;
+}
+
+static const char *SKDisplayName(YGDisplay display) {
+  switch (display) {
+    case YGDisplayFlex: return "flex";
+    case YGDisplayNone: return "none";
+  }
+  return nullptr;
+}
+
+static const char *SKUnitName(YGUnit unit) {
+  switch (unit) {
+    case YGUnitUndefined: return "undefined";
+    case YGUnitPoint: return "point";
+    case YGUnitPercent: return "percent";
+    case YGUnitAuto: return "auto";
+  }
+  return nullptr;
+}
+
+static folly::dynamic SKName(const char *name) {
+  return name ? folly::dynamic(name) : folly::dynamic(nullptr);
+}
+
+static folly::dynamic SKNumber(float value) {
+  return std::isnan(value) ? folly::dynamic(nullptr) : folly::dynamic(double(value));
+}
+
+static folly::dynamic SKMutable(folly::dynamic value) {
+  return folly::dynamic::object
+    ("__type__", "auto")
+    ("__mutable__", true)
+    ("value", std::move(value));
+}
+
+static folly::dynamic SKValue(YGValue value) {
+  return folly::dynamic::object
+    ("value", SKMutable(SKNumber(value.value)))
+    ("unit", SKMutable(SKName(SKUnitName(value.unit))));
+}
+
+template <typename Getter>
+static folly::dynamic SKEdges(YGNodeRef node, Getter getter) {
+  return folly::dynamic::object
+    ("left", SKValue(getter(node, YGEdgeLeft)))
+    ("top", SKValue(getter(node, YGEdgeTop)))
+    ("right", SKValue(getter(node, YGEdgeRight)))
+    ("bottom", SKValue(getter(node, YGEdgeBottom)))
+    ("start", SKValue(getter(node, YGEdgeStart)))
+    ("end", SKValue(getter(node, YGEdgeEnd)))
+    ("horizontal", SKValue(getter(node, YGEdgeHorizontal)))
+    ("vertical", SKValue(getter(node, YGEdgeVertical)))
+    ("all", SKValue(getter(node, YGEdgeAll)));
+}
+
+folly::dynamic SKYogaLayoutData(YGNodeRef node) {
+  return folly::dynamic::object
+    ("direction", SKMutable(SKName(SKDirectionName(YGNodeStyleGetDirection(node)))))
+    ("justifyContent", SKMutable(SKName(SKJustifyName(YGNodeStyleGetJustifyContent(node)))))
+    ("aligns", folly::dynamic::object
+      ("alignContent", SKMutable(SKName(SKAlignName(YGNodeStyleGetAlignContent(node)))))
+      ("alignItems", SKMutable(SKName(SKAlignName(YGNodeStyleGetAlignItems(node)))))
+      ("alignSelf", SKMutable(SKName(SKAlignName(YGNodeStyleGetAlignSelf(node))))))
+    ("position", folly::dynamic::object
+      ("type", SKMutable(SKName(SKPositionTypeName(YGNodeStyleGetPositionType(node)))))
+      ("left", SKValue(YGNodeStyleGetPosition(node, YGEdgeLeft)))
+      ("top", SKValue(YGNodeStyleGetPosition(node, YGEdgeTop)))
+      ("right", SKValue(YGNodeStyleGetPosition(node, YGEdgeRight)))
+      ("bottom", SKValue(YGNodeStyleGetPosition(node, YGEdgeBottom)))
+      ("start", SKValue(YGNodeStyleGetPosition(node, YGEdgeStart)))
+      ("end", SKValue(YGNodeStyleGetPosition(node, YGEdgeEnd))))
+    ("overflow", SKMutable(SKName(SKOverflowName(YGNodeStyleGetOverflow(node)))))
+    ("display", SKMutable(SKName(SKDisplayName(YGNodeStyleGetDisplay(node)))))
+    ("flex", folly::dynamic::object
+      ("flexDirection", SKMutable(SKName(SKFlexDirectionName(YGNodeStyleGetFlexDirection(node)))))
+      ("flexWrap", SKMutable(SKName(SKWrapName(YGNodeStyleGetFlexWrap(node)))))
+      ("flexGrow", SKMutable(SKNumber(YGNodeStyleGetFlexGrow(node))))
+      ("flexShrink", SKMutable(SKNumber(YGNodeStyleGetFlexShrink(node))))
+      ("flexBasis", SKValue(YGNodeStyleGetFlexBasis(node))))
+    ("margin", SKEdges(node, YGNodeStyleGetMargin))
+    ("padding", SKEdges(node, YGNodeStyleGetPadding))
+    ("border", folly::dynamic::object
+      ("leftWidth", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeLeft))))
+      ("topWidth", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeTop))))
+      ("rightWidth", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeRight))))
+      ("bottomWidth", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeBottom))))
+      ("startWidth", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeStart))))
+      ("endWidth", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeEnd))))
+      ("all", SKMutable(SKNumber(YGNodeStyleGetBorder(node, YGEdgeAll)))))
+    ("dimensions", folly::dynamic::object
+      ("width", SKValue(YGNodeStyleGetWidth(node)))
+      ("height", SKValue(YGNodeStyleGetHeight(node)))
+      ("minWidth", SKValue(YGNodeStyleGetMinWidth(node)))
+      ("minHeight", SKValue(YGNodeStyleGetMinHeight(node)))
+      ("maxWidth", SKValue(YGNodeStyleGetMaxWidth(node)))
+      ("maxHeight", SKValue(YGNodeStyleGetMaxHeight(node))))
+    ("aspectRatio", SKMutable(SKNumber(YGNodeStyleGetAspectRatio(node))))
+    ("resolvedDirection", SKName(SKDirectionName(YGNodeLayoutGetDirection(node))));
+}
+
+#endif
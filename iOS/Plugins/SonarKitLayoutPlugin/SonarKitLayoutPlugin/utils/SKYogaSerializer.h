@@ -0,0 +1,22 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#pragma once
+
+#include <folly/dynamic.h>
+#include <yoga/Yoga.h>
+
+/**
+ The YGLayout data section for node, read straight from its style and layout
+ through the Yoga C API. Editable values are in the same `__mutable__` form
+ SKMutableObject produces, and enum values use the names the mutations in
+ SKViewDescriptor map back from. Undefined values are null.
+
+ Only depends on folly and Yoga, so any descriptor that can get at a
+ YGNodeRef can use it.
+ */
+folly::dynamic SKYogaLayoutData(YGNodeRef node);
@@ -12,8 +12,10 @@
 #import <SonarKitLayoutPlugin/SKDescriptorMapper.h>
 #import <SonarKitLayoutPlugin/SKNodeDescriptor.h>
 #import <SonarKitLayoutPlugin/SonarKitLayoutPlugin.h>
+#import <SonarKitLayoutPlugin/UIView+SKInvalidation.h>
 #import <SonarKitTestUtils/SonarConnectionMock.h>
 #import <SonarKitTestUtils/SonarResponderMock.h>
+#import <SonarKitTestUtils/SonarStreamResponderMock.h>
 
 #import "SKTapListenerMock.h"
 #import "TestNode.h"
@@ -59,6 +61,99 @@
                                                        }]));
 }
 
+- (void)testMarksTrackedViews {
+  UIView *rootView = [UIView new];
+  UIView *untrackedView = [UIView new];
+  SonarKitLayoutPlugin *plugin = [[SonarKitLayoutPlugin alloc]
+                                  initWithRootNode: rootView
+                                  withTapListener: nil
+                                  withDescriptorMapper: _descriptorMapper];
+
+  SonarConnectionMock *connection = [SonarConnectionMock new];
+  SonarResponderMock *responder = [SonarResponderMock new];
+  [plugin didConnect:connection];
+  XCTAssertFalse([rootView sk_isTracked]);
+
+  connection.receivers[@"getRoot"](@{}, responder);
+
+  XCTAssertTrue([rootView sk_isTracked]);
+  XCTAssertFalse([untrackedView sk_isTracked]);
+}
+
+- (void)testGetSubtree {
+  TestNode *rootNode = [[TestNode alloc] initWithName: @"rootNode"];
+  TestNode *childNode = [[TestNode alloc] initWithName: @"testNode1"];
+  childNode.children = @[ [[TestNode alloc] initWithName: @"testNode2"] ];
+  rootNode.children = @[ childNode ];
+
+  SonarKitLayoutPlugin *plugin = [[SonarKitLayoutPlugin alloc] initWithRootNode: rootNode
+                                                                withTapListener: nil
+                                                           withDescriptorMapper: _descriptorMapper];
+
+  SonarConnectionMock *connection = [SonarConnectionMock new];
+  SonarResponderMock *responder = [SonarResponderMock new];
+  [plugin didConnect:connection];
+
+  connection.receivers[@"getRoot"](@{}, responder);
+  connection.receivers[@"getSubtree"](@{@"id": @"rootNode", @"depth": @1}, responder);
+  NSDictionary *subtree = responder.successes.lastObject;
+  XCTAssertEqualObjects([subtree[@"elements"] valueForKey: @"id"], (@[ @"rootNode", @"testNode1" ]));
+  XCTAssertEqualObjects(subtree[@"complete"], @YES);
+
+  connection.receivers[@"getSubtree"](@{@"id": @"rootNode", @"depth": @5}, responder);
+  subtree = responder.successes.lastObject;
+  XCTAssertEqualObjects([subtree[@"elements"] valueForKey: @"id"], (@[ @"rootNode", @"testNode1", @"testNode2" ]));
+}
+
+- (void)testGetViewHierarchy {
+  UIView *rootView = [[UIView alloc] initWithFrame: CGRectMake(0, 0, 100, 200)];
+  UILabel *label = [[UILabel alloc] initWithFrame: CGRectMake(10, 20, 30, 40)];
+  label.text = @"Hello";
+  UIView *hiddenView = [UIView new];
+  hiddenView.hidden = YES;
+  UIView *container = [UIView new];
+  [container addSubview: [UIView new]];
+  [rootView addSubview: label];
+  [rootView addSubview: hiddenView];
+  [rootView addSubview: container];
+
+  SonarKitLayoutPlugin *plugin = [[SonarKitLayoutPlugin alloc] initWithRootNode: rootView
+                                                                withTapListener: nil
+                                                           withDescriptorMapper: _descriptorMapper];
+  SonarConnectionMock *connection = [SonarConnectionMock new];
+  SonarResponderMock *responder = [SonarResponderMock new];
+  [plugin didConnect:connection];
+
+  // Encoded off the main thread.
+  connection.receivers[@"getViewHierarchy"](@{}, responder);
+  [self expectationForPredicate: [NSPredicate predicateWithFormat: @"successes.@count == 1"]
+            evaluatedWithObject: responder
+                        handler: nil];
+  [self waitForExpectationsWithTimeout: 5 handler: nil];
+
+  NSDictionary *hierarchy = responder.successes.lastObject;
+  XCTAssertEqual([hierarchy[@"ids"] count], 4);
+  XCTAssertEqualObjects(hierarchy[@"ids"][0], ([NSString stringWithFormat: @"%p", rootView]));
+  XCTAssertEqualObjects(hierarchy[@"ids"][2], ([NSString stringWithFormat: @"%p", container]));
+  XCTAssertEqualObjects(hierarchy[@"parents"], (@[ @-1, @0, @0, @2 ]));
+  XCTAssertEqualObjects(hierarchy[@"classNames"][[hierarchy[@"classes"][1] unsignedIntegerValue]], @"UILabel");
+  XCTAssertEqualObjects([hierarchy[@"frames"] subarrayWithRange: NSMakeRange(0, 8)],
+                        (@[ @0, @0, @100, @200, @10, @20, @30, @40 ]));
+  XCTAssertEqualObjects(hierarchy[@"textIndexes"], (@[ @1 ]));
+  XCTAssertEqualObjects(hierarchy[@"texts"], (@[ @"Hello" ]));
+  XCTAssertEqualObjects(hierarchy[@"complete"], @YES);
+
+  connection.receivers[@"getViewHierarchy"](@{@"maxNodes": @2}, responder);
+  [self expectationForPredicate: [NSPredicate predicateWithFormat: @"successes.@count == 2"]
+            evaluatedWithObject: responder
+                        handler: nil];
+  [self waitForExpectationsWithTimeout: 5 handler: nil];
+  hierarchy = responder.successes.lastObject;
+  XCTAssertEqual([hierarchy[@"ids"] count], 2);
+  XCTAssertEqualObjects(hierarchy[@"complete"], @NO);
+  XCTAssertTrue([label sk_isTracked]);
+}
+
 - (void)testGetEmptyNodes {
   SonarKitLayoutPlugin *plugin = [SonarKitLayoutPlugin new];
   SonarConnectionMock *connection = [SonarConnectionMock new];
@@ -245,6 +340,34 @@
   XCTAssertTrue([testNode3.nodeName isEqualToString: @"changedNameForTestNode3"]);
 }
 
+- (void)testStreamsSearchResults {
+  TestNode *rootNode = [[TestNode alloc] initWithName: @"rootNode"];
+  TestNode *testNode1 = [[TestNode alloc] initWithName: @"testNode1"];
+  TestNode *otherNode = [[TestNode alloc] initWithName: @"otherNode"];
+  rootNode.children = @[ testNode1, otherNode ];
+
+  SonarKitLayoutPlugin *plugin = [[SonarKitLayoutPlugin alloc] initWithRootNode: rootNode
+                                                                withTapListener: nil
+                                                           withDescriptorMapper: _descriptorMapper];
+
+  SonarConnectionMock *connection = [SonarConnectionMock new];
+  SonarStreamResponderMock *responder = [SonarStreamResponderMock new];
+  [plugin didConnect:connection];
+
+  connection.streamReceivers[@"getSearchResultsStream"](@{ @"query": @"testnode1" }, responder);
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow: 5];
+  while (!responder.completed && responder.errors.count == 0 && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop mainRunLoop] runUntilDate: [NSDate dateWithTimeIntervalSinceNow: 0.01]];
+  }
+
+  XCTAssertTrue(responder.completed);
+  XCTAssertEqual(responder.chunks.count, 1u);
+  XCTAssertEqualObjects(responder.chunks[0][@"query"], @"testnode1");
+  NSDictionary *results = responder.chunks[0][@"results"];
+  XCTAssertEqualObjects(results[@"id"], @"rootNode");
+  XCTAssertEqualObjects([results[@"children"] valueForKey: @"id"], @[ @"testNode1" ]);
+}
+
 @end
 
 #endif
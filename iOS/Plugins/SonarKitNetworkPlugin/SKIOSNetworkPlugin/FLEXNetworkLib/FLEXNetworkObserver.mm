@@ -33,6 +33,8 @@ typedef void (^NSURLSessionAsyncCompletion)(id fileURLOrData, NSURLResponse *res
 
 @property (nonatomic, copy) NSURLRequest *request;
 @property (nonatomic, strong) NSMutableData *dataAccumulator;
+/// Set once body capture has been decided on, after which dataAccumulator is only nil if the body isn't captured.
+@property (nonatomic, assign) BOOL bodyCaptureStarted;
 
 @end
 
@@ -40,6 +42,43 @@ typedef void (^NSURLSessionAsyncCompletion)(id fileURLOrData, NSURLResponse *res
 
 @end
 
+/// Starts capturing the response body of the request, or stops it if the recorder doesn't want it.
+static void FLEXStartCapturingBody(FLEXInternalRequestState *requestState, NSString *requestID, NSURLResponse *response, int64_t expectedLength)
+{
+    FLEXNetworkRecorder *recorder = [FLEXNetworkRecorder defaultRecorder];
+    requestState.bodyCaptureStarted = YES;
+    if (![recorder shouldCaptureBodyForRequestID:requestID response:response]) {
+        requestState.dataAccumulator = nil;
+        return;
+    }
+    const NSUInteger limit = recorder.bodyCaptureByteLimit;
+    requestState.dataAccumulator = [[NSMutableData alloc] initWithCapacity:expectedLength > 0 ? MIN((NSUInteger)expectedLength, limit) : 0];
+}
+
+/// Appends as much of data as still fits under the capture limit.
+static void FLEXCaptureBodyData(FLEXInternalRequestState *requestState, NSData *data)
+{
+    NSMutableData *accumulator = requestState.dataAccumulator;
+    const NSUInteger limit = [FLEXNetworkRecorder defaultRecorder].bodyCaptureByteLimit;
+    if (!accumulator || accumulator.length >= limit) {
+        return;
+    }
+    [accumulator appendBytes:data.bytes length:MIN(data.length, limit - accumulator.length)];
+}
+
+/// Reads no more of the file than would be captured, and nothing if the body isn't captured.
+static NSData *FLEXCapturedContentsOfFile(NSURL *fileURL, NSString *requestID, NSURLResponse *response)
+{
+    FLEXNetworkRecorder *recorder = [FLEXNetworkRecorder defaultRecorder];
+    if (![recorder shouldCaptureBodyForRequestID:requestID response:response]) {
+        return nil;
+    }
+    NSFileHandle *file = [NSFileHandle fileHandleForReadingFromURL:fileURL error:NULL];
+    NSData *data = [file readDataOfLength:recorder.bodyCaptureByteLimit];
+    [file closeFile];
+    return data;
+}
+
 @interface FLEXNetworkObserver (NSURLConnectionHelpers)
 
 - (void)connection:(NSURLConnection *)connection willSendRequest:(NSURLRequest *)request redirectResponse:(NSURLResponse *)response delegate:(id<NSURLConnectionDelegate>)delegate;
@@ -458,12 +497,17 @@ didBecomeDownloadTask:(NSURLSessionDownloadTask *)downloadTask delegate:(id<NSUR
         [[FLEXNetworkRecorder defaultRecorder] recordMechanism:mechanism forRequestID:requestID];
         [[FLEXNetworkRecorder defaultRecorder] recordResponseReceivedWithRequestID:requestID response:response];
         NSData *data = nil;
+        int64_t dataLength = 0;
         if ([fileURLOrData isKindOfClass:[NSURL class]]) {
-            data = [NSData dataWithContentsOfURL:fileURLOrData];
+            NSNumber *fileSize = nil;
+            [fileURLOrData getResourceValue:&fileSize forKey:NSURLFileSizeKey error:NULL];
+            dataLength = fileSize.longLongValue;
+            data = FLEXCapturedContentsOfFile(fileURLOrData, requestID, response);
         } else if ([fileURLOrData isKindOfClass:[NSData class]]) {
             data = fileURLOrData;
+            dataLength = data.length;
         }
-        [[FLEXNetworkRecorder defaultRecorder] recordDataReceivedWithRequestID:requestID dataLength:[data length]];
+        [[FLEXNetworkRecorder defaultRecorder] recordDataReceivedWithRequestID:requestID dataLength:dataLength];
         if (error) {
             [[FLEXNetworkRecorder defaultRecorder] recordLoadingFailedWithRequestID:requestID error:error];
         } else {
@@ -792,7 +836,8 @@ didBecomeDownloadTask:(NSURLSessionDownloadTask *)downloadTask delegate:(id<NSUR
     typedef void (^NSURLSessionDownloadTaskDidFinishDownloadingBlock)(id<NSURLSessionTaskDelegate> slf, NSURLSession *session, NSURLSessionDownloadTask *task, NSURL *location);
 
     NSURLSessionDownloadTaskDidFinishDownloadingBlock undefinedBlock = ^(id<NSURLSessionTaskDelegate> slf, NSURLSession *session, NSURLSessionDownloadTask *task, NSURL *location) {
-        NSData *data = [NSData dataWithContentsOfFile:location.relativePath];
+        NSString *requestID = [self requestIDForConnectionOrTask:task];
+        NSData *data = FLEXCapturedContentsOfFile(location, requestID, task.response);
         [[FLEXNetworkObserver sharedObserver] URLSession:session task:task didFinishDownloadingToURL:location data:data delegate:slf];
     };
 
@@ -907,13 +952,7 @@ static char const *const kFLEXRequestIDKey = "kFLEXRequestIDKey";
         NSString *requestID = [[self class] requestIDForConnectionOrTask:connection];
         FLEXInternalRequestState *requestState = [self requestStateForRequestID:requestID];
 
-        NSMutableData *dataAccumulator = nil;
-        if (response.expectedContentLength < 0) {
-            dataAccumulator = [NSMutableData new];
-        } else {
-            dataAccumulator = [[NSMutableData alloc] initWithCapacity:(NSUInteger)response.expectedContentLength];
-        }
-        requestState.dataAccumulator = dataAccumulator;
+        FLEXStartCapturingBody(requestState, requestID, response, response.expectedContentLength);
 
         [[FLEXNetworkRecorder defaultRecorder] recordResponseReceivedWithRequestID:requestID response:response];
     }];
@@ -926,7 +965,7 @@ static char const *const kFLEXRequestIDKey = "kFLEXRequestIDKey";
     [self performBlock:^{
         NSString *requestID = [[self class] requestIDForConnectionOrTask:connection];
         FLEXInternalRequestState *requestState = [self requestStateForRequestID:requestID];
-        [requestState.dataAccumulator appendData:data];
+        FLEXCaptureBodyData(requestState, data);
         [[FLEXNetworkRecorder defaultRecorder] recordDataReceivedWithRequestID:requestID dataLength:data.length];
     }];
 }
@@ -986,13 +1025,7 @@ static char const *const kFLEXRequestIDKey = "kFLEXRequestIDKey";
         NSString *requestID = [[self class] requestIDForConnectionOrTask:dataTask];
         FLEXInternalRequestState *requestState = [self requestStateForRequestID:requestID];
 
-        NSMutableData *dataAccumulator = nil;
-        if (response.expectedContentLength < 0) {
-            dataAccumulator = [NSMutableData new];
-        } else {
-            dataAccumulator = [[NSMutableData alloc] initWithCapacity:(NSUInteger)response.expectedContentLength];
-        }
-        requestState.dataAccumulator = dataAccumulator;
+        FLEXStartCapturingBody(requestState, requestID, response, response.expectedContentLength);
 
         NSString *requestMechanism = [NSString stringWithFormat:@"NSURLSessionDataTask (delegate: %@)", [delegate class]];
         [[FLEXNetworkRecorder defaultRecorder] recordMechanism:requestMechanism forRequestID:requestID];
@@ -1019,7 +1052,7 @@ static char const *const kFLEXRequestIDKey = "kFLEXRequestIDKey";
         NSString *requestID = [[self class] requestIDForConnectionOrTask:dataTask];
         FLEXInternalRequestState *requestState = [self requestStateForRequestID:requestID];
 
-        [requestState.dataAccumulator appendData:data];
+        FLEXCaptureBodyData(requestState, data);
 
         [[FLEXNetworkRecorder defaultRecorder] recordDataReceivedWithRequestID:requestID dataLength:data.length];
     }];
@@ -1047,9 +1080,8 @@ static char const *const kFLEXRequestIDKey = "kFLEXRequestIDKey";
         NSString *requestID = [[self class] requestIDForConnectionOrTask:downloadTask];
         FLEXInternalRequestState *requestState = [self requestStateForRequestID:requestID];
 
-        if (!requestState.dataAccumulator) {
-            NSUInteger unsignedBytesExpectedToWrite = totalBytesExpectedToWrite > 0 ? (NSUInteger)totalBytesExpectedToWrite : 0;
-            requestState.dataAccumulator = [[NSMutableData alloc] initWithCapacity:unsignedBytesExpectedToWrite];
+        if (!requestState.bodyCaptureStarted) {
+            FLEXStartCapturingBody(requestState, requestID, downloadTask.response, totalBytesExpectedToWrite);
             [[FLEXNetworkRecorder defaultRecorder] recordResponseReceivedWithRequestID:requestID response:downloadTask.response];
 
             NSString *requestMechanism = [NSString stringWithFormat:@"NSURLSessionDownloadTask (delegate: %@)", [delegate class]];
@@ -1066,7 +1098,7 @@ static char const *const kFLEXRequestIDKey = "kFLEXRequestIDKey";
     [self performBlock:^{
         NSString *requestID = [[self class] requestIDForConnectionOrTask:downloadTask];
         FLEXInternalRequestState *requestState = [self requestStateForRequestID:requestID];
-        [requestState.dataAccumulator appendData:data];
+        FLEXCaptureBodyData(requestState, data);
     }];
 }
 
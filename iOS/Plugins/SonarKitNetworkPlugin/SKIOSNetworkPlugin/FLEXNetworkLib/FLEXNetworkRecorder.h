@@ -33,6 +33,22 @@ extern NSString *const kFLEXNetworkRecorderTransactionsClearedNotification;
 
 @property (nonatomic, copy) NSArray<NSString *> *hostBlacklist;
 
+/// Bodies are captured up to this many bytes, the rest is dropped as it arrives. Defaults to 1 MB.
+@property (atomic, assign) NSUInteger bodyCaptureByteLimit;
+
+/// Only response bodies whose MIME type starts with one of these are captured, those of responses without a MIME type always are.
+/// Defaults to text and the common structured data types.
+@property (atomic, copy) NSArray<NSString *> *bodyCaptureContentTypePrefixes;
+
+/// The share of requests whose response bodies are captured, from 0 to 1. Defaults to 1.
+@property (atomic, assign) double bodyCaptureSampleRate;
+
+/// Whether requests to url are recorded at all, as the delegate decides. Safe to call from any thread.
+- (BOOL)shouldObserveURL:(NSURL *)url;
+
+/// Whether the response body of the request should be captured at all. Safe to call from any thread, and always gives the same answer for a request.
+- (BOOL)shouldCaptureBodyForRequestID:(NSString *)requestID response:(NSURLResponse *)response;
+
 
 // Accessing recorded network activity
 
@@ -57,7 +73,7 @@ extern NSString *const kFLEXNetworkRecorderTransactionsClearedNotification;
 /// Call when data chunk is received over the network.
 - (void)recordDataReceivedWithRequestID:(NSString *)requestID dataLength:(int64_t)dataLength;
 
-/// Call when HTTP request has finished loading.
+/// Call when HTTP request has finished loading. Bodies that should not be captured are dropped and longer ones are truncated, see bodyCaptureByteLimit.
 - (void)recordLoadingFinishedWithRequestID:(NSString *)requestID responseBody:(NSData *)responseBody;
 
 /// Call when HTTP request has failed to load.
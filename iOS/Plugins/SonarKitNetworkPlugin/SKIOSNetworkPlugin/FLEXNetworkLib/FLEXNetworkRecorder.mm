@@ -47,6 +47,10 @@ NSString *const kFLEXNetworkRecorderResponseCacheLimitDefaultsKey = @"com.flex.r
         // Serial queue used because we use mutable objects that are not thread safe
         _queue = dispatch_queue_create("com.flex.FLEXNetworkRecorder", DISPATCH_QUEUE_SERIAL);
         _identifierDict = [NSMutableDictionary dictionary];
+
+        _bodyCaptureByteLimit = 1024 * 1024;
+        _bodyCaptureContentTypePrefixes = @[ @"text/", @"application/json", @"application/xml", @"application/javascript", @"application/x-www-form-urlencoded", @"application/graphql" ];
+        _bodyCaptureSampleRate = 1;
     }
     return self;
 }
@@ -101,10 +105,55 @@ NSString *const kFLEXNetworkRecorderResponseCacheLimitDefaultsKey = @"com.flex.r
     });
 }
 
+- (BOOL)shouldObserveURL:(NSURL *)url
+{
+    id<SKNetworkReporterDelegate> delegate = self.delegate;
+    return ![delegate respondsToSelector:@selector(shouldObserveURL:)] || [delegate shouldObserveURL:url];
+}
+
+- (BOOL)shouldCaptureBodyForRequestID:(NSString *)requestID response:(NSURLResponse *)response
+{
+    if (![self shouldObserveURL:response.URL]) {
+        return NO;
+    }
+    const double sampleRate = self.bodyCaptureSampleRate;
+    if (sampleRate <= 0) {
+        return NO;
+    }
+    if (sampleRate < 1) {
+        // Decided by the request ID rather than at random, so every part of a response is treated the same.
+        const NSUInteger buckets = 10000;
+        if ([requestID hash] % buckets >= sampleRate * buckets) {
+            return NO;
+        }
+    }
+
+    NSString *mimeType = response.MIMEType;
+    if (!mimeType) {
+        return YES;
+    }
+    for (NSString *prefix in self.bodyCaptureContentTypePrefixes) {
+        if ([mimeType rangeOfString:prefix options:NSCaseInsensitiveSearch | NSAnchoredSearch].location != NSNotFound) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (NSData *)capturedBody:(NSData *)body
+{
+    const NSUInteger limit = self.bodyCaptureByteLimit;
+    return body.length > limit ? [body subdataWithRange:NSMakeRange(0, limit)] : body;
+}
+
 #pragma mark - Network Events
 
 - (void)recordRequestWillBeSentWithRequestID:(NSString *)requestID request:(NSURLRequest *)request redirectResponse:(NSURLResponse *)redirectResponse
 {
+  // Without a transaction, the rest of the request's events are ignored too.
+  if (![self shouldObserveURL:request.URL]) {
+    return;
+  }
   if (![self.identifierDict objectForKey:requestID]) {
     self.identifierDict[requestID] = [NSNumber random];
   }
@@ -116,7 +165,7 @@ NSString *const kFLEXNetworkRecorderResponseCacheLimitDefaultsKey = @"com.flex.r
     }
 
     dispatch_async(self.queue, ^{
-        SKRequestInfo *info = [[SKRequestInfo alloc] initWithIdentifier:self.identifierDict[requestID].longLongValue timestamp:[NSDate timestamp] request:request data:request.HTTPBody];
+        SKRequestInfo *info = [[SKRequestInfo alloc] initWithIdentifier:self.identifierDict[requestID].longLongValue timestamp:[NSDate timestamp] request:request data:[self capturedBody:request.HTTPBody]];
         [self.delegate didObserveRequest:info];
 
         FLEXNetworkTransaction *transaction = [FLEXNetworkTransaction new];
@@ -170,11 +219,12 @@ NSString *const kFLEXNetworkRecorderResponseCacheLimitDefaultsKey = @"com.flex.r
         }
         transaction.transactionState = FLEXNetworkTransactionStateFinished;
         transaction.duration = -[transaction.startTime timeIntervalSinceDate:finishedDate];
-        SKResponseInfo *responseInfo = [[SKResponseInfo alloc] initWithIndentifier:self.identifierDict[requestID].longLongValue timestamp:[NSDate timestamp] response:transaction.response data:responseBody];
+        NSData *capturedBody = [self shouldCaptureBodyForRequestID:requestID response:transaction.response] ? [self capturedBody:responseBody] : nil;
+        SKResponseInfo *responseInfo = [[SKResponseInfo alloc] initWithIndentifier:self.identifierDict[requestID].longLongValue timestamp:[NSDate timestamp] response:transaction.response data:capturedBody];
         self.identifierDict[requestID] = nil; //Clear the entry
         [self.delegate didObserveResponse:responseInfo];
 
-        BOOL shouldCache = [responseBody length] > 0;
+        BOOL shouldCache = [capturedBody length] > 0;
         if (!self.shouldCacheMediaResponses) {
             NSArray<NSString *> *ignoredMIMETypePrefixes = @[ @"audio", @"image", @"video" ];
             for (NSString *ignoredPrefix in ignoredMIMETypePrefixes) {
@@ -183,7 +233,7 @@ NSString *const kFLEXNetworkRecorderResponseCacheLimitDefaultsKey = @"com.flex.r
         }
 
         if (shouldCache) {
-            [self.responseCache setObject:responseBody forKey:requestID cost:[responseBody length]];
+            [self.responseCache setObject:capturedBody forKey:requestID cost:[capturedBody length]];
         }
     });
 }
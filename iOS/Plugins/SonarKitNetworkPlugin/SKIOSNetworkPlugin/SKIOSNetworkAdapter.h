@@ -14,6 +14,15 @@
 - (instancetype)init NS_DESIGNATED_INITIALIZER;
 @property (weak, nonatomic) id<SKNetworkReporterDelegate> delegate;
 
+// Which bodies are captured, shared by all adapters. Bodies are cut off
+// after bodyCaptureByteLimit bytes (1 MB by default). Response bodies are only
+// captured for MIME types starting with one of bodyCaptureContentTypePrefixes
+// (text and common structured data by default), and for the given share of
+// requests (all by default).
+@property (assign, nonatomic) NSUInteger bodyCaptureByteLimit;
+@property (copy, nonatomic) NSArray<NSString *> *bodyCaptureContentTypePrefixes;
+@property (assign, nonatomic) double bodyCaptureSampleRate;
+
 @end
 
 #endif
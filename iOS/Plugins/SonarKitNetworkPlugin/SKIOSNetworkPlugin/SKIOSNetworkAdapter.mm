@@ -26,6 +26,30 @@
   [FLEXNetworkRecorder defaultRecorder].delegate = _delegate;
 }
 
+- (NSUInteger)bodyCaptureByteLimit {
+  return [FLEXNetworkRecorder defaultRecorder].bodyCaptureByteLimit;
+}
+
+- (void)setBodyCaptureByteLimit:(NSUInteger)bodyCaptureByteLimit {
+  [FLEXNetworkRecorder defaultRecorder].bodyCaptureByteLimit = bodyCaptureByteLimit;
+}
+
+- (NSArray<NSString *> *)bodyCaptureContentTypePrefixes {
+  return [FLEXNetworkRecorder defaultRecorder].bodyCaptureContentTypePrefixes;
+}
+
+- (void)setBodyCaptureContentTypePrefixes:(NSArray<NSString *> *)bodyCaptureContentTypePrefixes {
+  [FLEXNetworkRecorder defaultRecorder].bodyCaptureContentTypePrefixes = bodyCaptureContentTypePrefixes;
+}
+
+- (double)bodyCaptureSampleRate {
+  return [FLEXNetworkRecorder defaultRecorder].bodyCaptureSampleRate;
+}
+
+- (void)setBodyCaptureSampleRate:(double)bodyCaptureSampleRate {
+  [FLEXNetworkRecorder defaultRecorder].bodyCaptureSampleRate = bodyCaptureSampleRate;
+}
+
 @end
 
 #endif
@@ -12,10 +12,45 @@
 #import "SKDispatchQueue.h"
 #import <iostream>
 #import <memory>
+#import <vector>
 
 struct CachedEvent {
   NSString *method;
-  NSDictionary<NSString *, id> *sonarObject;
+  // The event's params, serialized as JSON.
+  NSData *params;
+};
+
+/**
+Fixed capacity ring of events waiting for a connection. Once it holds
+capacity events, or their params take up more than maxBytes, the oldest
+events are overwritten.
+*/
+class CachedEventRing {
+ public:
+  CachedEventRing(size_t capacity = 0, size_t maxBytes = 0);
+
+  /**
+  Adds event, dropping the oldest events to make room. An event larger
+  than maxBytes on its own is dropped.
+  */
+  void push(CachedEvent event);
+
+  /**
+  Removes all events, oldest first.
+  */
+  std::vector<CachedEvent> drain();
+
+  size_t size() const { return count_; }
+  size_t bytes() const { return bytes_; }
+
+ private:
+  void dropOldest();
+
+  std::vector<CachedEvent> slots_;
+  size_t maxBytes_;
+  size_t head_ = 0;
+  size_t count_ = 0;
+  size_t bytes_ = 0;
 };
 
 
@@ -10,32 +10,71 @@
 #import <vector>
 
 #import "SKBufferingPlugin.h"
+#import <FBCxxUtils/FBCxxFollyDynamicConvert.h>
 #import <SonarKit/SonarConnection.h>
 #import "SKDispatchQueue.h"
 #import "SKBufferingPlugin+CPPInitialization.h"
 
 static const NSUInteger bufferSize = 500;
+// Events are kept serialized, this bounds what they can cost while there is
+// no connection.
+static const NSUInteger bufferBytes = 2 * 1024 * 1024;
+
+CachedEventRing::CachedEventRing(size_t capacity, size_t maxBytes)
+    : slots_(capacity), maxBytes_(maxBytes) {}
+
+void CachedEventRing::push(CachedEvent event) {
+  const size_t eventBytes = event.params.length;
+  if (slots_.empty() || eventBytes > maxBytes_) {
+    return;
+  }
+  while (count_ == slots_.size() || bytes_ + eventBytes > maxBytes_) {
+    dropOldest();
+  }
+  slots_[(head_ + count_) % slots_.size()] = std::move(event);
+  count_++;
+  bytes_ += eventBytes;
+}
+
+std::vector<CachedEvent> CachedEventRing::drain() {
+  std::vector<CachedEvent> events;
+  events.reserve(count_);
+  while (count_) {
+    events.push_back(std::move(slots_[head_]));
+    slots_[head_] = {};
+    head_ = (head_ + 1) % slots_.size();
+    count_--;
+  }
+  head_ = 0;
+  bytes_ = 0;
+  return events;
+}
+
+void CachedEventRing::dropOldest() {
+  bytes_ -= slots_[head_].params.length;
+  slots_[head_] = {};
+  head_ = (head_ + 1) % slots_.size();
+  count_--;
+}
 
 @interface SKBufferingPlugin()
 
-@property(assign, nonatomic) std::vector<CachedEvent> ringBuffer;
 @property(assign, nonatomic) std::shared_ptr<facebook::sonar::DispatchQueue> connectionAccessQueue;
 @property(strong, nonatomic) id<SonarConnection> connection;
 
 @end
 
 @implementation SKBufferingPlugin
-// {
-//   std::vector<CachedEvent> _ringBuffer;
-//   std::shared_ptr<facebook::sonar::DispatchQueue> _connectionAccessQueue;
-//
-//   id<SonarConnection> _connection;
-// }
+{
+  CachedEventRing _ringBuffer;
+}
 
 - (instancetype)initWithQueue:(dispatch_queue_t)queue {
   if (self = [super init]) {
-    _ringBuffer.reserve(bufferSize);
-    _connectionAccessQueue = std::make_shared<facebook::sonar::GCDQueue>(queue);
+    _ringBuffer = CachedEventRing(bufferSize, bufferBytes);
+    // Network heavy apps send thousands of events a second, so they are
+    // handed to the queue in batches.
+    _connectionAccessQueue = std::make_shared<facebook::sonar::CoalescingGCDQueue>(queue);
   }
   return self;
 }
@@ -64,12 +103,19 @@ static const NSUInteger bufferSize = 500;
     if (self->_connection) {
       [self->_connection send:method withParams:sonarObject];
     } else {
-      if (self->_ringBuffer.size() == bufferSize) {
-        return;
-      }
-      self->_ringBuffer.push_back({
+      // Serialized right away, so the event doesn't keep the objects it was
+      // made from alive.
+      auto json = facebook::cxxutils::convertIdToJSON(sonarObject, true);
+      json->coalesce();
+      folly::IOBuf *const buffer = json.release();
+      NSData *const params = [[NSData alloc] initWithBytesNoCopy:buffer->writableData()
+                                                          length:buffer->length()
+                                                     deallocator:^(void *, NSUInteger) {
+                                                       delete buffer;
+                                                     }];
+      self->_ringBuffer.push({
         .method = method,
-        .sonarObject = sonarObject
+        .params = params
       });
     }
   });
@@ -77,10 +123,15 @@ static const NSUInteger bufferSize = 500;
 
 - (void)sendBufferedEvents {
   NSAssert(_connection, @"connection object cannot be nil");
-  for (const auto &event : _ringBuffer) {
-    [_connection send:event.method withParams:event.sonarObject];
+  const BOOL sendsSerialized = [_connection respondsToSelector:@selector(send:withSerializedParams:)];
+  for (const auto &event : _ringBuffer.drain()) {
+    if (sendsSerialized) {
+      [_connection send:event.method withSerializedParams:event.params];
+    } else {
+      id params = [NSJSONSerialization JSONObjectWithData:event.params options:0 error:nil];
+      [_connection send:event.method withParams:params];
+    }
   }
-  _ringBuffer.clear();
 }
 
 @end
@@ -89,7 +140,7 @@ static const NSUInteger bufferSize = 500;
 
 - (instancetype)initWithVectorEventSize:(NSUInteger)size connectionAccessQueue:(std::shared_ptr<facebook::sonar::DispatchQueue>)connectionAccessQueue {
     if (self = [super init]) {
-      _ringBuffer.reserve(size);
+      _ringBuffer = CachedEventRing(size, bufferBytes);
       _connectionAccessQueue = connectionAccessQueue;
     }
     return self;
@@ -11,11 +11,15 @@
 
 #import <dispatch/dispatch.h>
 
+#import <atomic>
+#import <memory>
+
 namespace facebook {
   namespace sonar {
     class DispatchQueue
     {
     public:
+      virtual ~DispatchQueue() { }
       virtual void async(dispatch_block_t block) = 0;
     };
 
@@ -33,6 +37,95 @@ namespace facebook {
     private:
       dispatch_queue_t _underlyingQueue;
     };
+
+    /**
+     Runs blocks on underlyingQueue in the order they were added, like
+     GCDQueue, but blocks added in quick succession are run together by a
+     single dispatch. Adding a block pushes it on a lock free list and
+     triggers a DATA_ADD dispatch source, which GCD coalesces until the
+     source's handler drains the list.
+     */
+    class CoalescingGCDQueue: public DispatchQueue
+    {
+    public:
+      CoalescingGCDQueue(dispatch_queue_t underlyingQueue)
+      :_pending(std::make_shared<Pending>()),
+       _source(dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, underlyingQueue))
+      {
+        // The handler keeps the list alive, it may still run after the
+        // queue is gone.
+        std::shared_ptr<Pending> pending = _pending;
+        dispatch_source_set_event_handler(_source, ^{
+          pending->drain();
+        });
+        dispatch_resume(_source);
+      }
+
+      ~CoalescingGCDQueue() override
+      {
+        dispatch_source_cancel(_source);
+      }
+
+      void async(dispatch_block_t block) override
+      {
+        _pending->push(block);
+        dispatch_source_merge_data(_source, 1);
+      }
+
+    private:
+      struct Node {
+        dispatch_block_t block;
+        Node *next;
+      };
+
+      class Pending {
+      public:
+        ~Pending()
+        {
+          deleteList(_head.exchange(nullptr));
+        }
+
+        void push(dispatch_block_t block)
+        {
+          Node *node = new Node{block, _head.load(std::memory_order_relaxed)};
+          while (!_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) { }
+        }
+
+        void drain()
+        {
+          Node *node = _head.exchange(nullptr, std::memory_order_acquire);
+          // The list is newest first.
+          Node *oldest = nullptr;
+          while (node) {
+            Node *next = node->next;
+            node->next = oldest;
+            oldest = node;
+            node = next;
+          }
+          while (oldest) {
+            Node *next = oldest->next;
+            oldest->block();
+            delete oldest;
+            oldest = next;
+          }
+        }
+
+      private:
+        static void deleteList(Node *node)
+        {
+          while (node) {
+            Node *next = node->next;
+            delete node;
+            node = next;
+          }
+        }
+
+        std::atomic<Node *> _head{nullptr};
+      };
+
+      std::shared_ptr<Pending> _pending;
+      dispatch_source_t _source;
+    };
   }
 }
 
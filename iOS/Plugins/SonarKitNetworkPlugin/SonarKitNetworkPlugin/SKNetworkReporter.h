@@ -14,6 +14,13 @@
 - (void)didObserveRequest:(SKRequestInfo *)request;
 - (void)didObserveResponse:(SKResponseInfo *)response;
 
+@optional
+
+// Whether requests to url are wanted at all. Adapters check before reading a
+// request's headers or bodies, and don't report the requests that aren't.
+// Safe to call from any thread.
+- (BOOL)shouldObserveURL:(NSURL *)url;
+
 @end
 
 @protocol SKNetworkAdapterDelegate
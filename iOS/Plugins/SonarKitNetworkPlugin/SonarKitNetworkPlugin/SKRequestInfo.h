@@ -12,6 +12,8 @@
 @property(assign, readwrite) int64_t identifier;
 @property(assign, readwrite) uint64_t timestamp;
 @property(strong, nonatomic) NSURLRequest* request;
+@property(strong, nonatomic) NSData* bodyData;
+// Base64 encoding of bodyData, computed on every access.
 @property(strong, nonatomic) NSString* body;
 
 - (instancetype)initWithIdentifier:(int64_t)identifier timestamp:(uint64_t)timestamp request:(NSURLRequest*)request data:(NSData *)data;
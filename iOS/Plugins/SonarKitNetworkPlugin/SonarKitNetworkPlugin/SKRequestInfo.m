@@ -12,7 +12,7 @@
 @synthesize identifier = _identifier;
 @synthesize timestamp = _timestamp;
 @synthesize request = _request;
-@synthesize body = _body;
+@synthesize bodyData = _bodyData;
 
 - (instancetype)initWithIdentifier:(int64_t)identifier timestamp:(uint64_t)timestamp request:(NSURLRequest *)request data:(NSData *)data{
 
@@ -20,15 +20,21 @@
     _identifier = identifier;
     _timestamp = timestamp;
     _request = request;
-    _body = data ? [data base64EncodedStringWithOptions: 0]
-    : [request.HTTPBody base64EncodedStringWithOptions: 0];
+    _bodyData = data ?: request.HTTPBody;
   }
   return self;
 }
 
 - (void)setBodyFromData:(NSData * _Nullable)data {
-    self.body = data ? [data base64EncodedStringWithOptions: 0]
-    : [self.request.HTTPBody base64EncodedStringWithOptions: 0];
+    self.bodyData = data ?: self.request.HTTPBody;
+}
+
+- (NSString *)body {
+  return [self.bodyData base64EncodedStringWithOptions: 0];
+}
+
+- (void)setBody:(NSString *)body {
+  self.bodyData = body ? [[NSData alloc] initWithBase64EncodedString: body options: 0] : nil;
 }
 
 @end
@@ -13,6 +13,8 @@
 @property(assign, readwrite) int64_t identifier;
 @property(assign, readwrite) uint64_t timestamp;
 @property(strong, nonatomic) NSURLResponse* response;
+@property(strong, nonatomic) NSData* bodyData;
+// Base64 encoding of bodyData, computed on every access.
 @property(strong, nonatomic) NSString* body;
 
 - (instancetype)initWithIndentifier:(int64_t)identifier timestamp:(uint64_t)timestamp response:(NSURLResponse *)response data:(NSData *)data;
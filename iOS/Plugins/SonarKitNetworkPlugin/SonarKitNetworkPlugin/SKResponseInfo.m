@@ -12,14 +12,14 @@
 @synthesize identifier = _identifier;
 @synthesize timestamp = _timestamp;
 @synthesize response = _response;
-@synthesize body = _body;
+@synthesize bodyData = _bodyData;
 
 - (instancetype)initWithIndentifier:(int64_t)identifier timestamp:(uint64_t)timestamp response:(NSURLResponse *)response data:(NSData *)data {
   if(self = [super init]) {
     _identifier = identifier;
     _timestamp = timestamp;
     _response = response;
-    _body = [SKResponseInfo shouldStripReponseBodyWithResponse:response] ? nil : [data base64EncodedStringWithOptions: 0];
+    _bodyData = [SKResponseInfo shouldStripReponseBodyWithResponse:response] ? nil : data;
   }
   return self;
 }
@@ -37,7 +37,15 @@
 }
 
 - (void)setBodyFromData:(NSData *_Nullable)data {
-    self.body = [SKResponseInfo shouldStripReponseBodyWithResponse:self.response] ? nil : [data base64EncodedStringWithOptions: 0];
+    self.bodyData = [SKResponseInfo shouldStripReponseBodyWithResponse:self.response] ? nil : data;
+}
+
+- (NSString *)body {
+  return [self.bodyData base64EncodedStringWithOptions: 0];
+}
+
+- (void)setBody:(NSString *)body {
+  self.bodyData = body ? [[NSData alloc] initWithBase64EncodedString: body options: 0] : nil;
 }
 
 @end
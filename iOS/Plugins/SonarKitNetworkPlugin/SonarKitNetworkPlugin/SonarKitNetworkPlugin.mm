@@ -14,12 +14,65 @@
 #import "SonarKitNetworkPlugin+CPPInitialization.h"
 #import "SKBufferingPlugin+CPPInitialization.h"
 #import "SKDispatchQueue.h"
+#import <SonarKit/SonarConnection.h>
+#import <SonarKit/SonarResponder.h>
+#import <Sonar/SonarClient.h>
+#import <Sonar/SonarNetworkReporter.h>
+
+// Events buffered while no desktop is connected can take up this much.
+static const size_t maxBufferedBytes = 2 * 1024 * 1024;
+
+using facebook::sonar::SonarNetworkReporter;
+using facebook::sonar::SonarUrlFilter;
+
+static std::vector<SonarNetworkReporter::Header> SKHeaders(NSDictionary<NSString *, NSString *> *fields)
+{
+  std::vector<SonarNetworkReporter::Header> headers;
+  headers.reserve(fields.count);
+  for (NSString *key in fields) {
+    id value = fields[key];
+    NSString *string = [value isKindOfClass:[NSString class]] ? value : [value description];
+    headers.push_back({[key UTF8String], [string UTF8String]});
+  }
+  return headers;
+}
+
+static std::vector<std::string> SKStrings(id array)
+{
+  std::vector<std::string> strings;
+  if (![array isKindOfClass:[NSArray class]]) {
+    return strings;
+  }
+  for (id string in array) {
+    if ([string isKindOfClass:[NSString class]]) {
+      strings.push_back([string UTF8String]);
+    }
+  }
+  return strings;
+}
+
+static folly::Optional<std::string> SKOptionalString(NSString *string)
+{
+  return string ? folly::Optional<std::string>([string UTF8String]) : folly::none;
+}
+
+static folly::Optional<folly::ByteRange> SKBody(NSData *data)
+{
+  if (!data) {
+    return folly::none;
+  }
+  return folly::ByteRange(static_cast<const uint8_t *>(data.bytes), data.length);
+}
 
 @interface SonarKitNetworkPlugin ()
 
 @end
 
 @implementation SonarKitNetworkPlugin
+{
+  // Formats, buffers and sends the events, shared with Android.
+  std::shared_ptr<SonarNetworkReporter> _reporter;
+}
 
 - (void)setAdapter:(id<SKNetworkAdapterDelegate>)adapter {
   _adapter = adapter;
@@ -28,6 +81,7 @@
 
 - (instancetype)init {
   if (self = [super initWithQueue:dispatch_queue_create("com.sonarkit.network.buffer", DISPATCH_QUEUE_SERIAL)]) {
+    [self makeReporter];
   }
   return self;
 }
@@ -36,6 +90,7 @@
   if (self = [super initWithQueue:dispatch_queue_create("com.sonarkit.network.buffer", DISPATCH_QUEUE_SERIAL)]) {
     adapter.delegate = self;
     _adapter = adapter;
+    [self makeReporter];
   }
   return self;
 }
@@ -44,62 +99,98 @@
   if (self = [super initWithQueue:queue]) {
     adapter.delegate = self;
     _adapter = adapter;
+    [self makeReporter];
   }
   return self;
 }
 
+- (void)makeReporter {
+  SonarNetworkReporter::Options options;
+  options.maxBufferedBytes = maxBufferedBytes;
+  if (auto client = facebook::sonar::SonarClient::instance()) {
+    options.memoryBudget = client->memoryBudget();
+  }
+  _reporter = std::make_shared<SonarNetworkReporter>(options);
+}
+
+- (void)shedMemory:(size_t)bytes {
+  _reporter->shedBuffered(bytes);
+}
+
+- (void)didConnect:(id<SonarConnection>)connection {
+  [super didConnect:connection];
+  const BOOL sendsSerialized = [connection respondsToSelector:@selector(send:withSerializedParams:)];
+  _reporter->setSender([connection, sendsSerialized](const std::string &method, std::unique_ptr<folly::IOBuf> params) {
+    params->coalesce();
+    folly::IOBuf *const buffer = params.release();
+    NSData *const data = [[NSData alloc] initWithBytesNoCopy:buffer->writableData()
+                                                      length:buffer->length()
+                                                 deallocator:^(void *, NSUInteger) {
+                                                   delete buffer;
+                                                 }];
+    NSString *const name = [NSString stringWithUTF8String:method.c_str()];
+    if (sendsSerialized) {
+      [connection send:name withSerializedParams:data];
+    } else {
+      [connection send:name withParams:[NSJSONSerialization JSONObjectWithData:data options:0 error:nil]];
+    }
+  });
+  const auto reporter = _reporter;
+  [connection receive:@"enableHeaderTable" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
+    [responder success:@{@"generation": @(reporter->enableHeaderTable())}];
+  }];
+  [connection receive:@"setUrlFilter" withBlock:^(NSDictionary *params, id<SonarResponder> responder) {
+    SonarUrlFilter::Patterns patterns;
+    patterns.includeUrls = SKStrings(params[@"includeUrls"]);
+    patterns.excludeUrls = SKStrings(params[@"excludeUrls"]);
+    patterns.includeHosts = SKStrings(params[@"includeHosts"]);
+    patterns.excludeHosts = SKStrings(params[@"excludeHosts"]);
+    reporter->setUrlFilter(std::make_shared<SonarUrlFilter>(patterns));
+    [responder success:@{}];
+  }];
+}
+
+- (void)didDisconnect {
+  [super didDisconnect];
+  _reporter->setSender(nullptr);
+}
+
 #pragma mark - SKNetworkReporterDelegate
 
+- (BOOL)shouldObserveURL:(NSURL *)url
+{
+  NSString *string = [url absoluteString];
+  return !string || _reporter->shouldCapture([string UTF8String]);
+}
 
 - (void)didObserveRequest:(SKRequestInfo *)request;
 {
-  NSMutableArray<NSDictionary<NSString *, id> *> *headers = [NSMutableArray new];
-  for (NSString *key in [request.request.allHTTPHeaderFields allKeys]) {
-    NSDictionary<NSString *, id> *header = @{
-                                             @"key": key,
-                                             @"value": request.request.allHTTPHeaderFields[key]
-                                            };
-    [headers addObject: header];
-  }
-
-  NSString *body = request.body;
-
-  [self send:@"newRequest"
- sonarObject:@{
-               @"id": @(request.identifier),
-               @"timestamp": @(request.timestamp),
-               @"method": request.request.HTTPMethod ?: [NSNull null],
-               @"url": [request.request.URL absoluteString] ?: [NSNull null],
-               @"headers": headers,
-               @"data": body ? body : [NSNull null]
-               }];
+  NSURLRequest *urlRequest = request.request;
+  SonarNetworkReporter::Request report;
+  report.id = request.identifier;
+  report.timestamp = request.timestamp;
+  report.method = SKOptionalString(urlRequest.HTTPMethod);
+  report.url = SKOptionalString([urlRequest.URL absoluteString]);
+  report.headers = SKHeaders(urlRequest.allHTTPHeaderFields);
+  // Only read during the call, so the data doesn't have to be copied.
+  NSData *body = request.bodyData;
+  report.body = SKBody(body);
+  _reporter->reportRequest(report);
 }
 
 - (void)didObserveResponse:(SKResponseInfo *)response
 {
   NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse*)response.response;
 
-  NSMutableArray<NSDictionary<NSString *, id> *> *headers = [NSMutableArray new];
-  for (NSString *key in [httpResponse.allHeaderFields allKeys]) {
-    NSDictionary<NSString *, id> *header = @{
-                                             @"key": key,
-                                             @"value": httpResponse.allHeaderFields[key]
-                                            };
-    [headers addObject: header];
-  }
-
-  NSString *body = response.body;
-
-  [self send:@"newResponse"
- sonarObject:@{
-               @"id": @(response.identifier),
-               @"timestamp": @(response.timestamp),
-               @"status": @(httpResponse.statusCode),
-               @"reason": [NSHTTPURLResponse localizedStringForStatusCode: httpResponse.statusCode] ?: [NSNull null],
-               @"headers": headers,
-               @"data": body ? body : [NSNull null]
-               }];
-
+  SonarNetworkReporter::Response report;
+  report.id = response.identifier;
+  report.timestamp = response.timestamp;
+  report.status = httpResponse.statusCode;
+  report.reason = SKOptionalString([NSHTTPURLResponse localizedStringForStatusCode: httpResponse.statusCode]);
+  report.headers = SKHeaders(httpResponse.allHeaderFields);
+  NSData *body = response.bodyData;
+  report.body = SKBody(body);
+  _reporter->reportResponse(report);
 }
 
 @end
@@ -110,6 +201,7 @@
     if (self = [super initWithDispatchQueue:queue]) {
       adapter.delegate = self;
       _adapter = adapter;
+      [self makeReporter];
     }
     return self;
 }
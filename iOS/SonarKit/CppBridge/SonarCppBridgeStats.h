@@ -0,0 +1,59 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Counts and times the calls across the Objective-C/C++ bridge at one call site,
+ so that bridge overhead on hot paths shows up on the diagnostics screen, as the
+ JNI calls do on Android. Instances are static and register themselves.
+ */
+class SonarCppBridgeStats {
+public:
+  explicit SonarCppBridgeStats(const char *name);
+
+  void record(std::chrono::steady_clock::duration duration)
+  {
+    calls_.fetch_add(1, std::memory_order_relaxed);
+    nanos_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+  }
+
+  // One line per call site, the most expensive first.
+  static std::string dump();
+
+private:
+  const char *name_;
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> nanos_{0};
+};
+
+class SonarCppBridgeTimer {
+public:
+  explicit SonarCppBridgeTimer(SonarCppBridgeStats &stats) : stats_(stats), start_(std::chrono::steady_clock::now()) {}
+
+  ~SonarCppBridgeTimer() { stats_.record(std::chrono::steady_clock::now() - start_); }
+
+private:
+  SonarCppBridgeStats &stats_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace sonar
+} // namespace facebook
+
+// Records the rest of the enclosing scope as a bridge call of the given name.
+#define SONAR_BRIDGE_CALL(name)                                      \
+  static facebook::sonar::SonarCppBridgeStats sonarBridgeStats{name}; \
+  facebook::sonar::SonarCppBridgeTimer sonarBridgeTimer{sonarBridgeStats}
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include "SonarCppBridgeStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+static std::mutex &registryMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+static std::vector<SonarCppBridgeStats *> &registry()
+{
+  static std::vector<SonarCppBridgeStats *> registry;
+  return registry;
+}
+
+SonarCppBridgeStats::SonarCppBridgeStats(const char *name) : name_(name)
+{
+  std::lock_guard<std::mutex> lock(registryMutex());
+  registry().push_back(this);
+}
+
+std::string SonarCppBridgeStats::dump()
+{
+  std::vector<SonarCppBridgeStats *> stats;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    stats = registry();
+  }
+  std::sort(stats.begin(), stats.end(), [](SonarCppBridgeStats *a, SonarCppBridgeStats *b) {
+    return a->nanos_.load() > b->nanos_.load();
+  });
+  std::string result;
+  for (const auto stat : stats) {
+    const auto calls = stat->calls_.load();
+    const auto nanos = stat->nanos_.load();
+    char line[160];
+    snprintf(line, sizeof(line), "%s: %llu calls, %.3f ms, %.1f us each\n",
+             stat->name_,
+             static_cast<unsigned long long>(calls),
+             nanos / 1e6,
+             calls ? nanos / 1e3 / calls : 0.0);
+    result += line;
+  }
+  return result;
+}
+
+} // namespace sonar
+} // namespace facebook
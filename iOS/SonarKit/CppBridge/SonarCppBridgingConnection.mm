@@ -8,8 +8,11 @@
 #import "SonarCppBridgingConnection.h"
 
 #import <FBCxxUtils/FBCxxFollyDynamicConvert.h>
+#include <folly/json.h>
 
+#import "SonarCppBridgeStats.h"
 #import "SonarCppBridgingResponder.h"
+#import "SonarCppBridgingStreamResponder.h"
 
 @implementation SonarCppBridgingConnection
 {
@@ -24,24 +27,146 @@
   return self;
 }
 
+/**
+ Params are serialized here rather than on the sending thread, which is often
+ the main thread. One queue is shared by all connections, keeping every
+ message in the order it was sent.
+ */
+static dispatch_queue_t serializationQueue()
+{
+  static dispatch_queue_t queue;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    queue = dispatch_queue_create(
+        "com.facebook.sonar.serialization",
+        dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+  });
+  return queue;
+}
+
 #pragma mark - SonarConnection
 
 - (void)send:(NSString *)method withParams:(NSDictionary *)params
 {
-  conn_->send([method UTF8String], facebook::cxxutils::convertIdToFollyDynamic(params, true));
+  SONAR_BRIDGE_CALL("SonarConnection.send");
+  const std::string cppMethod = [method UTF8String];
+  // Dropped events are never copied or serialized.
+  if (!conn_->admit(cppMethod)) {
+    return;
+  }
+  // Only a snapshot is taken on the calling thread, which is free for
+  // immutable dictionaries. Like with any Foundation collection handed to
+  // another thread, the objects inside must not be mutated afterwards.
+  NSDictionary *const snapshot = [params copy];
+  const auto conn = conn_;
+  dispatch_async(serializationQueue(), ^{
+    @autoreleasepool {
+      SONAR_BRIDGE_CALL("SonarConnection.send serialize");
+      // Written straight to JSON, big dictionaries such as the layout
+      // plugin's don't have to be converted to folly::dynamic first.
+      conn->sendRawAdmitted(cppMethod, facebook::cxxutils::convertIdToJSON(snapshot, true));
+    }
+  });
+}
+
+- (void)send:(NSString *)method withSerializedParams:(NSData *)params
+{
+  SONAR_BRIDGE_CALL("SonarConnection.sendSerialized");
+  const std::string cppMethod = [method UTF8String];
+  if (!conn_->admit(cppMethod)) {
+    return;
+  }
+  // The IOBuf keeps its own reference to the data instead of copying it,
+  // copy is free for data that isn't mutable.
+  NSData *const data = [params copy];
+  const auto conn = conn_;
+  // Through the same queue as send:withParams:, so that the order holds.
+  dispatch_async(serializationQueue(), ^{
+    conn->sendRawAdmitted(
+        cppMethod,
+        folly::IOBuf::takeOwnership(
+            const_cast<void *>(data.bytes),
+            data.length,
+            [](void *, void *userData) { CFRelease(userData); },
+            (void *)CFBridgingRetain(data)));
+  });
+}
+
+- (void)send:(NSString *)method withParamsBuilder:(SonarParamsBuilder)builder
+{
+  SONAR_BRIDGE_CALL("SonarConnection.sendLazy");
+  const std::string cppMethod = [method UTF8String];
+  if (!conn_->admit(cppMethod)) {
+    return;
+  }
+  SonarParamsBuilder const copiedBuilder = [builder copy];
+  const auto conn = conn_;
+  // Built on the serialization queue, so that lazy events keep their order
+  // with those sent by send:withParams:.
+  dispatch_async(serializationQueue(), ^{
+    @autoreleasepool {
+      SONAR_BRIDGE_CALL("SonarConnection.sendLazy build");
+      conn->sendRawAdmitted(cppMethod, facebook::cxxutils::convertIdToJSON(copiedBuilder(), true));
+    }
+  });
+}
+
+- (void)setSendLimitForMethod:(NSString *)method
+                 maxPerSecond:(double)maxPerSecond
+                   sampleRate:(double)sampleRate
+{
+  facebook::sonar::SonarSendLimit limit;
+  limit.maxPerSecond = maxPerSecond;
+  limit.sampleRate = sampleRate;
+  conn_->setSendLimit([method UTF8String], limit);
+}
+
+- (BOOL)isSubscribedToMethod:(NSString *)method
+{
+  return conn_->isSubscribed([method UTF8String]);
+}
+
+- (void)cacheResponsesForMethod:(NSString *)method
+{
+  conn_->cacheResponses([method UTF8String]);
+}
+
+- (void)invalidateCachedResponsesForMethod:(NSString *)method
+{
+  conn_->invalidateCachedResponses([method UTF8String]);
 }
 
 - (void)receive:(NSString *)method withBlock:(SonarReceiver)receiver
 {
-    const auto lambda = [receiver](const folly::dynamic &message,
+    // Params are only converted to Foundation objects as the receiver reads
+    // them, big setData or search params cost what is actually used.
+    const auto lambda = [receiver](folly::StringPiece message,
                                    std::unique_ptr<facebook::sonar::SonarResponder> responder) {
       @autoreleasepool {
+        SONAR_BRIDGE_CALL("SonarReceiver.receive");
         SonarCppBridgingResponder *const objCResponder =
         [[SonarCppBridgingResponder alloc] initWithCppResponder:std::move(responder)];
-        receiver(facebook::cxxutils::convertFollyDynamicToId(message), objCResponder);
+        id params = facebook::cxxutils::convertFollyDynamicToLazyId(
+            std::make_shared<const folly::dynamic>(folly::parseJson(message)));
+        receiver(params == [NSNull null] ? nil : params, objCResponder);
       }
     };
-    conn_->receive([method UTF8String], lambda);
+    conn_->receiveRaw([method UTF8String], lambda);
+}
+
+- (void)receiveStream:(NSString *)method withBlock:(SonarStreamReceiver)receiver
+{
+  const auto lambda = [receiver](const folly::dynamic &message,
+                                 std::shared_ptr<facebook::sonar::SonarStreamResponder> responder) {
+    @autoreleasepool {
+      SONAR_BRIDGE_CALL("SonarStreamReceiver.receive");
+      SonarCppBridgingStreamResponder *const objCResponder =
+      [[SonarCppBridgingStreamResponder alloc] initWithCppResponder:std::move(responder)];
+      id params = facebook::cxxutils::convertFollyDynamicToId(message);
+      receiver(params == [NSNull null] ? nil : params, objCResponder);
+    }
+  };
+  conn_->receiveStream([method UTF8String], lambda);
 }
 
 @end
@@ -9,6 +9,8 @@
 
 #import <FBCxxUtils/FBCxxFollyDynamicConvert.h>
 
+#import "SonarCppBridgeStats.h"
+
 @implementation SonarCppBridgingResponder {
   std::unique_ptr<facebook::sonar::SonarResponder> responder_;
 }
@@ -28,8 +30,16 @@
 
 #pragma mark - SonarResponder
 
-- (void)success:(NSDictionary *)response { responder_->success(facebook::cxxutils::convertIdToFollyDynamic(response)); }
+- (void)success:(NSDictionary *)response
+{
+  SONAR_BRIDGE_CALL("SonarResponder.success");
+  responder_->success(facebook::cxxutils::convertIdToFollyDynamic(response));
+}
 
-- (void)error:(NSDictionary *)response { responder_->error(facebook::cxxutils::convertIdToFollyDynamic(response)); }
+- (void)error:(NSDictionary *)response
+{
+  SONAR_BRIDGE_CALL("SonarResponder.error");
+  responder_->error(facebook::cxxutils::convertIdToFollyDynamic(response));
+}
 
 @end
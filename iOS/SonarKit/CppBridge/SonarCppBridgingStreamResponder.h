@@ -0,0 +1,17 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#import <Sonar/SonarStreamResponder.h>
+#import <SonarKit/SonarStreamResponder.h>
+
+/**
+SonarCppBridgingStreamResponder forwards chunks to the underlying C++ stream responder, like
+SonarCppBridgingResponder does for single responses.
+*/
+@interface SonarCppBridgingStreamResponder : NSObject <SonarStreamResponder>
+- (instancetype)initWithCppResponder:(std::shared_ptr<facebook::sonar::SonarStreamResponder>)responder;
+@end
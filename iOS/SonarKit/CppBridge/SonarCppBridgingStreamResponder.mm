@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#import "SonarCppBridgingStreamResponder.h"
+
+#import <FBCxxUtils/FBCxxFollyDynamicConvert.h>
+
+#import "SonarCppBridgeStats.h"
+
+@implementation SonarCppBridgingStreamResponder {
+  std::shared_ptr<facebook::sonar::SonarStreamResponder> responder_;
+}
+
+- (instancetype)initWithCppResponder:(std::shared_ptr<facebook::sonar::SonarStreamResponder>)responder
+{
+  if (!responder) {
+    return nil;
+  }
+
+  if (self = [super init]) {
+    responder_ = std::move(responder);
+  }
+
+  return self;
+}
+
+#pragma mark - SonarStreamResponder
+
+- (void)next:(NSDictionary *)chunk
+{
+  SONAR_BRIDGE_CALL("SonarStreamResponder.next");
+  responder_->next(facebook::cxxutils::convertIdToFollyDynamic(chunk));
+}
+
+- (void)complete { responder_->complete(); }
+
+- (void)error:(NSDictionary *)response { responder_->error(facebook::cxxutils::convertIdToFollyDynamic(response)); }
+
+@end
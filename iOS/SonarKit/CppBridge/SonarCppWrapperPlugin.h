@@ -10,6 +10,7 @@
 #endif
 
 #import <Sonar/SonarPlugin.h>
+#import <SonarKit/CppBridge/SonarCppBridgeStats.h>
 #import <SonarKit/CppBridge/SonarCppBridgingConnection.h>
 #import <SonarKit/SonarPlugin.h>
 
@@ -25,23 +26,51 @@ Objective-C plugins if they want.
 */
 class SonarCppWrapperPlugin final : public facebook::sonar::SonarPlugin {
 public:
-  // Under ARC copying objCPlugin *does* increment its retain count
-  SonarCppWrapperPlugin(ObjCPlugin objCPlugin) : _objCPlugin(objCPlugin) {}
+  // Under ARC copying objCPlugin *does* increment its retain count. The
+  // identifier is read once, the client asks for it over and over.
+  SonarCppWrapperPlugin(ObjCPlugin objCPlugin) : _objCPlugin(objCPlugin), _identifier(identifierOf(objCPlugin)) {}
 
-  std::string identifier() const override { return [[_objCPlugin identifier] UTF8String]; }
+  std::string identifier() const override { return _identifier; }
 
   void didConnect(std::shared_ptr<facebook::sonar::SonarConnection> conn) override
   {
+    SONAR_BRIDGE_CALL("SonarPlugin.didConnect");
+    // The client makes a new connection each time, so there is no bridging
+    // connection to reuse.
     SonarCppBridgingConnection *const bridgingConn = [[SonarCppBridgingConnection alloc] initWithCppConnection:conn];
     [_objCPlugin didConnect:bridgingConn];
   }
 
-  void didDisconnect() override { [_objCPlugin didDisconnect]; }
+  void didDisconnect() override
+  {
+    SONAR_BRIDGE_CALL("SonarPlugin.didDisconnect");
+    [_objCPlugin didDisconnect];
+  }
+
+  bool runInBackground() override
+  {
+    return [_objCPlugin respondsToSelector:@selector(runInBackground)] && [_objCPlugin runInBackground];
+  }
+
+  void shedMemory(size_t bytes) override
+  {
+    if ([_objCPlugin respondsToSelector:@selector(shedMemory:)]) {
+      SONAR_BRIDGE_CALL("SonarPlugin.shedMemory");
+      [_objCPlugin shedMemory:bytes];
+    }
+  }
 
   ObjCPlugin getObjCPlugin() { return _objCPlugin; }
 
 private:
+  static std::string identifierOf(ObjCPlugin objCPlugin)
+  {
+    NSString *const identifier = [objCPlugin identifier];
+    return identifier ? std::string([identifier UTF8String]) : std::string();
+  }
+
   ObjCPlugin _objCPlugin;
+  const std::string _identifier;
 };
 
 } // namespace sonar
@@ -4,11 +4,35 @@
 #import <Foundation/Foundation.h>
 
 #include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+
+#include <memory>
 
 namespace facebook {
 namespace cxxutils {
 
+/**
+ NSData is converted to a base64 encoded string, here and in convertIdToJSON.
+ */
 folly::dynamic convertIdToFollyDynamic(id json, bool nullifyNanAndInf = false);
 id convertFollyDynamicToId(const folly::dynamic &dyn);
 
+/**
+ Like convertFollyDynamicToId, but objects and arrays are returned as
+ NSDictionary and NSArray subclasses backed by dyn, which only convert the
+ values that are actually read. Converted values are kept, so reading one
+ again returns the same object. They keep dyn alive. Converting them back,
+ with convertIdToFollyDynamic or convertIdToJSON, reads dyn directly.
+ */
+id convertFollyDynamicToLazyId(std::shared_ptr<const folly::dynamic> dyn);
+
+/**
+ Serializes json straight to JSON bytes, equivalent to
+ folly::toJson(convertIdToFollyDynamic(json, nullifyNanAndInf)) but without
+ building the intermediate folly::dynamic or copying strings out of their
+ NSStrings. Meant for the pre-serialized send
+ APIs, such as SonarConnection::sendRaw.
+ */
+std::unique_ptr<folly::IOBuf> convertIdToJSON(id json, bool nullifyNanAndInf = false);
+
 } }
@@ -4,6 +4,141 @@
 
 #import <objc/runtime.h>
 
+#include <folly/Conv.h>
+#include <folly/json.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <vector>
+
+namespace facebook {
+namespace cxxutils {
+static id convertLazily(const std::shared_ptr<const folly::dynamic> &root, const folly::dynamic &dyn);
+} }
+
+/**
+ Views of an object or array somewhere in root. Only value is read, root
+ keeps it alive.
+ */
+@interface FBCxxLazyDynamicDictionary : NSDictionary
+- (instancetype)initWithRoot:(std::shared_ptr<const folly::dynamic>)root value:(const folly::dynamic *)value;
+- (const folly::dynamic &)dynamicValue;
+@end
+
+@interface FBCxxLazyDynamicArray : NSArray
+- (instancetype)initWithRoot:(std::shared_ptr<const folly::dynamic>)root value:(const folly::dynamic *)value;
+- (const folly::dynamic &)dynamicValue;
+@end
+
+@implementation FBCxxLazyDynamicDictionary
+{
+  std::shared_ptr<const folly::dynamic> _root;
+  const folly::dynamic *_value;
+  // Guarded by @synchronized(self), lookups may come from several threads.
+  NSMutableDictionary *_converted;
+}
+
+- (instancetype)initWithRoot:(std::shared_ptr<const folly::dynamic>)root value:(const folly::dynamic *)value
+{
+  if (self = [super init]) {
+    _root = std::move(root);
+    _value = value;
+    _converted = [NSMutableDictionary new];
+  }
+  return self;
+}
+
+- (const folly::dynamic &)dynamicValue
+{
+  return *_value;
+}
+
+- (NSUInteger)count
+{
+  return _value->size();
+}
+
+- (id)objectForKey:(id)key
+{
+  if (![key isKindOfClass:[NSString class]]) {
+    return nil;
+  }
+  @synchronized(self) {
+    id converted = _converted[key];
+    if (converted) {
+      return converted;
+    }
+    const auto found = _value->get_ptr(std::string([key UTF8String]));
+    if (!found) {
+      return nil;
+    }
+    converted = facebook::cxxutils::convertLazily(_root, *found);
+    if (converted) {
+      _converted[key] = converted;
+    }
+    return converted;
+  }
+}
+
+- (NSEnumerator *)keyEnumerator
+{
+  NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:_value->size()];
+  for (const auto &key : _value->keys()) {
+    [keys addObject:facebook::cxxutils::convertFollyDynamicToId(key)];
+  }
+  return [keys objectEnumerator];
+}
+
+@end
+
+@implementation FBCxxLazyDynamicArray
+{
+  std::shared_ptr<const folly::dynamic> _root;
+  const folly::dynamic *_value;
+  // Guarded by @synchronized(self).
+  std::vector<id> _converted;
+}
+
+- (instancetype)initWithRoot:(std::shared_ptr<const folly::dynamic>)root value:(const folly::dynamic *)value
+{
+  if (self = [super init]) {
+    _root = std::move(root);
+    _value = value;
+  }
+  return self;
+}
+
+- (const folly::dynamic &)dynamicValue
+{
+  return *_value;
+}
+
+- (NSUInteger)count
+{
+  return _value->size();
+}
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+  if (index >= _value->size()) {
+    [NSException raise:NSRangeException format:@"Index %lu beyond bounds [0 .. %lu]", (unsigned long)index, (unsigned long)_value->size()];
+  }
+  @synchronized(self) {
+    if (_converted.empty()) {
+      _converted.resize(_value->size());
+    }
+    if (!_converted[index]) {
+      // Arrays can't hold nil, same as convertFollyDynamicToId.
+      id converted = facebook::cxxutils::convertLazily(_root, (*_value)[index]);
+      _converted[index] = converted ?: (id)kCFNull;
+    }
+    return _converted[index];
+  }
+}
+
+@end
+
 namespace facebook {
 namespace cxxutils {
 
@@ -51,6 +186,26 @@ id convertFollyDynamicToId(const folly::dynamic &dyn)
   }
 }
 
+static void appendBase64(std::string &out, NSData *data)
+{
+  static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const uint8_t *bytes = static_cast<const uint8_t *>(data.bytes);
+  const size_t length = data.length;
+  out.reserve(out.size() + (length + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 3 <= length; i += 3) {
+    const uint32_t n = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+    const char encoded[] = {kAlphabet[n >> 18], kAlphabet[(n >> 12) & 0x3f], kAlphabet[(n >> 6) & 0x3f], kAlphabet[n & 0x3f]};
+    out.append(encoded, sizeof(encoded));
+  }
+  if (i < length) {
+    const bool twoBytes = i + 1 < length;
+    const uint32_t n = (bytes[i] << 16) | (twoBytes ? bytes[i + 1] << 8 : 0);
+    const char encoded[] = {kAlphabet[n >> 18], kAlphabet[(n >> 12) & 0x3f], twoBytes ? kAlphabet[(n >> 6) & 0x3f] : '=', '='};
+    out.append(encoded, sizeof(encoded));
+  }
+}
+
 folly::dynamic convertIdToFollyDynamic(id json, bool nullifyNanAndInf)
 {
   if (json == nil || json == (id)kCFNull) {
@@ -106,6 +261,14 @@ folly::dynamic convertIdToFollyDynamic(id json, bool nullifyNanAndInf)
   } else if ([json isKindOfClass:[NSString class]]) {
     NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
     return std::string(reinterpret_cast<const char *>(data.bytes), data.length);
+  } else if ([json isKindOfClass:[NSData class]]) {
+    std::string encoded;
+    appendBase64(encoded, json);
+    return encoded;
+  } else if ([json isKindOfClass:[FBCxxLazyDynamicDictionary class]]) {
+    return [(FBCxxLazyDynamicDictionary *)json dynamicValue];
+  } else if ([json isKindOfClass:[FBCxxLazyDynamicArray class]]) {
+    return [(FBCxxLazyDynamicArray *)json dynamicValue];
   } else if ([json isKindOfClass:[NSArray class]]) {
     folly::dynamic array = folly::dynamic::array;
     for (id element in json) {
@@ -124,5 +287,198 @@ folly::dynamic convertIdToFollyDynamic(id json, bool nullifyNanAndInf)
 
   return nil;
 }
+
+namespace {
+
+void appendJSON(std::string &out, id json, bool nullifyNanAndInf);
+
+void appendEscaped(std::string &out, const char *bytes, size_t length)
+{
+  static const char kHex[] = "0123456789abcdef";
+  out.push_back('"');
+  size_t start = 0;
+  for (size_t i = 0; i < length; i++) {
+    const unsigned char c = bytes[i];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out.append(bytes + start, i - start);
+    start = i + 1;
+    switch (c) {
+      case '"': out.append("\\\""); break;
+      case '\\': out.append("\\\\"); break;
+      case '\b': out.append("\\b"); break;
+      case '\f': out.append("\\f"); break;
+      case '\n': out.append("\\n"); break;
+      case '\r': out.append("\\r"); break;
+      case '\t': out.append("\\t"); break;
+      default: {
+        const char escaped[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+        out.append(escaped, sizeof(escaped));
+      }
+    }
+  }
+  out.append(bytes + start, length - start);
+  out.push_back('"');
+}
+
+void appendString(std::string &out, NSString *string)
+{
+  CFStringRef cfString = (__bridge CFStringRef)string;
+  // Most strings keep their contents as ASCII or UTF-8, which can be read in
+  // place.
+  const CFIndex length = CFStringGetLength(cfString);
+  const char *bytes = CFStringGetCStringPtr(cfString, kCFStringEncodingUTF8);
+  if (bytes) {
+    const size_t size = strlen(bytes);
+    // Shorter than the string only if it has a NUL in it.
+    if (size >= (size_t)length) {
+      appendEscaped(out, bytes, size);
+      return;
+    }
+  }
+  const CFIndex maxSize = CFStringGetMaximumSizeForEncoding(length, kCFStringEncodingUTF8);
+  char stackBuffer[256];
+  std::string heapBuffer;
+  char *buffer = stackBuffer;
+  if (maxSize > (CFIndex)sizeof(stackBuffer)) {
+    heapBuffer.resize(maxSize);
+    buffer = &heapBuffer[0];
+  }
+  CFIndex used = 0;
+  CFStringGetBytes(cfString, CFRangeMake(0, length), kCFStringEncodingUTF8, 0, false, (UInt8 *)buffer, maxSize, &used);
+  appendEscaped(out, buffer, used);
+}
+
+void appendDouble(std::string &out, double value, bool nullifyNanAndInf)
+{
+  if (isnan(value) || isinf(value)) {
+    if (!nullifyNanAndInf) {
+      // Matches folly::toJson, which refuses to write them as well.
+      throw std::invalid_argument("Cannot serialize NaN or infinity as JSON");
+    }
+    out.append("null");
+    return;
+  }
+  folly::toAppend(value, &out, double_conversion::DoubleToStringConverter::SHORTEST, 0);
+}
+
+void appendNumber(std::string &out, NSNumber *number, bool nullifyNanAndInf)
+{
+  const char *objCType = [number objCType];
+  switch (objCType[0]) {
+    case _C_BOOL:
+      out.append([number boolValue] ? "true" : "false");
+      return;
+    case _C_CHR:
+      // See convertIdToFollyDynamic for how BOOLs are told from chars.
+      if ([number isKindOfClass:[@YES class]]) {
+        out.append([number boolValue] ? "true" : "false");
+        return;
+      }
+      folly::toAppend([number longLongValue], &out);
+      return;
+    case _C_UCHR:
+    case _C_SHT:
+    case _C_USHT:
+    case _C_INT:
+    case _C_UINT:
+    case _C_LNG:
+    case _C_ULNG:
+    case _C_LNG_LNG:
+    case _C_ULNG_LNG:
+      folly::toAppend([number longLongValue], &out);
+      return;
+    case _C_FLT:
+    case _C_DBL:
+      appendDouble(out, [number doubleValue], nullifyNanAndInf);
+      return;
+  }
+  out.append("null");
+}
+
+void appendJSON(std::string &out, id json, bool nullifyNanAndInf)
+{
+  if (json == nil || json == (id)kCFNull) {
+    out.append("null");
+  } else if ([json isKindOfClass:[NSString class]]) {
+    appendString(out, json);
+  } else if ([json isKindOfClass:[NSNumber class]]) {
+    appendNumber(out, json, nullifyNanAndInf);
+  } else if ([json isKindOfClass:[NSData class]]) {
+    // Base64 never needs escaping.
+    out.push_back('"');
+    appendBase64(out, json);
+    out.push_back('"');
+  } else if ([json isKindOfClass:[FBCxxLazyDynamicDictionary class]]) {
+    out.append(folly::toJson([(FBCxxLazyDynamicDictionary *)json dynamicValue]));
+  } else if ([json isKindOfClass:[FBCxxLazyDynamicArray class]]) {
+    out.append(folly::toJson([(FBCxxLazyDynamicArray *)json dynamicValue]));
+  } else if ([json isKindOfClass:[NSArray class]]) {
+    out.push_back('[');
+    bool first = true;
+    for (id element in json) {
+      if (!first) {
+        out.push_back(',');
+      }
+      first = false;
+      appendJSON(out, element, nullifyNanAndInf);
+    }
+    out.push_back(']');
+  } else if ([json isKindOfClass:[NSDictionary class]]) {
+    out.push_back('{');
+    std::string *const output = &out;
+    __block bool first = true;
+    [json enumerateKeysAndObjectsUsingBlock:^(id key, id value, __unused BOOL *stop) {
+      if (!first) {
+        output->push_back(',');
+      }
+      first = false;
+      appendString(*output, [key isKindOfClass:[NSString class]] ? key : [key description]);
+      output->push_back(':');
+      appendJSON(*output, value, nullifyNanAndInf);
+    }];
+    out.push_back('}');
+  } else {
+    out.append("null");
+  }
+}
+
+}
+
+static id convertLazily(const std::shared_ptr<const folly::dynamic> &root, const folly::dynamic &dyn)
+{
+  switch (dyn.type()) {
+    case folly::dynamic::ARRAY:
+      return [[FBCxxLazyDynamicArray alloc] initWithRoot:root value:&dyn];
+    case folly::dynamic::OBJECT:
+      return [[FBCxxLazyDynamicDictionary alloc] initWithRoot:root value:&dyn];
+    default:
+      return convertFollyDynamicToId(dyn);
+  }
+}
+
+id convertFollyDynamicToLazyId(std::shared_ptr<const folly::dynamic> dyn)
+{
+  const auto &value = *dyn;
+  return convertLazily(dyn, value);
+}
+
+std::unique_ptr<folly::IOBuf> convertIdToJSON(id json, bool nullifyNanAndInf)
+{
+  auto *out = new std::string();
+  try {
+    appendJSON(*out, json, nullifyNanAndInf);
+  } catch (...) {
+    delete out;
+    throw;
+  }
+  // Hand the string's buffer over instead of copying it.
+  return folly::IOBuf::takeOwnership(
+      &(*out)[0],
+      out->size(),
+      [](void *, void *userData) { delete static_cast<std::string *>(userData); },
+      out);
+}
 }
 }
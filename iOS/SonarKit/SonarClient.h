@@ -20,11 +20,25 @@ The shared singleton SonarClient instance. It is an error to call this on non-de
 */
 + (instancetype)sharedClient;
 
+/**
+Set the QoS classes of the client's threads: callbackQoS for the one plugins handle the desktop's calls on,
+connectionQoS for the one talking to the desktop. They default to QOS_CLASS_USER_INITIATED and QOS_CLASS_UTILITY.
+Only takes effect before sharedClient is first called. The classes applied are under "threads" in the
+diagnostics plugin's metrics.
+*/
++ (void)setCallbackQoS:(qos_class_t)callbackQoS connectionQoS:(qos_class_t)connectionQoS;
+
 /**
 Register a plugin with the client.
 */
 - (void)addPlugin:(NSObject<SonarPlugin> *)plugin;
 
+/**
+Register a plugin that is only created by factory once the desktop opens it, or once it is retrieved with
+pluginWithIdentifier:, leaving its setup out of app startup. The plugin's identifier must be identifier.
+*/
+- (void)addPluginWithIdentifier:(NSString *)identifier factory:(NSObject<SonarPlugin> * (^)(void))factory;
+
 /**
 Unregister a plugin with the client.
 */
@@ -35,6 +49,12 @@ Retrieve the plugin with a given identifier which was previously registered with
 */
 - (NSObject<SonarPlugin> *)pluginWithIdentifier:(NSString *)identifier;
 
+/**
+The calls across the Objective-C/C++ bridge so far, one line per call site with their count and time, the most
+expensive first. For diagnostics, like getNativeCallStats on Android.
+*/
+- (NSString *)nativeCallStats;
+
 /**
 Establish a connection to the Sonar desktop.
 */
@@ -8,27 +8,54 @@
 #if FB_SONARKIT_ENABLED
 
 #import "SonarClient.h"
+#import "SonarCppBridgeStats.h"
 #import "SonarCppWrapperPlugin.h"
 #import <Sonar/SonarClient.h>
 #include <folly/io/async/EventBase.h>
-#include <folly/io/async/ScopedEventBaseThread.h>
 #import <UIKit/UIKit.h>
+#import <Network/Network.h>
 
 #if !TARGET_OS_SIMULATOR
 //#import "SKPortForwardingServer.h"
 #endif
 
 using WrapperPlugin = facebook::sonar::SonarCppWrapperPlugin;
+using facebook::sonar::SonarThreadQoS;
+
+// Responses to the desktop are waited on by someone, moving bytes isn't.
+static qos_class_t callbackQoSClass = QOS_CLASS_USER_INITIATED;
+static qos_class_t connectionQoSClass = QOS_CLASS_UTILITY;
+
+static SonarThreadQoS threadQoS(qos_class_t qos)
+{
+  switch (qos) {
+    case QOS_CLASS_BACKGROUND:
+      return SonarThreadQoS::background;
+    case QOS_CLASS_UTILITY:
+      return SonarThreadQoS::utility;
+    case QOS_CLASS_USER_INITIATED:
+      return SonarThreadQoS::userInitiated;
+    case QOS_CLASS_USER_INTERACTIVE:
+      return SonarThreadQoS::userInteractive;
+    default:
+      return SonarThreadQoS::unspecified;
+  }
+}
 
 @implementation SonarClient {
   facebook::sonar::SonarClient *_cppClient;
-  folly::ScopedEventBaseThread sonarThread;
-  folly::ScopedEventBaseThread connectionThread;
+  nw_path_monitor_t _pathMonitor API_AVAILABLE(ios(12.0));
 #if !TARGET_OS_SIMULATOR
  // SKPortForwardingServer *_server;
 #endif
 }
 
++ (void)setCallbackQoS:(qos_class_t)callbackQoS connectionQoS:(qos_class_t)connectionQoS
+{
+  callbackQoSClass = callbackQoS;
+  connectionQoSClass = connectionQoS;
+}
+
 + (instancetype)sharedClient
 {
   static SonarClient *sharedClient = nil;
@@ -60,7 +87,7 @@ using WrapperPlugin = facebook::sonar::SonarCppWrapperPlugin;
     deviceName = [NSString stringWithFormat:@"%@ %@", [[UIDevice currentDevice] model], @"Simulator"];
 #endif
 
-    facebook::sonar::SonarClient::init({
+    facebook::sonar::SonarInitConfig config{
       {
         "localhost",
         "iOS",
@@ -70,14 +97,76 @@ using WrapperPlugin = facebook::sonar::SonarCppWrapperPlugin;
         [appId UTF8String],
         [privateAppDirectory UTF8String],
       },
-      sonarThread.getEventBase(),
-      connectionThread.getEventBase()
-    });
+      nullptr,
+      nullptr
+    };
+    // The client's own threads, so that they are set up with the QoS classes
+    // asked for rather than competing with the app's UI work.
+    config.nativeWorkers = true;
+    config.callbackThread.qos = threadQoS(callbackQoSClass);
+    config.connectionThread.qos = threadQoS(connectionQoSClass);
+    if (@available(iOS 12.0, *)) {
+      // The path monitor retries as soon as a desktop may be back.
+      config.idleReconnectInterval = std::chrono::minutes(15);
+    }
+    facebook::sonar::SonarClient::init(std::move(config));
     _cppClient = facebook::sonar::SonarClient::instance();
+    [self monitorPath];
+    [self observeAppLifecycle];
   }
   return self;
 }
 
+// Tells the client when the network path changes, which is when a desktop that
+// couldn't be reached may have become reachable, so that it can retry right
+// away instead of polling. On the simulator this follows the Mac's network.
+- (void)monitorPath
+{
+  if (@available(iOS 12.0, *)) {
+    _pathMonitor = nw_path_monitor_create();
+    nw_path_monitor_set_queue(_pathMonitor, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    facebook::sonar::SonarClient *const cppClient = _cppClient;
+    __block BOOL initialPath = YES;
+    nw_path_monitor_set_update_handler(_pathMonitor, ^(nw_path_t path) {
+      // The first update is the path at start, not a change.
+      if (initialPath) {
+        initialPath = NO;
+        return;
+      }
+      cppClient->connectivityChanged();
+    });
+    nw_path_monitor_start(_pathMonitor);
+  }
+}
+
+// Events are held back while the app is in the background, see
+// SonarInitConfig::pauseEventsInBackground, and memory is released on memory
+// warnings, see SonarMemoryPressure.
+- (void)observeAppLifecycle
+{
+  NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+  facebook::sonar::SonarClient *const cppClient = _cppClient;
+  [center addObserverForName:UIApplicationDidEnterBackgroundNotification
+                      object:nil
+                       queue:nil
+                  usingBlock:^(NSNotification *note) {
+                    cppClient->onAppBackground();
+                  }];
+  [center addObserverForName:UIApplicationWillEnterForegroundNotification
+                      object:nil
+                       queue:nil
+                  usingBlock:^(NSNotification *note) {
+                    cppClient->onAppForeground();
+                  }];
+  // iOS has a single level, and apps that don't free enough are killed.
+  [center addObserverForName:UIApplicationDidReceiveMemoryWarningNotification
+                      object:nil
+                       queue:nil
+                  usingBlock:^(NSNotification *note) {
+                    cppClient->onMemoryPressure(facebook::sonar::SonarMemoryPressure::critical);
+                  }];
+}
+
 - (void)refreshPlugins
 {
   _cppClient->refreshPlugins();
@@ -88,6 +177,18 @@ using WrapperPlugin = facebook::sonar::SonarCppWrapperPlugin;
   _cppClient->addPlugin(std::make_shared<WrapperPlugin>(plugin));
 }
 
+- (void)addPluginWithIdentifier:(NSString *)identifier factory:(NSObject<SonarPlugin> * (^)(void))factory
+{
+  NSObject<SonarPlugin> * (^const copiedFactory)(void) = [factory copy];
+  _cppClient->addPluginFactory([identifier UTF8String], [copiedFactory]() -> std::shared_ptr<facebook::sonar::SonarPlugin> {
+    NSObject<SonarPlugin> *const plugin = copiedFactory();
+    if (!plugin) {
+      return nullptr;
+    }
+    return std::make_shared<WrapperPlugin>(plugin);
+  });
+}
+
 - (void)removePlugin:(NSObject<SonarPlugin> *)plugin
 {
   _cppClient->removePlugin(std::make_shared<WrapperPlugin>(plugin));
@@ -102,6 +203,11 @@ using WrapperPlugin = facebook::sonar::SonarCppWrapperPlugin;
   return nil;
 }
 
+- (NSString *)nativeCallStats
+{
+  return [NSString stringWithUTF8String:facebook::sonar::SonarCppBridgeStats::dump().c_str()];
+}
+
 - (void)start;
 {
 #if !TARGET_OS_SIMULATOR
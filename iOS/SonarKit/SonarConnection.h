@@ -8,9 +8,12 @@
 #import <Foundation/Foundation.h>
 
 @protocol SonarResponder;
+@protocol SonarStreamResponder;
 @protocol SonarWebSocket;
 
 typedef void (^SonarReceiver)(NSDictionary*, id<SonarResponder>);
+typedef void (^SonarStreamReceiver)(NSDictionary*, id<SonarStreamResponder>);
+typedef NSDictionary* (^SonarParamsBuilder)(void);
 
 /**
 Represents a connection between the Desktop and mobile plugins with corresponding identifiers.
@@ -28,4 +31,49 @@ plugin with a matching identifier.
 */
 - (void)receive:(NSString *)method withBlock:(SonarReceiver)receiver;
 
+@optional
+
+/**
+Same as send:withParams:, but params are already serialized as JSON and are sent as they are.
+*/
+- (void)send:(NSString *)method withSerializedParams:(NSData *)params;
+
+/**
+Limit how often events of the given method are sent. Events beyond maxPerSecond, or outside the
+sampled fraction sampleRate, are dropped before they are serialized. 0 and 1 don't limit. The
+desktop can override the limit while it is connected.
+*/
+- (void)setSendLimitForMethod:(NSString *)method
+                 maxPerSecond:(double)maxPerSecond
+                   sampleRate:(double)sampleRate;
+
+/**
+Whether the desktop wants events of the given method. Desktops that don't declare which methods
+they want get all of them. Events the desktop doesn't want are dropped anyway, plugins can ask
+first to skip building their params.
+*/
+- (BOOL)isSubscribedToMethod:(NSString *)method;
+
+/**
+Same as send:withParams:, but params are only built if the event would be sent to a connected
+desktop. The builder is called later on a background queue, not on the calling thread, so it must
+only read state that is safe to read from there.
+*/
+- (void)send:(NSString *)method withParamsBuilder:(SonarParamsBuilder)builder;
+
+/**
+Cache the responses to calls of the given method by their params, so that repeated calls are
+answered without calling the receiver. Only for methods whose responses don't change until
+invalidateCachedResponsesForMethod: is called.
+*/
+- (void)cacheResponsesForMethod:(NSString *)method;
+
+- (void)invalidateCachedResponsesForMethod:(NSString *)method;
+
+/**
+Same as receive:withBlock:, for calls the desktop wants answered with a stream of chunks rather
+than a single response.
+*/
+- (void)receiveStream:(NSString *)method withBlock:(SonarStreamReceiver)receiver;
+
 @end
@@ -36,4 +36,18 @@ longer valid to use.
 */
 - (void)didDisconnect;
 
+@optional
+
+/**
+Whether the plugin should be connected while no desktop has initialized it, when the client captures
+events offline. What it sends is captured and replayed once the desktop initializes it.
+*/
+- (BOOL)runInBackground;
+
+/**
+Called when the client buffers more than its memory budget allows and this plugin is among the biggest
+users, to drop about bytes of the data it holds on to, oldest first.
+*/
+- (void)shedMemory:(size_t)bytes;
+
 @end
@@ -0,0 +1,31 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#import <Foundation/Foundation.h>
+
+/**
+Responds to a call from a Sonar desktop plugin with a sequence of chunks rather than a single
+return value, so that results can be sent while they are still being produced.
+*/
+@protocol SonarStreamResponder
+
+/**
+Send the next chunk. Chunks are held until the desktop is ready to receive them.
+*/
+- (void)next:(NSDictionary *)chunk;
+
+/**
+Tell the desktop that the response is complete.
+*/
+- (void)complete;
+
+/**
+End the response with an error, no more chunks are sent after it.
+*/
+- (void)error:(NSDictionary *)response;
+
+@end
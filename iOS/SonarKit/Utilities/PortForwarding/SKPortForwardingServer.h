@@ -15,4 +15,11 @@
 - (void)forwardConnectionsFromPort:(NSUInteger)port;
 - (void)close;
 
+// Throughput since the server was created. Only updated on the server's
+// queue, so reads from elsewhere are approximate.
+@property (nonatomic, readonly) uint64_t framesSentToDesktop;
+@property (nonatomic, readonly) uint64_t bytesSentToDesktop;
+@property (nonatomic, readonly) uint64_t framesReceivedFromDesktop;
+@property (nonatomic, readonly) uint64_t bytesReceivedFromDesktop;
+
 @end
@@ -15,17 +15,62 @@
 #import "SKMacros.h"
 #import "SKPortForwardingCommon.h"
 
+// Reads from a socket are forwarded in frames of at most this size, so that
+// one busy pipe can't hold up the others for long.
+static const NSUInteger kMaxFrameLength = 256 * 1024;
+// Frames handed to the channel but not yet written out. Keeping several in
+// flight hides the round trip through the USB stack.
+static const NSUInteger kMaxFramesInFlight = 8;
+// Frames a pipe may have queued or in flight before reading from its socket
+// pauses, bounding what a fast local writer can buffer here.
+static const NSUInteger kMaxFramesPerPipe = 4;
+
+/**
+ A frame waiting to be sent to the desktop.
+ */
+@interface SKForwardedFrame : NSObject
+@property (nonatomic, assign) uint32_t type;
+@property (nonatomic, strong) dispatch_data_t payload;
+@end
+
+@implementation SKForwardedFrame
+@end
+
+/**
+ One forwarded connection, multiplexed over the channel with the others.
+ */
+@interface SKForwardedPipe : NSObject
+@property (nonatomic, assign) UInt32 tag;
+@property (nonatomic, strong) GCDAsyncSocket *socket;
+@property (nonatomic, strong) NSMutableArray<SKForwardedFrame *> *frames;
+// Frames queued plus frames in flight.
+@property (nonatomic, assign) NSUInteger outstandingFrames;
+@property (nonatomic, assign) BOOL reading;
+@property (nonatomic, assign) BOOL closed;
+@end
+
+@implementation SKForwardedPipe
+@end
+
 @interface SKPortForwardingServer () <PTChannelDelegate, GCDAsyncSocketDelegate>
 
 @property (nonatomic, weak) PTChannel *serverChannel;
 @property (nonatomic, weak) PTChannel *peerChannel;
 
 @property (nonatomic, strong) GCDAsyncSocket *serverSocket;
-@property (nonatomic, strong) NSMutableDictionary *clientSockets;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, SKForwardedPipe *> *pipes;
 @property (nonatomic, assign) UInt32 lastClientSocketTag;
 @property (nonatomic, strong) dispatch_queue_t socketQueue;
 @property (nonatomic, strong) PTProtocol *protocol;
 
+// Pipes with queued frames, served round robin so that they share the
+// channel fairly.
+@property (nonatomic, strong) NSMutableArray<SKForwardedPipe *> *readyPipes;
+@property (nonatomic, assign) NSUInteger framesInFlight;
+// Bumped when the channel goes away, callbacks from older channels are
+// ignored.
+@property (nonatomic, assign) NSUInteger channelGeneration;
+
 @end
 
 @implementation SKPortForwardingServer
@@ -35,7 +80,8 @@
   if (self = [super init]) {
     _socketQueue = dispatch_queue_create("SKPortForwardingServer", DISPATCH_QUEUE_SERIAL);
     _lastClientSocketTag = 0;
-    _clientSockets = [NSMutableDictionary dictionary];
+    _pipes = [NSMutableDictionary dictionary];
+    _readyPipes = [NSMutableArray array];
     _protocol = [[PTProtocol alloc] initWithDispatchQueue:_socketQueue];
   }
   return self;
@@ -119,26 +165,90 @@
 - (void)ioFrameChannel:(PTChannel *)channel didReceiveFrameOfType:(uint32_t)type tag:(uint32_t)tag payload:(PTData *)payload {
   //NSLog(@"didReceiveFrameOfType: %u, %u, %@", type, tag, payload);
   if (type == SKPortForwardingFrameTypeWriteToPipe) {
-    GCDAsyncSocket *sock = self.clientSockets[@(tag)];
-    [sock writeData:[NSData dataWithBytes:payload.data length:payload.length] withTimeout:-1 tag:0];
+    GCDAsyncSocket *sock = self.pipes[@(tag)].socket;
+    // Dispatch data is an NSData, so the payload is written without being
+    // copied.
+    [sock writeData:(NSData *)payload.dispatchData withTimeout:-1 tag:0];
+    _framesReceivedFromDesktop++;
+    _bytesReceivedFromDesktop += payload.length;
     SKTrace(@"channel -> socket (%d), %zu bytes", tag, payload.length);
   }
 
   if (type == SKPortForwardingFrameTypeClosePipe) {
-    GCDAsyncSocket *sock = self.clientSockets[@(tag)];
+    GCDAsyncSocket *sock = self.pipes[@(tag)].socket;
     [sock disconnectAfterWriting];
   }
 }
 
 - (void)ioFrameChannel:(PTChannel *)channel didEndWithError:(NSError *)error {
-  for (GCDAsyncSocket *sock in [_clientSockets objectEnumerator]) {
-    [sock setDelegate:nil];
-    [sock disconnect];
+  for (SKForwardedPipe *pipe in [_pipes objectEnumerator]) {
+    pipe.closed = YES;
+    [pipe.socket setDelegate:nil];
+    [pipe.socket disconnect];
   }
-  [self.clientSockets removeAllObjects];
+  [self.pipes removeAllObjects];
+  [self.readyPipes removeAllObjects];
+  self.framesInFlight = 0;
+  self.channelGeneration++;
   SKTrace(@"Disconnected from %@, error = %@", channel.userInfo, error);
 }
 
+#pragma mark - Sending to the desktop
+
+- (void)_readFromPipe:(SKForwardedPipe *)pipe
+{
+  if (pipe.reading || pipe.closed || pipe.outstandingFrames >= kMaxFramesPerPipe) {
+    return;
+  }
+  pipe.reading = YES;
+  [pipe.socket readDataWithTimeout:-1 buffer:nil bufferOffset:0 maxLength:kMaxFrameLength tag:0];
+}
+
+- (void)_enqueueFrameOfType:(uint32_t)type payload:(dispatch_data_t)payload forPipe:(SKForwardedPipe *)pipe
+{
+  SKForwardedFrame *frame = [SKForwardedFrame new];
+  frame.type = type;
+  frame.payload = payload;
+  [pipe.frames addObject:frame];
+  pipe.outstandingFrames++;
+  if (pipe.frames.count == 1) {
+    [self.readyPipes addObject:pipe];
+  }
+  [self _sendPendingFrames];
+}
+
+- (void)_sendPendingFrames
+{
+  PTChannel *peerChannel = self.peerChannel;
+  while (peerChannel && self.framesInFlight < kMaxFramesInFlight && self.readyPipes.count > 0) {
+    SKForwardedPipe *pipe = self.readyPipes.firstObject;
+    [self.readyPipes removeObjectAtIndex:0];
+    SKForwardedFrame *frame = pipe.frames.firstObject;
+    [pipe.frames removeObjectAtIndex:0];
+    if (pipe.frames.count > 0) {
+      [self.readyPipes addObject:pipe];
+    }
+
+    self.framesInFlight++;
+    const NSUInteger generation = self.channelGeneration;
+    const size_t length = frame.payload ? dispatch_data_get_size(frame.payload) : 0;
+    [peerChannel sendFrameOfType:frame.type tag:pipe.tag withPayload:frame.payload callback:^(NSError *error) {
+      if (generation != self.channelGeneration) {
+        return;
+      }
+      SKTrace(@"socket (%d) -> channel %zu bytes, error = %@", (unsigned int)pipe.tag, length, error);
+      self.framesInFlight--;
+      pipe.outstandingFrames--;
+      if (!error && frame.type == SKPortForwardingFrameTypeWriteToPipe) {
+        self->_framesSentToDesktop++;
+        self->_bytesSentToDesktop += length;
+      }
+      [self _readFromPipe:pipe];
+      [self _sendPendingFrames];
+    }];
+  }
+}
+
 
 #pragma mark - GCDAsyncSocketDelegate
 
@@ -151,12 +261,17 @@
     }
 
     UInt32 tag = ++self->_lastClientSocketTag;
+    SKForwardedPipe *pipe = [SKForwardedPipe new];
+    pipe.tag = tag;
+    pipe.socket = newSocket;
+    pipe.frames = [NSMutableArray array];
     newSocket.userData = @(tag);
     newSocket.delegate = self;
-    self.clientSockets[@(tag)] = newSocket;
-    [self.peerChannel sendFrameOfType:SKPortForwardingFrameTypeOpenPipe tag:self->_lastClientSocketTag withPayload:nil callback:^(NSError *error) {
+    self.pipes[@(tag)] = pipe;
+    // Sent ahead of everything queued, no data of this pipe can be waiting.
+    [self.peerChannel sendFrameOfType:SKPortForwardingFrameTypeOpenPipe tag:tag withPayload:nil callback:^(NSError *error) {
       SKTrace(@"open socket (%d), error = %@", (unsigned int)tag, error);
-      [newSocket readDataWithTimeout:-1 tag:0];
+      [self _readFromPipe:pipe];
     }];
   };
 
@@ -170,20 +285,28 @@
 - (void)socket:(GCDAsyncSocket *)sock didReadData:(NSData *)data withTag:(long)_
 {
   UInt32 tag = [[sock userData] unsignedIntValue];
+  SKForwardedPipe *pipe = _pipes[@(tag)];
   SKTrace(@"Incoming data on socket (%d) - %lu bytes", (unsigned int)tag, (unsigned long)data.length);
-  [_peerChannel sendFrameOfType:SKPortForwardingFrameTypeWriteToPipe tag:tag withPayload:NSDataToGCDData(data) callback:^(NSError *error) {
-    SKTrace(@"socket (%d) -> channel %lu bytes, error = %@", (unsigned int)tag, (unsigned long)data.length, error);
-    [sock readDataWithTimeout:-1 tag:_];
-  }];
+  if (!pipe) {
+    return;
+  }
+  pipe.reading = NO;
+  [self _enqueueFrameOfType:SKPortForwardingFrameTypeWriteToPipe payload:NSDataToGCDData(data) forPipe:pipe];
+  [self _readFromPipe:pipe];
 }
 
 - (void)socketDidDisconnect:(GCDAsyncSocket *)sock withError:(NSError *)err
 {
   UInt32 tag = [sock.userData unsignedIntValue];
-  [_clientSockets removeObjectForKey:@(tag)];
-  [_peerChannel sendFrameOfType:SKPortForwardingFrameTypeClosePipe tag:tag withPayload:nil callback:^(NSError *error) {
-    SKTrace(@"socket (%d) disconnected, err = %@, peer error = %@", (unsigned int)tag, err, error);
-  }];
+  SKForwardedPipe *pipe = _pipes[@(tag)];
+  if (!pipe) {
+    return;
+  }
+  [_pipes removeObjectForKey:@(tag)];
+  pipe.closed = YES;
+  SKTrace(@"socket (%d) disconnected, err = %@", (unsigned int)tag, err);
+  // Queued behind the pipe's remaining data.
+  [self _enqueueFrameOfType:SKPortForwardingFrameTypeClosePipe payload:nil forPipe:pipe];
 }
 
 
@@ -13,6 +13,7 @@
 
 @property (nonatomic, assign, getter=isConnected) BOOL connected;
 @property (nonatomic, readonly) NSDictionary<NSString *, SonarReceiver> *receivers;
+@property (nonatomic, readonly) NSDictionary<NSString *, SonarStreamReceiver> *streamReceivers;
 @property (nonatomic, readonly) NSDictionary<NSString *, NSArray<NSDictionary *> *> *sent;
 
 @end
@@ -14,6 +14,7 @@
   if (self = [super init]) {
     _connected = YES;
     _receivers = @{};
+    _streamReceivers = @{};
     _sent = @{};
   }
   return self;
@@ -34,6 +35,13 @@
   }
 }
 
+- (void)send:(NSString *)method withParamsBuilder:(SonarParamsBuilder)builder
+{
+  if (_connected) {
+    [self send:method withParams:builder()];
+  }
+}
+
 - (void)receive:(NSString *)method withBlock:(SonarReceiver)receiver
 {
   if (_connected) {
@@ -44,4 +52,14 @@
   }
 }
 
+- (void)receiveStream:(NSString *)method withBlock:(SonarStreamReceiver)receiver
+{
+  if (_connected) {
+    NSMutableDictionary *newReceivers = [NSMutableDictionary new];
+    [newReceivers addEntriesFromDictionary:_streamReceivers];
+    newReceivers[method] = receiver;
+    _streamReceivers = newReceivers;
+  }
+}
+
 @end
@@ -0,0 +1,18 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#import <Foundation/Foundation.h>
+
+#import <SonarKit/SonarStreamResponder.h>
+
+@interface SonarStreamResponderMock : NSObject<SonarStreamResponder>
+
+@property (nonatomic, readonly) NSArray<NSDictionary *> *chunks;
+@property (nonatomic, readonly) NSArray<NSDictionary *> *errors;
+@property (nonatomic, readonly, getter=isCompleted) BOOL completed;
+
+@end
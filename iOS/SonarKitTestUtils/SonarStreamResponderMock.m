@@ -0,0 +1,36 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#import "SonarStreamResponderMock.h"
+
+@implementation SonarStreamResponderMock
+
+- (instancetype)init
+{
+  if (self = [super init]) {
+    _chunks = @[];
+    _errors = @[];
+  }
+  return self;
+}
+
+- (void)next:(NSDictionary *)chunk
+{
+  _chunks = [_chunks arrayByAddingObject:chunk];
+}
+
+- (void)complete
+{
+  _completed = YES;
+}
+
+- (void)error:(NSDictionary *)response
+{
+  _errors = [_errors arrayByAddingObject:response];
+}
+
+@end
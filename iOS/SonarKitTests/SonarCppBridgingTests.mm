@@ -15,10 +15,15 @@
 using facebook::sonar::SonarCppWrapperPlugin;
 
 @interface DummyPlugin : NSObject <SonarPlugin>
+@property (nonatomic, assign) NSUInteger identifierCalls;
 @end
 
 @implementation DummyPlugin
-- (NSString *)identifier { return @"Dummy"; }
+- (NSString *)identifier
+{
+  self.identifierCalls++;
+  return @"Dummy";
+}
 - (void)didConnect:(id<SonarConnection>)connection {}
 - (void)didDisconnect {}
 @end
@@ -36,6 +41,22 @@ using facebook::sonar::SonarCppWrapperPlugin;
   XCTAssertTrue(retainCountAfter > retainCountBefore);
 }
 
+- (void)testCppWrapperReadsIdentifierOnce {
+  DummyPlugin *dummyPlugin = [DummyPlugin new];
+  SonarCppWrapperPlugin wrapperPlugin(dummyPlugin);
+  XCTAssertTrue(wrapperPlugin.identifier() == "Dummy");
+  XCTAssertTrue(wrapperPlugin.identifier() == "Dummy");
+  XCTAssertEqual(dummyPlugin.identifierCalls, (NSUInteger)1);
+}
+
+- (void)testBridgeCallsAreCounted {
+  DummyPlugin *dummyPlugin = [DummyPlugin new];
+  SonarCppWrapperPlugin wrapperPlugin(dummyPlugin);
+  wrapperPlugin.didDisconnect();
+  const std::string stats = facebook::sonar::SonarCppBridgeStats::dump();
+  XCTAssertNotEqual(stats.find("SonarPlugin.didDisconnect: "), std::string::npos);
+}
+
 @end
 
 #endif
@@ -40,16 +40,21 @@
     #define socketerrno WSAGetLastError()
     #define SOCKET_EAGAIN_EINPROGRESS WSAEINPROGRESS
     #define SOCKET_EWOULDBLOCK WSAEWOULDBLOCK
+    #define socket_poll WSAPoll
+    #define strncasecmp _strnicmp
 #else
     #include <fcntl.h>
     #include <netdb.h>
     #include <netinet/tcp.h>
+    #include <poll.h>
     #include <stdio.h>
     #include <stdlib.h>
     #include <string.h>
+    #include <strings.h>
     #include <sys/socket.h>
     #include <sys/time.h>
     #include <sys/types.h>
+    #include <sys/uio.h>
     #include <unistd.h>
     #include <stdint.h>
     #ifndef _SOCKET_T_DEFINED
@@ -67,18 +72,130 @@
     #define socketerrno errno
     #define SOCKET_EAGAIN_EINPROGRESS EAGAIN
     #define SOCKET_EWOULDBLOCK EWOULDBLOCK
+    #define socket_poll ::poll
 #endif
 
 #include <vector>
 #include <string>
 
+#include <zlib.h>
+
 #include "easywsclient.hpp"
 
 using easywsclient::Callback_Imp;
 using easywsclient::BytesCallback_Imp;
+using easywsclient::StreamCallback_Imp;
+using easywsclient::DeflateOptions;
+using easywsclient::MaskFunction;
 
 namespace { // private module-only namespace
 
+// Bytes are received straight into this buffer in large reads. Consuming a
+// frame only advances begin, the unconsumed bytes are moved back to the front
+// when more room is needed, so a frame is always contiguous and bursts of
+// small frames cost linear time.
+class ReceiveBuffer {
+  public:
+    ReceiveBuffer() : begin(0), end(0) { }
+
+    size_t size() const { return end - begin; }
+    uint8_t* data() { return &buf[0] + begin; }
+
+    // Returns room for at least n more bytes, to be committed after writing.
+    uint8_t* reserve(size_t n) {
+        if (buf.size() - end < n) {
+            if (begin > 0) {
+                memmove(&buf[0], &buf[0] + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            if (buf.size() - end < n) {
+                buf.resize(end + n);
+            }
+        }
+        return &buf[0] + end;
+    }
+    void commit(size_t n) { end += n; }
+
+    void consume(size_t n) {
+        begin += n;
+        if (begin == end) { begin = end = 0; }
+    }
+
+  private:
+    std::vector<uint8_t> buf;
+    size_t begin;
+    size_t end;
+};
+
+// How much each recv asks for.
+const size_t kReadSize = 64 * 1024;
+
+// XORs n bytes of src with the masking key, starting at its first byte, into
+// dst, which may be src. After bytes up to an 8 byte boundary of dst, the
+// key is applied a word at a time.
+void apply_mask(uint8_t* dst, const uint8_t* src, size_t n, const uint8_t masking_key[4]) {
+    size_t i = 0;
+    while (i < n && ((uintptr_t)(dst + i) & 7)) {
+        dst[i] = src[i] ^ masking_key[i&0x3];
+        ++i;
+    }
+    if (n - i >= 8) {
+        uint8_t pattern[8];
+        for (size_t j = 0; j != 8; ++j) { pattern[j] = masking_key[(i + j)&0x3]; }
+        uint64_t key;
+        memcpy(&key, pattern, 8);
+        for (; n - i >= 16; i += 16) {
+            uint64_t a;
+            uint64_t b;
+            memcpy(&a, src + i, 8);
+            memcpy(&b, src + i + 8, 8);
+            a ^= key;
+            b ^= key;
+            memcpy(dst + i, &a, 8);
+            memcpy(dst + i + 8, &b, 8);
+        }
+        for (; n - i >= 8; i += 8) {
+            uint64_t a;
+            memcpy(&a, src + i, 8);
+            a ^= key;
+            memcpy(dst + i, &a, 8);
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i] = src[i] ^ masking_key[i&0x3];
+    }
+}
+
+// See easywsclient::setMaskFunction.
+MaskFunction mask_function = apply_mask;
+
+// Sends a frame header and its payload with a single gather write, without
+// copying either into one buffer first.
+ssize_t send_frame(socket_t sockfd, const uint8_t* header, size_t header_size, const uint8_t* payload, size_t payload_size) {
+#ifdef _WIN32
+    WSABUF buffers[2];
+    buffers[0].buf = (char*)header;
+    buffers[0].len = (ULONG)header_size;
+    buffers[1].buf = (char*)payload;
+    buffers[1].len = (ULONG)payload_size;
+    DWORD sent = 0;
+    if (WSASend(sockfd, buffers, 2, &sent, 0, NULL, NULL) == SOCKET_ERROR) { return -1; }
+    return sent;
+#else
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)header;
+    iov[0].iov_len = header_size;
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = payload_size;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    return sendmsg(sockfd, &msg, 0);
+#endif
+}
+
 socket_t hostname_connect(const std::string& hostname, int port) {
     struct addrinfo hints;
     struct addrinfo *result;
@@ -110,6 +227,39 @@ socket_t hostname_connect(const std::string& hostname, int port) {
 }
 
 
+// What the server agreed to in its Sec-WebSocket-Extensions response.
+struct DeflateParams {
+    bool enabled;
+    bool serverNoContextTakeover;
+    bool clientNoContextTakeover;
+    int clientMaxWindowBits;
+    size_t threshold;
+
+    DeflateParams() : enabled(false), serverNoContextTakeover(false), clientNoContextTakeover(false), clientMaxWindowBits(15), threshold(0) { }
+};
+
+// Parses a permessage-deflate response, e.g.
+// "permessage-deflate; server_no_context_takeover; client_max_window_bits=10".
+// Returns false if the server didn't accept the extension.
+bool parse_deflate_response(const char* value, const DeflateOptions& options, DeflateParams& params) {
+    const char* p = strstr(value, "permessage-deflate");
+    if (p == NULL) { return false; }
+    params.enabled = true;
+    params.serverNoContextTakeover = options.serverNoContextTakeover;
+    params.clientNoContextTakeover = options.clientNoContextTakeover;
+    params.threshold = options.threshold;
+    if (strstr(p, "server_no_context_takeover")) { params.serverNoContextTakeover = true; }
+    if (strstr(p, "client_no_context_takeover")) { params.clientNoContextTakeover = true; }
+    const char* bits = strstr(p, "client_max_window_bits=");
+    if (bits) {
+        params.clientMaxWindowBits = atoi(bits + strlen("client_max_window_bits="));
+        if (params.clientMaxWindowBits < 8 || params.clientMaxWindowBits > 15) { return false; }
+        // zlib can't write raw deflate streams with a 256 byte window.
+        if (params.clientMaxWindowBits == 8) { params.clientMaxWindowBits = 9; }
+    }
+    return true;
+}
+
 class _DummyWebSocket : public easywsclient::WebSocket
 {
   public:
@@ -120,8 +270,11 @@ class _DummyWebSocket : public easywsclient::WebSocket
     void sendPing() { }
     void close() { }
     readyStateValues getReadyState() const { return CLOSED; }
+    intptr_t getSocket() const { return (intptr_t)INVALID_SOCKET; }
+    size_t bufferedAmount() const { return 0; }
     void _dispatch(Callback_Imp & callable) { }
     void _dispatchBinary(BytesCallback_Imp& callable) { }
+    void _dispatchStreaming(StreamCallback_Imp& callable) { }
 };
 
 
@@ -151,6 +304,7 @@ class _RealWebSocket : public easywsclient::WebSocket
     struct wsheader_type {
         unsigned header_size;
         bool fin;
+        bool rsv1;
         bool mask;
         enum opcode_type {
             CONTINUATION = 0x0,
@@ -165,63 +319,111 @@ class _RealWebSocket : public easywsclient::WebSocket
         uint8_t masking_key[4];
     };
 
-    std::vector<uint8_t> rxbuf;
+    ReceiveBuffer rxbuf;
+    // Bytes that couldn't be sent right away. The ones before txoffset have
+    // been sent already.
     std::vector<uint8_t> txbuf;
+    size_t txoffset;
     std::vector<uint8_t> receivedData;
 
     socket_t sockfd;
     readyStateValues readyState;
     bool useMask;
 
-    _RealWebSocket(socket_t sockfd, bool useMask) : sockfd(sockfd), readyState(OPEN), useMask(useMask) {
+    DeflateParams deflateParams;
+    z_stream deflater;
+    z_stream inflater;
+    // Whether the message being received in receivedData is compressed.
+    bool receivedCompressed;
+    std::vector<uint8_t> deflated;
+    // Set when permessage-deflate was negotiated but zlib couldn't be set
+    // up for it, see from_url.
+    bool compressionFailed;
+
+    // The data frame dispatchStreaming is in the middle of. Its header has
+    // been consumed, streamRemaining payload bytes haven't been delivered yet.
+    uint64_t streamRemaining;
+    bool streamFin;
+    bool streamMask;
+    uint8_t streamMaskingKey[4];
+    std::vector<uint8_t> inflated;
+
+    _RealWebSocket(socket_t sockfd, bool useMask, const DeflateParams& deflateParams) : txoffset(0), sockfd(sockfd), readyState(OPEN), useMask(useMask), deflateParams(deflateParams), receivedCompressed(false), compressionFailed(false), streamRemaining(0), streamFin(false), streamMask(false) {
+        memset(&deflater, 0, sizeof(deflater));
+        memset(&inflater, 0, sizeof(inflater));
+        if (deflateParams.enabled) {
+            // Negative window bits make zlib read and write raw deflate
+            // streams, without the zlib header and checksum.
+            const bool deflaterReady = deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -deflateParams.clientMaxWindowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            const bool inflaterReady = inflateInit2(&inflater, -15) == Z_OK;
+            if (!deflaterReady || !inflaterReady) {
+                if (deflaterReady) { deflateEnd(&deflater); }
+                if (inflaterReady) { inflateEnd(&inflater); }
+                this->deflateParams.enabled = false;
+                compressionFailed = true;
+            }
+        }
+    }
+
+    ~_RealWebSocket() {
+        if (deflateParams.enabled) {
+            deflateEnd(&deflater);
+            inflateEnd(&inflater);
+        }
     }
 
     readyStateValues getReadyState() const {
       return readyState;
     }
 
+    intptr_t getSocket() const {
+      return (intptr_t)sockfd;
+    }
+
+    size_t bufferedAmount() const {
+      return txbuf.size() - txoffset;
+    }
+
     void poll(int timeout) { // timeout in milliseconds
         if (readyState == CLOSED) {
             if (timeout > 0) {
-                timeval tv = { timeout/1000, (timeout%1000) * 1000 };
-                select(0, NULL, NULL, NULL, &tv);
+#ifdef _WIN32
+                Sleep(timeout);
+#else
+                socket_poll(NULL, 0, timeout);
+#endif
             }
             return;
         }
         if (timeout != 0) {
-            fd_set rfds;
-            fd_set wfds;
-            timeval tv = { timeout/1000, (timeout%1000) * 1000 };
-            FD_ZERO(&rfds);
-            FD_ZERO(&wfds);
-            FD_SET(sockfd, &rfds);
-            if (txbuf.size()) { FD_SET(sockfd, &wfds); }
-            select(sockfd + 1, &rfds, &wfds, 0, timeout > 0 ? &tv : 0);
+            // poll() rather than select(), which can't wait on descriptors
+            // past FD_SETSIZE.
+            struct pollfd pfd;
+            pfd.fd = sockfd;
+            pfd.events = POLLIN | (txbuf.size() ? POLLOUT : 0);
+            pfd.revents = 0;
+            socket_poll(&pfd, 1, timeout > 0 ? timeout : -1);
         }
         while (true) {
-            // FD_ISSET(0, &rfds) will be true
-            int N = rxbuf.size();
             ssize_t ret;
-            rxbuf.resize(N + 1500);
-            ret = recv(sockfd, (char*)&rxbuf[0] + N, 1500, 0);
+            uint8_t* buf = rxbuf.reserve(kReadSize);
+            ret = recv(sockfd, (char*)buf, kReadSize, 0);
             if (false) { }
             else if (ret < 0 && (socketerrno == SOCKET_EWOULDBLOCK || socketerrno == SOCKET_EAGAIN_EINPROGRESS)) {
-                rxbuf.resize(N);
                 break;
             }
             else if (ret <= 0) {
-                rxbuf.resize(N);
                 closesocket(sockfd);
                 readyState = CLOSED;
                 fputs(ret < 0 ? "Connection error!\n" : "Connection closed!\n", stderr);
                 break;
             }
             else {
-                rxbuf.resize(N + ret);
+                rxbuf.commit(ret);
             }
         }
         while (txbuf.size()) {
-            int ret = ::send(sockfd, (char*)&txbuf[0], txbuf.size(), 0);
+            int ret = ::send(sockfd, (char*)&txbuf[txoffset], txbuf.size() - txoffset, 0);
             if (false) { } // ??
             else if (ret < 0 && (socketerrno == SOCKET_EWOULDBLOCK || socketerrno == SOCKET_EAGAIN_EINPROGRESS)) {
                 break;
@@ -233,7 +435,11 @@ class _RealWebSocket : public easywsclient::WebSocket
                 break;
             }
             else {
-                txbuf.erase(txbuf.begin(), txbuf.begin() + ret);
+                txoffset += ret;
+                if (txoffset == txbuf.size()) {
+                    txbuf.clear();
+                    txoffset = 0;
+                }
             }
         }
         if (!txbuf.size() && readyState == CLOSING) {
@@ -262,53 +468,61 @@ class _RealWebSocket : public easywsclient::WebSocket
         _dispatchBinary(bytesCallback);
     }
 
+    // Parses the frame header at the start of data, false if it isn't all
+    // there yet.
+    static bool parseHeader(const uint8_t* data, size_t size, wsheader_type& ws) {
+        if (size < 2) { return false; /* Need at least 2 */ }
+        ws.fin = (data[0] & 0x80) == 0x80;
+        ws.rsv1 = (data[0] & 0x40) == 0x40;
+        ws.opcode = (wsheader_type::opcode_type) (data[0] & 0x0f);
+        ws.mask = (data[1] & 0x80) == 0x80;
+        ws.N0 = (data[1] & 0x7f);
+        ws.header_size = 2 + (ws.N0 == 126? 2 : 0) + (ws.N0 == 127? 8 : 0) + (ws.mask? 4 : 0);
+        if (size < ws.header_size) { return false; /* Need: ws.header_size - size */ }
+        int i = 0;
+        if (ws.N0 < 126) {
+            ws.N = ws.N0;
+            i = 2;
+        }
+        else if (ws.N0 == 126) {
+            ws.N = 0;
+            ws.N |= ((uint64_t) data[2]) << 8;
+            ws.N |= ((uint64_t) data[3]) << 0;
+            i = 4;
+        }
+        else if (ws.N0 == 127) {
+            ws.N = 0;
+            ws.N |= ((uint64_t) data[2]) << 56;
+            ws.N |= ((uint64_t) data[3]) << 48;
+            ws.N |= ((uint64_t) data[4]) << 40;
+            ws.N |= ((uint64_t) data[5]) << 32;
+            ws.N |= ((uint64_t) data[6]) << 24;
+            ws.N |= ((uint64_t) data[7]) << 16;
+            ws.N |= ((uint64_t) data[8]) << 8;
+            ws.N |= ((uint64_t) data[9]) << 0;
+            i = 10;
+        }
+        if (ws.mask) {
+            ws.masking_key[0] = ((uint8_t) data[i+0]) << 0;
+            ws.masking_key[1] = ((uint8_t) data[i+1]) << 0;
+            ws.masking_key[2] = ((uint8_t) data[i+2]) << 0;
+            ws.masking_key[3] = ((uint8_t) data[i+3]) << 0;
+        }
+        else {
+            ws.masking_key[0] = 0;
+            ws.masking_key[1] = 0;
+            ws.masking_key[2] = 0;
+            ws.masking_key[3] = 0;
+        }
+        return true;
+    }
+
     virtual void _dispatchBinary(BytesCallback_Imp & callable) {
         // TODO: consider acquiring a lock on rxbuf...
         while (true) {
             wsheader_type ws;
-            if (rxbuf.size() < 2) { return; /* Need at least 2 */ }
-            const uint8_t * data = (uint8_t *) &rxbuf[0]; // peek, but don't consume
-            ws.fin = (data[0] & 0x80) == 0x80;
-            ws.opcode = (wsheader_type::opcode_type) (data[0] & 0x0f);
-            ws.mask = (data[1] & 0x80) == 0x80;
-            ws.N0 = (data[1] & 0x7f);
-            ws.header_size = 2 + (ws.N0 == 126? 2 : 0) + (ws.N0 == 127? 8 : 0) + (ws.mask? 4 : 0);
-            if (rxbuf.size() < ws.header_size) { return; /* Need: ws.header_size - rxbuf.size() */ }
-            int i = 0;
-            if (ws.N0 < 126) {
-                ws.N = ws.N0;
-                i = 2;
-            }
-            else if (ws.N0 == 126) {
-                ws.N = 0;
-                ws.N |= ((uint64_t) data[2]) << 8;
-                ws.N |= ((uint64_t) data[3]) << 0;
-                i = 4;
-            }
-            else if (ws.N0 == 127) {
-                ws.N = 0;
-                ws.N |= ((uint64_t) data[2]) << 56;
-                ws.N |= ((uint64_t) data[3]) << 48;
-                ws.N |= ((uint64_t) data[4]) << 40;
-                ws.N |= ((uint64_t) data[5]) << 32;
-                ws.N |= ((uint64_t) data[6]) << 24;
-                ws.N |= ((uint64_t) data[7]) << 16;
-                ws.N |= ((uint64_t) data[8]) << 8;
-                ws.N |= ((uint64_t) data[9]) << 0;
-                i = 10;
-            }
-            if (ws.mask) {
-                ws.masking_key[0] = ((uint8_t) data[i+0]) << 0;
-                ws.masking_key[1] = ((uint8_t) data[i+1]) << 0;
-                ws.masking_key[2] = ((uint8_t) data[i+2]) << 0;
-                ws.masking_key[3] = ((uint8_t) data[i+3]) << 0;
-            }
-            else {
-                ws.masking_key[0] = 0;
-                ws.masking_key[1] = 0;
-                ws.masking_key[2] = 0;
-                ws.masking_key[3] = 0;
-            }
+            uint8_t * data = rxbuf.data(); // peek, but don't consume
+            if (!parseHeader(data, rxbuf.size(), ws)) { return; /* Need more */ }
             if (rxbuf.size() < ws.header_size+ws.N) { return; /* Need: ws.header_size+ws.N - rxbuf.size() */ }
 
             // We got a whole message, now do something with it:
@@ -318,46 +532,204 @@ class _RealWebSocket : public easywsclient::WebSocket
                 || ws.opcode == wsheader_type::BINARY_FRAME
                 || ws.opcode == wsheader_type::CONTINUATION
             ) {
-                if (ws.mask) { for (size_t i = 0; i != ws.N; ++i) { rxbuf[i+ws.header_size] ^= ws.masking_key[i&0x3]; } }
-                receivedData.insert(receivedData.end(), rxbuf.begin()+ws.header_size, rxbuf.begin()+ws.header_size+(size_t)ws.N);// just feed
+                if (ws.mask) { mask_function(data+ws.header_size, data+ws.header_size, (size_t)ws.N, ws.masking_key); }
+                // Only the first frame of a message says whether it is compressed.
+                if (ws.opcode != wsheader_type::CONTINUATION) { receivedCompressed = ws.rsv1 && deflateParams.enabled; }
+                receivedData.insert(receivedData.end(), data+ws.header_size, data+ws.header_size+(size_t)ws.N);// just feed
                 if (ws.fin) {
-                    callable((const std::vector<uint8_t>) receivedData);
+                    if (receivedCompressed && !inflateMessage(receivedData)) {
+                        fprintf(stderr, "ERROR: Could not inflate WebSocket message.\n");
+                        close();
+                    }
+                    else {
+                        callable((const std::vector<uint8_t>) receivedData);
+                    }
                     receivedData.erase(receivedData.begin(), receivedData.end());
                     std::vector<uint8_t> ().swap(receivedData);// free memory
                 }
             }
-            else if (ws.opcode == wsheader_type::PING) {
-                if (ws.mask) { for (size_t i = 0; i != ws.N; ++i) { rxbuf[i+ws.header_size] ^= ws.masking_key[i&0x3]; } }
-                std::string data(rxbuf.begin()+ws.header_size, rxbuf.begin()+ws.header_size+(size_t)ws.N);
-                sendData(wsheader_type::PONG, data.size(), data.begin(), data.end());
+            else { handleControlFrame(ws, data); }
+
+            rxbuf.consume(ws.header_size+(size_t)ws.N);
+        }
+    }
+
+    void handleControlFrame(const wsheader_type& ws, uint8_t* data) {
+        if (ws.opcode == wsheader_type::PING) {
+            if (ws.mask) { mask_function(data+ws.header_size, data+ws.header_size, (size_t)ws.N, ws.masking_key); }
+            sendData(wsheader_type::PONG, data+ws.header_size, (size_t)ws.N);
+        }
+        else if (ws.opcode == wsheader_type::PONG) { }
+        else if (ws.opcode == wsheader_type::CLOSE) { close(); }
+        else { fprintf(stderr, "ERROR: Got unexpected WebSocket message.\n"); close(); }
+    }
+
+    virtual void _dispatchStreaming(StreamCallback_Imp & callable) {
+        while (readyState != CLOSED) {
+            if (streamRemaining) {
+                // Hand over what has arrived of the current frame's payload.
+                size_t n = rxbuf.size() < streamRemaining ? rxbuf.size() : (size_t)streamRemaining;
+                if (!n) { return; }
+                uint8_t * data = rxbuf.data();
+                if (streamMask) {
+                    mask_function(data, data, n, streamMaskingKey);
+                    // Keep the key lined up with the next payload byte.
+                    uint8_t key[4];
+                    for (size_t i = 0; i < 4; ++i) { key[i] = streamMaskingKey[(n + i) & 3]; }
+                    memcpy(streamMaskingKey, key, 4);
+                }
+                streamRemaining -= n;
+                bool ok = deliverFragment(callable, data, n);
+                rxbuf.consume(n);
+                if (!ok) { return; }
+                if (!streamRemaining && streamFin) { endStreamedMessage(callable); }
+                continue;
             }
-            else if (ws.opcode == wsheader_type::PONG) { }
-            else if (ws.opcode == wsheader_type::CLOSE) { close(); }
-            else { fprintf(stderr, "ERROR: Got unexpected WebSocket message.\n"); close(); }
+            wsheader_type ws;
+            uint8_t * data = rxbuf.data(); // peek, but don't consume
+            if (!parseHeader(data, rxbuf.size(), ws)) { return; /* Need more */ }
+            if (
+                   ws.opcode == wsheader_type::TEXT_FRAME
+                || ws.opcode == wsheader_type::BINARY_FRAME
+                || ws.opcode == wsheader_type::CONTINUATION
+            ) {
+                // Data frames don't have to be complete, their payload is
+                // delivered as it arrives.
+                if (ws.opcode != wsheader_type::CONTINUATION) { receivedCompressed = ws.rsv1 && deflateParams.enabled; }
+                streamRemaining = ws.N;
+                streamFin = ws.fin;
+                streamMask = ws.mask;
+                memcpy(streamMaskingKey, ws.masking_key, 4);
+                rxbuf.consume(ws.header_size);
+                if (!streamRemaining && streamFin) { endStreamedMessage(callable); }
+                continue;
+            }
+            if (rxbuf.size() < ws.header_size+ws.N) { return; /* Need: ws.header_size+ws.N - rxbuf.size() */ }
+            handleControlFrame(ws, data);
+            rxbuf.consume(ws.header_size+(size_t)ws.N);
+        }
+    }
 
-            rxbuf.erase(rxbuf.begin(), rxbuf.begin() + ws.header_size+(size_t)ws.N);
+    bool deliverFragment(StreamCallback_Imp & callable, const uint8_t* data, size_t size) {
+        if (!receivedCompressed) {
+            if (size) { callable.onFragment(data, size); }
+            return true;
+        }
+        if (!inflateFragment(callable, data, size)) {
+            fprintf(stderr, "ERROR: Could not inflate WebSocket message.\n");
+            streamRemaining = 0;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void endStreamedMessage(StreamCallback_Imp & callable) {
+        if (receivedCompressed) {
+            static const uint8_t tail[4] = { 0x00, 0x00, 0xff, 0xff };
+            if (!deliverFragment(callable, tail, 4)) { return; }
+            if (deflateParams.serverNoContextTakeover) { inflateReset(&inflater); }
+            receivedCompressed = false;
+        }
+        callable.onEnd();
+    }
+
+    // Inflates part of a compressed message, handing the output over as it is
+    // produced.
+    bool inflateFragment(StreamCallback_Imp & callable, const uint8_t* data, size_t size) {
+        if (inflated.empty()) { inflated.resize(kReadSize); }
+        inflater.next_in = (Bytef*)data;
+        inflater.avail_in = size;
+        while (true) {
+            inflater.next_out = &inflated[0];
+            inflater.avail_out = inflated.size();
+            int ret = inflate(&inflater, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) { return false; }
+            size_t produced = inflated.size() - inflater.avail_out;
+            if (produced) { callable.onFragment(&inflated[0], produced); }
+            if (ret == Z_STREAM_END) { inflateReset(&inflater); return true; }
+            if (inflater.avail_out != 0) { return inflater.avail_in == 0; }
         }
     }
 
     void sendPing() {
-        std::string empty;
-        sendData(wsheader_type::PING, empty.size(), empty.begin(), empty.end());
+        sendData(wsheader_type::PING, NULL, 0);
     }
 
     void send(const std::string& message) {
-        sendData(wsheader_type::TEXT_FRAME, message.size(), message.begin(), message.end());
+        sendMessage(wsheader_type::TEXT_FRAME, (const uint8_t*)message.data(), message.size());
     }
 
     void sendBinary(const std::string& message) {
-        sendData(wsheader_type::BINARY_FRAME, message.size(), message.begin(), message.end());
+        sendMessage(wsheader_type::BINARY_FRAME, (const uint8_t*)message.data(), message.size());
     }
 
     void sendBinary(const std::vector<uint8_t>& message) {
-        sendData(wsheader_type::BINARY_FRAME, message.size(), message.begin(), message.end());
+        sendMessage(wsheader_type::BINARY_FRAME, message.empty() ? NULL : &message[0], message.size());
+    }
+
+    void sendMessage(wsheader_type::opcode_type type, const uint8_t* message, size_t message_size) {
+        if (deflateParams.enabled && message_size >= deflateParams.threshold && readyState == OPEN) {
+            if (!deflateMessage(message, message_size)) {
+                fprintf(stderr, "ERROR: Could not deflate WebSocket message.\n");
+                close();
+                return;
+            }
+            sendData(type, deflated.empty() ? NULL : &deflated[0], deflated.size(), true);
+            return;
+        }
+        sendData(type, message, message_size);
+    }
+
+    // Compresses a message into deflated, as RFC 7692 section 7.2.1 says.
+    bool deflateMessage(const uint8_t* message, size_t message_size) {
+        deflated.resize(deflateBound(&deflater, message_size) + 16);
+        deflater.next_in = (Bytef*)message;
+        deflater.avail_in = message_size;
+        deflater.next_out = &deflated[0];
+        deflater.avail_out = deflated.size();
+        size_t produced;
+        while (true) {
+            int ret = deflate(&deflater, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_BUF_ERROR) { return false; }
+            produced = deflated.size() - deflater.avail_out;
+            if (deflater.avail_out != 0) { break; }
+            deflated.resize(deflated.size() * 2);
+            deflater.next_out = &deflated[produced];
+            deflater.avail_out = deflated.size() - produced;
+        }
+        // The flush ends in an empty block, 00 00 ff ff, which isn't sent.
+        deflated.resize(produced >= 4 ? produced - 4 : produced);
+        if (deflateParams.clientNoContextTakeover) { deflateReset(&deflater); }
+        return true;
+    }
+
+    // Decompresses a received message in place.
+    bool inflateMessage(std::vector<uint8_t>& message) {
+        static const uint8_t tail[4] = { 0x00, 0x00, 0xff, 0xff };
+        message.insert(message.end(), tail, tail + 4);
+        std::vector<uint8_t> out(message.size() * 4);
+        inflater.next_in = &message[0];
+        inflater.avail_in = message.size();
+        size_t produced = 0;
+        int ret;
+        while (true) {
+            inflater.next_out = &out[produced];
+            inflater.avail_out = out.size() - produced;
+            ret = inflate(&inflater, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) { return false; }
+            produced = out.size() - inflater.avail_out;
+            if (ret == Z_STREAM_END || (inflater.avail_in == 0 && inflater.avail_out != 0)) { break; }
+            if (inflater.avail_out != 0) { return false; /* No progress */ }
+            out.resize(out.size() * 2);
+        }
+        out.resize(produced);
+        message.swap(out);
+        if (ret == Z_STREAM_END || deflateParams.serverNoContextTakeover) { inflateReset(&inflater); }
+        return true;
     }
 
-    template<class Iterator>
-    void sendData(wsheader_type::opcode_type type, uint64_t message_size, Iterator message_begin, Iterator message_end) {
+    void sendData(wsheader_type::opcode_type type, const uint8_t* message, size_t message_size, bool compressed = false) {
         // TODO:
         // Masking key should (must) be derived from a high quality random
         // number generator, to mitigate attacks on non-WebSocket friendly
@@ -365,9 +737,9 @@ class _RealWebSocket : public easywsclient::WebSocket
         const uint8_t masking_key[4] = { 0x12, 0x34, 0x56, 0x78 };
         // TODO: consider acquiring a lock on txbuf...
         if (readyState == CLOSING || readyState == CLOSED) { return; }
-        std::vector<uint8_t> header;
-        header.assign(2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) + (useMask ? 4 : 0), 0);
-        header[0] = 0x80 | type;
+        uint8_t header[14];
+        size_t header_size = 2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) + (useMask ? 4 : 0);
+        header[0] = 0x80 | (compressed ? 0x40 : 0) | type;
         if (false) { }
         else if (message_size < 126) {
             header[1] = (message_size & 0xff) | (useMask ? 0x80 : 0);
@@ -391,10 +763,10 @@ class _RealWebSocket : public easywsclient::WebSocket
         }
         else { // TODO: run coverage testing here
             header[1] = 127 | (useMask ? 0x80 : 0);
-            header[2] = (message_size >> 56) & 0xff;
-            header[3] = (message_size >> 48) & 0xff;
-            header[4] = (message_size >> 40) & 0xff;
-            header[5] = (message_size >> 32) & 0xff;
+            header[2] = ((uint64_t) message_size >> 56) & 0xff;
+            header[3] = ((uint64_t) message_size >> 48) & 0xff;
+            header[4] = ((uint64_t) message_size >> 40) & 0xff;
+            header[5] = ((uint64_t) message_size >> 32) & 0xff;
             header[6] = (message_size >> 24) & 0xff;
             header[7] = (message_size >> 16) & 0xff;
             header[8] = (message_size >>  8) & 0xff;
@@ -407,28 +779,52 @@ class _RealWebSocket : public easywsclient::WebSocket
             }
         }
         // N.B. - txbuf will keep growing until it can be transmitted over the socket:
-        txbuf.insert(txbuf.end(), header.begin(), header.end());
-        txbuf.insert(txbuf.end(), message_begin, message_end);
         if (useMask) {
-            size_t message_offset = txbuf.size() - message_size;
-            for (size_t i = 0; i != message_size; ++i) {
-                txbuf[message_offset + i] ^= masking_key[i&0x3];
+            // Masking needs a copy of the payload anyway, so it is masked
+            // straight into txbuf.
+            txbuf.insert(txbuf.end(), header, header + header_size);
+            size_t message_offset = txbuf.size();
+            txbuf.resize(message_offset + message_size);
+            if (message_size) { mask_function(&txbuf[message_offset], message, message_size, masking_key); }
+            return;
+        }
+        size_t sent = 0;
+        if (txbuf.empty()) {
+            // Nothing is queued ahead of this frame, so it is sent straight
+            // from the caller's buffer. Only what the socket doesn't take
+            // right away gets copied.
+            ssize_t ret = send_frame(sockfd, header, header_size, message, message_size);
+            if (false) { }
+            else if (ret < 0 && (socketerrno == SOCKET_EWOULDBLOCK || socketerrno == SOCKET_EAGAIN_EINPROGRESS)) {
             }
+            else if (ret <= 0) {
+                closesocket(sockfd);
+                readyState = CLOSED;
+                fputs(ret < 0 ? "Connection error!\n" : "Connection closed!\n", stderr);
+                return;
+            }
+            else {
+                sent = ret;
+            }
+        }
+        if (sent < header_size) {
+            txbuf.insert(txbuf.end(), header + sent, header + header_size);
+            sent = header_size;
         }
+        txbuf.insert(txbuf.end(), message + (sent - header_size), message + message_size);
     }
 
     void close() {
         if(readyState == CLOSING || readyState == CLOSED) { return; }
         readyState = CLOSING;
         uint8_t closeFrame[6] = {0x88, 0x80, 0x00, 0x00, 0x00, 0x00}; // last 4 bytes are a masking key
-        std::vector<uint8_t> header(closeFrame, closeFrame+6);
-        txbuf.insert(txbuf.end(), header.begin(), header.end());
+        txbuf.insert(txbuf.end(), closeFrame, closeFrame+6);
     }
 
 };
 
 
-easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask, const std::string& origin) {
+easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask, const std::string& origin, const DeflateOptions* deflate) {
     char host[128];
     int port;
     char path[300];
@@ -463,6 +859,7 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
         fprintf(stderr, "Unable to connect to %s:%d\n", host, port);
         return NULL;
     }
+    DeflateParams deflateParams;
     {
         // XXX: this should be done non-blocking,
         char line[256];
@@ -482,6 +879,12 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
         }
         snprintf(line, 256, "Sec-WebSocket-Key: x3JJHMbDL1EzLkh9GBhXDw==\r\n"); ::send(sockfd, line, strlen(line), 0);
         snprintf(line, 256, "Sec-WebSocket-Version: 13\r\n"); ::send(sockfd, line, strlen(line), 0);
+        if (deflate) {
+            snprintf(line, 256, "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits%s%s\r\n",
+                deflate->serverNoContextTakeover ? "; server_no_context_takeover" : "",
+                deflate->clientNoContextTakeover ? "; client_no_context_takeover" : "");
+            ::send(sockfd, line, strlen(line), 0);
+        }
         snprintf(line, 256, "\r\n"); ::send(sockfd, line, strlen(line), 0);
         for (i = 0; i < 2 || (i < 255 && line[i-2] != '\r' && line[i-1] != '\n'); ++i) { if (recv(sockfd, line+i, 1, 0) == 0) { return NULL; } }
         line[i] = 0;
@@ -491,6 +894,13 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
         while (true) {
             for (i = 0; i < 2 || (i < 255 && line[i-2] != '\r' && line[i-1] != '\n'); ++i) { if (recv(sockfd, line+i, 1, 0) == 0) { return NULL; } }
             if (line[0] == '\r' && line[1] == '\n') { break; }
+            line[i] = 0;
+            if (deflate && strncasecmp(line, "Sec-WebSocket-Extensions:", 25) == 0) {
+                if (!parse_deflate_response(line + 25, *deflate, deflateParams)) {
+                    fprintf(stderr, "ERROR: Got unsupported extensions connecting to %s: %s", url.c_str(), line);
+                    return NULL;
+                }
+            }
         }
     }
     int flag = 1;
@@ -502,7 +912,15 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
     fcntl(sockfd, F_SETFL, O_NONBLOCK);
 #endif
     //fprintf(stderr, "Connected to: %s\n", url.c_str());
-    return easywsclient::WebSocket::pointer(new _RealWebSocket(sockfd, useMask));
+    _RealWebSocket* ws = new _RealWebSocket(sockfd, useMask, deflateParams);
+    if (ws->compressionFailed) {
+        // The server may send compressed messages, which couldn't be read.
+        fprintf(stderr, "ERROR: Could not set up compression connecting to: %s\n", url.c_str());
+        delete ws;
+        closesocket(sockfd);
+        return NULL;
+    }
+    return easywsclient::WebSocket::pointer(ws);
 }
 
 } // end of module-only namespace
@@ -511,6 +929,10 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
 
 namespace easywsclient {
 
+void setMaskFunction(MaskFunction mask) {
+    mask_function = mask ? mask : apply_mask;
+}
+
 WebSocket::pointer WebSocket::create_dummy() {
     static pointer dummy = pointer(new _DummyWebSocket);
     return dummy;
@@ -518,11 +940,15 @@ WebSocket::pointer WebSocket::create_dummy() {
 
 
 WebSocket::pointer WebSocket::from_url(const std::string& url, const std::string& origin) {
-    return ::from_url(url, true, origin);
+    return ::from_url(url, true, origin, NULL);
 }
 
 WebSocket::pointer WebSocket::from_url_no_mask(const std::string& url, const std::string& origin) {
-    return ::from_url(url, false, origin);
+    return ::from_url(url, false, origin, NULL);
+}
+
+WebSocket::pointer WebSocket::from_url_deflate(const std::string& url, const DeflateOptions& options, const std::string& origin) {
+    return ::from_url(url, true, origin, &options);
 }
 
 
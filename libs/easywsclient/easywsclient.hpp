@@ -8,6 +8,8 @@
 // wget https://raw.github.com/dhbaird/easywsclient/master/easywsclient.hpp
 // wget https://raw.github.com/dhbaird/easywsclient/master/easywsclient.cpp
 
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -15,6 +17,34 @@ namespace easywsclient {
 
 struct Callback_Imp { virtual void operator()(const std::string& message) = 0; };
 struct BytesCallback_Imp { virtual void operator()(const std::vector<uint8_t>& message) = 0; };
+struct StreamCallback_Imp {
+    virtual void onFragment(const uint8_t* data, size_t size) = 0;
+    virtual void onEnd() = 0;
+};
+
+// RFC 7692 permessage-deflate, offered in the handshake by from_url_deflate.
+// Messages are only compressed if the server accepts it.
+struct DeflateOptions {
+    // Ask the server to compress each message on its own, so it keeps no
+    // window between messages.
+    bool serverNoContextTakeover;
+    // Compress each message sent on its own, so no window is kept between
+    // them. The server may also require this.
+    bool clientNoContextTakeover;
+    // Messages shorter than this many bytes are sent uncompressed.
+    size_t threshold;
+
+    DeflateOptions() : serverNoContextTakeover(false), clientNoContextTakeover(false), threshold(1024) { }
+};
+
+// XORs n bytes of src with the 4 byte masking key, starting at its first
+// byte, into dst, which may be src.
+typedef void (*MaskFunction)(uint8_t* dst, const uint8_t* src, size_t n, const uint8_t masking_key[4]);
+
+// Replaces how payloads are masked and unmasked, e.g. with a vectorized
+// function. Should be called before any socket is created; 0 restores the
+// default.
+void setMaskFunction(MaskFunction mask);
 
 class WebSocket {
   public:
@@ -25,6 +55,7 @@ class WebSocket {
     static pointer create_dummy();
     static pointer from_url(const std::string& url, const std::string& origin = std::string());
     static pointer from_url_no_mask(const std::string& url, const std::string& origin = std::string());
+    static pointer from_url_deflate(const std::string& url, const DeflateOptions& options, const std::string& origin = std::string());
 
     // Interfaces:
     virtual ~WebSocket() { }
@@ -35,6 +66,12 @@ class WebSocket {
     virtual void sendPing() = 0;
     virtual void close() = 0;
     virtual readyStateValues getReadyState() const = 0;
+    // The underlying socket, for waiting on it in an event loop. poll(0)
+    // should be called when it is readable, or writable while
+    // bufferedAmount() isn't 0.
+    virtual intptr_t getSocket() const = 0;
+    // Number of bytes of sent messages that haven't been written yet.
+    virtual size_t bufferedAmount() const = 0;
 
     template<class Callable>
     void dispatch(Callable callable)
@@ -62,9 +99,30 @@ class WebSocket {
         _dispatchBinary(callback);
     }
 
+    template<class OnFragment, class OnEnd>
+    void dispatchStreaming(OnFragment onFragment, OnEnd onEnd)
+        // For callbacks that take message payloads piece by piece, as they
+        // arrive, instead of buffering whole messages: onFragment accepts a
+        // (const uint8_t* data, size_t size) pair and onEnd is called with
+        // no arguments once a message is complete. The data is only valid
+        // during the call. Switching between this and dispatch or
+        // dispatchBinary in the middle of a message loses data.
+    {
+        struct _Callback : public StreamCallback_Imp {
+            OnFragment& fragmentCallable;
+            OnEnd& endCallable;
+            _Callback(OnFragment& fragmentCallable, OnEnd& endCallable) : fragmentCallable(fragmentCallable), endCallable(endCallable) { }
+            void onFragment(const uint8_t* data, size_t size) { fragmentCallable(data, size); }
+            void onEnd() { endCallable(); }
+        };
+        _Callback callback(onFragment, onEnd);
+        _dispatchStreaming(callback);
+    }
+
   protected:
     virtual void _dispatch(Callback_Imp& callable) = 0;
     virtual void _dispatchBinary(BytesCallback_Imp& callable) = 0;
+    virtual void _dispatchStreaming(StreamCallback_Imp& callable) = 0;
 };
 
 } // namespace easywsclient
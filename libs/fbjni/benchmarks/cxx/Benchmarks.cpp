@@ -0,0 +1,155 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include <fbjni/NativeRunnable.h>
+#include <fbjni/fbjni.h>
+
+using namespace facebook::jni;
+
+namespace {
+
+// Each benchmark runs its body the given number of times and returns the
+// average time per iteration in nanoseconds.
+template <typename F>
+jlong measure(jint iterations, F&& body) {
+  auto start = std::chrono::steady_clock::now();
+  for (jint i = 0; i < iterations; i++) {
+    body();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return iterations > 0
+      ? std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations
+      : 0;
+}
+
+class JHybridPeer : public HybridClass<JHybridPeer> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/jni/benchmarks/FbjniBenchmarks$HybridPeer;";
+
+ private:
+  friend HybridBase;
+  JHybridPeer() {}
+};
+
+class JFbjniBenchmarks : public JavaClass<JFbjniBenchmarks> {
+ public:
+  constexpr static auto kJavaDescriptor = "Lcom/facebook/jni/benchmarks/FbjniBenchmarks;";
+
+  static void registerNatives() {
+    javaClassStatic()->registerNatives({
+      makeNativeMethod("staticMethodCall", JFbjniBenchmarks::staticMethodCall),
+      makeNativeMethod("staticMethodCallUncached", JFbjniBenchmarks::staticMethodCallUncached),
+      makeNativeMethod("instanceMethodCall", JFbjniBenchmarks::instanceMethodCall),
+      makeNativeMethod("instanceMethodCallUncached", JFbjniBenchmarks::instanceMethodCallUncached),
+      makeNativeMethod("localRefs", JFbjniBenchmarks::localRefs),
+      makeNativeMethod("globalRefs", JFbjniBenchmarks::globalRefs),
+      makeNativeMethod("weakRefs", JFbjniBenchmarks::weakRefs),
+      makeNativeMethod("stringToJava", JFbjniBenchmarks::stringToJava),
+      makeNativeMethod("stringFromJava", JFbjniBenchmarks::stringFromJava),
+      makeNativeMethod("hybridCreation", JFbjniBenchmarks::hybridCreation),
+      makeNativeMethod("exceptionTranslation", JFbjniBenchmarks::exceptionTranslation),
+      makeNativeMethod("nativeRunnable", JFbjniBenchmarks::nativeRunnable),
+      makeNativeMethod("nativeBatchRunnable", JFbjniBenchmarks::nativeBatchRunnable),
+    });
+  }
+
+  static jlong staticMethodCall(alias_ref<jclass> cls, jint iterations) {
+    static const auto method = javaClassStatic()->getStaticMethod<void()>("staticNoop");
+    return measure(iterations, [&] { method(cls); });
+  }
+
+  static jlong staticMethodCallUncached(alias_ref<jclass> cls, jint iterations) {
+    return measure(iterations, [&] {
+      javaClassStatic()->getStaticMethod<void()>("staticNoop")(cls);
+    });
+  }
+
+  static jlong instanceMethodCall(alias_ref<javaobject> self, jint iterations) {
+    static const auto method = javaClassStatic()->getMethod<void()>("instanceNoop");
+    return measure(iterations, [&] { method(self); });
+  }
+
+  static jlong instanceMethodCallUncached(alias_ref<javaobject> self, jint iterations) {
+    return measure(iterations, [&] {
+      javaClassStatic()->getMethod<void()>("instanceNoop")(self);
+    });
+  }
+
+  static jlong localRefs(alias_ref<javaobject> self, jint iterations) {
+    return measure(iterations, [&] { make_local(self); });
+  }
+
+  static jlong globalRefs(alias_ref<javaobject> self, jint iterations) {
+    return measure(iterations, [&] { make_global(self); });
+  }
+
+  static jlong weakRefs(alias_ref<javaobject> self, jint iterations) {
+    return measure(iterations, [&] { make_weak(self).lockLocal(); });
+  }
+
+  static jlong stringToJava(alias_ref<jclass>, jint iterations, jint length) {
+    auto str = std::string(length, 'x');
+    return measure(iterations, [&] { make_jstring(str); });
+  }
+
+  static jlong stringFromJava(alias_ref<jclass>, alias_ref<jstring> str, jint iterations) {
+    return measure(iterations, [&] { str->toStdString(); });
+  }
+
+  static jlong hybridCreation(alias_ref<jclass>, jint iterations) {
+    return measure(iterations, [&] { JHybridPeer::newObjectCxxArgs()->cthis(); });
+  }
+
+  static jlong exceptionTranslation(alias_ref<jclass>, jint iterations) {
+    return measure(iterations, [&] {
+      try {
+        throw std::runtime_error("benchmark");
+      } catch (...) {
+        getJavaExceptionForCppException(std::current_exception());
+      }
+    });
+  }
+
+  // A runnable per callback, run from Java the way a Handler would.
+  static jlong nativeRunnable(alias_ref<jclass>, jint iterations) {
+    static const auto method = JRunnable::javaClassStatic()->getMethod<void()>("run");
+    int runs = 0;
+    return measure(iterations, [&] {
+      auto runnable = JNativeRunnable::newObjectCxxArgs([&runs] { runs++; });
+      method(runnable);
+    });
+  }
+
+  // Callbacks queued on one runnable, which is run once batchSize of them
+  // are queued.
+  static jlong nativeBatchRunnable(alias_ref<jclass>, jint iterations, jint batchSize) {
+    static const auto method = JRunnable::javaClassStatic()->getMethod<void()>("run");
+    auto runnable = JNativeBatchRunnable::newObjectCxxArgs();
+    int runs = 0;
+    jint queued = 0;
+    auto nanos = measure(iterations, [&] {
+      runnable->cthis()->enqueue([&runs] { runs++; });
+      if (++queued % batchSize == 0) {
+        method(runnable);
+      }
+    });
+    method(runnable);
+    return nanos;
+  }
+};
+
+} // namespace
+
+jint JNI_OnLoad(JavaVM* vm, void*) {
+  return initialize(vm, [] {
+    JFbjniBenchmarks::registerNatives();
+  });
+}
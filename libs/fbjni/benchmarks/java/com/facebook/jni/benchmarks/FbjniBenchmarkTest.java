@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.jni.benchmarks;
+
+import android.support.test.InstrumentationRegistry;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+import com.facebook.soloader.SoLoader;
+import org.junit.BeforeClass;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+@RunWith(AndroidJUnit4.class)
+public class FbjniBenchmarkTest {
+  private static final String TAG = "FbjniBenchmarks";
+  private static final int ITERATIONS = 100000;
+  // Slower operations run fewer times so the suite stays quick.
+  private static final int SLOW_ITERATIONS = 1000;
+
+  private static final FbjniBenchmarks sBenchmarks = new FbjniBenchmarks();
+
+  @BeforeClass
+  public static void setUp() throws Exception {
+    SoLoader.init(InstrumentationRegistry.getTargetContext(), false);
+    // Warm up class and member lookups.
+    FbjniBenchmarks.staticMethodCall(1);
+    sBenchmarks.instanceMethodCall(1);
+  }
+
+  private static void report(String name, long nanos) {
+    Log.i(TAG, name + ": " + nanos + " ns");
+  }
+
+  @Test
+  public void methodCalls() {
+    report("static call", FbjniBenchmarks.staticMethodCall(ITERATIONS));
+    report("static call, uncached", FbjniBenchmarks.staticMethodCallUncached(ITERATIONS));
+    report("instance call", sBenchmarks.instanceMethodCall(ITERATIONS));
+    report("instance call, uncached", sBenchmarks.instanceMethodCallUncached(ITERATIONS));
+  }
+
+  @Test
+  public void references() {
+    report("local ref", sBenchmarks.localRefs(ITERATIONS));
+    report("global ref", sBenchmarks.globalRefs(ITERATIONS));
+    report("weak ref", sBenchmarks.weakRefs(ITERATIONS));
+  }
+
+  @Test
+  public void strings() {
+    for (int length : new int[] {16, 1024, 65536}) {
+      StringBuilder builder = new StringBuilder(length);
+      for (int i = 0; i < length; i++) {
+        builder.append('x');
+      }
+      String string = builder.toString();
+      int iterations = length > 1024 ? SLOW_ITERATIONS : ITERATIONS;
+      report("string to java, " + length + " chars", FbjniBenchmarks.stringToJava(iterations, length));
+      report("string from java, " + length + " chars", FbjniBenchmarks.stringFromJava(string, iterations));
+    }
+  }
+
+  @Test
+  public void hybridCreation() {
+    report("hybrid creation", FbjniBenchmarks.hybridCreation(SLOW_ITERATIONS));
+  }
+
+  @Test
+  public void runnables() {
+    report("runnable per callback", FbjniBenchmarks.nativeRunnable(SLOW_ITERATIONS));
+    for (int batchSize : new int[] {1, 16, 256}) {
+      report(
+          "batched runnable, " + batchSize + " per batch",
+          FbjniBenchmarks.nativeBatchRunnable(ITERATIONS, batchSize));
+    }
+  }
+
+  @Test
+  public void exceptionTranslation() {
+    report("exception translation", FbjniBenchmarks.exceptionTranslation(SLOW_ITERATIONS));
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.jni.benchmarks;
+
+import com.facebook.jni.HybridData;
+import com.facebook.jni.annotations.DoNotStrip;
+import com.facebook.soloader.SoLoader;
+
+/**
+ * Entry points of the native benchmarks. Each runs its operation the given number of times and
+ * returns the average time of one in nanoseconds.
+ */
+@DoNotStrip
+public class FbjniBenchmarks {
+  static {
+    SoLoader.loadLibrary("fbjnibenchmarks");
+  }
+
+  @DoNotStrip
+  public static void staticNoop() {}
+
+  @DoNotStrip
+  public void instanceNoop() {}
+
+  public static native long staticMethodCall(int iterations);
+
+  public static native long staticMethodCallUncached(int iterations);
+
+  public native long instanceMethodCall(int iterations);
+
+  public native long instanceMethodCallUncached(int iterations);
+
+  public native long localRefs(int iterations);
+
+  public native long globalRefs(int iterations);
+
+  public native long weakRefs(int iterations);
+
+  public static native long stringToJava(int iterations, int length);
+
+  public static native long stringFromJava(String string, int iterations);
+
+  public static native long hybridCreation(int iterations);
+
+  public static native long exceptionTranslation(int iterations);
+
+  public static native long nativeRunnable(int iterations);
+
+  public static native long nativeBatchRunnable(int iterations, int batchSize);
+
+  @DoNotStrip
+  static class HybridPeer {
+    @DoNotStrip private final HybridData mHybridData;
+
+    @DoNotStrip
+    private HybridPeer(HybridData hybridData) {
+      mHybridData = hybridData;
+    }
+  }
+}
@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include <fbjni/NativeRunnable.h>
+
+#include <exception>
+
+namespace facebook {
+namespace jni {
+
+JNativeBatchRunnable::~JNativeBatchRunnable() {
+  auto node = head_.exchange(nullptr);
+  while (node) {
+    auto next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+bool JNativeBatchRunnable::enqueue(std::function<void()> function) {
+  auto node = new Node{std::move(function), head_.load(std::memory_order_relaxed)};
+  while (!head_.compare_exchange_weak(
+      node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+  return !scheduled_.exchange(true, std::memory_order_acq_rel);
+}
+
+void JNativeBatchRunnable::run() {
+  std::exception_ptr error;
+  while (true) {
+    auto node = head_.exchange(nullptr, std::memory_order_acquire);
+    if (!node) {
+      scheduled_.store(false, std::memory_order_release);
+      // A function queued since the exchange found the runnable scheduled and
+      // didn't schedule it again, so it is run here unless a later one did.
+      if (!head_.load(std::memory_order_acquire) ||
+          scheduled_.exchange(true, std::memory_order_acq_rel)) {
+        break;
+      }
+      continue;
+    }
+    // The stack has the latest first.
+    Node* ordered = nullptr;
+    while (node) {
+      auto next = node->next;
+      node->next = ordered;
+      ordered = node;
+      node = next;
+    }
+    while (ordered) {
+      auto next = ordered->next;
+      try {
+        ordered->function();
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+      delete ordered;
+      ordered = next;
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace jni
+} // namespace facebook
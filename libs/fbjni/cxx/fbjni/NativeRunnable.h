@@ -9,6 +9,7 @@
 
 #include <fbjni/fbjni.h>
 
+#include <atomic>
 #include <functional>
 
 namespace facebook {
@@ -38,6 +39,57 @@ struct JNativeRunnable : public HybridClass<JNativeRunnable, JRunnable> {
   std::function<void()> runnable_;
 };
 
+/**
+ * A Runnable that runs every function queued on it since it last ran, in the
+ * order they were queued. Native code with many small callbacks for a Java
+ * thread, e.g. through a Handler, then pays for one Java object and one post
+ * per batch rather than per callback:
+ *
+ *   if (runnable->cthis()->enqueue(std::move(callback))) {
+ *     post(runnable);
+ *   }
+ *
+ * enqueue only asks for the runnable to be scheduled when it isn't already,
+ * so it is scheduled at most once until it has drained its queue. Queuing
+ * doesn't lock and is safe from any thread; run is meant for one thread at a
+ * time.
+ */
+struct JNativeBatchRunnable : public HybridClass<JNativeBatchRunnable, JRunnable> {
+ public:
+  static auto constexpr kJavaDescriptor = "Lcom/facebook/jni/NativeBatchRunnable;";
+
+  JNativeBatchRunnable() = default;
+  ~JNativeBatchRunnable() override;
+
+  static void OnLoad() {
+    registerHybrid({
+        makeNativeMethod("run", JNativeBatchRunnable::run),
+      });
+  }
+
+  /**
+   * Queues function, returns true if the caller has to schedule the runnable.
+   */
+  bool enqueue(std::function<void()> function);
+
+  /**
+   * Runs the queued functions, including ones queued meanwhile, until there
+   * are none left. If any throws, the rest still run and the first exception
+   * is rethrown afterwards.
+   */
+  void run();
+
+ private:
+  struct Node {
+    std::function<void()> function;
+    Node* next;
+  };
+
+  // Functions are pushed onto a stack, run takes the whole of it at once.
+  std::atomic<Node*> head_{nullptr};
+  std::atomic<bool> scheduled_{false};
+};
+
 
 } // namespace jni
 } // namespace facebook
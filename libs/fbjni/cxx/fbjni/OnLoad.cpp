@@ -13,7 +13,9 @@ using namespace facebook::jni;
 JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
   return facebook::jni::initialize(vm, [] {
     HybridDataOnLoad();
+    CppExceptionOnLoad();
     JNativeRunnable::OnLoad();
+    JNativeBatchRunnable::OnLoad();
     ThreadScope::OnLoad();
   });
 }
@@ -7,6 +7,9 @@
  */
 #include <fbjni/ReadableByteChannel.h>
 
+#include <mutex>
+#include <vector>
+
 namespace facebook {
 namespace jni {
 
@@ -18,5 +21,59 @@ int JReadableByteChannel::read(alias_ref<JByteBuffer> dest) const {
   return method(self(), dest);
 }
 
-}}
+constexpr size_t DirectByteBufferReader::kBufferSize;
+
+struct DirectByteBufferReader::Buffer {
+  uint8_t data[kBufferSize];
+  global_ref<JByteBuffer> buffer;
+};
+
+namespace {
+
+// About as many as threads read channels at once. Buffers beyond that are
+// freed when their reader is done.
+constexpr size_t kMaxPooledBuffers = 4;
+
+std::mutex& poolMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Leaked, so that no global reference is deleted while the process exits.
+std::vector<std::unique_ptr<DirectByteBufferReader::Buffer>>& pool() {
+  static auto pool = new std::vector<std::unique_ptr<DirectByteBufferReader::Buffer>>();
+  return *pool;
+}
+
+}
 
+DirectByteBufferReader::DirectByteBufferReader() {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex());
+    if (!pool().empty()) {
+      buffer_ = std::move(pool().back());
+      pool().pop_back();
+      return;
+    }
+  }
+  buffer_.reset(new Buffer);
+  buffer_->buffer = make_global(JByteBuffer::wrapBytes(buffer_->data, kBufferSize));
+}
+
+DirectByteBufferReader::~DirectByteBufferReader() {
+  std::lock_guard<std::mutex> lock(poolMutex());
+  if (pool().size() < kMaxPooledBuffers) {
+    pool().push_back(std::move(buffer_));
+  }
+}
+
+int DirectByteBufferReader::read(alias_ref<JReadableByteChannel> channel) {
+  buffer_->buffer->rewind();
+  return channel->read(buffer_->buffer);
+}
+
+const uint8_t* DirectByteBufferReader::data() const {
+  return buffer_->data;
+}
+
+}}
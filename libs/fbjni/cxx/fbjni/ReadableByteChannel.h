@@ -10,6 +10,9 @@
 #include <fbjni/fbjni.h>
 #include <fbjni/ByteBuffer.h>
 
+#include <cstdint>
+#include <memory>
+
 namespace facebook {
 namespace jni {
 
@@ -20,4 +23,46 @@ public:
   int read(alias_ref<JByteBuffer> dest) const;
 };
 
+// Reads channels into native memory through a direct ByteBuffer that is
+// reused for every read, so that reading doesn't allocate anything on the
+// Java heap. The buffers, and their global references, are pooled for the
+// life of the process rather than made for every reader.
+class DirectByteBufferReader {
+public:
+  static constexpr size_t kBufferSize = 16 * 1024;
+
+  DirectByteBufferReader();
+  ~DirectByteBufferReader();
+
+  DirectByteBufferReader(const DirectByteBufferReader&) = delete;
+  DirectByteBufferReader& operator=(const DirectByteBufferReader&) = delete;
+
+  // Reads once from channel into the buffer, see data(). Returns how many
+  // bytes were read, 0 or less once the channel has no more.
+  int read(alias_ref<JReadableByteChannel> channel);
+
+  // The bytes of the last read, valid until the next one.
+  const uint8_t* data() const;
+
+  // Reads until the channel has no more bytes, handing each read's bytes to
+  // sink(const uint8_t*, size_t). Returns how many were read in all.
+  template <typename Sink>
+  size_t readAll(alias_ref<JReadableByteChannel> channel, Sink&& sink) {
+    size_t total = 0;
+    for (;;) {
+      const auto count = read(channel);
+      if (count <= 0) {
+        return total;
+      }
+      sink(data(), static_cast<size_t>(count));
+      total += count;
+    }
+  }
+
+  struct Buffer;
+
+private:
+  std::unique_ptr<Buffer> buffer_;
+};
+
 }}
@@ -513,10 +513,15 @@ class PinnedCriticalAlloc {
       T** elements,
       size_t* size,
       jboolean* isCopy) {
-    const auto env = Environment::current();
-    *elements = static_cast<T*>(env->GetPrimitiveArrayCritical(array.get(), isCopy));
-    FACEBOOK_JNI_THROW_EXCEPTION_IF(!elements);
+    // The length is read first, nothing but the critical calls themselves may
+    // happen once the region is open.
     *size = array->size();
+    const auto env = detail::enterCriticalRegion();
+    *elements = static_cast<T*>(env->GetPrimitiveArrayCritical(array.get(), isCopy));
+    if (!*elements) {
+      detail::exitCriticalRegion();
+      FACEBOOK_JNI_THROW_EXCEPTION_IF(true);
+    }
   }
   static void release(
       alias_ref<typename jtype_traits<T>::array_type> array,
@@ -524,7 +529,9 @@ class PinnedCriticalAlloc {
       jint start,
       jint size,
       jint mode) {
-    const auto env = Environment::current();
+    (void) start;
+    (void) size;
+    const auto env = detail::exitCriticalRegion();
     env->ReleasePrimitiveArrayCritical(array.get(), elements, mode);
   }
 };
@@ -478,6 +478,10 @@ class JPrimitiveArray :
   /// block on other Java threads. These restrictions make it more likely that
   /// the view will be "pinned" rather than copied (for example, the VM may
   /// suspend garbage collection within a critical region).
+  ///
+  /// Debug builds enforce the first rule: any fbjni call made while the pin
+  /// is held asserts, including destroying a local_ref. Keep the region short
+  /// and release it before calling back into Java.
   PinnedPrimitiveArray<T, PinnedCriticalAlloc<T>> pinCritical();
 
 private:
@@ -486,6 +490,11 @@ private:
   void releaseElements(T* elements, jint mode);
 };
 
+/// A critical region over all elements of a primitive array, as returned by
+/// JPrimitiveArray::pinCritical().
+template <typename T>
+using CriticalArrayRegion = PinnedPrimitiveArray<T, PinnedCriticalAlloc<T>>;
+
 local_ref<jbooleanArray> make_boolean_array(jsize size);
 local_ref<jbyteArray> make_byte_array(jsize size);
 local_ref<jcharArray> make_char_array(jsize size);
@@ -8,7 +8,6 @@
 #include <fbjni/fbjni.h>
 
 #include <functional>
-#include <pthread.h>
 
 namespace facebook {
 namespace jni {
@@ -71,36 +70,28 @@ void Environment::initialize(JavaVM* vm) {
 
 namespace {
 
-pthread_key_t makeKey() {
-  pthread_key_t key;
-  int ret = pthread_key_create(&key, nullptr);
-  if (ret != 0) {
-    FBJNI_LOGF("pthread_key_create failed: %d", ret);
-  }
-  return key;
-}
+// Looked up on every fbjni call, so it is a plain thread_local rather than a
+// pthread key. It points into the JniEnvCacher or ThreadScope that set it,
+// which clear it again before they go away.
+thread_local detail::TLData* tlData = nullptr;
 
-pthread_key_t getTLKey() {
-  static pthread_key_t key = makeKey();
-  return key;
+inline detail::TLData* getTLData() {
+  return tlData;
 }
 
-inline detail::TLData* getTLData(pthread_key_t key) {
-  return reinterpret_cast<detail::TLData*>(pthread_getspecific(key));
+inline void setTLData(detail::TLData* data) {
+  tlData = data;
 }
 
-inline void setTLData(pthread_key_t key, detail::TLData* data) {
-  int ret = pthread_setspecific(key, data);
-  if (ret != 0) {
-    (void) ret;
-    FBJNI_LOGF("pthread_setspecific failed: %d", ret);
-  }
-}
+#ifndef NDEBUG
+// Critical regions currently open on this thread.
+thread_local int criticalRegions = 0;
+#endif
 
 // This returns non-nullptr iff the env was cached from java.  So it
 // can return nullptr for a thread which has been registered.
 inline JNIEnv* cachedOrNull() {
-  detail::TLData* pdata = getTLData(getTLKey());
+  detail::TLData* pdata = getTLData();
   return (pdata ? pdata->env : nullptr);
 }
 
@@ -118,10 +109,15 @@ JNIEnv* currentOrNull() {
     return nullptr;
   }
 
-  detail::TLData* pdata = getTLData(getTLKey());
+  detail::TLData* pdata = getTLData();
   if (pdata && pdata->env) {
     return pdata->env;
   }
+  // Threads attached by a ThreadScope keep their env until it detaches them,
+  // so there is no need to ask the VM for it each time.
+  if (pdata && pdata->attached) {
+    return pdata->attachedEnv;
+  }
 
   JNIEnv* env;
   if (getEnv(&env) != JNI_OK) {
@@ -132,6 +128,26 @@ JNIEnv* currentOrNull() {
   return env;
 }
 
+JNIEnv* enterCriticalRegion() {
+  FBJNI_ASSERT(g_vm);
+  JNIEnv* env = currentOrNull();
+  if (env == nullptr) {
+    throw std::runtime_error("Unable to retrieve jni environment. Is the thread attached?");
+  }
+#ifndef NDEBUG
+  ++criticalRegions;
+#endif
+  return env;
+}
+
+JNIEnv* exitCriticalRegion() {
+#ifndef NDEBUG
+  FBJNI_ASSERT(criticalRegions > 0);
+  --criticalRegions;
+#endif
+  return currentOrNull();
+}
+
 // To understand JniEnvCacher and ThreadScope, it is helpful to
 // realize that if a flagged JniEnvCacher is on the stack, then a
 // flagged ThreadScope cannot be after it.  If a flagged ThreadCacher
@@ -145,16 +161,16 @@ JniEnvCacher::JniEnvCacher(JNIEnv* env)
 {
   FBJNI_ASSERT(env);
 
-  pthread_key_t key = getTLKey();
-  detail::TLData* pdata = getTLData(key);
+  detail::TLData* pdata = getTLData();
   if (pdata && pdata->env) {
     return;
   }
 
   if (!pdata) {
     pdata = &data_;
-    setTLData(key, pdata);
+    setTLData(pdata);
     pdata->attached = false;
+    pdata->attachedEnv = nullptr;
   } else {
     FBJNI_ASSERT(!pdata->env);
   }
@@ -169,13 +185,12 @@ JniEnvCacher::~JniEnvCacher() {
     return;
   }
 
-  pthread_key_t key = getTLKey();
-  TLData* pdata = getTLData(key);
+  TLData* pdata = getTLData();
   FBJNI_ASSERT(pdata);
   FBJNI_ASSERT(pdata->env != nullptr);
   pdata->env = nullptr;
   if (!pdata->attached) {
-    setTLData(key, nullptr);
+    setTLData(nullptr);
   }
 }
 
@@ -200,13 +215,11 @@ ThreadScope::ThreadScope()
   // cached, or we would have returned already.  So there better not
   // be TLData.
 
-  pthread_key_t key = getTLKey();
-  detail::TLData* pdata = getTLData(key);
+  detail::TLData* pdata = getTLData();
   FBJNI_ASSERT(pdata == nullptr);
-  setTLData(key, &data_);
-
-  attachCurrentThread();
+  setTLData(&data_);
 
+  data_.attachedEnv = attachCurrentThread();
   data_.env = nullptr;
   data_.attached = true;
 
@@ -218,19 +231,25 @@ ThreadScope::~ThreadScope() {
     return;
   }
 
-  pthread_key_t key = getTLKey();
-  detail::TLData* pdata = getTLData(key);
+  detail::TLData* pdata = getTLData();
   FBJNI_ASSERT(pdata);
   FBJNI_ASSERT(pdata->env == nullptr);
   FBJNI_ASSERT(pdata->attached);
   FBJNI_ASSERT(g_vm);
+  // Forget the env before it becomes invalid.
+  setTLData(nullptr);
+  pdata->attached = false;
+  pdata->attachedEnv = nullptr;
   g_vm->DetachCurrentThread();
-  setTLData(key, nullptr);
 }
 
 /* static */
 JNIEnv* Environment::current() {
   FBJNI_ASSERT(g_vm);
+#ifndef NDEBUG
+  // No JNI calls are allowed while a critical region is open.
+  FBJNI_ASSERT(criticalRegions == 0);
+#endif
   JNIEnv* env = detail::currentOrNull();
   if (env == nullptr) {
     throw std::runtime_error("Unable to retrieve jni environment. Is the thread attached?");
@@ -34,6 +34,15 @@ namespace detail {
 // shouldn't be using this.
 JNIEnv* currentOrNull();
 
+/**
+ * Bracket a critical region (see JPrimitiveArray::pinCritical) on this
+ * thread, returning its env for the Get/ReleasePrimitiveArrayCritical calls.
+ * Regions may nest. In debug builds, Environment::current() asserts while
+ * one is open, which catches fbjni calls made where JNI forbids them.
+ */
+JNIEnv* enterCriticalRegion();
+JNIEnv* exitCriticalRegion();
+
 /**
  * If there's thread-local data, it's a pointer to one of these.  The
  * instance is a member of JniEnvCacher or ThreadScope, and lives on
@@ -47,6 +56,9 @@ struct TLData {
   // This is modified only by ThreadScope, and is set only if an
   // instance of ThreadScope which attached is on the stack.
   bool attached;
+  // The env of the thread that ThreadScope attached, valid while attached
+  // is set.
+  JNIEnv* attachedEnv;
 };
 
 /**
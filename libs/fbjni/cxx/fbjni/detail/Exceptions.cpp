@@ -7,6 +7,7 @@
  */
 #include "CoreClasses.h"
 #include "Log.h"
+#include "Registration.h"
 
 #ifndef FBJNI_NO_EXCEPTION_PTR
 #include <lyra/lyra.h>
@@ -14,6 +15,7 @@
 #endif
 
 #include <alloca.h>
+#include <atomic>
 #include <cstdlib>
 #include <ios>
 #include <stdexcept>
@@ -228,12 +230,54 @@ local_ref<JStackTraceElement> createJStackTraceElement(const lyra::StackTraceEle
       "|lyra|{" + cpp.libraryName() + "}", cpp.functionName(), cpp.buildId(), cpp.libraryOffset());
 }
 
+namespace {
+
+std::atomic<bool> lazyCppStackTraces{false};
+
+// Hands the raw frames to a CppException, which symbolicates them the first
+// time its trace is read.
+void setNativeFrames(
+    alias_ref<JThrowable> java,
+    const std::vector<lyra::InstructionPointer>& trace) {
+  static auto meth = JCppException::javaClassStatic()
+                         ->getMethod<void(alias_ref<jlongArray>)>("setNativeFrames");
+  auto frames = std::vector<jlong>(trace.size());
+  for (size_t i = 0; i < trace.size(); i++) {
+    frames[i] = reinterpret_cast<jlong>(trace[i]);
+  }
+  auto jframes = make_long_array(frames.size());
+  jframes->setRegion(0, frames.size(), frames.data());
+  meth(java, jframes);
+}
+
+local_ref<JThrowable::JStackTrace> symbolicateFrames(
+    alias_ref<jclass>,
+    alias_ref<jlongArray> jframes) {
+  auto size = jframes->size();
+  auto frames = jframes->getRegion(0, size);
+  auto trace = std::vector<lyra::InstructionPointer>(size);
+  for (size_t i = 0; i < size; i++) {
+    trace[i] = reinterpret_cast<lyra::InstructionPointer>(frames[i]);
+  }
+  auto cppStack = lyra::getStackTraceSymbols(trace);
+  auto stack = JThrowable::JStackTrace::newArray(cppStack.size());
+  for (size_t i = 0; i < cppStack.size(); i++) {
+    (*stack)[i] = createJStackTraceElement(cppStack[i]);
+  }
+  return stack;
+}
+
+} // namespace
+
 void addCppStacktraceToJavaException(alias_ref<JThrowable> java, std::exception_ptr cpp) {
-  auto cppStack = lyra::getStackTraceSymbols(
-                    (cpp == nullptr) ?
-                      lyra::getStackTrace()
-                      : lyra::getExceptionTrace(cpp));
+  auto trace = (cpp == nullptr) ? lyra::getStackTrace() : lyra::getExceptionTrace(cpp);
+  if (lazyCppStackTraces.load(std::memory_order_relaxed) &&
+      java->isInstanceOf(JCppException::javaClassStatic())) {
+    setNativeFrames(java, trace);
+    return;
+  }
 
+  auto cppStack = lyra::getStackTraceSymbols(trace);
   auto javaStack = java->getStackTrace();
   auto newStack = JThrowable::JStackTrace::newArray(javaStack->size() + cppStack.size());
   size_t i = 0;
@@ -280,6 +324,22 @@ local_ref<JThrowable> convertCppExceptionToJavaException(std::exception_ptr ptr)
   }
 #endif
 
+void setLazyCppStackTraces(bool enabled) {
+#ifndef FBJNI_NO_EXCEPTION_PTR
+  lazyCppStackTraces.store(enabled, std::memory_order_relaxed);
+#else
+  (void) enabled;
+#endif
+}
+
+void CppExceptionOnLoad() {
+#ifndef FBJNI_NO_EXCEPTION_PTR
+  JCppException::javaClassStatic()->registerNatives({
+      makeNativeMethod("symbolicateFrames", symbolicateFrames),
+  });
+#endif
+}
+
 local_ref<JThrowable> getJavaExceptionForCppBackTrace() {
   return getJavaExceptionForCppBackTrace(nullptr);
 }
@@ -125,6 +125,17 @@ local_ref<JThrowable> getJavaExceptionForCppBackTrace();
 
 local_ref<JThrowable> getJavaExceptionForCppBackTrace(const char* msg);
 
+/**
+ * By default the C++ frames of a translated exception are symbolicated and
+ * added to its Java stack trace right away. When lazy stack traces are
+ * enabled, exceptions translated to a CppException (or a subclass) only keep
+ * the raw addresses, and turn them into StackTraceElements the first time
+ * the trace is read from Java. Other exception types are not affected.
+ */
+void setLazyCppStackTraces(bool enabled);
+
+void CppExceptionOnLoad();
+
 // For convenience, some exception names in java.lang are available here.
 const char* const gJavaLangIllegalArgumentException = "java/lang/IllegalArgumentException";
 
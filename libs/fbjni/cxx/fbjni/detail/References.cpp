@@ -18,6 +18,9 @@ JniLocalScope::JniLocalScope(JNIEnv* env, jint capacity)
   hasFrame_ = true;
 }
 
+JniLocalScope::JniLocalScope(jint capacity)
+    : JniLocalScope(Environment::current(), capacity) {}
+
 JniLocalScope::~JniLocalScope() {
   if (hasFrame_) {
     env_->PopLocalFrame(nullptr);
@@ -551,10 +551,17 @@ class alias_ref {
  *
  * This is useful when you have a call which is initiated from C++-land, and therefore
  * doesn't automatically get a local JNI frame managed for you by the JNI framework.
+ * On a thread that C++ attached, such as with ThreadScope, nothing ever pops the
+ * outermost frame, so any local reference that isn't deleted stays alive for the
+ * lifetime of the thread. Wrapping each call into Java in a scope bounds them.
+ *
+ * local_refs created inside the scope must not outlive it.
  */
 class JniLocalScope {
 public:
   JniLocalScope(JNIEnv* p_env, jint capacity);
+  // Uses the current thread's environment.
+  explicit JniLocalScope(jint capacity);
   ~JniLocalScope();
 
 private:
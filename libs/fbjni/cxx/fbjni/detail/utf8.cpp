@@ -7,6 +7,14 @@
  */
 #include "utf8.h"
 
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "Log.h"
 
 namespace facebook {
@@ -52,14 +60,116 @@ inline bool isFourByteUTF8Encoding(const T* utf8) {
   return ((*utf8 & 0xF8) == 0xF0);
 }
 
+// Nearly all text passing through here is ASCII, which reads the same in every
+// encoding. Runs of it are found 16 (or, without SIMD, 8) bytes at a time and
+// copied in bulk, and only the characters around them take the slow path.
+
+// Length of the prefix of str made of bytes 0x01-0x7f. NUL is left out, as
+// modified UTF-8 encodes it in two bytes.
+inline size_t asciiPrefixLength(const uint8_t* str, size_t len) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    // High bit set for bytes >= 0x80 and, through the comparison, for NULs.
+    const int mask = _mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero)));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 16 <= len; i += 16) {
+    const uint8x16_t v = vld1q_u8(str + i);
+    if (vmaxvq_u8(v) >= 0x80 || vminvq_u8(v) == 0) {
+      break;
+    }
+  }
+#else
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, str + i, sizeof(w));
+    // Any byte >= 0x80, or any zero byte.
+    if (((w | ((w - 0x0101010101010101ULL) & ~w)) & 0x8080808080808080ULL) != 0) {
+      break;
+    }
+  }
+#endif
+  while (i < len && str[i] != 0 && str[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+// Length of the prefix of str made of code units below 0x80.
+inline size_t asciiPrefixLength(const uint16_t* str, size_t len) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i nonAscii = _mm_set1_epi16((short) 0xff80);
+  for (; i + 8 <= len; i += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, nonAscii), zero)) != 0xffff) {
+      break;
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 8 <= len; i += 8) {
+    if (vmaxvq_u16(vld1q_u16(str + i)) >= 0x80) {
+      break;
+    }
+  }
+#else
+  for (; i + 4 <= len; i += 4) {
+    uint64_t w;
+    memcpy(&w, str + i, sizeof(w));
+    if ((w & 0xff80ff80ff80ff80ULL) != 0) {
+      break;
+    }
+  }
+#endif
+  while (i < len && str[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+// Narrows len code units below 0x80 to bytes.
+inline void copyAscii(const uint16_t* in, size_t len, char* out) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= len; i += 16) {
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 16 <= len; i += 16) {
+    const uint8x16_t bytes =
+        vcombine_u8(vmovn_u16(vld1q_u16(in + i)), vmovn_u16(vld1q_u16(in + i + 8)));
+    vst1q_u8(reinterpret_cast<uint8_t*>(out + i), bytes);
+  }
+#endif
+  for (; i < len; i++) {
+    out[i] = (char) in[i];
+  }
+}
+
 }
 
 namespace detail {
 
 size_t modifiedLength(const std::string& str) {
   // Scan for supplementary characters
+  const auto bytes = reinterpret_cast<const uint8_t*>(str.data());
   size_t j = 0;
   for (size_t i = 0; i < str.size(); ) {
+    const size_t ascii = asciiPrefixLength(bytes + i, str.size() - i);
+    if (ascii > 0) {
+      i += ascii;
+      j += ascii;
+      continue;
+    }
     if (str[i] == 0) {
       i += 1;
       j += 2;
@@ -106,6 +216,16 @@ void utf8ToModifiedUTF8(const uint8_t* utf8, size_t len, uint8_t* modified, size
     if (j >= modifiedBufLen) {
       FBJNI_LOGF("output buffer is too short");
     }
+    const size_t ascii = asciiPrefixLength(utf8 + i, len - i);
+    if (ascii > 0) {
+      if (j + ascii > modifiedBufLen) {
+        FBJNI_LOGF("output buffer is too short");
+      }
+      memcpy(modified + j, utf8 + i, ascii);
+      i += ascii;
+      j += ascii;
+      continue;
+    }
     if (utf8[i] == 0) {
       if (j + 1 >= modifiedBufLen) {
         FBJNI_LOGF("output buffer is too short");
@@ -169,6 +289,14 @@ std::string modifiedUTF8ToUTF8(const uint8_t* modified, size_t len) noexcept {
   std::string utf8(len, 0);
   size_t j = 0;
   for (size_t i = 0; i < len; ) {
+    const size_t ascii = asciiPrefixLength(modified + i, len - i);
+    if (ascii > 0) {
+      memcpy(&utf8[j], modified + i, ascii);
+      i += ascii;
+      j += ascii;
+      continue;
+    }
+
     // surrogate pair: 1101 10xx  xxxx xxxx  1101 11xx  xxxx xxxx
     // encoded pair: 1110 1101  1010 xxxx  10xx xxxx  1110 1101  1011 xxxx  10xx xxxx
 
@@ -219,6 +347,12 @@ size_t utf16toUTF8Length(const uint16_t* utf16String, size_t utf16StringLen) {
   auto utf16StringEnd = utf16String + utf16StringLen;
   auto idx16 = utf16String;
   while (idx16 < utf16StringEnd) {
+    const size_t ascii = asciiPrefixLength(idx16, utf16StringEnd - idx16);
+    utf8StringLen += ascii;
+    idx16 += ascii;
+    if (idx16 == utf16StringEnd) {
+      break;
+    }
     auto ch = *idx16++;
     if (ch < kUtf8OneByteBoundary) {
       utf8StringLen++;
@@ -248,6 +382,13 @@ std::string utf16toUTF8(const uint16_t* utf16String, size_t utf16StringLen) noex
   auto idx16 = utf16String;
   auto utf16StringEnd = utf16String + utf16StringLen;
   while (idx16 < utf16StringEnd) {
+    const size_t ascii = asciiPrefixLength(idx16, utf16StringEnd - idx16);
+    if (ascii > 0) {
+      copyAscii(idx16, ascii, &*idx8);
+      idx8 += ascii;
+      idx16 += ascii;
+      continue;
+    }
     auto ch = *idx16++;
     if (ch < kUtf8OneByteBoundary) {
       *idx8++ = (ch & 0x7F);
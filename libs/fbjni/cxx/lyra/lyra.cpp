@@ -8,6 +8,7 @@
 #include <lyra/lyra.h>
 
 #include <atomic>
+#include <cstdint>
 #include <ios>
 #include <ostream>
 #include <iomanip>
@@ -77,6 +78,66 @@ void captureBacktrace(size_t skip, vector<InstructionPointer>& stackTrace) {
 // this is a pointer to a function
 std::atomic<LibraryIdentifierFunctionType> gLibraryIdentifierFunction{nullptr};
 
+// What dladdr found for a program counter.
+struct SymbolInfo {
+  InstructionPointer absoluteProgramCounter;
+  bool found;
+  InstructionPointer libraryBase;
+  InstructionPointer functionAddress;
+  std::string libraryName;
+  std::string functionName;
+};
+
+unique_ptr<SymbolInfo> lookupSymbol(InstructionPointer absoluteProgramCounter) {
+  auto symbol = unique_ptr<SymbolInfo>(new SymbolInfo{absoluteProgramCounter, false, nullptr, nullptr, "", ""});
+  Dl_info info;
+  if (dladdr(absoluteProgramCounter, &info)) {
+    symbol->found = true;
+    symbol->libraryBase = info.dli_fbase;
+    symbol->functionAddress = info.dli_saddr;
+    symbol->libraryName = info.dli_fname ? info.dli_fname : "";
+    symbol->functionName = info.dli_sname ? info.dli_sname : "";
+  }
+  return symbol;
+}
+
+// dladdr takes the dynamic linker's lock and searches symbol tables, and the
+// same frames show up in trace after trace, so lookups are cached by program
+// counter. The table is lock free: a slot is claimed once with a
+// compare-and-swap and its entry is never changed or freed afterwards. When
+// all the slots a program counter may use are taken, it is looked up without
+// being cached. Entries aren't invalidated when a library is unloaded.
+constexpr size_t kSymbolCacheSize = 4096;
+constexpr size_t kSymbolCacheProbes = 8;
+std::atomic<const SymbolInfo*> gSymbolCache[kSymbolCacheSize];
+
+const SymbolInfo& getSymbol(
+    InstructionPointer absoluteProgramCounter,
+    unique_ptr<SymbolInfo>& uncached) {
+  auto hash = static_cast<size_t>(
+      (reinterpret_cast<uintptr_t>(absoluteProgramCounter) >> 1) * 2654435761u);
+  for (size_t i = 0; i < kSymbolCacheProbes; ++i) {
+    auto& slot = gSymbolCache[(hash + i) & (kSymbolCacheSize - 1)];
+    auto entry = slot.load(std::memory_order_acquire);
+    if (!entry) {
+      if (!uncached) {
+        uncached = lookupSymbol(absoluteProgramCounter);
+      }
+      if (slot.compare_exchange_strong(entry, uncached.get(), std::memory_order_acq_rel)) {
+        return *uncached.release();
+      }
+      // Another thread claimed the slot first, entry now holds its value.
+    }
+    if (entry->absoluteProgramCounter == absoluteProgramCounter) {
+      return *entry;
+    }
+  }
+  if (!uncached) {
+    uncached = lookupSymbol(absoluteProgramCounter);
+  }
+  return *uncached;
+}
+
 }
 
 void setLibraryIdentifierFunction(LibraryIdentifierFunctionType func) {
@@ -108,11 +169,11 @@ void getStackTraceSymbols(vector<StackTraceElement>& symbols,
   symbols.reserve(trace.size());
 
   for (size_t i = 0; i < trace.size(); ++i) {
-    Dl_info info;
-    if (dladdr(trace[i], &info)) {
-      symbols.emplace_back(trace[i], info.dli_fbase, info.dli_saddr,
-                           info.dli_fname ? info.dli_fname : "",
-                           info.dli_sname ? info.dli_sname : "");
+    unique_ptr<SymbolInfo> uncached;
+    auto& symbol = getSymbol(trace[i], uncached);
+    if (symbol.found) {
+      symbols.emplace_back(trace[i], symbol.libraryBase, symbol.functionAddress,
+                           symbol.libraryName, symbol.functionName);
     }
   }
 }
@@ -135,6 +135,10 @@ inline std::vector<InstructionPointer> getStackTrace(
 /**
  * Symbolicates a stack trace into a given vector
  *
+ * Symbols are cached by program counter, so frames that were symbolicated
+ * before are cheap. Capturing a trace never symbolicates, so it can be done on
+ * a hot path and the trace symbolicated later, or not at all.
+ *
  * @param symbols The vector to receive the output. The vector is cleared and
  * enough room to keep the frames are reserved.
  *
@@ -8,11 +8,63 @@
 package com.facebook.jni;
 
 import com.facebook.jni.annotations.DoNotStrip;
+import java.io.PrintStream;
+import java.io.PrintWriter;
 
 @DoNotStrip
 public class CppException extends RuntimeException {
+  // Addresses of the C++ frames this was thrown from, when native code defers
+  // symbolicating them (see setLazyCppStackTraces in Exceptions.h). They are
+  // put in front of the Java frames the first time the trace is read.
+  private long[] nativeFrames;
+
   @DoNotStrip
   public CppException(String message) {
     super(message);
   }
+
+  @Override
+  public StackTraceElement[] getStackTrace() {
+    addNativeFrames();
+    return super.getStackTrace();
+  }
+
+  @Override
+  public synchronized void setStackTrace(StackTraceElement[] stackTrace) {
+    nativeFrames = null;
+    super.setStackTrace(stackTrace);
+  }
+
+  @Override
+  public void printStackTrace(PrintStream s) {
+    addNativeFrames();
+    super.printStackTrace(s);
+  }
+
+  @Override
+  public void printStackTrace(PrintWriter s) {
+    addNativeFrames();
+    super.printStackTrace(s);
+  }
+
+  @DoNotStrip
+  private synchronized void setNativeFrames(long[] frames) {
+    nativeFrames = frames;
+  }
+
+  private synchronized void addNativeFrames() {
+    long[] frames = nativeFrames;
+    if (frames == null) {
+      return;
+    }
+    nativeFrames = null;
+    StackTraceElement[] nativeTrace = symbolicateFrames(frames);
+    StackTraceElement[] javaTrace = super.getStackTrace();
+    StackTraceElement[] trace = new StackTraceElement[nativeTrace.length + javaTrace.length];
+    System.arraycopy(nativeTrace, 0, trace, 0, nativeTrace.length);
+    System.arraycopy(javaTrace, 0, trace, nativeTrace.length, javaTrace.length);
+    super.setStackTrace(trace);
+  }
+
+  private static native StackTraceElement[] symbolicateFrames(long[] frames);
 }
@@ -0,0 +1,23 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+package com.facebook.jni;
+
+import com.facebook.jni.annotations.DoNotStrip;
+
+/** A Runnable that runs a batch of functions queued natively, see JNativeBatchRunnable. */
+@DoNotStrip
+public class NativeBatchRunnable implements Runnable {
+
+  private final HybridData mHybridData;
+
+  private NativeBatchRunnable(HybridData hybridData) {
+    mHybridData = hybridData;
+  }
+
+  public native void run();
+}
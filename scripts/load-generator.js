@@ -0,0 +1,65 @@
+/**
+ * Copyright 2018-present Facebook.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ * @format
+ */
+
+// Runs src/utils/LoadGenerator.js as a headless desktop, e.g.
+//   node scripts/load-generator.js --plugin Network --method ping \
+//     --rate 500 --payload-bytes 1024 --duration 30
+// and prints a JSON report for each device once its run is over.
+
+const path = require('path');
+const Module = require('module');
+const yargs = require('yargs');
+
+const staticModules = path.join(__dirname, '..', 'static', 'node_modules');
+const srcDir = path.join(__dirname, '..', 'src');
+const babel = require(path.join(staticModules, '@babel/core'));
+const babelPlugins = [
+  'babel-plugin-transform-flow-strip-types',
+  'babel-plugin-transform-class-properties',
+  'babel-plugin-transform-object-rest-spread',
+  'babel-plugin-transform-es2015-modules-commonjs',
+].map(name => require(path.join(staticModules, name)));
+
+// The desktop's sources are Flow, stripped as they are loaded.
+const compile = Module.prototype._compile;
+Module.prototype._compile = function(content, filename) {
+  if (filename.startsWith(srcDir)) {
+    content = babel.transform(content, {
+      filename,
+      babelrc: false,
+      plugins: babelPlugins,
+    }).code;
+  }
+  return compile.call(this, content, filename);
+};
+
+const argv = yargs
+  .usage('$0 [args]')
+  .option('plugin', {describe: 'Plugin to send requests to', demand: true})
+  .option('method', {describe: 'Method to call on the plugin', demand: true})
+  .option('rate', {describe: 'Requests per second per device', default: 100})
+  .option('payload-bytes', {
+    describe: 'Payload size of each request',
+    default: 100,
+  })
+  .option('duration', {describe: 'Seconds to run for', default: 30})
+  .help().argv;
+
+const LoadGenerator = require('../src/utils/LoadGenerator.js').default;
+const generator = new LoadGenerator({
+  plugin: argv.plugin,
+  method: argv.method,
+  rate: Number(argv.rate),
+  payloadBytes: Number(argv['payload-bytes']),
+  durationSeconds: Number(argv.duration),
+});
+generator.on('report', report =>
+  // eslint-disable-next-line no-console
+  console.log(JSON.stringify(report, null, 2)),
+);
+generator.on('error', err => console.error(err));
+generator.start();
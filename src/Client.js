@@ -26,6 +26,18 @@ export type ClientQuery = {|
 
 type RequestMetadata = {method: string, id: number, params: ?Object};
 
+type Call = {promise: Promise<Object>, cancel: () => void};
+
+// Errors come back as the message of the error frame, which the client
+// fills with the JSON of its error response.
+function parseCallError(error: Error): Object {
+  try {
+    return JSON.parse(error.message);
+  } catch (err) {
+    return {message: error.message};
+  }
+}
+
 export default class Client extends EventEmitter {
   constructor(
     id: string,
@@ -41,6 +53,7 @@ export default class Client extends EventEmitter {
     this.id = id;
     this.query = query;
     this.messageIdCounter = 0;
+    this.supportsRequestResponse = true;
     this.logger = logger;
 
     this.broadcastCallbacks = new Map();
@@ -73,6 +86,9 @@ export default class Client extends EventEmitter {
   id: string;
   query: ClientQuery;
   messageIdCounter: number;
+  // Cleared once the client turns out to be too old to answer calls made as
+  // a request-response.
+  supportsRequestResponse: boolean;
   plugins: Plugins;
   connection: ReactiveSocket;
   responder: PartialResponder;
@@ -225,13 +241,74 @@ export default class Client extends EventEmitter {
   }
 
   rawCall(method: string, params?: Object): Promise<Object> {
-    return new Promise((resolve, reject) => {
-      const id = this.messageIdCounter++;
-      const metadata: RequestMetadata = {
-        method,
-        id,
-        params,
-      };
+    return this.startCall(method, params).promise;
+  }
+
+  // Calls are made as a request-response, which the client answers on the
+  // call's own stream. Clients too old for that, and calls the client can't
+  // answer that way, are made again as a message with an id, which the
+  // client answers with a message of its own.
+  startCall(method: string, params?: Object): Call {
+    const id = this.messageIdCounter++;
+    const metadata: RequestMetadata = {method, id, params};
+    this.startTimingRequestResponse(metadata);
+    if (!this.supportsRequestResponse) {
+      return this.startLegacyCall(metadata);
+    }
+
+    let settled = false;
+    let cancelRequest: ?() => void = null;
+    let fallback: ?Call = null;
+    let rejectCall: (err: Object) => void = () => {};
+    const promise = new Promise((resolve, reject) => {
+      rejectCall = reject;
+      const data = {method, params};
+      console.debug(data, 'message:call');
+      this.connection
+        .requestResponse({data: JSON.stringify(data)})
+        .subscribe({
+          onComplete: (payload: {data: string}) => {
+            settled = true;
+            this.finishTimingRequestResponse(metadata);
+            resolve(JSON.parse(payload.data));
+          },
+          onError: (error: Error) => {
+            settled = true;
+            const response = parseCallError(error);
+            const notImplemented = /not implemented/.test(response.message);
+            if (notImplemented || response.fallback) {
+              if (notImplemented) {
+                this.supportsRequestResponse = false;
+              }
+              fallback = this.startLegacyCall(metadata);
+              fallback.promise.then(resolve, reject);
+              return;
+            }
+            this.finishTimingRequestResponse(metadata);
+            reject(response);
+          },
+          onSubscribe: (cancel: () => void) => {
+            cancelRequest = cancel;
+          },
+        });
+    });
+    // Cancelling the request tells the client to abandon it, it isn't
+    // answered anymore.
+    const cancel = () => {
+      if (fallback) {
+        fallback.cancel();
+      } else if (!settled && cancelRequest) {
+        settled = true;
+        cancelRequest();
+        rejectCall({message: 'Cancelled', cancelled: true});
+      }
+    };
+    return {promise, cancel};
+  }
+
+  startLegacyCall(metadata: RequestMetadata): Call {
+    const {method, id, params} = metadata;
+    const promise = new Promise((resolve, reject) => {
       this.requestCallbacks.set(id, {reject, resolve, metadata});
 
       const data = {
@@ -241,9 +318,14 @@ export default class Client extends EventEmitter {
       };
 
       console.debug(data, 'message:call');
-      this.startTimingRequestResponse({method, id, params});
       this.connection.fireAndForget({data: JSON.stringify(data)});
     });
+    const cancel = () => {
+      if (this.requestCallbacks.has(id)) {
+        this.rawSend('cancel', {id});
+      }
+    };
+    return {promise, cancel};
   }
 
   startTimingRequestResponse(data: RequestMetadata) {
@@ -277,10 +359,52 @@ export default class Client extends EventEmitter {
     this.connection.fireAndForget({data: JSON.stringify(data)});
   }
 
+  // Fetches the bytes of a blob a plugin sent by its id instead of inlining
+  // them. They arrive in chunks, as the metadata of a stream.
+  fetchBlob(id: string): Promise<Buffer> {
+    return new Promise((resolve, reject) => {
+      const chunks = [];
+      this.connection
+        .requestStream({
+          data: JSON.stringify({method: 'getBlob', params: {id}}),
+        })
+        .subscribe({
+          onNext(payload) {
+            if (payload.metadata) {
+              chunks.push(payload.metadata);
+            }
+          },
+          onComplete() {
+            resolve(Buffer.concat(chunks));
+          },
+          onError(error) {
+            reject(error);
+          },
+          onSubscribe(subscription) {
+            subscription.request(Number.MAX_SAFE_INTEGER);
+          },
+        });
+    });
+  }
+
   call(api: string, method: string, params?: Object): Promise<Object> {
     return this.rawCall('execute', {api, method, params});
   }
 
+  // Tells the plugin to only send events of these methods, e.g. the ones
+  // the plugin's UI currently shows, so that the others aren't even built.
+  // null sends all of them again.
+  setSubscriptions(api: string, methods: ?Array<string>): void {
+    this.rawSend('setSubscriptions', {plugin: api, methods});
+  }
+
+  // Like call, but the request can be cancelled once its result isn't
+  // needed anymore, e.g. because a newer one superseded it. It is then
+  // rejected with {cancelled: true}, and its receiver may abandon the work.
+  callCancellable(api: string, method: string, params?: Object): Call {
+    return this.startCall('execute', {api, method, params});
+  }
+
   send(api: string, method: string, params?: Object): void {
     return this.rawSend('execute', {api, method, params});
   }
@@ -82,7 +82,8 @@ export default class AndroidDevice extends BaseDevice {
     if (this.deviceType === 'physical') {
       return this.adb
         .reverse(this.serial, 'tcp:8088', 'tcp:8088')
-        .then(_ => this.adb.reverse(this.serial, 'tcp:8089', 'tcp:8089'));
+        .then(_ => this.adb.reverse(this.serial, 'tcp:8089', 'tcp:8089'))
+        .then(_ => this.adb.reverse(this.serial, 'tcp:8090', 'tcp:8090'));
     } else {
       return Promise.resolve();
     }
@@ -0,0 +1,151 @@
+/**
+ * Copyright 2018-present Facebook.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ * @format
+ */
+
+import {ManagedTable, Panel, FlexColumn} from 'sonar';
+import {SonarPlugin} from 'sonar';
+
+// What the client's Diagnostics plugin reports for each initialized plugin,
+// see SonarConnectionStats.
+type PluginMetrics = {|
+  messagesIn: number,
+  bytesIn: number,
+  messagesOut: number,
+  bytesOut: number,
+  responses: number,
+  errors: number,
+  queueDepth: number,
+  maxQueueDepth: number,
+  // Counts per bucket, the last bucket is everything above the last bound.
+  receiverLatency: Array<number>,
+  responseLatency: Array<number>,
+  latencyBucketsMicros: Array<number>,
+  suppressed: {[method: string]: number},
+  dropped: number,
+|};
+
+type DiagnosticsState = {|
+  plugins: {[id: string]: PluginMetrics},
+|};
+
+const POLL_INTERVAL_MS = 1000;
+
+const COLUMNS = {
+  plugin: {value: 'Plugin'},
+  received: {value: 'Received'},
+  sent: {value: 'Sent'},
+  responses: {value: 'Responses'},
+  receiverP50: {value: 'Receiver p50'},
+  responseP99: {value: 'Response p99'},
+  queue: {value: 'Queue'},
+  dropped: {value: 'Dropped'},
+};
+
+// Upper bound of the bucket the given share of the samples falls in.
+function percentile(
+  counts: Array<number>,
+  bounds: Array<number>,
+  p: number,
+): string {
+  const total = counts.reduce((sum, count) => sum + count, 0);
+  if (total === 0) {
+    return '-';
+  }
+  let seen = 0;
+  for (let i = 0; i < counts.length; i++) {
+    seen += counts[i];
+    if (seen >= total * p) {
+      return i < bounds.length
+        ? `< ${bounds[i] / 1000} ms`
+        : `> ${bounds[bounds.length - 1] / 1000} ms`;
+    }
+  }
+  return '-';
+}
+
+function traffic(messages: number, bytes: number): string {
+  return bytes > 0 ? `${messages} (${bytes} B)` : String(messages);
+}
+
+export default class extends SonarPlugin<DiagnosticsState> {
+  static title = 'Diagnostics';
+  static id = 'Diagnostics';
+  static icon = 'bug';
+
+  state = {
+    plugins: {},
+  };
+
+  timer: ?IntervalID;
+
+  reducers = {
+    UpdateMetrics(state: DiagnosticsState, results: Object) {
+      return {plugins: results.plugins};
+    },
+  };
+
+  init() {
+    this.refresh();
+    this.timer = setInterval(this.refresh, POLL_INTERVAL_MS);
+  }
+
+  teardown() {
+    if (this.timer) {
+      clearInterval(this.timer);
+      this.timer = null;
+    }
+  }
+
+  refresh = () => {
+    this.client.call('getMetrics', {}).then((results: Object) => {
+      this.dispatchAction({plugins: results.plugins, type: 'UpdateMetrics'});
+    });
+  };
+
+  render() {
+    const rows = Object.keys(this.state.plugins).map(id => {
+      const metrics = this.state.plugins[id];
+      const suppressed = Object.keys(metrics.suppressed).reduce(
+        (sum, method) => sum + metrics.suppressed[method],
+        0,
+      );
+      return {
+        columns: {
+          plugin: {value: id},
+          received: {value: traffic(metrics.messagesIn, metrics.bytesIn)},
+          sent: {value: traffic(metrics.messagesOut, metrics.bytesOut)},
+          responses: {value: `${metrics.responses} (${metrics.errors} errors)`},
+          receiverP50: {
+            value: percentile(
+              metrics.receiverLatency,
+              metrics.latencyBucketsMicros,
+              0.5,
+            ),
+          },
+          responseP99: {
+            value: percentile(
+              metrics.responseLatency,
+              metrics.latencyBucketsMicros,
+              0.99,
+            ),
+          },
+          queue: {
+            value: `${metrics.queueDepth} (max ${metrics.maxQueueDepth})`,
+          },
+          dropped: {value: String(metrics.dropped + suppressed)},
+        },
+        key: id,
+      };
+    });
+    return (
+      <FlexColumn fill={true}>
+        <Panel heading="Plugin traffic" floating={false}>
+          <ManagedTable columns={COLUMNS} rows={rows} />
+        </Panel>
+      </FlexColumn>
+    );
+  }
+}
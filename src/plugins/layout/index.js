@@ -90,6 +90,41 @@ type GetNodesResult = {|
   elements: Array<Element>,
 |};
 
+type GetChildrenResult = {|
+  id: ElementID,
+  offset: number,
+  childCount: number,
+  children: Array<ElementID>,
+|};
+
+// Nodes with more children than they list end with a placeholder child under
+// this key, selecting it loads the next page of children.
+const CHILD_PAGE_SIZE = 200;
+const MORE_CHILDREN_SUFFIX = '#more';
+const moreChildrenKey = (id: ElementID): ElementID =>
+  id + MORE_CHILDREN_SUFFIX;
+const isMoreChildrenKey = (id: ElementID): boolean =>
+  id.endsWith(MORE_CHILDREN_SUFFIX);
+
+// Sent by clients that diff invalidated nodes against what they sent before,
+// only the fields that changed are present. Removed data sections are null.
+type ElementChanges = {|
+  name?: string,
+  decoration?: string,
+  attributes?: $PropertyType<Element, 'attributes'>,
+  data?: {[section: string]: ?Object},
+  childrenSplice?: {|
+    start: number,
+    deleteCount: number,
+    items: Array<ElementID>,
+  |},
+|};
+
+type InvalidatedNode = {|
+  id: ElementID,
+  changes?: ElementChanges,
+|};
+
 type GetNodesOptions = {|
   force: boolean,
   ax: boolean,
@@ -267,10 +302,35 @@ export default class Layout extends SonarPlugin<InspectorState> {
 
       for (const element of elements) {
         const current = updatedElements[element.id] || {};
-        updatedElements[element.id] = {
+        const updated = {
           ...current,
           ...element,
         };
+        if (element.children) {
+          if (element.childCount == null) {
+            delete updated.childCount;
+          }
+          const moreKey = moreChildrenKey(element.id);
+          const children = element.children.filter(id => id !== moreKey);
+          const remaining = (updated.childCount || 0) - children.length;
+          if (remaining > 0) {
+            updatedElements[moreKey] = {
+              id: moreKey,
+              name: `${remaining} more children`,
+              expanded: false,
+              children: [],
+              attributes: [],
+              data: {},
+              decoration: '',
+              extraInfo: {},
+            };
+            children.push(moreKey);
+          } else {
+            delete updatedElements[moreKey];
+          }
+          updated.children = children;
+        }
+        updatedElements[element.id] = updated;
         const linked = element.extraInfo && element.extraInfo.linkedAXNode;
         if (linked && !updatedMapping[linked]) {
           updatedMapping[linked] = element.id;
@@ -596,12 +656,35 @@ export default class Layout extends SonarPlugin<InspectorState> {
 
     this.client.subscribe(
       'invalidate',
-      ({nodes}: {nodes: Array<{id: ElementID}>}) => {
-        this.invalidate(nodes.map(node => node.id), false).then(
-          (elements: Array<Element>) => {
+      ({nodes}: {nodes: Array<InvalidatedNode>}) => {
+        const updates = [];
+        const refetch = [];
+        const added = [];
+        for (const node of nodes) {
+          const current = this.state.elements[node.id];
+          if (!node.changes || !current) {
+            refetch.push(node.id);
+            continue;
+          }
+          const update = this.applyChanges(current, node.changes);
+          updates.push(update);
+          if (current.expanded && node.changes.childrenSplice) {
+            added.push(...node.changes.childrenSplice.items);
+          }
+        }
+        if (updates.length > 0) {
+          this.dispatchAction({elements: updates, type: 'UpdateElements'});
+        }
+        Promise.all([
+          this.invalidate(refetch, false),
+          // New children of expanded nodes are shown right away.
+          this.getNodes(added, {force: false, ax: false}),
+        ]).then(([invalidated, children]) => {
+          const elements = invalidated.concat(children);
+          if (elements.length > 0) {
             this.dispatchAction({elements, type: 'UpdateElements'});
-          },
-        );
+          }
+        });
       },
     );
 
@@ -615,6 +698,37 @@ export default class Layout extends SonarPlugin<InspectorState> {
     }
   }
 
+  applyChanges(current: Element, changes: ElementChanges): $Shape<Element> {
+    const update: $Shape<Element> = {id: current.id};
+    if (changes.name != null) {
+      update.name = changes.name;
+    }
+    if (changes.decoration != null) {
+      update.decoration = changes.decoration;
+    }
+    if (changes.attributes != null) {
+      update.attributes = changes.attributes;
+    }
+    if (changes.data != null) {
+      const data = {...current.data};
+      for (const section of Object.keys(changes.data)) {
+        if (changes.data[section] == null) {
+          delete data[section];
+        } else {
+          data[section] = changes.data[section];
+        }
+      }
+      update.data = data;
+    }
+    if (changes.childrenSplice != null) {
+      const {start, deleteCount, items} = changes.childrenSplice;
+      const children = current.children.slice();
+      children.splice(start, deleteCount, ...items);
+      update.children = children;
+    }
+    return update;
+  }
+
   invalidate(ids: Array<ElementID>, ax: boolean): Promise<Array<Element>> {
     if (ids.length === 0) {
       return Promise.resolve([]);
@@ -673,6 +787,7 @@ export default class Layout extends SonarPlugin<InspectorState> {
     options: GetNodesOptions,
   ): Promise<Array<Element>> {
     const {force, ax, forFocusEvent} = options;
+    ids = ids.filter(id => !isMoreChildrenKey(id));
     if (!force) {
       const elems = ax ? this.state.AXelements : this.state.elements;
       // always force undefined elements and elements that need to be expanded
@@ -707,6 +822,27 @@ export default class Layout extends SonarPlugin<InspectorState> {
     }
   }
 
+  loadMoreChildren(id: ElementID) {
+    const element = this.state.elements[id];
+    if (!element) {
+      return;
+    }
+    const moreKey = moreChildrenKey(id);
+    const loaded = element.children.filter(child => child !== moreKey);
+    this.client
+      .call('getChildren', {id, offset: loaded.length, count: CHILD_PAGE_SIZE})
+      .then(({childCount, children}: GetChildrenResult) => {
+        this.dispatchAction({
+          elements: [{id, childCount, children: loaded.concat(children)}],
+          type: 'UpdateElements',
+        });
+        return this.getNodes(children, {force: false, ax: false});
+      })
+      .then((elements: Array<Element>) => {
+        this.dispatchAction({elements, type: 'UpdateElements'});
+      });
+  }
+
   isExpanded(key: ElementID, ax: boolean): boolean {
     return ax
       ? this.state.AXelements[key].expanded
@@ -864,6 +1000,12 @@ export default class Layout extends SonarPlugin<InspectorState> {
   }
 
   onElementSelected = debounce((selectedKey: ElementID) => {
+    if (isMoreChildrenKey(selectedKey)) {
+      this.loadMoreChildren(
+        selectedKey.slice(0, -MORE_CHILDREN_SUFFIX.length),
+      );
+      return;
+    }
     const {key, AXkey} = this.getKeysFromSelected(selectedKey);
     this.dispatchAction({key, AXkey, type: 'SelectElement'});
 
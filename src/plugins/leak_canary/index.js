@@ -21,15 +21,21 @@ import type {ElementID, Element} from 'sonar';
 import {processLeaks} from './processLeakString';
 
 type State = {
-  leaks: Leak[],
+  leaks: LeakSummary[],
+  // Parsed traces, by leak id, of the leaks whose trace was fetched.
+  traces: {[id: number]: ?Leak},
   selectedIdx: ?number,
   selectedEid: ?string,
   showFullClassPaths: boolean,
-  leaksCount: number,
 };
 
-type LeakReport = {
-  leaks: string[],
+// Sent as each leak is found, and again with a higher count each time it is
+// found again. The trace is only fetched on demand, it can be large.
+type LeakSummary = {
+  id: number,
+  title: string,
+  retainedSize: string,
+  count: number,
 };
 
 export type Leak = {
@@ -58,41 +64,45 @@ export default class LeakCanary extends SonarPlugin<State> {
   static icon = 'bird';
   state = {
     leaks: [],
+    traces: {},
     selectedIdx: null,
     selectedEid: null,
     showFullClassPaths: false,
-    leaksCount: 0,
   };
 
   init() {
-    this.client.subscribe('reportLeak', (results: LeakReport) => {
-      // We only process new leaks instead of replacing the whole list in order
-      // to both avoid redundant processing and to preserve the expanded/
-      // collapsed state of the tree view
-      const newLeaks = processLeaks(results.leaks.slice(this.state.leaksCount));
-
-      let leaks = this.state.leaks;
-      for (let i = 0; i < newLeaks.length; i++) {
-        leaks.push(newLeaks[i]);
+    this.client.subscribe('leak', (summary: LeakSummary) => {
+      const leaks = this.state.leaks.slice();
+      const idx = leaks.findIndex(leak => leak.id === summary.id);
+      if (idx === -1) {
+        leaks.push(summary);
+      } else {
+        leaks[idx] = summary;
       }
-
-      this.setState({
-        leaks: leaks,
-        leaksCount: results.leaks.length,
-      });
+      this.setState({leaks});
     });
   }
 
   _clearLeaks = () => {
     this.setState({
       leaks: [],
-      leaksCount: 0,
+      traces: {},
       selectedIdx: null,
       selectedEid: null,
     });
     this.client.send('clear');
   };
 
+  _loadTrace = (id: number) => {
+    this.client.call('getLeak', {id}).then(({info}: {info: string}) => {
+      // Parsed once, so that the tree keeps its expanded/collapsed state.
+      const parsed = processLeaks([info]);
+      this.setState({
+        traces: {...this.state.traces, [id]: parsed.length ? parsed[0] : null},
+      });
+    });
+  };
+
   _selectElement = (leakIdx: number, eid: string) => {
     this.setState({
       selectedIdx: leakIdx,
@@ -101,17 +111,19 @@ export default class LeakCanary extends SonarPlugin<State> {
   };
 
   _toggleElement = (leakIdx: number, eid: string) => {
-    const leaks = this.state.leaks;
-    const leak = leaks[leakIdx];
+    const trace = this.state.traces[this.state.leaks[leakIdx].id];
+    if (!trace) {
+      return;
+    }
 
-    const element = leak.elements[eid];
+    const element = trace.elements[eid];
     element.expanded = !element.expanded;
 
-    const elementSimple = leak.elementsSimple[eid];
+    const elementSimple = trace.elementsSimple[eid];
     elementSimple.expanded = !elementSimple.expanded;
 
     this.setState({
-      leaks: leaks,
+      traces: {...this.state.traces},
     });
   };
 
@@ -134,13 +146,16 @@ export default class LeakCanary extends SonarPlugin<State> {
   }
 
   renderSidebar() {
-    const {selectedIdx, selectedEid, leaks} = this.state;
+    const {selectedIdx, selectedEid, leaks, traces} = this.state;
 
     if (selectedIdx == null || selectedEid == null) {
       return null;
     }
 
-    const leak = leaks[selectedIdx];
+    const leak = traces[leaks[selectedIdx].id];
+    if (!leak) {
+      return null;
+    }
     const staticFields = leak.staticFields[selectedEid];
     const instanceFields = leak.instanceFields[selectedEid];
 
@@ -172,18 +187,42 @@ export default class LeakCanary extends SonarPlugin<State> {
       <Window>
         <FlexColumn fill={true}>
           <FlexColumn fill={true} scrollable={true}>
-            {this.state.leaks.map((leak: Leak, idx: number) => {
+            {this.state.leaks.map((summary: LeakSummary, idx: number) => {
+              const heading =
+                summary.count > 1
+                  ? `${summary.title} (${summary.count}x)`
+                  : summary.title;
+              const leak = this.state.traces[summary.id];
+              if (!leak) {
+                return (
+                  <Panel
+                    key={summary.id}
+                    collapsable={false}
+                    heading={heading}
+                    floating={false}
+                    accessory={summary.retainedSize}>
+                    {summary.id in this.state.traces ? (
+                      'The trace could not be parsed.'
+                    ) : (
+                      <Button onClick={() => this._loadTrace(summary.id)}>
+                        Show trace
+                      </Button>
+                    )}
+                  </Panel>
+                );
+              }
               const elements = showFullClassPaths
                 ? leak.elements
                 : leak.elementsSimple;
               const selected = selectedIdx == idx ? selectedEid : null;
               return (
                 <Panel
+                  key={summary.id}
                   collapsable={false}
                   padded={false}
-                  heading={leak.title}
+                  heading={heading}
                   floating={false}
-                  accessory={leak.retainedSize}>
+                  accessory={summary.retainedSize}>
                   <ElementsInspector
                     onElementSelected={eid => {
                       this._selectElement(idx, eid);
@@ -55,6 +55,22 @@ export type Header = {|
   value: string,
 |};
 
+// Sent instead of headers once enableHeaderTable has been called: names and
+// values alternate, each an index into the table or the string itself.
+type HeaderTableEvent = {
+  headers: Array<number | string>,
+  headerTable: {|
+    generation: number,
+    first: number,
+    strings: Array<string>,
+  |},
+};
+
+type HeaderTable = {|
+  generation: number,
+  strings: Array<string>,
+|};
+
 const COLUMN_SIZE = {
   domain: 'flex',
   method: 100,
@@ -124,12 +140,15 @@ export default class extends SonarPlugin<State, *, PersistedState> {
     selectedIds: [],
   };
 
+  headerTable: HeaderTable = {generation: 0, strings: []};
+  enablingHeaderTable = false;
+
   init() {
     this.client.subscribe('newRequest', (request: Request) => {
       this.props.setPersistedState({
         requests: {
           ...this.props.persistedState.requests,
-          [request.id]: request,
+          [request.id]: this.decodeHeaders(request),
         },
       });
     });
@@ -137,10 +156,56 @@ export default class extends SonarPlugin<State, *, PersistedState> {
       this.props.setPersistedState({
         responses: {
           ...this.props.persistedState.responses,
-          [response.id]: response,
+          [response.id]: this.decodeHeaders(response),
         },
       });
     });
+    this.enableHeaderTable();
+  }
+
+  enableHeaderTable() {
+    if (this.enablingHeaderTable) {
+      return;
+    }
+    this.enablingHeaderTable = true;
+    this.client
+      .call('enableHeaderTable')
+      // Older clients only send plain headers.
+      .catch(() => {})
+      .then(() => {
+        this.enablingHeaderTable = false;
+      });
+  }
+
+  decodeHeaders<T: Object>(event: T): T {
+    if (event.headerTable == null) {
+      return event;
+    }
+    const {headers, headerTable, ...rest}: HeaderTableEvent = event;
+    const table = this.headerTable;
+    const {generation, first, strings} = headerTable;
+    if (generation !== table.generation && first === 0) {
+      this.headerTable = {generation, strings: strings.slice()};
+    } else if (
+      generation === table.generation &&
+      first === table.strings.length
+    ) {
+      table.strings.push(...strings);
+    } else {
+      // An event was missed, start over with a new table.
+      this.enableHeaderTable();
+    }
+    const lookup = (entry: number | string): string =>
+      typeof entry === 'string'
+        ? entry
+        : generation === this.headerTable.generation
+          ? this.headerTable.strings[entry] || ''
+          : '';
+    const decoded: Array<Header> = [];
+    for (let i = 0; i + 1 < headers.length; i += 2) {
+      decoded.push({key: lookup(headers[i]), value: lookup(headers[i + 1])});
+    }
+    return {...rest, headers: decoded};
   }
 
   onRowHighlighted = (selectedIds: Array<RequestId>) =>
@@ -15,6 +15,13 @@ type SharedPreferencesChangeEvent = {|
   time: number,
   deleted: boolean,
   value: string,
+  // Not sent by older clients.
+  version?: number,
+|};
+
+type SharedPreferencesSnapshot = {|
+  version: number,
+  preferences: SharedPreferences,
 |};
 
 export type SharedPreferences = {
@@ -24,6 +31,8 @@ export type SharedPreferences = {
 type SharedPreferencesState = {|
   sharedPreferences: ?SharedPreferences,
   changesList: Array<SharedPreferencesChangeEvent>,
+  // The version of the last change applied, null for clients without versions.
+  version: ?number,
 |};
 
 const CHANGELOG_COLUMNS = {
@@ -54,6 +63,7 @@ export default class extends SonarPlugin<SharedPreferencesState> {
   state = {
     changesList: [],
     sharedPreferences: null,
+    version: null,
   };
 
   reducers = {
@@ -61,10 +71,20 @@ export default class extends SonarPlugin<SharedPreferencesState> {
       return {
         changesList: state.changesList,
         sharedPreferences: results.results,
+        version: results.version != null ? results.version : state.version,
       };
     },
 
     ChangeSharedPreferences(state: SharedPreferencesState, event: Object) {
+      const {version} = event.change;
+      if (
+        version != null &&
+        state.version != null &&
+        version <= state.version
+      ) {
+        // Already part of the snapshot.
+        return state;
+      }
       const sharedPreferences = {...(state.sharedPreferences || {})};
       if (event.change.deleted) {
         delete sharedPreferences[event.change.name];
@@ -74,21 +94,26 @@ export default class extends SonarPlugin<SharedPreferencesState> {
       return {
         changesList: [event.change, ...state.changesList],
         sharedPreferences,
+        version: version != null ? version : state.version,
       };
     },
   };
 
   init() {
-    this.client
-      .call('getSharedPreferences')
-      .then((results: SharedPreferences) => {
-        this.dispatchAction({results, type: 'UpdateSharedPreferences'});
-      });
+    this.fetchSnapshot();
 
     this.client.subscribe(
       'sharedPreferencesChange',
       (change: SharedPreferencesChangeEvent) => {
+        const {version} = this.state;
+        const missedChanges =
+          change.version != null &&
+          version != null &&
+          change.version > version + 1;
         this.dispatchAction({change, type: 'ChangeSharedPreferences'});
+        if (missedChanges) {
+          this.fetchSnapshot();
+        }
       },
     );
     this.client.subscribe(
@@ -99,6 +124,32 @@ export default class extends SonarPlugin<SharedPreferencesState> {
     );
   }
 
+  // Whether the client sends versioned snapshots and changes, and leaves edits
+  // to be sent as changes.
+  incremental = false;
+
+  fetchSnapshot() {
+    this.client
+      .call('getSharedPreferencesSnapshot')
+      .then(
+        ({version, preferences}: SharedPreferencesSnapshot) => {
+          this.incremental = true;
+          this.dispatchAction({
+            results: preferences,
+            version,
+            type: 'UpdateSharedPreferences',
+          });
+        },
+        // Older clients only send the whole file.
+        () =>
+          this.client
+            .call('getSharedPreferences')
+            .then((results: SharedPreferences) => {
+              this.dispatchAction({results, type: 'UpdateSharedPreferences'});
+            }),
+      );
+  }
+
   onSharedPreferencesChanged = (path: Array<string>, value: any) => {
     const values = this.state.sharedPreferences;
 
@@ -111,9 +162,12 @@ export default class extends SonarPlugin<SharedPreferencesState> {
       .call('setSharedPreference', {
         preferenceName: path[0],
         preferenceValue: newValue,
+        incremental: this.incremental,
       })
       .then((results: SharedPreferences) => {
-        this.dispatchAction({results, type: 'UpdateSharedPreferences'});
+        if (!this.incremental) {
+          this.dispatchAction({results, type: 'UpdateSharedPreferences'});
+        }
       });
   };
 
@@ -10,9 +10,15 @@ import type Logger from './fb-stubs/Logger';
 import type {ClientQuery} from './Client.js';
 
 import CertificateProvider from './utils/CertificateProvider';
-import {RSocketServer, ReactiveSocket} from 'rsocket-core';
+import {
+  BufferEncoder,
+  RSocketServer,
+  ReactiveSocket,
+  Utf8Encoders,
+} from 'rsocket-core';
 import RSocketTCPServer from 'rsocket-tcp-server';
-import {Single} from 'rsocket-flowable';
+import {Flowable, Single} from 'rsocket-flowable';
+import WebSocket from 'ws';
 import Client from './Client.js';
 import {RecurringError} from './utils/errors';
 
@@ -20,12 +26,21 @@ const EventEmitter = (require('events'): any);
 const invariant = require('invariant');
 const tls = require('tls');
 const net = require('net');
+const url = require('url');
 
 const SECURE_PORT = 8088;
 const INSECURE_PORT = 8089;
+// Plain WebSocket connections of clients built with SONAR_EASYWSCLIENT, see
+// xplat/Sonar/SonarEasyWebSocket.h.
+const WEBSOCKET_PORT = 8090;
+
+// Messages are JSON strings. Metadata is only used by chunks of blobs, which
+// the client sends as raw bytes.
+const ENCODERS = {...Utf8Encoders, metadata: BufferEncoder};
 
 type RSocket = {|
   fireAndForget(payload: {data: string}): void,
+  requestStream(payload: {data: string}): any,
   connectionStatus(): any,
   close(): void,
 |};
@@ -39,6 +54,7 @@ export default class Server extends EventEmitter {
   connections: Map<string, ClientInfo>;
   secureServer: RSocketServer;
   insecureServer: RSocketServer;
+  webSocketServer: ?WebSocket.Server;
   certificateProvider: CertificateProvider;
   connectionTracker: ConnectionTracker;
   logger: Logger;
@@ -71,6 +87,7 @@ export default class Server extends EventEmitter {
         options => (this.secureServer = this.startServer(SECURE_PORT, options)),
       );
     this.insecureServer = this.startServer(INSECURE_PORT);
+    this.webSocketServer = this.startWebSocketServer(WEBSOCKET_PORT);
   }
 
   startServer(port: number, sslConfig?: SecureServerConfig) {
@@ -100,16 +117,63 @@ export default class Server extends EventEmitter {
       getRequestHandler: sslConfig
         ? this._trustedRequestHandler
         : this._untrustedRequestHandler,
-      transport: new RSocketTCPServer({
-        port: port,
-        serverFactory: serverFactory,
-      }),
+      transport: new RSocketTCPServer(
+        {
+          port: port,
+          serverFactory: serverFactory,
+        },
+        ENCODERS,
+      ),
     });
 
     rsServer.start();
     return rsServer;
   }
 
+  startWebSocketServer(port: number): WebSocket.Server {
+    // Nothing is encrypted, so only clients on this machine can connect:
+    // simulators, emulators and devices through adb reverse.
+    const webSocketServer = new WebSocket.Server({
+      host: 'localhost',
+      port,
+      path: '/sonar',
+    });
+    webSocketServer
+      .on('error', err => {
+        this.emit('error', err);
+        console.error(`Error opening server on port ${port}`, 'server');
+      })
+      .on('listening', () => {
+        console.debug(`WebSocket server started on port ${port}`, 'server');
+      })
+      .on('connection', this._onWebSocketConnection);
+    return webSocketServer;
+  }
+
+  _onWebSocketConnection = (socket: WebSocket, request: {url: string}) => {
+    // The client sends what RSocket's setup payload holds in the query.
+    const {query} = url.parse(request.url, true);
+    const clientData: ClientQuery = {
+      app: String(query.app),
+      os: String(query.os),
+      device: String(query.device),
+      device_id: query.device_id != null ? String(query.device_id) : null,
+    };
+    this.connectionTracker.logConnectionAttempt(clientData);
+
+    const client = this.addConnection(
+      (new WebSocketConnection(socket): any),
+      clientData,
+    );
+    socket.on('message', data => {
+      client.responder.fireAndForget({data: String(data)});
+    });
+    socket.on('close', () => {
+      console.debug(`Device disconnected ${client.id}`, 'connection');
+      this.removeConnection(client.id);
+    });
+  };
+
   _trustedRequestHandler = (conn: RSocket, connectRequest: {data: string}) => {
     const server = this;
 
@@ -232,6 +296,9 @@ export default class Server extends EventEmitter {
   close() {
     this.secureServer.stop();
     this.insecureServer.stop();
+    if (this.webSocketServer) {
+      this.webSocketServer.close();
+    }
   }
 
   toJSON() {
@@ -298,6 +365,53 @@ export default class Server extends EventEmitter {
   }
 }
 
+/**
+ * Makes a plain WebSocket look like the RSocket connections Client expects.
+ * It only carries messages: calls are answered "not implemented", which makes
+ * Client fall back to sending them with ids, and blobs can't be fetched.
+ */
+class WebSocketConnection {
+  socket: WebSocket;
+
+  constructor(socket: WebSocket) {
+    this.socket = socket;
+  }
+
+  fireAndForget(payload: {data: string}) {
+    if (this.socket.readyState === WebSocket.OPEN) {
+      this.socket.send(payload.data);
+    }
+  }
+
+  requestResponse(payload: {data: string}) {
+    return new Single(subscriber => {
+      subscriber.onSubscribe();
+      subscriber.onError(new Error('not implemented'));
+    });
+  }
+
+  requestStream(payload: {data: string}) {
+    return new Flowable(subscriber => {
+      subscriber.onSubscribe({cancel: () => {}, request: () => {}});
+      subscriber.onError(new Error('not implemented'));
+    });
+  }
+
+  connectionStatus() {
+    return new Flowable(subscriber => {
+      subscriber.onSubscribe({cancel: () => {}, request: () => {}});
+      this.socket.on('close', () => subscriber.onNext({kind: 'CLOSED'}));
+      this.socket.on('error', error =>
+        subscriber.onNext({kind: 'ERROR', error}),
+      );
+    });
+  }
+
+  close() {
+    this.socket.close();
+  }
+}
+
 class ConnectionTracker {
   timeWindowMillis = 20 * 1000;
   connectionProblemThreshold = 4;
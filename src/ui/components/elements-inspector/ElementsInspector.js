@@ -45,6 +45,8 @@ export type Element = {|
   name: string,
   expanded: boolean,
   children: Array<ElementID>,
+  // Set when children only lists the first ones, how many there are in all.
+  childCount?: number,
   attributes: Array<ElementAttribute>,
   data: ElementData,
   decoration: string,
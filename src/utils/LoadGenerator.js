@@ -0,0 +1,279 @@
+/**
+ * Copyright 2018-present Facebook.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ * @format
+ */
+
+import type {SecureServerConfig} from './CertificateProvider';
+import type {ClientQuery} from '../Client.js';
+
+import CertificateProvider from './CertificateProvider';
+import Logger from '../fb-stubs/Logger';
+import {RSocketServer} from 'rsocket-core';
+import RSocketTCPServer from 'rsocket-tcp-server';
+import {Single} from 'rsocket-flowable';
+
+const EventEmitter = (require('events'): any);
+const tls = require('tls');
+const net = require('net');
+
+const SECURE_PORT = 8088;
+const INSECURE_PORT = 8089;
+// Requests are sent in small bursts, this often.
+const TICK_MS = 10;
+
+export type LoadConfig = {|
+  // Plugin and method the execute requests are sent to.
+  plugin: string,
+  method: string,
+  // Execute requests per second, per device.
+  rate: number,
+  // Size of the string sent as the payload param of each request.
+  payloadBytes: number,
+  durationSeconds: number,
+|};
+
+export type LoadReport = {|
+  device: string,
+  requestsSent: number,
+  responses: number,
+  errors: number,
+  // Response latency in milliseconds.
+  latency: {|p50: number, p90: number, p99: number, max: number|},
+  // Messages the device sent on its own, such as plugin events.
+  eventsPerSecond: number,
+  receivedBytesPerSecond: number,
+|};
+
+type RSocket = {|
+  fireAndForget(payload: {data: string}): void,
+  connectionStatus(): any,
+  close(): void,
+|};
+
+function now(): number {
+  const [seconds, nanos] = process.hrtime();
+  return seconds * 1e3 + nanos / 1e6;
+}
+
+function percentile(sorted: Array<number>, p: number): number {
+  if (sorted.length === 0) {
+    return 0;
+  }
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+/*
+ * A headless stand-in for the desktop app, for sizing the client's limits and
+ * queues. It listens on the same ports as the desktop, signs certificates the
+ * same way so that devices can connect securely, and then drives execute
+ * requests at a fixed rate against each device that connects, measuring
+ * response latency and the throughput of what the device sends by itself.
+ * The desktop app can't run at the same time, as it uses the same ports.
+ */
+export default class LoadGenerator extends EventEmitter {
+  config: LoadConfig;
+  certificateProvider: CertificateProvider;
+  secureServer: ?RSocketServer;
+  insecureServer: ?RSocketServer;
+
+  constructor(config: LoadConfig) {
+    super();
+    this.config = config;
+    this.certificateProvider = new CertificateProvider(this, new Logger());
+  }
+
+  on: ((event: 'report', callback: (report: LoadReport) => void) => void) &
+    ((event: 'error', callback: (err: Error) => void) => void);
+
+  start() {
+    this.certificateProvider
+      .loadSecureServerConfig()
+      .then(
+        options =>
+          (this.secureServer = this.startServer(SECURE_PORT, options)),
+      )
+      .catch(e => this.emit('error', e));
+    this.insecureServer = this.startServer(INSECURE_PORT);
+  }
+
+  stop() {
+    this.secureServer && this.secureServer.stop();
+    this.insecureServer && this.insecureServer.stop();
+  }
+
+  startServer(port: number, sslConfig?: SecureServerConfig): RSocketServer {
+    const serverFactory = onConnect => {
+      const transportServer = sslConfig
+        ? tls.createServer(sslConfig, socket => {
+            onConnect(socket);
+          })
+        : net.createServer(onConnect);
+      transportServer.on('error', err => this.emit('error', err));
+      return transportServer;
+    };
+    const rsServer = new RSocketServer({
+      getRequestHandler: sslConfig
+        ? this._trustedRequestHandler
+        : this._untrustedRequestHandler,
+      transport: new RSocketTCPServer({port, serverFactory}),
+    });
+    rsServer.start();
+    return rsServer;
+  }
+
+  // Same certificate exchange as the desktop's, see server.js.
+  _untrustedRequestHandler = (
+    conn: RSocket,
+    connectRequest: {data: string},
+  ) => {
+    const clientData = JSON.parse(connectRequest.data);
+    return {
+      requestResponse: (payload: {data: string}) => {
+        const json = JSON.parse(payload.data);
+        if (json.method !== 'signCertificate') {
+          return;
+        }
+        const {csr, destination} = json;
+        return new Single(subscriber => {
+          subscriber.onSubscribe();
+          this.certificateProvider
+            .processCertificateSigningRequest(csr, clientData.os, destination)
+            .then(_ => subscriber.onComplete({data: '{}', metadata: ''}))
+            .catch(e => subscriber.onError(e));
+        });
+      },
+    };
+  };
+
+  _trustedRequestHandler = (conn: RSocket, connectRequest: {data: string}) => {
+    // The payload connectSecurely sets up the connection with.
+    const query: ClientQuery = JSON.parse(connectRequest.data);
+    const session = new LoadSession(
+      `${query.app}-${query.os}-${query.device}`,
+      conn,
+      this.config,
+    );
+    session.on('report', report => this.emit('report', report));
+    conn.connectionStatus().subscribe({
+      onNext(payload) {
+        if (payload.kind == 'ERROR' || payload.kind == 'CLOSED') {
+          session.finish();
+        }
+      },
+      onSubscribe(subscription) {
+        subscription.request(Number.MAX_SAFE_INTEGER);
+      },
+    });
+    session.start();
+    return session.responder;
+  };
+}
+
+class LoadSession extends EventEmitter {
+  device: string;
+  connection: RSocket;
+  config: LoadConfig;
+  payload: string;
+  nextId: number = 0;
+  // Send times of the requests not responded to yet, by id.
+  pending: Map<number, number> = new Map();
+  latencies: Array<number> = [];
+  requestsSent: number = 0;
+  errors: number = 0;
+  events: number = 0;
+  receivedBytes: number = 0;
+  startTime: number = 0;
+  timer: ?IntervalID;
+  finished: boolean = false;
+  responder = {
+    fireAndForget: (payload: {data: string}) => this.onMessage(payload.data),
+  };
+
+  constructor(device: string, connection: RSocket, config: LoadConfig) {
+    super();
+    this.device = device;
+    this.connection = connection;
+    this.config = config;
+    this.payload = 'x'.repeat(config.payloadBytes);
+  }
+
+  call(method: string, params?: Object): number {
+    const id = this.nextId++;
+    this.pending.set(id, now());
+    this.connection.fireAndForget({data: JSON.stringify({id, method, params})});
+    return id;
+  }
+
+  start() {
+    this.call('init', {plugin: this.config.plugin});
+    this.startTime = now();
+    // Fractions of a request carry over to the next tick.
+    let owed = 0;
+    this.timer = setInterval(() => {
+      if (now() - this.startTime >= this.config.durationSeconds * 1000) {
+        this.finish();
+        return;
+      }
+      owed += (this.config.rate * TICK_MS) / 1000;
+      for (; owed >= 1; owed--) {
+        this.call('execute', {
+          api: this.config.plugin,
+          method: this.config.method,
+          params: {payload: this.payload},
+        });
+        this.requestsSent++;
+      }
+    }, TICK_MS);
+  }
+
+  onMessage(data: string) {
+    if (typeof data !== 'string' || this.finished) {
+      return;
+    }
+    this.receivedBytes += data.length;
+    const message = JSON.parse(data);
+    if (message.id == null) {
+      this.events++;
+      return;
+    }
+    const sent = this.pending.get(message.id);
+    if (sent == null) {
+      return;
+    }
+    this.pending.delete(message.id);
+    if (message.error) {
+      this.errors++;
+    }
+    this.latencies.push(now() - sent);
+  }
+
+  finish() {
+    if (this.finished) {
+      return;
+    }
+    this.finished = true;
+    if (this.timer) {
+      clearInterval(this.timer);
+    }
+    const seconds = Math.max(0.001, (now() - this.startTime) / 1000);
+    const sorted = this.latencies.slice().sort((a, b) => a - b);
+    const report: LoadReport = {
+      device: this.device,
+      requestsSent: this.requestsSent,
+      responses: this.latencies.length,
+      errors: this.errors,
+      latency: {
+        p50: percentile(sorted, 0.5),
+        p90: percentile(sorted, 0.9),
+        p99: percentile(sorted, 0.99),
+        max: sorted.length ? sorted[sorted.length - 1] : 0,
+      },
+      eventsPerSecond: this.events / seconds,
+      receivedBytesPerSecond: this.receivedBytes / seconds,
+    };
+    this.emit('report', report);
+    this.connection.close();
+  }
+}
@@ -8,6 +8,9 @@
 #include "CertificateUtils.h"
 
 #include <fcntl.h>
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/obj_mac.h>
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
 #include <sys/stat.h>
@@ -20,18 +23,63 @@ void free(
     BIO* privateKey,
     BIO* csrBio);
 
+EVP_PKEY* generatePrivateKey(CertificateKeyType keyType) {
+  EVP_PKEY* pKey = EVP_PKEY_new();
+  if (pKey == NULL) {
+    return NULL;
+  }
+
+  if (keyType == CertificateKeyTypeECDSA) {
+    EC_KEY* ecKey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    if (ecKey == NULL) {
+      EVP_PKEY_free(pKey);
+      return NULL;
+    }
+    // Encode the curve by name, desktop tooling doesn't handle explicit
+    // curve parameters.
+    EC_KEY_set_asn1_flag(ecKey, OPENSSL_EC_NAMED_CURVE);
+    if (EC_KEY_generate_key(ecKey) != 1 ||
+        EVP_PKEY_assign_EC_KEY(pKey, ecKey) != 1) {
+      EC_KEY_free(ecKey);
+      EVP_PKEY_free(pKey);
+      return NULL;
+    }
+    return pKey;
+  }
+
+  int bits = 2048;
+
+  // Using 65537 as exponent
+  unsigned long e = RSA_F4;
+
+  RSA* rsa = RSA_new();
+  EVP_PKEY_assign_RSA(pKey, rsa);
+
+  // Generate rsa key
+  BIGNUM* bne = BN_new();
+  BN_set_flags(bne, BN_FLG_CONSTTIME);
+  int ret = BN_set_word(bne, e);
+  if (ret == 1) {
+    ret = RSA_generate_key_ex(rsa, bits, bne, NULL);
+  }
+  BN_free(bne);
+  if (ret != 1) {
+    EVP_PKEY_free(pKey);
+    return NULL;
+  }
+  return pKey;
+}
+
 bool generateCertSigningRequest(
     const char* appId,
     const char* csrFile,
-    const char* privateKeyFile) {
+    const char* privateKeyFile,
+    CertificateKeyType keyType,
+    EVP_PKEY* pregeneratedKey) {
   int ret = 0;
   BIGNUM* bne = NULL;
 
   int nVersion = 1;
-  int bits = 2048;
-
-  // Using 65537 as exponent
-  unsigned long e = RSA_F4;
 
   X509_NAME* x509_name = NULL;
 
@@ -42,32 +90,20 @@ bool generateCertSigningRequest(
   const char* subjectCommon = appId;
 
   X509_REQ* x509_req = X509_REQ_new();
-  EVP_PKEY* pKey = EVP_PKEY_new();
-  RSA* rsa = RSA_new();
+  EVP_PKEY* pKey =
+      pregeneratedKey ? pregeneratedKey : generatePrivateKey(keyType);
   BIO* privateKey = NULL;
   BIO* csrBio = NULL;
 
-  EVP_PKEY_assign_RSA(pKey, rsa);
-
-  // Generate rsa key
-  bne = BN_new();
-  BN_set_flags(bne, BN_FLG_CONSTTIME);
-  ret = BN_set_word(bne, e);
-  if (ret != 1) {
+  if (pKey == NULL) {
     free(pKey, x509_req, bne, privateKey, csrBio);
-    return ret;
-  }
-
-  ret = RSA_generate_key_ex(rsa, bits, bne, NULL);
-  if (ret != 1) {
-    free(pKey, x509_req, bne, privateKey, csrBio);
-    return ret;
+    return false;
   }
 
   {
     // Write private key to a file
     int privateKeyFd =
-        open(privateKeyFile, O_CREAT | O_WRONLY, S_IWUSR | S_IRUSR);
+        open(privateKeyFile, O_CREAT | O_WRONLY | O_TRUNC, S_IWUSR | S_IRUSR);
     if (privateKeyFd < 0) {
       free(pKey, x509_req, bne, privateKey, csrBio);
       return -1;
@@ -79,15 +115,13 @@ bool generateCertSigningRequest(
     }
     privateKey = BIO_new_fp(privateKeyFp, BIO_CLOSE);
     ret =
-        PEM_write_bio_RSAPrivateKey(privateKey, rsa, NULL, NULL, 0, NULL, NULL);
+        PEM_write_bio_PrivateKey(privateKey, pKey, NULL, NULL, 0, NULL, NULL);
     if (ret != 1) {
       free(pKey, x509_req, bne, privateKey, csrBio);
       return ret;
     }
   }
 
-  rsa = NULL;
-
   ret = BIO_flush(privateKey);
   if (ret != 1) {
     free(pKey, x509_req, bne, privateKey, csrBio);
@@ -182,7 +216,8 @@ bool generateCertSigningRequest(
 
   {
     // Write CSR to a file
-    int csrFd = open(csrFile, O_CREAT | O_WRONLY, S_IWUSR | S_IRUSR);
+    int csrFd =
+        open(csrFile, O_CREAT | O_WRONLY | O_TRUNC, S_IWUSR | S_IRUSR);
     if (csrFd < 0) {
       free(pKey, x509_req, bne, privateKey, csrBio);
       return -1;
@@ -209,6 +244,43 @@ bool generateCertSigningRequest(
   return (ret == 1);
 }
 
+bool isValidCertSigningRequest(
+    const char* appId,
+    const char* csrFile,
+    const char* privateKeyFile,
+    CertificateKeyType keyType) {
+  BIO* privateKey = BIO_new_file(privateKeyFile, "r");
+  BIO* csrBio = BIO_new_file(csrFile, "r");
+  EVP_PKEY* pKey = NULL;
+  X509_REQ* x509_req = NULL;
+  if (privateKey != NULL && csrBio != NULL) {
+    pKey = PEM_read_bio_PrivateKey(privateKey, NULL, NULL, NULL);
+    x509_req = PEM_read_bio_X509_REQ(csrBio, NULL, NULL, NULL);
+  }
+
+  bool valid = pKey != NULL && x509_req != NULL;
+  if (valid) {
+    const int expectedType =
+        keyType == CertificateKeyTypeECDSA ? EVP_PKEY_EC : EVP_PKEY_RSA;
+    valid = EVP_PKEY_base_id(pKey) == expectedType &&
+        X509_REQ_check_private_key(x509_req, pKey) == 1;
+  }
+  if (valid) {
+    char commonName[256];
+    const int length = X509_NAME_get_text_by_NID(
+        X509_REQ_get_subject_name(x509_req),
+        NID_commonName,
+        commonName,
+        sizeof(commonName));
+    valid = length >= 0 && strcmp(commonName, appId) == 0;
+  }
+
+  free(pKey, x509_req, NULL, privateKey, csrBio);
+  // Don't leave errors from a failed check behind for the next TLS call.
+  ERR_clear_error();
+  return valid;
+}
+
 void free(
     EVP_PKEY* pKey,
     X509_REQ* x509_req,
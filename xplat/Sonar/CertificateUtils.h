@@ -8,13 +8,37 @@
 #ifndef CertificateUtils_hpp
 #define CertificateUtils_hpp
 
+#include <openssl/evp.h>
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
 #include <stdio.h>
 
+enum CertificateKeyType {
+  CertificateKeyTypeRSA,
+  // P-256, much cheaper than RSA to generate and to handshake with.
+  CertificateKeyTypeECDSA,
+};
+
+/* Generates a new private key of the given type, or returns NULL on failure.
+   The caller owns the returned key. */
+EVP_PKEY* generatePrivateKey(CertificateKeyType keyType);
+
+/* Writes a private key and a CSR for it to the given files. The key is
+   generated unless a pregenerated one is passed, in which case this takes
+   ownership of it. */
 bool generateCertSigningRequest(
     const char* appId,
     const char* csrFile,
-    const char* privateKeyFile);
+    const char* privateKeyFile,
+    CertificateKeyType keyType = CertificateKeyTypeRSA,
+    EVP_PKEY* pregeneratedKey = NULL);
+
+/* Whether the CSR and private key in the given files exist, belong together,
+   and match the app id and key type a new request would be generated with. */
+bool isValidCertSigningRequest(
+    const char* appId,
+    const char* csrFile,
+    const char* privateKeyFile,
+    CertificateKeyType keyType);
 
 #endif /* CertificateUtils_hpp */
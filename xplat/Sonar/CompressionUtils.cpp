@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include "CompressionUtils.h"
+
+#include <folly/ScopeGuard.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+#include <zlib.h>
+#include <stdexcept>
+
+static constexpr uint8_t zlibHeaderByte = 0x78;
+static constexpr size_t inflateChunkSize = 16 * 1024;
+
+namespace facebook {
+namespace sonar {
+
+std::unique_ptr<folly::IOBuf> deflateFrame(const folly::IOBuf& data) {
+  z_stream stream = {};
+  if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    throw std::runtime_error("Unable to initialize deflate stream");
+  }
+  SCOPE_EXIT {
+    deflateEnd(&stream);
+  };
+
+  auto out =
+      folly::IOBuf::create(deflateBound(&stream, data.computeChainDataLength()));
+  stream.next_out = out->writableTail();
+  stream.avail_out = out->tailroom();
+  for (const auto& range : data) {
+    stream.next_in = const_cast<Bytef*>(range.data());
+    stream.avail_in = range.size();
+    if (deflate(&stream, Z_NO_FLUSH) != Z_OK) {
+      throw std::runtime_error("Unable to deflate frame");
+    }
+  }
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+    throw std::runtime_error("Unable to deflate frame");
+  }
+  out->append(out->tailroom() - stream.avail_out);
+  return out;
+}
+
+std::unique_ptr<folly::IOBuf> inflateFrame(const folly::IOBuf& data) {
+  z_stream stream = {};
+  if (inflateInit(&stream) != Z_OK) {
+    throw std::runtime_error("Unable to initialize inflate stream");
+  }
+  SCOPE_EXIT {
+    inflateEnd(&stream);
+  };
+
+  folly::IOBufQueue out(folly::IOBufQueue::cacheChainLength());
+  int result = Z_OK;
+  for (const auto& range : data) {
+    stream.next_in = const_cast<Bytef*>(range.data());
+    stream.avail_in = range.size();
+    // Keep going while there is input left, or while the last call filled
+    // the whole output buffer and may have more pending.
+    do {
+      auto buffer = out.preallocate(inflateChunkSize, inflateChunkSize);
+      stream.next_out = static_cast<Bytef*>(buffer.first);
+      stream.avail_out = buffer.second;
+      result = inflate(&stream, Z_NO_FLUSH);
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+        throw std::runtime_error("Unable to inflate frame");
+      }
+      out.postallocate(buffer.second - stream.avail_out);
+    } while ((stream.avail_in > 0 || stream.avail_out == 0) &&
+             result != Z_STREAM_END);
+  }
+  if (result != Z_STREAM_END) {
+    throw std::runtime_error("Truncated deflated frame");
+  }
+  return out.move();
+}
+
+bool isDeflated(const folly::IOBuf& data) {
+  folly::io::Cursor cursor(&data);
+  return cursor.canAdvance(1) && cursor.read<uint8_t>() == zlibHeaderByte;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,31 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Compresses data into a zlib stream. zlib streams always start with 0x78,
+ which lets the receiver tell them apart from JSON and BSER frames.
+ */
+std::unique_ptr<folly::IOBuf> deflateFrame(const folly::IOBuf& data);
+
+/**
+ Decompresses a zlib stream produced by deflateFrame.
+ */
+std::unique_ptr<folly::IOBuf> inflateFrame(const folly::IOBuf& data);
+
+bool isDeflated(const folly::IOBuf& data);
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,35 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarBackoff.h"
+#include <folly/Random.h>
+#include <algorithm>
+#include <cstdint>
+
+namespace facebook {
+namespace sonar {
+
+constexpr std::chrono::milliseconds SonarBackoff::kDefaultInitialDelay;
+constexpr std::chrono::milliseconds SonarBackoff::kDefaultMaxDelay;
+
+// More doublings than this would overflow well before reaching any ceiling
+// that makes sense.
+static constexpr int kMaxDoublings = 20;
+
+std::chrono::milliseconds SonarBackoff::delay(int attempts) const {
+  const int shift = std::max(0, std::min(attempts, kMaxDoublings));
+  const auto ceiling =
+      std::min(initialDelay_ * (int64_t(1) << shift), maxDelay_);
+  const double point =
+      jitter_ ? jitter_() : folly::Random::randDouble(0.5, 1.0);
+  return std::chrono::milliseconds(
+      static_cast<int64_t>(ceiling.count() * point));
+}
+
+} // namespace sonar
+} // namespace facebook
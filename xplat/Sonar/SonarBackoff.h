@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ How long to wait before reconnecting. The delay doubles with every failed
+ attempt up to a ceiling, then a random point in its upper half is picked so
+ that devices in a lab don't retry in lockstep.
+ */
+class SonarBackoff {
+ public:
+  // Picks the point in the upper half, a value between 0.5 and 1.
+  using Jitter = std::function<double()>;
+
+  static constexpr std::chrono::milliseconds kDefaultInitialDelay{2000};
+  static constexpr std::chrono::milliseconds kDefaultMaxDelay{60000};
+
+  /**
+   Without jitter, the point is picked at random.
+   */
+  explicit SonarBackoff(
+      std::chrono::milliseconds initialDelay = kDefaultInitialDelay,
+      std::chrono::milliseconds maxDelay = kDefaultMaxDelay,
+      Jitter jitter = nullptr)
+      : initialDelay_(initialDelay),
+        maxDelay_(maxDelay),
+        jitter_(std::move(jitter)) {}
+
+  /**
+   The delay before the next attempt after attempts failed ones.
+   */
+  std::chrono::milliseconds delay(int attempts) const;
+
+ private:
+  const std::chrono::milliseconds initialDelay_;
+  const std::chrono::milliseconds maxDelay_;
+  const Jitter jitter_;
+};
+
+} // namespace sonar
+} // namespace facebook
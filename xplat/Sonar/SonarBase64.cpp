@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include "SonarBase64.h"
+#include "SonarSimd.h"
+
+static const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+namespace facebook {
+namespace sonar {
+
+void appendBase64(std::string& out, folly::ByteRange data) {
+  static const auto groups = sonarSimdKernels().base64Groups;
+  const size_t start = out.size();
+  out.resize(start + (data.size() + 2) / 3 * 4);
+  char* dst = &out[start];
+  const size_t encoded = groups(data.data(), data.size(), dst);
+  dst += encoded / 3 * 4;
+  const uint8_t* src = data.data() + encoded;
+  const size_t remaining = data.size() - encoded;
+  if (remaining) {
+    const bool two = remaining == 2;
+    const uint32_t n = src[0] << 16 | (two ? src[1] << 8 : 0);
+    *dst++ = kAlphabet[n >> 18];
+    *dst++ = kAlphabet[n >> 12 & 63];
+    *dst++ = two ? kAlphabet[n >> 6 & 63] : '=';
+    *dst++ = '=';
+  }
+}
+
+std::string toBase64(folly::ByteRange data) {
+  std::string result;
+  appendBase64(result, data);
+  return result;
+}
+
+} // namespace sonar
+} // namespace facebook
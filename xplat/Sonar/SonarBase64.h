@@ -0,0 +1,26 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Appends data to out base64 encoded, with padding. Whole groups of 3 bytes
+ go through the best kernel of SonarSimd.h.
+ */
+void appendBase64(std::string& out, folly::ByteRange data);
+
+std::string toBase64(folly::ByteRange data);
+
+} // namespace sonar
+} // namespace facebook
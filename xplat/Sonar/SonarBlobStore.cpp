@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarBlobStore.h"
+#include <folly/Conv.h>
+#include <algorithm>
+#include <iterator>
+
+namespace facebook {
+namespace sonar {
+
+constexpr size_t SonarBlobStore::kDefaultMaxBytes;
+constexpr size_t SonarBlobStore::kDefaultChunkSize;
+
+std::string SonarBlobStore::put(
+    const std::string& plugin,
+    std::unique_ptr<folly::IOBuf> blob) {
+  if (!blob) {
+    blob = folly::IOBuf::create(0);
+  }
+  // Chunks are slices of one contiguous buffer.
+  blob->coalesce();
+  const auto length = blob->length();
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto id = nextId_++;
+  blobs_[id] =
+      Blob{plugin, std::shared_ptr<const folly::IOBuf>(std::move(blob))};
+  bytes_ += length;
+  while (maxBytes_ > 0 && bytes_ > maxBytes_ && blobs_.size() > 1) {
+    erase(blobs_.begin());
+  }
+  return folly::to<std::string>(id);
+}
+
+bool SonarBlobStore::release(const std::string& id) {
+  const auto key = folly::tryTo<uint64_t>(id);
+  if (!key) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto iter = blobs_.find(*key);
+  if (iter == blobs_.end()) {
+    return false;
+  }
+  erase(iter);
+  return true;
+}
+
+void SonarBlobStore::releaseAll(const std::string& plugin) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto iter = blobs_.begin(); iter != blobs_.end();) {
+    auto next = std::next(iter);
+    if (iter->second.plugin == plugin) {
+      erase(iter);
+    }
+    iter = next;
+  }
+}
+
+void SonarBlobStore::stream(
+    const std::string& id,
+    size_t chunkSize,
+    SonarStreamResponder& responder) const {
+  std::shared_ptr<const folly::IOBuf> data;
+  if (const auto key = folly::tryTo<uint64_t>(id)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto iter = blobs_.find(*key);
+    if (iter != blobs_.end()) {
+      data = iter->second.data;
+    }
+  }
+  if (!data) {
+    responder.error(
+        folly::dynamic::object("message", "blob " + id + " not found"));
+    return;
+  }
+  if (chunkSize == 0) {
+    chunkSize = kDefaultChunkSize;
+  }
+  const auto length = data->length();
+  for (size_t offset = 0; offset < length; offset += chunkSize) {
+    const auto size = std::min(chunkSize, length - offset);
+    auto chunk = data->cloneOne();
+    chunk->trimStart(offset);
+    chunk->trimEnd(length - offset - size);
+    responder.nextBytes(std::move(chunk));
+  }
+  responder.complete();
+}
+
+size_t SonarBlobStore::bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+size_t SonarBlobStore::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return blobs_.size();
+}
+
+size_t SonarBlobStore::shed(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto before = bytes_;
+  while (before - bytes_ < bytes && !blobs_.empty()) {
+    erase(blobs_.begin());
+  }
+  return before - bytes_;
+}
+
+void SonarBlobStore::erase(std::map<uint64_t, Blob>::iterator iter) {
+  bytes_ -= iter->second.data->length();
+  blobs_.erase(iter);
+}
+
+} // namespace sonar
+} // namespace facebook
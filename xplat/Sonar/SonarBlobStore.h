@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarStreamResponder.h>
+#include <folly/io/IOBuf.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Byte buffers plugins registered for the desktop to fetch on demand, so that
+ messages only carry their id instead of inlining them as base64. Blobs are
+ kept until released, and the oldest ones are evicted once they hold more
+ than maxBytes. Safe to use from any thread.
+ */
+class SonarBlobStore {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 32 * 1024 * 1024;
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit SonarBlobStore(size_t maxBytes = kDefaultMaxBytes)
+      : maxBytes_(maxBytes) {}
+
+  /**
+   Keep blob on behalf of plugin, returning the id the desktop fetches it by.
+   */
+  std::string put(
+      const std::string& plugin,
+      std::unique_ptr<folly::IOBuf> blob);
+
+  /**
+   Returns whether the blob was still kept.
+   */
+  bool release(const std::string& id);
+
+  // Release the blobs of plugin, e.g. because its desktop disconnected.
+  void releaseAll(const std::string& plugin);
+
+  /**
+   Send the blob to responder in chunks of at most chunkSize bytes, which
+   share its memory rather than copying it. Responds with an error if there
+   is no blob with the id.
+   */
+  void stream(
+      const std::string& id,
+      size_t chunkSize,
+      SonarStreamResponder& responder) const;
+
+  /**
+   Evict the oldest blobs until at least bytes are freed, or none are left.
+   Returns the bytes freed.
+   */
+  size_t shed(size_t bytes);
+
+  size_t bytes() const;
+
+  size_t size() const;
+
+ private:
+  struct Blob {
+    std::string plugin;
+    std::shared_ptr<const folly::IOBuf> data;
+  };
+
+  void erase(std::map<uint64_t, Blob>::iterator iter);
+
+  const size_t maxBytes_;
+  mutable std::mutex mutex_;
+  // Ordered by id, which is also the order they were put in.
+  std::map<uint64_t, Blob> blobs_;
+  uint64_t nextId_ = 0;
+  size_t bytes_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,242 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarBroker.h"
+#include <Sonar/SonarRawJson.h>
+#include <Sonar/SonarTransport.h>
+#include <folly/json.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define SONAR_LOG(message) \
+  __android_log_print(ANDROID_LOG_INFO, "sonar", "sonar: %s", message)
+#else
+#define SONAR_LOG(message) printf("sonar: %s\n", message)
+#endif
+
+namespace facebook {
+namespace sonar {
+
+static constexpr int kListenBacklog = 16;
+
+static std::unique_ptr<folly::IOBuf> serialize(const folly::dynamic& message) {
+  return folly::IOBuf::copyBuffer(folly::toJson(message));
+}
+
+void SonarBroker::start(DesktopSender toDesktop) {
+  toDesktop_ = std::move(toDesktop);
+  eventBase_->runInEventBaseThread([self = shared_from_this()]() {
+    try {
+      auto address = localSocketAddress(self->path_);
+      if (!self->path_.empty() && self->path_[0] != '@') {
+        // A socket file left behind by an earlier run would fail the bind.
+        unlink(self->path_.c_str());
+      }
+      self->server_.reset(new folly::AsyncServerSocket(self->eventBase_));
+      self->server_->bind(address);
+      self->server_->listen(kListenBacklog);
+      self->server_->addAcceptCallback(self.get(), nullptr);
+      self->server_->startAccepting();
+    } catch (std::exception& e) {
+      // The other processes keep retrying, the owner works on its own.
+      SONAR_LOG(e.what());
+      self->server_.reset();
+    }
+  });
+}
+
+void SonarBroker::stop() {
+  eventBase_->runInEventBaseThread([self = shared_from_this()]() {
+    if (self->server_) {
+      self->server_->removeAcceptCallback(self.get(), nullptr);
+      self->server_.reset();
+    }
+    self->processes_.clear();
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    self->owners_.clear();
+  });
+}
+
+std::vector<std::string> SonarBroker::plugins() const {
+  std::vector<std::string> plugins;
+  std::lock_guard<std::mutex> lock(mutex_);
+  plugins.reserve(owners_.size());
+  for (const auto& owner : owners_) {
+    plugins.push_back(owner.first);
+  }
+  return plugins;
+}
+
+bool SonarBroker::forward(
+    const std::string& plugin,
+    std::unique_ptr<folly::IOBuf> message) {
+  uint64_t process;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto& iter = owners_.find(plugin);
+    if (iter == owners_.end()) {
+      return false;
+    }
+    process = iter->second;
+  }
+  auto self = shared_from_this();
+  eventBase_->runInEventBaseThread(
+      [self, process, message = std::move(message)]() mutable {
+        const auto& iter = self->processes_.find(process);
+        if (iter != self->processes_.end()) {
+          iter->second.channel->send(std::move(message));
+        }
+      });
+  return true;
+}
+
+void SonarBroker::broadcast(std::unique_ptr<folly::IOBuf> message) {
+  eventBase_->runInEventBaseThread(
+      [self = shared_from_this(), message = std::move(message)]() {
+        for (auto& process : self->processes_) {
+          process.second.channel->send(message->clone());
+        }
+      });
+}
+
+void SonarBroker::setDesktopConnected(bool connected) {
+  desktopConnected_ = connected;
+  eventBase_->runInEventBaseThread([self = shared_from_this()]() {
+    for (auto& process : self->processes_) {
+      self->sendState(process.second);
+    }
+  });
+}
+
+void SonarBroker::connectionAccepted(
+    int fd,
+    const folly::SocketAddress& /* clientAddr */) noexcept {
+#ifdef SO_PEERCRED
+  // Abstract sockets can be reached by any app, only the app's own processes
+  // are let in.
+  struct ucred peer;
+  socklen_t length = sizeof(peer);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 ||
+      peer.uid != getuid()) {
+    SONAR_LOG("Refusing broker connection from another user");
+    close(fd);
+    return;
+  }
+#endif
+  const auto id = nextProcess_++;
+  std::weak_ptr<SonarBroker> weak = shared_from_this();
+  auto& process = processes_[id];
+  process.channel = std::make_unique<SonarBrokerChannel>(
+      folly::AsyncSocket::UniquePtr(new folly::AsyncSocket(eventBase_, fd)),
+      [weak, id](std::unique_ptr<folly::IOBuf> frame) {
+        if (auto self = weak.lock()) {
+          self->onFrame(id, std::move(frame));
+        }
+      },
+      [weak, id]() {
+        if (auto self = weak.lock()) {
+          self->removeProcess(id);
+        }
+      });
+  sendState(process);
+  requestPlugins(id);
+}
+
+void SonarBroker::acceptError(const std::exception& ex) noexcept {
+  SONAR_LOG(ex.what());
+}
+
+void SonarBroker::onFrame(
+    uint64_t process,
+    std::unique_ptr<folly::IOBuf> frame) {
+  const auto& iter = processes_.find(process);
+  if (iter == processes_.end()) {
+    return;
+  }
+  const auto bytes = frame->coalesce();
+  const auto fields =
+      SonarRawJson::view(folly::StringPiece(bytes)).fields();
+  const auto id = SonarRawJson::field(fields, "id");
+  if (!id.empty() && id.json().startsWith('-')) {
+    // A response to a call of the broker's own.
+    if (iter->second.pluginsRequest == id.parse().asInt()) {
+      iter->second.pluginsRequest = 0;
+      std::vector<std::string> plugins;
+      const auto success = SonarRawJson::field(fields, "success");
+      if (!success.empty()) {
+        for (const auto& plugin : success.parse()["plugins"]) {
+          plugins.push_back(plugin.asString());
+        }
+      }
+      setPlugins(process, std::move(plugins));
+    }
+    return;
+  }
+  const auto method = SonarRawJson::field(fields, "method");
+  if (!method.empty() && method.asString() == "refreshPlugins") {
+    requestPlugins(process);
+    return;
+  }
+  toDesktop_(std::move(frame));
+}
+
+void SonarBroker::requestPlugins(uint64_t process) {
+  const auto& iter = processes_.find(process);
+  if (iter == processes_.end()) {
+    return;
+  }
+  const auto id = --nextRequest_;
+  iter->second.pluginsRequest = id;
+  iter->second.channel->send(
+      serialize(folly::dynamic::object("id", id)("method", "getPlugins")));
+}
+
+void SonarBroker::setPlugins(
+    uint64_t process,
+    std::vector<std::string> plugins) {
+  auto& previous = processes_[process].plugins;
+  if (plugins == previous) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& plugin : previous) {
+      const auto& iter = owners_.find(plugin);
+      if (iter != owners_.end() && iter->second == process) {
+        owners_.erase(iter);
+      }
+    }
+    // A process that shows up later doesn't take over another's plugins.
+    for (const auto& plugin : plugins) {
+      owners_.emplace(plugin, process);
+    }
+  }
+  previous = std::move(plugins);
+  refreshDesktop();
+}
+
+void SonarBroker::removeProcess(uint64_t process) {
+  setPlugins(process, {});
+  processes_.erase(process);
+}
+
+void SonarBroker::sendState(Process& process) {
+  process.channel->send(serialize(folly::dynamic::object(
+      "broker", desktopConnected_ ? "connected" : "disconnected")));
+}
+
+void SonarBroker::refreshDesktop() {
+  if (desktopConnected_) {
+    toDesktop_(serialize(folly::dynamic::object("method", "refreshPlugins")));
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
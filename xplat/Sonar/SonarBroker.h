@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarBrokerChannel.h>
+#include <folly/io/async/AsyncServerSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Shares the desktop connection of the process that owns it with the app's
+ other processes, which connect to a local socket with SonarBrokerSocket
+ instead of each opening their own. The desktop sees a single app: the
+ plugins of the other processes are listed along with the owner's, calls to
+ them are forwarded to their process as they are, and whatever those
+ processes send is passed on to the desktop without being parsed again.
+
+ Calls of the broker's own, to list a process's plugins, have negative ids
+ so that they can't be mistaken for the desktop's. Sockets are only used on
+ eventBase, the rest is safe to use from any thread. Must be owned by a
+ shared_ptr.
+ */
+class SonarBroker : public std::enable_shared_from_this<SonarBroker>,
+                    private folly::AsyncServerSocket::AcceptCallback {
+ public:
+  using DesktopSender = std::function<void(std::unique_ptr<folly::IOBuf>)>;
+
+  /**
+   path names the local socket as for localSocketTransport.
+   */
+  SonarBroker(folly::EventBase* eventBase, std::string path)
+      : eventBase_(eventBase), path_(std::move(path)) {}
+
+  /**
+   Start accepting processes, sending what they send to the desktop with
+   toDesktop.
+   */
+  void start(DesktopSender toDesktop);
+
+  void stop();
+
+  /**
+   The plugins of the other processes that are connected.
+   */
+  std::vector<std::string> plugins() const;
+
+  /**
+   Forward a message of the desktop to the process that has plugin. Returns
+   false if no process has it.
+   */
+  bool forward(
+      const std::string& plugin,
+      std::unique_ptr<folly::IOBuf> message);
+
+  // Forward a message of the desktop to every process, e.g. a cancel.
+  void broadcast(std::unique_ptr<folly::IOBuf> message);
+
+  /**
+   Tell the processes whether a desktop is connected, so that their plugins
+   are disconnected along with the owner's.
+   */
+  void setDesktopConnected(bool connected);
+
+ private:
+  struct Process {
+    std::unique_ptr<SonarBrokerChannel> channel;
+    std::vector<std::string> plugins;
+    // The getPlugins call waiting for a response, if any.
+    int64_t pluginsRequest = 0;
+  };
+
+  void connectionAccepted(
+      int fd,
+      const folly::SocketAddress& clientAddr) noexcept override;
+  void acceptError(const std::exception& ex) noexcept override;
+
+  void onFrame(uint64_t process, std::unique_ptr<folly::IOBuf> frame);
+  void requestPlugins(uint64_t process);
+  void setPlugins(uint64_t process, std::vector<std::string> plugins);
+  void removeProcess(uint64_t process);
+  void sendState(Process& process);
+  void refreshDesktop();
+
+  folly::EventBase* eventBase_;
+  const std::string path_;
+  DesktopSender toDesktop_;
+  std::atomic<bool> desktopConnected_{false};
+
+  // Only touched on eventBase_.
+  folly::AsyncServerSocket::UniquePtr server_;
+  std::map<uint64_t, Process> processes_;
+  uint64_t nextProcess_ = 0;
+  int64_t nextRequest_ = 0;
+
+  // Which process each plugin is in, for lookups from any thread.
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, uint64_t> owners_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarBrokerChannel.h"
+#include <folly/io/Cursor.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define SONAR_LOG(message) \
+  __android_log_print(ANDROID_LOG_INFO, "sonar", "sonar: %s", message)
+#else
+#define SONAR_LOG(message) printf("sonar: %s\n", message)
+#endif
+
+namespace facebook {
+namespace sonar {
+
+static constexpr size_t kHeaderBytes = sizeof(uint32_t);
+static constexpr size_t kMinReadBytes = 4096;
+static constexpr size_t kMaxReadBytes = 64 * 1024;
+
+constexpr uint32_t SonarBrokerChannel::kMaxFrameBytes;
+
+SonarBrokerChannel::SonarBrokerChannel(
+    folly::AsyncSocket::UniquePtr socket,
+    FrameCallback onFrame,
+    CloseCallback onClose)
+    : socket_(std::move(socket)),
+      onFrame_(std::move(onFrame)),
+      onClose_(std::move(onClose)) {
+  socket_->setReadCB(this);
+}
+
+SonarBrokerChannel::~SonarBrokerChannel() {
+  if (socket_) {
+    socket_->setReadCB(nullptr);
+    socket_->closeNow();
+  }
+}
+
+void SonarBrokerChannel::send(std::unique_ptr<folly::IOBuf> frame) {
+  if (closed_) {
+    return;
+  }
+  const auto length = frame ? frame->computeChainDataLength() : 0;
+  auto header = folly::IOBuf::create(kHeaderBytes);
+  header->append(kHeaderBytes);
+  folly::io::RWPrivateCursor(header.get())
+      .writeBE<uint32_t>(static_cast<uint32_t>(length));
+  if (frame) {
+    header->prependChain(std::move(frame));
+  }
+  // Frames are small and local, nothing needs to know when they are written.
+  socket_->writeChain(nullptr, std::move(header));
+}
+
+void SonarBrokerChannel::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  socket_->setReadCB(nullptr);
+  socket_->close();
+  auto onClose = onClose_;
+  socket_->getEventBase()->runInLoop([onClose]() { onClose(); });
+}
+
+void SonarBrokerChannel::getReadBuffer(void** buffer, size_t* length) {
+  const auto space = received_.preallocate(kMinReadBytes, kMaxReadBytes);
+  *buffer = space.first;
+  *length = space.second;
+}
+
+void SonarBrokerChannel::readDataAvailable(size_t length) noexcept {
+  received_.postallocate(length);
+  while (!closed_ && received_.chainLength() >= kHeaderBytes) {
+    folly::io::Cursor cursor(received_.front());
+    const auto size = cursor.readBE<uint32_t>();
+    if (size > kMaxFrameBytes) {
+      SONAR_LOG("Closing broker channel on oversized frame");
+      close();
+      return;
+    }
+    if (received_.chainLength() < kHeaderBytes + size) {
+      return;
+    }
+    received_.trimStart(kHeaderBytes);
+    auto frame = size > 0 ? received_.split(size) : folly::IOBuf::create(0);
+    try {
+      onFrame_(std::move(frame));
+    } catch (std::exception& e) {
+      // One bad frame doesn't take the channel down.
+      SONAR_LOG(e.what());
+    }
+  }
+}
+
+void SonarBrokerChannel::readEOF() noexcept {
+  close();
+}
+
+void SonarBrokerChannel::readErr(
+    const folly::AsyncSocketException& ex) noexcept {
+  SONAR_LOG(ex.what());
+  close();
+}
+
+} // namespace sonar
+} // namespace facebook
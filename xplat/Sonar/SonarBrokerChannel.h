@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Frames exchanged over a local socket between the process that owns the
+ desktop connection and the other processes of the app, see SonarBroker.
+ Each frame is a serialized message prefixed with its length as a 32 bit big
+ endian integer. Must only be used on the socket's event base.
+ */
+class SonarBrokerChannel : private folly::AsyncTransportWrapper::ReadCallback {
+ public:
+  using FrameCallback = std::function<void(std::unique_ptr<folly::IOBuf>)>;
+  using CloseCallback = std::function<void()>;
+
+  // Anything bigger is taken for a corrupted stream.
+  static constexpr uint32_t kMaxFrameBytes = 64 * 1024 * 1024;
+
+  /**
+   onClose is called once the socket closes or fails, from the event base's
+   loop rather than inline, so that it may destroy the channel.
+   */
+  SonarBrokerChannel(
+      folly::AsyncSocket::UniquePtr socket,
+      FrameCallback onFrame,
+      CloseCallback onClose);
+
+  ~SonarBrokerChannel() override;
+
+  void send(std::unique_ptr<folly::IOBuf> frame);
+
+  void close();
+
+  bool isOpen() const {
+    return !closed_;
+  }
+
+ private:
+  void getReadBuffer(void** buffer, size_t* length) override;
+  void readDataAvailable(size_t length) noexcept override;
+  void readEOF() noexcept override;
+  void readErr(const folly::AsyncSocketException& ex) noexcept override;
+
+  folly::AsyncSocket::UniquePtr socket_;
+  FrameCallback onFrame_;
+  CloseCallback onClose_;
+  folly::IOBufQueue received_{folly::IOBufQueue::cacheChainLength()};
+  bool closed_ = false;
+};
+
+} // namespace sonar
+} // namespace facebook
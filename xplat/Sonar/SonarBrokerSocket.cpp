@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarBrokerSocket.h"
+#include <Sonar/SonarRawJson.h>
+#include <Sonar/SonarTrace.h>
+#include <Sonar/SonarTransport.h>
+#include <folly/json.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define SONAR_LOG(message) \
+  __android_log_print(ANDROID_LOG_INFO, "sonar", "sonar: %s", message)
+#else
+#define SONAR_LOG(message) printf("sonar: %s\n", message)
+#endif
+
+// The owner is on the same device, it is only missing until its process
+// starts, so there's no need to back off.
+static constexpr int reconnectDelayMillis = 1000;
+static constexpr int connectTimeoutMillis = 1000;
+
+namespace facebook {
+namespace sonar {
+
+SonarBrokerSocket::SonarBrokerSocket(SonarInitConfig config, std::string path)
+    : path_(std::move(path)),
+      eventBase_(
+          config.connectionWorker ? config.connectionWorker
+                                  : config.callbackWorker) {}
+
+SonarBrokerSocket::~SonarBrokerSocket() {
+  eventBase_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    started_ = false;
+    reconnectTimeout_ = nullptr;
+    // The callbacks may already be gone.
+    isOpen_ = false;
+    disconnect();
+  });
+}
+
+void SonarBrokerSocket::start() {
+  eventBase_->runInEventBaseThread([this]() {
+    if (started_) {
+      return;
+    }
+    started_ = true;
+    reconnectTimeout_ =
+        folly::AsyncTimeout::make(*eventBase_, [this]() noexcept {
+          connect();
+        });
+    connect();
+  });
+}
+
+void SonarBrokerSocket::stop() {
+  eventBase_->runInEventBaseThread([this]() {
+    started_ = false;
+    reconnectTimeout_ = nullptr;
+    setDesktopConnected(false);
+    disconnect();
+  });
+}
+
+bool SonarBrokerSocket::isOpen() const {
+  return isOpen_;
+}
+
+void SonarBrokerSocket::connectivityChanged() {
+  // The owner's connection is the one that cares.
+}
+
+void SonarBrokerSocket::setCallbacks(Callbacks* callbacks) {
+  callbacks_ = callbacks;
+}
+
+void SonarBrokerSocket::sendMessage(const folly::dynamic& message) {
+  SONAR_TRACE_SECTION("SonarWebSocket::sendMessage");
+  sendSerialized(folly::IOBuf::copyBuffer(folly::toJson(message)));
+}
+
+void SonarBrokerSocket::sendSerialized(
+    std::unique_ptr<folly::IOBuf> message) {
+  eventBase_->runInEventBaseThread(
+      [this, message = std::move(message)]() mutable {
+        // Like any socket that isn't open, messages sent meanwhile are lost.
+        if (channel_ && channel_->isOpen()) {
+          channel_->send(std::move(message));
+        }
+      });
+}
+
+void SonarBrokerSocket::connect() {
+  if (!started_ || channel_ || connecting_) {
+    return;
+  }
+  try {
+    connecting_ = folly::AsyncSocket::newSocket(eventBase_);
+    connecting_->connect(
+        this, localSocketAddress(path_), connectTimeoutMillis);
+  } catch (std::exception& e) {
+    SONAR_LOG(e.what());
+    connecting_ = nullptr;
+    reconnectTimeout_->scheduleTimeout(reconnectDelayMillis);
+  }
+}
+
+void SonarBrokerSocket::connectSuccess() noexcept {
+  channel_ = std::make_unique<SonarBrokerChannel>(
+      std::move(connecting_),
+      [this](std::unique_ptr<folly::IOBuf> frame) {
+        onFrame(std::move(frame));
+      },
+      [this]() {
+        setDesktopConnected(false);
+        channel_ = nullptr;
+        if (started_ && reconnectTimeout_) {
+          reconnectTimeout_->scheduleTimeout(reconnectDelayMillis);
+        }
+      });
+  // The owner tells whether a desktop is connected right away.
+}
+
+void SonarBrokerSocket::connectErr(
+    const folly::AsyncSocketException& /* ex */) noexcept {
+  // Expected until the owning process has started.
+  connecting_ = nullptr;
+  if (started_ && reconnectTimeout_) {
+    reconnectTimeout_->scheduleTimeout(reconnectDelayMillis);
+  }
+}
+
+void SonarBrokerSocket::disconnect() {
+  connecting_ = nullptr;
+  channel_ = nullptr;
+}
+
+void SonarBrokerSocket::onFrame(std::unique_ptr<folly::IOBuf> frame) {
+  auto message =
+      SonarRawJson::fromString(frame->moveToFbString().toStdString());
+  const auto fields = message.fields();
+  const auto state = SonarRawJson::field(fields, "broker");
+  if (!state.empty()) {
+    setDesktopConnected(state.asString() == "connected");
+    return;
+  }
+  SONAR_TRACE_SECTION("SonarWebSocket::onMessageReceived");
+  callbacks_->onRawMessageReceived(message);
+}
+
+void SonarBrokerSocket::setDesktopConnected(bool connected) {
+  if (isOpen_.exchange(connected) == connected) {
+    return;
+  }
+  if (connected) {
+    callbacks_->onConnected();
+  } else {
+    callbacks_->onDisconnected();
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
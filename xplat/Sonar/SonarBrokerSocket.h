@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarBrokerChannel.h>
+#include <Sonar/SonarInitConfig.h>
+#include <Sonar/SonarWebSocket.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ A SonarWebSocket for the processes of an app that don't own the desktop
+ connection: messages go through the local socket of the process that does,
+ see SonarBroker. There is no certificate exchange, TLS or connection of
+ its own. It counts as open while the owner's desktop is connected.
+
+ Everything but sending messages happens on the connection worker's
+ EventBase, callbacks included.
+ */
+class SonarBrokerSocket : public SonarWebSocket,
+                          private folly::AsyncSocket::ConnectCallback {
+ public:
+  SonarBrokerSocket(SonarInitConfig config, std::string path);
+
+  ~SonarBrokerSocket();
+
+  void start() override;
+
+  void stop() override;
+
+  bool isOpen() const override;
+
+  void connectivityChanged() override;
+
+  void setCallbacks(Callbacks* callbacks) override;
+
+  void sendMessage(const folly::dynamic& message) override;
+
+  using SonarWebSocket::sendSerialized;
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override;
+
+ private:
+  void connectSuccess() noexcept override;
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override;
+
+  void connect();
+  void disconnect();
+  void onFrame(std::unique_ptr<folly::IOBuf> frame);
+  void setDesktopConnected(bool connected);
+
+  const std::string path_;
+  folly::EventBase* eventBase_;
+  Callbacks* callbacks_ = nullptr;
+  std::atomic<bool> isOpen_{false};
+
+  // Only accessed on eventBase_.
+  bool started_ = false;
+  folly::AsyncSocket::UniquePtr connecting_;
+  std::unique_ptr<SonarBrokerChannel> channel_;
+  std::unique_ptr<folly::AsyncTimeout> reconnectTimeout_;
+};
+
+} // namespace sonar
+} // namespace facebook
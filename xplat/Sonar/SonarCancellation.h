@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Tells a receiver that the desktop no longer wants its response, so that it
+ can abandon the work. Follows folly::CancellationToken, which the folly we
+ build against doesn't have yet. Default constructed tokens are never
+ cancelled. Safe to use from any thread.
+ */
+class SonarCancellationToken {
+ public:
+  SonarCancellationToken() = default;
+
+  bool isCancellationRequested() const {
+    return state_ && state_->load(std::memory_order_acquire);
+  }
+
+ private:
+  friend class SonarCancellationSource;
+
+  explicit SonarCancellationToken(
+      std::shared_ptr<const std::atomic<bool>> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<const std::atomic<bool>> state_;
+};
+
+class SonarCancellationSource {
+ public:
+  SonarCancellationSource()
+      : state_(std::make_shared<std::atomic<bool>>(false)) {}
+
+  SonarCancellationToken getToken() const {
+    return SonarCancellationToken(state_);
+  }
+
+  /**
+   Returns whether this was the first request to cancel.
+   */
+  bool requestCancellation() {
+    return !state_->exchange(true, std::memory_order_acq_rel);
+  }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> state_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -7,11 +7,27 @@
  */
 
 #include "SonarClient.h"
+#include "SonarBrokerSocket.h"
 #include "SonarConnectionImpl.h"
+#include "SonarDiagnosticsPlugin.h"
+#include "SonarFanOutSocket.h"
+#include "SonarOfflineCapture.h"
 #include "SonarResponderImpl.h"
 #include "SonarState.h"
 #include "SonarStep.h"
+#include "SonarTrace.h"
 #include "SonarWebSocketImpl.h"
+#if FB_SONAR_EASYWSCLIENT
+#include "SonarEasyWebSocket.h"
+#endif
+#include <folly/Conv.h>
+#include <folly/ScopeGuard.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
 #include <vector>
 
 #ifdef __ANDROID__
@@ -29,12 +45,167 @@ namespace sonar {
 
 static SonarClient* kInstance;
 
+// Plugin receivers run on a small shared pool. Each connection serializes its
+// own work on top of it, so one busy plugin never stalls the others.
+static constexpr size_t kPluginWorkerThreads = 2;
+
+static const std::string kExecuteMethod = "execute";
+
+// Captured events are replayed in a batch per interval.
+static constexpr uint32_t kReplayIntervalMs = 100;
+
 using folly::dynamic;
 
+static std::unique_ptr<SonarWebSocket> makeDesktopSocket(
+    SonarInitConfig config,
+    std::shared_ptr<SonarState> state,
+    std::shared_ptr<SonarMemoryBudget> budget) {
+#if FB_SONAR_EASYWSCLIENT
+  return std::make_unique<SonarEasyWebSocket>(std::move(config), state);
+#else
+  return std::make_unique<SonarWebSocketImpl>(
+      std::move(config), std::move(state), std::move(budget));
+#endif
+}
+
+// The main desktop's config, for a desktop at host, see additionalDesktops.
+static SonarInitConfig additionalDesktopConfig(
+    const SonarInitConfig& config,
+    const std::string& host) {
+  SonarInitConfig desktop = config;
+  desktop.deviceData.host = host;
+  // Each desktop signs certificates of its own.
+  desktop.deviceData.privateAppDirectory =
+      config.deviceData.privateAppDirectory + "/sonar-" + host;
+  mkdir(
+      desktop.deviceData.privateAppDirectory.c_str(),
+      S_IRUSR | S_IWUSR | S_IXUSR);
+  desktop.hostCandidates.clear();
+  desktop.transport = nullptr;
+  desktop.sessionRecordingPath.clear();
+  desktop.flightRecorderPath.clear();
+  desktop.additionalDesktops.clear();
+  return desktop;
+}
+
 void SonarClient::init(SonarInitConfig config) {
+  setTraceSamplingRate(config.traceSamplingRate);
   auto state = std::make_shared<SonarState>();
-  kInstance =
-      new SonarClient(std::make_unique<SonarWebSocketImpl>(std::move(config), state), state);
+  std::vector<std::unique_ptr<SonarEventBaseThread>> workerThreads;
+  if (config.nativeWorkers) {
+    for (auto options : {config.callbackThread, config.connectionThread}) {
+      auto step = state->start("Start " + options.name + " thread");
+      workerThreads.push_back(std::make_unique<SonarEventBaseThread>(
+          std::move(options), config.workerThreadFactory));
+      const auto& thread = workerThreads.back();
+      if (thread->fullyApplied()) {
+        step->complete();
+      } else {
+        // The thread still works, just not as asked.
+        std::string errors;
+        for (const auto& error : thread->report()["errors"]) {
+          errors += error.asString() + "\n";
+        }
+        step->fail(errors);
+      }
+    }
+    config.callbackWorker = workerThreads[0]->eventBase();
+    config.connectionWorker = workerThreads[1]->eventBase();
+  }
+  const auto capturePath = config.offlineCapturePath;
+  const auto captureBytes = config.offlineCaptureBytes;
+  const auto replayBytesPerSecond = config.offlineReplayBytesPerSecond;
+  const auto callbackWorker = config.callbackWorker;
+  const auto memorySoftLimit = config.memorySoftLimitBytes;
+  const auto memoryHardLimit = config.memoryHardLimitBytes;
+  const auto brokerPath = config.brokerPath;
+  const auto brokerOwner = config.brokerOwner;
+  const auto watchdogThreshold = config.watchdogThreshold;
+  const auto stackUnwinder = config.stackUnwinder;
+  const auto backgroundSendLimit = config.backgroundSendLimit;
+  const auto requestTimeout = config.requestTimeout;
+  const auto maxInFlightRequests = config.maxInFlightRequests;
+  const auto connectionWorker = config.connectionWorker
+      ? config.connectionWorker
+      : config.callbackWorker;
+  auto threadFactory = config.pluginThreadFactory
+      ? config.pluginThreadFactory
+      : std::make_shared<folly::NamedThreadFactory>("SonarPlugin");
+  auto pluginExecutor = std::make_shared<folly::CPUThreadPoolExecutor>(
+      kPluginWorkerThreads, std::move(threadFactory));
+  std::shared_ptr<SonarMemoryBudget> budget;
+  if (memorySoftLimit > 0 || memoryHardLimit > 0) {
+    budget = std::make_shared<SonarMemoryBudget>(
+        memorySoftLimit, memoryHardLimit, pluginExecutor.get());
+  }
+  std::unique_ptr<SonarWebSocket> socket;
+  if (!brokerPath.empty() && !brokerOwner) {
+    // The process owning the desktop connection serves this one.
+    socket = std::make_unique<SonarBrokerSocket>(std::move(config), brokerPath);
+  } else {
+    const auto additionalDesktops = config.additionalDesktops;
+    if (additionalDesktops.empty()) {
+      socket = makeDesktopSocket(std::move(config), state, budget);
+    } else {
+      std::vector<std::unique_ptr<SonarWebSocket>> sockets;
+      for (const auto& host : additionalDesktops) {
+        sockets.push_back(makeDesktopSocket(
+            additionalDesktopConfig(config, host),
+            std::make_shared<SonarState>(),
+            budget));
+      }
+      sockets.insert(
+          sockets.begin(), makeDesktopSocket(std::move(config), state, budget));
+      socket = std::make_unique<SonarFanOutSocket>(std::move(sockets));
+    }
+  }
+  kInstance = new SonarClient(
+      std::move(socket),
+      state,
+      std::move(pluginExecutor));
+  if (budget) {
+    kInstance->setMemoryBudget(std::move(budget));
+  }
+  kInstance->setRefreshWorker(callbackWorker);
+  kInstance->setBackgroundSendLimit(backgroundSendLimit);
+  kInstance->setInFlightRequests(std::make_shared<SonarInFlightRequests>(
+      maxInFlightRequests, requestTimeout));
+  if (!workerThreads.empty()) {
+    kInstance->setWorkerThreads(std::move(workerThreads));
+  }
+  if (watchdogThreshold.count() > 0) {
+    kInstance->setWatchdog(std::make_shared<SonarWatchdog>(
+        watchdogThreshold,
+        stackUnwinder,
+        [state](const SonarWatchdog::Report& report) {
+          state->incrementCounter("blockedTasks");
+          std::string stack;
+          for (const auto& frame : report.stack) {
+            stack += frame + "\n";
+          }
+          state->start("Blocked in " + report.task)
+              ->fail(
+                  folly::to<std::string>(report.blockedFor.count()) +
+                  "ms\n" + stack);
+        }));
+  }
+  if (!brokerPath.empty() && brokerOwner) {
+    kInstance->setBroker(
+        std::make_shared<SonarBroker>(connectionWorker, brokerPath));
+  }
+  kInstance->addPlugin(std::make_shared<SonarDiagnosticsPlugin>(
+      []() { return kInstance->getMetrics(); }));
+  if (!capturePath.empty()) {
+    try {
+      kInstance->enableOfflineCapture(
+          std::make_shared<SonarOfflineCapture>(capturePath, captureBytes),
+          callbackWorker,
+          replayBytesPerSecond);
+    } catch (std::exception& e) {
+      // The client works as it would without capture.
+      SONAR_LOG(e.what());
+    }
+  }
 }
 
 SonarClient* SonarClient::instance() {
@@ -47,34 +218,293 @@ void SonarClient::setStateListener(
   sonarState_->setUpdateListener(stateListener);
 }
 
+void SonarClient::enableOfflineCapture(
+    std::shared_ptr<SonarOfflineCapture> capture,
+    folly::EventBase* replayWorker,
+    size_t replayBytesPerSecond) {
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+  capture_ = std::move(capture);
+  replayWorker_ = replayWorker;
+  replayBytesPerTick_ = std::max<size_t>(
+      1, replayBytesPerSecond * kReplayIntervalMs / 1000);
+  const auto connections = getConnections();
+  for (const auto& iter : *getPlugins()) {
+    if (connections->find(iter.first) != connections->end()) {
+      continue;
+    }
+    if (auto conn = captureConnection(iter.second)) {
+      auto plugin = iter.second;
+      conn->dispatch([plugin, conn]() { plugin->didConnect(conn); });
+    }
+  }
+}
+
+void SonarClient::setMemoryBudget(std::shared_ptr<SonarMemoryBudget> budget) {
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+  memoryBudget_ = std::move(budget);
+  for (const auto& iter : *getPlugins()) {
+    setShedHandler(iter.second);
+  }
+}
+
+void SonarClient::setWatchdog(std::shared_ptr<SonarWatchdog> watchdog) {
+  watchdog_ = std::move(watchdog);
+}
+
+void SonarClient::onAppBackground() {
+  {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    if (inBackground_) {
+      return;
+    }
+    inBackground_ = true;
+    for (const auto& iter : *getConnections()) {
+      iter.second->setBackgroundLimit(backgroundSendLimit_);
+    }
+  }
+  sonarState_->incrementCounter("Backgrounded");
+  socket_->setInBackground(true);
+}
+
+void SonarClient::onAppForeground() {
+  {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    if (!inBackground_) {
+      return;
+    }
+    inBackground_ = false;
+    for (const auto& iter : *getConnections()) {
+      iter.second->setBackgroundLimit(folly::none);
+    }
+  }
+  socket_->setInBackground(false);
+}
+
+void SonarClient::setWorkerThreads(
+    std::vector<std::unique_ptr<SonarEventBaseThread>> threads) {
+  workerThreads_ = std::move(threads);
+}
+
+void SonarClient::setBroker(std::shared_ptr<SonarBroker> broker) {
+  broker_ = std::move(broker);
+  broker_->start([this](std::unique_ptr<folly::IOBuf> message) {
+    socket_->sendSerialized(std::move(message));
+  });
+}
+
+bool SonarClient::forwardToBroker(
+    const std::string& method,
+    const dynamic& params,
+    const dynamic& message) {
+  if (method == "cancel") {
+    // Whichever process has the call cancels it, the others ignore it.
+    broker_->broadcast(folly::IOBuf::copyBuffer(folly::toJson(message)));
+    return false;
+  }
+  if (!params.isObject()) {
+    return false;
+  }
+  const auto target =
+      params.get_ptr(method == kExecuteMethod ? "api" : "plugin");
+  if (!target || !target->isString() || hasPlugin(target->getString())) {
+    return false;
+  }
+  return broker_->forward(
+      target->getString(), folly::IOBuf::copyBuffer(folly::toJson(message)));
+}
+
+std::shared_ptr<SonarMemoryBudget> SonarClient::memoryBudget() {
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+  return memoryBudget_;
+}
+
+void SonarClient::setShedHandler(const std::shared_ptr<SonarPlugin>& plugin) {
+  if (!memoryBudget_) {
+    return;
+  }
+  // Runs on the budget's executor.
+  std::weak_ptr<SonarPlugin> weakPlugin = plugin;
+  memoryBudget_->setShedHandler(
+      plugin->identifier(), [this, weakPlugin](size_t bytes) {
+        if (auto plugin = weakPlugin.lock()) {
+          shedPluginMemory(std::move(plugin), bytes);
+        }
+      });
+}
+
+void SonarClient::shedPluginMemory(
+    std::shared_ptr<SonarPlugin> plugin,
+    size_t bytes) {
+  const auto connections = getConnections();
+  const auto& iter = connections->find(plugin->identifier());
+  if (iter != connections->end()) {
+    iter->second->dispatch([plugin, bytes]() { plugin->shedMemory(bytes); });
+  } else {
+    plugin->shedMemory(bytes);
+  }
+}
+
+size_t SonarClient::onMemoryPressure(SonarMemoryPressure level) {
+  const bool low = level == SonarMemoryPressure::low;
+  const auto budget = memoryBudget();
+  for (const auto& iter : *getPlugins()) {
+    size_t bytes = SIZE_MAX;
+    if (low) {
+      // Without a budget there's no telling what half of it would be.
+      bytes = budget ? budget->bytes(iter.first) / 2 : 0;
+    }
+    if (bytes > 0) {
+      shedPluginMemory(iter.second, bytes);
+    }
+  }
+  size_t released =
+      blobs_->shed(low ? blobs_->bytes() / 2 : blobs_->bytes());
+  released += socket_->onMemoryPressure(level);
+  memoryPressureReports_++;
+  memoryPressureReleased_ += released;
+  sonarState_->incrementCounter("Memory pressure reports");
+  return released;
+}
+
+std::shared_ptr<SonarConnectionImpl> SonarClient::captureConnection(
+    const std::shared_ptr<SonarPlugin>& plugin) {
+  if (!capture_ || !plugin->runInBackground()) {
+    return nullptr;
+  }
+  auto conn = std::make_shared<SonarConnectionImpl>(
+      socket_.get(),
+      plugin->identifier(),
+      pluginSerialExecutor(plugin->identifier()),
+      capture_,
+      blobs_,
+      errors_);
+  conn->setWatchdog(watchdog_.get());
+  conn->setMetricsWorker(refreshWorker_);
+  captureConnections_[plugin->identifier()] = conn;
+  return conn;
+}
+
+folly::Executor::KeepAlive<folly::SerialExecutor>
+SonarClient::pluginSerialExecutor(const std::string& identifier) {
+  auto iter = pluginExecutors_.find(identifier);
+  if (iter == pluginExecutors_.end()) {
+    iter = pluginExecutors_
+               .emplace(
+                   identifier,
+                   folly::SerialExecutor::create(
+                       folly::getKeepAliveToken(pluginExecutor_.get())))
+               .first;
+  }
+  return folly::getKeepAliveToken(iter->second.get());
+}
+
+void SonarClient::replayCaptured(
+    std::shared_ptr<SonarOfflineCapture> capture,
+    const std::string& identifier,
+    std::weak_ptr<SonarConnectionImpl> weakConn) {
+  // Stops once the desktop is done with the plugin, the rest is replayed the
+  // next time it initializes it.
+  const auto conn = weakConn.lock();
+  const auto connections = getConnections();
+  const auto& iter = connections->find(identifier);
+  if (!conn || iter == connections->end() || iter->second != conn) {
+    return;
+  }
+  folly::EventBase* worker;
+  size_t bytesPerTick;
+  {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    worker = replayWorker_;
+    bytesPerTick = replayBytesPerTick_;
+  }
+
+  auto events = capture->take(identifier, worker ? bytesPerTick : SIZE_MAX);
+  if (events.empty()) {
+    return;
+  }
+  // Replayed as they were sent, the plugin's current limits don't apply.
+  for (auto& event : events) {
+    conn->sendRawAdmitted(event.method, std::move(event.params));
+  }
+  if (worker) {
+    worker->runInEventBaseThread(
+        [this, worker, capture, identifier, weakConn]() {
+          worker->runAfterDelay(
+              [this, capture, identifier, weakConn]() {
+                replayCaptured(capture, identifier, weakConn);
+              },
+              kReplayIntervalMs);
+        });
+  }
+}
+
 void SonarClient::addPlugin(std::shared_ptr<SonarPlugin> plugin) {
-  SONAR_LOG(("SonarClient::addPlugin " + plugin->identifier()).c_str());
-  auto step = sonarState_->start("Add plugin " + plugin->identifier());
+  addPlugins({std::move(plugin)});
+}
 
-  std::lock_guard<std::mutex> lock(mutex_);
-  performAndReportError([this, plugin, step]() {
-    if (plugins_.find(plugin->identifier()) != plugins_.end()) {
-      throw std::out_of_range(
-          "plugin " + plugin->identifier() + " already added.");
+void SonarClient::addPlugins(
+    std::vector<std::shared_ptr<SonarPlugin>> added) {
+  std::vector<std::shared_ptr<SonarStep>> steps;
+  for (const auto& plugin : added) {
+    SONAR_LOG(("SonarClient::addPlugin " + plugin->identifier()).c_str());
+    steps.push_back(
+        sonarState_->start(SonarStepId::addPlugin, plugin->identifier()));
+  }
+
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+  performAndReportError([this, &added, &steps]() {
+    // One copy of the snapshot for all of them.
+    auto plugins = std::make_shared<PluginMap>(*getPlugins());
+    for (const auto& plugin : added) {
+      if (!plugins->emplace(plugin->identifier(), plugin).second) {
+        throw std::out_of_range(
+            "plugin " + plugin->identifier() + " already added.");
+      }
     }
-    plugins_[plugin->identifier()] = plugin;
-    step->complete();
-    if (connected_) {
+    std::atomic_store(&plugins_, std::shared_ptr<const PluginMap>(plugins));
+    for (const auto& plugin : added) {
+      setShedHandler(plugin);
+      if (auto conn = captureConnection(plugin)) {
+        conn->dispatch([plugin, conn]() { plugin->didConnect(conn); });
+      }
+    }
+    for (const auto& step : steps) {
+      step->complete();
+    }
+    if (connected_ && !added.empty()) {
       refreshPlugins();
     }
   });
 }
 
+void SonarClient::addPluginFactory(
+    const std::string& identifier,
+    SonarPluginFactory factory) {
+  addPlugin(std::make_shared<SonarLazyPlugin>(identifier, std::move(factory)));
+}
+
 void SonarClient::removePlugin(std::shared_ptr<SonarPlugin> plugin) {
   SONAR_LOG(("SonarClient::removePlugin " + plugin->identifier()).c_str());
 
-  std::lock_guard<std::mutex> lock(mutex_);
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
   performAndReportError([this, plugin]() {
-    if (plugins_.find(plugin->identifier()) == plugins_.end()) {
+    auto plugins = std::make_shared<PluginMap>(*getPlugins());
+    if (plugins->find(plugin->identifier()) == plugins->end()) {
       throw std::out_of_range("plugin " + plugin->identifier() + " not added.");
     }
+    plugins->erase(plugin->identifier());
+    std::atomic_store(&plugins_, std::shared_ptr<const PluginMap>(plugins));
+    if (memoryBudget_) {
+      memoryBudget_->setShedHandler(plugin->identifier(), nullptr);
+    }
     disconnect(plugin);
-    plugins_.erase(plugin->identifier());
+    const auto& capturing = captureConnections_.find(plugin->identifier());
+    if (capturing != captureConnections_.end()) {
+      capturing->second->dispatch([plugin]() { plugin->didDisconnect(); });
+      captureConnections_.erase(capturing);
+    }
+    // Whatever is queued keeps it alive until it has run.
+    pluginExecutors_.erase(plugin->identifier());
     if (connected_) {
       refreshPlugins();
     }
@@ -83,140 +513,873 @@ void SonarClient::removePlugin(std::shared_ptr<SonarPlugin> plugin) {
 
 std::shared_ptr<SonarPlugin> SonarClient::getPlugin(
     const std::string& identifier) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (plugins_.find(identifier) == plugins_.end()) {
+  const auto plugins = getPlugins();
+  const auto& iter = plugins->find(identifier);
+  if (iter == plugins->end()) {
     return nullptr;
   }
-  return plugins_.at(identifier);
+  if (auto lazy = std::dynamic_pointer_cast<SonarLazyPlugin>(iter->second)) {
+    return lazy->instance();
+  }
+  return iter->second;
 }
 
 bool SonarClient::hasPlugin(const std::string& identifier) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return plugins_.find(identifier) != plugins_.end();
+  const auto plugins = getPlugins();
+  return plugins->find(identifier) != plugins->end();
+}
+
+std::shared_ptr<const SonarClient::PluginMap> SonarClient::getPlugins() const {
+  return std::atomic_load(&plugins_);
+}
+
+std::shared_ptr<const SonarClient::ConnectionMap> SonarClient::getConnections()
+    const {
+  return std::atomic_load(&connections_);
 }
 
 void SonarClient::disconnect(std::shared_ptr<SonarPlugin> plugin) {
-  const auto& conn = connections_.find(plugin->identifier());
-  if (conn != connections_.end()) {
-    connections_.erase(plugin->identifier());
-    plugin->didDisconnect();
+  auto connections = getConnections();
+  const auto& iter = connections->find(plugin->identifier());
+  if (iter != connections->end()) {
+    auto conn = iter->second;
+    auto updated = std::make_shared<ConnectionMap>(*connections);
+    updated->erase(plugin->identifier());
+    std::atomic_store(
+        &connections_, std::shared_ptr<const ConnectionMap>(updated));
+    teardown(detach(plugin, std::move(conn)));
   }
 }
 
+SonarClient::Teardown SonarClient::detach(
+    const std::shared_ptr<SonarPlugin>& plugin,
+    std::shared_ptr<SonarConnectionImpl> conn) {
+  // Plugins that run in the background go back to capturing, unless they
+  // are being removed.
+  auto capturing =
+      hasPlugin(plugin->identifier()) ? captureConnection(plugin) : nullptr;
+  return Teardown{plugin, std::move(conn), std::move(capturing)};
+}
+
+void SonarClient::teardown(Teardown detached, std::function<void()> done) {
+  // Queued behind any calls still pending for this plugin. Its blobs were
+  // for the desktop that is gone.
+  auto conn = detached.conn;
+  conn->dispatch([detached = std::move(detached),
+                  done = std::move(done),
+                  blobs = blobs_]() {
+    auto guard = folly::makeGuard([&done]() {
+      if (done) {
+        done();
+      }
+    });
+    const auto& plugin = detached.plugin;
+    const auto& capturing = detached.capturing;
+    plugin->didDisconnect();
+    blobs->releaseAll(plugin->identifier());
+    if (capturing) {
+      capturing->dispatch(
+          [plugin, capturing]() { plugin->didConnect(capturing); });
+    }
+  });
+}
+
 void SonarClient::refreshPlugins() {
-  dynamic message = dynamic::object("method", "refreshPlugins");
-  socket_->sendMessage(message);
+  if (!refreshWorker_) {
+    socket_->sendMessage(dynamic::object("method", "refreshPlugins"));
+    return;
+  }
+  // Plugins added and removed one after the other, e.g. while the app
+  // starts, make the desktop fetch them once.
+  if (refreshScheduled_.exchange(true)) {
+    return;
+  }
+  refreshWorker_->runInEventBaseThread([this]() {
+    refreshScheduled_ = false;
+    socket_->sendMessage(dynamic::object("method", "refreshPlugins"));
+  });
+}
+
+void SonarClient::setInFlightRequests(
+    std::shared_ptr<SonarInFlightRequests> inFlight) {
+  inFlight->setExpiredHandler([this](
+                                  int64_t id,
+                                  const std::string& method,
+                                  const std::string& reason) {
+    // Answered like a cancel, so the desktop isn't left waiting.
+    respondWithError(
+        id,
+        dynamic::object("message", reason)("method", method)("expired", true));
+  });
+  inFlight_ = std::move(inFlight);
+}
+
+void SonarClient::scheduleRequestExpiry() {
+  if (!refreshWorker_ || inFlight_->timeout().count() == 0 ||
+      expiryScheduled_.exchange(true)) {
+    return;
+  }
+  refreshWorker_->runInEventBaseThread([this]() {
+    refreshWorker_->runAfterDelay(
+        [this]() { expireRequests(); }, inFlight_->timeout().count());
+  });
+}
+
+void SonarClient::expireRequests() {
+  const auto now = SonarInFlightRequests::Clock::now();
+  if (const auto next = inFlight_->expire(now)) {
+    const auto delay =
+        std::chrono::duration_cast<std::chrono::milliseconds>(*next - now);
+    refreshWorker_->runAfterDelay(
+        [this]() { expireRequests(); },
+        std::max<uint32_t>(delay.count(), 1));
+    return;
+  }
+  expiryScheduled_ = false;
+  // A request may have started after the sweep and before the flag was
+  // cleared, without scheduling one.
+  if (inFlight_->size() > 0) {
+    scheduleRequestExpiry();
+  }
+}
+
+void SonarClient::setRefreshWorker(folly::EventBase* worker) {
+  refreshWorker_ = worker;
+  errors_->setFlushWorker(worker);
 }
 
 void SonarClient::onConnected() {
   SONAR_LOG("SonarClient::onConnected");
 
-  std::lock_guard<std::mutex> lock(mutex_);
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
   connected_ = true;
+  if (broker_) {
+    broker_->setDesktopConnected(true);
+  }
 }
 
 void SonarClient::onDisconnected() {
   SONAR_LOG("SonarClient::onDisconnected");
-  auto step = sonarState_->start("Trigger onDisconnected callbacks");
-  std::lock_guard<std::mutex> lock(mutex_);
-  connected_ = false;
-  performAndReportError([this, step]() {
-    for (const auto& iter : plugins_) {
-      disconnect(iter.second);
-    }
-    step->complete();
-  });
+  auto step = sonarState_->start(SonarStepId::triggerOnDisconnected);
+  std::vector<Teardown> teardowns;
+  {
+    // Only long enough to empty the registry in one go, plugin code runs
+    // once the lock is released.
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    connected_ = false;
+    if (broker_) {
+      broker_->setDesktopConnected(false);
+    }
+    performAndReportError([this, &teardowns]() {
+      const auto connections = getConnections();
+      std::atomic_store(
+          &connections_,
+          std::shared_ptr<const ConnectionMap>(
+              std::make_shared<ConnectionMap>()));
+      const auto plugins = getPlugins();
+      teardowns.reserve(connections->size());
+      for (const auto& iter : *connections) {
+        const auto& plugin = plugins->find(iter.first);
+        if (plugin != plugins->end()) {
+          teardowns.push_back(detach(plugin->second, iter.second));
+        }
+      }
+    });
+  }
+  // Each plugin is torn down on its own executor, in parallel with the
+  // others and with the reconnect. The step completes when the last is done.
+  auto pending = std::make_shared<std::atomic<size_t>>(teardowns.size() + 1);
+  auto done = [step, pending]() {
+    if (--*pending == 0) {
+      step->complete();
+    }
+  };
+  for (auto& teardown : teardowns) {
+    this->teardown(std::move(teardown), done);
+  }
+  done();
+}
+
+const SonarClient::MethodHandlerMap& SonarClient::methodHandlers() {
+  static const MethodHandlerMap handlers{
+      {"getPlugins", &SonarClient::handleGetPlugins},
+      {"init", &SonarClient::handleInit},
+      {"deinit", &SonarClient::handleDeinit},
+      {"initMany", &SonarClient::handleInitMany},
+      {"deinitMany", &SonarClient::handleDeinitMany},
+      {"execute", &SonarClient::handleExecute},
+      {"setSendLimit", &SonarClient::handleSetSendLimit},
+      {"setSubscriptions", &SonarClient::handleSetSubscriptions},
+      {"getSendStats", &SonarClient::handleGetSendStats},
+      {"cancel", &SonarClient::handleCancel},
+      {"getTimeline", &SonarClient::handleGetTimeline},
+  };
+  return handlers;
 }
 
 void SonarClient::onMessageReceived(const dynamic& message) {
-  std::lock_guard<std::mutex> lock(mutex_);
+  // Routing reads the plugin and connection snapshots without locking. Plugin
+  // code runs on the plugin's connection executor.
+  SONAR_TRACE_SECTION("SonarClient::onMessageReceived");
+  SonarWatchdog::Scope watched(watchdog_.get(), "onMessageReceived");
   performAndReportError([this, &message]() {
-    const auto& method = message["method"];
-    const auto& params = message.getDefault("params");
+    if (broker_ &&
+        forwardToBroker(
+            message["method"].getString(),
+            message.getDefault("params"),
+            message)) {
+      return;
+    }
 
     std::unique_ptr<SonarResponderImpl> responder;
-    if (message.find("id") != message.items().end()) {
-      responder.reset(
-          new SonarResponderImpl(socket_.get(), message["id"].getInt()));
+    if (const auto id = message.get_ptr("id")) {
+      responder.reset(new SonarResponderImpl(socket_.get(), id->getInt()));
     }
+    route(message, std::move(responder));
+  });
+}
 
-    if (method == "getPlugins") {
-      dynamic identifiers = dynamic::array();
-      for (const auto& elem : plugins_) {
-        identifiers.push_back(elem.first);
-      }
-      dynamic response = dynamic::object("plugins", identifiers);
-      responder->success(response);
+void SonarClient::onRequestReceived(
+    const dynamic& message,
+    std::shared_ptr<SonarReply> reply) {
+  SONAR_TRACE_SECTION("SonarClient::onRequestReceived");
+  SonarWatchdog::Scope watched(watchdog_.get(), "onRequestReceived");
+  try {
+    const auto& method = message["method"].getString();
+    if (broker_ && isForBroker(method, message.getDefault("params"))) {
+      // Other processes answer with the id of the call, which this one
+      // doesn't have. The desktop makes it again the old way.
+      reply->error(dynamic::object(
+          "message", "Plugin runs in another process")("fallback", true));
       return;
     }
+    const auto id = nextReplyID_.fetch_sub(1);
+    trackReply(id, reply);
+    route(message, std::make_unique<SonarResponderImpl>(reply, id));
+  } catch (std::exception& e) {
+    reportError(e.what());
+    reply->error(dynamic::object("message", e.what()));
+  }
+}
 
-    if (method == "init") {
-      const auto identifier = params["plugin"].getString();
-      if (plugins_.find(identifier) == plugins_.end()) {
-        throw std::out_of_range(
-            "plugin " + identifier + " not found for method " +
-            method.getString());
+void SonarClient::route(
+    const dynamic& message,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto& method = message["method"].getString();
+  const auto& params = message.getDefault("params");
+
+  // execute makes up nearly all inbound traffic, so it skips the table.
+  if (method == kExecuteMethod) {
+    handleExecute(method, params, std::move(responder));
+    return;
+  }
+
+  const auto& handlers = methodHandlers();
+  const auto& handler = handlers.find(method);
+  if (handler != handlers.end()) {
+    (this->*(handler->second))(method, params, std::move(responder));
+    return;
+  }
+
+  dynamic response =
+      dynamic::object("message", "Received unknown method: " + method);
+  responder->error(response);
+}
+
+void SonarClient::trackReply(
+    int64_t id,
+    const std::shared_ptr<SonarReply>& reply) {
+  std::lock_guard<std::mutex> lock(repliesMutex_);
+  // Replies are released once answered, their entries are swept out once
+  // there are twice as many as after the previous sweep.
+  if (replies_.size() >= repliesPruneThreshold_) {
+    for (auto iter = replies_.begin(); iter != replies_.end();) {
+      if (iter->second.expired()) {
+        iter = replies_.erase(iter);
+      } else {
+        ++iter;
       }
-      const auto plugin = plugins_.at(identifier);
-      auto& conn = connections_[plugin->identifier()];
-      conn = std::make_shared<SonarConnectionImpl>(
-          socket_.get(), plugin->identifier());
-      plugin->didConnect(conn);
-      return;
     }
+    repliesPruneThreshold_ =
+        std::max(kMinRepliesBeforePruning, replies_.size() * 2);
+  }
+  replies_[id] = reply;
+}
 
-    if (method == "deinit") {
-      const auto identifier = params["plugin"].getString();
-      if (plugins_.find(identifier) == plugins_.end()) {
-        throw std::out_of_range(
-            "plugin " + identifier + " not found for method " +
-            method.getString());
-      }
-      const auto plugin = plugins_.at(identifier);
-      disconnect(plugin);
+std::shared_ptr<SonarReply> SonarClient::takeReply(int64_t id) {
+  std::lock_guard<std::mutex> lock(repliesMutex_);
+  const auto iter = replies_.find(id);
+  if (iter == replies_.end()) {
+    return nullptr;
+  }
+  auto reply = iter->second.lock();
+  replies_.erase(iter);
+  return reply;
+}
+
+void SonarClient::respondWithError(int64_t id, const dynamic& error) {
+  if (id >= 0) {
+    SonarResponderImpl(socket_.get(), id).error(error);
+  } else if (auto reply = takeReply(id)) {
+    reply->error(error);
+  }
+}
+
+bool SonarClient::isForBroker(const std::string& method, const dynamic& params) {
+  if (!params.isObject()) {
+    return false;
+  }
+  const auto target =
+      params.get_ptr(method == kExecuteMethod ? "api" : "plugin");
+  if (!target || !target->isString() || hasPlugin(target->getString())) {
+    return false;
+  }
+  const auto plugins = broker_->plugins();
+  return std::find(plugins.begin(), plugins.end(), target->getString()) !=
+      plugins.end();
+}
+
+void SonarClient::onRawMessageReceived(const SonarRawJson& message) {
+  SONAR_TRACE_SECTION("SonarClient::onRawMessageReceived");
+  performAndReportError([this, &message]() {
+    const auto envelope = message.fields();
+    const auto method = SonarRawJson::field(envelope, "method").asString();
+    if (method != kExecuteMethod) {
+      // Everything but execute is small and rare.
+      onMessageReceived(message.parse());
       return;
     }
+    SonarWatchdog::Scope watched(watchdog_.get(), "onRawMessageReceived");
 
-    if (method == "execute") {
-      const auto identifier = params["api"].getString();
-      if (connections_.find(identifier) == connections_.end()) {
-        throw std::out_of_range(
-            "connection " + identifier + " not found for method " +
-            method.getString());
-      }
-      const auto& conn = connections_.at(params["api"].getString());
-      conn->call(
-          params["method"].getString(),
-          params.getDefault("params"),
-          std::move(responder));
-      return;
+    std::unique_ptr<SonarResponderImpl> responder;
+    const auto id = SonarRawJson::field(envelope, "id");
+    if (!id.empty()) {
+      responder.reset(
+          new SonarResponderImpl(socket_.get(), id.parse().getInt()));
     }
 
-    dynamic response =
-        dynamic::object("message", "Received unknown method: " + method);
-    responder->error(response);
+    // Only the target is read here. The receiver's params stay unparsed
+    // until the call runs on the plugin's executor.
+    const auto params = SonarRawJson::field(envelope, "params").fields();
+    const auto identifier = SonarRawJson::field(params, "api").asString();
+    if (broker_ && !hasPlugin(identifier) &&
+        broker_->forward(
+            identifier,
+            folly::IOBuf::copyBuffer(
+                message.json().data(), message.json().size()))) {
+      return;
+    }
+    const auto connections = getConnections();
+    const auto& iter = connections->find(identifier);
+    if (iter == connections->end()) {
+      throw std::out_of_range(
+          "connection " + identifier + " not found for method " + method);
+    }
+    auto receiver = SonarRawJson::field(params, "method").asString();
+    if (responder) {
+      responder->setStats(iter->second->stats());
+      responder->setInFlight(inFlight_, identifier + "." + receiver);
+      scheduleRequestExpiry();
+    }
+    iter->second->call(
+        std::move(receiver),
+        SonarRawJson::field(params, "params"),
+        std::move(responder));
   });
 }
 
-void SonarClient::performAndReportError(const std::function<void()>& func) {
+void SonarClient::onStreamRequested(
+    const dynamic& message,
+    std::shared_ptr<SonarStreamResponder> responder) {
   try {
-    func();
+    const auto& params = message["params"];
+    if (message.getDefault("method") == "getBlob") {
+      blobs_->stream(
+          params["id"].asString(),
+          params.getDefault("chunkSize", 0).asInt(),
+          *responder);
+      return;
+    }
+    const auto& identifier = params["api"].getString();
+    const auto connections = getConnections();
+    const auto& iter = connections->find(identifier);
+    if (iter == connections->end()) {
+      throw std::out_of_range(
+          "connection " + identifier + " not found for stream request");
+    }
+    iter->second->callStream(
+        params["method"].getString(),
+        params.getDefault("params"),
+        std::move(responder));
   } catch (std::exception& e) {
-    if (connected_) {
-      dynamic message = dynamic::object(
-          "error",
-          dynamic::object("message", e.what())("stacktrace", "<none>"));
-      socket_->sendMessage(message);
+    responder->error(dynamic::object("message", e.what()));
+  }
+}
+
+void SonarClient::handleGetPlugins(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  dynamic identifiers = dynamic::array();
+  const auto plugins = getPlugins();
+  for (const auto& elem : *plugins) {
+    identifiers.push_back(elem.first);
+  }
+  if (broker_) {
+    for (const auto& identifier : broker_->plugins()) {
+      if (plugins->find(identifier) == plugins->end()) {
+        identifiers.push_back(identifier);
+      }
+    }
+  }
+  dynamic response = dynamic::object("plugins", identifiers);
+  responder->success(response);
+}
+
+void SonarClient::handleInit(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto& identifier = params["plugin"].getString();
+  Attachment attached;
+  std::shared_ptr<SonarOfflineCapture> capture;
+  {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    const auto plugins = getPlugins();
+    const auto& iter = plugins->find(identifier);
+    if (iter == plugins->end()) {
+      throw std::out_of_range(
+          "plugin " + identifier + " not found for method " + method);
+    }
+    auto connections = std::make_shared<ConnectionMap>(*getConnections());
+    attached = attach(identifier, iter->second, *connections);
+    std::atomic_store(
+        &connections_, std::shared_ptr<const ConnectionMap>(connections));
+    capture = capture_;
+  }
+  start(std::move(attached), std::move(capture));
+}
+
+void SonarClient::handleDeinit(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto& identifier = params["plugin"].getString();
+  SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+  const auto plugins = getPlugins();
+  const auto& iter = plugins->find(identifier);
+  if (iter == plugins->end()) {
+    throw std::out_of_range(
+        "plugin " + identifier + " not found for method " + method);
+  }
+  disconnect(iter->second);
+}
+
+void SonarClient::handleInitMany(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  // The plugins are set up in one pass under the lock, and then connect in
+  // parallel, each on its own executor. Plugins of other processes get an
+  // init of their own, the response lists the ones no process has.
+  std::vector<Attachment> attachments;
+  std::vector<std::string> forwarded;
+  std::shared_ptr<SonarOfflineCapture> capture;
+  dynamic missing = dynamic::array;
+  {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    const auto plugins = getPlugins();
+    auto connections = std::make_shared<ConnectionMap>(*getConnections());
+    for (const auto& plugin : params["plugins"]) {
+      const auto& identifier = plugin.getString();
+      const auto& iter = plugins->find(identifier);
+      if (iter != plugins->end()) {
+        attachments.push_back(attach(identifier, iter->second, *connections));
+      } else if (broker_) {
+        forwarded.push_back(identifier);
+      } else {
+        missing.push_back(identifier);
+      }
+    }
+    std::atomic_store(
+        &connections_, std::shared_ptr<const ConnectionMap>(connections));
+    capture = capture_;
+  }
+  for (auto& attached : attachments) {
+    start(std::move(attached), capture);
+  }
+  for (const auto& identifier : forwarded) {
+    const auto message = dynamic::object("method", "init")(
+        "params", dynamic::object("plugin", identifier));
+    if (!broker_->forward(
+            identifier, folly::IOBuf::copyBuffer(folly::toJson(message)))) {
+      missing.push_back(identifier);
+    }
+  }
+  if (responder) {
+    responder->success(dynamic::object("missing", std::move(missing)));
+  }
+}
+
+void SonarClient::handleDeinitMany(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  std::vector<Teardown> teardowns;
+  std::vector<std::string> forwarded;
+  {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    const auto plugins = getPlugins();
+    const auto connections = getConnections();
+    auto updated = std::make_shared<ConnectionMap>(*connections);
+    for (const auto& plugin : params["plugins"]) {
+      const auto& identifier = plugin.getString();
+      const auto& pluginIter = plugins->find(identifier);
+      if (pluginIter == plugins->end()) {
+        if (broker_) {
+          forwarded.push_back(identifier);
+        }
+        continue;
+      }
+      const auto& iter = connections->find(identifier);
+      if (iter != connections->end()) {
+        updated->erase(identifier);
+        teardowns.push_back(detach(pluginIter->second, iter->second));
+      }
+    }
+    std::atomic_store(
+        &connections_, std::shared_ptr<const ConnectionMap>(updated));
+  }
+  // Each on its own executor, in parallel with the others.
+  for (auto& teardown : teardowns) {
+    this->teardown(std::move(teardown));
+  }
+  for (const auto& identifier : forwarded) {
+    const auto message = dynamic::object("method", "deinit")(
+        "params", dynamic::object("plugin", identifier));
+    broker_->forward(
+        identifier, folly::IOBuf::copyBuffer(folly::toJson(message)));
+  }
+  if (responder) {
+    responder->success(dynamic::object());
+  }
+}
+
+SonarClient::Attachment SonarClient::attach(
+    const std::string& identifier,
+    std::shared_ptr<SonarPlugin> plugin,
+    ConnectionMap& connections) {
+  auto conn = std::make_shared<SonarConnectionImpl>(
+      socket_.get(),
+      identifier,
+      pluginSerialExecutor(identifier),
+      nullptr,
+      blobs_,
+      errors_);
+  conn->setWatchdog(watchdog_.get());
+  conn->setMetricsWorker(refreshWorker_);
+  if (inBackground_) {
+    conn->setBackgroundLimit(backgroundSendLimit_);
+  }
+  connections[identifier] = conn;
+  Attachment attached{identifier, std::move(plugin), std::move(conn), nullptr};
+  const auto& iter = captureConnections_.find(identifier);
+  if (iter != captureConnections_.end()) {
+    attached.capturing = iter->second;
+    captureConnections_.erase(iter);
+  }
+  return attached;
+}
+
+void SonarClient::start(
+    Attachment attached,
+    std::shared_ptr<SonarOfflineCapture> capture) {
+  const auto plugin = attached.plugin;
+  const auto conn = attached.conn;
+  if (!attached.capturing) {
+    conn->dispatch([plugin, conn]() { plugin->didConnect(conn); });
+    if (capture) {
+      replayCaptured(capture, attached.identifier, conn);
+    }
+    return;
+  }
+  // Replayed once the plugin has stopped capturing, so that nothing it
+  // captured is left behind.
+  std::weak_ptr<SonarConnectionImpl> weakConn = conn;
+  const auto identifier = attached.identifier;
+  attached.capturing->dispatch(
+      [this, plugin, conn, capture, identifier, weakConn]() {
+        plugin->didDisconnect();
+        conn->dispatch([plugin, conn]() { plugin->didConnect(conn); });
+        replayCaptured(capture, identifier, weakConn);
+      });
+}
+
+void SonarClient::handleExecute(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto& identifier = params["api"].getString();
+  const auto connections = getConnections();
+  const auto& iter = connections->find(identifier);
+  if (iter == connections->end()) {
+    throw std::out_of_range(
+        "connection " + identifier + " not found for method " + method);
+  }
+  if (responder) {
+    responder->setStats(iter->second->stats());
+    responder->setInFlight(
+        inFlight_, identifier + "." + params["method"].getString());
+    scheduleRequestExpiry();
+  }
+  iter->second->call(
+      params["method"].getString(),
+      params.getDefault("params"),
+      std::move(responder));
+}
+
+void SonarClient::handleSetSendLimit(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto& identifier = params["plugin"].getString();
+  const auto connections = getConnections();
+  const auto& iter = connections->find(identifier);
+  if (iter == connections->end()) {
+    throw std::out_of_range(
+        "connection " + identifier + " not found for method " + method);
+  }
+  // Without either value the plugin's own limit applies again.
+  const auto& maxPerSecond = params.getDefault("maxPerSecond");
+  const auto& sampleRate = params.getDefault("sampleRate");
+  folly::Optional<SonarSendLimit> limit;
+  if (!maxPerSecond.isNull() || !sampleRate.isNull()) {
+    limit = SonarSendLimit();
+    if (!maxPerSecond.isNull()) {
+      limit->maxPerSecond = maxPerSecond.asDouble();
+    }
+    if (!sampleRate.isNull()) {
+      limit->sampleRate = sampleRate.asDouble();
+    }
+  }
+  iter->second->overrideSendLimit(params["method"].getString(), limit);
+  if (responder) {
+    responder->success(dynamic::object());
+  }
+}
+
+void SonarClient::handleSetSubscriptions(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto& identifier = params["plugin"].getString();
+  const auto connections = getConnections();
+  const auto& iter = connections->find(identifier);
+  if (iter == connections->end()) {
+    throw std::out_of_range(
+        "connection " + identifier + " not found for method " + method);
+  }
+  // Without methods the plugin sends all of its events again.
+  const auto& methods = params.getDefault("methods");
+  folly::Optional<std::unordered_set<std::string>> subscriptions;
+  if (!methods.isNull()) {
+    subscriptions.emplace();
+    for (const auto& subscribed : methods) {
+      subscriptions->insert(subscribed.getString());
     }
   }
+  iter->second->setSubscriptions(std::move(subscriptions));
+  if (responder) {
+    responder->success(dynamic::object());
+  }
+}
+
+void SonarClient::handleGetSendStats(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  dynamic suppressed = dynamic::object();
+  for (const auto& iter : *getConnections()) {
+    auto events = iter.second->suppressedEvents();
+    if (!events.empty()) {
+      suppressed[iter.first] = std::move(events);
+    }
+  }
+  responder->success(dynamic::object("suppressed", std::move(suppressed)));
+}
+
+void SonarClient::handleCancel(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  const auto id = params["id"].getInt();
+  const bool cancelled = inFlight_->cancel(id);
+  if (cancelled) {
+    // Answered right away, so the desktop isn't left waiting on receivers
+    // that abandon the work. Their responses aren't sent anymore.
+    respondWithError(
+        id, dynamic::object("message", "Cancelled")("cancelled", true));
+  }
+  if (responder) {
+    responder->success(dynamic::object("cancelled", cancelled));
+  }
+}
+
+void SonarClient::handleGetTimeline(
+    const std::string& method,
+    const dynamic& params,
+    std::unique_ptr<SonarResponderImpl> responder) {
+  if (responder) {
+    responder->success(getTimeline());
+  }
+}
+
+dynamic SonarClient::getMetrics() {
+  const auto dropped = socket_->droppedMessages();
+  dynamic plugins = dynamic::object();
+  for (const auto& iter : *getConnections()) {
+    auto metrics = iter.second->stats()->toDynamic();
+    metrics["suppressed"] = iter.second->suppressedEvents();
+    const auto& count = dropped.find(iter.first);
+    metrics["dropped"] = count != dropped.end() ? count->second : 0;
+    plugins[iter.first] = std::move(metrics);
+  }
+  dynamic metrics = dynamic::object("plugins", std::move(plugins))(
+      "largestMessages",
+      largestMessages(SonarConnectionStats::kLargestMessages));
+  if (const auto budget = memoryBudget()) {
+    metrics["memory"] = budget->usage();
+  }
+  if (watchdog_) {
+    metrics["blocked"] = watchdog_->reports();
+  }
+  auto previousSession = socket_->previousSessionFrames();
+  if (!previousSession.isNull()) {
+    metrics["previousSession"] = std::move(previousSession);
+  }
+  if (const auto reports = memoryPressureReports_.load()) {
+    metrics["memoryPressure"] = dynamic::object("reports", reports)(
+        "releasedBytes", memoryPressureReleased_.load());
+  }
+  metrics["requests"] = inFlight_->toDynamic();
+  if (!workerThreads_.empty()) {
+    dynamic threads = dynamic::array();
+    for (const auto& thread : workerThreads_) {
+      threads.push_back(thread->report());
+    }
+    metrics["threads"] = std::move(threads);
+  }
+#if FB_SONAR_LOCK_PROFILING
+  metrics["locks"] = sonarLockProfile();
+#endif
+  return metrics;
+}
+
+dynamic SonarClient::largestMessages(size_t count) {
+  std::vector<std::tuple<size_t, std::string, std::string>> largest;
+  for (const auto& iter : *getConnections()) {
+    for (auto& message : iter.second->stats()->largestMessages()) {
+      largest.emplace_back(
+          message.first, iter.first, std::move(message.second));
+    }
+  }
+  std::sort(largest.begin(), largest.end(), [](const auto& a, const auto& b) {
+    return std::get<0>(a) > std::get<0>(b);
+  });
+  dynamic messages = dynamic::array();
+  for (size_t i = 0; i < largest.size() && i < count; i++) {
+    messages.push_back(dynamic::object("plugin", std::get<1>(largest[i]))(
+        "method", std::get<2>(largest[i]))("bytes", std::get<0>(largest[i])));
+  }
+  return messages;
+}
+
+void SonarClient::reportError(const std::string& message) {
+  if (connected_) {
+    errors_->report("SonarClient", message, "<none>");
+  }
 }
 
 std::string SonarClient::getState() {
   return sonarState_->getState();
 }
 
+std::string SonarClient::getTrace() {
+  return sonarState_->getTrace();
+}
+
+constexpr size_t SonarClient::kTimelineFields;
+constexpr size_t SonarClient::kMinRepliesBeforePruning;
+
+dynamic SonarClient::getTimeline() {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  const auto entries = sonarState_->getLogEntries();
+  dynamic counters = dynamic::object();
+  for (const auto& counter : sonarState_->getCounters()) {
+    counters[counter.first] = counter.second;
+  }
+  if (entries.empty()) {
+    return dynamic::object("origin", 0)("names", dynamic::array())(
+        "steps", dynamic::array())("errors", dynamic::object())(
+        "counters", std::move(counters));
+  }
+  // Steps are timed on the monotonic clock, only when they finished is
+  // known on the wall clock. The earliest start is placed on it once and
+  // everything else is relative to it.
+  const auto earliest = std::min_element(
+      entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        return a.started < b.started;
+      });
+  const auto origin =
+      duration_cast<microseconds>(earliest->time.time_since_epoch()) -
+      duration_cast<microseconds>(earliest->finished - earliest->started);
+  std::unordered_map<std::string, size_t> nameIndices;
+  dynamic names = dynamic::array();
+  dynamic steps = dynamic::array();
+  dynamic errors = dynamic::object();
+  for (size_t i = 0; i < entries.size(); i++) {
+    const auto& entry = entries[i];
+    const auto inserted = nameIndices.emplace(entry.step, names.size());
+    if (inserted.second) {
+      names.push_back(entry.step);
+    }
+    steps.push_back(inserted.first->second);
+    steps.push_back(static_cast<int64_t>(entry.state));
+    steps.push_back(
+        duration_cast<microseconds>(entry.started - earliest->started)
+            .count());
+    steps.push_back(
+        duration_cast<microseconds>(entry.finished - entry.started).count());
+    steps.push_back(entry.id);
+    steps.push_back(entry.parentId);
+    if (entry.state == State::failed) {
+      errors[folly::to<std::string>(i)] = entry.message;
+    }
+  }
+  return dynamic::object("origin", origin.count())("names", std::move(names))(
+      "steps", std::move(steps))("errors", std::move(errors))(
+      "counters", std::move(counters));
+}
+
 std::vector<StateElement> SonarClient::getStateElements() {
-  return sonarState_->getStateElements();
+  auto elements = sonarState_->getStateElements();
+  // Counters are listed after the steps, so they show up in the same
+  // summary as the connection progress.
+  for (const auto& counter : sonarState_->getCounters()) {
+    elements.push_back(StateElement(
+        counter.first + ": " + folly::to<std::string>(counter.second),
+        State::success));
+  }
+  // The few largest events, to tell where compression or blobs would help.
+  for (const auto& message : largestMessages(kLargestMessagesInState)) {
+    elements.push_back(StateElement(
+        "Largest event: " + message["plugin"].getString() + "." +
+            message["method"].getString() + " " +
+            folly::to<std::string>(message["bytes"].asInt()) + " bytes",
+        State::success));
+  }
+  return elements;
 }
 
 } // namespace sonar
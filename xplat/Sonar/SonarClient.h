@@ -8,13 +8,28 @@
 
 #pragma once
 
+#include <Sonar/SonarBlobStore.h>
+#include <Sonar/SonarBroker.h>
 #include <Sonar/SonarConnectionImpl.h>
+#include <Sonar/SonarErrorReporter.h>
+#include <Sonar/SonarEventBaseThread.h>
+#include <Sonar/SonarInFlightRequests.h>
 #include <Sonar/SonarInitConfig.h>
+#include <Sonar/SonarLazyPlugin.h>
+#include <Sonar/SonarMemoryBudget.h>
+#include <Sonar/SonarMutex.h>
 #include <Sonar/SonarPlugin.h>
+#include <Sonar/SonarResponderImpl.h>
 #include <Sonar/SonarState.h>
+#include <Sonar/SonarWatchdog.h>
 #include <Sonar/SonarWebSocket.h>
+#include <folly/executors/InlineExecutor.h>
+#include <folly/executors/SerialExecutor.h>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <mutex>
+#include <unordered_map>
 #include "SonarStep.h"
 #include <vector>
 
@@ -40,46 +55,214 @@ class SonarClient : public SonarWebSocket::Callbacks {
   /**
    Only public for testing
    */
-  SonarClient(std::unique_ptr<SonarWebSocket> socket, std::shared_ptr<SonarState> state)
-      : socket_(std::move(socket)), sonarState_(state) {
-    auto step = sonarState_->start("Create client");
+  SonarClient(
+      std::unique_ptr<SonarWebSocket> socket,
+      std::shared_ptr<SonarState> state,
+      std::shared_ptr<folly::Executor> pluginExecutor =
+          std::make_shared<folly::InlineExecutor>())
+      : socket_(std::move(socket)),
+        sonarState_(state),
+        pluginExecutor_(std::move(pluginExecutor)),
+        errors_(std::make_shared<SonarErrorReporter>(socket_.get())) {
+    auto step = sonarState_->start(SonarStepId::createClient);
     socket_->setCallbacks(this);
+    setInFlightRequests(std::make_shared<SonarInFlightRequests>());
     step->complete();
   }
 
   void start() {
-    auto step = sonarState_->start("Start client");
+    auto step = sonarState_->start(SonarStepId::startClient);
     socket_->start();
     step->complete();
   }
 
   void stop() {
-    auto step = sonarState_->start("Stop client");
+    auto step = sonarState_->start(SonarStepId::stopClient);
     socket_->stop();
     step->complete();
   }
 
+  void connectivityChanged() {
+    socket_->connectivityChanged();
+  }
+
+  /**
+   Called by the platform when the app goes to the background and when it
+   comes back to the foreground, see SonarInitConfig::pauseEventsInBackground.
+   */
+  void onAppBackground();
+  void onAppForeground();
+
+  /**
+   Called by the platform when the system is short of memory. Releases what
+   the client and its plugins hold as level asks, see SonarMemoryPressure.
+   Returns the bytes the client released itself. Plugins shed on their own
+   threads, what they free shows in the memory budget's usage. Both are
+   recorded in the metrics under "memoryPressure".
+   */
+  size_t onMemoryPressure(SonarMemoryPressure level);
+
+  /**
+   The limit applied to the events of every method while the app is in the
+   background. Set once before the client starts.
+   */
+  void setBackgroundSendLimit(SonarSendLimit limit) {
+    backgroundSendLimit_ = limit;
+  }
+
   void onConnected() override;
 
   void onDisconnected() override;
 
   void onMessageReceived(const folly::dynamic& message) override;
 
+  void onRawMessageReceived(const SonarRawJson& message) override;
+
+  void onRequestReceived(
+      const folly::dynamic& message,
+      std::shared_ptr<SonarReply> reply) override;
+
+  void onStreamRequested(
+      const folly::dynamic& message,
+      std::shared_ptr<SonarStreamResponder> responder) override;
+
+  /**
+   Connect plugins that run in the background to capture while no desktop
+   has initialized them, and replay what they captured once one does. With
+   replayWorker, replay is spread out to replayBytesPerSecond on it, all of
+   it is sent at once otherwise.
+   */
+  void enableOfflineCapture(
+      std::shared_ptr<SonarOfflineCapture> capture,
+      folly::EventBase* replayWorker,
+      size_t replayBytesPerSecond);
+
+  /**
+   Account what plugins buffer in budget, and ask them to shed data when it
+   goes over its soft limit.
+   */
+  void setMemoryBudget(std::shared_ptr<SonarMemoryBudget> budget);
+
+  /**
+   Budget plugins should account their buffers in, see SonarEventBuffer. Null
+   unless set up by init or setMemoryBudget.
+   */
+  std::shared_ptr<SonarMemoryBudget> memoryBudget();
+
+  /**
+   Share the desktop connection with the app's other processes through
+   broker. Their plugins are listed with this process's own, which win when
+   both have a plugin.
+   */
+  void setBroker(std::shared_ptr<SonarBroker> broker);
+
+  /**
+   Report plugin tasks, and messages from the desktop, that keep their thread
+   busy for too long through watchdog, see SonarWatchdog. Set once before
+   the client starts.
+   */
+  void setWatchdog(std::shared_ptr<SonarWatchdog> watchdog);
+
+  /**
+   Keep the threads the client's workers run on for as long as the client,
+   and report how they were set up with the metrics. Set once before the
+   client starts.
+   */
+  void setWorkerThreads(
+      std::vector<std::unique_ptr<SonarEventBaseThread>> threads);
+
+  /**
+   Track the desktop's requests in inFlight, answering the ones it gives up
+   on with an error. Their deadlines are checked on the event base set by
+   setRefreshWorker, without which requests only give up to stay within
+   inFlight's maximum. Set once before the client starts.
+   */
+  void setInFlightRequests(std::shared_ptr<SonarInFlightRequests> inFlight);
+
   void addPlugin(std::shared_ptr<SonarPlugin> plugin);
 
+  /**
+   Add several plugins at once, e.g. all of an app's plugins at startup. The
+   desktop is only asked once to fetch the plugins again. If any of them is
+   already added, none are.
+   */
+  void addPlugins(std::vector<std::shared_ptr<SonarPlugin>> plugins);
+
+  /**
+   Add a plugin that is only built by factory once the desktop initializes
+   it, or once it is asked for with getPlugin. The desktop is told about it
+   under identifier right away. See SonarLazyPlugin.
+   */
+  void addPluginFactory(
+      const std::string& identifier,
+      SonarPluginFactory factory);
+
   void removePlugin(std::shared_ptr<SonarPlugin> plugin);
 
+  /**
+   Ask the desktop to fetch the plugins again. With an event base set by
+   setRefreshWorker, requests made during one iteration of its loop are sent
+   as one.
+   */
   void refreshPlugins();
 
+  /**
+   Also flushes the counts of repeated errors, see SonarErrorReporter, and
+   the metrics of the connections attached after it is set, see
+   SonarMetrics.
+   */
+  void setRefreshWorker(folly::EventBase* worker);
+
   void setStateListener(
       std::shared_ptr<SonarStateUpdateListener> stateListener);
 
+  /**
+   The plugin added under identifier, building it if it was added with a
+   factory and isn't built yet.
+   */
   std::shared_ptr<SonarPlugin> getPlugin(const std::string& identifier);
 
   std::string getState();
 
+  /**
+   Recent connection steps and their timings in Chrome trace event format.
+   */
+  std::string getTrace();
+
+  /**
+   Recent connection steps as compact columns, which the desktop gets from
+   the getTimeline method. "names" lists each step name once and "steps"
+   holds kTimelineFields integers per step, oldest first: its name's index,
+   its State, when it started and how long it took, both in microseconds
+   with the start relative to "origin", the wall clock time in
+   microseconds of the earliest start, then its id and its parent's id, 0
+   for top level steps. The errors of failed steps are in "errors" by the
+   step's position and the counters in "counters". Sent as BSER once the
+   desktop negotiated it, so the columns cost a few bytes per step.
+   */
+  folly::dynamic getTimeline();
+  static constexpr size_t kTimelineFields = 6;
+
   std::vector<StateElement> getStateElements();
 
+  /**
+   Traffic of each initialized plugin: messages and bytes each way, receiver
+   and response latency histograms, receiver wall and CPU time and sent
+   sizes by method, queue depth, and events suppressed by send limits or
+   dropped by the socket's send queue. The largest events of all plugins
+   are under "largestMessages". With a memory budget, its usage is under
+   "memory", with a watchdog, its latest reports are under "blocked", and
+   with native workers, how their threads were set up is under "threads",
+   and memory pressure reports are under "memoryPressure". The desktop's
+   requests in flight, timed out and evicted, and the latency percentiles
+   of their responses by plugin and method are under "requests". With a
+   flight recorder, the last frames of a session that crashed are under
+   "previousSession".
+   Built with FB_SONAR_LOCK_PROFILING, the profile of the client's and
+   connections' locks is under "locks".
+   */
+  folly::dynamic getMetrics();
+
   template <typename P>
   std::shared_ptr<P> getPlugin(const std::string& identifier) {
     return std::static_pointer_cast<P>(getPlugin(identifier));
@@ -89,15 +272,208 @@ class SonarClient : public SonarWebSocket::Callbacks {
 
  private:
   static SonarClient* instance_;
-  bool connected_ = false;
+  std::atomic<bool> connected_{false};
   std::unique_ptr<SonarWebSocket> socket_;
-  std::map<std::string, std::shared_ptr<SonarPlugin>> plugins_;
-  std::map<std::string, std::shared_ptr<SonarConnectionImpl>> connections_;
-  std::mutex mutex_;
+  using PluginMap = std::map<std::string, std::shared_ptr<SonarPlugin>>;
+  using ConnectionMap =
+      std::unordered_map<std::string, std::shared_ptr<SonarConnectionImpl>>;
+
+  /**
+   The plugin and connection registries are immutable snapshots. Readers load
+   the current snapshot atomically and never block. Writers serialize on
+   mutex_, copy the snapshot and atomically publish the modified copy.
+   */
+  std::shared_ptr<const PluginMap> plugins_ = std::make_shared<PluginMap>();
+  std::shared_ptr<const ConnectionMap> connections_ =
+      std::make_shared<ConnectionMap>();
+  SonarMutex mutex_{"SonarClient::mutex_"};
+  // Guarded by mutex_, like the connections of plugins running in the
+  // background until a desktop initializes them.
+  std::shared_ptr<SonarOfflineCapture> capture_;
+  std::shared_ptr<SonarMemoryBudget> memoryBudget_;
+  folly::EventBase* replayWorker_ = nullptr;
+  folly::EventBase* refreshWorker_ = nullptr;
+  std::atomic<bool> refreshScheduled_{false};
+  size_t replayBytesPerTick_ = 0;
+  std::unordered_map<std::string, std::shared_ptr<SonarConnectionImpl>>
+      captureConnections_;
+  // Shared by every connection of a plugin, so that a connection's teardown
+  // still running when the desktop initializes the plugin again comes first.
+  std::unordered_map<
+      std::string,
+      folly::Executor::KeepAlive<folly::SerialExecutor>>
+      pluginExecutors_;
   std::shared_ptr<SonarState> sonarState_;
+  std::shared_ptr<folly::Executor> pluginExecutor_;
+  // execute requests that haven't been responded to, for cancel and
+  // timeouts. Set once before the client starts, see setInFlightRequests.
+  std::shared_ptr<SonarInFlightRequests> inFlight_;
+  std::atomic<bool> expiryScheduled_{false};
+  // Calls made as a request-response have no id of their own, they are
+  // tracked in inFlight_ under negative ones. Their replies are kept here
+  // weakly, to answer them when they are given up on.
+  std::atomic<int64_t> nextReplyID_{-1};
+  std::mutex repliesMutex_;
+  std::unordered_map<int64_t, std::weak_ptr<SonarReply>> replies_;
+  size_t repliesPruneThreshold_ = kMinRepliesBeforePruning;
+  static constexpr size_t kMinRepliesBeforePruning = 64;
+  // Blobs plugins registered for the desktop to fetch with getBlob streams.
+  std::shared_ptr<SonarBlobStore> blobs_ = std::make_shared<SonarBlobStore>();
+  // Shared with the connections, so that repeated errors are sent once.
+  std::shared_ptr<SonarErrorReporter> errors_;
+  // Set once before the client starts, see setBroker.
+  std::shared_ptr<SonarBroker> broker_;
+  // Set once before the client starts, see setWatchdog.
+  std::shared_ptr<SonarWatchdog> watchdog_;
+  // Set once before the client starts, see setWorkerThreads.
+  std::vector<std::unique_ptr<SonarEventBaseThread>> workerThreads_;
+  // Guarded by mutex_, see onAppBackground.
+  bool inBackground_ = false;
+  SonarSendLimit backgroundSendLimit_;
+  // Memory pressure reports so far, and the bytes released on them.
+  std::atomic<size_t> memoryPressureReports_{0};
+  std::atomic<size_t> memoryPressureReleased_{0};
+
+  using MethodHandler = void (SonarClient::*)(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  using MethodHandlerMap = std::unordered_map<std::string, MethodHandler>;
+
+  /**
+   Handlers for the methods the desktop can call on the client, built once.
+   */
+  static const MethodHandlerMap& methodHandlers();
+
+  void handleGetPlugins(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleInit(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleDeinit(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleInitMany(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleDeinitMany(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleExecute(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleSetSendLimit(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleSetSubscriptions(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleGetSendStats(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleCancel(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void handleGetTimeline(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponderImpl> responder);
+
+  std::shared_ptr<const PluginMap> getPlugins() const;
+  std::shared_ptr<const ConnectionMap> getConnections() const;
+
+  // Runs the handler of message's method.
+  void route(
+      const folly::dynamic& message,
+      std::unique_ptr<SonarResponderImpl> responder);
+  void trackReply(int64_t id, const std::shared_ptr<SonarReply>& reply);
+  std::shared_ptr<SonarReply> takeReply(int64_t id);
+  // Answers the request with id with error, whichever way it was made.
+  void respondWithError(int64_t id, const folly::dynamic& error);
+  // Whether message is for a plugin of another process.
+  bool isForBroker(const std::string& method, const folly::dynamic& params);
+
+  // Passes messages for the plugins of other processes on to their process.
+  // Returns whether message was one of them.
+  bool forwardToBroker(
+      const std::string& method,
+      const folly::dynamic& params,
+      const folly::dynamic& message);
+
+  // Takes func as it is rather than wrapping it in a std::function, it runs
+  // for every message.
+  template <typename Func>
+  void performAndReportError(Func&& func) {
+    try {
+      func();
+    } catch (std::exception& e) {
+      reportError(e.what());
+    }
+  }
+  void reportError(const std::string& message);
+  // Ask plugin to shed bytes, on its connection's executor when connected
+  // so that it doesn't race its own receivers.
+  void shedPluginMemory(std::shared_ptr<SonarPlugin> plugin, size_t bytes);
+  // Give up on requests past their deadline until none are left in flight.
+  void scheduleRequestExpiry();
+  void expireRequests();
+
+  // The largest events sent by any initialized plugin, largest first.
+  folly::dynamic largestMessages(size_t count);
+  static constexpr size_t kLargestMessagesInState = 3;
+  // A plugin's connection that was taken out of the registry, to be torn
+  // down outside of mutex_.
+  struct Teardown {
+    std::shared_ptr<SonarPlugin> plugin;
+    std::shared_ptr<SonarConnectionImpl> conn;
+    std::shared_ptr<SonarConnectionImpl> capturing;
+  };
+
+  // A plugin's new connection made by init, to be started outside of
+  // mutex_.
+  struct Attachment {
+    std::string identifier;
+    std::shared_ptr<SonarPlugin> plugin;
+    std::shared_ptr<SonarConnectionImpl> conn;
+    // The connection it was capturing on until now, if any.
+    std::shared_ptr<SonarConnectionImpl> capturing;
+  };
 
-  void performAndReportError(const std::function<void()>& func);
+  // Makes plugin's connection and adds it to connections, which the caller
+  // then stores. Called with mutex_ held.
+  Attachment attach(
+      const std::string& identifier,
+      std::shared_ptr<SonarPlugin> plugin,
+      ConnectionMap& connections);
+  // Connects the plugin on its executor, then replays what was captured.
+  void start(
+      Attachment attached,
+      std::shared_ptr<SonarOfflineCapture> capture);
   void disconnect(std::shared_ptr<SonarPlugin> plugin);
+  Teardown detach(
+      const std::shared_ptr<SonarPlugin>& plugin,
+      std::shared_ptr<SonarConnectionImpl> conn);
+  void teardown(Teardown detached, std::function<void()> done = nullptr);
+  folly::Executor::KeepAlive<folly::SerialExecutor> pluginSerialExecutor(
+      const std::string& identifier);
+  void setShedHandler(const std::shared_ptr<SonarPlugin>& plugin);
+  std::shared_ptr<SonarConnectionImpl> captureConnection(
+      const std::shared_ptr<SonarPlugin>& plugin);
+  void replayCaptured(
+      std::shared_ptr<SonarOfflineCapture> capture,
+      const std::string& identifier,
+      std::weak_ptr<SonarConnectionImpl> conn);
 };
 
 } // namespace sonar
@@ -8,9 +8,20 @@
 
 #pragma once
 
+#include <Sonar/SonarDeltaEncoder.h>
+#include <Sonar/SonarMetrics.h>
 #include <Sonar/SonarResponder.h>
+#include <Sonar/SonarSendLimiter.h>
+#include <Sonar/SonarSerialize.h>
+#include <Sonar/SonarSnapshotWriter.h>
+#include <Sonar/SonarStreamResponder.h>
+#include <folly/Range.h>
+#include <folly/executors/InlineExecutor.h>
+#include <folly/futures/Future.h>
+#include <folly/io/IOBuf.h>
 #include <folly/json.h>
 #include <functional>
+#include <stdexcept>
 #include <string>
 
 namespace facebook {
@@ -24,6 +35,14 @@ class SonarConnection {
  public:
   using SonarReceiver = std::function<
       void(const folly::dynamic&, std::unique_ptr<SonarResponder>)>;
+  using SonarRawReceiver = std::function<
+      void(folly::StringPiece, std::unique_ptr<SonarResponder>)>;
+  using SonarStreamReceiver = std::function<
+      void(const folly::dynamic&, std::shared_ptr<SonarStreamResponder>)>;
+  using SonarAsyncReceiver =
+      std::function<folly::SemiFuture<folly::dynamic>(const folly::dynamic&)>;
+  using SonarParamsBuilder = std::function<folly::dynamic()>;
+  using SonarSnapshotProvider = std::function<void(SonarSnapshotWriter&)>;
 
   virtual ~SonarConnection() {}
 
@@ -34,6 +53,97 @@ class SonarConnection {
       const std::string& method,
       const folly::dynamic& params) = 0;
 
+  /**
+  Same as send, but params are already serialized as JSON. Meant for bulk
+  payloads produced outside of C++, which are framed as they are instead of
+  being parsed and serialized again.
+  */
+  virtual void sendRaw(
+      const std::string& method,
+      std::unique_ptr<folly::IOBuf> params) {
+    send(method, folly::parseJson(params->moveToFbString()));
+  }
+
+  /**
+  Same as send, but params is a struct listing its fields with SONAR_FIELDS.
+  It is written straight to JSON, without being converted to a dynamic
+  first. Derived classes need a using declaration to call it.
+  */
+  template <
+      typename T,
+      typename = typename std::enable_if<SonarHasFields<T>::value>::type>
+  void send(const std::string& method, const T& params) {
+    if (admit(method)) {
+      sendRawAdmitted(method, folly::IOBuf::copyBuffer(serializeJson(params)));
+    }
+  }
+
+  /**
+  Limit how often events of the given method are sent, see SonarSendLimit.
+  Events over the limit are dropped. The desktop can override the limit
+  while it is connected.
+  */
+  virtual void setSendLimit(const std::string& method, SonarSendLimit limit) {}
+
+  /**
+  Send events of the given method as patches of the previous event's params
+  rather than in full, for events that repeat the same shaped object with a
+  few fields changed, such as periodic metrics. The whole params go out
+  every keyframeInterval events, see SonarDeltaEncoder. The desktop
+  reassembles them, and waits for the next keyframe after a gap in their
+  sequence, e.g. one dropped by a full send queue. Only applies to send and
+  sendLazy, sendRaw's params are always sent as they are.
+  */
+  virtual void sendDeltas(
+      const std::string& method,
+      size_t keyframeInterval = SonarDeltaEncoder::kDefaultKeyframeInterval) {}
+
+  /**
+  Whether an event of the given method would be sent now. send and sendRaw
+  check this themselves. Callers whose params are expensive to produce can
+  ask first, and then send with sendAdmitted or sendRawAdmitted so the event
+  isn't counted twice. Events the desktop isn't subscribed to are never
+  admitted.
+  */
+  virtual bool admit(const std::string& method) {
+    return true;
+  }
+
+  /**
+  Whether the desktop wants events of the given method. Desktops that don't
+  declare which methods they want get all of them. Unlike admit it doesn't
+  count as sending an event, so plugins can ask before doing any work for
+  events nobody would look at.
+  */
+  virtual bool isSubscribed(const std::string& method) {
+    return true;
+  }
+
+  virtual void sendAdmitted(
+      const std::string& method,
+      const folly::dynamic& params) {
+    send(method, params);
+  }
+
+  virtual void sendRawAdmitted(
+      const std::string& method,
+      std::unique_ptr<folly::IOBuf> params) {
+    sendRaw(method, std::move(params));
+  }
+
+  /**
+  Same as send, but params are only built by calling builder if the event
+  is admitted while a desktop is connected. The builder runs later, on the
+  connection's executor rather than the calling thread, so it must not
+  refer to anything the caller may have changed or freed by then. Lazy
+  events are in order with each other, but not with events sent otherwise.
+  */
+  virtual void sendLazy(const std::string& method, SonarParamsBuilder builder) {
+    if (admit(method)) {
+      sendAdmitted(method, builder());
+    }
+  }
+
   /**
   Report an error to the Sonar desktop app
   */
@@ -48,6 +158,154 @@ class SonarConnection {
   virtual void receive(
       const std::string& method,
       const SonarReceiver& receiver) = 0;
+
+  /**
+  Same as receive, but the receiver gets the params as unparsed JSON, which
+  is only valid for the duration of the call. Meant for receivers that hand
+  params on to another layer as a string anyway. Registering a method with
+  receive or receiveRaw replaces a receiver registered with the other.
+  */
+  virtual void receiveRaw(
+      const std::string& method,
+      const SonarRawReceiver& receiver) = 0;
+
+  /**
+  Same as receive, but the params are read straight from the JSON text into
+  a struct listing its fields with SONAR_FIELDS, without building a
+  folly::dynamic. Params that don't fit the struct are reported to the
+  desktop as an error, like an exception thrown by the receiver.
+  */
+  template <
+      typename Params,
+      typename Receiver,
+      typename = typename std::enable_if<SonarHasFields<Params>::value>::type>
+  void receive(const std::string& method, Receiver receiver) {
+    receiveRaw(
+        method,
+        [receiver = std::move(receiver)](
+            folly::StringPiece params,
+            std::unique_ptr<SonarResponder> responder) {
+          receiver(deserializeJson<Params>(params), std::move(responder));
+        });
+  }
+
+  /**
+  Register a receiver for incoming calls of the given method that respond
+  with a stream of chunks rather than a single response.
+  */
+  virtual void receiveStream(
+      const std::string& method,
+      const SonarStreamReceiver& receiver) = 0;
+
+  /**
+  Let the desktop fetch the plugin's whole state in one go when it
+  (re)connects, instead of rebuilding it from many small requests. It asks
+  for a stream of the "snapshot" method, with an optional chunkSize param,
+  and gets what provider writes as a single compressed stream, see
+  SonarSnapshotWriter. The stream is completed once provider returns, an
+  exception thrown by it ends the stream with an error carrying its message.
+  */
+  void receiveSnapshot(const SonarSnapshotProvider& provider) {
+    receiveStream(
+        "snapshot",
+        [provider](
+            const folly::dynamic& params,
+            std::shared_ptr<SonarStreamResponder> responder) {
+          SonarSnapshotWriter writer(
+              std::move(responder),
+              params.isObject()
+                  ? params.getDefault("chunkSize", 0).asInt()
+                  : 0);
+          try {
+            provider(writer);
+            writer.finish();
+          } catch (std::exception& e) {
+            writer.error(folly::dynamic::object("message", e.what()));
+          }
+        });
+  }
+
+  /**
+  Cache the responses to calls of the given method, by their params. Calls
+  with params seen before are answered with the response serialized then,
+  without calling the receiver. Only for methods whose responses don't
+  change until the plugin invalidates them.
+  */
+  virtual void cacheResponses(const std::string& method) {}
+
+  /**
+  Forget the responses cached for the given method, e.g. because the data
+  they describe changed.
+  */
+  virtual void invalidateCachedResponses(const std::string& method) {}
+
+  /**
+  Hand bytes such as an image or a network body to the client, returning an
+  id to send in their place. The desktop fetches them by id when it needs
+  them, in binary chunks on a stream of their own, instead of receiving them
+  inlined in the message as base64. Blobs are kept until released, until the
+  desktop disconnects, or until newer blobs need the room.
+  */
+  virtual std::string registerBlob(std::unique_ptr<folly::IOBuf> blob) {
+    throw std::runtime_error("Blobs aren't supported by this connection");
+  }
+
+  virtual void releaseBlob(const std::string& id) {}
+
+  /**
+  A histogram of a measurement taken too often for an event each, such as
+  frame times. Samples are recorded without locking and summarized on the
+  device, then sent as a single event of the given method per interval, see
+  SonarMetrics. The same histogram for every call with the same method.
+  */
+  virtual std::shared_ptr<SonarHistogram> histogram(const std::string& method) {
+    throw std::runtime_error("Metrics aren't supported by this connection");
+  }
+
+  /**
+  Same as histogram, for a count of occurrences, sent as its increase over
+  each interval.
+  */
+  virtual std::shared_ptr<SonarCounter> counter(const std::string& method) {
+    throw std::runtime_error("Metrics aren't supported by this connection");
+  }
+
+  /**
+  Same as receive, but the receiver returns its response as a future rather
+  than calling a responder. It only occupies the connection's executor until
+  it returns, the response is sent from wherever the future completes. A
+  future failing with an exception responds with an error carrying its
+  message. Coroutine receivers can return their task as a SemiFuture.
+  */
+  virtual void receiveAsync(
+      const std::string& method,
+      const SonarAsyncReceiver& receiver) {
+    receive(
+        method,
+        [receiver](
+            const folly::dynamic& params,
+            std::unique_ptr<SonarResponder> responder) {
+          respondWhenDone(receiver(params), std::move(responder));
+        });
+  }
+
+ protected:
+  static void respondWhenDone(
+      folly::SemiFuture<folly::dynamic> response,
+      std::unique_ptr<SonarResponder> responder) {
+    std::move(response)
+        .via(&folly::InlineExecutor::instance())
+        .thenTry([responder = std::shared_ptr<SonarResponder>(
+                      std::move(responder))](
+                     folly::Try<folly::dynamic>&& result) {
+          if (result.hasValue()) {
+            responder->success(result.value());
+          } else {
+            responder->error(folly::dynamic::object(
+                "message", result.exception().what().toStdString()));
+          }
+        });
+  }
 };
 
 } // namespace sonar
@@ -0,0 +1,169 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarConnectionFactory.h"
+#include <folly/io/async/AsyncSSLSocket.h>
+#include <rsocket/transports/tcp/TcpConnectionFactory.h>
+
+namespace facebook {
+namespace sonar {
+
+SonarTLSSessionCache::~SonarTLSSessionCache() {
+  if (session_) {
+    SSL_SESSION_free(session_);
+  }
+}
+
+SSL_SESSION* SonarTLSSessionCache::get() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (session_) {
+    SSL_SESSION_up_ref(session_);
+  }
+  return session_;
+}
+
+void SonarTLSSessionCache::set(SSL_SESSION* session) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (session_) {
+    SSL_SESSION_free(session_);
+  }
+  session_ = session;
+}
+
+std::string SonarTLSSessionCache::encoded() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!session_) {
+    return "";
+  }
+  const int length = i2d_SSL_SESSION(session_, nullptr);
+  if (length <= 0) {
+    return "";
+  }
+  std::string encoded(length, '\0');
+  auto out = reinterpret_cast<unsigned char*>(&encoded[0]);
+  i2d_SSL_SESSION(session_, &out);
+  return encoded;
+}
+
+void SonarTLSSessionCache::setEncoded(const std::string& encoded) {
+  auto in = reinterpret_cast<const unsigned char*>(encoded.data());
+  SSL_SESSION* session =
+      encoded.empty() ? nullptr : d2i_SSL_SESSION(nullptr, &in, encoded.size());
+  if (session) {
+    set(session);
+  }
+}
+
+namespace {
+
+class ConnectCallback : public folly::AsyncSocket::ConnectCallback {
+ public:
+  ConnectCallback(
+      folly::EventBase& eventBase,
+      const folly::SocketAddress& address,
+      const std::shared_ptr<folly::SSLContext>& sslContext,
+      std::shared_ptr<SonarTLSSessionCache> sessions,
+      std::shared_ptr<SonarState> state,
+      std::shared_ptr<rsocket::RSocketStats> stats,
+      folly::Promise<rsocket::ConnectionFactory::ConnectedDuplexConnection>
+          promise)
+      : eventBase_(eventBase),
+        sessions_(std::move(sessions)),
+        state_(std::move(state)),
+        stats_(std::move(stats)),
+        promise_(std::move(promise)) {
+    if (sslContext) {
+      auto socket = new folly::AsyncSSLSocket(sslContext, &eventBase_);
+      if (auto session = sessions_->get()) {
+        socket->setSSLSession(session, true /* takeOwnership */);
+      }
+      sslSocket_ = socket;
+      socket_.reset(socket);
+    } else {
+      socket_.reset(new folly::AsyncSocket(&eventBase_));
+    }
+    socket_->connect(this, address);
+  }
+
+  void connectSuccess() noexcept override {
+    if (sslSocket_) {
+      // The handshake has completed by the time an SSL socket connects.
+      const bool resumed = sslSocket_->getSSLSessionReused();
+      sessions_->setResumed(resumed);
+      state_->incrementCounter(
+          resumed ? "TLS handshakes resumed" : "TLS handshakes full");
+      if (!resumed) {
+        sessions_->set(sslSocket_->getSSLSession());
+      }
+    }
+    auto connection =
+        rsocket::TcpConnectionFactory::createDuplexConnectionFromSocket(
+            std::move(socket_), stats_);
+    promise_.setValue(rsocket::ConnectionFactory::ConnectedDuplexConnection{
+        std::move(connection), eventBase_});
+    delete this;
+  }
+
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override {
+    if (sslSocket_) {
+      // Don't keep offering a session the desktop may have rejected.
+      sessions_->set(nullptr);
+    }
+    promise_.setException(ex);
+    delete this;
+  }
+
+ private:
+  folly::EventBase& eventBase_;
+  std::shared_ptr<SonarTLSSessionCache> sessions_;
+  std::shared_ptr<SonarState> state_;
+  std::shared_ptr<rsocket::RSocketStats> stats_;
+  folly::Promise<rsocket::ConnectionFactory::ConnectedDuplexConnection>
+      promise_;
+  folly::AsyncSocket::UniquePtr socket_;
+  folly::AsyncSSLSocket* sslSocket_ = nullptr;
+};
+
+} // namespace
+
+SonarConnectionFactory::SonarConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    std::shared_ptr<folly::SSLContext> sslContext,
+    std::shared_ptr<SonarTLSSessionCache> sessions,
+    std::shared_ptr<SonarState> state,
+    std::shared_ptr<rsocket::RSocketStats> stats)
+    : eventBase_(eventBase),
+      address_(std::move(address)),
+      sslContext_(std::move(sslContext)),
+      sessions_(std::move(sessions)),
+      state_(std::move(state)),
+      stats_(std::move(stats)) {}
+
+folly::Future<rsocket::ConnectionFactory::ConnectedDuplexConnection>
+SonarConnectionFactory::connect(
+    rsocket::ProtocolVersion,
+    rsocket::ResumeStatus) {
+  folly::Promise<ConnectedDuplexConnection> promise;
+  auto future = promise.getFuture();
+  eventBase_.runInEventBaseThread(
+      [this, promise = std::move(promise)]() mutable {
+        new ConnectCallback(
+            eventBase_,
+            address_,
+            sslContext_,
+            sessions_,
+            state_,
+            stats_,
+            std::move(promise));
+      });
+  return future;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,98 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarState.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/SSLContext.h>
+#include <openssl/ssl.h>
+#include <rsocket/ConnectionFactory.h>
+#include <rsocket/RSocketStats.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Holds on to the most recent TLS session negotiated with the desktop so the
+ next connection can resume it instead of doing a full handshake. Sessions are
+ only valid for the SSL context they were negotiated with, so a new cache
+ should be used whenever the context changes.
+ */
+class SonarTLSSessionCache {
+ public:
+  ~SonarTLSSessionCache();
+
+  /**
+   Returns the cached session with an added reference, or nullptr. The caller
+   owns the reference.
+   */
+  SSL_SESSION* get();
+
+  /**
+   Replaces the cached session, taking ownership of the passed reference.
+   */
+  void set(SSL_SESSION* session);
+
+  /**
+   The cached session DER encoded, or empty, to keep it across launches, see
+   SonarWarmStart. setEncoded replaces the cached session with one decoded
+   from it, ignoring what can't be.
+   */
+  std::string encoded();
+  void setEncoded(const std::string& encoded);
+
+  // Whether the last handshake resumed the cached session.
+  bool resumed() const {
+    return resumed_;
+  }
+
+  void setResumed(bool resumed) {
+    resumed_ = resumed;
+  }
+
+ private:
+  std::mutex mutex_;
+  SSL_SESSION* session_ = nullptr;
+  std::atomic<bool> resumed_{false};
+};
+
+/**
+ Same as rsocket::TcpConnectionFactory, but offers the cached session on every
+ TLS connection and records whether it was resumed.
+ */
+class SonarConnectionFactory : public rsocket::ConnectionFactory {
+ public:
+  SonarConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      std::shared_ptr<SonarTLSSessionCache> sessions,
+      std::shared_ptr<SonarState> state,
+      std::shared_ptr<rsocket::RSocketStats> stats);
+
+  folly::Future<ConnectedDuplexConnection> connect(
+      rsocket::ProtocolVersion,
+      rsocket::ResumeStatus) override;
+
+ private:
+  folly::EventBase& eventBase_;
+  const folly::SocketAddress address_;
+  const std::shared_ptr<folly::SSLContext> sslContext_;
+  const std::shared_ptr<SonarTLSSessionCache> sessions_;
+  const std::shared_ptr<SonarState> state_;
+  const std::shared_ptr<rsocket::RSocketStats> stats_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -8,39 +8,343 @@
 
 #pragma once
 
+#include <Sonar/SonarBlobStore.h>
 #include <Sonar/SonarConnection.h>
+#include <Sonar/SonarConnectionStats.h>
+#include <Sonar/SonarErrorReporter.h>
+#include <Sonar/SonarJsonWriter.h>
+#include <Sonar/SonarMetrics.h>
+#include <Sonar/SonarMutex.h>
+#include <Sonar/SonarOfflineCapture.h>
+#include <Sonar/SonarRawJson.h>
+#include <Sonar/SonarTrace.h>
+#include <Sonar/SonarWatchdog.h>
 #include <Sonar/SonarWebSocket.h>
+#include <folly/executors/SerialExecutor.h>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace facebook {
 namespace sonar {
 
-class SonarConnectionImpl : public SonarConnection {
+class SonarConnectionImpl
+    : public SonarConnection,
+      public std::enable_shared_from_this<SonarConnectionImpl> {
  public:
-  SonarConnectionImpl(SonarWebSocket* socket, const std::string& name)
-      : socket_(socket), name_(name) {}
+  /**
+  With capture, events are written to it instead of the socket, for plugins
+  that run while no desktop has initialized them.
+  */
+  SonarConnectionImpl(
+      SonarWebSocket* socket,
+      const std::string& name,
+      folly::Executor* executor,
+      std::shared_ptr<SonarOfflineCapture> capture = nullptr,
+      std::shared_ptr<SonarBlobStore> blobs = nullptr,
+      std::shared_ptr<SonarErrorReporter> errors = nullptr)
+      : SonarConnectionImpl(
+            socket,
+            name,
+            folly::SerialExecutor::create(folly::getKeepAliveToken(executor)),
+            std::move(capture),
+            std::move(blobs),
+            std::move(errors)) {}
+
+  /**
+  Runs tasks on executor, which may be shared with other connections of the
+  same plugin so that the tasks of all of them run in order.
+  */
+  SonarConnectionImpl(
+      SonarWebSocket* socket,
+      const std::string& name,
+      folly::Executor::KeepAlive<folly::SerialExecutor> executor,
+      std::shared_ptr<SonarOfflineCapture> capture = nullptr,
+      std::shared_ptr<SonarBlobStore> blobs = nullptr,
+      std::shared_ptr<SonarErrorReporter> errors = nullptr)
+      : socket_(socket),
+        name_(name),
+        executor_(std::move(executor)),
+        capture_(std::move(capture)),
+        blobs_(std::move(blobs)),
+        errors_(std::move(errors)) {}
+
+  bool capturing() const {
+    return capture_ != nullptr;
+  }
+
+  /**
+  Track the tasks of this connection with watchdog, which must outlive it.
+  Only set before the connection is used.
+  */
+  void setWatchdog(SonarWatchdog* watchdog) {
+    watchdog_ = watchdog;
+  }
+
+  /**
+  Flush the histograms and counters of this connection every interval on
+  worker, which must outlive it. Without one they are only sent by
+  flushMetrics. Only set before the connection is used.
+  */
+  void setMetricsWorker(folly::EventBase* worker) {
+    metricsWorker_ = worker;
+  }
+
+  // Traffic of this connection, shared with its responders.
+  const std::shared_ptr<SonarConnectionStats>& stats() const {
+    return stats_;
+  }
+
+  /**
+  Schedule a task on this connection's serial executor. Tasks of one
+  connection run one at a time and in order, tasks of different connections
+  may run in parallel. Exceptions thrown by the task are reported as errors.
+  */
+  void dispatch(folly::Func task) {
+    auto self = shared_from_this();
+    stats_->queued();
+    executor_->add([self, task = std::move(task)]() mutable {
+      self->stats_->dequeued();
+      SonarWatchdog::Scope watched(self->watchdog_, self->name_.c_str());
+      try {
+        task();
+      } catch (std::exception& e) {
+        self->error(e.what(), "<none>");
+      }
+    });
+  }
 
   void call(
       const std::string& method,
-      const folly::dynamic& params,
+      folly::dynamic params,
       std::unique_ptr<SonarResponder> responder) {
-    if (receivers_.find(method) == receivers_.end()) {
-      throw std::out_of_range("receiver " + method + " not found.");
-    }
-    receivers_.at(method)(params, std::move(responder));
+    // The size of parsed params isn't known without serializing them again.
+    stats_->received(0);
+    auto self = shared_from_this();
+    dispatch([self,
+              method,
+              params = std::move(params),
+              responder = std::move(responder)]() mutable {
+      SONAR_TRACE_SECTION("SonarConnection::call");
+      const auto start = std::chrono::steady_clock::now();
+      const auto cpuStart = SonarConnectionStats::threadCpuTime();
+      self->invoke(method, params, std::move(responder));
+      self->stats_->receiverRan(
+          method,
+          std::chrono::steady_clock::now() - start,
+          SonarConnectionStats::threadCpuTime() - cpuStart);
+    });
+  }
+
+  /**
+  Same as above, but params are only parsed once the call runs on the
+  connection's executor, keeping that work off the connection thread. Raw
+  receivers get them without any parsing at all.
+  */
+  void call(
+      const std::string& method,
+      SonarRawJson params,
+      std::unique_ptr<SonarResponder> responder) {
+    stats_->received(params.json().size());
+    auto self = shared_from_this();
+    dispatch([self,
+              method,
+              params = std::move(params),
+              responder = std::move(responder)]() mutable {
+      SONAR_TRACE_SECTION("SonarConnection::call");
+      const auto start = std::chrono::steady_clock::now();
+      const auto cpuStart = SonarConnectionStats::threadCpuTime();
+      self->invoke(method, params, std::move(responder));
+      self->stats_->receiverRan(
+          method,
+          std::chrono::steady_clock::now() - start,
+          SonarConnectionStats::threadCpuTime() - cpuStart);
+    });
+  }
+
+  void callStream(
+      const std::string& method,
+      folly::dynamic params,
+      std::shared_ptr<SonarStreamResponder> responder) {
+    auto self = shared_from_this();
+    dispatch([self, method, params = std::move(params), responder]() {
+      SonarStreamReceiver receiver;
+      {
+        SonarLockGuard lock(self->mutex_, SONAR_LOCK_SITE);
+        const auto& iter = self->streamReceivers_.find(method);
+        if (iter == self->streamReceivers_.end()) {
+          responder->error(folly::dynamic::object(
+              "message", "stream receiver " + method + " not found."));
+          return;
+        }
+        receiver = iter->second;
+      }
+      receiver(params, responder);
+    });
   }
 
+  using SonarConnection::receive;
+  using SonarConnection::send;
+
   void send(const std::string& method, const folly::dynamic& params) override {
-    folly::dynamic message = folly::dynamic::object("method", "execute")(
-        "params",
-        folly::dynamic::object("api", name_)("method", method)(
-            "params", params));
-    socket_->sendMessage(message);
+    if (admit(method)) {
+      sendAdmitted(method, params);
+    }
+  }
+
+  void sendRaw(
+      const std::string& method,
+      std::unique_ptr<folly::IOBuf> params) override {
+    if (admit(method)) {
+      sendRawAdmitted(method, std::move(params));
+    }
+  }
+
+  void sendLazy(const std::string& method, SonarParamsBuilder builder)
+      override {
+    // Captured events are written whether or not a desktop is connected.
+    if (!capture_ && !socket_->isOpen()) {
+      return;
+    }
+    if (!admit(method)) {
+      return;
+    }
+    auto self = shared_from_this();
+    dispatch([self, method, builder = std::move(builder)]() {
+      SONAR_TRACE_SECTION("SonarConnection::sendLazy");
+      self->sendAdmitted(method, builder());
+    });
+  }
+
+  void setSendLimit(const std::string& method, SonarSendLimit limit) override {
+    limiter_.setLimit(method, limit);
+  }
+
+  void sendDeltas(const std::string& method, size_t keyframeInterval)
+      override {
+    SonarLockGuard lock(deltaMutex_, SONAR_LOCK_SITE);
+    deltaEncoders_[method] =
+        std::make_unique<SonarDeltaEncoder>(keyframeInterval);
+    hasDeltaEncoders_ = true;
+  }
+
+  bool admit(const std::string& method) override {
+    // Unsubscribed events don't count against the limits.
+    return isSubscribed(method) && limiter_.admit(method);
+  }
+
+  bool isSubscribed(const std::string& method) override {
+    if (!subscribed_.load(std::memory_order_acquire)) {
+      return true;
+    }
+    const auto subscriptions = std::atomic_load(&subscriptions_);
+    return !subscriptions || subscriptions->count(method) > 0;
+  }
+
+  /**
+  Set by the desktop, only events of methods are sent from then on. None
+  sends all of them again.
+  */
+  void setSubscriptions(
+      folly::Optional<std::unordered_set<std::string>> methods) {
+    std::shared_ptr<const std::unordered_set<std::string>> subscriptions;
+    if (methods) {
+      subscriptions = std::make_shared<const std::unordered_set<std::string>>(
+          std::move(*methods));
+    }
+    const bool subscribed = subscriptions != nullptr;
+    std::atomic_store(&subscriptions_, std::move(subscriptions));
+    subscribed_.store(subscribed, std::memory_order_release);
+  }
+
+  /**
+  Set by the desktop, takes precedence over the plugin's limit. None goes
+  back to the plugin's.
+  */
+  void overrideSendLimit(
+      const std::string& method,
+      folly::Optional<SonarSendLimit> limit) {
+    limiter_.overrideLimit(method, std::move(limit));
+  }
+
+  /**
+  Applies to every method on top of its own limit while the app is in the
+  background. None stops applying it.
+  */
+  void setBackgroundLimit(folly::Optional<SonarSendLimit> limit) {
+    limiter_.setBackgroundLimit(std::move(limit));
+  }
+
+  // Events dropped by the limits so far, by method.
+  folly::dynamic suppressedEvents() const {
+    return limiter_.suppressed();
+  }
+
+  void sendAdmitted(const std::string& method, const folly::dynamic& params)
+      override {
+    if (capture_) {
+      stats_->sent(0);
+      capture_->append(
+          name_, method, *folly::IOBuf::copyBuffer(sonarToJson(params)));
+      return;
+    }
+    if (hasDeltaEncoders_.load(std::memory_order_acquire) &&
+        sendDelta(method, params)) {
+      return;
+    }
+    if (!socket_->sendsJson()) {
+      stats_->sent(0);
+      folly::dynamic message = folly::dynamic::object("method", "execute")(
+          "params",
+          folly::dynamic::object("api", name_)("method", method)(
+              "params", params));
+      socket_->sendMessage(std::move(message));
+      return;
+    }
+    // Params are serialized straight into the envelope, which isn't built
+    // as a dynamic for every event.
+    auto serialized = folly::IOBuf::copyBuffer(sonarToJson(params));
+    stats_->sent(method, serialized->length());
+    auto message = envelopePrefix(method);
+    message->prependChain(std::move(serialized));
+    message->prependChain(envelopeSuffix());
+    socket_->sendSerialized(std::move(message), name_);
+  }
+
+  void sendRawAdmitted(
+      const std::string& method,
+      std::unique_ptr<folly::IOBuf> params) override {
+    stats_->sent(method, params ? params->computeChainDataLength() : 0);
+    if (capture_) {
+      capture_->append(
+          name_, method, params ? *params : *folly::IOBuf::create(0));
+      return;
+    }
+    // Params are chained into the envelope without being copied.
+    auto message = envelopePrefix(method);
+    if (!params || params->computeChainDataLength() == 0) {
+      params = folly::IOBuf::wrapBuffer("null", 4);
+    }
+    message->prependChain(std::move(params));
+    message->prependChain(envelopeSuffix());
+    socket_->sendSerialized(std::move(message), name_);
   }
 
   void error(const std::string& message, const std::string& stacktrace)
       override {
+    if (capture_) {
+      // Errors are only of use to a desktop that can act on them.
+      return;
+    }
+    if (errors_) {
+      errors_->report(name_, message, stacktrace);
+      return;
+    }
     socket_->sendMessage(folly::dynamic::object(
         "error",
         folly::dynamic::object("message", message)("stacktrace", stacktrace)));
@@ -48,13 +352,378 @@ class SonarConnectionImpl : public SonarConnection {
 
   void receive(const std::string& method, const SonarReceiver& receiver)
       override {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
     receivers_[method] = receiver;
+    rawReceivers_.erase(method);
+  }
+
+  void receiveRaw(const std::string& method, const SonarRawReceiver& receiver)
+      override {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    rawReceivers_[method] = receiver;
+    receivers_.erase(method);
+  }
+
+  void receiveStream(
+      const std::string& method,
+      const SonarStreamReceiver& receiver) override {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    streamReceivers_[method] = receiver;
+  }
+
+  void cacheResponses(const std::string& method) override {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    responseCache_[method];
+    hasResponseCache_ = true;
+  }
+
+  void invalidateCachedResponses(const std::string& method) override {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    const auto& iter = responseCache_.find(method);
+    if (iter != responseCache_.end()) {
+      iter->second.generation++;
+      iter->second.responses.clear();
+    }
+  }
+
+  std::string registerBlob(std::unique_ptr<folly::IOBuf> blob) override {
+    if (!blobs_) {
+      return SonarConnection::registerBlob(std::move(blob));
+    }
+    return blobs_->put(name_, std::move(blob));
+  }
+
+  void releaseBlob(const std::string& id) override {
+    if (blobs_) {
+      blobs_->release(id);
+    }
+  }
+
+  std::shared_ptr<SonarHistogram> histogram(
+      const std::string& method) override {
+    return metrics()->histogram(method);
+  }
+
+  std::shared_ptr<SonarCounter> counter(const std::string& method) override {
+    return metrics()->counter(method);
+  }
+
+  // Send what the histograms and counters recorded since the last flush.
+  void flushMetrics() {
+    std::shared_ptr<SonarMetrics> metrics;
+    {
+      SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+      metrics = metrics_;
+    }
+    if (metrics) {
+      metrics->flush();
+    }
   }
 
  private:
+  // Created by the first metric, most connections have none.
+  std::shared_ptr<SonarMetrics> metrics() {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    if (!metrics_) {
+      // The metrics belong to the connection, they can't keep it alive.
+      std::weak_ptr<SonarConnectionImpl> weakSelf = shared_from_this();
+      metrics_ = std::make_shared<SonarMetrics>(
+          [weakSelf](const std::string& method, folly::dynamic params) {
+            if (auto self = weakSelf.lock()) {
+              self->send(method, params);
+            }
+          });
+      metrics_->setFlushWorker(metricsWorker_);
+    }
+    return metrics_;
+  }
+
+  /**
+  The start of an execute event of the given method, up to its params.
+  Serialized once per method and shared by the events' buffers.
+  */
+  std::unique_ptr<folly::IOBuf> envelopePrefix(const std::string& method) {
+    SonarLockGuard lock(envelopeMutex_, SONAR_LOCK_SITE);
+    auto& prefix = envelopePrefixes_[method];
+    if (!prefix) {
+      prefix = folly::IOBuf::copyBuffer(
+          "{\"method\":\"execute\",\"params\":{\"api\":" +
+          folly::toJson(name_) + ",\"method\":" + folly::toJson(method) +
+          ",\"params\":");
+    }
+    return prefix->clone();
+  }
+
+  static std::unique_ptr<folly::IOBuf> envelopeSuffix() {
+    return folly::IOBuf::wrapBuffer("}}", 2);
+  }
+
+  /**
+  Sends params encoded against the method's previous event, with the delta's
+  sequence next to them in the envelope. Returns false if the method isn't
+  delta encoded. The lock is held until the event is queued, so that deltas
+  are queued in the order they were encoded.
+  */
+  bool sendDelta(const std::string& method, const folly::dynamic& params) {
+    SonarLockGuard lock(deltaMutex_, SONAR_LOCK_SITE);
+    const auto& iter = deltaEncoders_.find(method);
+    if (iter == deltaEncoders_.end()) {
+      return false;
+    }
+    auto encoded = iter->second->encode(params);
+    auto delta = folly::dynamic::object("sequence", encoded.sequence)(
+        "keyframe", encoded.keyframe);
+    if (!socket_->sendsJson()) {
+      stats_->sent(0);
+      socket_->sendMessage(folly::dynamic::object("method", "execute")(
+          "params",
+          folly::dynamic::object("api", name_)("method", method)(
+              "params", std::move(encoded.params))(
+              "delta", std::move(delta))));
+      return true;
+    }
+    auto serialized = folly::IOBuf::copyBuffer(sonarToJson(encoded.params));
+    stats_->sent(method, serialized->length());
+    auto message = envelopePrefix(method);
+    message->prependChain(std::move(serialized));
+    message->prependChain(
+        folly::IOBuf::copyBuffer(",\"delta\":" + sonarToJson(delta) + "}}"));
+    socket_->sendSerialized(std::move(message), name_);
+    return true;
+  }
+
+  // Responses that are computed from scratch by each call, kept per method
+  // until invalidated. Only the latest so many params are worth keeping.
+  static constexpr size_t kMaxCachedResponses = 64;
+
+  struct ResponseCache {
+    // Bumped by invalidation, so responses computed before it aren't kept.
+    uint64_t generation = 0;
+    std::unordered_map<std::string, std::string> responses;
+  };
+
+  // Fills the cache with the response it is given before passing it on.
+  class CachingResponder : public SonarResponder {
+   public:
+    CachingResponder(
+        std::shared_ptr<SonarConnectionImpl> connection,
+        std::string method,
+        std::string params,
+        uint64_t generation,
+        std::unique_ptr<SonarResponder> responder)
+        : connection_(std::move(connection)),
+          method_(std::move(method)),
+          params_(std::move(params)),
+          generation_(generation),
+          responder_(std::move(responder)) {}
+
+    void success(const folly::dynamic& response) const override {
+      // Serialized once, for the cache and the socket alike.
+      successSerialized(sonarToJson(response));
+    }
+
+    void successSerialized(folly::StringPiece response) const override {
+      connection_->cacheResponse(method_, params_, generation_, response);
+      responder_->successSerialized(response);
+    }
+
+    void error(const folly::dynamic& response) const override {
+      responder_->error(response);
+    }
+
+    SonarCancellationToken cancellationToken() const override {
+      return responder_->cancellationToken();
+    }
+
+   private:
+    std::shared_ptr<SonarConnectionImpl> connection_;
+    std::string method_;
+    std::string params_;
+    uint64_t generation_;
+    std::unique_ptr<SonarResponder> responder_;
+  };
+
+  /**
+  Answers from the cache if the method's responses are cached and these
+  params were seen before. Otherwise responder is wrapped to fill the cache
+  if needed. Returns whether the call was answered.
+  */
+  bool respondFromCache(
+      const std::string& method,
+      folly::StringPiece params,
+      std::unique_ptr<SonarResponder>& responder) {
+    if (!responder) {
+      return false;
+    }
+    uint64_t generation;
+    std::string cached;
+    {
+      SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+      const auto& iter = responseCache_.find(method);
+      if (iter == responseCache_.end()) {
+        return false;
+      }
+      const auto& response = iter->second.responses.find(params.str());
+      if (response == iter->second.responses.end()) {
+        generation = iter->second.generation;
+      } else {
+        cached = response->second;
+      }
+    }
+    if (!cached.empty()) {
+      responder->successSerialized(cached);
+      return true;
+    }
+    responder = std::make_unique<CachingResponder>(
+        shared_from_this(),
+        method,
+        params.str(),
+        generation,
+        std::move(responder));
+    return false;
+  }
+
+  bool hasResponseCache() const {
+    return hasResponseCache_.load(std::memory_order_relaxed);
+  }
+
+  bool cachesResponses(const std::string& method) {
+    if (!hasResponseCache()) {
+      return false;
+    }
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    return responseCache_.count(method) > 0;
+  }
+
+  void cacheResponse(
+      const std::string& method,
+      const std::string& params,
+      uint64_t generation,
+      folly::StringPiece response) {
+    SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+    const auto& iter = responseCache_.find(method);
+    if (iter == responseCache_.end() ||
+        iter->second.generation != generation) {
+      return;
+    }
+    auto& responses = iter->second.responses;
+    if (responses.size() >= kMaxCachedResponses) {
+      responses.clear();
+    }
+    responses[params] = response.str();
+  }
+
+  void invoke(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponder> responder) {
+    if (cachesResponses(method) &&
+        respondFromCache(method, folly::toJson(params), responder)) {
+      return;
+    }
+    invokeReceiver(method, params, std::move(responder));
+  }
+
+  void invokeReceiver(
+      const std::string& method,
+      const folly::dynamic& params,
+      std::unique_ptr<SonarResponder> responder) {
+    SonarReceiver receiver;
+    SonarRawReceiver rawReceiver;
+    {
+      SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+      const auto& iter = receivers_.find(method);
+      const auto& rawIter = rawReceivers_.find(method);
+      if (iter != receivers_.end()) {
+        receiver = iter->second;
+      } else if (rawIter != rawReceivers_.end()) {
+        rawReceiver = rawIter->second;
+      } else {
+        throw std::out_of_range("receiver " + method + " not found.");
+      }
+    }
+    if (receiver) {
+      receiver(params, std::move(responder));
+    } else {
+      rawReceiver(folly::toJson(params), std::move(responder));
+    }
+  }
+
+  void invoke(
+      const std::string& method,
+      const SonarRawJson& params,
+      std::unique_ptr<SonarResponder> responder) {
+    // Both looked up under a single lock, a method has one or the other.
+    SonarReceiver receiver;
+    SonarRawReceiver rawReceiver;
+    {
+      SonarLockGuard lock(mutex_, SONAR_LOCK_SITE);
+      const auto& rawIter = rawReceivers_.find(method);
+      if (rawIter != rawReceivers_.end()) {
+        rawReceiver = rawIter->second;
+      } else {
+        const auto& iter = receivers_.find(method);
+        if (iter != receivers_.end()) {
+          receiver = iter->second;
+        }
+      }
+    }
+    if (hasResponseCache() &&
+        respondFromCache(
+            method,
+            params.empty() ? folly::StringPiece("null") : params.json(),
+            responder)) {
+      return;
+    }
+    if (!rawReceiver) {
+      if (!receiver) {
+        throw std::out_of_range("receiver " + method + " not found.");
+      }
+      receiver(params.parse(), std::move(responder));
+      return;
+    }
+    // Passed through as received, missing params are null like they are for
+    // parsed receivers.
+    rawReceiver(
+        params.empty() ? folly::StringPiece("null") : params.json(),
+        std::move(responder));
+  }
+
   SonarWebSocket* socket_;
   std::string name_;
+  folly::Executor::KeepAlive<folly::SerialExecutor> executor_;
+  SonarMutex mutex_{"SonarConnectionImpl::mutex_"};
   std::map<std::string, SonarReceiver> receivers_;
+  std::map<std::string, SonarRawReceiver> rawReceivers_;
+  std::map<std::string, SonarStreamReceiver> streamReceivers_;
+  std::unordered_map<std::string, ResponseCache> responseCache_;
+  // Not guarded by mutex_, which receivers are looked up under, to keep
+  // sending threads from contending with calls.
+  SonarMutex envelopeMutex_{"SonarConnectionImpl::envelopeMutex_"};
+  std::unordered_map<std::string, std::unique_ptr<folly::IOBuf>>
+      envelopePrefixes_;
+  SonarMutex deltaMutex_{"SonarConnectionImpl::deltaMutex_"};
+  std::unordered_map<std::string, std::unique_ptr<SonarDeltaEncoder>>
+      deltaEncoders_;
+  // Set once any method is delta encoded, so that other connections don't
+  // pay for looking up their events.
+  std::atomic<bool> hasDeltaEncoders_{false};
+  // Set once any method is cached, so that other connections don't pay for
+  // looking up their calls.
+  std::atomic<bool> hasResponseCache_{false};
+  SonarSendLimiter limiter_;
+  // The methods the desktop subscribed to. Until it does, subscribed_ is
+  // false and sends don't pay for loading them.
+  std::atomic<bool> subscribed_{false};
+  std::shared_ptr<const std::unordered_set<std::string>> subscriptions_;
+  std::shared_ptr<SonarOfflineCapture> capture_;
+  std::shared_ptr<SonarBlobStore> blobs_;
+  std::shared_ptr<SonarErrorReporter> errors_;
+  SonarWatchdog* watchdog_ = nullptr;
+  folly::EventBase* metricsWorker_ = nullptr;
+  std::shared_ptr<SonarMetrics> metrics_;
+  std::shared_ptr<SonarConnectionStats> stats_ =
+      std::make_shared<SonarConnectionStats>();
 };
 
 } // namespace sonar
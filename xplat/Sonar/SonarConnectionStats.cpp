@@ -0,0 +1,182 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarConnectionStats.h"
+
+#include <time.h>
+#include <algorithm>
+
+namespace facebook {
+namespace sonar {
+
+static constexpr int64_t kFirstBucketMicros = 250;
+static constexpr size_t kFirstBucketBytes = 64;
+
+constexpr size_t SonarConnectionStats::kLatencyBuckets;
+constexpr size_t SonarConnectionStats::kSizeBuckets;
+constexpr size_t SonarConnectionStats::kLargestMessages;
+
+void SonarConnectionStats::received(size_t bytes) {
+  messagesIn_.fetch_add(1, std::memory_order_relaxed);
+  bytesIn_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void SonarConnectionStats::sent(size_t bytes) {
+  messagesOut_.fetch_add(1, std::memory_order_relaxed);
+  bytesOut_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void SonarConnectionStats::sent(const std::string& method, size_t bytes) {
+  sent(bytes);
+  if (bytes == 0) {
+    // Not known, see above.
+    return;
+  }
+  size_t bucket = 0;
+  for (auto bound = kFirstBucketBytes;
+       bytes >= bound && bucket < kSizeBuckets - 1;
+       bound *= 2) {
+    bucket++;
+  }
+  std::lock_guard<std::mutex> lock(methodsMutex_);
+  auto& totals = methods_[method];
+  totals.sentBytes += bytes;
+  totals.sentSizes[bucket]++;
+  if (largest_.size() == kLargestMessages && bytes <= largest_.front().first) {
+    return;
+  }
+  const auto entry = std::make_pair(bytes, method);
+  largest_.insert(
+      std::upper_bound(largest_.begin(), largest_.end(), entry), entry);
+  if (largest_.size() > kLargestMessages) {
+    largest_.erase(largest_.begin());
+  }
+}
+
+std::vector<std::pair<size_t, std::string>>
+SonarConnectionStats::largestMessages() const {
+  std::lock_guard<std::mutex> lock(methodsMutex_);
+  return std::vector<std::pair<size_t, std::string>>(
+      largest_.rbegin(), largest_.rend());
+}
+
+void SonarConnectionStats::queued() {
+  const auto depth = queueDepth_.fetch_add(1, std::memory_order_relaxed) + 1;
+  auto max = maxQueueDepth_.load(std::memory_order_relaxed);
+  while (depth > max &&
+         !maxQueueDepth_.compare_exchange_weak(
+             max, depth, std::memory_order_relaxed)) {
+  }
+}
+
+void SonarConnectionStats::dequeued() {
+  queueDepth_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SonarConnectionStats::receiverRan(Duration duration) {
+  record(receiverLatency_, duration);
+}
+
+void SonarConnectionStats::receiverRan(
+    const std::string& method,
+    Duration duration,
+    Duration cpu) {
+  receiverRan(duration);
+  const auto micros = [](Duration d) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+  };
+  receiverCpuMicros_.fetch_add(micros(cpu), std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(methodsMutex_);
+  auto& totals = methods_[method];
+  totals.calls++;
+  totals.wallMicros += micros(duration);
+  totals.cpuMicros += micros(cpu);
+}
+
+SonarConnectionStats::Duration SonarConnectionStats::threadCpuTime() {
+  struct timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+    return Duration::zero();
+  }
+  return std::chrono::duration_cast<Duration>(
+      std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec));
+}
+
+void SonarConnectionStats::responded(Duration latency, bool error) {
+  responses_.fetch_add(1, std::memory_order_relaxed);
+  if (error) {
+    errors_.fetch_add(1, std::memory_order_relaxed);
+  }
+  record(responseLatency_, latency);
+}
+
+void SonarConnectionStats::record(Histogram& histogram, Duration duration) {
+  const auto micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  size_t bucket = 0;
+  for (auto bound = kFirstBucketMicros;
+       micros >= bound && bucket < kLatencyBuckets - 1;
+       bound *= 2) {
+    bucket++;
+  }
+  histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+folly::dynamic SonarConnectionStats::toDynamic(const Histogram& histogram) {
+  auto counts = folly::dynamic::array();
+  for (const auto& count : histogram) {
+    counts.push_back(count.load(std::memory_order_relaxed));
+  }
+  return counts;
+}
+
+folly::dynamic SonarConnectionStats::toDynamic() const {
+  auto bounds = folly::dynamic::array();
+  for (size_t i = 0, bound = kFirstBucketMicros; i < kLatencyBuckets - 1;
+       i++, bound *= 2) {
+    bounds.push_back(bound);
+  }
+  auto methods = folly::dynamic::object();
+  {
+    std::lock_guard<std::mutex> lock(methodsMutex_);
+    for (const auto& iter : methods_) {
+      auto sizes = folly::dynamic::array();
+      for (const auto count : iter.second.sentSizes) {
+        sizes.push_back(count);
+      }
+      methods[iter.first] = folly::dynamic::object(
+          "calls", iter.second.calls)("wallMicros", iter.second.wallMicros)(
+          "cpuMicros", iter.second.cpuMicros)(
+          "sentBytes", iter.second.sentBytes)("sentSizes", std::move(sizes));
+    }
+  }
+  auto sizeBounds = folly::dynamic::array();
+  for (size_t i = 0, bound = kFirstBucketBytes; i < kSizeBuckets - 1;
+       i++, bound *= 2) {
+    sizeBounds.push_back(bound);
+  }
+  return folly::dynamic::object(
+      "messagesIn", messagesIn_.load(std::memory_order_relaxed))(
+      "bytesIn", bytesIn_.load(std::memory_order_relaxed))(
+      "messagesOut", messagesOut_.load(std::memory_order_relaxed))(
+      "bytesOut", bytesOut_.load(std::memory_order_relaxed))(
+      "responses", responses_.load(std::memory_order_relaxed))(
+      "errors", errors_.load(std::memory_order_relaxed))(
+      "queueDepth", queueDepth_.load(std::memory_order_relaxed))(
+      "maxQueueDepth", maxQueueDepth_.load(std::memory_order_relaxed))(
+      "receiverLatency", toDynamic(receiverLatency_))(
+      "responseLatency", toDynamic(responseLatency_))(
+      "latencyBucketsMicros", std::move(bounds))(
+      "receiverCpuMicros", receiverCpuMicros_.load(std::memory_order_relaxed))(
+      "methods", std::move(methods))(
+      "sizeBucketsBytes", std::move(sizeBounds));
+}
+
+} // namespace sonar
+} // namespace facebook
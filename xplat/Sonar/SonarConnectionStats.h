@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/dynamic.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Traffic of one plugin's connection, counted with relaxed atomics so that
+ recording costs a few uncontended increments. Latencies are kept as
+ histograms with buckets doubling from 250us up, the last bucket holds
+ everything slower. Safe to use from any thread.
+ */
+class SonarConnectionStats {
+ public:
+  using Duration = std::chrono::steady_clock::duration;
+
+  static constexpr size_t kLatencyBuckets = 12;
+
+  static constexpr size_t kSizeBuckets = 16;
+  static constexpr size_t kLargestMessages = 10;
+
+  // Bytes are 0 where they aren't known without serializing.
+  void received(size_t bytes);
+  void sent(size_t bytes);
+
+  /**
+   Same as above for an event of method, whose params size is also kept in
+   a histogram for the method, with buckets doubling from 64 bytes up. The
+   kLargestMessages largest events are kept with their method.
+   */
+  void sent(const std::string& method, size_t bytes);
+
+  // The largest events sent so far as (bytes, method), largest first.
+  std::vector<std::pair<size_t, std::string>> largestMessages() const;
+
+  // A call was queued on the connection's executor, or started running.
+  void queued();
+  void dequeued();
+
+  // Time the receiver ran for on the connection's executor.
+  void receiverRan(Duration duration);
+
+  /**
+   Same as above, with the CPU time the receiver's thread spent on it, which
+   is also totalled for each method.
+   */
+  void receiverRan(const std::string& method, Duration duration, Duration cpu);
+
+  /**
+   CPU time consumed by the calling thread so far, from
+   CLOCK_THREAD_CPUTIME_ID. Only differences between two readings on the
+   same thread mean anything.
+   */
+  static Duration threadCpuTime();
+
+  // Time from the call arriving to its response, for receivers that respond.
+  void responded(Duration latency, bool error);
+
+  /**
+   Everything counted so far, with the histograms as arrays of counts and
+   the bucket bounds in latencyBucketsMicros. Receiver time and sent sizes
+   by method are under methods, with the size bucket bounds in
+   sizeBucketsBytes.
+   */
+  folly::dynamic toDynamic() const;
+
+ private:
+  using Histogram = std::array<std::atomic<uint64_t>, kLatencyBuckets>;
+
+  static void record(Histogram& histogram, Duration duration);
+  static folly::dynamic toDynamic(const Histogram& histogram);
+
+  std::atomic<uint64_t> messagesIn_{0};
+  std::atomic<uint64_t> bytesIn_{0};
+  std::atomic<uint64_t> messagesOut_{0};
+  std::atomic<uint64_t> bytesOut_{0};
+  std::atomic<uint64_t> responses_{0};
+  std::atomic<uint64_t> errors_{0};
+  std::atomic<int64_t> queueDepth_{0};
+  std::atomic<int64_t> maxQueueDepth_{0};
+  std::atomic<uint64_t> receiverCpuMicros_{0};
+  Histogram receiverLatency_{};
+  Histogram responseLatency_{};
+
+  struct MethodTotals {
+    uint64_t calls = 0;
+    uint64_t wallMicros = 0;
+    uint64_t cpuMicros = 0;
+    uint64_t sentBytes = 0;
+    std::array<uint64_t, kSizeBuckets> sentSizes{};
+  };
+
+  // A plugin has a handful of methods, each call only locks briefly.
+  mutable std::mutex methodsMutex_;
+  std::unordered_map<std::string, MethodTotals> methods_;
+  // Smallest first, guarded by methodsMutex_.
+  std::vector<std::pair<size_t, std::string>> largest_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include "SonarDeltaEncoder.h"
+
+namespace facebook {
+namespace sonar {
+
+constexpr size_t SonarDeltaEncoder::kDefaultKeyframeInterval;
+
+static bool containsNull(const folly::dynamic& value) {
+  if (value.isNull()) {
+    return true;
+  }
+  if (value.isObject()) {
+    for (const auto& item : value.values()) {
+      if (containsNull(item)) {
+        return true;
+      }
+    }
+  } else if (value.isArray()) {
+    for (const auto& item : value) {
+      if (containsNull(item)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+SonarDeltaEncoder::Encoded SonarDeltaEncoder::encode(
+    const folly::dynamic& params) {
+  sequence_++;
+  if (sinceKeyframe_ > 0 && sinceKeyframe_ < keyframeInterval_) {
+    if (auto patch = diff(last_, params)) {
+      sinceKeyframe_++;
+      last_ = params;
+      return {std::move(*patch), sequence_, false};
+    }
+  }
+  sinceKeyframe_ = 1;
+  last_ = params;
+  return {params, sequence_, true};
+}
+
+folly::Optional<folly::dynamic> SonarDeltaEncoder::diff(
+    const folly::dynamic& from,
+    const folly::dynamic& to) {
+  if (!from.isObject() || !to.isObject()) {
+    return folly::none;
+  }
+  auto patch = folly::dynamic::object();
+  for (const auto& item : from.items()) {
+    if (to.count(item.first) == 0) {
+      patch[item.first] = nullptr;
+    }
+  }
+  for (const auto& item : to.items()) {
+    const auto previous = from.get_ptr(item.first);
+    if (previous && *previous == item.second) {
+      continue;
+    }
+    if (previous && previous->isObject() && item.second.isObject()) {
+      auto nested = diff(*previous, item.second);
+      if (!nested) {
+        return folly::none;
+      }
+      patch[item.first] = std::move(*nested);
+      continue;
+    }
+    // A null would read as a removal.
+    if (containsNull(item.second)) {
+      return folly::none;
+    }
+    patch[item.first] = item.second;
+  }
+  return patch;
+}
+
+void SonarDeltaEncoder::apply(
+    folly::dynamic& target,
+    const folly::dynamic& patch) {
+  if (!patch.isObject()) {
+    target = patch;
+    return;
+  }
+  if (!target.isObject()) {
+    target = folly::dynamic::object();
+  }
+  for (const auto& item : patch.items()) {
+    if (item.second.isNull()) {
+      target.erase(item.first);
+    } else {
+      apply(target[item.first], item.second);
+    }
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
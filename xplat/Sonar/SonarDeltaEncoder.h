@@ -0,0 +1,66 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/dynamic.h>
+#include <cstdint>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Encodes the successive params of an event method as patches against the
+ previous ones, for methods that send the same shaped object over and over.
+ Patches are JSON merge patches (RFC 7386): the changed fields only, nested
+ objects as patches of their own, arrays whole, and removed fields as null.
+ A keyframe with the whole params is sent first, every keyframeInterval
+ events, and whenever a patch can't describe the change, i.e. for params
+ that aren't objects or with null values. Not thread safe.
+ */
+class SonarDeltaEncoder {
+ public:
+  static constexpr size_t kDefaultKeyframeInterval = 30;
+
+  struct Encoded {
+    // The whole params for keyframes, otherwise the patch to apply to the
+    // params of sequence - 1.
+    folly::dynamic params;
+    uint64_t sequence;
+    bool keyframe;
+  };
+
+  explicit SonarDeltaEncoder(
+      size_t keyframeInterval = kDefaultKeyframeInterval)
+      : keyframeInterval_(keyframeInterval > 0 ? keyframeInterval : 1) {}
+
+  Encoded encode(const folly::dynamic& params);
+
+  /**
+   The merge patch turning from into to, none if it can't be expressed as
+   one.
+   */
+  static folly::Optional<folly::dynamic> diff(
+      const folly::dynamic& from,
+      const folly::dynamic& to);
+
+  /**
+   Applies a merge patch, as the desktop does.
+   */
+  static void apply(folly::dynamic& target, const folly::dynamic& patch);
+
+ private:
+  const size_t keyframeInterval_;
+  folly::dynamic last_ = nullptr;
+  uint64_t sequence_ = 0;
+  size_t sinceKeyframe_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
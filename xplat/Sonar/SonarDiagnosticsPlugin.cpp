@@ -0,0 +1,29 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarDiagnosticsPlugin.h"
+#include <Sonar/SonarResponder.h>
+
+namespace facebook {
+namespace sonar {
+
+const std::string SonarDiagnosticsPlugin::kIdentifier = "Diagnostics";
+
+void SonarDiagnosticsPlugin::didConnect(
+    std::shared_ptr<SonarConnection> conn) {
+  auto metrics = metrics_;
+  conn->receive(
+      "getMetrics",
+      [metrics](
+          const folly::dynamic&, std::unique_ptr<SonarResponder> responder) {
+        responder->success(metrics());
+      });
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,44 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarPlugin.h>
+#include <folly/dynamic.h>
+#include <functional>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Built in plugin answering getMetrics with the traffic of every initialized
+ plugin, see SonarClient::getMetrics. SonarClient::init registers it.
+ */
+class SonarDiagnosticsPlugin : public SonarPlugin {
+ public:
+  using MetricsProvider = std::function<folly::dynamic()>;
+
+  static const std::string kIdentifier;
+
+  explicit SonarDiagnosticsPlugin(MetricsProvider metrics)
+      : metrics_(std::move(metrics)) {}
+
+  std::string identifier() const override {
+    return kIdentifier;
+  }
+
+  void didConnect(std::shared_ptr<SonarConnection> conn) override;
+
+  void didDisconnect() override {}
+
+ private:
+  MetricsProvider metrics_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,289 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarEasyWebSocket.h"
+#include "SonarJsonWriter.h"
+#include "SonarSimd.h"
+#include "SonarStep.h"
+#include "SonarTrace.h"
+#include <easywsclient.hpp>
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/json.h>
+#include <algorithm>
+#include <chrono>
+
+namespace facebook {
+namespace sonar {
+
+constexpr uint16_t SonarEasyWebSocket::kDefaultPort;
+
+SonarEasyWebSocket::SocketHandler::SocketHandler(
+    SonarEasyWebSocket* websocket,
+    int fd)
+    : folly::EventHandler(websocket->eventBase_, fd), websocket_(websocket) {}
+
+void SonarEasyWebSocket::SocketHandler::handlerReady(uint16_t) noexcept {
+  websocket_->handleEvents();
+}
+
+SonarEasyWebSocket::SonarEasyWebSocket(
+    SonarInitConfig config,
+    std::shared_ptr<SonarState> state,
+    uint16_t port)
+    : deviceData_(config.deviceData),
+      port_(port),
+      sonarState_(std::move(state)),
+      eventBase_(
+          config.connectionWorker ? config.connectionWorker
+                                  : config.callbackWorker),
+      queue_(config.maxQueuedMessagesPerPlugin, config.overflowPolicy) {
+  // Before any socket exists, payloads are masked with the CPU's best kernel.
+  easywsclient::setMaskFunction(sonarSimdKernels().mask);
+}
+
+SonarEasyWebSocket::~SonarEasyWebSocket() {
+  eventBase_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    started_ = false;
+    reconnectTimeout_ = nullptr;
+    // The callbacks may already be gone.
+    isOpen_ = false;
+    disconnect();
+    alive_ = nullptr;
+  });
+  // Waits for a handshake in progress, whose socket is then closed.
+  handshakeExecutor_ = nullptr;
+}
+
+void SonarEasyWebSocket::start() {
+  eventBase_->runInEventBaseThread([this]() {
+    if (started_) {
+      return;
+    }
+    started_ = true;
+    reconnectTimeout_ =
+        folly::AsyncTimeout::make(*eventBase_, [this]() noexcept {
+          connect();
+        });
+    connect();
+  });
+}
+
+void SonarEasyWebSocket::stop() {
+  eventBase_->runInEventBaseThread([this]() {
+    started_ = false;
+    reconnectTimeout_ = nullptr;
+    disconnect();
+  });
+}
+
+bool SonarEasyWebSocket::isOpen() const {
+  return isOpen_;
+}
+
+void SonarEasyWebSocket::connectivityChanged() {
+  eventBase_->runInEventBaseThread([this]() {
+    reconnectAttempts_ = 0;
+    if (started_ && !socket_) {
+      scheduleReconnect(true);
+    }
+  });
+}
+
+void SonarEasyWebSocket::setCallbacks(Callbacks* callbacks) {
+  callbacks_ = callbacks;
+}
+
+void SonarEasyWebSocket::sendMessage(const folly::dynamic& message) {
+  SONAR_TRACE_SECTION("SonarWebSocket::sendMessage");
+  std::string plugin;
+  const auto params = message.isObject() ? message.get_ptr("params") : nullptr;
+  const auto api =
+      params && params->isObject() ? params->get_ptr("api") : nullptr;
+  if (api && api->isString()) {
+    plugin = api->getString();
+  }
+  enqueue({std::move(plugin),
+           nullptr,
+           folly::IOBuf::copyBuffer(sonarToJson(message))});
+}
+
+void SonarEasyWebSocket::sendSerialized(
+    std::unique_ptr<folly::IOBuf> message) {
+  enqueue({"", nullptr, std::move(message)});
+}
+
+std::string SonarEasyWebSocket::url() const {
+  auto escape = [](const std::string& value) {
+    return folly::uriEscape<std::string>(value, folly::UriEscapeMode::QUERY);
+  };
+  // The setup payload RSocket would send goes in the query string instead.
+  return "ws://" + deviceData_.host + ":" + folly::to<std::string>(port_) +
+      "/sonar?os=" +
+      escape(deviceData_.os) + "&device=" + escape(deviceData_.device) +
+      "&device_id=" + escape(deviceData_.deviceId) +
+      "&app=" + escape(deviceData_.app);
+}
+
+void SonarEasyWebSocket::connect() {
+  if (!started_ || socket_ || connecting_) {
+    return;
+  }
+  connecting_ = true;
+  auto step = sonarState_->start(SonarStepId::connectToDesktop);
+  if (!handshakeExecutor_) {
+    handshakeExecutor_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+        1, std::make_shared<folly::NamedThreadFactory>("SonarHandshake"));
+  }
+  std::weak_ptr<bool> alive = alive_;
+  handshakeExecutor_->add([this, alive, step, address = url()]() {
+    std::unique_ptr<easywsclient::WebSocket> socket(
+        easywsclient::WebSocket::from_url(address));
+    eventBase_->runInEventBaseThread(
+        [this, alive, step, socket = std::move(socket)]() mutable {
+          if (alive.expired()) {
+            if (socket) {
+              socket->close();
+              socket->poll();
+            }
+            return;
+          }
+          connected(std::move(step), std::move(socket));
+        });
+  });
+}
+
+void SonarEasyWebSocket::connected(
+    std::shared_ptr<SonarStep> step,
+    std::unique_ptr<easywsclient::WebSocket> socket) {
+  connecting_ = false;
+  if (!socket) {
+    step->fail("Port not open");
+    scheduleReconnect(false);
+    return;
+  }
+  if (!started_) {
+    // Stopped during the handshake.
+    step->fail("Stopped");
+    socket->close();
+    socket->poll();
+    return;
+  }
+  step->complete();
+  socket_ = std::move(socket);
+  reconnectAttempts_ = 0;
+  incoming_.clear();
+  handler_ = std::make_unique<SocketHandler>(
+      this, static_cast<int>(socket_->getSocket()));
+  isOpen_ = true;
+  updateRegistration();
+  callbacks_->onConnected();
+  // Anything sent while disconnected has been dropped, see drainSendQueue.
+  drainSendQueue();
+}
+
+void SonarEasyWebSocket::disconnect() {
+  if (!socket_) {
+    return;
+  }
+  if (handler_) {
+    handler_->unregisterHandler();
+    handler_ = nullptr;
+  }
+  if (socket_->getReadyState() != easywsclient::WebSocket::CLOSED) {
+    // Sends the close frame, if there's room for it.
+    socket_->close();
+    socket_->poll();
+  }
+  socket_ = nullptr;
+  if (isOpen_) {
+    isOpen_ = false;
+    callbacks_->onDisconnected();
+  }
+}
+
+void SonarEasyWebSocket::scheduleReconnect(bool immediately) {
+  if (!reconnectTimeout_) {
+    return;
+  }
+  if (immediately) {
+    reconnectTimeout_->cancelTimeout();
+    eventBase_->runInLoop([this]() { connect(); });
+    return;
+  }
+  reconnectTimeout_->scheduleTimeout(backoff_.delay(reconnectAttempts_++));
+}
+
+void SonarEasyWebSocket::handleEvents() {
+  // Reads everything that has arrived and writes as much as fits.
+  socket_->poll();
+  socket_->dispatchStreaming(
+      [this](const uint8_t* data, size_t size) {
+        incoming_.append(reinterpret_cast<const char*>(data), size);
+      },
+      [this]() {
+        SONAR_TRACE_SECTION("SonarWebSocket::onMessageReceived");
+        std::string message;
+        message.swap(incoming_);
+        callbacks_->onRawMessageReceived(
+            SonarRawJson::fromString(std::move(message)));
+      });
+  if (socket_->getReadyState() == easywsclient::WebSocket::CLOSED) {
+    disconnect();
+    scheduleReconnect(false);
+    return;
+  }
+  updateRegistration();
+}
+
+void SonarEasyWebSocket::updateRegistration() {
+  // Only ask to be woken up for writes while there is something to write,
+  // a socket is writable nearly all the time.
+  const uint16_t events = folly::EventHandler::READ |
+      folly::EventHandler::PERSIST |
+      (socket_->bufferedAmount() ? folly::EventHandler::WRITE : 0);
+  if (handler_->getRegisteredEvents() != events) {
+    handler_->registerHandler(events);
+  }
+}
+
+void SonarEasyWebSocket::enqueue(SonarSendQueue::Entry entry) {
+  if (queue_.push(std::move(entry), !eventBase_->isInEventBaseThread())) {
+    eventBase_->add([this]() { drainSendQueue(); });
+  }
+}
+
+void SonarEasyWebSocket::drainSendQueue() {
+  auto drained = queue_.drain();
+  if (!socket_) {
+    return;
+  }
+  size_t dropped = 0;
+  for (const auto& count : drained.dropped) {
+    dropped += count.second;
+  }
+  if (dropped) {
+    sonarState_->incrementCounter("Messages dropped", dropped);
+  }
+  for (auto& entry : drained.entries) {
+    auto range = entry.data->coalesce();
+    socket_->send(std::string(
+        reinterpret_cast<const char*>(range.data()), range.size()));
+  }
+  socket_->poll();
+  if (socket_->getReadyState() == easywsclient::WebSocket::CLOSED) {
+    disconnect();
+    scheduleReconnect(false);
+    return;
+  }
+  updateRegistration();
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarBackoff.h>
+#include <Sonar/SonarInitConfig.h>
+#include <Sonar/SonarSendQueue.h>
+#include <Sonar/SonarState.h>
+#include <Sonar/SonarWebSocket.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace easywsclient {
+class WebSocket;
+}
+
+namespace facebook {
+namespace sonar {
+
+/**
+ A SonarWebSocket speaking plain WebSocket through easywsclient, for builds
+ where the size and startup cost of the RSocket stack matter more than its
+ features. Messages are exchanged as JSON text frames. There is no TLS and
+ no certificate exchange, so it must only be used over channels that are
+ already private to the device and the desktop, such as `adb reverse`.
+ Streamed responses, batching, BSER and compression aren't supported.
+
+ The desktop serves it on kDefaultPort at /sonar, see src/server.js.
+
+ The socket is registered with the connection worker's EventBase and only
+ read or written when it is ready, everything but sending messages happens
+ on that thread. The handshake, which easywsclient only does blocking, runs
+ on a thread of its own.
+ */
+class SonarEasyWebSocket : public SonarWebSocket {
+ public:
+  static constexpr uint16_t kDefaultPort = 8090;
+
+  SonarEasyWebSocket(
+      SonarInitConfig config,
+      std::shared_ptr<SonarState> state,
+      uint16_t port = kDefaultPort);
+
+  ~SonarEasyWebSocket();
+
+  void start() override;
+
+  void stop() override;
+
+  bool isOpen() const override;
+
+  void connectivityChanged() override;
+
+  void setCallbacks(Callbacks* callbacks) override;
+
+  void sendMessage(const folly::dynamic& message) override;
+
+  using SonarWebSocket::sendSerialized;
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override;
+
+ private:
+  class SocketHandler : public folly::EventHandler {
+   public:
+    SocketHandler(SonarEasyWebSocket* websocket, int fd);
+
+    void handlerReady(uint16_t events) noexcept override;
+
+   private:
+    SonarEasyWebSocket* websocket_;
+  };
+
+  DeviceData deviceData_;
+  const uint16_t port_;
+  std::shared_ptr<SonarState> sonarState_;
+  folly::EventBase* eventBase_;
+  Callbacks* callbacks_ = nullptr;
+  std::atomic<bool> isOpen_{false};
+  SonarSendQueue queue_;
+
+  // Only accessed on eventBase_.
+  bool started_ = false;
+  // Set while a handshake runs on handshakeExecutor_.
+  bool connecting_ = false;
+  // Handshakes finishing after the socket is destroyed find it expired.
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+  std::unique_ptr<folly::CPUThreadPoolExecutor> handshakeExecutor_;
+  std::unique_ptr<easywsclient::WebSocket> socket_;
+  std::unique_ptr<SocketHandler> handler_;
+  std::unique_ptr<folly::AsyncTimeout> reconnectTimeout_;
+  int reconnectAttempts_ = 0;
+  // Same as SonarWebSocketImpl's.
+  const SonarBackoff backoff_;
+  // The message being received, frames are appended as they arrive.
+  std::string incoming_;
+
+  std::string url() const;
+  void connect();
+  void connected(
+      std::shared_ptr<SonarStep> step,
+      std::unique_ptr<easywsclient::WebSocket> socket);
+  void disconnect();
+  void scheduleReconnect(bool immediately);
+  void handleEvents();
+  void updateRegistration();
+  void enqueue(SonarSendQueue::Entry entry);
+  void drainSendQueue();
+};
+
+} // namespace sonar
+} // namespace facebook
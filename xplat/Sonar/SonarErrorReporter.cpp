@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarErrorReporter.h"
+#include <folly/Conv.h>
+
+namespace facebook {
+namespace sonar {
+
+constexpr std::chrono::milliseconds SonarErrorReporter::kDefaultWindow;
+constexpr size_t SonarErrorReporter::kMaxFingerprints;
+
+static folly::dynamic errorMessage(
+    const std::string& message,
+    const std::string& stacktrace) {
+  return folly::dynamic::object(
+      "error",
+      folly::dynamic::object("message", message)("stacktrace", stacktrace));
+}
+
+void SonarErrorReporter::setFlushWorker(folly::EventBase* worker) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  worker_ = worker;
+}
+
+void SonarErrorReporter::report(
+    const std::string& site,
+    const std::string& message,
+    const std::string& stacktrace,
+    Clock::time_point now) {
+  std::vector<folly::dynamic> messages;
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now - windowStart_ >= window_) {
+      collect(messages, now);
+    }
+    auto key = site;
+    key.push_back('\0');
+    key.append(message);
+    const auto& iter = entries_.find(key);
+    if (iter == entries_.end() && entries_.size() < kMaxFingerprints) {
+      entries_.emplace(std::move(key), Entry{message, stacktrace});
+      messages.push_back(errorMessage(message, stacktrace));
+    } else {
+      if (iter != entries_.end()) {
+        iter->second.repeats++;
+      } else {
+        overflow_++;
+      }
+      suppressed_++;
+      // The count is sent once the window has passed, even if no other
+      // error comes along.
+      if (!flushScheduled_ && worker_) {
+        flushScheduled_ = schedule = true;
+      }
+    }
+  }
+  send(std::move(messages));
+  if (schedule) {
+    scheduleFlush();
+  }
+}
+
+void SonarErrorReporter::flush(Clock::time_point now) {
+  std::vector<folly::dynamic> messages;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushScheduled_ = false;
+    collect(messages, now);
+  }
+  send(std::move(messages));
+}
+
+size_t SonarErrorReporter::suppressed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return suppressed_;
+}
+
+void SonarErrorReporter::collect(
+    std::vector<folly::dynamic>& messages,
+    Clock::time_point now) {
+  windowStart_ = now;
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    auto& entry = iter->second;
+    if (entry.repeats == 0) {
+      // Not seen again, the next one is sent right away.
+      iter = entries_.erase(iter);
+      continue;
+    }
+    auto message = errorMessage(entry.message, entry.stacktrace);
+    message["error"]["count"] = entry.repeats;
+    messages.push_back(std::move(message));
+    // Still repeating, so only counted in the next window too.
+    entry.repeats = 0;
+    ++iter;
+  }
+  if (overflow_ > 0) {
+    auto message = errorMessage(
+        folly::to<std::string>(
+            overflow_, " errors of other kinds were not reported"),
+        "<none>");
+    message["error"]["count"] = overflow_;
+    messages.push_back(std::move(message));
+    overflow_ = 0;
+  }
+}
+
+void SonarErrorReporter::scheduleFlush() {
+  folly::EventBase* worker;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    worker = worker_;
+  }
+  std::weak_ptr<SonarErrorReporter> weak = shared_from_this();
+  const auto delay = static_cast<uint32_t>(window_.count());
+  worker->runInEventBaseThread([weak, worker, delay]() {
+    worker->runAfterDelay(
+        [weak]() {
+          if (auto self = weak.lock()) {
+            self->flush();
+          }
+        },
+        delay);
+  });
+}
+
+void SonarErrorReporter::send(std::vector<folly::dynamic> messages) {
+  if (messages.empty() || !socket_->isOpen()) {
+    return;
+  }
+  for (auto& message : messages) {
+    socket_->sendMessage(std::move(message));
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
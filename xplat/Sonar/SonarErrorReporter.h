@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarWebSocket.h>
+#include <folly/dynamic.h>
+#include <folly/io/async/EventBase.h>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Sends the errors of the client and its connections to the desktop, so that a
+ plugin throwing on every event doesn't flood the socket. Errors are told
+ apart by where they happened and their message. The first of a kind is sent
+ right away, repeats within the same window are only counted and sent as one
+ error with a count when the window is flushed.
+
+ Flushes happen on the flush worker once a window has passed, or otherwise
+ with the next error after it. Safe to use from any thread. Must be owned by
+ a shared_ptr.
+ */
+class SonarErrorReporter
+    : public std::enable_shared_from_this<SonarErrorReporter> {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds kDefaultWindow{5000};
+  // Kinds of errors kept track of per window, others are only counted.
+  static constexpr size_t kMaxFingerprints = 64;
+
+  explicit SonarErrorReporter(
+      SonarWebSocket* socket,
+      std::chrono::milliseconds window = kDefaultWindow)
+      : socket_(socket), window_(window) {}
+
+  void setFlushWorker(folly::EventBase* worker);
+
+  /**
+   site names where the error happened, e.g. the plugin whose connection it
+   is.
+   */
+  void report(
+      const std::string& site,
+      const std::string& message,
+      const std::string& stacktrace,
+      Clock::time_point now = Clock::now());
+
+  // Send the counts of the errors repeated since the last flush.
+  void flush(Clock::time_point now = Clock::now());
+
+  // The number of errors counted instead of sent so far.
+  size_t suppressed() const;
+
+ private:
+  struct Entry {
+    std::string message;
+    std::string stacktrace;
+    size_t repeats = 0;
+  };
+
+  void collect(std::vector<folly::dynamic>& messages, Clock::time_point now);
+  void scheduleFlush();
+  void send(std::vector<folly::dynamic> messages);
+
+  SonarWebSocket* const socket_;
+  const std::chrono::milliseconds window_;
+
+  mutable std::mutex mutex_;
+  folly::EventBase* worker_ = nullptr;
+  bool flushScheduled_ = false;
+  Clock::time_point windowStart_;
+  std::unordered_map<std::string, Entry> entries_;
+  // Errors that didn't fit in kMaxFingerprints since the last flush.
+  size_t overflow_ = 0;
+  size_t suppressed_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
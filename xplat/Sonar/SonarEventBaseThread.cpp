@@ -0,0 +1,215 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarEventBaseThread.h"
+
+#include <folly/io/async/EventBaseManager.h>
+#include <pthread.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <map>
+
+#ifdef __APPLE__
+#include <pthread/qos.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace facebook {
+namespace sonar {
+
+static const char* qosName(SonarThreadQoS qos) {
+  switch (qos) {
+    case SonarThreadQoS::background:
+      return "background";
+    case SonarThreadQoS::utility:
+      return "utility";
+    case SonarThreadQoS::userInitiated:
+      return "userInitiated";
+    case SonarThreadQoS::userInteractive:
+      return "userInteractive";
+    case SonarThreadQoS::unspecified:
+      break;
+  }
+  return "unspecified";
+}
+
+#ifdef __APPLE__
+static qos_class_t qosClass(SonarThreadQoS qos) {
+  switch (qos) {
+    case SonarThreadQoS::background:
+      return QOS_CLASS_BACKGROUND;
+    case SonarThreadQoS::utility:
+      return QOS_CLASS_UTILITY;
+    case SonarThreadQoS::userInitiated:
+      return QOS_CLASS_USER_INITIATED;
+    case SonarThreadQoS::userInteractive:
+      return QOS_CLASS_USER_INTERACTIVE;
+    case SonarThreadQoS::unspecified:
+      break;
+  }
+  return QOS_CLASS_UNSPECIFIED;
+}
+
+static SonarThreadQoS threadQoS(qos_class_t qos) {
+  switch (qos) {
+    case QOS_CLASS_BACKGROUND:
+      return SonarThreadQoS::background;
+    case QOS_CLASS_UTILITY:
+      return SonarThreadQoS::utility;
+    case QOS_CLASS_USER_INITIATED:
+      return SonarThreadQoS::userInitiated;
+    case QOS_CLASS_USER_INTERACTIVE:
+      return SonarThreadQoS::userInteractive;
+    default:
+      return SonarThreadQoS::unspecified;
+  }
+}
+#endif
+
+SonarEventBaseThread::SonarEventBaseThread(
+    SonarThreadOptions options,
+    std::shared_ptr<folly::ThreadFactory> threadFactory)
+    : options_(std::move(options)) {
+  std::promise<void> ready;
+  auto loop = [this, &ready]() {
+    setUp();
+    folly::EventBaseManager::get()->setEventBase(&eventBase_, false);
+    ready.set_value();
+    eventBase_.loopForever();
+  };
+  thread_ = threadFactory ? threadFactory->newThread(std::move(loop))
+                          : std::thread(std::move(loop));
+  ready.get_future().wait();
+}
+
+SonarEventBaseThread::~SonarEventBaseThread() {
+  eventBase_.terminateLoopSoon();
+  thread_.join();
+}
+
+void SonarEventBaseThread::setUp() {
+  auto errors = folly::dynamic::array();
+  report_["name"] = options_.name;
+#ifdef __APPLE__
+  pthread_setname_np(options_.name.c_str());
+#else
+  // Longer names are refused rather than truncated.
+  pthread_setname_np(pthread_self(), options_.name.substr(0, 15).c_str());
+#endif
+
+  if (options_.qos != SonarThreadQoS::unspecified) {
+    report_["requestedQoS"] = qosName(options_.qos);
+#ifdef __APPLE__
+    const auto result =
+        pthread_set_qos_class_self_np(qosClass(options_.qos), 0);
+    if (result != 0) {
+      errors.push_back(
+          std::string("pthread_set_qos_class_self_np: ") + strerror(result));
+    }
+#endif
+  }
+#ifdef __APPLE__
+  qos_class_t applied;
+  if (pthread_get_qos_class_np(pthread_self(), &applied, nullptr) == 0) {
+    report_["qos"] = qosName(threadQoS(applied));
+  }
+#endif
+
+#ifdef __linux__
+  const auto tid = static_cast<pid_t>(syscall(SYS_gettid));
+  report_["tid"] = tid;
+  report_["requestedNice"] = options_.niceValue;
+  if (setpriority(PRIO_PROCESS, tid, options_.niceValue) != 0) {
+    errors.push_back(std::string("setpriority: ") + strerror(errno));
+  }
+  errno = 0;
+  const auto nice = getpriority(PRIO_PROCESS, tid);
+  if (errno == 0) {
+    report_["nice"] = nice;
+  }
+
+  if (options_.littleCores) {
+    const auto cores = littleCores();
+    report_["requestedCpus"] = folly::dynamic(cores.begin(), cores.end());
+    if (cores.empty()) {
+      errors.push_back("No little cores to keep to");
+    } else {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (const auto core : cores) {
+        CPU_SET(core, &set);
+      }
+      if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        errors.push_back(std::string("sched_setaffinity: ") + strerror(errno));
+      }
+    }
+  }
+  cpu_set_t applied;
+  CPU_ZERO(&applied);
+  if (sched_getaffinity(0, sizeof(applied), &applied) == 0) {
+    auto cpus = folly::dynamic::array();
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &applied)) {
+        cpus.push_back(cpu);
+      }
+    }
+    report_["cpus"] = std::move(cpus);
+  }
+#else
+  if (options_.littleCores) {
+    errors.push_back("Affinity isn't supported on this platform");
+  }
+#endif
+  report_["errors"] = std::move(errors);
+}
+
+std::vector<int> SonarEventBaseThread::littleCores() {
+  std::vector<int> cores;
+#ifdef __linux__
+  std::map<int, long> maxFrequencies;
+  const auto count = sysconf(_SC_NPROCESSORS_CONF);
+  for (int cpu = 0; cpu < count; cpu++) {
+    std::ifstream file(
+        "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+        "/cpufreq/cpuinfo_max_freq");
+    long frequency;
+    if (file >> frequency) {
+      maxFrequencies[cpu] = frequency;
+    }
+  }
+  if (maxFrequencies.empty()) {
+    return cores;
+  }
+  auto lowest = maxFrequencies.begin()->second;
+  auto highest = lowest;
+  for (const auto& iter : maxFrequencies) {
+    lowest = std::min(lowest, iter.second);
+    highest = std::max(highest, iter.second);
+  }
+  if (lowest == highest) {
+    return cores;
+  }
+  for (const auto& iter : maxFrequencies) {
+    if (iter.second == lowest) {
+      cores.push_back(iter.first);
+    }
+  }
+#endif
+  return cores;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/dynamic.h>
+#include <folly/executors/thread_factory/ThreadFactory.h>
+#include <folly/io/async/EventBase.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+// Apple's quality of service classes, see pthread_set_qos_class_self_np.
+enum class SonarThreadQoS {
+  unspecified,
+  background,
+  utility,
+  userInitiated,
+  userInteractive,
+};
+
+struct SonarThreadOptions {
+  // At most 15 characters are shown on Linux and Android.
+  std::string name;
+  // Applied where threads have a nice value of their own, i.e. not on iOS.
+  // 10 is Android's THREAD_PRIORITY_BACKGROUND.
+  int niceValue = 10;
+  // Keep the thread on the cores with the lowest maximum frequency, away
+  // from the app's UI and render threads on big.LITTLE devices. Ignored
+  // where all cores are alike, and where affinity can't be set.
+  bool littleCores = false;
+  // Applied on Apple platforms only, where the QoS class rather than a nice
+  // value decides how threads compete with the app's UI work. Unspecified
+  // leaves it as the thread was created.
+  SonarThreadQoS qos = SonarThreadQoS::unspecified;
+};
+
+/**
+ A thread running an EventBase loop, set up as options ask. What could and
+ couldn't be applied is recorded for diagnostics, see report.
+ */
+class SonarEventBaseThread {
+ public:
+  /**
+   With threadFactory, e.g. one attaching threads to the JVM, the thread is
+   created with it. Returns once the thread is set up and looping.
+   */
+  explicit SonarEventBaseThread(
+      SonarThreadOptions options,
+      std::shared_ptr<folly::ThreadFactory> threadFactory = nullptr);
+
+  ~SonarEventBaseThread();
+
+  SonarEventBaseThread(const SonarEventBaseThread&) = delete;
+  SonarEventBaseThread& operator=(const SonarEventBaseThread&) = delete;
+
+  folly::EventBase* eventBase() {
+    return &eventBase_;
+  }
+
+  const std::string& name() const {
+    return options_.name;
+  }
+
+  /**
+   The thread's id, nice value, QoS class and CPUs as requested and as
+   applied, and errors setting them up. Set once the constructor returns.
+   */
+  const folly::dynamic& report() const {
+    return report_;
+  }
+
+  // Whether everything asked for was applied.
+  bool fullyApplied() const {
+    return report_["errors"].empty();
+  }
+
+  /**
+   The CPUs with the lowest maximum frequency, or none if they all have the
+   same or it can't be told.
+   */
+  static std::vector<int> littleCores();
+
+ private:
+  void setUp();
+
+  const SonarThreadOptions options_;
+  folly::EventBase eventBase_;
+  folly::dynamic report_ = folly::dynamic::object();
+  std::thread thread_;
+};
+
+} // namespace sonar
+} // namespace facebook
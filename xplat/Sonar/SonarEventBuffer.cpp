@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarEventBuffer.h"
+
+#include <iterator>
+
+namespace facebook {
+namespace sonar {
+
+size_t SonarEventBuffer::sizeOf(const Event& event) {
+  return event.method.size() +
+      (event.params ? event.params->computeChainDataLength() : 0);
+}
+
+SonarEventBuffer::~SonarEventBuffer() {
+  release(bytes_);
+}
+
+void SonarEventBuffer::release(size_t bytes) {
+  if (budget_ && bytes > 0) {
+    budget_->release(plugin_, bytes);
+  }
+}
+
+void SonarEventBuffer::append(
+    std::string method,
+    std::unique_ptr<folly::IOBuf> params) {
+  Event event{std::move(method), std::move(params)};
+  const auto size = sizeOf(event);
+  // The budget is only called outside the lock, its shed handlers may call
+  // back into the buffer.
+  const bool accepted =
+      size <= maxBytes_ && (!budget_ || budget_->reserve(plugin_, size));
+
+  size_t evicted = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!accepted) {
+      dropped_++;
+      return;
+    }
+    while (!events_.empty() && bytes_ + size > maxBytes_) {
+      evicted += sizeOf(events_.front());
+      bytes_ -= sizeOf(events_.front());
+      events_.pop_front();
+      dropped_++;
+    }
+    bytes_ += size;
+    events_.push_back(std::move(event));
+  }
+  release(evicted);
+}
+
+std::vector<SonarEventBuffer::Event> SonarEventBuffer::takeAll() {
+  std::deque<Event> events;
+  size_t taken;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(events, events_);
+    taken = bytes_;
+    bytes_ = 0;
+  }
+  release(taken);
+  return std::vector<Event>(
+      std::make_move_iterator(events.begin()),
+      std::make_move_iterator(events.end()));
+}
+
+void SonarEventBuffer::drainTo(SonarConnection& connection) {
+  // Sent outside the lock, so that appending isn't blocked by the socket.
+  for (auto& event : takeAll()) {
+    connection.sendRaw(event.method, std::move(event.params));
+  }
+}
+
+size_t SonarEventBuffer::shed(size_t bytes) {
+  size_t freed = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!events_.empty() && freed < bytes) {
+      freed += sizeOf(events_.front());
+      events_.pop_front();
+      dropped_++;
+    }
+    bytes_ -= freed;
+  }
+  release(freed);
+  return freed;
+}
+
+size_t SonarEventBuffer::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return events_.size();
+}
+
+size_t SonarEventBuffer::bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+size_t SonarEventBuffer::dropped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+} // namespace sonar
+} // namespace facebook
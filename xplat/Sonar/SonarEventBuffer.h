@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarConnection.h>
+#include <Sonar/SonarMemoryBudget.h>
+#include <folly/io/IOBuf.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Events a plugin sends while no desktop is connected, kept serialized so that
+ each costs no more than its bytes. Once the buffered events take up more than
+ maxBytes, the oldest ones are dropped. With a budget, the buffered bytes are
+ accounted against plugin in it, and events it refuses are dropped. Safe to
+ use from any thread.
+ */
+class SonarEventBuffer {
+ public:
+  struct Event {
+    std::string method;
+    std::unique_ptr<folly::IOBuf> params;
+  };
+
+  explicit SonarEventBuffer(
+      size_t maxBytes,
+      std::shared_ptr<SonarMemoryBudget> budget = nullptr,
+      std::string plugin = "")
+      : maxBytes_(maxBytes),
+        budget_(std::move(budget)),
+        plugin_(std::move(plugin)) {}
+
+  ~SonarEventBuffer();
+
+  /**
+   Buffer an event whose params are already serialized as JSON. An event
+   bigger than maxBytes on its own is dropped right away.
+   */
+  void append(std::string method, std::unique_ptr<folly::IOBuf> params);
+
+  /**
+   Take all buffered events, oldest first, leaving the buffer empty.
+   */
+  std::vector<Event> takeAll();
+
+  /**
+   Send all buffered events to connection as they are, oldest first.
+   */
+  void drainTo(SonarConnection& connection);
+
+  /**
+   Drop the oldest events until at least bytes are freed, or the buffer is
+   empty. Returns the bytes freed.
+   */
+  size_t shed(size_t bytes);
+
+  size_t size() const;
+  size_t bytes() const;
+  // Number of events dropped to stay within maxBytes.
+  size_t dropped() const;
+
+ private:
+  static size_t sizeOf(const Event& event);
+
+  void release(size_t bytes);
+
+  const size_t maxBytes_;
+  const std::shared_ptr<SonarMemoryBudget> budget_;
+  const std::string plugin_;
+  mutable std::mutex mutex_;
+  std::deque<Event> events_;
+  size_t bytes_ = 0;
+  size_t dropped_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,438 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarFanOutSocket.h"
+#include <Sonar/SonarJsonWriter.h>
+#include <Sonar/SonarTrace.h>
+#include <folly/Conv.h>
+#include <algorithm>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define SONAR_LOG(message) \
+  __android_log_print(ANDROID_LOG_INFO, "sonar", "sonar: %s", message)
+#else
+#define SONAR_LOG(message) printf("sonar: %s\n", message)
+#endif
+
+namespace facebook {
+namespace sonar {
+
+constexpr int SonarFanOutSocket::kDesktopIdShift;
+
+static constexpr int64_t kDesktopIdMask =
+    (int64_t(1) << SonarFanOutSocket::kDesktopIdShift) - 1;
+
+class SonarFanOutSocket::Desktop : public SonarWebSocket::Callbacks {
+ public:
+  Desktop(SonarFanOutSocket* owner, size_t index)
+      : owner_(owner), index_(index) {}
+
+  void onConnected() override {
+    owner_->onConnected(index_);
+  }
+
+  void onDisconnected() override {
+    owner_->onDisconnected(index_);
+  }
+
+  void onMessageReceived(const folly::dynamic& message) override {
+    owner_->onMessageReceived(index_, message);
+  }
+
+  void onRawMessageReceived(const SonarRawJson& message) override {
+    owner_->onRawMessageReceived(index_, message);
+  }
+
+  // Request-responses and streams answer on their own stream, they need no
+  // routing.
+  void onRequestReceived(
+      const folly::dynamic& message,
+      std::shared_ptr<SonarReply> reply) override {
+    owner_->callbacks_->onRequestReceived(message, std::move(reply));
+  }
+
+  void onStreamRequested(
+      const folly::dynamic& message,
+      std::shared_ptr<SonarStreamResponder> responder) override {
+    owner_->callbacks_->onStreamRequested(message, std::move(responder));
+  }
+
+ private:
+  SonarFanOutSocket* owner_;
+  size_t index_;
+};
+
+SonarFanOutSocket::SonarFanOutSocket(
+    std::vector<std::unique_ptr<SonarWebSocket>> sockets)
+    : sockets_(std::move(sockets)), states_(sockets_.size()) {
+  for (size_t i = 0; i < sockets_.size(); i++) {
+    desktops_.push_back(std::make_unique<Desktop>(this, i));
+  }
+}
+
+void SonarFanOutSocket::start() {
+  for (auto& socket : sockets_) {
+    socket->start();
+  }
+}
+
+void SonarFanOutSocket::stop() {
+  for (auto& socket : sockets_) {
+    socket->stop();
+  }
+}
+
+bool SonarFanOutSocket::isOpen() const {
+  for (auto& socket : sockets_) {
+    if (socket->isOpen()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SonarFanOutSocket::connectivityChanged() {
+  for (auto& socket : sockets_) {
+    socket->connectivityChanged();
+  }
+}
+
+void SonarFanOutSocket::setInBackground(bool background) {
+  for (auto& socket : sockets_) {
+    socket->setInBackground(background);
+  }
+}
+
+size_t SonarFanOutSocket::onMemoryPressure(SonarMemoryPressure level) {
+  size_t released = 0;
+  for (auto& socket : sockets_) {
+    released += socket->onMemoryPressure(level);
+  }
+  return released;
+}
+
+void SonarFanOutSocket::setCallbacks(Callbacks* callbacks) {
+  callbacks_ = callbacks;
+  for (size_t i = 0; i < sockets_.size(); i++) {
+    sockets_[i]->setCallbacks(desktops_[i].get());
+  }
+}
+
+void SonarFanOutSocket::sendMessage(const folly::dynamic& message) {
+  SONAR_TRACE_SECTION("SonarFanOutSocket::sendMessage");
+  const auto id = message.get_ptr("id");
+  if (id && id->isInt()) {
+    respond(id->getInt(), message);
+    return;
+  }
+  std::string plugin;
+  const auto params = message.get_ptr("params");
+  if (params && params->isObject()) {
+    const auto api = params->get_ptr("api");
+    if (api && api->isString()) {
+      plugin = api->getString();
+    }
+  }
+  // Only reached when the sockets don't all send JSON, or for the odd
+  // message without a plugin, so each socket serializes its own.
+  for (auto desktop : desktopsFor(plugin)) {
+    sockets_[desktop]->sendMessage(message);
+  }
+}
+
+void SonarFanOutSocket::sendSerialized(std::unique_ptr<folly::IOBuf> message) {
+  route(std::move(message), false);
+}
+
+void SonarFanOutSocket::sendSerialized(
+    std::unique_ptr<folly::IOBuf> message,
+    const std::string& plugin) {
+  fanOut(std::move(message), plugin);
+}
+
+void SonarFanOutSocket::sendSerializedResponse(
+    std::unique_ptr<folly::IOBuf> message) {
+  route(std::move(message), true);
+}
+
+bool SonarFanOutSocket::sendsJson() const {
+  for (auto& socket : sockets_) {
+    if (!socket->sendsJson()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::map<std::string, size_t> SonarFanOutSocket::droppedMessages() const {
+  std::map<std::string, size_t> dropped;
+  for (auto& socket : sockets_) {
+    for (const auto& entry : socket->droppedMessages()) {
+      dropped[entry.first] += entry.second;
+    }
+  }
+  return dropped;
+}
+
+folly::dynamic SonarFanOutSocket::previousSessionFrames() const {
+  return sockets_.front()->previousSessionFrames();
+}
+
+void SonarFanOutSocket::onConnected(size_t desktop) {
+  bool first;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_[desktop].connected = true;
+    first = std::count_if(
+                states_.begin(), states_.end(), [](const DesktopState& state) {
+                  return state.connected;
+                }) == 1;
+  }
+  if (first) {
+    callbacks_->onConnected();
+  }
+}
+
+void SonarFanOutSocket::onDisconnected(size_t desktop) {
+  std::vector<std::string> orphaned;
+  bool last;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& state = states_[desktop];
+    if (!state.connected) {
+      return;
+    }
+    for (const auto& plugin : state.plugins) {
+      if (initializedBy(plugin) == 1) {
+        orphaned.push_back(plugin);
+      }
+    }
+    state.connected = false;
+    state.plugins.clear();
+    last = std::none_of(
+        states_.begin(), states_.end(), [](const DesktopState& state) {
+          return state.connected;
+        });
+  }
+  if (last) {
+    callbacks_->onDisconnected();
+    return;
+  }
+  // The others are still connected, only the plugins no one else uses go.
+  for (const auto& plugin : orphaned) {
+    callbacks_->onMessageReceived(folly::dynamic::object("method", "deinit")(
+        "params", folly::dynamic::object("plugin", plugin)));
+  }
+}
+
+void SonarFanOutSocket::onMessageReceived(
+    size_t desktop,
+    const folly::dynamic& message) {
+  const auto method = message.get_ptr("method");
+  const auto params = message.get_ptr("params");
+  if (method && method->isString() && params && params->isObject() &&
+      (*method == "init" || *method == "deinit")) {
+    const auto plugin = params->get_ptr("plugin");
+    if (plugin && plugin->isString()) {
+      bool forward;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& plugins = states_[desktop].plugins;
+        if (*method == "init") {
+          plugins.insert(plugin->getString());
+          forward = initializedBy(plugin->getString()) == 1;
+        } else {
+          plugins.erase(plugin->getString());
+          forward = initializedBy(plugin->getString()) == 0;
+        }
+      }
+      if (forward) {
+        callbacks_->onMessageReceived(message);
+      }
+      return;
+    }
+  }
+  folly::dynamic routed = message;
+  if (method && method->isString() && params && params->isObject() &&
+      (*method == "initMany" || *method == "deinitMany")) {
+    const auto plugins = params->get_ptr("plugins");
+    if (plugins && plugins->isArray()) {
+      // As for init and deinit one at a time, only the plugins this desktop
+      // is the first or last to use are passed on.
+      folly::dynamic forwarded = folly::dynamic::array;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& initialized = states_[desktop].plugins;
+        for (const auto& plugin : *plugins) {
+          if (!plugin.isString()) {
+            continue;
+          }
+          bool forward;
+          if (*method == "initMany") {
+            initialized.insert(plugin.getString());
+            forward = initializedBy(plugin.getString()) == 1;
+          } else {
+            initialized.erase(plugin.getString());
+            forward = initializedBy(plugin.getString()) == 0;
+          }
+          if (forward) {
+            forwarded.push_back(plugin);
+          }
+        }
+      }
+      const auto id = message.get_ptr("id");
+      if (forwarded.empty() && !(id && id->isInt())) {
+        return;
+      }
+      // Still passed on when empty if it expects a response.
+      routed["params"]["plugins"] = std::move(forwarded);
+    }
+  }
+  if (desktop == 0) {
+    callbacks_->onMessageReceived(routed);
+    return;
+  }
+  const int64_t base = int64_t(desktop) << kDesktopIdShift;
+  const auto id = routed.get_ptr("id");
+  if (id && id->isInt()) {
+    *id = base | id->getInt();
+  }
+  if (method && *method == "cancel" && params && params->isObject()) {
+    const auto cancelled = routed["params"].get_ptr("id");
+    if (cancelled && cancelled->isInt()) {
+      *cancelled = base | cancelled->getInt();
+    }
+  }
+  callbacks_->onMessageReceived(routed);
+}
+
+void SonarFanOutSocket::onRawMessageReceived(
+    size_t desktop,
+    const SonarRawJson& message) {
+  try {
+    const auto fields = message.fields();
+    const auto method = SonarRawJson::field(fields, "method");
+    const auto name = method.isNull() ? std::string() : method.asString();
+    // Only messages whose plugin or id matter here are parsed, the rest go
+    // through as they came.
+    if (name == "init" || name == "deinit" || name == "initMany" ||
+        name == "deinitMany" ||
+        (desktop > 0 &&
+         (name == "cancel" || !SonarRawJson::field(fields, "id").isNull()))) {
+      onMessageReceived(desktop, message.parse());
+      return;
+    }
+  } catch (const std::exception& e) {
+    // Not an envelope, the client reports it.
+  }
+  callbacks_->onRawMessageReceived(message);
+}
+
+void SonarFanOutSocket::fanOut(
+    std::unique_ptr<folly::IOBuf> message,
+    const std::string& plugin) {
+  SONAR_TRACE_SECTION("SonarFanOutSocket::fanOut");
+  const auto desktops = desktopsFor(plugin);
+  // Every desktop shares the one serialized buffer.
+  for (size_t i = 0; i + 1 < desktops.size(); i++) {
+    if (plugin.empty()) {
+      sockets_[desktops[i]]->sendSerialized(message->clone());
+    } else {
+      sockets_[desktops[i]]->sendSerialized(message->clone(), plugin);
+    }
+  }
+  if (plugin.empty()) {
+    sockets_[desktops.back()]->sendSerialized(std::move(message));
+  } else {
+    sockets_[desktops.back()]->sendSerialized(std::move(message), plugin);
+  }
+}
+
+void SonarFanOutSocket::route(
+    std::unique_ptr<folly::IOBuf> message,
+    bool response) {
+  // Such as what plugins in other processes send through the broker, which
+  // only the text tells the id or plugin of.
+  message->coalesce();
+  const auto json = SonarRawJson::view(folly::StringPiece(
+      reinterpret_cast<const char*>(message->data()), message->length()));
+  int64_t id = -1;
+  std::string plugin;
+  try {
+    const auto fields = json.fields();
+    const auto rawId = SonarRawJson::field(fields, "id");
+    if (!rawId.isNull()) {
+      id = folly::to<int64_t>(rawId.json());
+    } else {
+      const auto params = SonarRawJson::field(fields, "params");
+      if (!params.isNull()) {
+        const auto api = SonarRawJson::field(params.fields(), "api");
+        if (!api.isNull()) {
+          plugin = api.asString();
+        }
+      }
+    }
+  } catch (const std::exception& e) {
+    SONAR_LOG(e.what());
+  }
+  if (id < 0 || (id >> kDesktopIdShift) == 0) {
+    if (id >= 0 || response) {
+      auto& primary = sockets_.front();
+      response ? primary->sendSerializedResponse(std::move(message))
+               : primary->sendSerialized(std::move(message));
+      return;
+    }
+    fanOut(std::move(message), plugin);
+    return;
+  }
+  respond(id, json.parse());
+}
+
+void SonarFanOutSocket::respond(int64_t id, folly::dynamic message) {
+  const auto desktop = id < 0 ? 0 : size_t(id >> kDesktopIdShift);
+  if (desktop >= sockets_.size()) {
+    SONAR_LOG("Response to an unknown desktop dropped");
+    return;
+  }
+  if (desktop > 0) {
+    message["id"] = id & kDesktopIdMask;
+  }
+  sockets_[desktop]->sendMessage(std::move(message));
+}
+
+std::vector<size_t> SonarFanOutSocket::desktopsFor(
+    const std::string& plugin) const {
+  std::vector<size_t> desktops;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < states_.size(); i++) {
+      if (plugin.empty() ? states_[i].connected
+                         : states_[i].plugins.count(plugin) > 0) {
+        desktops.push_back(i);
+      }
+    }
+  }
+  if (desktops.empty()) {
+    // As with a single desktop, the main one gets what no one's listening
+    // for, to queue or drop as it does.
+    desktops.push_back(0);
+  }
+  return desktops;
+}
+
+size_t SonarFanOutSocket::initializedBy(const std::string& plugin) const {
+  size_t count = 0;
+  for (const auto& state : states_) {
+    count += state.plugins.count(plugin);
+  }
+  return count;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarWebSocket.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ A SonarWebSocket over the connections to several desktops at once, e.g. a
+ local one and a recording service, see
+ SonarInitConfig::additionalDesktops. The client sees a single desktop:
+
+ - It counts as connected while any desktop is, and as disconnected once
+   the last one is gone.
+ - A plugin is initialized once the first desktop initializes it and torn
+   down once no desktop has it initialized anymore, including because they
+   disconnected, whether one at a time or several at once with initMany
+   and deinitMany. Desktops that initialize a plugin that already is only
+   get its events from then on.
+ - A plugin's events only go to the desktops that have it initialized.
+   Events are serialized once, every desktop sends the same buffer.
+ - Requests of desktops other than the first get ids of their own, so that
+   their responses find their way back.
+
+ Each desktop's connection keeps its own send queues, a slow desktop only
+ holds back what is sent to it. Safe to use from any thread.
+ */
+class SonarFanOutSocket : public SonarWebSocket {
+ public:
+  // The first socket is the main desktop's, whose ids are kept as they are.
+  explicit SonarFanOutSocket(
+      std::vector<std::unique_ptr<SonarWebSocket>> sockets);
+
+  void start() override;
+
+  void stop() override;
+
+  bool isOpen() const override;
+
+  void connectivityChanged() override;
+
+  void setInBackground(bool background) override;
+
+  size_t onMemoryPressure(SonarMemoryPressure level) override;
+
+  void setCallbacks(Callbacks* callbacks) override;
+
+  using SonarWebSocket::sendMessage;
+
+  void sendMessage(const folly::dynamic& message) override;
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override;
+
+  void sendSerialized(
+      std::unique_ptr<folly::IOBuf> message,
+      const std::string& plugin) override;
+
+  void sendSerializedResponse(std::unique_ptr<folly::IOBuf> message) override;
+
+  bool sendsJson() const override;
+
+  std::map<std::string, size_t> droppedMessages() const override;
+
+  folly::dynamic previousSessionFrames() const override;
+
+  // Ids of other desktops' requests are their own above this many bits.
+  static constexpr int kDesktopIdShift = 48;
+
+ private:
+  class Desktop;
+
+  struct DesktopState {
+    bool connected = false;
+    std::unordered_set<std::string> plugins;
+  };
+
+  void onConnected(size_t desktop);
+  void onDisconnected(size_t desktop);
+  void onMessageReceived(size_t desktop, const folly::dynamic& message);
+  void onRawMessageReceived(size_t desktop, const SonarRawJson& message);
+
+  // Sends message to the desktops that have plugin initialized, or to all
+  // connected ones without a plugin.
+  void fanOut(std::unique_ptr<folly::IOBuf> message, const std::string& plugin);
+  // Sends a serialized message whose id or plugin still has to be looked up.
+  void route(std::unique_ptr<folly::IOBuf> message, bool response);
+  void respond(int64_t id, folly::dynamic message);
+  std::vector<size_t> desktopsFor(const std::string& plugin) const;
+  // Guarded by mutex_.
+  size_t initializedBy(const std::string& plugin) const;
+
+  std::vector<std::unique_ptr<SonarWebSocket>> sockets_;
+  std::vector<std::unique_ptr<Desktop>> desktops_;
+  Callbacks* callbacks_ = nullptr;
+  mutable std::mutex mutex_;
+  std::vector<DesktopState> states_;
+};
+
+} // namespace sonar
+} // namespace facebook
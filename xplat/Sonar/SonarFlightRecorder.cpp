@@ -0,0 +1,229 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarFlightRecorder.h"
+
+#include <folly/io/Cursor.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace facebook {
+namespace sonar {
+
+constexpr size_t SonarFlightRecorder::kMethodBytes;
+constexpr size_t SonarFlightRecorder::kPayloadBytes;
+
+static constexpr char kMagic[8] = {'S', 'O', 'N', 'A', 'R', 'F', 'R', '1'};
+
+// The layout of the file, which a later process reads back. Atomics over
+// the mapping are fine as long as they are lock free.
+struct SonarFlightRecorder::Header {
+  char magic[8];
+  uint32_t slotBytes;
+  uint32_t frames;
+  // The last sequence claimed, frames are numbered from 1.
+  std::atomic<uint64_t> sequence;
+};
+
+struct SonarFlightRecorder::Slot {
+  // 0 while the slot is being written.
+  std::atomic<uint64_t> sequence;
+  int64_t timeMicros;
+  uint64_t size;
+  uint16_t payloadLength;
+  uint8_t direction;
+  uint8_t methodLength;
+  char method[kMethodBytes];
+  char payload[kPayloadBytes];
+};
+
+SonarFlightRecorder::SonarFlightRecorder(
+    const std::string& path,
+    size_t frames)
+    : previous_(load(path)), frames_(std::max<size_t>(frames, 1)) {
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  mappedBytes_ = sizeof(Header) + frames_ * sizeof(Slot);
+  // Emptied, then grown back, so that the ring starts out zeroed.
+  if (::ftruncate(fd_, 0) != 0 ||
+      ::ftruncate(fd_, static_cast<off_t>(mappedBytes_)) != 0) {
+    const auto error = errno;
+    ::close(fd_);
+    throw std::system_error(
+        error, std::generic_category(), "ftruncate " + path);
+  }
+  mapping_ = ::mmap(
+      nullptr, mappedBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mapping_ == MAP_FAILED) {
+    const auto error = errno;
+    ::close(fd_);
+    throw std::system_error(error, std::generic_category(), "mmap " + path);
+  }
+  header_ = static_cast<Header*>(mapping_);
+  slots_ = reinterpret_cast<Slot*>(header_ + 1);
+  header_->slotBytes = sizeof(Slot);
+  header_->frames = static_cast<uint32_t>(frames_);
+  // Written last, a ring without it isn't read back.
+  std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+}
+
+SonarFlightRecorder::~SonarFlightRecorder() {
+  ::munmap(mapping_, mappedBytes_);
+  ::close(fd_);
+}
+
+SonarFlightRecorder::Slot* SonarFlightRecorder::begin(
+    Direction direction,
+    folly::StringPiece method,
+    size_t size,
+    uint64_t& sequence) {
+  sequence = header_->sequence.fetch_add(1, std::memory_order_relaxed) + 1;
+  auto slot = &slots_[(sequence - 1) % frames_];
+  slot->sequence.store(0, std::memory_order_relaxed);
+  slot->timeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+  slot->size = size;
+  slot->direction = static_cast<uint8_t>(direction);
+  slot->methodLength =
+      static_cast<uint8_t>(std::min(method.size(), kMethodBytes));
+  std::memcpy(slot->method, method.data(), slot->methodLength);
+  return slot;
+}
+
+void SonarFlightRecorder::publish(Slot* slot, uint64_t sequence) {
+  slot->sequence.store(sequence, std::memory_order_release);
+}
+
+void SonarFlightRecorder::record(
+    Direction direction,
+    folly::StringPiece method,
+    size_t size,
+    folly::StringPiece payload) {
+  uint64_t sequence;
+  const auto slot = begin(direction, method, size, sequence);
+  slot->payloadLength =
+      static_cast<uint16_t>(std::min(payload.size(), kPayloadBytes));
+  std::memcpy(slot->payload, payload.data(), slot->payloadLength);
+  publish(slot, sequence);
+}
+
+void SonarFlightRecorder::record(
+    Direction direction,
+    folly::StringPiece method,
+    const folly::IOBuf& data) {
+  uint64_t sequence;
+  const auto slot =
+      begin(direction, method, data.computeChainDataLength(), sequence);
+  folly::io::Cursor cursor(&data);
+  slot->payloadLength = static_cast<uint16_t>(
+      cursor.pullAtMost(slot->payload, kPayloadBytes));
+  publish(slot, sequence);
+}
+
+std::vector<SonarFlightRecorder::Frame> SonarFlightRecorder::load(
+    const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  const std::string contents(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::vector<Frame> frames;
+  if (contents.size() < sizeof(Header)) {
+    return frames;
+  }
+  // Copied out rather than cast, the string isn't aligned for the atomics.
+  char magic[sizeof(kMagic)];
+  uint32_t slotBytes;
+  uint32_t count;
+  std::memcpy(magic, contents.data() + offsetof(Header, magic), sizeof(magic));
+  std::memcpy(
+      &slotBytes,
+      contents.data() + offsetof(Header, slotBytes),
+      sizeof(slotBytes));
+  std::memcpy(
+      &count, contents.data() + offsetof(Header, frames), sizeof(count));
+  if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      slotBytes != sizeof(Slot) ||
+      contents.size() < sizeof(Header) + size_t(count) * sizeof(Slot)) {
+    return frames;
+  }
+  std::vector<std::pair<uint64_t, Frame>> sequenced;
+  for (uint32_t i = 0; i < count; i++) {
+    const auto base = contents.data() + sizeof(Header) + i * sizeof(Slot);
+    uint64_t sequence;
+    int64_t timeMicros;
+    uint64_t size;
+    uint16_t payloadLength;
+    uint8_t direction;
+    uint8_t methodLength;
+    std::memcpy(&sequence, base + offsetof(Slot, sequence), sizeof(sequence));
+    if (sequence == 0) {
+      continue;
+    }
+    std::memcpy(
+        &timeMicros, base + offsetof(Slot, timeMicros), sizeof(timeMicros));
+    std::memcpy(&size, base + offsetof(Slot, size), sizeof(size));
+    std::memcpy(
+        &payloadLength,
+        base + offsetof(Slot, payloadLength),
+        sizeof(payloadLength));
+    std::memcpy(
+        &direction, base + offsetof(Slot, direction), sizeof(direction));
+    std::memcpy(
+        &methodLength,
+        base + offsetof(Slot, methodLength),
+        sizeof(methodLength));
+    Frame frame;
+    frame.time = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::microseconds(timeMicros)));
+    frame.direction = direction == 0 ? Direction::inbound : Direction::outbound;
+    frame.method.assign(
+        base + offsetof(Slot, method),
+        std::min<size_t>(methodLength, kMethodBytes));
+    frame.size = size;
+    frame.payload.assign(
+        base + offsetof(Slot, payload),
+        std::min<size_t>(payloadLength, kPayloadBytes));
+    sequenced.emplace_back(sequence, std::move(frame));
+  }
+  std::sort(
+      sequenced.begin(), sequenced.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+      });
+  for (auto& entry : sequenced) {
+    frames.push_back(std::move(entry.second));
+  }
+  return frames;
+}
+
+folly::dynamic SonarFlightRecorder::toDynamic(
+    const std::vector<Frame>& frames) {
+  auto array = folly::dynamic::array();
+  for (const auto& frame : frames) {
+    array.push_back(folly::dynamic::object(
+        "time",
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            frame.time.time_since_epoch())
+            .count())(
+        "direction", frame.direction == Direction::inbound ? "in" : "out")(
+        "method", frame.method)("size", frame.size)("payload", frame.payload));
+  }
+  return array;
+}
+
+} // namespace sonar
+} // namespace facebook
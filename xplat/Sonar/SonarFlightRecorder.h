@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Keeps the last frames exchanged with the desktop in a fixed size ring in a
+ memory mapped file: when, which way, the method when known, the size, and
+ the first kPayloadBytes of the frame. Frames are written with plain stores
+ into the mapping, which the kernel writes back even if the process crashes
+ or is killed, so what was going on is still there on the next launch.
+ Recording a frame takes an atomic increment and a copy of at most a few
+ hundred bytes, without locks or system calls. Safe to use from any thread.
+ */
+class SonarFlightRecorder {
+ public:
+  enum class Direction : uint8_t { inbound, outbound };
+
+  static constexpr size_t kMethodBytes = 40;
+  static constexpr size_t kPayloadBytes = 192;
+
+  struct Frame {
+    std::chrono::system_clock::time_point time;
+    Direction direction;
+    std::string method;
+    // The whole frame's size, of which payload is the start.
+    size_t size;
+    std::string payload;
+  };
+
+  /**
+   Maps the ring at path with room for frames, reading what a previous
+   process left there first, see previousFrames. Throws std::system_error if
+   the file can't be created or mapped.
+   */
+  SonarFlightRecorder(const std::string& path, size_t frames);
+  ~SonarFlightRecorder();
+
+  SonarFlightRecorder(const SonarFlightRecorder&) = delete;
+  SonarFlightRecorder& operator=(const SonarFlightRecorder&) = delete;
+
+  void record(
+      Direction direction,
+      folly::StringPiece method,
+      size_t size,
+      folly::StringPiece payload);
+
+  void record(
+      Direction direction,
+      folly::StringPiece method,
+      const folly::IOBuf& data);
+
+  /**
+   What the ring held when it was opened, oldest first. Frames that were
+   being written when the process died are left out.
+   */
+  const std::vector<Frame>& previousFrames() const {
+    return previous_;
+  }
+
+  /**
+   Reads a ring, oldest first. Returns no frames if the file doesn't exist
+   or isn't a ring.
+   */
+  static std::vector<Frame> load(const std::string& path);
+
+  static folly::dynamic toDynamic(const std::vector<Frame>& frames);
+
+ private:
+  struct Header;
+  struct Slot;
+
+  // Claims the next slot and writes the frame's fields but the payload into
+  // it. The slot's sequence is only set by publish, once it is complete.
+  Slot* begin(
+      Direction direction,
+      folly::StringPiece method,
+      size_t size,
+      uint64_t& sequence);
+  static void publish(Slot* slot, uint64_t sequence);
+
+  std::vector<Frame> previous_;
+  int fd_ = -1;
+  size_t frames_;
+  size_t mappedBytes_ = 0;
+  void* mapping_ = nullptr;
+  Header* header_ = nullptr;
+  Slot* slots_ = nullptr;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,242 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarHostResolver.h"
+
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <algorithm>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+constexpr std::chrono::milliseconds SonarHostResolver::kDefaultTtl;
+constexpr std::chrono::milliseconds SonarHostResolver::kAttemptDelay;
+
+namespace {
+
+struct Race;
+
+// A TCP connect to one host, closed as soon as it succeeds: only the
+// address is wanted, the real connection is made by the caller.
+class Attempt : public folly::AsyncSocket::ConnectCallback {
+ public:
+  Attempt(std::shared_ptr<Race> race, std::string host)
+      : race_(std::move(race)), host_(std::move(host)) {}
+
+  void start(
+      folly::EventBase* evb,
+      const folly::SocketAddress& address,
+      std::chrono::milliseconds timeout);
+
+  void cancel() {
+    socket_->closeNow();
+  }
+
+  void connectSuccess() noexcept override;
+
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override;
+
+ private:
+  std::shared_ptr<Race> race_;
+  const std::string host_;
+  folly::SocketAddress address_;
+  folly::AsyncSocket::UniquePtr socket_;
+};
+
+// Only accessed on the event base the attempts run on.
+struct Race {
+  folly::Promise<std::pair<std::string, folly::SocketAddress>> promise;
+  size_t remaining;
+  bool done = false;
+  std::vector<Attempt*> attempts;
+  folly::exception_wrapper error;
+
+  void failed(folly::exception_wrapper e) {
+    error = std::move(e);
+    if (--remaining == 0 && !done) {
+      done = true;
+      promise.setException(error);
+    }
+  }
+};
+
+void Attempt::start(
+    folly::EventBase* evb,
+    const folly::SocketAddress& address,
+    std::chrono::milliseconds timeout) {
+  address_ = address;
+  race_->attempts.push_back(this);
+  socket_.reset(new folly::AsyncSocket(evb));
+  socket_->connect(this, address, timeout.count());
+}
+
+void Attempt::connectSuccess() noexcept {
+  auto race = std::move(race_);
+  auto& attempts = race->attempts;
+  attempts.erase(std::find(attempts.begin(), attempts.end(), this));
+  socket_->closeNow();
+  if (!race->done) {
+    race->done = true;
+    race->promise.setValue(std::make_pair(host_, address_));
+    // Cancelled attempts remove themselves.
+    const auto others = attempts;
+    for (const auto attempt : others) {
+      attempt->cancel();
+    }
+  }
+  delete this;
+}
+
+void Attempt::connectErr(const folly::AsyncSocketException& ex) noexcept {
+  auto race = std::move(race_);
+  auto& attempts = race->attempts;
+  attempts.erase(std::find(attempts.begin(), attempts.end(), this));
+  race->failed(folly::make_exception_wrapper<folly::AsyncSocketException>(ex));
+  delete this;
+}
+
+} // namespace
+
+SonarHostResolver::SonarHostResolver(
+    std::vector<std::string> hosts,
+    std::chrono::milliseconds ttl)
+    : hosts_(std::move(hosts)), ttl_(ttl) {}
+
+folly::Future<folly::SocketAddress> SonarHostResolver::resolve(
+    folly::EventBase* evb,
+    uint16_t port,
+    std::chrono::milliseconds connectTimeout) {
+  if (hosts_.size() == 1) {
+    return lookup(hosts_[0], port);
+  }
+  if (const auto host = preferredHost()) {
+    return lookup(*host, port);
+  }
+  return race(evb, port, connectTimeout);
+}
+
+folly::Future<folly::SocketAddress> SonarHostResolver::lookup(
+    const std::string& host,
+    uint16_t port) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto iter = resolved_.find(host);
+    if (iter != resolved_.end() && iter->second.expiry > Clock::now()) {
+      auto address = iter->second.address;
+      address.setPort(port);
+      return address;
+    }
+  }
+  folly::SocketAddress literal;
+  try {
+    literal.setFromIpPort(host, port);
+    return literal;
+  } catch (const std::exception&) {
+    // A host name, to be looked up.
+  }
+  return folly::via(
+             executor(),
+             [host, port]() {
+               folly::SocketAddress address;
+               address.setFromHostPort(host, port);
+               return address;
+             })
+      .thenValue([this, host](folly::SocketAddress address) {
+        auto cached = address;
+        cached.setPort(0);
+        std::lock_guard<std::mutex> lock(mutex_);
+        resolved_[host] = {std::move(cached), Clock::now() + ttl_};
+        return address;
+      });
+}
+
+folly::Future<folly::SocketAddress> SonarHostResolver::race(
+    folly::EventBase* evb,
+    uint16_t port,
+    std::chrono::milliseconds connectTimeout) {
+  auto state = std::make_shared<Race>();
+  state->remaining = hosts_.size();
+  auto result = state->promise.getFuture();
+  for (size_t i = 0; i < hosts_.size(); i++) {
+    const auto host = hosts_[i];
+    const auto start = [this, evb, state, host, port, connectTimeout]() {
+      if (state->done) {
+        state->failed(folly::exception_wrapper());
+        return;
+      }
+      lookup(host, port)
+          .via(evb)
+          .thenValue([evb, state, host, connectTimeout](
+                         folly::SocketAddress address) {
+            if (state->done) {
+              state->failed(folly::exception_wrapper());
+              return;
+            }
+            (new Attempt(state, host))->start(evb, address, connectTimeout);
+          })
+          .onError([state](folly::exception_wrapper e) {
+            state->failed(std::move(e));
+          });
+    };
+    evb->runInEventBaseThread([evb, start, i]() {
+      if (i == 0) {
+        start();
+      } else {
+        evb->runAfterDelay(start, kAttemptDelay.count() * i);
+      }
+    });
+  }
+  return std::move(result).thenValue(
+      [this](std::pair<std::string, folly::SocketAddress> winner) {
+        preferred(winner.first);
+        return winner.second;
+      });
+}
+
+void SonarHostResolver::preferred(const std::string& host) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  preferred_ = host;
+}
+
+bool SonarHostResolver::prefer(const std::string& host) {
+  if (std::find(hosts_.begin(), hosts_.end(), host) == hosts_.end()) {
+    return false;
+  }
+  preferred(host);
+  return true;
+}
+
+folly::Executor* SonarHostResolver::executor() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!executor_) {
+    executor_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+        1, std::make_shared<folly::NamedThreadFactory>("SonarResolve"));
+  }
+  return executor_.get();
+}
+
+void SonarHostResolver::forgetPreferred() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  preferred_ = folly::none;
+}
+
+void SonarHostResolver::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  resolved_.clear();
+  preferred_ = folly::none;
+}
+
+folly::Optional<std::string> SonarHostResolver::preferredHost() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return preferred_;
+}
+
+} // namespace sonar
+} // namespace facebook
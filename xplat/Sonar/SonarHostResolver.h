@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Finds the desktop's address among the hosts it may be reachable at, e.g.
+ 10.0.2.2 and localhost on an emulator. Host names are resolved on a thread
+ of the resolver's own, created the first time one is, never on the calling
+ thread, and kept for ttl. IP literals are never looked up.
+
+ With several hosts, TCP connects to all of them are raced, each started
+ kAttemptDelay after the previous one as in Happy Eyeballs (RFC 8305), and
+ the first host to connect is kept for later connections until forgotten.
+ Safe to use from any thread.
+ */
+class SonarHostResolver {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds kDefaultTtl{60000};
+  static constexpr std::chrono::milliseconds kAttemptDelay{250};
+
+  explicit SonarHostResolver(
+      std::vector<std::string> hosts,
+      std::chrono::milliseconds ttl = kDefaultTtl);
+
+  /**
+   The address to connect to the desktop at on port. Races connects on evb,
+   each given connectTimeout, unless there is a single host or one was kept.
+   */
+  folly::Future<folly::SocketAddress> resolve(
+      folly::EventBase* evb,
+      uint16_t port,
+      std::chrono::milliseconds connectTimeout);
+
+  /**
+   Keep host as if it had won a race, e.g. because it did on the previous
+   launch. Ignored unless it's one of the hosts. Returns whether it was kept.
+   */
+  bool prefer(const std::string& host);
+
+  /**
+   Race the hosts again next time, e.g. because the kept one failed.
+   */
+  void forgetPreferred();
+
+  /**
+   Forget resolved addresses and the kept host, e.g. because the network
+   changed.
+   */
+  void clear();
+
+  folly::Optional<std::string> preferredHost() const;
+
+  const std::vector<std::string>& hosts() const {
+    return hosts_;
+  }
+
+ private:
+  folly::Future<folly::SocketAddress> lookup(
+      const std::string& host,
+      uint16_t port);
+
+  folly::Future<folly::SocketAddress> race(
+      folly::EventBase* evb,
+      uint16_t port,
+      std::chrono::milliseconds connectTimeout);
+
+  void preferred(const std::string& host);
+
+  folly::Executor* executor();
+
+  struct Resolved {
+    // With port 0.
+    folly::SocketAddress address;
+    Clock::time_point expiry;
+  };
+
+  const std::vector<std::string> hosts_;
+  const std::chrono::milliseconds ttl_;
+  mutable std::mutex mutex_;
+  std::unique_ptr<folly::CPUThreadPoolExecutor> executor_;
+  std::unordered_map<std::string, Resolved> resolved_;
+  folly::Optional<std::string> preferred_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,165 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarInFlightRequests.h"
+
+#include <folly/Conv.h>
+#include <algorithm>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+constexpr size_t SonarInFlightRequests::kDefaultMaxRequests;
+constexpr std::chrono::milliseconds SonarInFlightRequests::kDefaultTimeout;
+constexpr size_t SonarInFlightRequests::kLatencyBuckets;
+
+static size_t latencyBucket(std::chrono::milliseconds latency) {
+  size_t bucket = 0;
+  for (auto ms = latency.count(); ms > 0 && bucket + 1 < SonarInFlightRequests::kLatencyBuckets; ms >>= 1) {
+    bucket++;
+  }
+  return bucket;
+}
+
+SonarCancellationToken SonarInFlightRequests::start(
+    int64_t id,
+    std::string method,
+    Clock::time_point now) {
+  SonarCancellationSource source;
+  auto token = source.getToken();
+  std::vector<Expired> evicted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (maxRequests_ > 0 && requests_.size() >= maxRequests_ &&
+        requests_.count(id) == 0) {
+      const auto oldest = std::min_element(
+          requests_.begin(),
+          requests_.end(),
+          [](const auto& a, const auto& b) {
+            return a.second.started < b.second.started;
+          });
+      evicted.push_back(
+          {oldest->first,
+           std::move(oldest->second.method),
+           std::move(oldest->second.source),
+           "Too many requests in flight"});
+      requests_.erase(oldest);
+      evicted_++;
+    }
+    requests_[id] = {std::move(source),
+                     std::move(method),
+                     now,
+                     timeout_.count() > 0
+                         ? now + timeout_
+                         : Clock::time_point::max()};
+  }
+  giveUp(std::move(evicted));
+  return token;
+}
+
+bool SonarInFlightRequests::finish(int64_t id, Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto iter = requests_.find(id);
+  if (iter == requests_.end()) {
+    return false;
+  }
+  if (!iter->second.method.empty()) {
+    latencies_[iter->second.method][latencyBucket(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - iter->second.started))]++;
+  }
+  requests_.erase(iter);
+  return true;
+}
+
+bool SonarInFlightRequests::cancel(int64_t id) {
+  SonarCancellationSource source;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto iter = requests_.find(id);
+    if (iter == requests_.end()) {
+      return false;
+    }
+    source = std::move(iter->second.source);
+    requests_.erase(iter);
+  }
+  source.requestCancellation();
+  return true;
+}
+
+folly::Optional<SonarInFlightRequests::Clock::time_point>
+SonarInFlightRequests::expire(Clock::time_point now) {
+  std::vector<Expired> expired;
+  folly::Optional<Clock::time_point> next;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto iter = requests_.begin(); iter != requests_.end();) {
+      if (iter->second.deadline <= now) {
+        expired.push_back(
+            {iter->first,
+             std::move(iter->second.method),
+             std::move(iter->second.source),
+             "Timed out"});
+        iter = requests_.erase(iter);
+        timedOut_++;
+        continue;
+      }
+      if (iter->second.deadline != Clock::time_point::max() &&
+          (!next || iter->second.deadline < *next)) {
+        next = iter->second.deadline;
+      }
+      ++iter;
+    }
+  }
+  giveUp(std::move(expired));
+  return next;
+}
+
+void SonarInFlightRequests::giveUp(std::vector<Expired> expired) {
+  for (auto& request : expired) {
+    request.source.requestCancellation();
+    if (expiredHandler_) {
+      expiredHandler_(request.id, request.method, request.reason);
+    }
+  }
+}
+
+size_t SonarInFlightRequests::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return requests_.size();
+}
+
+folly::dynamic SonarInFlightRequests::toDynamic() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto methods = folly::dynamic::object();
+  for (const auto& iter : latencies_) {
+    size_t count = 0;
+    for (const auto bucket : iter.second) {
+      count += bucket;
+    }
+    auto method = folly::dynamic::object("count", count);
+    for (const auto percentile : {50, 90, 99}) {
+      size_t seen = 0;
+      for (size_t i = 0; i < kLatencyBuckets; i++) {
+        seen += iter.second[i];
+        if (seen * 100 >= count * percentile) {
+          method["p" + folly::to<std::string>(percentile) + "Ms"] =
+              int64_t(1) << i;
+          break;
+        }
+      }
+    }
+    methods[iter.first] = std::move(method);
+  }
+  return folly::dynamic::object("inFlight", requests_.size())(
+      "timedOut", timedOut_)("evicted", evicted_)("methods", std::move(methods));
+}
+
+} // namespace sonar
+} // namespace facebook
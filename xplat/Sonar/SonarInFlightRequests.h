@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarCancellation.h>
+#include <folly/Optional.h>
+#include <folly/dynamic.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ The desktop's requests that haven't been responded to yet, by id, so that
+ the desktop can cancel ones it no longer needs. Requests not responded to
+ within timeout, and the oldest ones once there are more than maxRequests,
+ are given up on: they are cancelled, their responses aren't sent anymore,
+ and the expired handler answers them instead. The time to respond is kept
+ per method. Safe to use from any thread.
+ */
+class SonarInFlightRequests {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Called outside the table's lock with each request given up on, and why.
+  using ExpiredHandler = std::function<
+      void(int64_t id, const std::string& method, const std::string& reason)>;
+
+  static constexpr size_t kDefaultMaxRequests = 1000;
+  static constexpr std::chrono::milliseconds kDefaultTimeout{30000};
+  // Latencies are kept in power of two buckets of milliseconds, the last
+  // one taking everything above.
+  static constexpr size_t kLatencyBuckets = 20;
+
+  /**
+   A timeout of 0 never gives up on requests, a maxRequests of 0 keeps any
+   number of them.
+   */
+  explicit SonarInFlightRequests(
+      size_t maxRequests = kDefaultMaxRequests,
+      std::chrono::milliseconds timeout = kDefaultTimeout)
+      : maxRequests_(maxRequests), timeout_(timeout) {}
+
+  /**
+   Set once before tracking any request.
+   */
+  void setExpiredHandler(ExpiredHandler handler) {
+    expiredHandler_ = std::move(handler);
+  }
+
+  std::chrono::milliseconds timeout() const {
+    return timeout_;
+  }
+
+  /**
+   Track a request until it finishes or is cancelled. A request with the
+   same id that is still tracked is replaced. method names the request in
+   the latencies.
+   */
+  SonarCancellationToken start(
+      int64_t id,
+      std::string method = "",
+      Clock::time_point now = Clock::now());
+
+  /**
+   Stop tracking a request. Returns false if it had been cancelled or given
+   up on, in which case its response shouldn't be sent anymore.
+   */
+  bool finish(int64_t id, Clock::time_point now = Clock::now());
+
+  /**
+   Returns whether the request was still in flight.
+   */
+  bool cancel(int64_t id);
+
+  /**
+   Give up on the requests past their deadline. Returns the earliest
+   deadline left, if any.
+   */
+  folly::Optional<Clock::time_point> expire(Clock::time_point now = Clock::now());
+
+  size_t size() const;
+
+  /**
+   The number of requests in flight and given up on, and for each method
+   the number of responses and their latency percentiles in milliseconds.
+   Percentiles are the upper bound of their bucket.
+   */
+  folly::dynamic toDynamic() const;
+
+ private:
+  struct Request {
+    SonarCancellationSource source;
+    std::string method;
+    Clock::time_point started;
+    // Clock::time_point::max() without a timeout.
+    Clock::time_point deadline;
+  };
+
+  struct Expired {
+    int64_t id;
+    std::string method;
+    SonarCancellationSource source;
+    const char* reason;
+  };
+
+  void giveUp(std::vector<Expired> expired);
+
+  const size_t maxRequests_;
+  const std::chrono::milliseconds timeout_;
+  ExpiredHandler expiredHandler_;
+  mutable std::mutex mutex_;
+  std::unordered_map<int64_t, Request> requests_;
+  std::map<std::string, std::array<size_t, kLatencyBuckets>> latencies_;
+  size_t timedOut_ = 0;
+  size_t evicted_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,98 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarInboundScheduler.h"
+
+namespace facebook {
+namespace sonar {
+
+SonarInboundPriority SonarInboundScheduler::classify(
+    folly::StringPiece method,
+    size_t bytes) const {
+  if (method != "execute") {
+    return SonarInboundPriority::control;
+  }
+  return bytes >= weights_.bulkBytes ? SonarInboundPriority::bulk
+                                     : SonarInboundPriority::interactive;
+}
+
+void SonarInboundScheduler::push(
+    SonarInboundPriority priority,
+    folly::Function<void()> task,
+    Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  queues_[static_cast<size_t>(priority)].push_back(
+      Entry{std::move(task), now});
+}
+
+folly::Function<void()> SonarInboundScheduler::pop(Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The oldest of the messages that waited too long goes first.
+  size_t starved = kClasses;
+  for (size_t i = 0; i < kClasses; i++) {
+    if (queues_[i].empty() ||
+        now - queues_[i].front().queued < weights_.maxWait) {
+      continue;
+    }
+    if (starved == kClasses ||
+        queues_[i].front().queued < queues_[starved].front().queued) {
+      starved = i;
+    }
+  }
+  if (starved != kClasses) {
+    return take(starved);
+  }
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < kClasses; i++) {
+      if (!queues_[i].empty() && credits_[i] > 0) {
+        credits_[i]--;
+        return take(i);
+      }
+    }
+    for (size_t i = 0; i < kClasses; i++) {
+      credits_[i] = weight(i);
+    }
+  }
+  // Only classes weighted 0 are waiting.
+  for (size_t i = 0; i < kClasses; i++) {
+    if (!queues_[i].empty()) {
+      return take(i);
+    }
+  }
+  return nullptr;
+}
+
+size_t SonarInboundScheduler::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t size = 0;
+  for (const auto& queue : queues_) {
+    size += queue.size();
+  }
+  return size;
+}
+
+size_t SonarInboundScheduler::weight(size_t priority) const {
+  switch (static_cast<SonarInboundPriority>(priority)) {
+    case SonarInboundPriority::control:
+      return weights_.control;
+    case SonarInboundPriority::interactive:
+      return weights_.interactive;
+    case SonarInboundPriority::bulk:
+      return weights_.bulk;
+  }
+  return 0;
+}
+
+folly::Function<void()> SonarInboundScheduler::take(size_t priority) {
+  auto task = std::move(queues_[priority].front().task);
+  queues_[priority].pop_front();
+  return task;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/Range.h>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace facebook {
+namespace sonar {
+
+enum class SonarInboundPriority {
+  // Everything but execute, such as init, deinit and setSubscriptions.
+  control,
+  // Calls with small params, usually the user clicking around the desktop.
+  interactive,
+  // Calls with params of at least bulkBytes.
+  bulk,
+};
+
+struct SonarInboundWeights {
+  // Messages of each class run in these proportions while all of them are
+  // waiting. A class with weight 0 still runs once the others are empty.
+  size_t control = 8;
+  size_t interactive = 4;
+  size_t bulk = 1;
+  // Messages that have waited this long run next whatever their class, so
+  // that a steady stream of urgent ones can't hold back bulk calls forever.
+  std::chrono::milliseconds maxWait{500};
+  size_t bulkBytes = 64 * 1024;
+};
+
+/**
+ Orders the messages received from the desktop before they are handed to the
+ client, so that control messages and small calls don't wait behind large
+ ones. Messages of a class keep their order, classes are interleaved by
+ weighted round robin. Safe to use from any thread.
+ */
+class SonarInboundScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit SonarInboundScheduler(SonarInboundWeights weights = {})
+      : weights_(weights) {}
+
+  SonarInboundPriority classify(folly::StringPiece method, size_t bytes) const;
+
+  void push(
+      SonarInboundPriority priority,
+      folly::Function<void()> task,
+      Clock::time_point now = Clock::now());
+
+  /**
+   Takes the message due next, or an empty function if none is waiting.
+   */
+  folly::Function<void()> pop(Clock::time_point now = Clock::now());
+
+  size_t size() const;
+
+ private:
+  static constexpr size_t kClasses = 3;
+
+  struct Entry {
+    folly::Function<void()> task;
+    Clock::time_point queued;
+  };
+
+  size_t weight(size_t priority) const;
+  folly::Function<void()> take(size_t priority);
+
+  const SonarInboundWeights weights_;
+  mutable std::mutex mutex_;
+  std::array<std::deque<Entry>, kClasses> queues_;
+  // Turns left for each class in the current round.
+  std::array<size_t, kClasses> credits_{};
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -8,8 +8,21 @@
 
 #pragma once
 
+#include <Sonar/CertificateUtils.h>
+#include <Sonar/SonarEventBaseThread.h>
+#include <Sonar/SonarInboundScheduler.h>
+#include <Sonar/SonarSendLimiter.h>
+#include <Sonar/SonarSendQueue.h>
+#include <Sonar/SonarStackCapture.h>
+#include <Sonar/SonarTransport.h>
+#include <folly/executors/thread_factory/ThreadFactory.h>
 #include <folly/io/async/EventBase.h>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace facebook {
 namespace sonar {
@@ -36,9 +49,212 @@ struct SonarInitConfig {
   folly::EventBase* callbackWorker;
 
   /**
-  EventBase to be used to maintain the network connection.
+  EventBase to be used to maintain the network connection. May be the same as
+  callbackWorker, or null to use callbackWorker for both, which saves a thread
+  where that matters more than isolating the connection from slow callbacks.
   */
-  folly::EventBase* connectionWorker;
+  folly::EventBase* connectionWorker = nullptr;
+
+  /**
+  Factory for the threads plugin receivers are dispatched on. Platforms that
+  need plugin threads set up in a particular way (e.g. attached to the JVM)
+  should provide one; plain named threads are used otherwise.
+  */
+  std::shared_ptr<folly::ThreadFactory> pluginThreadFactory = nullptr;
+
+  /**
+  Maximum number of messages a single plugin can have waiting to be sent,
+  and what happens to messages sent beyond that.
+  */
+  size_t maxQueuedMessagesPerPlugin = 1000;
+  OverflowPolicy overflowPolicy = OverflowPolicy::dropOldest;
+
+  /**
+  How many events each plugin sends per turn while several have events
+  waiting, by plugin identifier. Plugins not listed send one, see
+  SonarSendQueue.
+  */
+  std::unordered_map<std::string, size_t> sendWeights;
+
+  /**
+  How messages from the desktop that arrive while earlier ones are still
+  being handled are ordered on callbackWorker, see SonarInboundScheduler.
+  */
+  SonarInboundWeights inboundWeights;
+
+  /**
+  Type of key generated for the client certificate. With
+  pregenerateCertificateKey the key is generated on a low priority thread at
+  startup, when no key exists yet, so the first certificate exchange doesn't
+  have to wait for it.
+  */
+  CertificateKeyType certificateKeyType = CertificateKeyTypeRSA;
+  bool pregenerateCertificateKey = false;
+
+  /**
+  Transport to reach the desktop with instead of TCP and TLS, for channels
+  that are already trusted such as a forwarded local socket, or a socket
+  shared with the desktop by a simulator running on the same machine. If it
+  can't connect, the client falls back to TCP and TLS until connectivity
+  changes. See SonarTransport.h.
+  */
+  SonarTransportFactory transport = nullptr;
+
+  /**
+  Fraction of hot path trace spans to record while systrace or Instruments
+  is capturing. Only used when built with FB_SONAR_TRACING, see SonarTrace.h.
+  */
+  double traceSamplingRate = 1.0;
+
+  /**
+  File to capture the events of plugins that run in the background in while
+  no desktop has initialized them, see SonarPlugin::runInBackground. Empty
+  doesn't capture. The file is created anew and holds at most
+  offlineCaptureBytes, the oldest events are dropped beyond that. Captured
+  events are replayed at up to offlineReplayBytesPerSecond once the desktop
+  initializes their plugin.
+  */
+  std::string offlineCapturePath;
+  size_t offlineCaptureBytes = 4 * 1024 * 1024;
+  size_t offlineReplayBytesPerSecond = 1024 * 1024;
+
+  /**
+  File to record the frames exchanged with the desktop in, with their
+  timings, for replaying the session offline. Empty doesn't record. See
+  SonarSessionRecorder.h.
+  */
+  std::string sessionRecordingPath;
+
+  /**
+  File to keep the last flightRecorderFrames frames exchanged with the
+  desktop in, cheaply enough to always be on. What a crashed session left
+  there is reported by SonarClient::getMetrics. Empty doesn't record. See
+  SonarFlightRecorder.h.
+  */
+  std::string flightRecorderPath;
+  size_t flightRecorderFrames = 256;
+
+  /**
+  Budget for the bytes buffered on behalf of plugins: queued events and event
+  buffers, see SonarMemoryBudget. Past the soft limit plugins are asked to
+  shed data with SonarPlugin::shedMemory, past the hard limit new data is
+  dropped. 0 doesn't limit.
+  */
+  size_t memorySoftLimitBytes = 0;
+  size_t memoryHardLimitBytes = 0;
+
+  /**
+  Stay dormant until a desktop is reachable: instead of connecting, only try
+  a plain TCP connection to the desktop's insecure port, with the usual
+  reconnect backoff. No certificates are loaded or generated and no TLS
+  session is set up until that succeeds, so an app nobody is debugging pays
+  next to nothing for Sonar. Platforms that know a desktop just showed up,
+  e.g. from a USB or adb connection, should call connectivityChanged to probe
+  right away. Doesn't apply while a local transport is in use.
+  */
+  bool dormantUntilReachable = false;
+
+  /**
+  For platforms that call SonarClient::connectivityChanged whenever the
+  network, USB or adb state changes, which retries right away: failed
+  connection attempts then back off up to this long rather than a minute, so
+  an app with no desktop around is left idle until something relevant
+  changes. The attempts that still happen are a safety net for changes the
+  platform can't tell about. 0 keeps the usual ceiling.
+  */
+  std::chrono::milliseconds idleReconnectInterval{0};
+
+  /**
+  Other hosts the desktop may be reachable at besides deviceData.host, e.g.
+  localhost for adb reverse besides 10.0.2.2 on an emulator. Connects to all
+  of them are raced and the first to connect is kept until a connection to
+  it fails or connectivity changes, see SonarHostResolver.
+  */
+  std::vector<std::string> hostCandidates;
+
+  /**
+  Hosts of desktops to stay connected to at the same time as the one at
+  deviceData.host, e.g. a recording service next to a developer's desktop,
+  see SonarFanOutSocket. Each has a connection and certificates of its own,
+  kept under privateAppDirectory, and gets the events of the plugins it
+  initialized. Connections to them don't record sessions or frames.
+  */
+  std::vector<std::string> additionalDesktops;
+
+  /**
+  What changes while the app is in the background, as reported by the
+  platform through SonarClient::onAppBackground. With
+  pauseEventsInBackground, plugins' events are held back in the send queue,
+  within its quotas, and sent once the app is in the foreground again.
+  Events of every method are limited to backgroundSendLimit on top of their
+  own limits, which by default doesn't limit. Connections only send
+  keepalives while nothing is read from the desktop, at most keepalive apart
+  in the foreground and backgroundKeepalive in the background, see
+  SonarKeepalive. The certificate exchange keeps one or the other for the
+  whole connection.
+  */
+  bool pauseEventsInBackground = true;
+  SonarSendLimit backgroundSendLimit;
+  std::chrono::seconds keepalive{10};
+  std::chrono::seconds backgroundKeepalive{60};
+
+  /**
+  Trusted connections that drop resume their rsocket session rather than
+  disconnecting, so plugins stay connected through brief interruptions and
+  the desktop doesn't have to init them and fetch their state again. Up to
+  resumeBufferBytes of frames the desktop hasn't acknowledged are kept to
+  send again, and a session that hasn't resumed within resumeWindow is
+  given up, disconnecting plugins as before. 0 bytes turns resumption off,
+  and a desktop that doesn't support it rejects the resume the same way.
+  */
+  size_t resumeBufferBytes = 1024 * 1024;
+  std::chrono::seconds resumeWindow{30};
+
+  /**
+  Plugin tasks and messages from the desktop that keep their thread busy for
+  longer than this are reported with the thread's stack, in the client's
+  state and in the diagnostics plugin's metrics, see SonarWatchdog. 0, the
+  default, doesn't watch, since capturing stacks interrupts app threads with
+  SIGURG. The stack is captured with stackUnwinder, which platforms with a
+  better unwinder than backtrace() should set.
+  */
+  std::chrono::milliseconds watchdogThreshold{0};
+  SonarStackUnwinder stackUnwinder = sonarDefaultStackUnwinder;
+
+  /**
+  Requests from the desktop that plugins don't respond to within
+  requestTimeout are answered with an error, and so are the oldest ones once
+  more than maxInFlightRequests wait for a response, see
+  SonarInFlightRequests. Plugins' responses to them aren't sent anymore. A
+  timeout of 0 waits for as long as plugins take, a maximum of 0 doesn't
+  limit.
+  */
+  std::chrono::milliseconds requestTimeout{30000};
+  size_t maxInFlightRequests = 1000;
+
+  /**
+  For apps running in several processes: a local socket, named as for
+  localSocketTransport, through which they share a single desktop
+  connection. The process with brokerOwner set connects to the desktop and
+  serves the socket, the others reach the desktop through it, see
+  SonarBroker. The desktop then sees one app, and certificates and the
+  connection are only set up once. Empty for a connection per process.
+  */
+  std::string brokerPath;
+  bool brokerOwner = false;
+
+  /**
+  Create callbackWorker and connectionWorker on threads of the client's own,
+  set up as callbackThread and connectionThread ask, instead of using the
+  ones given. Their threads are created with workerThreadFactory when set,
+  e.g. to attach them to the JVM. What could be applied is recorded in the
+  client's state and in the diagnostics plugin's metrics, see
+  SonarEventBaseThread.
+  */
+  bool nativeWorkers = false;
+  SonarThreadOptions callbackThread = {"SonarCallback"};
+  SonarThreadOptions connectionThread = {"SonarConnection"};
+  std::shared_ptr<folly::ThreadFactory> workerThreadFactory = nullptr;
 };
 
 } // namespace sonar
@@ -0,0 +1,84 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarJsonParser.h"
+#include "SonarOpCounts.h"
+
+#include <folly/json.h>
+
+#if FB_SONAR_SIMDJSON
+#include <simdjson.h>
+#endif
+
+namespace facebook {
+namespace sonar {
+
+#if FB_SONAR_SIMDJSON
+
+static folly::dynamic toDynamic(simdjson::dom::element element) {
+  using simdjson::dom::element_type;
+  switch (element.type()) {
+    case element_type::ARRAY: {
+      auto array = folly::dynamic::array();
+      for (const auto child : element.get_array().value_unsafe()) {
+        array.push_back(toDynamic(child));
+      }
+      return array;
+    }
+    case element_type::OBJECT: {
+      auto object = folly::dynamic::object();
+      for (const auto field : element.get_object().value_unsafe()) {
+        // Later duplicate keys win, as with folly.
+        object[std::string(field.key.data(), field.key.size())] =
+            toDynamic(field.value);
+      }
+      return object;
+    }
+    case element_type::INT64:
+      return element.get_int64().value_unsafe();
+    case element_type::UINT64:
+      return static_cast<double>(element.get_uint64().value_unsafe());
+    case element_type::DOUBLE:
+      return element.get_double().value_unsafe();
+    case element_type::STRING: {
+      const auto string = element.get_string().value_unsafe();
+      return std::string(string.data(), string.size());
+    }
+    case element_type::BOOL:
+      return element.get_bool().value_unsafe();
+    case element_type::NULL_VALUE:
+      return nullptr;
+  }
+  return nullptr;
+}
+
+folly::dynamic sonarParseJsonSimd(folly::StringPiece json) {
+  static thread_local simdjson::dom::parser parser;
+  simdjson::dom::element root;
+  // Copies json into a padded buffer of the parser's, as frames come
+  // without simdjson's padding.
+  if (parser.parse(json.data(), json.size()).get(root)) {
+    return folly::parseJson(json);
+  }
+  return toDynamic(root);
+}
+
+#endif
+
+folly::dynamic sonarParseJson(folly::StringPiece json) {
+  SONAR_COUNT_OP(jsonDecodes);
+#if FB_SONAR_SIMDJSON
+  if (json.size() >= kSimdJsonThreshold) {
+    return sonarParseJsonSimd(json);
+  }
+#endif
+  return folly::parseJson(json);
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,49 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <cstddef>
+
+/**
+ Messages from the desktop are parsed with folly::parseJson. Built with
+ FB_SONAR_SIMDJSON=1 and simdjson, those of at least kSimdJsonThreshold
+ bytes, like console scripts or bulk setData calls, are parsed with
+ simdjson's SIMD parser instead, which is several times faster on them.
+ Smaller ones stay with folly, for which building the dynamic dominates.
+ */
+#ifndef FB_SONAR_SIMDJSON
+#define FB_SONAR_SIMDJSON 0
+#endif
+
+namespace facebook {
+namespace sonar {
+
+constexpr size_t kSimdJsonThreshold = 16 * 1024;
+
+/**
+ Same result and errors as folly::parseJson with its default options.
+ */
+folly::dynamic sonarParseJson(folly::StringPiece json);
+
+#if FB_SONAR_SIMDJSON
+
+/**
+ Whatever the size of json, for benchmarks. Falls back to folly::parseJson
+ for anything simdjson rejects, so that errors are reported the same way.
+ Integers above the range of int64_t become doubles. Each thread keeps a
+ parser with buffers as large as the largest json it parsed.
+ */
+folly::dynamic sonarParseJsonSimd(folly::StringPiece json);
+
+#endif
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,191 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarJsonWriter.h"
+#include "SonarOpCounts.h"
+#include "SonarSimd.h"
+
+#include <folly/Conv.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+inline bool isContinuation(unsigned char c) {
+  return (c & 0xc0) == 0x80;
+}
+
+// The length of the valid UTF-8 sequence at p, or 0. Overlong encodings,
+// surrogates and code points above U+10FFFF aren't valid.
+size_t utf8SequenceLength(const unsigned char* p, const unsigned char* end) {
+  const auto left = end - p;
+  const auto c = p[0];
+  if (c >= 0xc2 && c <= 0xdf) {
+    return left >= 2 && isContinuation(p[1]) ? 2 : 0;
+  }
+  if (c >= 0xe0 && c <= 0xef) {
+    if (left < 3 || !isContinuation(p[1]) || !isContinuation(p[2]) ||
+        (c == 0xe0 && p[1] < 0xa0) || (c == 0xed && p[1] > 0x9f)) {
+      return 0;
+    }
+    return 3;
+  }
+  if (c >= 0xf0 && c <= 0xf4) {
+    if (left < 4 || !isContinuation(p[1]) || !isContinuation(p[2]) ||
+        !isContinuation(p[3]) || (c == 0xf0 && p[1] < 0x90) ||
+        (c == 0xf4 && p[1] > 0x8f)) {
+      return 0;
+    }
+    return 4;
+  }
+  return 0;
+}
+
+void appendEscaped(unsigned char c, std::string& out) {
+  switch (c) {
+    case '"':
+      out.append("\\\"");
+      break;
+    case '\\':
+      out.append("\\\\");
+      break;
+    case '\b':
+      out.append("\\b");
+      break;
+    case '\f':
+      out.append("\\f");
+      break;
+    case '\n':
+      out.append("\\n");
+      break;
+    case '\r':
+      out.append("\\r");
+      break;
+    case '\t':
+      out.append("\\t");
+      break;
+    default: {
+      static const char kHex[] = "0123456789abcdef";
+      const char escaped[] = {
+          '\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+      out.append(escaped, sizeof(escaped));
+    }
+  }
+}
+
+} // namespace
+
+void sonarAppendJsonString(folly::StringPiece value, std::string& out) {
+  out.reserve(out.size() + value.size() + 2);
+  out.push_back('"');
+  const auto begin = reinterpret_cast<const unsigned char*>(value.begin());
+  const auto end = reinterpret_cast<const unsigned char*>(value.end());
+  static const auto plainPrefix = sonarSimdKernels().jsonPlainPrefix;
+  auto p = begin;
+  // Plain bytes not appended yet.
+  auto run = begin;
+  while (p < end) {
+    p += plainPrefix(reinterpret_cast<const char*>(p), end - p);
+    if (p == end) {
+      break;
+    }
+    const auto c = *p;
+    if (c >= 0x80) {
+      if (const auto length = utf8SequenceLength(p, end)) {
+        p += length;
+        continue;
+      }
+    }
+    out.append(reinterpret_cast<const char*>(run), p - run);
+    if (c >= 0x80) {
+      out.append("\xef\xbf\xbd");
+    } else {
+      appendEscaped(c, out);
+    }
+    run = ++p;
+  }
+  out.append(reinterpret_cast<const char*>(run), end - run);
+  out.push_back('"');
+}
+
+namespace {
+
+void appendJson(const folly::dynamic& value, std::string& out) {
+  switch (value.type()) {
+    case folly::dynamic::NULLT:
+      out.append("null");
+      break;
+    case folly::dynamic::BOOL:
+      out.append(value.getBool() ? "true" : "false");
+      break;
+    case folly::dynamic::INT64:
+      folly::toAppend(value.getInt(), &out);
+      break;
+    case folly::dynamic::DOUBLE:
+      if (!std::isfinite(value.getDouble())) {
+        throw std::invalid_argument("Non-finite numbers aren't valid JSON");
+      }
+      folly::toAppend(value.getDouble(), &out);
+      break;
+    case folly::dynamic::STRING:
+      sonarAppendJsonString(value.stringPiece(), out);
+      break;
+    case folly::dynamic::ARRAY: {
+      out.push_back('[');
+      bool first = true;
+      for (const auto& element : value) {
+        if (!first) {
+          out.push_back(',');
+        }
+        first = false;
+        appendJson(element, out);
+      }
+      out.push_back(']');
+      break;
+    }
+    case folly::dynamic::OBJECT: {
+      out.push_back('{');
+      bool first = true;
+      for (const auto& field : value.items()) {
+        if (!field.first.isString()) {
+          throw std::invalid_argument("JSON object keys must be strings");
+        }
+        if (!first) {
+          out.push_back(',');
+        }
+        first = false;
+        sonarAppendJsonString(field.first.stringPiece(), out);
+        out.push_back(':');
+        appendJson(field.second, out);
+      }
+      out.push_back('}');
+      break;
+    }
+  }
+}
+
+} // namespace
+
+void sonarAppendJson(const folly::dynamic& value, std::string& out) {
+  SONAR_COUNT_OP(jsonEncodes);
+  appendJson(value, out);
+}
+
+std::string sonarToJson(const folly::dynamic& value) {
+  std::string out;
+  sonarAppendJson(value, out);
+  return out;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,42 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Appends value to out as a quoted JSON string. The largest strings sent,
+ like network bodies, source text and long attribute values, are mostly
+ ASCII with nothing to escape, so they are scanned with the best kernel of
+ SonarSimd.h for plain runs, which are copied whole. Only the characters to
+ escape and multibyte sequences between them are handled one at a time.
+
+ Escapes like folly::json::escapeString with its default options, except
+ that bytes that aren't part of valid UTF-8 are replaced with U+FFFD rather
+ than sent as they are, which the desktop would fail to decode.
+ */
+void sonarAppendJsonString(folly::StringPiece value, std::string& out);
+
+/**
+ Appends value to out as folly::toJson with its default options would,
+ with strings written by sonarAppendJsonString. Throws
+ std::invalid_argument for NaN or infinite doubles and for object keys that
+ aren't strings.
+ */
+void sonarAppendJson(const folly::dynamic& value, std::string& out);
+
+std::string sonarToJson(const folly::dynamic& value);
+
+} // namespace sonar
+} // namespace facebook
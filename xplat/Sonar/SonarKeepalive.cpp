@@ -0,0 +1,251 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarKeepalive.h"
+#include <folly/io/async/AsyncTimeout.h>
+#include <rsocket/framing/Frame.h>
+#include <rsocket/framing/FrameSerializer.h>
+#include <rsocket/framing/FramedDuplexConnection.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace facebook {
+namespace sonar {
+
+constexpr std::chrono::milliseconds SonarKeepalive::kMinInterval;
+constexpr std::chrono::milliseconds SonarKeepalive::kMinTimeout;
+constexpr std::chrono::milliseconds SonarKeepalive::kMaxTimeout;
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+SonarKeepalive::SonarKeepalive(milliseconds ceiling, Clock::time_point now)
+    : ceiling_(ceiling),
+      interval_(std::min(kMinInterval, ceiling)),
+      lastRead_(now) {}
+
+void SonarKeepalive::setCeiling(milliseconds ceiling) {
+  ceiling_ = ceiling;
+  interval_ = std::min(interval_, ceiling_);
+}
+
+void SonarKeepalive::onRead(Clock::time_point now) {
+  lastRead_ = now;
+  if (!awaiting_) {
+    return;
+  }
+  awaiting_ = false;
+  const auto rtt = duration_cast<microseconds>(now - sentAt_);
+  smoothedRtt_ =
+      smoothedRtt_.count() == 0 ? rtt : (smoothedRtt_ * 7 + rtt) / 8;
+  // The link is quiet but alive, check it less often.
+  interval_ = std::min(interval_ * 2, ceiling_);
+}
+
+SonarKeepalive::Action SonarKeepalive::check(
+    Clock::time_point now,
+    milliseconds* next) {
+  // Rounded up, a timer firing early would only check again.
+  const auto until = [](Clock::duration remaining) {
+    return duration_cast<milliseconds>(remaining) + milliseconds(1);
+  };
+  if (awaiting_) {
+    const auto waited = now - sentAt_;
+    if (waited >= timeout()) {
+      return Action::fail;
+    }
+    *next = until(timeout() - waited);
+    return Action::wait;
+  }
+  const auto idle = now - lastRead_;
+  if (idle < interval_) {
+    *next = until(interval_ - idle);
+    return Action::wait;
+  }
+  awaiting_ = true;
+  sentAt_ = now;
+  *next = timeout();
+  return Action::send;
+}
+
+milliseconds SonarKeepalive::timeout() const {
+  if (smoothedRtt_.count() == 0) {
+    return kMaxTimeout;
+  }
+  return std::min(
+      std::max(duration_cast<milliseconds>(smoothedRtt_ * 4), kMinTimeout),
+      kMaxTimeout);
+}
+
+namespace {
+
+// What a connection shares with the subscriber reading from it, both only
+// use it on the connection's thread.
+struct KeepaliveState {
+  KeepaliveState(SonarKeepalive aKeepalive) : keepalive(aKeepalive) {}
+
+  SonarKeepalive keepalive;
+  std::shared_ptr<rsocket::DuplexConnection::Subscriber> input;
+  // Once the input has been completed or failed.
+  bool done = false;
+};
+
+class KeepaliveSubscriber : public rsocket::DuplexConnection::Subscriber {
+ public:
+  explicit KeepaliveSubscriber(std::shared_ptr<KeepaliveState> state)
+      : state_(std::move(state)) {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    if (state_->input) {
+      state_->input->onSubscribe(std::move(subscription));
+    }
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    state_->keepalive.onRead(SonarKeepalive::Clock::now());
+    if (!state_->done && state_->input) {
+      state_->input->onNext(std::move(frame));
+    }
+  }
+
+  void onComplete() override {
+    if (!state_->done && state_->input) {
+      state_->done = true;
+      state_->input->onComplete();
+    }
+  }
+
+  void onError(folly::exception_wrapper error) override {
+    if (!state_->done && state_->input) {
+      state_->done = true;
+      state_->input->onError(std::move(error));
+    }
+  }
+
+ private:
+  const std::shared_ptr<KeepaliveState> state_;
+};
+
+class KeepaliveConnection : public rsocket::DuplexConnection {
+ public:
+  KeepaliveConnection(
+      std::unique_ptr<rsocket::DuplexConnection> connection,
+      folly::EventBase& eventBase,
+      rsocket::ProtocolVersion version,
+      std::shared_ptr<SonarKeepalivePolicy> policy,
+      std::shared_ptr<rsocket::RSocketStats> stats)
+      : connection_(std::move(connection)),
+        eventBase_(eventBase),
+        serializer_(rsocket::FrameSerializer::createFrameSerializer(version)),
+        policy_(std::move(policy)),
+        stats_(std::move(stats)),
+        state_(std::make_shared<KeepaliveState>(SonarKeepalive(
+            policy_->ceiling(),
+            SonarKeepalive::Clock::now()))) {}
+
+  // Called on the connection's thread, where the keepalives run.
+  void setInput(std::shared_ptr<Subscriber> input) override {
+    state_->input = std::move(input);
+    connection_->setInput(std::make_shared<KeepaliveSubscriber>(state_));
+    if (!timer_) {
+      timer_ = folly::AsyncTimeout::make(
+          eventBase_, [this]() noexcept { check(); });
+      timer_->scheduleTimeout(state_->keepalive.interval());
+    }
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) override {
+    connection_->send(std::move(frame));
+  }
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  void check() {
+    if (state_->done) {
+      return;
+    }
+    state_->keepalive.setCeiling(policy_->ceiling());
+    std::chrono::milliseconds next;
+    switch (state_->keepalive.check(SonarKeepalive::Clock::now(), &next)) {
+      case SonarKeepalive::Action::fail:
+        state_->done = true;
+        if (state_->input) {
+          state_->input->onError(
+              std::runtime_error("The desktop stopped answering keepalives"));
+        }
+        return;
+      case SonarKeepalive::Action::send:
+        if (stats_) {
+          stats_->keepaliveSent();
+        }
+        connection_->send(serializer_->serializeOut(rsocket::Frame_KEEPALIVE(
+            rsocket::FrameFlags::KEEPALIVE_RESPOND,
+            0,
+            folly::IOBuf::create(0))));
+        break;
+      case SonarKeepalive::Action::wait:
+        break;
+    }
+    timer_->scheduleTimeout(next);
+  }
+
+  // Destroyed last, the timer goes first.
+  const std::unique_ptr<rsocket::DuplexConnection> connection_;
+  folly::EventBase& eventBase_;
+  const std::unique_ptr<rsocket::FrameSerializer> serializer_;
+  const std::shared_ptr<SonarKeepalivePolicy> policy_;
+  const std::shared_ptr<rsocket::RSocketStats> stats_;
+  const std::shared_ptr<KeepaliveState> state_;
+  std::unique_ptr<folly::AsyncTimeout> timer_;
+};
+
+} // namespace
+
+SonarKeepaliveConnectionFactory::SonarKeepaliveConnectionFactory(
+    std::unique_ptr<rsocket::ConnectionFactory> factory,
+    std::shared_ptr<SonarKeepalivePolicy> policy,
+    std::shared_ptr<rsocket::RSocketStats> stats)
+    : factory_(std::move(factory)),
+      policy_(std::move(policy)),
+      stats_(std::move(stats)) {}
+
+folly::Future<rsocket::ConnectionFactory::ConnectedDuplexConnection>
+SonarKeepaliveConnectionFactory::connect(
+    rsocket::ProtocolVersion version,
+    rsocket::ResumeStatus resume) {
+  if (version == rsocket::ProtocolVersion::Unknown) {
+    version = rsocket::ProtocolVersion::Latest;
+  }
+  auto policy = policy_;
+  auto stats = stats_;
+  return factory_->connect(version, resume)
+      .thenValue([version, policy, stats](ConnectedDuplexConnection connected) {
+        auto connection = std::move(connected.connection);
+        // Keepalives are sent between whole frames.
+        if (!connection->isFramed()) {
+          connection = std::make_unique<rsocket::FramedDuplexConnection>(
+              std::move(connection), version);
+        }
+        return ConnectedDuplexConnection{
+            std::make_unique<KeepaliveConnection>(
+                std::move(connection),
+                connected.eventBase,
+                version,
+                policy,
+                stats),
+            connected.eventBase};
+      });
+}
+
+} // namespace sonar
+} // namespace facebook
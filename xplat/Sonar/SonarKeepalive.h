@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <rsocket/ConnectionFactory.h>
+#include <rsocket/RSocketStats.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ When to send keepalives on a connection to the desktop, and when to give
+ up on it. Anything read from the desktop shows that it is alive, so a busy
+ link sends none. Once the link goes quiet, the first keepalive goes out
+ after kMinInterval and every answered one doubles the wait, up to the
+ ceiling. Whatever is read first after a keepalive is taken as its answer;
+ the round trip times set how long to wait for one. Not thread safe.
+ */
+class SonarKeepalive {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Action {
+    // Check again in next.
+    wait,
+    // Send a keepalive now, and check again in next.
+    send,
+    // The desktop didn't answer in time.
+    fail,
+  };
+
+  static constexpr std::chrono::milliseconds kMinInterval{5000};
+  static constexpr std::chrono::milliseconds kMinTimeout{3000};
+  static constexpr std::chrono::milliseconds kMaxTimeout{10000};
+
+  SonarKeepalive(std::chrono::milliseconds ceiling, Clock::time_point now);
+
+  /**
+   The longest wait between keepalives on a quiet link, which changes with
+   the app going to the background and back.
+   */
+  void setCeiling(std::chrono::milliseconds ceiling);
+
+  void onRead(Clock::time_point now);
+
+  Action check(Clock::time_point now, std::chrono::milliseconds* next);
+
+  std::chrono::milliseconds interval() const {
+    return interval_;
+  }
+
+  /**
+   How long to wait for an answer, 4 times the smoothed round trip time
+   within kMinTimeout and kMaxTimeout, kMaxTimeout before any is known.
+   */
+  std::chrono::milliseconds timeout() const;
+
+ private:
+  std::chrono::milliseconds ceiling_;
+  std::chrono::milliseconds interval_;
+  Clock::time_point lastRead_;
+  Clock::time_point sentAt_;
+  bool awaiting_ = false;
+  // 0 until the first answer.
+  std::chrono::microseconds smoothedRtt_{0};
+};
+
+/**
+ The keepalive ceilings of a socket's connections: one while the app is in
+ the foreground, a longer one while it's in the background. Safe to use
+ from any thread.
+ */
+class SonarKeepalivePolicy {
+ public:
+  SonarKeepalivePolicy(
+      std::chrono::milliseconds foreground,
+      std::chrono::milliseconds background)
+      : foreground_(foreground), background_(background) {}
+
+  void setInBackground(bool background) {
+    inBackground_ = background;
+  }
+
+  std::chrono::milliseconds ceiling() const {
+    return inBackground_ ? background_ : foreground_;
+  }
+
+ private:
+  const std::chrono::milliseconds foreground_;
+  const std::chrono::milliseconds background_;
+  std::atomic<bool> inBackground_{false};
+};
+
+/**
+ Makes connections through factory that keep themselves alive as
+ SonarKeepalive says, in place of rsocket's keepalives, which go out at a
+ fixed interval whatever the traffic. Clients using it should be created
+ with a keepalive interval of 0. A connection the desktop stops answering
+ on fails with an error, which closes the client.
+ */
+class SonarKeepaliveConnectionFactory : public rsocket::ConnectionFactory {
+ public:
+  SonarKeepaliveConnectionFactory(
+      std::unique_ptr<rsocket::ConnectionFactory> factory,
+      std::shared_ptr<SonarKeepalivePolicy> policy,
+      std::shared_ptr<rsocket::RSocketStats> stats);
+
+  folly::Future<ConnectedDuplexConnection> connect(
+      rsocket::ProtocolVersion version,
+      rsocket::ResumeStatus resume) override;
+
+ private:
+  const std::unique_ptr<rsocket::ConnectionFactory> factory_;
+  const std::shared_ptr<SonarKeepalivePolicy> policy_;
+  const std::shared_ptr<rsocket::RSocketStats> stats_;
+};
+
+} // namespace sonar
+} // namespace facebook
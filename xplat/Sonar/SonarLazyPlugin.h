@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarPlugin.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+using SonarPluginFactory = std::function<std::shared_ptr<SonarPlugin>()>;
+
+/**
+ Stands in for a plugin that is only built once it's needed, the first time
+ the desktop initializes it or someone asks for it with instance(). Until
+ then only its identifier exists, so a plugin the desktop never opens costs
+ nothing to set up. See SonarClient::addPluginFactory.
+ */
+class SonarLazyPlugin : public SonarPlugin {
+ public:
+  SonarLazyPlugin(std::string identifier, SonarPluginFactory factory)
+      : identifier_(std::move(identifier)), factory_(std::move(factory)) {}
+
+  std::string identifier() const override {
+    return identifier_;
+  }
+
+  /**
+   The plugin, built by the factory on first use. Throws if the factory
+   doesn't produce a plugin with this identifier.
+   */
+  std::shared_ptr<SonarPlugin> instance() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!instance_) {
+      auto plugin = factory_();
+      if (!plugin || plugin->identifier() != identifier_) {
+        throw std::runtime_error(
+            "factory of plugin " + identifier_ + " built another plugin.");
+      }
+      instance_ = std::move(plugin);
+      factory_ = nullptr;
+    }
+    return instance_;
+  }
+
+  // Null until built.
+  std::shared_ptr<SonarPlugin> builtInstance() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return instance_;
+  }
+
+  void didConnect(std::shared_ptr<SonarConnection> conn) override {
+    instance()->didConnect(std::move(conn));
+  }
+
+  void didDisconnect() override {
+    if (auto plugin = builtInstance()) {
+      plugin->didDisconnect();
+    }
+  }
+
+  // Lazy plugins only run once the desktop asks for them.
+  bool runInBackground() override {
+    return false;
+  }
+
+  void shedMemory(size_t bytes) override {
+    if (auto plugin = builtInstance()) {
+      plugin->shedMemory(bytes);
+    }
+  }
+
+ private:
+  const std::string identifier_;
+  std::mutex mutex_;
+  SonarPluginFactory factory_;
+  std::shared_ptr<SonarPlugin> instance_;
+};
+
+} // namespace sonar
+} // namespace facebook
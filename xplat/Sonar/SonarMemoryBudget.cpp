@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarMemoryBudget.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+bool SonarMemoryBudget::reserve(const std::string& plugin, size_t bytes) {
+  bool accepted = true;
+  bool scheduleShed = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto total = bytes_.load(std::memory_order_relaxed) + bytes;
+    if (hardLimit_ > 0 && total > hardLimit_) {
+      accepted = false;
+      refused_++;
+    } else {
+      usage_[plugin] += bytes;
+      bytes_.store(total, std::memory_order_relaxed);
+    }
+    if (softLimit_ > 0 && total > softLimit_ && !shedScheduled_) {
+      scheduleShed = shedScheduled_ = true;
+    }
+  }
+  if (scheduleShed) {
+    auto self = shared_from_this();
+    executor_->add([self]() { self->shed(); });
+  }
+  return accepted;
+}
+
+void SonarMemoryBudget::release(const std::string& plugin, size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto& iter = usage_.find(plugin);
+  if (iter == usage_.end()) {
+    return;
+  }
+  // Never below what was reserved, whatever the buffer claims.
+  bytes = std::min(bytes, iter->second);
+  iter->second -= bytes;
+  if (iter->second == 0) {
+    usage_.erase(iter);
+  }
+  bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void SonarMemoryBudget::setShedHandler(
+    const std::string& plugin,
+    ShedHandler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handler) {
+    shedHandlers_[plugin] = std::move(handler);
+  } else {
+    shedHandlers_.erase(plugin);
+  }
+}
+
+size_t SonarMemoryBudget::bytes(const std::string& plugin) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto& iter = usage_.find(plugin);
+  return iter != usage_.end() ? iter->second : 0;
+}
+
+folly::dynamic SonarMemoryBudget::usage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  folly::dynamic plugins = folly::dynamic::object();
+  for (const auto& iter : usage_) {
+    plugins[iter.first] = iter.second;
+  }
+  return folly::dynamic::object("bytes", bytes())("softLimit", softLimit_)(
+      "hardLimit", hardLimit_)("refused", refused_)("plugins", plugins);
+}
+
+void SonarMemoryBudget::shed() {
+  // Decided under the lock, handlers are called outside of it since they
+  // release what they free.
+  std::vector<std::pair<ShedHandler, size_t>> requests;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shedScheduled_ = false;
+    const auto total = bytes_.load(std::memory_order_relaxed);
+    if (total <= softLimit_) {
+      return;
+    }
+    std::vector<std::pair<std::string, size_t>> biggest(
+        usage_.begin(), usage_.end());
+    std::sort(
+        biggest.begin(),
+        biggest.end(),
+        [](const std::pair<std::string, size_t>& a,
+           const std::pair<std::string, size_t>& b) {
+          return a.second > b.second;
+        });
+    auto excess = total - softLimit_;
+    for (const auto& plugin : biggest) {
+      const auto& handler = shedHandlers_.find(plugin.first);
+      if (handler == shedHandlers_.end()) {
+        continue;
+      }
+      const auto share = std::min(excess, plugin.second);
+      requests.emplace_back(handler->second, share);
+      excess -= share;
+      if (excess == 0) {
+        break;
+      }
+    }
+  }
+  for (const auto& request : requests) {
+    request.first(request.second);
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
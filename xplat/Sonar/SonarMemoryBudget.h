@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Executor.h>
+#include <folly/dynamic.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ How short of memory the system is, as reported by the platform to
+ SonarClient::onMemoryPressure. Each level releases what the ones below it
+ do, and more.
+ */
+enum class SonarMemoryPressure {
+  // Plugins shed half of what the memory budget accounts to them, and half
+  // of the blobs held for the desktop are evicted, oldest first.
+  low,
+  // Plugins shed everything they hold on to, and all blobs are evicted.
+  moderate,
+  // Events waiting in the send queue are dropped as well, the app is about
+  // to be killed otherwise.
+  critical,
+};
+
+/**
+ Bytes buffered by Sonar on behalf of each plugin: queued messages, event
+ buffers and whatever else plugins choose to account. Buffers reserve what
+ they hold and release it once it is gone.
+
+ Past softLimit, the shed handlers are asked to free the excess, biggest
+ users first, on executor. Past hardLimit, reservations fail and the data is
+ dropped by the buffer instead. A limit of 0 doesn't limit. Safe to use from
+ any thread, must be owned by a shared_ptr.
+ */
+class SonarMemoryBudget
+    : public std::enable_shared_from_this<SonarMemoryBudget> {
+ public:
+  // Asked to free about bytes of what the plugin holds.
+  using ShedHandler = std::function<void(size_t bytes)>;
+
+  SonarMemoryBudget(
+      size_t softLimit,
+      size_t hardLimit,
+      folly::Executor* executor)
+      : softLimit_(softLimit), hardLimit_(hardLimit), executor_(executor) {}
+
+  /**
+   Account bytes against plugin. Returns false without accounting anything if
+   that would go over the hard limit.
+   */
+  bool reserve(const std::string& plugin, size_t bytes);
+
+  void release(const std::string& plugin, size_t bytes);
+
+  /**
+   Handler asked to shed for plugin, replacing any earlier one. An empty
+   handler removes it. Handlers run on executor, never inline with reserve,
+   so they may call back into the buffers that reserve.
+   */
+  void setShedHandler(const std::string& plugin, ShedHandler handler);
+
+  size_t bytes() const {
+    return bytes_.load(std::memory_order_relaxed);
+  }
+
+  size_t bytes(const std::string& plugin) const;
+
+  // Bytes held by each plugin holding any, and reservations refused so far.
+  folly::dynamic usage() const;
+
+ private:
+  void shed();
+
+  const size_t softLimit_;
+  const size_t hardLimit_;
+  folly::Executor* executor_;
+  std::atomic<size_t> bytes_{0};
+  mutable std::mutex mutex_;
+  std::map<std::string, size_t> usage_;
+  std::map<std::string, ShedHandler> shedHandlers_;
+  size_t refused_ = 0;
+  bool shedScheduled_ = false;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,255 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarMetrics.h"
+#include <folly/io/async/EventBase.h>
+#include <algorithm>
+#include <cmath>
+
+namespace facebook {
+namespace sonar {
+
+constexpr int SonarHistogram::kSubBucketBits;
+constexpr size_t SonarHistogram::kSubBuckets;
+constexpr size_t SonarHistogram::kBuckets;
+constexpr std::chrono::milliseconds SonarMetrics::kDefaultInterval;
+
+size_t SonarHistogram::bucketOf(uint64_t value) {
+  if (value < kSubBuckets) {
+    return value;
+  }
+  // The power of two, and the sub bucket from the bits right below it.
+  const int exponent = 63 - __builtin_clzll(value);
+  const int shift = exponent - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t SonarHistogram::lowerBound(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  const int shift = bucket / kSubBuckets - 1;
+  return (kSubBuckets + bucket % kSubBuckets) << shift;
+}
+
+void SonarHistogram::record(int64_t value) {
+  value = std::max<int64_t>(value, 0);
+  buckets_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  auto min = min_.load(std::memory_order_relaxed);
+  while (value < min &&
+         !min_.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+  }
+  auto max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+SonarHistogram::Summary SonarHistogram::take() {
+  Summary summary;
+  for (size_t i = 0; i < kBuckets; i++) {
+    // Most are empty, and are only read.
+    if (buckets_[i].load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    const auto count = buckets_[i].exchange(0, std::memory_order_relaxed);
+    if (count > 0) {
+      summary.count += count;
+      summary.buckets.emplace_back(lowerBound(i), count);
+    }
+  }
+  summary.sum = sum_.exchange(0, std::memory_order_relaxed);
+  summary.min = min_.exchange(INT64_MAX, std::memory_order_relaxed);
+  summary.max = max_.exchange(INT64_MIN, std::memory_order_relaxed);
+  if (summary.count == 0) {
+    return Summary();
+  }
+  // A sample recorded while taking may be in the buckets only.
+  if (summary.min == INT64_MAX) {
+    summary.min = summary.buckets.front().first;
+  }
+  if (summary.max == INT64_MIN) {
+    summary.max = summary.buckets.back().first;
+  }
+  return summary;
+}
+
+void SonarHistogram::Summary::merge(const Summary& other) {
+  if (other.count == 0) {
+    return;
+  }
+  min = count > 0 ? std::min(min, other.min) : other.min;
+  max = count > 0 ? std::max(max, other.max) : other.max;
+  count += other.count;
+  sum += other.sum;
+  std::vector<std::pair<int64_t, uint64_t>> merged;
+  merged.reserve(buckets.size() + other.buckets.size());
+  auto left = buckets.begin();
+  auto right = other.buckets.begin();
+  while (left != buckets.end() || right != other.buckets.end()) {
+    if (right == other.buckets.end() ||
+        (left != buckets.end() && left->first < right->first)) {
+      merged.push_back(*left++);
+    } else if (left == buckets.end() || right->first < left->first) {
+      merged.push_back(*right++);
+    } else {
+      merged.emplace_back(left->first, left->second + right->second);
+      ++left;
+      ++right;
+    }
+  }
+  buckets = std::move(merged);
+}
+
+int64_t SonarHistogram::Summary::percentile(double fraction) const {
+  if (count == 0) {
+    return 0;
+  }
+  const auto rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(fraction * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i].second;
+    if (seen >= rank) {
+      // The middle of the bucket, within what was actually seen.
+      const auto lower = buckets[i].first;
+      const auto bucket = bucketOf(lower);
+      const auto width = lowerBound(bucket + 1) - lowerBound(bucket);
+      const auto middle = lower + static_cast<int64_t>((width - 1) / 2);
+      return std::min(std::max(middle, min), max);
+    }
+  }
+  return max;
+}
+
+folly::dynamic SonarHistogram::Summary::toDynamic() const {
+  folly::dynamic encoded = folly::dynamic::array;
+  for (const auto& bucket : buckets) {
+    encoded.push_back(folly::dynamic::array(
+        bucket.first, static_cast<int64_t>(bucket.second)));
+  }
+  return folly::dynamic::object("count", static_cast<int64_t>(count))(
+      "sum", sum)("min", min)("max", max)("p50", percentile(0.5))(
+      "p90", percentile(0.9))("p99", percentile(0.99))(
+      "buckets", std::move(encoded));
+}
+
+SonarMetrics::SonarMetrics(Sender sender, std::chrono::milliseconds interval)
+    : sender_(std::move(sender)),
+      interval_(interval),
+      lastFlush_(Clock::now()) {}
+
+void SonarMetrics::setFlushWorker(folly::EventBase* worker) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    worker_ = worker;
+  }
+  startFlushing();
+}
+
+std::shared_ptr<SonarHistogram> SonarMetrics::histogram(
+    const std::string& method) {
+  std::shared_ptr<SonarHistogram> histogram;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = histograms_[method];
+    if (!entry) {
+      entry = std::make_shared<SonarHistogram>();
+    }
+    histogram = entry;
+  }
+  startFlushing();
+  return histogram;
+}
+
+std::shared_ptr<SonarCounter> SonarMetrics::counter(
+    const std::string& method) {
+  std::shared_ptr<SonarCounter> counter;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = counters_[method];
+    if (!entry) {
+      entry = std::make_shared<SonarCounter>();
+    }
+    counter = entry;
+  }
+  startFlushing();
+  return counter;
+}
+
+void SonarMetrics::flush(Clock::time_point now) {
+  std::vector<std::pair<std::string, std::shared_ptr<SonarHistogram>>>
+      histograms;
+  std::vector<std::pair<std::string, std::shared_ptr<SonarCounter>>> counters;
+  int64_t intervalMs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms.assign(histograms_.begin(), histograms_.end());
+    counters.assign(counters_.begin(), counters_.end());
+    intervalMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     now - lastFlush_)
+                     .count();
+    lastFlush_ = now;
+  }
+  // Sent outside the lock, recording never waits for the socket.
+  for (const auto& entry : histograms) {
+    const auto summary = entry.second->take();
+    if (summary.count == 0) {
+      continue;
+    }
+    auto params = summary.toDynamic();
+    params["intervalMs"] = intervalMs;
+    sender_(entry.first, std::move(params));
+  }
+  for (const auto& entry : counters) {
+    const auto count = entry.second->take();
+    if (count == 0) {
+      continue;
+    }
+    sender_(
+        entry.first,
+        folly::dynamic::object("count", count)("intervalMs", intervalMs));
+  }
+}
+
+void SonarMetrics::startFlushing() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!worker_ || flushScheduled_ ||
+        (histograms_.empty() && counters_.empty())) {
+      return;
+    }
+    flushScheduled_ = true;
+  }
+  scheduleFlush();
+}
+
+void SonarMetrics::scheduleFlush() {
+  folly::EventBase* worker;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    worker = worker_;
+  }
+  // Stops once the metrics are gone, with the connection they belong to.
+  std::weak_ptr<SonarMetrics> weak = shared_from_this();
+  const auto delay = static_cast<uint32_t>(interval_.count());
+  worker->runInEventBaseThread([weak, worker, delay]() {
+    worker->runAfterDelay(
+        [weak]() {
+          if (auto self = weak.lock()) {
+            self->flush();
+            self->scheduleFlush();
+          }
+        },
+        delay);
+  });
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/dynamic.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace folly {
+class EventBase;
+}
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Samples of a measurement such as frame or request times, in whatever unit
+ the plugin picks, aggregated on the device instead of being sent one event
+ each. Values are counted in log-linear buckets: exact below 16, and past
+ that each power of two is split into 16 buckets, so a bucket is never wider
+ than 1/16th of its values. Negative values count as 0.
+
+ record is lock-free and safe from any thread. Samples recorded while the
+ histogram is being taken count in either interval.
+ */
+class SonarHistogram {
+ public:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+  // Enough for every non-negative int64_t.
+  static constexpr size_t kBuckets = (64 - kSubBucketBits) * kSubBuckets;
+
+  /**
+   What was recorded over an interval. Summaries of the same measurement can
+   be merged, e.g. across processes or intervals.
+   */
+  struct Summary {
+    uint64_t count = 0;
+    int64_t sum = 0;
+    int64_t min = 0;
+    int64_t max = 0;
+    // Lower bound and count of each bucket with samples, by lower bound.
+    std::vector<std::pair<int64_t, uint64_t>> buckets;
+
+    void merge(const Summary& other);
+
+    /**
+     The value below which about the given fraction of the samples are,
+     within a bucket's width, or 0 without samples.
+     */
+    int64_t percentile(double fraction) const;
+
+    // The event sent to the desktop, see SonarMetrics.
+    folly::dynamic toDynamic() const;
+  };
+
+  void record(int64_t value);
+
+  // What was recorded since the last take, which starts over.
+  Summary take();
+
+  static size_t bucketOf(uint64_t value);
+  static uint64_t lowerBound(size_t bucket);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<int64_t> sum_{0};
+  std::atomic<int64_t> min_{INT64_MAX};
+  std::atomic<int64_t> max_{INT64_MIN};
+};
+
+/**
+ A count of occurrences, such as cache misses, sent as its increase over
+ each interval. add is lock-free and safe from any thread.
+ */
+class SonarCounter {
+ public:
+  void add(int64_t amount = 1) {
+    value_.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  // The amount added since the last take, which starts over.
+  int64_t take() {
+    return value_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+/**
+ The histograms and counters of a connection. Each is flushed as a single
+ event of its method per interval, summarizing what was recorded, so that
+ thousands of samples a second cost one small message. Intervals without
+ samples send nothing. A histogram's event has its count, sum, min, max,
+ p50, p90 and p99, and its non-empty buckets as [lowerBound, count] pairs; a
+ counter's has its count. Both have the interval they cover in intervalMs.
+
+ Flushes happen every interval on the flush worker, or with flush. Safe to
+ use from any thread. Must be owned by a shared_ptr.
+ */
+class SonarMetrics : public std::enable_shared_from_this<SonarMetrics> {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Sender =
+      std::function<void(const std::string& method, folly::dynamic params)>;
+
+  static constexpr std::chrono::milliseconds kDefaultInterval{1000};
+
+  explicit SonarMetrics(
+      Sender sender,
+      std::chrono::milliseconds interval = kDefaultInterval);
+
+  /**
+   Flush every interval on worker, which must outlive this, from the first
+   metric on.
+   */
+  void setFlushWorker(folly::EventBase* worker);
+
+  // The same for every call with the same method.
+  std::shared_ptr<SonarHistogram> histogram(const std::string& method);
+  std::shared_ptr<SonarCounter> counter(const std::string& method);
+
+  // Send what was recorded since the last flush.
+  void flush(Clock::time_point now = Clock::now());
+
+ private:
+  void startFlushing();
+  void scheduleFlush();
+
+  const Sender sender_;
+  const std::chrono::milliseconds interval_;
+
+  std::mutex mutex_;
+  folly::EventBase* worker_ = nullptr;
+  bool flushScheduled_ = false;
+  Clock::time_point lastFlush_;
+  std::map<std::string, std::shared_ptr<SonarHistogram>> histograms_;
+  std::map<std::string, std::shared_ptr<SonarCounter>> counters_;
+};
+
+} // namespace sonar
+} // namespace facebook
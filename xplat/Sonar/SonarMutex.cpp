@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarMutex.h"
+
+#if FB_SONAR_LOCK_PROFILING
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+namespace facebook {
+namespace sonar {
+
+#if FB_SONAR_LOCK_PROFILING
+
+namespace {
+
+struct SiteProfile {
+  uint64_t acquisitions = 0;
+  uint64_t contended = 0;
+  uint64_t totalWaitMicros = 0;
+  uint64_t maxWaitMicros = 0;
+  uint64_t totalHoldMicros = 0;
+  uint64_t maxHoldMicros = 0;
+};
+
+// Keyed by the name and site pointers, which are string literals.
+using Profiles =
+    std::map<std::pair<const char*, const char*>, SiteProfile>;
+
+std::mutex& profilesMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+Profiles& profiles() {
+  static Profiles profiles;
+  return profiles;
+}
+
+uint64_t micros(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+} // namespace
+
+void SonarMutex::lock(const char* site) {
+  SONAR_COUNT_OP(lockAcquisitions);
+  const auto start = Clock::now();
+  if (mutex_.try_lock()) {
+    acquired_ = start;
+  } else {
+    mutex_.lock();
+    acquired_ = Clock::now();
+  }
+  site_ = site;
+  waited_ = acquired_ - start;
+}
+
+void SonarMutex::unlock() {
+  const auto held = Clock::now() - acquired_;
+  const auto site = site_;
+  const auto waited = waited_;
+  mutex_.unlock();
+
+  std::lock_guard<std::mutex> lock(profilesMutex());
+  auto& profile = profiles()[std::make_pair(name_, site)];
+  profile.acquisitions++;
+  if (waited > Clock::duration::zero()) {
+    profile.contended++;
+  }
+  profile.totalWaitMicros += micros(waited);
+  profile.maxWaitMicros = std::max(profile.maxWaitMicros, micros(waited));
+  profile.totalHoldMicros += micros(held);
+  profile.maxHoldMicros = std::max(profile.maxHoldMicros, micros(held));
+}
+
+folly::dynamic sonarLockProfile() {
+  std::map<std::string, std::vector<std::pair<std::string, SiteProfile>>>
+      byMutex;
+  {
+    std::lock_guard<std::mutex> lock(profilesMutex());
+    for (const auto& iter : profiles()) {
+      const char* site = iter.first.second;
+      // Only the file name is of interest, not where it was built.
+      const char* file = strrchr(site, '/');
+      byMutex[iter.first.first].emplace_back(
+          file ? file + 1 : site, iter.second);
+    }
+  }
+  auto result = folly::dynamic::object();
+  for (auto& iter : byMutex) {
+    auto& sites = iter.second;
+    std::sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) {
+      return a.second.totalHoldMicros > b.second.totalHoldMicros;
+    });
+    auto list = folly::dynamic::array();
+    for (const auto& site : sites) {
+      const auto& profile = site.second;
+      list.push_back(folly::dynamic::object("site", site.first)(
+          "acquisitions", profile.acquisitions)(
+          "contended", profile.contended)(
+          "totalWaitMicros", profile.totalWaitMicros)(
+          "maxWaitMicros", profile.maxWaitMicros)(
+          "totalHoldMicros", profile.totalHoldMicros)(
+          "maxHoldMicros", profile.maxHoldMicros));
+    }
+    result[iter.first] = std::move(list);
+  }
+  return result;
+}
+
+#else
+
+folly::dynamic sonarLockProfile() {
+  return nullptr;
+}
+
+#endif
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarOpCounts.h>
+#include <folly/dynamic.h>
+#include <chrono>
+#include <mutex>
+
+/**
+ Mutexes of the client and connections that can be profiled. Build with
+ FB_SONAR_LOCK_PROFILING=1 to record, for each mutex and call site, how long
+ threads waited to acquire it and how long they held it, see
+ sonarLockProfile. Otherwise SonarMutex is a plain std::mutex and the call
+ sites compile away.
+ */
+#ifndef FB_SONAR_LOCK_PROFILING
+#define FB_SONAR_LOCK_PROFILING 0
+#endif
+
+#define SONAR_LOCK_STRINGIFY_(x) #x
+#define SONAR_LOCK_STRINGIFY(x) SONAR_LOCK_STRINGIFY_(x)
+// Identifies where a lock is taken in the profile.
+#define SONAR_LOCK_SITE __FILE__ ":" SONAR_LOCK_STRINGIFY(__LINE__)
+
+namespace facebook {
+namespace sonar {
+
+#if FB_SONAR_LOCK_PROFILING
+
+class SonarMutex {
+ public:
+  /**
+   name must outlive the mutex, typically it is a string literal, as must
+   the sites it is locked from.
+   */
+  explicit SonarMutex(const char* name) : name_(name) {}
+
+  SonarMutex(const SonarMutex&) = delete;
+  SonarMutex& operator=(const SonarMutex&) = delete;
+
+  void lock(const char* site);
+  void unlock();
+
+  // For std::lock_guard and the like, recorded under an unknown site.
+  void lock() {
+    lock("<unknown>");
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::mutex mutex_;
+  const char* name_;
+  // Of the current holder, guarded by mutex_ itself.
+  const char* site_ = nullptr;
+  Clock::duration waited_;
+  Clock::time_point acquired_;
+};
+
+#else
+
+class SonarMutex {
+ public:
+  explicit SonarMutex(const char*) {}
+
+  SonarMutex(const SonarMutex&) = delete;
+  SonarMutex& operator=(const SonarMutex&) = delete;
+
+  void lock(const char*) {
+    SONAR_COUNT_OP(lockAcquisitions);
+    mutex_.lock();
+  }
+
+  void lock() {
+    lock(nullptr);
+  }
+
+  void unlock() {
+    mutex_.unlock();
+  }
+
+ private:
+  std::mutex mutex_;
+};
+
+#endif
+
+/**
+ Same as std::lock_guard, with the call site taking the lock, usually
+ SONAR_LOCK_SITE.
+ */
+class SonarLockGuard {
+ public:
+  SonarLockGuard(SonarMutex& mutex, const char* site) : mutex_(mutex) {
+    mutex_.lock(site);
+  }
+
+  ~SonarLockGuard() {
+    mutex_.unlock();
+  }
+
+  SonarLockGuard(const SonarLockGuard&) = delete;
+  SonarLockGuard& operator=(const SonarLockGuard&) = delete;
+
+ private:
+  SonarMutex& mutex_;
+};
+
+/**
+ For each mutex, by call site: acquisitions, how many had to wait, and the
+ total and longest wait and hold in microseconds, sites holding the longest
+ first. Null unless built with FB_SONAR_LOCK_PROFILING.
+ */
+folly::dynamic sonarLockProfile();
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,324 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarNetworkReporter.h"
+#include "SonarBase64.h"
+#include "SonarJsonWriter.h"
+
+#include <folly/Conv.h>
+#include <folly/json.h>
+#include <algorithm>
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+void appendString(std::string& out, folly::StringPiece value) {
+  sonarAppendJsonString(value, out);
+}
+
+void appendOptionalString(
+    std::string& out,
+    const folly::Optional<std::string>& value) {
+  if (value) {
+    appendString(out, *value);
+  } else {
+    out.append("null");
+  }
+}
+
+// Wraps the string in an IOBuf without copying its contents.
+std::unique_ptr<folly::IOBuf> toIOBuf(std::string&& data) {
+  auto* owned = new std::string(std::move(data));
+  return folly::IOBuf::takeOwnership(
+      &(*owned)[0],
+      owned->size(),
+      [](void*, void* userData) { delete static_cast<std::string*>(userData); },
+      owned);
+}
+
+} // namespace
+
+SonarNetworkReporter::SonarNetworkReporter(Options options)
+    : options_(options),
+      buffer_(options.maxBufferedBytes, options.memoryBudget, "Network"),
+      tokens_(options.maxRequestsPerSecond),
+      lastRefill_(std::chrono::steady_clock::now()) {}
+
+void SonarNetworkReporter::setSender(Sender sender) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sender_ = std::move(sender);
+  disableHeaderTable();
+  setUrlFilter(nullptr);
+  if (!sender_) {
+    return;
+  }
+  for (auto& event : buffer_.takeAll()) {
+    sender_(event.method, std::move(event.params));
+  }
+}
+
+void SonarNetworkReporter::setConnection(
+    std::shared_ptr<SonarConnection> connection) {
+  if (!connection) {
+    setSender(nullptr);
+    return;
+  }
+  setSender([connection](
+                const std::string& method,
+                std::unique_ptr<folly::IOBuf> params) {
+    connection->sendRaw(method, std::move(params));
+  });
+}
+
+void SonarNetworkReporter::reportRequest(const Request& request) {
+  const auto id = folly::toJson(request.id);
+  // Platforms that check shouldCapture first never get here with these.
+  const bool captured = !request.url || shouldCapture(*request.url);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!captured) {
+    filtered_++;
+    dropRequest(id);
+    return;
+  }
+  if (!admitRequest(std::chrono::steady_clock::now())) {
+    rateLimited_++;
+    dropRequest(id);
+    return;
+  }
+
+  std::string params;
+  params.append("{\"id\":").append(id);
+  params.append(",\"timestamp\":");
+  folly::toAppend(request.timestamp, &params);
+  params.append(",\"method\":");
+  appendOptionalString(params, request.method);
+  params.append(",\"url\":");
+  appendOptionalString(params, request.url);
+  appendHeaders(params, request.headers);
+  params.append(",\"data\":");
+  appendBody(params, request.body);
+  params.push_back('}');
+  send("newRequest", std::move(params));
+}
+
+void SonarNetworkReporter::reportResponse(const Response& response) {
+  const auto id = folly::toJson(response.id);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The desktop would have no request to show it with. The id is kept for
+  // a report of the body to come.
+  if (response.bodyPending ? limitedIds_.count(id) > 0
+                           : limitedIds_.erase(id) > 0) {
+    return;
+  }
+
+  std::string params;
+  params.append("{\"id\":").append(id);
+  params.append(",\"timestamp\":");
+  folly::toAppend(response.timestamp, &params);
+  params.append(",\"status\":");
+  folly::toAppend(response.status, &params);
+  params.append(",\"reason\":");
+  appendOptionalString(params, response.reason);
+  appendHeaders(params, response.headers);
+  params.append(",\"data\":");
+  appendBody(params, response.body);
+  params.push_back('}');
+  send("newResponse", std::move(params));
+}
+
+int64_t SonarNetworkReporter::enableHeaderTable() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  disableHeaderTable();
+  headerTableEnabled_ = true;
+  return ++headerTableGeneration_;
+}
+
+void SonarNetworkReporter::setUrlFilter(
+    std::shared_ptr<const SonarUrlFilter> filter) {
+  if (filter && filter->empty()) {
+    filter = nullptr;
+  }
+  const bool hasFilter = filter != nullptr;
+  std::atomic_store(&urlFilter_, std::move(filter));
+  hasUrlFilter_.store(hasFilter, std::memory_order_release);
+}
+
+bool SonarNetworkReporter::shouldCapture(folly::StringPiece url) const {
+  if (!hasUrlFilter_.load(std::memory_order_acquire)) {
+    return true;
+  }
+  const auto filter = std::atomic_load(&urlFilter_);
+  return !filter || filter->matches(url);
+}
+
+std::vector<SonarEventBuffer::Event> SonarNetworkReporter::takeBuffered() {
+  return buffer_.takeAll();
+}
+
+size_t SonarNetworkReporter::shedBuffered(size_t bytes) {
+  return buffer_.shed(bytes);
+}
+
+size_t SonarNetworkReporter::droppedEvents() const {
+  return buffer_.dropped();
+}
+
+size_t SonarNetworkReporter::rateLimitedRequests() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rateLimited_;
+}
+
+size_t SonarNetworkReporter::filteredRequests() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return filtered_;
+}
+
+void SonarNetworkReporter::appendHeaders(
+    std::string& out,
+    const std::vector<Header>& headers) {
+  out.append(",\"headers\":");
+  if (headerTableEnabled_) {
+    appendHeaderStrings(out, headers);
+    return;
+  }
+  out.push_back('[');
+  std::string key;
+  for (size_t i = 0; i < headers.size(); i++) {
+    if (i) {
+      out.push_back(',');
+    }
+    const auto& header = headers[i];
+    key.assign(header.name).push_back('\0');
+    key.append(header.value);
+    auto interned = internedHeaders_.find(key);
+    if (interned == internedHeaders_.end()) {
+      if (internedHeaders_.size() >= kMaxInternedHeaders) {
+        internedHeaders_.clear();
+      }
+      std::string json("{\"key\":");
+      appendString(json, header.name);
+      json.append(",\"value\":");
+      appendString(json, header.value);
+      json.push_back('}');
+      interned = internedHeaders_.emplace(key, std::move(json)).first;
+    }
+    out.append(interned->second);
+  }
+  out.push_back(']');
+}
+
+void SonarNetworkReporter::appendHeaderStrings(
+    std::string& out,
+    const std::vector<Header>& headers) {
+  const size_t first = headerTable_.size();
+  std::vector<const std::string*> added;
+  out.push_back('[');
+  for (size_t i = 0; i < headers.size(); i++) {
+    if (i) {
+      out.push_back(',');
+    }
+    appendTableEntry(out, headers[i].name, true, added);
+    out.push_back(',');
+    appendTableEntry(out, headers[i].value, false, added);
+  }
+  out.append("],\"headerTable\":{\"generation\":");
+  folly::toAppend(headerTableGeneration_, &out);
+  out.append(",\"first\":");
+  folly::toAppend(first, &out);
+  out.append(",\"strings\":[");
+  for (size_t i = 0; i < added.size(); i++) {
+    if (i) {
+      out.push_back(',');
+    }
+    appendString(out, *added[i]);
+  }
+  out.append("]}");
+}
+
+void SonarNetworkReporter::appendTableEntry(
+    std::string& out,
+    const std::string& string,
+    bool internFirstTime,
+    std::vector<const std::string*>& added) {
+  const auto found = headerTable_.find(string);
+  if (found != headerTable_.end()) {
+    folly::toAppend(found->second, &out);
+    return;
+  }
+  const bool intern = headerTable_.size() < kMaxHeaderTableSize &&
+      (internFirstTime || !headerValuesSeen_.insert(string).second);
+  if (!intern) {
+    if (headerValuesSeen_.size() > kMaxHeaderTableSize) {
+      headerValuesSeen_.clear();
+    }
+    appendString(out, string);
+    return;
+  }
+  headerValuesSeen_.erase(string);
+  const size_t index = headerTable_.size();
+  // Keys of an unordered_map stay where they are as it grows.
+  added.push_back(&headerTable_.emplace(string, index).first->first);
+  folly::toAppend(index, &out);
+}
+
+void SonarNetworkReporter::disableHeaderTable() {
+  headerTableEnabled_ = false;
+  headerTable_.clear();
+  headerValuesSeen_.clear();
+}
+
+void SonarNetworkReporter::appendBody(
+    std::string& out,
+    const folly::Optional<folly::ByteRange>& body) const {
+  if (!body) {
+    out.append("null");
+    return;
+  }
+  out.push_back('"');
+  appendBase64(
+      out, body->subpiece(0, std::min(body->size(), options_.maxBodyBytes)));
+  out.push_back('"');
+}
+
+bool SonarNetworkReporter::admitRequest(
+    std::chrono::steady_clock::time_point now) {
+  const auto rate = options_.maxRequestsPerSecond;
+  if (!rate) {
+    return true;
+  }
+  // Refilled continuously, up to a second's worth of requests.
+  const std::chrono::duration<double> elapsed = now - lastRefill_;
+  lastRefill_ = now;
+  tokens_ = std::min<double>(rate, tokens_ + elapsed.count() * rate);
+  if (tokens_ < 1) {
+    return false;
+  }
+  tokens_--;
+  return true;
+}
+
+void SonarNetworkReporter::dropRequest(const std::string& id) {
+  if (limitedIds_.size() >= kMaxLimitedIds) {
+    limitedIds_.clear();
+  }
+  limitedIds_.insert(id);
+}
+
+void SonarNetworkReporter::send(std::string method, std::string params) {
+  auto data = toIOBuf(std::move(params));
+  if (sender_) {
+    sender_(method, std::move(data));
+  } else {
+    buffer_.append(std::move(method), std::move(data));
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,202 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarConnection.h>
+#include <Sonar/SonarEventBuffer.h>
+#include <Sonar/SonarUrlFilter.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ The part of the network plugin shared by iOS and Android. Requests and
+ responses are written straight to the JSON the desktop plugin expects, and
+ either sent right away or, while no desktop is connected, kept serialized in
+ a SonarEventBuffer. The platform plugins only translate their request and
+ response objects and tell the reporter where to send.
+
+ Bodies over maxBodyBytes are truncated. With maxRequestsPerSecond set,
+ requests beyond that rate are dropped together with their responses, so that
+ a burst of traffic can't flood the connection. Safe to use from any thread.
+
+ Once the desktop asks for it with enableHeaderTable, header names and
+ repeated values are sent as indexes into a string table instead of as
+ strings. Each event's "headerTable" holds the strings it adds to the table,
+ numbered on from "first", and the table's "generation". Entries of
+ "headers" alternate names and values, each either an index or a string. The
+ table only lasts for the connection, events sent to the next one or
+ buffered in between use plain headers until it is enabled again.
+
+ The desktop can also push a SonarUrlFilter, after which requests it doesn't
+ match are dropped with their responses. The platforms check shouldCapture
+ before reading a request's headers and body, so that dropped requests cost
+ next to nothing. Like the header table, the filter only lasts for the
+ connection.
+ */
+class SonarNetworkReporter {
+ public:
+  using Sender = std::function<
+      void(const std::string& method, std::unique_ptr<folly::IOBuf> params)>;
+
+  struct Header {
+    std::string name;
+    std::string value;
+  };
+
+  struct Request {
+    // A number or a string, sent as it is.
+    folly::dynamic id;
+    int64_t timestamp = 0;
+    folly::Optional<std::string> method;
+    folly::Optional<std::string> url;
+    std::vector<Header> headers;
+    // Sent base64 encoded, null without a body.
+    folly::Optional<folly::ByteRange> body;
+  };
+
+  struct Response {
+    folly::dynamic id;
+    int64_t timestamp = 0;
+    int64_t status = 0;
+    folly::Optional<std::string> reason;
+    std::vector<Header> headers;
+    folly::Optional<folly::ByteRange> body;
+    // Set when the response is reported again, with its body, once that has
+    // been read. The desktop shows the latest report for an id.
+    bool bodyPending = false;
+  };
+
+  struct Options {
+    size_t maxBufferedBytes = 1024 * 1024;
+    size_t maxBodyBytes = 1024 * 1024;
+    // 0 doesn't limit the rate.
+    size_t maxRequestsPerSecond = 0;
+    // Buffered events are accounted in it as the Network plugin's.
+    std::shared_ptr<SonarMemoryBudget> memoryBudget = nullptr;
+  };
+
+  explicit SonarNetworkReporter(Options options);
+
+  /**
+   Events are sent through sender from now on, buffered ones first, oldest
+   first. An empty sender buffers them again. Sender is called with the
+   reporter's lock held, so it must not call back into the reporter.
+   */
+  void setSender(Sender sender);
+
+  /**
+   Same as setSender, sending with connection->sendRaw. Null disconnects.
+   */
+  void setConnection(std::shared_ptr<SonarConnection> connection);
+
+  void reportRequest(const Request& request);
+  void reportResponse(const Response& response);
+
+  /**
+   Start a new, empty header table, used by events reported from now on.
+   Returns its generation, which is higher than that of any earlier table.
+   The desktop calls this again to start over if it misses an event.
+   */
+  int64_t enableHeaderTable();
+
+  /**
+   Only capture requests filter matches from now on, until the connection
+   changes. Null captures all of them again.
+   */
+  void setUrlFilter(std::shared_ptr<const SonarUrlFilter> filter);
+
+  /**
+   Whether requests to url are reported, for the platforms to check before
+   capturing them. Doesn't take the reporter's lock.
+   */
+  bool shouldCapture(folly::StringPiece url) const;
+
+  /**
+   Take all buffered events, oldest first, for senders that can't be called
+   from native code.
+   */
+  std::vector<SonarEventBuffer::Event> takeBuffered();
+
+  /**
+   Drop the oldest buffered events, for SonarPlugin::shedMemory. Returns the
+   bytes freed.
+   */
+  size_t shedBuffered(size_t bytes);
+
+  // Events dropped to stay within maxBufferedBytes.
+  size_t droppedEvents() const;
+  // Requests dropped to stay within maxRequestsPerSecond.
+  size_t rateLimitedRequests() const;
+  // Requests dropped because the URL filter didn't match them.
+  size_t filteredRequests() const;
+
+ private:
+  // Serialized headers are reused, most requests of an app repeat the same
+  // few. The cache starts over once it holds this many.
+  static constexpr size_t kMaxInternedHeaders = 512;
+  // Ids of requests that never get a response would otherwise pile up.
+  static constexpr size_t kMaxLimitedIds = 4096;
+  // Strings past this are sent as they are.
+  static constexpr size_t kMaxHeaderTableSize = 4096;
+
+  // Appends the "headers" member, and "headerTable" if it is enabled.
+  void appendHeaders(std::string& out, const std::vector<Header>& headers);
+  void appendHeaderStrings(std::string& out, const std::vector<Header>& headers);
+  void appendTableEntry(
+      std::string& out,
+      const std::string& string,
+      bool internFirstTime,
+      std::vector<const std::string*>& added);
+  void disableHeaderTable();
+  void appendBody(
+      std::string& out,
+      const folly::Optional<folly::ByteRange>& body) const;
+  bool admitRequest(std::chrono::steady_clock::time_point now);
+  void dropRequest(const std::string& id);
+  void send(std::string method, std::string params);
+
+  const Options options_;
+  SonarEventBuffer buffer_;
+  mutable std::mutex mutex_;
+  Sender sender_;
+  std::unordered_map<std::string, std::string> internedHeaders_;
+  bool headerTableEnabled_ = false;
+  int64_t headerTableGeneration_ = 0;
+  std::unordered_map<std::string, size_t> headerTable_;
+  // Values are only added to the table once they repeat, most that don't
+  // are dates, lengths and ids.
+  std::unordered_set<std::string> headerValuesSeen_;
+  // Token bucket for maxRequestsPerSecond.
+  double tokens_;
+  std::chrono::steady_clock::time_point lastRefill_;
+  // Serialized ids of dropped requests whose response hasn't come yet.
+  std::unordered_set<std::string> limitedIds_;
+  size_t rateLimited_ = 0;
+  // Read without the lock, hasUrlFilter_ saves loading it when there is none.
+  std::shared_ptr<const SonarUrlFilter> urlFilter_;
+  std::atomic<bool> hasUrlFilter_{false};
+  size_t filtered_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,183 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarOfflineCapture.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace facebook {
+namespace sonar {
+
+SonarOfflineCapture::SonarOfflineCapture(
+    const std::string& path,
+    size_t capacity)
+    : path_(path), capacity_(capacity) {
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  if (::ftruncate(fd_, capacity) != 0) {
+    const auto error = errno;
+    ::close(fd_);
+    ::unlink(path.c_str());
+    throw std::system_error(error, std::generic_category(), "ftruncate " + path);
+  }
+  void* data =
+      ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    const auto error = errno;
+    ::close(fd_);
+    ::unlink(path.c_str());
+    throw std::system_error(error, std::generic_category(), "mmap " + path);
+  }
+  data_ = static_cast<uint8_t*>(data);
+}
+
+SonarOfflineCapture::~SonarOfflineCapture() {
+  ::munmap(data_, capacity_);
+  ::close(fd_);
+  ::unlink(path_.c_str());
+}
+
+void SonarOfflineCapture::write(
+    size_t offset,
+    const void* data,
+    size_t length) {
+  const auto first = std::min(length, capacity_ - offset);
+  std::memcpy(data_ + offset, data, first);
+  std::memcpy(data_, static_cast<const uint8_t*>(data) + first, length - first);
+}
+
+void SonarOfflineCapture::read(size_t offset, void* data, size_t length)
+    const {
+  const auto first = std::min(length, capacity_ - offset);
+  std::memcpy(data, data_ + offset, first);
+  std::memcpy(static_cast<uint8_t*>(data) + first, data_, length - first);
+}
+
+SonarOfflineCapture::RecordHeader SonarOfflineCapture::header(
+    size_t offset) const {
+  RecordHeader header;
+  read(offset, &header, sizeof(header));
+  return header;
+}
+
+std::string SonarOfflineCapture::string(size_t offset, size_t length) const {
+  std::string result(length, '\0');
+  read(offset % capacity_, &result[0], length);
+  return result;
+}
+
+void SonarOfflineCapture::append(
+    const std::string& plugin,
+    const std::string& method,
+    const folly::IOBuf& params) {
+  const auto paramsLength = params.computeChainDataLength();
+  const auto size =
+      sizeof(RecordHeader) + plugin.size() + method.size() + paramsLength;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size > capacity_ || size > UINT32_MAX || plugin.size() > UINT16_MAX ||
+      method.size() > UINT16_MAX) {
+    dropped_++;
+    return;
+  }
+  while (used_ + size > capacity_) {
+    const auto oldest = header(head_);
+    head_ = (head_ + oldest.size) % capacity_;
+    used_ -= oldest.size;
+    if (!oldest.taken) {
+      dropped_++;
+    }
+  }
+
+  const RecordHeader header{static_cast<uint32_t>(size),
+                            static_cast<uint16_t>(plugin.size()),
+                            static_cast<uint16_t>(method.size()),
+                            0};
+  auto offset = (head_ + used_) % capacity_;
+  write(offset, &header, sizeof(header));
+  offset = (offset + sizeof(header)) % capacity_;
+  write(offset, plugin.data(), plugin.size());
+  offset = (offset + plugin.size()) % capacity_;
+  write(offset, method.data(), method.size());
+  offset = (offset + method.size()) % capacity_;
+  for (const auto range : params) {
+    write(offset, range.data(), range.size());
+    offset = (offset + range.size()) % capacity_;
+  }
+  used_ += size;
+}
+
+std::vector<SonarEventBuffer::Event> SonarOfflineCapture::take(
+    const std::string& plugin,
+    size_t maxBytes) {
+  std::vector<SonarEventBuffer::Event> events;
+  size_t taken = 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t position = 0; position < used_;) {
+    const auto offset = (head_ + position) % capacity_;
+    auto record = header(offset);
+    position += record.size;
+    if (record.taken || record.pluginLength != plugin.size() ||
+        string(offset + sizeof(record), record.pluginLength) != plugin) {
+      continue;
+    }
+    const auto methodOffset = offset + sizeof(record) + record.pluginLength;
+    const auto paramsOffset = methodOffset + record.methodLength;
+    const auto paramsLength =
+        record.size - sizeof(record) - record.pluginLength - record.methodLength;
+    if (!events.empty() && taken + paramsLength > maxBytes) {
+      break;
+    }
+    auto params = folly::IOBuf::create(paramsLength);
+    read(paramsOffset % capacity_, params->writableData(), paramsLength);
+    params->append(paramsLength);
+    events.push_back(SonarEventBuffer::Event{
+        string(methodOffset, record.methodLength), std::move(params)});
+    taken += paramsLength;
+
+    record.taken = 1;
+    write(offset, &record, sizeof(record));
+  }
+
+  // Taken records at the front are released right away, the ones behind
+  // records of other plugins once those are taken or dropped.
+  while (used_ > 0) {
+    const auto oldest = header(head_);
+    if (!oldest.taken) {
+      break;
+    }
+    head_ = (head_ + oldest.size) % capacity_;
+    used_ -= oldest.size;
+  }
+  if (used_ == 0) {
+    head_ = 0;
+  }
+  return events;
+}
+
+size_t SonarOfflineCapture::bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_;
+}
+
+size_t SonarOfflineCapture::dropped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+} // namespace sonar
+} // namespace facebook
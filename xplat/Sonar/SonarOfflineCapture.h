@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarEventBuffer.h>
+#include <folly/io/IOBuf.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Serialized plugin events captured while no desktop has initialized the
+ plugin, kept in a memory-mapped file of a fixed size so that capturing an
+ event costs a copy of its bytes and the capture doesn't add to the app's
+ heap. The file is a ring: once it is full, the oldest events are dropped.
+ It only lives as long as the capture and is replaced when one is opened
+ again. Safe to use from any thread.
+ */
+class SonarOfflineCapture {
+ public:
+  /**
+   Creates the file at path, throwing std::system_error if it can't be
+   created or mapped.
+   */
+  SonarOfflineCapture(const std::string& path, size_t capacity);
+  ~SonarOfflineCapture();
+
+  SonarOfflineCapture(const SonarOfflineCapture&) = delete;
+  SonarOfflineCapture& operator=(const SonarOfflineCapture&) = delete;
+
+  /**
+   Capture an event whose params are already serialized as JSON. An event
+   that doesn't fit the file on its own is dropped right away.
+   */
+  void append(
+      const std::string& plugin,
+      const std::string& method,
+      const folly::IOBuf& params);
+
+  /**
+   Take the oldest events of plugin, removing them from the capture, until
+   their params add up to maxBytes. At least one event is taken if there is
+   any.
+   */
+  std::vector<SonarEventBuffer::Event> take(
+      const std::string& plugin,
+      size_t maxBytes);
+
+  size_t bytes() const;
+  // Number of events dropped to stay within the file.
+  size_t dropped() const;
+
+ private:
+  struct RecordHeader {
+    uint32_t size;
+    uint16_t pluginLength;
+    uint16_t methodLength;
+    uint32_t taken;
+  };
+
+  void write(size_t offset, const void* data, size_t length);
+  void read(size_t offset, void* data, size_t length) const;
+  RecordHeader header(size_t offset) const;
+  std::string string(size_t offset, size_t length) const;
+
+  const std::string path_;
+  const size_t capacity_;
+  int fd_ = -1;
+  uint8_t* data_ = nullptr;
+
+  mutable std::mutex mutex_;
+  // Offset of the oldest record and the bytes in use from there, wrapping
+  // around the end of the file.
+  size_t head_ = 0;
+  size_t used_ = 0;
+  size_t dropped_ = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ Counts of the operations the hot paths are held to a budget of, kept per
+ thread so that tests can count what a single call does, see
+ SonarTestLib/SonarOpCounter.h. Counted unless NDEBUG is defined, or
+ FB_SONAR_OP_COUNTING=0 is, so that release builds don't pay for them.
+ */
+#ifndef FB_SONAR_OP_COUNTING
+#ifdef NDEBUG
+#define FB_SONAR_OP_COUNTING 0
+#else
+#define FB_SONAR_OP_COUNTING 1
+#endif
+#endif
+
+namespace facebook {
+namespace sonar {
+
+struct SonarOpCounts {
+  // Values serialized with sonarAppendJson or sonarToJson.
+  uint64_t jsonEncodes = 0;
+  // Values parsed with sonarParseJson.
+  uint64_t jsonDecodes = 0;
+  // SonarMutex locks taken.
+  uint64_t lockAcquisitions = 0;
+};
+
+#if FB_SONAR_OP_COUNTING
+
+inline SonarOpCounts& sonarThreadOpCounts() {
+  static thread_local SonarOpCounts counts;
+  return counts;
+}
+
+#define SONAR_COUNT_OP(op) (::facebook::sonar::sonarThreadOpCounts().op++)
+
+#else
+
+#define SONAR_COUNT_OP(op) ((void)0)
+
+#endif
+
+} // namespace sonar
+} // namespace facebook
@@ -36,6 +36,27 @@ class SonarPlugin {
   provided in didConnect is no longer valid to use.
   */
   virtual void didDisconnect() = 0;
+
+  /**
+  Whether the plugin should be connected while no desktop has initialized it,
+  when the client captures events offline (see
+  SonarInitConfig::offlineCapturePath). Its events are then captured and
+  replayed once the desktop initializes it. Nothing calls its receivers until
+  then.
+  */
+  virtual bool runInBackground() {
+    return false;
+  }
+
+  /**
+  Called when the client's memory budget goes over its soft limit (see
+  SonarInitConfig::memorySoftLimitBytes) and this plugin is among the biggest
+  users of it, to drop about bytes of the data it holds on to, oldest first.
+  Also called when the system is short of memory, see SonarMemoryPressure,
+  with SIZE_MAX to drop everything it can, including caches and trackers it
+  can rebuild. Called on a plugin thread.
+  */
+  virtual void shedMemory(size_t bytes) {}
 };
 
 } // namespace sonar
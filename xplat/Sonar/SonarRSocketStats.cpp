@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarRSocketStats.h"
+#include <folly/Conv.h>
+#include <rsocket/framing/FrameType.h>
+#include <chrono>
+
+namespace facebook {
+namespace sonar {
+
+constexpr std::array<int64_t, 5> SonarRSocketStats::kRttBucketsMs;
+
+static int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void SonarRSocketStats::socketCreated() {
+  socketsCreated_++;
+}
+
+void SonarRSocketStats::socketConnected() {
+  socketsConnected_++;
+}
+
+void SonarRSocketStats::socketDisconnected() {
+  socketsDisconnected_++;
+}
+
+void SonarRSocketStats::socketClosed(rsocket::StreamCompletionSignal) {
+  socketsClosed_++;
+}
+
+void SonarRSocketStats::duplexConnectionCreated(
+    const std::string&,
+    rsocket::DuplexConnection*) {
+  openConnections_++;
+}
+
+void SonarRSocketStats::duplexConnectionClosed(
+    const std::string&,
+    rsocket::DuplexConnection*) {
+  openConnections_--;
+}
+
+void SonarRSocketStats::bytesWritten(size_t bytes) {
+  bytesWritten_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void SonarRSocketStats::bytesRead(size_t bytes) {
+  bytesRead_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void SonarRSocketStats::frameWritten(rsocket::FrameType) {
+  framesWritten_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SonarRSocketStats::frameRead(rsocket::FrameType type) {
+  framesRead_.fetch_add(1, std::memory_order_relaxed);
+  if (type == rsocket::FrameType::REQUEST_STREAM) {
+    streamStarts_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void SonarRSocketStats::streamBufferChanged(
+    int64_t framesCountDelta,
+    int64_t dataSizeDelta) {
+  bufferedFrames_.fetch_add(framesCountDelta, std::memory_order_relaxed);
+  bufferedBytes_.fetch_add(dataSizeDelta, std::memory_order_relaxed);
+}
+
+void SonarRSocketStats::keepaliveSent() {
+  keepalivesSent_++;
+  lastKeepaliveSentNanos_ = nowNanos();
+}
+
+void SonarRSocketStats::keepaliveReceived() {
+  keepalivesReceived_++;
+  // The desktop echoes our keepalives, so the time since the last one we
+  // sent is the round trip time.
+  const auto sent = lastKeepaliveSentNanos_.exchange(0);
+  if (sent == 0) {
+    return;
+  }
+  const auto rttMs = (nowNanos() - sent) / 1000000;
+  lastKeepaliveRttMs_ = rttMs;
+  size_t bucket = 0;
+  while (bucket < kRttBucketsMs.size() && rttMs >= kRttBucketsMs[bucket]) {
+    bucket++;
+  }
+  rttBuckets_[bucket]++;
+}
+
+std::map<std::string, int64_t> SonarRSocketStats::counters() const {
+  std::map<std::string, int64_t> counters{
+      {"Sockets created", socketsCreated_},
+      {"Sockets connected", socketsConnected_},
+      {"Sockets disconnected", socketsDisconnected_},
+      {"Sockets closed", socketsClosed_},
+      {"Open connections", openConnections_},
+      {"Bytes written", bytesWritten_},
+      {"Bytes read", bytesRead_},
+      {"Frames written", framesWritten_},
+      {"Frames read", framesRead_},
+      {"Streams requested", streamStarts_},
+      {"Buffered frames", bufferedFrames_},
+      {"Buffered bytes", bufferedBytes_},
+      {"Keepalives sent", keepalivesSent_},
+      {"Keepalives received", keepalivesReceived_},
+      {"Keepalive RTT last (ms)", lastKeepaliveRttMs_},
+  };
+  for (size_t i = 0; i < rttBuckets_.size(); i++) {
+    const auto name = i < kRttBucketsMs.size()
+        ? "Keepalive RTT < " + folly::to<std::string>(kRttBucketsMs[i]) + "ms"
+        : "Keepalive RTT >= " +
+            folly::to<std::string>(kRttBucketsMs.back()) + "ms";
+    counters[name] = rttBuckets_[i];
+  }
+  return counters;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <rsocket/RSocketStats.h>
+#include <array>
+#include <atomic>
+#include <map>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Transport metrics for the connection to the desktop. Updated from the
+ connection thread on every frame, so everything is kept in atomics rather
+ than going through SonarState's locked counters. Read with counters().
+ */
+class SonarRSocketStats : public rsocket::RSocketStats {
+ public:
+  void socketCreated() override;
+  void socketConnected() override;
+  void socketDisconnected() override;
+  void socketClosed(rsocket::StreamCompletionSignal signal) override;
+  void duplexConnectionCreated(
+      const std::string& type,
+      rsocket::DuplexConnection* connection) override;
+  void duplexConnectionClosed(
+      const std::string& type,
+      rsocket::DuplexConnection* connection) override;
+  void bytesWritten(size_t bytes) override;
+  void bytesRead(size_t bytes) override;
+  void frameWritten(rsocket::FrameType type) override;
+  void frameRead(rsocket::FrameType type) override;
+  void streamBufferChanged(int64_t framesCountDelta, int64_t dataSizeDelta)
+      override;
+  void keepaliveSent() override;
+  void keepaliveReceived() override;
+
+  /**
+   Snapshot of all metrics by name.
+   */
+  std::map<std::string, int64_t> counters() const;
+
+ private:
+  // Upper bounds of the keepalive round trip histogram buckets, in
+  // milliseconds. The last bucket takes everything slower.
+  static constexpr std::array<int64_t, 5> kRttBucketsMs{
+      {10, 50, 100, 500, 1000}};
+
+  std::atomic<int64_t> socketsCreated_{0};
+  std::atomic<int64_t> socketsConnected_{0};
+  std::atomic<int64_t> socketsDisconnected_{0};
+  std::atomic<int64_t> socketsClosed_{0};
+  std::atomic<int64_t> openConnections_{0};
+  std::atomic<int64_t> bytesWritten_{0};
+  std::atomic<int64_t> bytesRead_{0};
+  std::atomic<int64_t> framesWritten_{0};
+  std::atomic<int64_t> framesRead_{0};
+  std::atomic<int64_t> streamStarts_{0};
+  std::atomic<int64_t> bufferedFrames_{0};
+  std::atomic<int64_t> bufferedBytes_{0};
+  std::atomic<int64_t> keepalivesSent_{0};
+  std::atomic<int64_t> keepalivesReceived_{0};
+  std::atomic<int64_t> lastKeepaliveSentNanos_{0};
+  std::atomic<int64_t> lastKeepaliveRttMs_{0};
+  std::array<std::atomic<int64_t>, kRttBucketsMs.size() + 1> rttBuckets_{};
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,185 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarRawJson.h"
+#include "SonarJsonParser.h"
+#include <folly/json.h>
+#include <stdexcept>
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+[[noreturn]] void malformed(const char* reason) {
+  throw std::runtime_error(std::string("Malformed JSON: ") + reason);
+}
+
+const char* skipWhitespace(const char* pos, const char* end) {
+  while (pos < end &&
+         (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+    pos++;
+  }
+  return pos;
+}
+
+// pos points at the opening quote, returns the position after the closing one.
+const char* skipString(const char* pos, const char* end) {
+  for (pos++; pos < end; pos++) {
+    if (*pos == '\\') {
+      pos++;
+    } else if (*pos == '"') {
+      return pos + 1;
+    }
+  }
+  malformed("unterminated string");
+}
+
+// Returns the position after the value starting at pos. Only strings and
+// nesting are checked, the rest is left to whoever parses the value.
+const char* skipValue(const char* pos, const char* end) {
+  if (pos >= end) {
+    malformed("missing value");
+  }
+  if (*pos == '"') {
+    return skipString(pos, end);
+  }
+  if (*pos == '{' || *pos == '[') {
+    int depth = 0;
+    while (pos < end) {
+      const char c = *pos;
+      if (c == '"') {
+        pos = skipString(pos, end);
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) {
+          return pos + 1;
+        }
+      }
+      pos++;
+    }
+    malformed("unterminated object or array");
+  }
+  while (pos < end && *pos != ',' && *pos != '}' && *pos != ']' &&
+         *pos != ' ' && *pos != '\n' && *pos != '\r' && *pos != '\t') {
+    pos++;
+  }
+  return pos;
+}
+
+} // namespace
+
+SonarRawJson SonarRawJson::fromString(std::string json) {
+  auto storage = std::make_shared<const std::string>(std::move(json));
+  const folly::StringPiece range(*storage);
+  return SonarRawJson(std::move(storage), range);
+}
+
+folly::dynamic SonarRawJson::parse() const {
+  if (json_.empty()) {
+    return nullptr;
+  }
+  return sonarParseJson(json_);
+}
+
+std::string SonarRawJson::asString() const {
+  if (json_.size() < 2 || json_.front() != '"' || json_.back() != '"') {
+    malformed("expected a string");
+  }
+  if (json_.find('\\') != folly::StringPiece::npos) {
+    return folly::parseJson(json_).getString();
+  }
+  return json_.subpiece(1, json_.size() - 2).str();
+}
+
+SonarRawJson::Fields SonarRawJson::fields() const {
+  Fields fields;
+  const char* end = json_.end();
+  const char* pos = skipWhitespace(json_.begin(), end);
+  if (pos == end || *pos != '{') {
+    malformed("expected an object");
+  }
+  pos = skipWhitespace(pos + 1, end);
+  if (pos < end && *pos == '}') {
+    return fields;
+  }
+  while (true) {
+    if (pos == end || *pos != '"') {
+      malformed("expected a key");
+    }
+    const char* keyEnd = skipString(pos, end);
+    folly::StringPiece quotedKey(pos, keyEnd);
+    std::string key = quotedKey.find('\\') == folly::StringPiece::npos
+        ? quotedKey.subpiece(1, quotedKey.size() - 2).str()
+        : folly::parseJson(quotedKey).getString();
+
+    pos = skipWhitespace(keyEnd, end);
+    if (pos == end || *pos != ':') {
+      malformed("expected ':'");
+    }
+    const char* valueBegin = skipWhitespace(pos + 1, end);
+    const char* valueEnd = skipValue(valueBegin, end);
+    fields.emplace_back(
+        std::move(key),
+        SonarRawJson(storage_, folly::StringPiece(valueBegin, valueEnd)));
+
+    pos = skipWhitespace(valueEnd, end);
+    if (pos < end && *pos == ',') {
+      pos = skipWhitespace(pos + 1, end);
+      continue;
+    }
+    if (pos < end && *pos == '}') {
+      return fields;
+    }
+    malformed("expected ',' or '}'");
+  }
+}
+
+SonarRawJson::Elements SonarRawJson::elements() const {
+  Elements elements;
+  const char* end = json_.end();
+  const char* pos = skipWhitespace(json_.begin(), end);
+  if (pos == end || *pos != '[') {
+    malformed("expected an array");
+  }
+  pos = skipWhitespace(pos + 1, end);
+  if (pos < end && *pos == ']') {
+    return elements;
+  }
+  while (true) {
+    const char* valueEnd = skipValue(pos, end);
+    elements.push_back(
+        SonarRawJson(storage_, folly::StringPiece(pos, valueEnd)));
+    pos = skipWhitespace(valueEnd, end);
+    if (pos < end && *pos == ',') {
+      pos = skipWhitespace(pos + 1, end);
+      continue;
+    }
+    if (pos < end && *pos == ']') {
+      return elements;
+    }
+    malformed("expected ',' or ']'");
+  }
+}
+
+constexpr size_t SonarRawJson::kInlineFields;
+
+SonarRawJson SonarRawJson::field(const Fields& fields, folly::StringPiece key) {
+  for (auto iter = fields.rbegin(); iter != fields.rend(); ++iter) {
+    if (folly::StringPiece(iter->first) == key) {
+      return iter->second;
+    }
+  }
+  return SonarRawJson();
+}
+
+} // namespace sonar
+} // namespace facebook
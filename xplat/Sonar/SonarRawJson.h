@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <folly/small_vector.h>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ A JSON value that hasn't been parsed yet. Fields of an object can be looked
+ up by scanning its text, without building a dynamic for the values that
+ aren't needed, so that routing a message only pays for its envelope. Copies
+ share the underlying buffer.
+ */
+class SonarRawJson {
+ public:
+  static constexpr size_t kInlineFields = 6;
+
+  /**
+   Envelopes have a handful of fields with short keys, which fit inline
+   without allocating. Looked up by scanning, like the text they came from.
+   */
+  using Fields =
+      folly::small_vector<std::pair<std::string, SonarRawJson>, kInlineFields>;
+
+  SonarRawJson() = default;
+
+  using Elements = folly::small_vector<SonarRawJson, kInlineFields>;
+
+  static SonarRawJson fromString(std::string json);
+
+  /**
+   A value over text owned elsewhere, such as the params a raw receiver
+   gets. It and the values split from it are only valid while the text is.
+   */
+  static SonarRawJson view(folly::StringPiece json) {
+    return SonarRawJson(nullptr, json);
+  }
+
+  /**
+   The unparsed JSON text, empty if the value is absent.
+   */
+  folly::StringPiece json() const {
+    return json_;
+  }
+
+  bool empty() const {
+    return json_.empty();
+  }
+
+  // Whether the value is absent or null.
+  bool isNull() const {
+    return json_.empty() || json_ == "null";
+  }
+
+  /**
+   Parses the whole value, an absent value parses to null.
+   */
+  folly::dynamic parse() const;
+
+  /**
+   The value of a string, such as a method name, without parsing it into a
+   dynamic. Throws std::runtime_error if this isn't a string.
+   */
+  std::string asString() const;
+
+  /**
+   Splits an object into its top level fields without parsing their values,
+   in the order they appear. Throws std::runtime_error if this isn't an
+   object.
+   */
+  Fields fields() const;
+
+  /**
+   Splits an array into its elements without parsing them. Throws
+   std::runtime_error if this isn't an array.
+   */
+  Elements elements() const;
+
+  /**
+   The given field of fields, or an empty value if it's missing. Of
+   duplicate keys the last one counts, as when parsing.
+   */
+  static SonarRawJson field(const Fields& fields, folly::StringPiece key);
+
+ private:
+  SonarRawJson(std::shared_ptr<const std::string> storage, folly::StringPiece json)
+      : storage_(std::move(storage)), json_(json) {}
+
+  std::shared_ptr<const std::string> storage_;
+  folly::StringPiece json_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,46 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/json.h>
+#include <functional>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ * SonarReply completes a call the Sonar desktop app made as a
+ * request-response. The response goes back on the call's own stream, so it
+ * carries no id and isn't wrapped in an envelope. Only the first of success,
+ * successSerialized and error is sent. Safe to use from any thread.
+ */
+class SonarReply {
+ public:
+  virtual ~SonarReply(){};
+
+  virtual void success(const folly::dynamic& response) = 0;
+
+  /**
+   * Same as success, but the response is already serialized as JSON.
+   */
+  virtual void successSerialized(std::unique_ptr<folly::IOBuf> response) = 0;
+
+  virtual void error(const folly::dynamic& response) = 0;
+
+  /**
+   * handler is called once if the Sonar desktop app cancels the call before
+   * it is completed, right away if it already has.
+   */
+  virtual void setCancelHandler(std::function<void()> handler) = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
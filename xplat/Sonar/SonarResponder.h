@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <Sonar/SonarCancellation.h>
 #include <folly/json.h>
 
 namespace facebook {
@@ -30,6 +31,22 @@ class SonarResponder {
    * Inform the Sonar desktop app of an error in handling the request.
    */
   virtual void error(const folly::dynamic& response) const = 0;
+
+  /**
+   * Same as success, but the response is already serialized as JSON.
+   */
+  virtual void successSerialized(folly::StringPiece response) const {
+    success(folly::parseJson(response));
+  }
+
+  /**
+   * Cancelled once the Sonar desktop app no longer wants the response, e.g.
+   * because a newer request superseded it. Receivers doing expensive work
+   * may check it and abandon the work, responding is then unnecessary.
+   */
+  virtual SonarCancellationToken cancellationToken() const {
+    return SonarCancellationToken();
+  }
 };
 
 } // namespace sonar
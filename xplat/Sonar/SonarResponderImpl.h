@@ -8,9 +8,16 @@
 
 #pragma once
 
+#include <Sonar/SonarConnectionStats.h>
+#include <Sonar/SonarInFlightRequests.h>
+#include <Sonar/SonarReply.h>
 #include <Sonar/SonarResponder.h>
 #include <Sonar/SonarWebSocket.h>
+#include <folly/Conv.h>
+#include <folly/io/IOBuf.h>
 #include <folly/json.h>
+#include <chrono>
+#include <memory>
 
 namespace facebook {
 namespace sonar {
@@ -18,23 +25,130 @@ namespace sonar {
 class SonarResponderImpl : public SonarResponder {
  public:
   SonarResponderImpl(SonarWebSocket* socket, int64_t responseID)
-      : socket_(socket), responseID_(responseID) {}
+      : socket_(socket),
+        responseID_(responseID),
+        received_(std::chrono::steady_clock::now()) {}
+
+  /**
+  Responds to a call the desktop made as a request-response through reply,
+  instead of sending a message with the call's id. responseID then only
+  identifies the call to the in flight requests.
+  */
+  SonarResponderImpl(std::shared_ptr<SonarReply> reply, int64_t responseID)
+      : socket_(nullptr),
+        reply_(std::move(reply)),
+        responseID_(responseID),
+        received_(std::chrono::steady_clock::now()) {}
+
+  /**
+  Count the response in stats, with the time since the call was received.
+  */
+  void setStats(std::shared_ptr<SonarConnectionStats> stats) {
+    stats_ = std::move(stats);
+  }
+
+  ~SonarResponderImpl() {
+    if (inFlight_ && !finished_) {
+      // Dropped without responding.
+      inFlight_->finish(responseID_);
+    }
+    if (reply_ && !replied_) {
+      // The desktop's request would stay open otherwise.
+      reply_->error(
+          folly::dynamic::object("message", "Dropped without a response"));
+    }
+  }
+
+  /**
+  Track the request in inFlight until it is responded to, so that the
+  desktop can cancel it and it can time out, with its latency counted under
+  method. Once cancelled, responses aren't sent anymore.
+  */
+  void setInFlight(
+      std::shared_ptr<SonarInFlightRequests> inFlight,
+      std::string method = "") {
+    inFlight_ = std::move(inFlight);
+    cancellationToken_ = inFlight_->start(responseID_, std::move(method));
+    if (reply_) {
+      // The desktop cancels these by cancelling the request itself.
+      reply_->setCancelHandler(
+          [inFlight = inFlight_, id = responseID_]() { inFlight->cancel(id); });
+    }
+  }
 
   void success(const folly::dynamic& response) const override {
-    const folly::dynamic message =
-        folly::dynamic::object("id", responseID_)("success", response);
-    socket_->sendMessage(message);
+    if (!finish()) {
+      return;
+    }
+    record(false);
+    if (reply_) {
+      replied_ = true;
+      reply_->success(response);
+      return;
+    }
+    socket_->sendMessage(
+        folly::dynamic::object("id", responseID_)("success", response));
+  }
+
+  void successSerialized(folly::StringPiece response) const override {
+    if (!finish()) {
+      return;
+    }
+    record(false);
+    if (reply_) {
+      replied_ = true;
+      reply_->successSerialized(folly::IOBuf::copyBuffer(response));
+      return;
+    }
+    socket_->sendSerializedResponse(
+        folly::IOBuf::copyBuffer(folly::to<std::string>(
+            "{\"id\":", responseID_, ",\"success\":", response, "}")));
   }
 
   void error(const folly::dynamic& response) const override {
-    const folly::dynamic message =
-        folly::dynamic::object("id", responseID_)("error", response);
-    socket_->sendMessage(message);
+    if (!finish()) {
+      return;
+    }
+    record(true);
+    if (reply_) {
+      replied_ = true;
+      reply_->error(response);
+      return;
+    }
+    socket_->sendMessage(
+        folly::dynamic::object("id", responseID_)("error", response));
+  }
+
+  SonarCancellationToken cancellationToken() const override {
+    return cancellationToken_;
   }
 
  private:
+  // Whether the response should still be sent.
+  bool finish() const {
+    if (inFlight_ && !finished_) {
+      finished_ = true;
+      cancelled_ = !inFlight_->finish(responseID_);
+    }
+    return !cancelled_;
+  }
+
+  void record(bool error) const {
+    if (stats_) {
+      stats_->responded(std::chrono::steady_clock::now() - received_, error);
+    }
+  }
+
   SonarWebSocket* socket_;
+  std::shared_ptr<SonarReply> reply_;
   int64_t responseID_;
+  std::chrono::steady_clock::time_point received_;
+  std::shared_ptr<SonarConnectionStats> stats_;
+  std::shared_ptr<SonarInFlightRequests> inFlight_;
+  SonarCancellationToken cancellationToken_;
+  mutable bool finished_ = false;
+  mutable bool cancelled_ = false;
+  mutable bool replied_ = false;
 };
 
 } // namespace sonar
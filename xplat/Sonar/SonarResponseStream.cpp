@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarResponseStream.h"
+#include <folly/json.h>
+
+namespace facebook {
+namespace sonar {
+
+constexpr int64_t SonarResponseStream::kUnbounded;
+
+class SonarResponseStream::Subscription
+    : public yarpl::flowable::Subscription {
+ public:
+  Subscription(std::shared_ptr<SonarResponseStream> stream)
+      : stream_(std::move(stream)) {}
+
+  void request(int64_t n) override {
+    stream_->request(n);
+  }
+
+  void cancel() override {
+    stream_->cancel();
+  }
+
+ private:
+  std::shared_ptr<SonarResponseStream> stream_;
+};
+
+class SonarResponseStream::Responder : public SonarStreamResponder {
+ public:
+  Responder(std::shared_ptr<SonarResponseStream> stream)
+      : stream_(std::move(stream)) {}
+
+  void next(const folly::dynamic& chunk) override {
+    stream_->push(rsocket::Payload(stream_->encode_(chunk)));
+  }
+
+  // Raw bytes go out as metadata, so that the desktop can tell them from
+  // JSON chunks and decode them as a buffer.
+  void nextBytes(std::unique_ptr<folly::IOBuf> chunk) override {
+    stream_->push(rsocket::Payload(nullptr, std::move(chunk)));
+  }
+
+  void complete() override {
+    stream_->finish(folly::none);
+  }
+
+  void error(const folly::dynamic& response) override {
+    stream_->finish(response);
+  }
+
+ private:
+  std::shared_ptr<SonarResponseStream> stream_;
+};
+
+SonarResponseStream::SonarResponseStream(
+    folly::EventBase* eventBase,
+    Encoder encode)
+    : eventBase_(eventBase), encode_(std::move(encode)) {}
+
+void SonarResponseStream::subscribe(
+    std::shared_ptr<yarpl::flowable::Subscriber<rsocket::Payload>>
+        subscriber) {
+  subscriber_ = subscriber;
+  subscriber->onSubscribe(std::make_shared<Subscription>(self()));
+}
+
+std::shared_ptr<SonarStreamResponder> SonarResponseStream::responder() {
+  return std::make_shared<Responder>(self());
+}
+
+void SonarResponseStream::push(rsocket::Payload payload) {
+  eventBase_->runInEventBaseThread(
+      [stream = self(), payload = std::move(payload)]() mutable {
+        if (stream->cancelled_ || stream->finished_) {
+          return;
+        }
+        stream->buffered_.emplace_back(std::move(payload));
+        stream->drain();
+      });
+}
+
+void SonarResponseStream::finish(folly::Optional<folly::dynamic> error) {
+  eventBase_->runInEventBaseThread(
+      [stream = self(), error = std::move(error)]() {
+        if (stream->finished_) {
+          return;
+        }
+        stream->finished_ = true;
+        stream->error_ = std::move(error);
+        stream->drain();
+      });
+}
+
+void SonarResponseStream::request(int64_t n) {
+  if (n <= 0) {
+    return;
+  }
+  // The desktop asks for kUnbounded to mean all of them, with credits still
+  // outstanding, so the sum saturates rather than overflows.
+  credits_ = n >= kUnbounded - credits_ ? kUnbounded : credits_ + n;
+  drain();
+}
+
+void SonarResponseStream::cancel() {
+  cancelled_ = true;
+  buffered_.clear();
+  subscriber_ = nullptr;
+}
+
+void SonarResponseStream::drain() {
+  if (!subscriber_) {
+    return;
+  }
+  while (credits_ > 0 && !buffered_.empty()) {
+    if (credits_ != kUnbounded) {
+      credits_--;
+    }
+    auto payload = std::move(buffered_.front());
+    buffered_.pop_front();
+    subscriber_->onNext(std::move(payload));
+    // The subscriber may have cancelled from onNext.
+    if (!subscriber_) {
+      return;
+    }
+  }
+  if (finished_ && buffered_.empty()) {
+    auto subscriber = std::move(subscriber_);
+    if (error_) {
+      subscriber->onError(
+          folly::make_exception_wrapper<rsocket::ErrorWithPayload>(
+              rsocket::Payload(folly::toJson(*error_))));
+    } else {
+      subscriber->onComplete();
+    }
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarStreamResponder.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+#include <rsocket/Payload.h>
+#include <yarpl/Flowable.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ A response streamed back for a requestStream from the desktop. Chunks are
+ buffered until the desktop requests more of them, requesting kUnbounded
+ takes all that come. An error or completion is delivered once the chunks
+ before it are. Chunks are encoded with encode on the thread that delivers
+ them, all other state is only touched on eventBase.
+ */
+class SonarResponseStream : public yarpl::flowable::Flowable<rsocket::Payload> {
+ public:
+  using Encoder =
+      std::function<std::unique_ptr<folly::IOBuf>(const folly::dynamic&)>;
+
+  static constexpr int64_t kUnbounded = std::numeric_limits<int64_t>::max();
+
+  SonarResponseStream(folly::EventBase* eventBase, Encoder encode);
+
+  void subscribe(
+      std::shared_ptr<yarpl::flowable::Subscriber<rsocket::Payload>>
+          subscriber) override;
+
+  /**
+   What plugins respond through, it keeps the stream alive.
+   */
+  std::shared_ptr<SonarStreamResponder> responder();
+
+ private:
+  class Subscription;
+  class Responder;
+
+  folly::EventBase* const eventBase_;
+  const Encoder encode_;
+  std::shared_ptr<yarpl::flowable::Subscriber<rsocket::Payload>> subscriber_;
+  std::deque<rsocket::Payload> buffered_;
+  int64_t credits_ = 0;
+  bool cancelled_ = false;
+  bool finished_ = false;
+  folly::Optional<folly::dynamic> error_;
+
+  std::shared_ptr<SonarResponseStream> self() {
+    return this->ref_from_this(this);
+  }
+
+  void push(rsocket::Payload payload);
+  void finish(folly::Optional<folly::dynamic> error);
+  void request(int64_t n);
+  void cancel();
+  void drain();
+};
+
+} // namespace sonar
+} // namespace facebook
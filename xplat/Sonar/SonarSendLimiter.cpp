@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarSendLimiter.h"
+
+#include <algorithm>
+
+namespace facebook {
+namespace sonar {
+
+SonarSendLimiter::Entry& SonarSendLimiter::entry(const std::string& method) {
+  auto iter = entries_.find(method);
+  if (iter == entries_.end()) {
+    iter = entries_.emplace(method, Entry()).first;
+    iter->second.bucket.lastRefill = Clock::now();
+    if (backgroundLimit_) {
+      iter->second.background.tokens = backgroundLimit_->maxPerSecond;
+      iter->second.background.lastRefill = iter->second.bucket.lastRefill;
+    }
+  }
+  return iter->second;
+}
+
+void SonarSendLimiter::setLimit(
+    const std::string& method,
+    SonarSendLimit limit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& e = entry(method);
+  e.pluginLimit = limit;
+  e.bucket.tokens = limit.maxPerSecond;
+  limited_ = true;
+}
+
+void SonarSendLimiter::overrideLimit(
+    const std::string& method,
+    folly::Optional<SonarSendLimit> limit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& e = entry(method);
+  e.desktopLimit = limit;
+  if (limit) {
+    e.bucket.tokens = limit->maxPerSecond;
+    limited_ = true;
+  }
+}
+
+void SonarSendLimiter::setBackgroundLimit(
+    folly::Optional<SonarSendLimit> limit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  backgroundLimit_ = limit;
+  if (limit) {
+    const auto now = Clock::now();
+    for (auto& iter : entries_) {
+      iter.second.background = Bucket();
+      iter.second.background.tokens = limit->maxPerSecond;
+      iter.second.background.lastRefill = now;
+    }
+    limited_ = true;
+  }
+}
+
+bool SonarSendLimiter::admit(
+    const std::string& method,
+    Clock::time_point now) {
+  if (!limited_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto iter = entries_.find(method);
+  if (iter == entries_.end() && !backgroundLimit_) {
+    return true;
+  }
+  auto& e = iter != entries_.end() ? iter->second : entry(method);
+  const auto& limit = e.desktopLimit ? e.desktopLimit : e.pluginLimit;
+  if ((limit && !admit(*limit, e.bucket, now)) ||
+      (backgroundLimit_ && !admit(*backgroundLimit_, e.background, now))) {
+    e.suppressed++;
+    return false;
+  }
+  return true;
+}
+
+bool SonarSendLimiter::admit(
+    const SonarSendLimit& limit,
+    Bucket& bucket,
+    Clock::time_point now) {
+  if (limit.sampleRate < 1) {
+    bucket.sampled += std::max(0.0, limit.sampleRate);
+    if (bucket.sampled < 1) {
+      return false;
+    }
+    bucket.sampled -= 1;
+  }
+
+  if (limit.maxPerSecond > 0) {
+    const std::chrono::duration<double> elapsed = now - bucket.lastRefill;
+    bucket.lastRefill = now;
+    bucket.tokens = std::min(
+        limit.maxPerSecond,
+        bucket.tokens + std::max(0.0, elapsed.count()) * limit.maxPerSecond);
+    if (bucket.tokens < 1) {
+      return false;
+    }
+    bucket.tokens -= 1;
+  }
+  return true;
+}
+
+folly::dynamic SonarSendLimiter::suppressed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto result = folly::dynamic::object();
+  for (const auto& iter : entries_) {
+    if (iter.second.suppressed) {
+      result[iter.first] = iter.second.suppressed;
+    }
+  }
+  return result;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/dynamic.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace facebook {
+namespace sonar {
+
+struct SonarSendLimit {
+  // Events per second, with bursts of up to a second's worth. 0 doesn't
+  // limit the rate.
+  double maxPerSecond = 0;
+  // Fraction of events sent, evenly spaced. 1 sends all of them.
+  double sampleRate = 1;
+};
+
+/**
+ Decides which events of a connection are sent, per method. Limits are set by
+ the plugin, and the desktop can override them while it is connected. Events
+ are sampled first, and the ones kept then go through a token bucket.
+ Methods without limits cost a single atomic load. Safe to use from any
+ thread.
+ */
+class SonarSendLimiter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void setLimit(const std::string& method, SonarSendLimit limit);
+
+  /**
+   Takes precedence over the plugin's limit. None goes back to the plugin's.
+   */
+  void overrideLimit(
+      const std::string& method,
+      folly::Optional<SonarSendLimit> limit);
+
+  /**
+   Whether an event of method may be sent now. Counts as sending it, or as
+   suppressing it.
+   */
+  bool admit(const std::string& method, Clock::time_point now = Clock::now());
+
+  /**
+   Applies to every method on top of its own limit, e.g. while the app is in
+   the background. None stops applying it.
+   */
+  void setBackgroundLimit(folly::Optional<SonarSendLimit> limit);
+
+  // The number of events suppressed so far, by method.
+  folly::dynamic suppressed() const;
+
+ private:
+  struct Bucket {
+    double tokens = 0;
+    Clock::time_point lastRefill;
+    // Sampling credit, an event is kept each time it reaches 1.
+    double sampled = 0;
+  };
+
+  struct Entry {
+    folly::Optional<SonarSendLimit> pluginLimit;
+    folly::Optional<SonarSendLimit> desktopLimit;
+    Bucket bucket;
+    // For backgroundLimit_, reset whenever it is set.
+    Bucket background;
+    size_t suppressed = 0;
+  };
+
+  Entry& entry(const std::string& method);
+
+  static bool
+  admit(const SonarSendLimit& limit, Bucket& bucket, Clock::time_point now);
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  folly::Optional<SonarSendLimit> backgroundLimit_;
+  std::atomic<bool> limited_{false};
+};
+
+} // namespace sonar
+} // namespace facebook
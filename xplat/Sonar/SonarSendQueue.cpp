@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include "SonarSendQueue.h"
+
+#include <algorithm>
+
+namespace facebook {
+namespace sonar {
+
+static size_t sizeOf(const SonarSendQueue::Entry& entry) {
+  return entry.data ? entry.data->computeChainDataLength() : 0;
+}
+
+SonarSendQueue::~SonarSendQueue() {
+  auto staged = staged_.load();
+  while (staged) {
+    const auto next = staged->next;
+    delete staged;
+    staged = next;
+  }
+}
+
+bool SonarSendQueue::push(Entry entry, bool mayBlock) {
+  // The budget is only called outside the lock.
+  const auto size = budget_ ? sizeOf(entry) : 0;
+  if (size > 0 && !budget_->reserve(entry.plugin, size)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropped_[entry.plugin]++;
+    return false;
+  }
+  if (pending_.fetch_add(1) < maxQueuedPerPlugin_) {
+    auto staged = new Staged{std::move(entry), size, staged_.load()};
+    while (!staged_.compare_exchange_weak(staged->next, staged)) {
+    }
+    return !drainScheduled_.exchange(true);
+  }
+  pending_--;
+  size_t released = 0;
+  std::string releasedPlugin;
+  const auto scheduleDrain = [&]() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    takeStaged();
+    auto& queue = queues_[entry.plugin];
+    if (queue.entries.size() >= maxQueuedPerPlugin_) {
+      if (policy_ == OverflowPolicy::block && mayBlock) {
+        hasRoom_.wait(lock, [&]() {
+          return queue.entries.size() < maxQueuedPerPlugin_;
+        });
+        takeStaged();
+      } else if (
+          policy_ == OverflowPolicy::dropOldest && !queue.entries.empty()) {
+        if (budget_) {
+          released = sizeOf(queue.entries.front());
+          releasedPlugin = entry.plugin;
+          queue.bytes -= released;
+        }
+        queue.entries.pop_front();
+        pending_--;
+        dropped_[entry.plugin]++;
+      } else {
+        dropped_[entry.plugin]++;
+        released = size;
+        releasedPlugin = entry.plugin;
+        return false;
+      }
+    }
+    pending_++;
+    append(queue, std::move(entry), size);
+    return !drainScheduled_.exchange(true);
+  }();
+  if (released > 0) {
+    budget_->release(releasedPlugin, released);
+  }
+  return scheduleDrain;
+}
+
+SonarSendQueue::Drained SonarSendQueue::drain(size_t maxEntries) {
+  Drained drained;
+  std::unordered_map<std::string, size_t> released;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Before taking the staged entries, so that pushes staged after that
+    // schedule another drain.
+    drainScheduled_ = false;
+    takeStaged();
+    while (!turns_.empty() && drained.entries.size() < maxEntries) {
+      auto& queue = queues_[turns_.front()];
+      const auto turn = std::min(
+          {weight(turns_.front()),
+           queue.entries.size(),
+           maxEntries - drained.entries.size()});
+      for (size_t i = 0; i < turn; i++) {
+        auto& entry = queue.entries.front();
+        const auto size = budget_ ? sizeOf(entry) : 0;
+        if (size > 0) {
+          queue.bytes -= size;
+          released[entry.plugin] += size;
+        }
+        drained.entries.push_back(std::move(entry));
+        queue.entries.pop_front();
+      }
+      // A turn cut short by maxEntries resumes with the next drain.
+      if (queue.entries.empty()) {
+        queue.hasTurn = false;
+        turns_.pop_front();
+      } else if (turn == weight(turns_.front())) {
+        turns_.push_back(turns_.front());
+        turns_.pop_front();
+      }
+    }
+    pending_ -= drained.entries.size();
+    drained.dropped.swap(dropped_);
+    drained.more = !turns_.empty();
+    if (drained.more) {
+      // The caller drains again, pushes needn't schedule it.
+      drainScheduled_ = true;
+    }
+  }
+  hasRoom_.notify_all();
+  for (const auto& bytes : released) {
+    budget_->release(bytes.first, bytes.second);
+  }
+  return drained;
+}
+
+size_t SonarSendQueue::discard() {
+  size_t bytes = 0;
+  std::unordered_map<std::string, size_t> released;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    takeStaged();
+    for (auto& iter : queues_) {
+      auto& queue = iter.second;
+      pending_ -= queue.entries.size();
+      dropped_[iter.first] += queue.entries.size();
+      for (const auto& entry : queue.entries) {
+        bytes += sizeOf(entry);
+      }
+      queue.entries.clear();
+      queue.hasTurn = false;
+      if (queue.bytes > 0) {
+        released[iter.first] = queue.bytes;
+        queue.bytes = 0;
+      }
+    }
+    turns_.clear();
+  }
+  hasRoom_.notify_all();
+  for (const auto& iter : released) {
+    budget_->release(iter.first, iter.second);
+  }
+  return bytes;
+}
+
+void SonarSendQueue::takeStaged() {
+  auto staged = staged_.exchange(nullptr);
+  Staged* oldest = nullptr;
+  while (staged) {
+    const auto next = staged->next;
+    staged->next = oldest;
+    oldest = staged;
+    staged = next;
+  }
+  while (oldest) {
+    auto& queue = queues_[oldest->entry.plugin];
+    append(queue, std::move(oldest->entry), oldest->size);
+    const auto next = oldest->next;
+    delete oldest;
+    oldest = next;
+  }
+}
+
+void SonarSendQueue::append(PluginQueue& queue, Entry entry, size_t size) {
+  if (!queue.hasTurn) {
+    queue.hasTurn = true;
+    turns_.push_back(entry.plugin);
+  }
+  queue.bytes += size;
+  queue.entries.push_back(std::move(entry));
+}
+
+size_t SonarSendQueue::weight(const std::string& plugin) const {
+  const auto iter = weights_.find(plugin);
+  return iter != weights_.end() ? std::max<size_t>(iter->second, 1) : 1;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,155 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarMemoryBudget.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ What to do with a message sent by a plugin that already has the maximum
+ number of messages waiting to be sent.
+ */
+enum class OverflowPolicy {
+  // Drop the plugin's oldest waiting message to make room.
+  dropOldest,
+  // Drop the message being sent.
+  dropNewest,
+  // Block the sending thread until there is room. Falls back to dropNewest
+  // for senders that must not block.
+  block,
+};
+
+/**
+ Bounded queue of outgoing messages, with a separate queue and quota for
+ each plugin. Producers push from any thread, a single consumer drains what
+ is queued so far. Each plugin's entries are drained in the order they were
+ pushed, plugins take turns of their weight's worth of entries, so that a
+ burst from one plugin doesn't hold back the others. With a budget,
+ serialized entries are accounted against their plugin in it until
+ drained, entries it refuses are dropped.
+
+ While fewer entries are queued than a single plugin's quota, no quota can be
+ exceeded, and producers only push onto a lock-free list, which the consumer
+ takes in one exchange. Past that, producers take the lock to enforce the
+ quotas exactly. Pushes racing a producer that just took the lock may still
+ go over a plugin's quota by at most one each.
+ */
+class SonarSendQueue {
+ public:
+  struct Entry {
+    std::string plugin;
+    // Exactly one of message and data is set.
+    folly::dynamic message;
+    std::unique_ptr<folly::IOBuf> data;
+  };
+
+  struct Drained {
+    std::deque<Entry> entries;
+    // Number of messages dropped per plugin since the last drain.
+    std::map<std::string, size_t> dropped;
+    // Set when a limited drain left entries queued. No further drain is
+    // scheduled by push until the queue is drained again.
+    bool more = false;
+  };
+
+  /**
+   Plugins missing from weights have a weight of 1.
+   */
+  SonarSendQueue(
+      size_t maxQueuedPerPlugin,
+      OverflowPolicy policy,
+      std::shared_ptr<SonarMemoryBudget> budget = nullptr,
+      std::unordered_map<std::string, size_t> weights = {})
+      : maxQueuedPerPlugin_(maxQueuedPerPlugin),
+        policy_(policy),
+        budget_(std::move(budget)),
+        weights_(std::move(weights)) {}
+
+  ~SonarSendQueue();
+
+  SonarSendQueue(const SonarSendQueue&) = delete;
+  SonarSendQueue& operator=(const SonarSendQueue&) = delete;
+
+  /**
+   Queue entry. Returns true if the consumer isn't scheduled yet and should be
+   scheduled to drain the queue.
+   */
+  bool push(Entry entry, bool mayBlock);
+
+  /**
+   Take up to maxEntries of what is queued so far, taking turns between the
+   plugins. Unblocks producers waiting for room.
+   */
+  Drained drain(size_t maxEntries = SIZE_MAX);
+
+  /**
+   Drop everything queued so far, counting it as dropped. Returns the bytes
+   of the serialized entries dropped.
+   */
+  size_t discard();
+
+ private:
+  struct Staged {
+    Entry entry;
+    // Reserved in budget_.
+    size_t size;
+    Staged* next;
+  };
+
+  struct PluginQueue {
+    std::deque<Entry> entries;
+    // Reserved in budget_ by entries.
+    size_t bytes = 0;
+    // Whether the plugin is in turns_.
+    bool hasTurn = false;
+  };
+
+  // Moves the lock-free pushes, newest first, to the end of their plugin's
+  // queue. Must hold mutex_.
+  void takeStaged();
+  // Must hold mutex_.
+  void append(PluginQueue& queue, Entry entry, size_t size);
+  size_t weight(const std::string& plugin) const;
+
+  const size_t maxQueuedPerPlugin_;
+  const OverflowPolicy policy_;
+  const std::shared_ptr<SonarMemoryBudget> budget_;
+  const std::unordered_map<std::string, size_t> weights_;
+
+  std::mutex mutex_;
+  std::condition_variable hasRoom_;
+  // Never erased, blocked producers hold references to their plugin's.
+  std::unordered_map<std::string, PluginQueue> queues_;
+  // Plugins with entries queued, in the order of their next turn. Queues
+  // emptied by dropOldest keep their turn, which is then skipped.
+  std::deque<std::string> turns_;
+  std::map<std::string, size_t> dropped_;
+
+  // Lock-free pushes not taken into entries_ yet, newest first.
+  std::atomic<Staged*> staged_{nullptr};
+  // Entries staged or in entries_, including pushes about to be staged.
+  std::atomic<size_t> pending_{0};
+  std::atomic<bool> drainScheduled_{false};
+};
+
+} // namespace sonar
+} // namespace facebook
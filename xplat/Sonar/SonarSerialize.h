@@ -0,0 +1,373 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarJsonWriter.h>
+#include <Sonar/SonarRawJson.h>
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/json.h>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ A field of a struct that can be written straight to JSON, see
+ SONAR_FIELDS.
+ */
+template <typename Class, typename Member>
+struct SonarField {
+  const char* name;
+  Member Class::*member;
+};
+
+template <typename Class, typename Member>
+constexpr SonarField<Class, Member> sonarField(
+    const char* name,
+    Member Class::*member) {
+  return {name, member};
+}
+
+#define SONAR_FIELD(Class, name) \
+  ::facebook::sonar::sonarField(#name, &Class::name)
+
+/**
+ Lists the fields of a struct for serializeJson and SonarConnection::send,
+ and for deserializeJson and SonarConnection::receive, in the order they are
+ written:
+
+   struct Request {
+     std::string url;
+     int64_t startTime;
+     SONAR_FIELDS(SONAR_FIELD(Request, url), SONAR_FIELD(Request, startTime))
+   };
+
+ The serializer and parser are generated from the list at compile time, the
+ struct isn't converted from or to a folly::dynamic. Fields can be numbers, bools,
+ strings, folly::Optional (null when empty), vectors, maps with string keys,
+ other structs with SONAR_FIELDS, and folly::dynamic for anything else.
+ */
+#define SONAR_FIELDS(...)                  \
+  static constexpr auto sonarFields() {    \
+    return std::make_tuple(__VA_ARGS__);   \
+  }
+
+namespace detail {
+
+template <typename T, typename = void>
+struct HasSonarFields : std::false_type {};
+
+template <typename T>
+struct HasSonarFields<T, decltype(void(T::sonarFields()))> : std::true_type {};
+
+inline void writeJson(std::string& out, const folly::dynamic& value) {
+  sonarAppendJson(value, out);
+}
+
+inline void writeJson(std::string& out, bool value) {
+  out += value ? "true" : "false";
+}
+
+inline void writeJson(std::string& out, folly::StringPiece value) {
+  sonarAppendJsonString(value, out);
+}
+
+inline void writeJson(std::string& out, const std::string& value) {
+  writeJson(out, folly::StringPiece(value));
+}
+
+inline void writeJson(std::string& out, const char* value) {
+  writeJson(out, folly::StringPiece(value));
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value>::type writeJson(
+    std::string& out,
+    T value) {
+  folly::toAppend(value, &out);
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type writeJson(
+    std::string& out,
+    T value) {
+  if (!std::isfinite(value)) {
+    throw std::invalid_argument("Non-finite numbers aren't valid JSON");
+  }
+  folly::toAppend(value, &out);
+}
+
+// Declared up front, so that they can be nested in any order.
+template <typename T>
+typename std::enable_if<HasSonarFields<T>::value>::type writeJson(
+    std::string& out,
+    const T& value);
+template <typename T>
+void writeJson(std::string& out, const folly::Optional<T>& value);
+template <typename T>
+void writeJson(std::string& out, const std::vector<T>& values);
+template <typename T>
+void writeJson(std::string& out, const std::map<std::string, T>& values);
+template <typename T>
+void writeJson(
+    std::string& out,
+    const std::unordered_map<std::string, T>& values);
+
+template <typename T>
+void writeJson(std::string& out, const folly::Optional<T>& value) {
+  if (value) {
+    writeJson(out, *value);
+  } else {
+    out += "null";
+  }
+}
+
+template <typename T>
+void writeJson(std::string& out, const std::vector<T>& values) {
+  out += '[';
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    writeJson(out, values[i]);
+  }
+  out += ']';
+}
+
+template <typename Map>
+void writeJsonObject(std::string& out, const Map& values) {
+  out += '{';
+  bool first = true;
+  for (const auto& entry : values) {
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    writeJson(out, folly::StringPiece(entry.first));
+    out += ':';
+    writeJson(out, entry.second);
+  }
+  out += '}';
+}
+
+template <typename T>
+void writeJson(std::string& out, const std::map<std::string, T>& values) {
+  writeJsonObject(out, values);
+}
+
+template <typename T>
+void writeJson(
+    std::string& out,
+    const std::unordered_map<std::string, T>& values) {
+  writeJsonObject(out, values);
+}
+
+template <typename T, typename Fields, size_t... Indices>
+void writeJsonFields(
+    std::string& out,
+    const T& value,
+    const Fields& fields,
+    std::index_sequence<Indices...>) {
+  out += '{';
+  // Expands to one write per field, in order.
+  const int expand[] = {
+      0,
+      (out += Indices == 0 ? "" : ",",
+       writeJson(out, folly::StringPiece(std::get<Indices>(fields).name)),
+       out += ':',
+       writeJson(out, value.*(std::get<Indices>(fields).member)),
+       0)...};
+  (void)expand;
+  out += '}';
+}
+
+template <typename T>
+typename std::enable_if<HasSonarFields<T>::value>::type writeJson(
+    std::string& out,
+    const T& value) {
+  constexpr auto fields = T::sonarFields();
+  writeJsonFields(
+      out,
+      value,
+      fields,
+      std::make_index_sequence<
+          std::tuple_size<typename std::decay<decltype(fields)>::type>::
+              value>());
+}
+
+// Parsing. Values are read from the JSON text, unknown fields are skipped
+// without being parsed.
+
+template <typename T>
+struct AcceptsMissing : std::false_type {};
+
+template <typename T>
+struct AcceptsMissing<folly::Optional<T>> : std::true_type {};
+
+template <>
+struct AcceptsMissing<folly::dynamic> : std::true_type {};
+
+inline void readJson(const SonarRawJson& json, folly::dynamic& value) {
+  value = json.parse();
+}
+
+inline void readJson(const SonarRawJson& json, bool& value) {
+  if (json.json() == "true") {
+    value = true;
+  } else if (json.json() == "false") {
+    value = false;
+  } else {
+    throw std::invalid_argument("Expected a bool: " + json.json().str());
+  }
+}
+
+inline void readJson(const SonarRawJson& json, std::string& value) {
+  value = json.asString();
+}
+
+template <typename T>
+typename std::enable_if<
+    std::is_integral<T>::value || std::is_floating_point<T>::value>::type
+readJson(const SonarRawJson& json, T& value) {
+  value = folly::to<T>(json.json());
+}
+
+template <typename T>
+typename std::enable_if<HasSonarFields<T>::value>::type readJson(
+    const SonarRawJson& json,
+    T& value);
+template <typename T>
+void readJson(const SonarRawJson& json, folly::Optional<T>& value);
+template <typename T>
+void readJson(const SonarRawJson& json, std::vector<T>& values);
+template <typename T>
+void readJson(const SonarRawJson& json, std::map<std::string, T>& values);
+template <typename T>
+void readJson(
+    const SonarRawJson& json,
+    std::unordered_map<std::string, T>& values);
+
+template <typename T>
+void readJson(const SonarRawJson& json, folly::Optional<T>& value) {
+  if (json.isNull()) {
+    value = folly::none;
+    return;
+  }
+  T present;
+  readJson(json, present);
+  value = std::move(present);
+}
+
+template <typename T>
+void readJson(const SonarRawJson& json, std::vector<T>& values) {
+  const auto elements = json.elements();
+  values.clear();
+  values.reserve(elements.size());
+  for (const auto& element : elements) {
+    values.emplace_back();
+    readJson(element, values.back());
+  }
+}
+
+template <typename Map>
+void readJsonObject(const SonarRawJson& json, Map& values) {
+  values.clear();
+  for (const auto& field : json.fields()) {
+    readJson(field.second, values[field.first]);
+  }
+}
+
+template <typename T>
+void readJson(const SonarRawJson& json, std::map<std::string, T>& values) {
+  readJsonObject(json, values);
+}
+
+template <typename T>
+void readJson(
+    const SonarRawJson& json,
+    std::unordered_map<std::string, T>& values) {
+  readJsonObject(json, values);
+}
+
+template <typename T, typename Member>
+void readJsonField(
+    const SonarRawJson::Fields& json,
+    const SonarField<T, Member>& field,
+    T& value) {
+  const auto raw = SonarRawJson::field(json, field.name);
+  if (raw.empty() && !AcceptsMissing<Member>::value) {
+    throw std::invalid_argument(std::string("Missing field ") + field.name);
+  }
+  readJson(raw, value.*(field.member));
+}
+
+template <typename T, typename Fields, size_t... Indices>
+void readJsonFields(
+    const SonarRawJson::Fields& json,
+    T& value,
+    const Fields& fields,
+    std::index_sequence<Indices...>) {
+  const int expand[] = {
+      0, (readJsonField(json, std::get<Indices>(fields), value), 0)...};
+  (void)expand;
+}
+
+template <typename T>
+typename std::enable_if<HasSonarFields<T>::value>::type readJson(
+    const SonarRawJson& json,
+    T& value) {
+  constexpr auto fields = T::sonarFields();
+  readJsonFields(
+      json.fields(),
+      value,
+      fields,
+      std::make_index_sequence<
+          std::tuple_size<typename std::decay<decltype(fields)>::type>::
+              value>());
+}
+
+} // namespace detail
+
+template <typename T>
+struct SonarHasFields : detail::HasSonarFields<T> {};
+
+/**
+ Writes a struct with SONAR_FIELDS as JSON.
+ */
+template <typename T>
+std::string serializeJson(const T& value) {
+  std::string out;
+  detail::writeJson(out, value);
+  return out;
+}
+
+/**
+ Reads a struct with SONAR_FIELDS from JSON. Fields that aren't listed are
+ skipped, listed ones may only be missing if they are folly::Optional or
+ folly::dynamic. Throws if the JSON doesn't fit the struct.
+ */
+template <typename T>
+T deserializeJson(folly::StringPiece json) {
+  T value;
+  detail::readJson(SonarRawJson::view(json), value);
+  return value;
+}
+
+} // namespace sonar
+} // namespace facebook
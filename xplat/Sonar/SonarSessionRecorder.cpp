@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarSessionRecorder.h"
+
+#include <folly/json.h>
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+
+namespace facebook {
+namespace sonar {
+
+SonarSessionRecorder::SonarSessionRecorder(const std::string& path)
+    : start_(std::chrono::steady_clock::now()),
+      file_(std::fopen(path.c_str(), "w")) {
+  if (!file_) {
+    throw std::system_error(errno, std::generic_category(), "fopen " + path);
+  }
+}
+
+SonarSessionRecorder::~SonarSessionRecorder() {
+  std::fclose(file_);
+}
+
+void SonarSessionRecorder::record(
+    Direction direction,
+    bool stream,
+    folly::StringPiece frame) {
+  const auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_);
+  const auto line = folly::toJson(folly::dynamic::object(
+                        "time", static_cast<int64_t>(time.count()))(
+                        "direction",
+                        direction == Direction::inbound ? "in" : "out")(
+                        "stream", stream)("frame", frame)) +
+      "\n";
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::fwrite(line.data(), 1, line.size(), file_);
+  // Kept readable while the session goes on, and if the app is killed.
+  std::fflush(file_);
+}
+
+std::vector<SonarSessionRecorder::Frame> SonarSessionRecorder::load(
+    const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  std::vector<Frame> frames;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    const auto record = folly::parseJson(line);
+    const auto& direction = record["direction"].getString();
+    if (direction != "in" && direction != "out") {
+      throw std::runtime_error("unknown frame direction " + direction);
+    }
+    frames.push_back(Frame{
+        std::chrono::microseconds(record["time"].getInt()),
+        direction == "in" ? Direction::inbound : Direction::outbound,
+        record["stream"].getBool(),
+        record["frame"].getString()});
+  }
+  return frames;
+}
+
+} // namespace sonar
+} // namespace facebook
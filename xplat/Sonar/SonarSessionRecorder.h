@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Writes the frames exchanged with the desktop to a file, each with the time
+ since recording started, so that a session's traffic can be replayed into a
+ client later (see SonarTestLib/SonarSessionReplay.h). Frames are recorded as
+ JSON, BSER frames are converted. Each line of the file is a JSON object with
+ the fields time (in microseconds), direction ("in" or "out"), stream (true
+ for inbound stream requests) and frame (the frame's text). Safe to use from
+ any thread.
+ */
+class SonarSessionRecorder {
+ public:
+  enum class Direction { inbound, outbound };
+
+  struct Frame {
+    std::chrono::microseconds time;
+    Direction direction;
+    bool stream;
+    std::string data;
+  };
+
+  /**
+   Creates the file at path, replacing what was there. Throws
+   std::system_error if it can't be created.
+   */
+  explicit SonarSessionRecorder(const std::string& path);
+  ~SonarSessionRecorder();
+
+  SonarSessionRecorder(const SonarSessionRecorder&) = delete;
+  SonarSessionRecorder& operator=(const SonarSessionRecorder&) = delete;
+
+  void record(Direction direction, bool stream, folly::StringPiece frame);
+
+  /**
+   Reads a recording back, in the order it was written. Throws
+   std::system_error if the file can't be read and std::runtime_error if
+   a line isn't a frame.
+   */
+  static std::vector<Frame> load(const std::string& path);
+
+ private:
+  const std::chrono::steady_clock::time_point start_;
+  std::mutex mutex_;
+  FILE* file_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,200 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarSimdImpl.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__arm__) && defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace facebook {
+namespace sonar {
+
+const char kSonarBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+namespace {
+
+#if defined(__arm__) && defined(__linux__)
+
+// getauxval needs API 18, so the hardware capabilities are read from where
+// it gets them.
+bool hasNeon() {
+  constexpr unsigned long kAtHwcap = 16;
+  constexpr unsigned long kHwcapNeon = 1 << 12;
+  const int fd = open("/proc/self/auxv", O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool neon = false;
+  unsigned long entry[2];
+  while (read(fd, entry, sizeof(entry)) == sizeof(entry) && entry[0] != 0) {
+    if (entry[0] == kAtHwcap) {
+      neon = (entry[1] & kHwcapNeon) != 0;
+      break;
+    }
+  }
+  close(fd);
+  return neon;
+}
+
+#endif
+
+SonarCpuFeatures detectCpuFeatures() {
+  SonarCpuFeatures features;
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_cpu_init();
+  features.sse2 = __builtin_cpu_supports("sse2");
+  features.ssse3 = __builtin_cpu_supports("ssse3");
+  // Also checks that the OS saves the AVX registers.
+  features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(__aarch64__)
+  features.neon = true;
+#elif defined(__arm__) && defined(__linux__)
+  features.neon = hasNeon();
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  // Every armv7 iOS device.
+  features.neon = true;
+#endif
+  return features;
+}
+
+constexpr uint64_t kOnes = ~uint64_t(0) / 255;
+constexpr uint64_t kHighBits = kOnes * 0x80;
+
+// Whether any byte of word is zero. Exact as to whether there is one, which
+// is all that is asked.
+inline uint64_t hasZeroByte(uint64_t word) {
+  return (word - kOnes) & ~word & kHighBits;
+}
+
+inline bool isPlainWord(uint64_t word) {
+  const auto below = (word - kOnes * 0x20) & ~word & kHighBits;
+  return (below | (word & kHighBits) | hasZeroByte(word ^ (kOnes * '"')) |
+          hasZeroByte(word ^ (kOnes * '\\'))) == 0;
+}
+
+inline bool isPlainByte(unsigned char c) {
+  return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+}
+
+const SonarSimdKernels kScalarKernels = {
+    SonarSimdLevel::scalar,
+    sonarJsonPlainPrefixScalar,
+    sonarBase64GroupsScalar,
+    sonarMaskScalar,
+};
+
+} // namespace
+
+size_t sonarJsonPlainPrefixScalar(const char* data, size_t size) {
+  size_t i = 0;
+  for (; size - i >= 8; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    if (!isPlainWord(word)) {
+      break;
+    }
+  }
+  while (i < size && isPlainByte(data[i])) {
+    i++;
+  }
+  return i;
+}
+
+size_t sonarBase64GroupsScalar(const uint8_t* src, size_t size, char* dst) {
+  const size_t groups = size / 3;
+  for (size_t i = 0; i < groups; i++, src += 3) {
+    const uint32_t n = src[0] << 16 | src[1] << 8 | src[2];
+    *dst++ = kSonarBase64Alphabet[n >> 18];
+    *dst++ = kSonarBase64Alphabet[n >> 12 & 63];
+    *dst++ = kSonarBase64Alphabet[n >> 6 & 63];
+    *dst++ = kSonarBase64Alphabet[n & 63];
+  }
+  return groups * 3;
+}
+
+void sonarMaskScalar(
+    uint8_t* dst,
+    const uint8_t* src,
+    size_t size,
+    const uint8_t key[4]) {
+  // A word at a time, as 8 bytes of key are its 4 twice.
+  uint8_t pattern[8];
+  for (size_t j = 0; j < 8; j++) {
+    pattern[j] = key[j & 3];
+  }
+  uint64_t word;
+  std::memcpy(&word, pattern, sizeof(word));
+  size_t i = 0;
+  for (; size - i >= 8; i += 8) {
+    uint64_t chunk;
+    std::memcpy(&chunk, src + i, sizeof(chunk));
+    chunk ^= word;
+    std::memcpy(dst + i, &chunk, sizeof(chunk));
+  }
+  for (; i < size; i++) {
+    dst[i] = src[i] ^ key[i & 3];
+  }
+}
+
+const SonarCpuFeatures& sonarCpuFeatures() {
+  static const SonarCpuFeatures features = detectCpuFeatures();
+  return features;
+}
+
+const char* sonarSimdLevelName(SonarSimdLevel level) {
+  switch (level) {
+    case SonarSimdLevel::scalar:
+      return "scalar";
+    case SonarSimdLevel::ssse3:
+      return "ssse3";
+    case SonarSimdLevel::avx2:
+      return "avx2";
+    case SonarSimdLevel::neon:
+      return "neon";
+  }
+  return "unknown";
+}
+
+const SonarSimdKernels* sonarSimdKernels(SonarSimdLevel level) {
+  const auto& cpu = sonarCpuFeatures();
+  switch (level) {
+    case SonarSimdLevel::scalar:
+      return &kScalarKernels;
+    case SonarSimdLevel::ssse3:
+      return cpu.sse2 && cpu.ssse3 ? sonarSimdKernelsX86(level) : nullptr;
+    case SonarSimdLevel::avx2:
+      return cpu.sse2 && cpu.ssse3 && cpu.avx2 ? sonarSimdKernelsX86(level)
+                                               : nullptr;
+    case SonarSimdLevel::neon:
+      return cpu.neon ? sonarSimdKernelsNeon() : nullptr;
+  }
+  return nullptr;
+}
+
+const SonarSimdKernels& sonarSimdKernels() {
+  static const SonarSimdKernels* const best = []() {
+    for (const auto level : {SonarSimdLevel::avx2,
+                             SonarSimdLevel::ssse3,
+                             SonarSimdLevel::neon}) {
+      if (const auto kernels = sonarSimdKernels(level)) {
+        return kernels;
+      }
+    }
+    return &kScalarKernels;
+  }();
+  return *best;
+}
+
+} // namespace sonar
+} // namespace facebook
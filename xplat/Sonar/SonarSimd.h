@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ The vector extensions of the CPU the client runs on, detected on first use.
+ SSE2 is always there on x86_64 and NEON on arm64, but neither SSSE3 nor AVX2
+ on every x86 host or emulator, nor NEON on every armeabi-v7a device.
+ */
+struct SonarCpuFeatures {
+  bool neon = false;
+  bool sse2 = false;
+  bool ssse3 = false;
+  bool avx2 = false;
+};
+
+const SonarCpuFeatures& sonarCpuFeatures();
+
+enum class SonarSimdLevel {
+  scalar,
+  // SSE2 and SSSE3.
+  ssse3,
+  avx2,
+  neon,
+};
+
+const char* sonarSimdLevelName(SonarSimdLevel level);
+
+/**
+ The client's vectorized kernels, built for one SonarSimdLevel. Each gives
+ the same results at every level, only faster.
+ */
+struct SonarSimdKernels {
+  SonarSimdLevel level;
+
+  /**
+   How many bytes at the start of data can go into a JSON string as they
+   are: none below 0x20 or of 0x80 and above, no quote and no backslash.
+   */
+  size_t (*jsonPlainPrefix)(const char* data, size_t size);
+
+  /**
+   Base64 encodes the whole groups of 3 bytes of src into dst, 4 characters
+   each, and returns how many bytes that was. The caller pads the rest.
+   */
+  size_t (*base64Groups)(const uint8_t* src, size_t size, char* dst);
+
+  /**
+   XORs size bytes of src with the websocket masking key, starting at its
+   first byte, into dst, which may be src.
+   */
+  void (*mask)(
+      uint8_t* dst,
+      const uint8_t* src,
+      size_t size,
+      const uint8_t key[4]);
+};
+
+/**
+ The kernels of the best level the build and the CPU support, picked once.
+ */
+const SonarSimdKernels& sonarSimdKernels();
+
+/**
+ The kernels of a given level, or nullptr if the build or the CPU doesn't
+ support it. For tests and benchmarks comparing levels.
+ */
+const SonarSimdKernels* sonarSimdKernels(SonarSimdLevel level);
+
+} // namespace sonar
+} // namespace facebook
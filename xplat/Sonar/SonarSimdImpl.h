@@ -0,0 +1,33 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include "SonarSimd.h"
+
+namespace facebook {
+namespace sonar {
+
+// The kernels of each level are built in a file of their own, so that only
+// that file needs the level's instructions. nullptr if the build has none.
+const SonarSimdKernels* sonarSimdKernelsX86(SonarSimdLevel level);
+const SonarSimdKernels* sonarSimdKernelsNeon();
+
+// The scalar kernels, which the others finish with.
+size_t sonarJsonPlainPrefixScalar(const char* data, size_t size);
+size_t sonarBase64GroupsScalar(const uint8_t* src, size_t size, char* dst);
+void sonarMaskScalar(
+    uint8_t* dst,
+    const uint8_t* src,
+    size_t size,
+    const uint8_t key[4]);
+
+extern const char kSonarBase64Alphabet[];
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarSimdImpl.h"
+
+// On armeabi-v7a only this file is built with NEON, see CMakeLists.txt, so
+// that nothing else picks up instructions older devices don't have.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+#include <cstring>
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+inline bool hasAnyByte(uint8x16_t bytes) {
+#if defined(__aarch64__)
+  return vmaxvq_u8(bytes) != 0;
+#else
+  const auto folded = vorr_u8(vget_low_u8(bytes), vget_high_u8(bytes));
+  return vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0;
+#endif
+}
+
+size_t jsonPlainPrefixNeon(const char* data, size_t size) {
+  const auto space = vdupq_n_u8(0x20);
+  const auto high = vdupq_n_u8(0x80);
+  const auto quote = vdupq_n_u8('"');
+  const auto backslash = vdupq_n_u8('\\');
+  size_t i = 0;
+  for (; size - i >= 16; i += 16) {
+    const auto block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+    const auto special = vorrq_u8(
+        vorrq_u8(vcltq_u8(block, space), vcgeq_u8(block, high)),
+        vorrq_u8(vceqq_u8(block, quote), vceqq_u8(block, backslash)));
+    if (hasAnyByte(special)) {
+      // Which byte it is, within this block.
+      break;
+    }
+  }
+  return i + sonarJsonPlainPrefixScalar(data + i, size - i);
+}
+
+#if defined(__aarch64__)
+
+// Splits 48 bytes into the 6 bit indexes of 64 characters, and looks them all
+// up in the 64 byte alphabet at once. vqtbl4q_u8 is AArch64 only.
+size_t base64GroupsNeon(const uint8_t* src, size_t size, char* dst) {
+  const auto alphabet = reinterpret_cast<const uint8_t*>(kSonarBase64Alphabet);
+  uint8x16x4_t table;
+  table.val[0] = vld1q_u8(alphabet);
+  table.val[1] = vld1q_u8(alphabet + 16);
+  table.val[2] = vld1q_u8(alphabet + 32);
+  table.val[3] = vld1q_u8(alphabet + 48);
+  const auto mask = vdupq_n_u8(63);
+  size_t i = 0;
+  for (; size - i >= 48; i += 48, dst += 64) {
+    // in.val[k][j] is byte k of group j.
+    const auto in = vld3q_u8(src + i);
+    uint8x16x4_t indexes;
+    indexes.val[0] = vshrq_n_u8(in.val[0], 2);
+    indexes.val[1] = vandq_u8(
+        vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+    indexes.val[2] = vandq_u8(
+        vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+    indexes.val[3] = vandq_u8(in.val[2], mask);
+    uint8x16x4_t encoded;
+    for (int k = 0; k < 4; k++) {
+      encoded.val[k] = vqtbl4q_u8(table, indexes.val[k]);
+    }
+    vst4q_u8(reinterpret_cast<uint8_t*>(dst), encoded);
+  }
+  return i + sonarBase64GroupsScalar(src + i, size - i, dst);
+}
+
+#endif
+
+void maskNeon(
+    uint8_t* dst,
+    const uint8_t* src,
+    size_t size,
+    const uint8_t key[4]) {
+  uint32_t word;
+  std::memcpy(&word, key, sizeof(word));
+  const auto pattern = vreinterpretq_u8_u32(vdupq_n_u32(word));
+  size_t i = 0;
+  for (; size - i >= 16; i += 16) {
+    vst1q_u8(dst + i, veorq_u8(vld1q_u8(src + i), pattern));
+  }
+  // The key starts over every 16 bytes.
+  sonarMaskScalar(dst + i, src + i, size - i, key);
+}
+
+const SonarSimdKernels kNeonKernels = {
+    SonarSimdLevel::neon,
+    jsonPlainPrefixNeon,
+#if defined(__aarch64__)
+    base64GroupsNeon,
+#else
+    sonarBase64GroupsScalar,
+#endif
+    maskNeon,
+};
+
+} // namespace
+
+const SonarSimdKernels* sonarSimdKernelsNeon() {
+  return &kNeonKernels;
+}
+
+} // namespace sonar
+} // namespace facebook
+
+#else
+
+namespace facebook {
+namespace sonar {
+
+const SonarSimdKernels* sonarSimdKernelsNeon() {
+  return nullptr;
+}
+
+} // namespace sonar
+} // namespace facebook
+
+#endif
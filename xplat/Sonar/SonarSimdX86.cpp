@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarSimdImpl.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+#include <cstring>
+
+// Each kernel is compiled for the instructions it needs, whatever the rest
+// of the build targets, and only called once the CPU is known to have them.
+#define SONAR_TARGET(features) __attribute__((target(features)))
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+SONAR_TARGET("sse2")
+size_t jsonPlainPrefixSse2(const char* data, size_t size) {
+  const auto space = _mm_set1_epi8(0x20);
+  const auto quote = _mm_set1_epi8('"');
+  const auto backslash = _mm_set1_epi8('\\');
+  size_t i = 0;
+  for (; size - i >= 16; i += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    // Signed, so that bytes of 0x80 and above compare below 0x20 too.
+    const auto special = _mm_or_si128(
+        _mm_cmplt_epi8(block, space),
+        _mm_or_si128(
+            _mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)));
+    if (const int bits = _mm_movemask_epi8(special)) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+  return i + sonarJsonPlainPrefixScalar(data + i, size - i);
+}
+
+SONAR_TARGET("avx2")
+size_t jsonPlainPrefixAvx2(const char* data, size_t size) {
+  const auto space = _mm256_set1_epi8(0x20);
+  const auto quote = _mm256_set1_epi8('"');
+  const auto backslash = _mm256_set1_epi8('\\');
+  size_t i = 0;
+  for (; size - i >= 32; i += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    const auto special = _mm256_or_si256(
+        _mm256_cmpgt_epi8(space, block),
+        _mm256_or_si256(
+            _mm256_cmpeq_epi8(block, quote),
+            _mm256_cmpeq_epi8(block, backslash)));
+    if (const auto bits =
+            static_cast<uint32_t>(_mm256_movemask_epi8(special))) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+  return i + jsonPlainPrefixSse2(data + i, size - i);
+}
+
+// Encodes 12 bytes at a time, from 16 byte loads: the 3 bytes of each group are
+// spread over a 32 bit lane, split into 4 indexes with multiplies standing in
+// for per-lane shifts, and the indexes mapped to characters by the offset of
+// their range of the alphabet.
+SONAR_TARGET("ssse3")
+size_t base64GroupsSsse3(const uint8_t* src, size_t size, char* dst) {
+  const auto spread =
+      _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const auto offsets = _mm_setr_epi8(
+      'a' - 26,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '0' - 52,
+      '+' - 62,
+      '/' - 63,
+      'A',
+      0,
+      0);
+  size_t i = 0;
+  for (; size - i >= 16; i += 12, dst += 16) {
+    const auto in = _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), spread);
+    const auto high = _mm_mulhi_epu16(
+        _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+        _mm_set1_epi32(0x04000040));
+    const auto low = _mm_mullo_epi16(
+        _mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+        _mm_set1_epi32(0x01000010));
+    const auto indexes = _mm_or_si128(high, low);
+    // 0 for 'a' to 'z', 1 to 12 for '0' to '/', 13 for 'A' to 'Z'.
+    auto range = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    range = _mm_or_si128(
+        range,
+        _mm_and_si128(
+            _mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+    const auto encoded =
+        _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indexes);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), encoded);
+  }
+  return i + sonarBase64GroupsScalar(src + i, size - i, dst);
+}
+
+SONAR_TARGET("sse2")
+void maskSse2(
+    uint8_t* dst,
+    const uint8_t* src,
+    size_t size,
+    const uint8_t key[4]) {
+  int32_t word;
+  std::memcpy(&word, key, sizeof(word));
+  const auto pattern = _mm_set1_epi32(word);
+  size_t i = 0;
+  for (; size - i >= 16; i += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(block, pattern));
+  }
+  // The key starts over every 16 bytes.
+  sonarMaskScalar(dst + i, src + i, size - i, key);
+}
+
+SONAR_TARGET("avx2")
+void maskAvx2(
+    uint8_t* dst,
+    const uint8_t* src,
+    size_t size,
+    const uint8_t key[4]) {
+  int32_t word;
+  std::memcpy(&word, key, sizeof(word));
+  const auto pattern = _mm256_set1_epi32(word);
+  size_t i = 0;
+  for (; size - i >= 32; i += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(dst + i),
+        _mm256_xor_si256(block, pattern));
+  }
+  maskSse2(dst + i, src + i, size - i, key);
+}
+
+// Base64 doesn't gain enough from 32 bytes to make up for shuffles not
+// crossing 16 byte lanes, the AVX2 level keeps the SSSE3 kernel.
+const SonarSimdKernels kSsse3Kernels = {
+    SonarSimdLevel::ssse3,
+    jsonPlainPrefixSse2,
+    base64GroupsSsse3,
+    maskSse2,
+};
+
+const SonarSimdKernels kAvx2Kernels = {
+    SonarSimdLevel::avx2,
+    jsonPlainPrefixAvx2,
+    base64GroupsSsse3,
+    maskAvx2,
+};
+
+} // namespace
+
+const SonarSimdKernels* sonarSimdKernelsX86(SonarSimdLevel level) {
+  switch (level) {
+    case SonarSimdLevel::ssse3:
+      return &kSsse3Kernels;
+    case SonarSimdLevel::avx2:
+      return &kAvx2Kernels;
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
+
+#else
+
+namespace facebook {
+namespace sonar {
+
+const SonarSimdKernels* sonarSimdKernelsX86(SonarSimdLevel) {
+  return nullptr;
+}
+
+} // namespace sonar
+} // namespace facebook
+
+#endif
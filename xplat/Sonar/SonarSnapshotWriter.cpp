@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+#include "SonarSnapshotWriter.h"
+#include "SonarJsonWriter.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+constexpr size_t SonarSnapshotWriter::kDefaultChunkSize;
+
+SonarSnapshotWriter::SonarSnapshotWriter(
+    std::shared_ptr<SonarStreamResponder> responder,
+    size_t chunkSize)
+    : responder_(std::move(responder)),
+      chunkSize_(chunkSize > 0 ? chunkSize : kDefaultChunkSize),
+      stream_(std::make_unique<z_stream_s>()) {
+  if (deflateInit(stream_.get(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+    throw std::runtime_error("Unable to initialize deflate stream");
+  }
+}
+
+SonarSnapshotWriter::~SonarSnapshotWriter() {
+  deflateEnd(stream_.get());
+  if (!done_) {
+    responder_->error(folly::dynamic::object("message", "Snapshot abandoned"));
+  }
+}
+
+void SonarSnapshotWriter::write(const folly::dynamic& part) {
+  if (done_) {
+    throw std::logic_error("Snapshot already ended");
+  }
+  std::string line;
+  sonarAppendJson(part, line);
+  line += '\n';
+  bytesIn_ += line.size();
+  deflate(line.data(), line.size(), Z_NO_FLUSH);
+}
+
+void SonarSnapshotWriter::finish() {
+  if (done_) {
+    return;
+  }
+  deflate(nullptr, 0, Z_FINISH);
+  if (chunk_ && chunk_->length() > 0) {
+    sendChunk();
+  }
+  done_ = true;
+  responder_->complete();
+}
+
+void SonarSnapshotWriter::error(const folly::dynamic& response) {
+  if (done_) {
+    return;
+  }
+  done_ = true;
+  responder_->error(response);
+}
+
+void SonarSnapshotWriter::deflate(const void* data, size_t length, int flush) {
+  stream_->next_in = static_cast<Bytef*>(const_cast<void*>(data));
+  stream_->avail_in = static_cast<uInt>(length);
+  int result;
+  do {
+    if (!chunk_) {
+      chunk_ = folly::IOBuf::create(chunkSize_);
+    }
+    stream_->next_out = chunk_->writableTail();
+    stream_->avail_out = static_cast<uInt>(chunk_->tailroom());
+    result = ::deflate(stream_.get(), flush);
+    if (result == Z_STREAM_ERROR) {
+      throw std::runtime_error("Unable to deflate snapshot");
+    }
+    chunk_->append(chunk_->tailroom() - stream_->avail_out);
+    if (chunk_->tailroom() == 0) {
+      sendChunk();
+    }
+    // zlib may hold output back until the chunk had room for all of it.
+  } while (stream_->avail_in > 0 ||
+           (flush == Z_FINISH && result != Z_STREAM_END));
+}
+
+void SonarSnapshotWriter::sendChunk() {
+  bytesOut_ += chunk_->length();
+  responder_->nextBytes(std::move(chunk_));
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarStreamResponder.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+#include <memory>
+
+struct z_stream_s;
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Streams a plugin's whole state to the desktop as one zlib stream of JSON
+ values, one per line, cut into binary chunks of about chunkSize compressed
+ bytes. Plugins write their state in as many parts as suits them, only the
+ compressed output of the parts not sent yet is held in memory. See
+ SonarConnection::receiveSnapshot.
+ */
+class SonarSnapshotWriter {
+ public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit SonarSnapshotWriter(
+      std::shared_ptr<SonarStreamResponder> responder,
+      size_t chunkSize = kDefaultChunkSize);
+  // Responds with an error if neither finish nor error was called.
+  ~SonarSnapshotWriter();
+
+  SonarSnapshotWriter(const SonarSnapshotWriter&) = delete;
+  SonarSnapshotWriter& operator=(const SonarSnapshotWriter&) = delete;
+
+  void write(const folly::dynamic& part);
+
+  /**
+   Sends what is left and completes the stream.
+   */
+  void finish();
+
+  /**
+   Ends the stream with an error, the desktop discards what it received.
+   */
+  void error(const folly::dynamic& response);
+
+  // Uncompressed bytes written so far.
+  size_t bytesIn() const {
+    return bytesIn_;
+  }
+
+  // Compressed bytes sent so far.
+  size_t bytesOut() const {
+    return bytesOut_;
+  }
+
+ private:
+  // Compresses the input with flush, sending every full chunk.
+  void deflate(const void* data, size_t length, int flush);
+  void sendChunk();
+
+  const std::shared_ptr<SonarStreamResponder> responder_;
+  const size_t chunkSize_;
+  std::unique_ptr<z_stream_s> stream_;
+  std::unique_ptr<folly::IOBuf> chunk_;
+  size_t bytesIn_ = 0;
+  size_t bytesOut_ = 0;
+  bool done_ = false;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,148 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarStackCapture.h"
+
+#include <dlfcn.h>
+#include <signal.h>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__APPLE__) || defined(__GLIBC__)
+#include <execinfo.h>
+#define SONAR_HAS_EXECINFO 1
+#else
+#define SONAR_HAS_EXECINFO 0
+#endif
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+constexpr size_t kMaxFrames = 64;
+
+// Shared with the signal handler, which is only armed while a capture holds
+// captureMutex.
+std::mutex captureMutex;
+std::atomic<SonarStackUnwinder> captureUnwinder{nullptr};
+uintptr_t captureFrames[kMaxFrames];
+std::atomic<size_t> captureCount{0};
+std::atomic<bool> captureDone{false};
+
+// Whatever handled SIGURG before, e.g. the app's own handler for urgent
+// socket data. Written once, before ours is installed.
+struct sigaction previousAction;
+
+void handleCaptureSignal(int signal, siginfo_t* info, void* context) {
+  const int savedErrno = errno;
+  const auto unwinder = captureUnwinder.exchange(nullptr);
+  if (unwinder) {
+    captureCount.store(unwinder(captureFrames, kMaxFrames));
+    captureDone.store(true, std::memory_order_release);
+  } else if (previousAction.sa_flags & SA_SIGINFO) {
+    // Not ours, or a late signal of a capture that already gave up, which
+    // the previous handler has to cope with as it would with any SIGURG.
+    previousAction.sa_sigaction(signal, info, context);
+  } else if (
+      previousAction.sa_handler != SIG_DFL &&
+      previousAction.sa_handler != SIG_IGN) {
+    previousAction.sa_handler(signal);
+  }
+  // SIGURG is ignored by default, so there's nothing to do for SIG_DFL.
+  errno = savedErrno;
+}
+
+void installCaptureHandler() {
+  static std::once_flag installed;
+  std::call_once(installed, []() {
+#if SONAR_HAS_EXECINFO
+    // backtrace loads the unwinder on its first call, which isn't safe in a
+    // signal handler.
+    void* frame;
+    backtrace(&frame, 1);
+#endif
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleCaptureSignal;
+    action.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    // Read first, so that it's there by the time ours can run.
+    sigaction(SIGURG, nullptr, &previousAction);
+    sigaction(SIGURG, &action, nullptr);
+  });
+}
+
+} // namespace
+
+size_t sonarDefaultStackUnwinder(uintptr_t* frames, size_t max) {
+#if SONAR_HAS_EXECINFO
+  static_assert(sizeof(void*) == sizeof(uintptr_t), "frames are pointers");
+  const auto count = backtrace(reinterpret_cast<void**>(frames), max);
+  return count > 0 ? count : 0;
+#else
+  return 0;
+#endif
+}
+
+std::vector<uintptr_t> captureThreadStack(
+    pthread_t thread,
+    SonarStackUnwinder unwinder,
+    std::chrono::milliseconds timeout) {
+  installCaptureHandler();
+  std::lock_guard<std::mutex> lock(captureMutex);
+  captureDone.store(false);
+  captureUnwinder.store(unwinder);
+  if (pthread_kill(thread, SIGURG) != 0) {
+    captureUnwinder.store(nullptr);
+    return {};
+  }
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!captureDone.load(std::memory_order_acquire)) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      // Whichever of us and the handler takes the unwinder first wins.
+      if (captureUnwinder.exchange(nullptr)) {
+        return {};
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return std::vector<uintptr_t>(
+      captureFrames, captureFrames + captureCount.load());
+}
+
+std::vector<std::string> describeStack(const std::vector<uintptr_t>& frames) {
+  std::vector<std::string> described;
+  described.reserve(frames.size());
+  for (const auto frame : frames) {
+    Dl_info info;
+    char line[512];
+    if (dladdr(reinterpret_cast<void*>(frame), &info) && info.dli_fname) {
+      const char* module = strrchr(info.dli_fname, '/');
+      snprintf(
+          line,
+          sizeof(line),
+          "%s+0x%" PRIxPTR " %s",
+          module ? module + 1 : info.dli_fname,
+          frame - reinterpret_cast<uintptr_t>(info.dli_fbase),
+          info.dli_sname ? info.dli_sname : "");
+    } else {
+      snprintf(line, sizeof(line), "0x%" PRIxPTR, frame);
+    }
+    described.push_back(line);
+  }
+  return described;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Writes up to max return addresses of the calling thread's stack to frames,
+ innermost first, and returns how many it wrote. Called from a signal
+ handler, so it must be async-signal-safe: no allocation, no locks.
+ Platforms with an unwinder of their own, such as lyra on Android, should
+ provide one.
+ */
+using SonarStackUnwinder = size_t (*)(uintptr_t* frames, size_t max);
+
+/**
+ backtrace() where execinfo is available, e.g. on iOS. Captures nothing
+ elsewhere.
+ */
+size_t sonarDefaultStackUnwinder(uintptr_t* frames, size_t max);
+
+/**
+ The stack of another thread of this process, which is interrupted with
+ SIGURG to run unwinder on itself. Empty if the thread didn't get to it
+ within timeout, e.g. because it is blocked with signals masked. Captures
+ are made one at a time. A handler of SIGURG installed before the first
+ capture still gets the signals that aren't captures.
+ */
+std::vector<uintptr_t> captureThreadStack(
+    pthread_t thread,
+    SonarStackUnwinder unwinder,
+    std::chrono::milliseconds timeout);
+
+/**
+ Frames as "module+0xoffset symbol", resolved with dladdr. Not symbolicated
+ any further, the desktop or a developer can do that with the binaries.
+ */
+std::vector<std::string> describeStack(const std::vector<uintptr_t>& frames);
+
+} // namespace sonar
+} // namespace facebook
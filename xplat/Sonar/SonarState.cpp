@@ -8,6 +8,10 @@
 #include "SonarState.h"
 #include "SonarStateUpdateListener.h"
 #include "SonarStep.h"
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <vector>
 
 using namespace facebook::sonar;
@@ -16,54 +20,335 @@ using namespace facebook::sonar;
  * view of the current state of the sonar client. */
 
 
-SonarState::SonarState(): log("") {}
+constexpr size_t SonarState::kMaxLogEntries;
+constexpr std::chrono::milliseconds SonarState::kUpdateInterval;
+
+SonarState::SonarState() : snapshot(std::make_shared<const Snapshot>()) {}
+
+SonarState::~SonarState() {
+  {
+    std::lock_guard<std::mutex> lock(notifyMutex);
+    stopping = true;
+  }
+  notifyCondition.notify_all();
+  if (notifier.joinable()) {
+    notifier.join();
+  }
+}
+
 void SonarState::setUpdateListener(
     std::shared_ptr<SonarStateUpdateListener> listener) {
-  mListener = listener;
+  std::atomic_store(&mListener, listener);
+  std::lock_guard<std::mutex> lock(notifyMutex);
+  if (listener && !notifier.joinable()) {
+    notifier = std::thread([this] { runNotifications(); });
+  }
 }
 
-void SonarState::started(std::string step) {
-  if (stateMap.find(step) == stateMap.end()) {
-    insertOrder.push_back(step);
+uint64_t SonarState::getVersion() {
+  return getSnapshot()->version;
+}
+
+void SonarState::scheduleNotification() {
+  {
+    std::lock_guard<std::mutex> lock(notifyMutex);
+    if (notificationPending || !notifier.joinable()) {
+      return;
+    }
+    notificationPending = true;
   }
-  stateMap[step] = State::in_progress;
-  if (mListener) {
-    mListener->onUpdate();
+  notifyCondition.notify_all();
+}
+
+void SonarState::runNotifications() {
+  uint64_t notifiedVersion = 0;
+  std::unique_lock<std::mutex> lock(notifyMutex);
+  while (true) {
+    notifyCondition.wait(
+        lock, [this] { return notificationPending || stopping; });
+    // Let the rest of the burst land before telling the listener.
+    notifyCondition.wait_for(
+        lock, kUpdateInterval, [this] { return stopping; });
+    if (stopping) {
+      return;
+    }
+    notificationPending = false;
+    lock.unlock();
+    const auto listener = std::atomic_load(&mListener);
+    const auto version = getVersion();
+    if (listener && version != notifiedVersion) {
+      notifiedVersion = version;
+      listener->onVersionUpdate(version);
+    }
+    lock.lock();
+  }
+}
+
+std::shared_ptr<const SonarState::Snapshot> SonarState::getSnapshot() const {
+  return std::atomic_load(&snapshot);
+}
+
+void SonarState::update(const std::function<void(Snapshot&)>& change) {
+  auto current = getSnapshot();
+  while (true) {
+    auto next = std::make_shared<Snapshot>(*current);
+    change(*next);
+    next->version = current->version + 1;
+    if (std::atomic_compare_exchange_weak(
+            &snapshot, &current, std::shared_ptr<const Snapshot>(next))) {
+      break;
+    }
   }
+  scheduleNotification();
+}
+
+void SonarState::started(const SonarStepKey& key) {
+  update([&key](Snapshot& snapshot) {
+    setState(snapshot, key, State::in_progress);
+  });
 }
 
-void SonarState::success(std::string step) {
-  log = log + "[Success] " + step + "\n";
-  stateMap[step] = State::success;
-  if (mListener) {
-    mListener->onUpdate();
+void SonarState::setState(
+    Snapshot& snapshot,
+    const SonarStepKey& key,
+    State state) {
+  if (!sonarStepInfo(key.id).parametrized) {
+    const auto index = static_cast<size_t>(key.id);
+    if (!snapshot.fixedSeen[index]) {
+      snapshot.fixedSeen[index] = true;
+      snapshot.insertOrder.push_back(key);
+    }
+    snapshot.fixedStates[index] = state;
+    return;
   }
+  for (auto& entry : snapshot.parametrizedStates) {
+    if (entry.first == key) {
+      entry.second = state;
+      return;
+    }
+  }
+  snapshot.parametrizedStates.emplace_back(key, state);
+  snapshot.insertOrder.push_back(key);
 }
 
-void SonarState::failed(std::string step, std::string errorMessage) {
-  log = log + "[Failed] " + step + ": " + errorMessage + "\n";
-  stateMap[step] = State::failed;
-  if (mListener) {
-    mListener->onUpdate();
+State SonarState::stateOf(const Snapshot& snapshot, const SonarStepKey& key) {
+  if (!sonarStepInfo(key.id).parametrized) {
+    return snapshot.fixedStates[static_cast<size_t>(key.id)];
+  }
+  for (const auto& entry : snapshot.parametrizedStates) {
+    if (entry.first == key) {
+      return entry.second;
+    }
   }
+  return State::in_progress;
+}
+
+void SonarState::success(const SonarStep& step) {
+  appendLog({step.key,
+             State::success,
+             std::chrono::system_clock::now(),
+             "",
+             step.startTime,
+             std::chrono::steady_clock::now(),
+             step.id,
+             step.parentId,
+             step.rootId});
+  update([&step](Snapshot& snapshot) {
+    setState(snapshot, step.key, State::success);
+  });
+}
+
+void SonarState::failed(const SonarStep& step, std::string errorMessage) {
+  appendLog({step.key,
+             State::failed,
+             std::chrono::system_clock::now(),
+             std::move(errorMessage),
+             step.startTime,
+             std::chrono::steady_clock::now(),
+             step.id,
+             step.parentId,
+             step.rootId});
+  update([&step](Snapshot& snapshot) {
+    setState(snapshot, step.key, State::failed);
+  });
 }
 
 // TODO: Currently returns string, but should really provide a better
 // representation of the current state so the UI can show it in a more intuitive
 // way
 std::string SonarState::getState() {
+  std::string log;
+  for (const auto& entry : getLogEntries()) {
+    if (entry.state == State::success) {
+      log += "[Success] " + entry.step + "\n";
+    } else {
+      log += "[Failed] " + entry.step + ": " + entry.message + "\n";
+    }
+  }
   return log;
 }
 
+std::vector<LogEntry> SonarState::getLogEntries() {
+  std::vector<LogRecord> records;
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+    records.reserve(logSize);
+    const size_t oldest = logSize < kMaxLogEntries ? 0 : logNext;
+    for (size_t i = 0; i < logSize; i++) {
+      records.push_back(log[(oldest + i) % kMaxLogEntries]);
+    }
+  }
+  // Names are built outside the lock, steps being recorded don't wait.
+  std::vector<LogEntry> entries;
+  entries.reserve(records.size());
+  for (auto& record : records) {
+    entries.push_back({record.key.name(),
+                       record.state,
+                       record.time,
+                       std::move(record.message),
+                       record.started,
+                       record.finished,
+                       record.id,
+                       record.parentId,
+                       record.rootId});
+  }
+  return entries;
+}
+
+void SonarState::appendLog(LogRecord record) {
+  std::lock_guard<std::mutex> lock(logMutex);
+  // Moved into the slot, which reuses the evicted record's storage.
+  log[logNext] = std::move(record);
+  logNext = (logNext + 1) % kMaxLogEntries;
+  logSize = std::min(logSize + 1, kMaxLogEntries);
+}
+
 std::vector<StateElement> SonarState::getStateElements() {
+  const auto current = getSnapshot();
   std::vector<StateElement> v;
-  for (auto stepName : insertOrder) {
-    v.push_back(StateElement(stepName, stateMap[stepName]));
+  v.reserve(current->insertOrder.size());
+  for (const auto& key : current->insertOrder) {
+    v.push_back(StateElement(key.name(), stateOf(*current, key)));
   }
   return v;
 }
 
 std::shared_ptr<SonarStep> SonarState::start(std::string step_name) {
-  started(step_name);
-  return std::make_shared<SonarStep>(step_name, this);
+  return start(
+      {SonarStepId::custom,
+       std::make_shared<const std::string>(std::move(step_name))},
+      nullptr);
+}
+
+std::shared_ptr<SonarStep> SonarState::start(SonarStepId step) {
+  return start({step, nullptr}, nullptr);
+}
+
+std::shared_ptr<SonarStep> SonarState::start(
+    SonarStepId step,
+    std::string parameter) {
+  return start(
+      {step, std::make_shared<const std::string>(std::move(parameter))},
+      nullptr);
+}
+
+std::shared_ptr<SonarStep> SonarState::start(
+    SonarStepKey key,
+    const SonarStep* parent) {
+  started(key);
+  const auto id = nextStepId++;
+  return std::make_shared<SonarStep>(
+      std::move(key),
+      this,
+      id,
+      parent ? parent->id : 0,
+      parent ? parent->rootId : id);
+}
+
+namespace {
+
+void appendJsonString(std::string& out, const std::string& value) {
+  out += '"';
+  for (const char c : value) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[7];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+void appendTraceEvent(
+    std::string& out,
+    const LogEntry& entry,
+    const char* phase,
+    std::chrono::steady_clock::time_point time) {
+  const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                          time.time_since_epoch())
+                          .count();
+  out += out.back() == '[' ? "\n" : ",\n";
+  out += "{\"name\":";
+  appendJsonString(out, entry.step);
+  out += ",\"cat\":\"sonar\",\"ph\":\"";
+  out += phase;
+  // Steps sharing an id nest, so each tree of steps gets the id of its root.
+  out += "\",\"id\":" + std::to_string(entry.rootId);
+  out += ",\"pid\":" + std::to_string(getpid());
+  out += ",\"tid\":0,\"ts\":" + std::to_string(micros);
+  if (phase[0] == 'e' && entry.state == State::failed) {
+    out += ",\"args\":{\"error\":";
+    appendJsonString(out, entry.message);
+    out += "}";
+  }
+  out += "}";
+}
+
+} // namespace
+
+std::string SonarState::getTrace() {
+  const auto entries = getLogEntries();
+  std::string trace = "{\"traceEvents\":[";
+  for (const auto& entry : entries) {
+    appendTraceEvent(trace, entry, "b", entry.started);
+    appendTraceEvent(trace, entry, "e", entry.finished);
+  }
+  trace += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return trace;
+}
+
+void SonarState::incrementCounter(const std::string& name, int64_t delta) {
+  std::lock_guard<std::mutex> lock(countersMutex);
+  counters[name] += delta;
+}
+
+std::map<std::string, int64_t> SonarState::getCounters() {
+  std::lock_guard<std::mutex> lock(countersMutex);
+  auto result = counters;
+  for (const auto& source : counterSources) {
+    for (const auto& counter : source()) {
+      result[counter.first] += counter.second;
+    }
+  }
+  return result;
+}
+
+void SonarState::addCounterSource(
+    std::function<std::map<std::string, int64_t>()> source) {
+  std::lock_guard<std::mutex> lock(countersMutex);
+  counterSources.push_back(std::move(source));
 }
@@ -8,10 +8,19 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
+#include <array>
 #include <map>
+#include "SonarSteps.h"
 
 class SonarStep;
 class SonarStateUpdateListener;
@@ -28,6 +37,20 @@ public:
   State state_;
 };
 
+struct LogEntry {
+  std::string step;
+  State state;
+  std::chrono::system_clock::time_point time;
+  std::string message;
+  // When the step ran, on the monotonic clock traces are recorded with.
+  std::chrono::steady_clock::time_point started;
+  std::chrono::steady_clock::time_point finished;
+  uint64_t id;
+  // 0 for steps that aren't nested in another one.
+  uint64_t parentId;
+  uint64_t rootId;
+};
+
 }
 }
 
@@ -36,8 +59,17 @@ class SonarState {
 
  public:
   SonarState();
+  ~SonarState();
+
+  /* The listener is notified on a background thread, at most once per
+   kUpdateInterval however many steps change within it. */
   void setUpdateListener(std::shared_ptr<SonarStateUpdateListener>);
+  /* Increases with every change, so listeners can tell whether anything
+   changed since they last looked. */
+  uint64_t getVersion();
   std::string getState();
+  /* The most recent step results, oldest first. */
+  std::vector<facebook::sonar::LogEntry> getLogEntries();
   std::vector<facebook::sonar::StateElement> getStateElements();
 
   /* To record a state update, call start() with the name of the step to get a
@@ -46,13 +78,105 @@ class SonarState {
    step failure. */
   std::shared_ptr<SonarStep> start(std::string step);
 
+  /* Same as above for the well known steps in SonarSteps.h, which are
+   tracked without building their names. */
+  std::shared_ptr<SonarStep> start(facebook::sonar::SonarStepId step);
+  std::shared_ptr<SonarStep> start(
+      facebook::sonar::SonarStepId step,
+      std::string parameter);
+
+  /* The recent steps as a Chrome trace event JSON file, which Perfetto and
+   chrome://tracing can open. Timestamps are in microseconds of the monotonic
+   clock, so they line up with other traces recorded on the device. Nested
+   steps are shown inside their parents. */
+  std::string getTrace();
+
+  /* Counters track ongoing numeric metrics, such as bytes sent, alongside the
+   steps. They don't trigger state updates and may be incremented from any
+   thread. */
+  void incrementCounter(const std::string& name, int64_t delta = 1);
+  std::map<std::string, int64_t> getCounters();
+
+  /* Counters tracked elsewhere, polled by getCounters. */
+  void addCounterSource(
+      std::function<std::map<std::string, int64_t>()> source);
+
  private:
-  void success(std::string);
-  void failed(std::string, std::string);
-  void started(std::string);
+  std::shared_ptr<SonarStep> start(
+      facebook::sonar::SonarStepKey key,
+      const SonarStep* parent);
+  void success(const SonarStep& step);
+  void failed(const SonarStep& step, std::string errorMessage);
+  void started(const facebook::sonar::SonarStepKey& key);
+
+  /* A LogEntry as recorded, naming its step by key. Names are only built
+   when the log is read, so recording a step's result doesn't allocate. */
+  struct LogRecord {
+    facebook::sonar::SonarStepKey key;
+    facebook::sonar::State state;
+    std::chrono::system_clock::time_point time;
+    std::string message;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point finished;
+    uint64_t id;
+    uint64_t parentId;
+    uint64_t rootId;
+  };
+
+  /* Everything a reader can see, never modified once published. Writers copy
+   the current snapshot, apply their change and swap the copy in, retrying if
+   another writer got there first, so readers always see a consistent state
+   without taking a lock and writers never wait for readers. */
+  struct Snapshot {
+    std::vector<facebook::sonar::SonarStepKey> insertOrder;
+    // States of the steps that aren't parametrized, indexed by SonarStepId.
+    std::array<bool, facebook::sonar::kSonarStepCount> fixedSeen{};
+    std::array<facebook::sonar::State, facebook::sonar::kSonarStepCount>
+        fixedStates{};
+    // There are only a few of these, e.g. one per plugin, so they are
+    // searched linearly.
+    std::vector<
+        std::pair<facebook::sonar::SonarStepKey, facebook::sonar::State>>
+        parametrizedStates;
+    uint64_t version = 0;
+  };
+
+  void update(const std::function<void(Snapshot&)>& change);
+  std::shared_ptr<const Snapshot> getSnapshot() const;
+  void appendLog(LogRecord record);
+  static void setState(
+      Snapshot& snapshot,
+      const facebook::sonar::SonarStepKey& key,
+      facebook::sonar::State state);
+  static facebook::sonar::State stateOf(
+      const Snapshot& snapshot,
+      const facebook::sonar::SonarStepKey& key);
+
+  void scheduleNotification();
+  void runNotifications();
+
+  static constexpr size_t kMaxLogEntries = 256;
+  // Roughly one frame, so a burst of steps shows up as a single redraw.
+  static constexpr std::chrono::milliseconds kUpdateInterval{16};
 
   std::shared_ptr<SonarStateUpdateListener> mListener = nullptr;
-  std::string log;
-  std::vector<std::string> insertOrder;
-  std::map<std::string, facebook::sonar::State> stateMap;
+  std::shared_ptr<const Snapshot> snapshot;
+  std::atomic<uint64_t> nextStepId{1};
+
+  /* Ring buffer of the last kMaxLogEntries step results, written in place.
+   Once full, logNext is also the index of the oldest record. */
+  std::mutex logMutex;
+  std::array<LogRecord, kMaxLogEntries> log;
+  size_t logSize = 0;
+  size_t logNext = 0;
+
+  // Started with the first listener and stopped on destruction.
+  std::mutex notifyMutex;
+  std::condition_variable notifyCondition;
+  bool notificationPending = false;
+  bool stopping = false;
+  std::thread notifier;
+  std::mutex countersMutex;
+  std::map<std::string, int64_t> counters;
+  std::vector<std::function<std::map<std::string, int64_t>()>> counterSources;
 };
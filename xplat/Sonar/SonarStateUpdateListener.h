@@ -8,7 +8,18 @@
 
 #pragma once
 
+#include <cstdint>
+
 class SonarStateUpdateListener {
  public:
+  virtual ~SonarStateUpdateListener() {}
+
   virtual void onUpdate() = 0;
+
+  /* Called with the state's version when it changed. Listeners that keep the
+   version of the state they last rendered can skip unchanged state by
+   overriding this instead of onUpdate(). */
+  virtual void onVersionUpdate(uint64_t version) {
+    onUpdate();
+  }
 };
@@ -10,21 +10,34 @@
 
 void SonarStep::complete() {
   isLogged = true;
-  state->success(name);
+  state->success(*this);
 }
 
 void SonarStep::fail(std::string message) {
   isLogged = true;
-  state->failed(name, message);
+  state->failed(*this, message);
 }
 
-SonarStep::SonarStep(std::string step, SonarState* s) {
+std::shared_ptr<SonarStep> SonarStep::start(facebook::sonar::SonarStepId step) {
+  return state->start({step, nullptr}, this);
+}
+
+SonarStep::SonarStep(
+    facebook::sonar::SonarStepKey stepKey,
+    SonarState* s,
+    uint64_t stepId,
+    uint64_t parent,
+    uint64_t root)
+    : key(std::move(stepKey)),
+      id(stepId),
+      parentId(parent),
+      rootId(root),
+      startTime(std::chrono::steady_clock::now()) {
   state = s;
-  name = step;
 }
 
 SonarStep::~SonarStep() {
   if (!isLogged) {
-    state->failed(name, "");
+    state->failed(*this, "");
   }
 }
@@ -8,11 +8,17 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include "SonarSteps.h"
 
 class SonarState;
 
 class SonarStep {
+  friend SonarState;
+
  public:
   /* Mark this step as completed successfully
    * failing to call complete() will be registered as a failure
@@ -22,11 +28,25 @@ class SonarStep {
   // Mark the step as failed, and provide a message.
   void fail(std::string message);
 
-  SonarStep(std::string name, SonarState* state);
+  /* Start a step that is part of this one. It is shown nested inside this
+   * step in the exported trace. */
+  std::shared_ptr<SonarStep> start(facebook::sonar::SonarStepId step);
+
+  SonarStep(
+      facebook::sonar::SonarStepKey key,
+      SonarState* state,
+      uint64_t id,
+      uint64_t parentId,
+      uint64_t rootId);
   ~SonarStep();
 
  private:
-  std::string name;
+  facebook::sonar::SonarStepKey key;
   bool isLogged = false;
   SonarState* state;
+  uint64_t id;
+  uint64_t parentId;
+  // The outermost step this one is nested in, or its own id.
+  uint64_t rootId;
+  std::chrono::steady_clock::time_point startTime;
 };
@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ The steps SonarState knows about up front. Their state is kept in a fixed
+ array indexed by this enum, so recording one allocates nothing.
+ */
+enum class SonarStepId : uint8_t {
+  // Named at runtime, the parameter is the whole name.
+  custom,
+  createClient,
+  startClient,
+  stopClient,
+  addPlugin,
+  triggerOnDisconnected,
+  startConnectionThread,
+  connectToDesktop,
+  connectInsecurely,
+  connectSecurely,
+  connectLocally,
+  loadCertificates,
+  checkCertificates,
+  reuseCSR,
+  generateCSR,
+  loadCSR,
+  getCertFromDesktop,
+  sendFallbackCertificateRequest,
+  probeDesktop,
+  resolveDesktop,
+  loadWarmStart,
+  count,
+};
+
+struct SonarStepInfo {
+  SonarStepId id;
+  const char* name;
+  // Parametrized steps are tracked per parameter, e.g. per plugin, and shown
+  // with the parameter appended to name.
+  bool parametrized;
+};
+
+constexpr SonarStepInfo kSonarSteps[] = {
+    {SonarStepId::custom, "", true},
+    {SonarStepId::createClient, "Create client", false},
+    {SonarStepId::startClient, "Start client", false},
+    {SonarStepId::stopClient, "Stop client", false},
+    {SonarStepId::addPlugin, "Add plugin ", true},
+    {SonarStepId::triggerOnDisconnected,
+     "Trigger onDisconnected callbacks",
+     false},
+    {SonarStepId::startConnectionThread, "Start connection thread", false},
+    {SonarStepId::connectToDesktop, "Connect to desktop", false},
+    {SonarStepId::connectInsecurely, "Connect insecurely", false},
+    {SonarStepId::connectSecurely, "Connect securely", false},
+    {SonarStepId::connectLocally, "Connect over local transport", false},
+    {SonarStepId::loadCertificates, "Load certificates", false},
+    {SonarStepId::checkCertificates,
+     "Check required certificates are present",
+     false},
+    {SonarStepId::reuseCSR, "Reuse existing CSR", false},
+    {SonarStepId::generateCSR, "Generate CSR", false},
+    {SonarStepId::loadCSR, "Load CSR", false},
+    {SonarStepId::getCertFromDesktop, "Getting cert from desktop", false},
+    {SonarStepId::sendFallbackCertificateRequest,
+     "Sending fallback certificate request",
+     false},
+    {SonarStepId::probeDesktop, "Probe for desktop", false},
+    {SonarStepId::resolveDesktop, "Resolve desktop address", false},
+    {SonarStepId::loadWarmStart, "Load warm start cache", false},
+};
+
+constexpr size_t kSonarStepCount = static_cast<size_t>(SonarStepId::count);
+
+constexpr bool sonarStepsAreIndexedById() {
+  for (size_t i = 0; i < kSonarStepCount; i++) {
+    if (static_cast<size_t>(kSonarSteps[i].id) != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(
+    sizeof(kSonarSteps) / sizeof(kSonarSteps[0]) == kSonarStepCount,
+    "Every SonarStepId needs an entry in kSonarSteps");
+static_assert(
+    sonarStepsAreIndexedById(),
+    "kSonarSteps must be in the same order as SonarStepId");
+
+constexpr const SonarStepInfo& sonarStepInfo(SonarStepId id) {
+  return kSonarSteps[static_cast<size_t>(id)];
+}
+
+/**
+ Identifies a step, and the plugin or other parameter it is for if it is
+ parametrized. The parameter is shared, so copying a key allocates nothing.
+ */
+struct SonarStepKey {
+  SonarStepId id;
+  std::shared_ptr<const std::string> parameter;
+
+  bool operator==(const SonarStepKey& other) const {
+    return id == other.id &&
+        (parameter == other.parameter ||
+         (parameter && other.parameter && *parameter == *other.parameter));
+  }
+
+  std::string name() const {
+    std::string name = sonarStepInfo(id).name;
+    if (parameter) {
+      name += *parameter;
+    }
+    return name;
+  }
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarBase64.h>
+#include <folly/io/IOBuf.h>
+#include <folly/json.h>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ * SonarStreamResponder is used to respond to a message received from the
+ * Sonar desktop app with a sequence of chunks, instead of a single response.
+ * This lets large responses be sent while they are still being produced.
+ */
+class SonarStreamResponder {
+ public:
+  virtual ~SonarStreamResponder(){};
+
+  /**
+   * Deliver the next chunk of the response. Chunks are held until the Sonar
+   * desktop app is ready to receive them.
+   */
+  virtual void next(const folly::dynamic& chunk) = 0;
+
+  /**
+   * Deliver the next chunk as raw bytes. Over the socket they are sent as the
+   * chunk's metadata without being encoded, responders that can only carry
+   * JSON deliver them as {"base64": ...} instead.
+   */
+  virtual void nextBytes(std::unique_ptr<folly::IOBuf> chunk) {
+    next(folly::dynamic::object("base64", toBase64(chunk->coalesce())));
+  }
+
+  /**
+   * Inform the Sonar desktop app that the response is complete.
+   */
+  virtual void complete() = 0;
+
+  /**
+   * Inform the Sonar desktop app of an error in handling the request. No more
+   * chunks will be delivered after this.
+   */
+  virtual void error(const folly::dynamic& response) = 0;
+};
+
+} // namespace sonar
+} // namespace facebook
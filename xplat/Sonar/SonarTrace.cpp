@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarTrace.h"
+
+#if FB_SONAR_TRACING
+
+#include <atomic>
+#include <limits>
+
+#if defined(__ANDROID__)
+#include <android/trace.h>
+#elif defined(__APPLE__)
+#include <os/signpost.h>
+#endif
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+// Sampling compares a random draw against this threshold, so that deciding
+// to skip a span costs no more than a few instructions.
+std::atomic<uint32_t> samplingThreshold{std::numeric_limits<uint32_t>::max()};
+
+bool sampled() {
+  // xorshift32, seeded per thread. The state is never 0, so a threshold of 0
+  // samples nothing and the maximum samples everything.
+  static thread_local uint32_t state =
+      static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&state)) | 1;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state <= samplingThreshold.load(std::memory_order_relaxed);
+}
+
+#ifdef __APPLE__
+os_log_t traceLog() {
+  static os_log_t log = os_log_create("com.facebook.sonar", "Sonar");
+  return log;
+}
+#endif
+
+} // namespace
+
+void setTraceSamplingRate(double rate) {
+  const auto max = std::numeric_limits<uint32_t>::max();
+  uint32_t threshold = 0;
+  if (rate >= 1) {
+    threshold = max;
+  } else if (rate > 0) {
+    threshold = static_cast<uint32_t>(rate * max);
+  }
+  samplingThreshold.store(threshold, std::memory_order_relaxed);
+}
+
+SonarTraceSection::SonarTraceSection(const char* name) {
+#if defined(__ANDROID__)
+#if __ANDROID_API__ >= 23
+  if (ATrace_isEnabled() && sampled()) {
+    ATrace_beginSection(name);
+    active_ = true;
+  }
+#endif
+#elif defined(__APPLE__)
+  name_ = name;
+  if (__builtin_available(iOS 12.0, macOS 10.14, *)) {
+    if (os_signpost_enabled(traceLog()) && sampled()) {
+      signpostId_ = os_signpost_id_generate(traceLog());
+      os_signpost_interval_begin(
+          traceLog(), signpostId_, "Sonar", "%{public}s", name_);
+      active_ = true;
+    }
+  }
+#else
+  // No tracing facility on this platform.
+  (void)name;
+  (void)sampled;
+#endif
+}
+
+SonarTraceSection::~SonarTraceSection() {
+  if (!active_) {
+    return;
+  }
+#if defined(__ANDROID__)
+#if __ANDROID_API__ >= 23
+  ATrace_endSection();
+#endif
+#elif defined(__APPLE__)
+  if (__builtin_available(iOS 12.0, macOS 10.14, *)) {
+    os_signpost_interval_end(
+        traceLog(), signpostId_, "Sonar", "%{public}s", name_);
+  }
+#endif
+}
+
+} // namespace sonar
+} // namespace facebook
+
+#endif
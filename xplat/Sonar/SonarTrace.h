@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ Spans around the client's hot paths, shown as ATrace sections in systrace on
+ Android and as os_signpost intervals in Instruments on iOS. Build with
+ FB_SONAR_TRACING=1 to enable them; otherwise SONAR_TRACE_SECTION compiles to
+ nothing.
+ */
+#ifndef FB_SONAR_TRACING
+#define FB_SONAR_TRACING 0
+#endif
+
+namespace facebook {
+namespace sonar {
+
+#if FB_SONAR_TRACING
+
+/**
+ Fraction of spans that are recorded, from 0 (none) to 1 (all, the default).
+ Spans are only recorded while the platform's tracing is capturing.
+ */
+void setTraceSamplingRate(double rate);
+
+class SonarTraceSection {
+ public:
+  /**
+   name must outlive the section, typically it is a string literal.
+   */
+  explicit SonarTraceSection(const char* name);
+  ~SonarTraceSection();
+
+  SonarTraceSection(const SonarTraceSection&) = delete;
+  SonarTraceSection& operator=(const SonarTraceSection&) = delete;
+
+ private:
+  bool active_ = false;
+#ifdef __APPLE__
+  const char* name_;
+  uint64_t signpostId_ = 0;
+#endif
+};
+
+#define SONAR_TRACE_CONCAT_(a, b) a##b
+#define SONAR_TRACE_VARIABLE_(line) SONAR_TRACE_CONCAT_(sonarTraceSection, line)
+#define SONAR_TRACE_SECTION(name)   \
+  ::facebook::sonar::SonarTraceSection \
+  SONAR_TRACE_VARIABLE_(__LINE__)(name)
+
+#else
+
+inline void setTraceSamplingRate(double) {}
+
+#define SONAR_TRACE_SECTION(name) (void)0
+
+#endif
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,34 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarTransport.h"
+#include <rsocket/transports/tcp/TcpConnectionFactory.h>
+
+namespace facebook {
+namespace sonar {
+
+SonarTransportFactory localSocketTransport(std::string path) {
+  auto address = localSocketAddress(std::move(path));
+  return [address](folly::EventBase& eventBase) {
+    // AsyncSocket connects to Unix domain addresses just like TCP ones.
+    return std::make_unique<rsocket::TcpConnectionFactory>(eventBase, address);
+  };
+}
+
+folly::SocketAddress localSocketAddress(std::string path) {
+  if (!path.empty() && path[0] == '@') {
+    // Abstract socket names are marked by a leading NUL byte.
+    path[0] = '\0';
+  }
+  folly::SocketAddress address;
+  address.setFromPath(path);
+  return address;
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/io/async/EventBase.h>
+#include <rsocket/ConnectionFactory.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Creates the connection factory used to reach the desktop, on the given
+ connection event base. A transport set in SonarInitConfig replaces TCP with
+ mutual TLS: its connections are trusted as they are and no certificate
+ exchange takes place, so it must only be used for channels that are already
+ private to the device and the desktop.
+ */
+using SonarTransportFactory =
+    std::function<std::unique_ptr<rsocket::ConnectionFactory>(
+        folly::EventBase& eventBase)>;
+
+/**
+ Transport over a Unix domain socket, for setups where the desktop is reached
+ through a forwarded socket, e.g. `adb reverse localabstract:sonar tcp:8089`.
+ A path starting with '@' names a socket in Linux's abstract namespace.
+ */
+SonarTransportFactory localSocketTransport(std::string path);
+
+/**
+ The address of a Unix domain socket named as for localSocketTransport.
+ */
+folly::SocketAddress localSocketAddress(std::string path);
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,231 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarUrlFilter.h"
+
+#include <folly/String.h>
+#include <stdexcept>
+
+namespace facebook {
+namespace sonar {
+
+namespace {
+
+bool hasWildcard(const std::string& pattern) {
+  return pattern.find_first_of("*?") != std::string::npos;
+}
+
+std::string lowercase(folly::StringPiece text) {
+  std::string result = text.str();
+  folly::toLowerAscii(&result[0], result.size());
+  return result;
+}
+
+// Whether piece, in which ? matches any character, matches text at offset.
+bool matchesAt(
+    folly::StringPiece text,
+    size_t offset,
+    const std::string& piece) {
+  for (size_t i = 0; i < piece.size(); i++) {
+    if (piece[i] != '?' && piece[i] != text[offset + i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The first offset from start at which piece matches text, or npos.
+size_t find(folly::StringPiece text, size_t start, const std::string& piece) {
+  if (piece.find('?') == std::string::npos) {
+    return text.find(piece, start);
+  }
+  for (size_t offset = start; offset + piece.size() <= text.size();
+       offset++) {
+    if (matchesAt(text, offset, piece)) {
+      return offset;
+    }
+  }
+  return folly::StringPiece::npos;
+}
+
+std::vector<std::string> strings(
+    const folly::dynamic& params,
+    const char* name) {
+  std::vector<std::string> result;
+  const auto patterns = params.get_ptr(name);
+  if (!patterns || patterns->isNull()) {
+    return result;
+  }
+  if (!patterns->isArray()) {
+    throw std::invalid_argument(std::string(name) + " must be an array");
+  }
+  for (const auto& pattern : *patterns) {
+    if (!pattern.isString()) {
+      throw std::invalid_argument(std::string(name) + " must hold strings");
+    }
+    result.push_back(pattern.getString());
+  }
+  return result;
+}
+
+} // namespace
+
+SonarUrlFilter::Glob::Glob(const std::string& pattern)
+    : anchoredStart_(pattern.empty() || pattern.front() != '*'),
+      anchoredEnd_(pattern.empty() || pattern.back() != '*') {
+  std::string piece;
+  for (const char c : pattern) {
+    if (c != '*') {
+      piece.push_back(c);
+    } else if (!piece.empty()) {
+      pieces_.push_back(std::move(piece));
+      piece.clear();
+    }
+  }
+  if (!piece.empty() || pieces_.empty()) {
+    pieces_.push_back(std::move(piece));
+  }
+}
+
+bool SonarUrlFilter::Glob::matches(folly::StringPiece text) const {
+  size_t first = 0;
+  size_t last = pieces_.size();
+  size_t start = 0;
+  size_t end = text.size();
+  if (anchoredStart_) {
+    const auto& piece = pieces_.front();
+    if (piece.size() > text.size() || !matchesAt(text, 0, piece)) {
+      return false;
+    }
+    if (pieces_.size() == 1 && anchoredEnd_) {
+      return piece.size() == text.size();
+    }
+    start = piece.size();
+    first++;
+  }
+  if (anchoredEnd_ && first < last) {
+    const auto& piece = pieces_.back();
+    if (piece.size() > end - start ||
+        !matchesAt(text, end - piece.size(), piece)) {
+      return false;
+    }
+    end -= piece.size();
+    last--;
+  }
+  // Stars in between, the earliest match of each piece leaves the most room
+  // for the rest.
+  const auto middle = text.subpiece(0, end);
+  for (size_t i = first; i < last; i++) {
+    const auto found = find(middle, start, pieces_[i]);
+    if (found == folly::StringPiece::npos) {
+      return false;
+    }
+    start = found + pieces_[i].size();
+  }
+  return true;
+}
+
+SonarUrlFilter::Set::Set(
+    const std::vector<std::string>& patterns,
+    bool ignoreCase)
+    : ignoreCase_(ignoreCase) {
+  for (const auto& pattern : patterns) {
+    const auto compiled = ignoreCase ? lowercase(pattern) : pattern;
+    if (hasWildcard(compiled)) {
+      globs_.emplace_back(compiled);
+    } else {
+      exact_.insert(compiled);
+    }
+  }
+}
+
+bool SonarUrlFilter::Set::matches(folly::StringPiece text) const {
+  if (empty()) {
+    return false;
+  }
+  std::string lowered;
+  if (ignoreCase_) {
+    lowered = lowercase(text);
+    text = lowered;
+  }
+  if (!exact_.empty() && exact_.count(text.str())) {
+    return true;
+  }
+  for (const auto& glob : globs_) {
+    if (glob.matches(text)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SonarUrlFilter::Set::empty() const {
+  return exact_.empty() && globs_.empty();
+}
+
+SonarUrlFilter::SonarUrlFilter(const Patterns& patterns)
+    : includeUrls_(patterns.includeUrls, false),
+      excludeUrls_(patterns.excludeUrls, false),
+      includeHosts_(patterns.includeHosts, true),
+      excludeHosts_(patterns.excludeHosts, true) {}
+
+SonarUrlFilter::Patterns SonarUrlFilter::patternsFromDynamic(
+    const folly::dynamic& params) {
+  if (!params.isObject()) {
+    throw std::invalid_argument("URL filter must be an object");
+  }
+  Patterns patterns;
+  patterns.includeUrls = strings(params, "includeUrls");
+  patterns.excludeUrls = strings(params, "excludeUrls");
+  patterns.includeHosts = strings(params, "includeHosts");
+  patterns.excludeHosts = strings(params, "excludeHosts");
+  return patterns;
+}
+
+bool SonarUrlFilter::matches(folly::StringPiece url) const {
+  folly::StringPiece urlHost;
+  const bool hosts = !includeHosts_.empty() || !excludeHosts_.empty();
+  if (hosts) {
+    urlHost = host(url);
+  }
+  if (excludeUrls_.matches(url) || (hosts && excludeHosts_.matches(urlHost))) {
+    return false;
+  }
+  if (includeUrls_.empty() && includeHosts_.empty()) {
+    return true;
+  }
+  return includeUrls_.matches(url) || (hosts && includeHosts_.matches(urlHost));
+}
+
+bool SonarUrlFilter::empty() const {
+  return includeUrls_.empty() && excludeUrls_.empty() &&
+      includeHosts_.empty() && excludeHosts_.empty();
+}
+
+folly::StringPiece SonarUrlFilter::host(folly::StringPiece url) {
+  const auto scheme = url.find("://");
+  if (scheme == folly::StringPiece::npos) {
+    return folly::StringPiece();
+  }
+  auto authority = url.subpiece(scheme + 3);
+  authority = authority.subpiece(0, authority.find_first_of("/?#"));
+  const auto at = authority.rfind('@');
+  if (at != folly::StringPiece::npos) {
+    authority.advance(at + 1);
+  }
+  if (authority.startsWith('[')) {
+    // IPv6, its colons aren't a port.
+    const auto close = authority.find(']');
+    return close == folly::StringPiece::npos ? authority
+                                              : authority.subpiece(0, close + 1);
+  }
+  return authority.subpiece(0, authority.find(':'));
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Which requests the network plugins capture, as pushed by the desktop. A URL
+ is captured if it matches an include pattern, or there are none, and no
+ exclude pattern. Patterns are globs, in which * stands for any run of
+ characters and ? for any one. URL patterns are matched against the whole
+ URL, host patterns against its host, ignoring case.
+
+ Patterns are compiled once, into literal pieces found in order, and exact
+ hosts into a hash set, so that checking a URL costs about as much as
+ comparing it with each pattern. Immutable and so safe to use from any
+ thread.
+ */
+class SonarUrlFilter {
+ public:
+  struct Patterns {
+    std::vector<std::string> includeUrls;
+    std::vector<std::string> excludeUrls;
+    std::vector<std::string> includeHosts;
+    std::vector<std::string> excludeHosts;
+  };
+
+  explicit SonarUrlFilter(const Patterns& patterns);
+
+  /**
+   The patterns of params as the desktop sends them, each an optional array
+   of strings under the name of its Patterns member. Throws on anything else.
+   */
+  static Patterns patternsFromDynamic(const folly::dynamic& params);
+
+  // Whether requests to url are captured.
+  bool matches(folly::StringPiece url) const;
+
+  // Whether every URL is captured.
+  bool empty() const;
+
+  // The host of url, empty if it has none, e.g. "example.com" for
+  // "https://user@example.com:443/path".
+  static folly::StringPiece host(folly::StringPiece url);
+
+ private:
+  class Glob {
+   public:
+    explicit Glob(const std::string& pattern);
+    bool matches(folly::StringPiece text) const;
+
+   private:
+    // The literal runs between the stars, ? still in them. The first is
+    // anchored at the start unless the pattern starts with a star, the last
+    // at the end unless it ends with one.
+    std::vector<std::string> pieces_;
+    bool anchoredStart_;
+    bool anchoredEnd_;
+  };
+
+  class Set {
+   public:
+    Set(const std::vector<std::string>& patterns, bool ignoreCase);
+    bool matches(folly::StringPiece text) const;
+    bool empty() const;
+
+   private:
+    const bool ignoreCase_;
+    // Patterns without wildcards, most host patterns are.
+    std::unordered_set<std::string> exact_;
+    std::vector<Glob> globs_;
+  };
+
+  Set includeUrls_;
+  Set excludeUrls_;
+  Set includeHosts_;
+  Set excludeHosts_;
+};
+
+} // namespace sonar
+} // namespace facebook
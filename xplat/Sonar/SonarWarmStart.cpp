@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarWarmStart.h"
+#include <folly/String.h>
+#include <folly/json.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace facebook {
+namespace sonar {
+
+constexpr int SonarWarmStart::kVersion;
+
+folly::dynamic SonarWarmStart::toDynamic() const {
+  return folly::dynamic::object("version", kVersion)("host", host)(
+      "legacyCertificateRequest", legacyCertificateRequest)(
+      "capabilities", capabilities)("session", folly::hexlify(session))(
+      "certificates", certificates);
+}
+
+SonarWarmStart SonarWarmStart::fromDynamic(const folly::dynamic& value) {
+  SonarWarmStart warmStart;
+  if (!value.isObject() || value.getDefault("version") != kVersion) {
+    return warmStart;
+  }
+  try {
+    std::string session;
+    if (!folly::unhexlify(value.getDefault("session", "").asString(), session)) {
+      session.clear();
+    }
+    warmStart.host = value.getDefault("host", "").asString();
+    warmStart.legacyCertificateRequest =
+        value.getDefault("legacyCertificateRequest", false).asBool();
+    const auto& capabilities = value.getDefault("capabilities");
+    if (capabilities.isObject()) {
+      warmStart.capabilities = capabilities;
+    }
+    warmStart.session = std::move(session);
+    warmStart.certificates = value.getDefault("certificates", "").asString();
+  } catch (const folly::TypeError&) {
+    return SonarWarmStart();
+  }
+  return warmStart;
+}
+
+SonarWarmStart SonarWarmStart::load(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    return SonarWarmStart();
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  try {
+    return fromDynamic(folly::parseJson(contents.str()));
+  } catch (const std::exception&) {
+    return SonarWarmStart();
+  }
+}
+
+bool SonarWarmStart::save(const std::string& path) const {
+  const auto temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file << folly::toJson(toDynamic());
+    if (!file.flush()) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SonarWarmStart::operator==(const SonarWarmStart& other) const {
+  return host == other.host &&
+      legacyCertificateRequest == other.legacyCertificateRequest &&
+      capabilities == other.capabilities && session == other.session &&
+      certificates == other.certificates;
+}
+
+} // namespace sonar
+} // namespace facebook
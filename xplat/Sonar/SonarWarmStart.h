@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/dynamic.h>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ What connecting to the desktop last negotiated, kept in a small file in the
+ sonar directory so that the next launch starts from it instead of finding
+ it all out again: the host the desktop answered at, whether it only takes
+ the legacy certificate request, the capabilities it accepted and the TLS
+ session to resume. All of it is only used optimistically, whatever turns
+ out wrong is found out as it would be without the file.
+
+ Files of another version, or that can't be parsed, are ignored.
+ */
+struct SonarWarmStart {
+  static constexpr int kVersion = 1;
+
+  // The host the desktop answered at, empty if there was just the one.
+  std::string host;
+  bool legacyCertificateRequest = false;
+  // The params of the desktop's last setCapabilities, null before any.
+  folly::dynamic capabilities = nullptr;
+  // DER encoded, only valid with the certificate files identified by
+  // certificates, see SonarWebSocketImpl.
+  std::string session;
+  std::string certificates;
+
+  folly::dynamic toDynamic() const;
+
+  static SonarWarmStart fromDynamic(const folly::dynamic& value);
+
+  /**
+   Reads the file at path. Empty if there is none or it's ignored.
+   */
+  static SonarWarmStart load(const std::string& path);
+
+  /**
+   Writes the file at path, through a temporary file renamed over it so that
+   a crash never leaves half of one behind. Returns whether it did.
+   */
+  bool save(const std::string& path) const;
+
+  bool operator==(const SonarWarmStart& other) const;
+  bool operator!=(const SonarWarmStart& other) const {
+    return !(*this == other);
+  }
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarWatchdog.h"
+
+namespace facebook {
+namespace sonar {
+
+constexpr std::chrono::milliseconds SonarWatchdog::kCaptureTimeout;
+
+SonarWatchdog::SonarWatchdog(
+    std::chrono::milliseconds threshold,
+    SonarStackUnwinder unwinder,
+    Reporter reporter)
+    : threshold_(threshold),
+      unwinder_(unwinder),
+      reporter_(std::move(reporter)),
+      thread_([this]() { run(); }) {}
+
+SonarWatchdog::~SonarWatchdog() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+uint64_t SonarWatchdog::begin(const char* task) {
+  bool wake;
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = nextId_++;
+    tasks_.emplace(id, Task{task, pthread_self(), Clock::now()});
+    wake = idle_;
+    idle_ = false;
+  }
+  if (wake) {
+    condition_.notify_one();
+  }
+  return id;
+}
+
+void SonarWatchdog::end(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_.erase(id);
+}
+
+folly::dynamic SonarWatchdog::reports() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  folly::dynamic reports = folly::dynamic::array();
+  for (const auto& report : reports_) {
+    folly::dynamic stack = folly::dynamic::array();
+    for (const auto& frame : report.stack) {
+      stack.push_back(frame);
+    }
+    reports.push_back(folly::dynamic::object("task", report.task)(
+        "blockedMs", report.blockedFor.count())("stack", std::move(stack)));
+  }
+  return reports;
+}
+
+void SonarWatchdog::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    const auto now = Clock::now();
+    Task* overdue = nullptr;
+    auto next = Clock::time_point::max();
+    for (auto& iter : tasks_) {
+      auto& task = iter.second;
+      if (task.reported) {
+        continue;
+      }
+      const auto deadline = task.started + threshold_;
+      if (deadline <= now) {
+        overdue = &task;
+        break;
+      }
+      next = std::min(next, deadline);
+    }
+    if (!overdue) {
+      if (next == Clock::time_point::max()) {
+        idle_ = true;
+        condition_.wait(lock);
+      } else {
+        condition_.wait_until(lock, next);
+      }
+      continue;
+    }
+    overdue->reported = true;
+    const auto thread = overdue->thread;
+    Report report{
+        overdue->name,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - overdue->started),
+        {}};
+    // The task may end while its thread is interrupted, in which case the
+    // stack shows whatever it went on to do.
+    lock.unlock();
+    report.stack =
+        describeStack(captureThreadStack(thread, unwinder_, kCaptureTimeout));
+    reporter_(report);
+    lock.lock();
+    reports_.push_back(std::move(report));
+    if (reports_.size() > kMaxReports) {
+      reports_.pop_front();
+    }
+  }
+}
+
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarStackCapture.h>
+#include <folly/dynamic.h>
+#include <pthread.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+/**
+ Notices tasks, such as plugin receivers, that keep their thread busy for
+ longer than threshold, and reports each of them once with the stack of the
+ blocked thread. Tasks are tracked with a Scope around them. The watchdog's
+ thread sleeps until the oldest task would be overdue, and for good while
+ none are running. Safe to use from any thread.
+ */
+class SonarWatchdog {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Report {
+    std::string task;
+    std::chrono::milliseconds blockedFor;
+    // Innermost frame first, see describeStack. Empty if it couldn't be
+    // captured.
+    std::vector<std::string> stack;
+  };
+
+  // Called on the watchdog's thread.
+  using Reporter = std::function<void(const Report&)>;
+
+  /**
+   Tracks the enclosing scope as a task named task, running on the calling
+   thread. Does nothing without a watchdog.
+   */
+  class Scope {
+   public:
+    Scope(SonarWatchdog* watchdog, const char* task)
+        : watchdog_(watchdog), id_(watchdog ? watchdog->begin(task) : 0) {}
+
+    ~Scope() {
+      if (watchdog_) {
+        watchdog_->end(id_);
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    SonarWatchdog* watchdog_;
+    uint64_t id_;
+  };
+
+  SonarWatchdog(
+      std::chrono::milliseconds threshold,
+      SonarStackUnwinder unwinder,
+      Reporter reporter);
+
+  ~SonarWatchdog();
+
+  uint64_t begin(const char* task);
+  void end(uint64_t id);
+
+  // The latest reports, oldest first, for the diagnostics plugin.
+  folly::dynamic reports() const;
+
+ private:
+  static constexpr size_t kMaxReports = 16;
+  static constexpr std::chrono::milliseconds kCaptureTimeout{100};
+
+  struct Task {
+    const char* name;
+    pthread_t thread;
+    Clock::time_point started;
+    bool reported = false;
+  };
+
+  void run();
+
+  const std::chrono::milliseconds threshold_;
+  const SonarStackUnwinder unwinder_;
+  const Reporter reporter_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::unordered_map<uint64_t, Task> tasks_;
+  uint64_t nextId_ = 1;
+  // Set while the thread waits without a deadline, so that only then
+  // beginning a task has to wake it.
+  bool idle_ = false;
+  bool stopping_ = false;
+  std::deque<Report> reports_;
+  // Declared last, so that it starts once everything it uses is initialized.
+  std::thread thread_;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -8,7 +8,15 @@
 
 #pragma once
 
+#include <Sonar/SonarMemoryBudget.h>
+#include <Sonar/SonarRawJson.h>
+#include <Sonar/SonarReply.h>
+#include <Sonar/SonarStreamResponder.h>
+#include <folly/io/IOBuf.h>
 #include <folly/json.h>
+#include <map>
+#include <memory>
+#include <string>
 
 namespace facebook {
 namespace sonar {
@@ -36,11 +44,86 @@ class SonarWebSocket {
    */
   virtual bool isOpen() const = 0;
 
+  /**
+   Called when the device's network connectivity changes. Any pending
+   reconnect is retried right away instead of waiting out its backoff.
+   */
+  virtual void connectivityChanged() = 0;
+
+  /**
+   Called when the app goes to the background or comes back. Sockets may
+   hold events back and lengthen their keepalive while in the background,
+   and send what they held back once in the foreground again.
+   */
+  virtual void setInBackground(bool background) {}
+
+  /**
+   Release what the socket holds as level asks, see SonarMemoryPressure.
+   Returns the bytes released.
+   */
+  virtual size_t onMemoryPressure(SonarMemoryPressure level) {
+    return 0;
+  }
+
   /**
    Send message to the ws server.
    */
   virtual void sendMessage(const folly::dynamic& message) = 0;
 
+  /**
+   Send message to the ws server, taking ownership of it instead of copying.
+   */
+  virtual void sendMessage(folly::dynamic&& message) {
+    sendMessage(static_cast<const folly::dynamic&>(message));
+  }
+
+  /**
+   Send a message that has already been serialized to JSON. The buffer is
+   handed to the transport as is.
+   */
+  virtual void sendSerialized(std::unique_ptr<folly::IOBuf> message) = 0;
+
+  /**
+   Same as above for a message sent by plugin, so that it counts towards the
+   plugin's queue quota and memory.
+   */
+  virtual void sendSerialized(
+      std::unique_ptr<folly::IOBuf> message,
+      const std::string& plugin) {
+    sendSerialized(std::move(message));
+  }
+
+  /**
+   Whether messages currently go out as JSON, so that serializing them
+   before sendSerialized costs nothing over sendMessage.
+   */
+  virtual bool sendsJson() const {
+    return true;
+  }
+
+  /**
+   Send a response to the desktop that has already been serialized to JSON.
+   Responses may go out ahead of queued events.
+   */
+  virtual void sendSerializedResponse(std::unique_ptr<folly::IOBuf> message) {
+    sendSerialized(std::move(message));
+  }
+
+  /**
+   Messages dropped so far because the send queue was full, by plugin.
+   */
+  virtual std::map<std::string, size_t> droppedMessages() const {
+    return {};
+  }
+
+  /**
+   The last frames of the previous session, as left by a crash or a kill,
+   null if there are none.
+   */
+  virtual folly::dynamic previousSessionFrames() const {
+    return nullptr;
+  }
+
   /**
    Handler for connection and message receipt from the ws server.
    The callbacks should be set before a connection is established.
@@ -57,6 +140,30 @@ class SonarWebSocket::Callbacks {
   virtual void onDisconnected() = 0;
 
   virtual void onMessageReceived(const folly::dynamic& message) = 0;
+
+  /**
+   Called instead of onMessageReceived for messages that arrive as JSON, so
+   that only the parts needed to route them have to be parsed.
+   */
+  virtual void onRawMessageReceived(const SonarRawJson& message) {
+    onMessageReceived(message.parse());
+  }
+
+  /**
+   Called for calls the desktop made as a request-response. They carry no
+   id, the response completes the call through reply.
+   */
+  virtual void onRequestReceived(
+      const folly::dynamic& message,
+      std::shared_ptr<SonarReply> reply) = 0;
+
+  /**
+   Called for messages the desktop expects a streamed response to. Chunks
+   are delivered through responder.
+   */
+  virtual void onStreamRequested(
+      const folly::dynamic& message,
+      std::shared_ptr<SonarStreamResponder> responder) = 0;
 };
 
 } // namespace sonar
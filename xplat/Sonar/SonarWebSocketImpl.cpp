@@ -8,20 +8,38 @@
 
 #include "SonarWebSocketImpl.h"
 #include "SonarStep.h"
+#include <folly/Optional.h>
 #include <folly/String.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/executors/thread_factory/PriorityThreadFactory.h>
+#include <folly/experimental/bser/Bser.h>
+#include <folly/io/Cursor.h>
 #include <folly/futures/Future.h>
+#include <folly/io/async/AsyncSocket.h>
 #include <folly/io/async/SSLContext.h>
 #include <folly/json.h>
 #include <rsocket/Payload.h>
 #include <rsocket/RSocket.h>
+#include <rsocket/resumption/WarmResumeManager.h>
 #include <rsocket/transports/tcp/TcpConnectionFactory.h>
+#include <yarpl/Flowable.h>
+#include <yarpl/Single.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <thread>
 #include <folly/io/async/AsyncSocketException.h>
 #include "CertificateUtils.h"
+#include "CompressionUtils.h"
+#include "SonarConnectionFactory.h"
+#include "SonarJsonParser.h"
+#include "SonarKeepalive.h"
+#include "SonarResponseStream.h"
+#include "SonarJsonWriter.h"
+#include "SonarRSocketStats.h"
+#include "SonarTrace.h"
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -35,19 +53,161 @@
 #define SONAR_CA_FILE_NAME "sonarCA.crt"
 #define CLIENT_CERT_FILE_NAME "device.crt"
 #define PRIVATE_KEY_FILE "privateKey.pem"
+#define WARM_START_FILE_NAME "warmStart.json"
 #define WRONG_THREAD_EXIT_MSG \
   "ERROR: Aborting sonar initialization because it's not running in the sonar thread."
 
-static constexpr int reconnectIntervalSeconds = 2;
-static constexpr int connectionKeepaliveSeconds = 10;
 static constexpr int securePort = 8088;
 static constexpr int insecurePort = 8089;
+// Dormant clients give up on reaching the desktop after this long.
+static constexpr int probeTimeoutMs = 2000;
+// Batched frames are flushed at the end of the event loop iteration, or
+// earlier once they grow past this size.
+static constexpr size_t maxBatchBytes = 64 * 1024;
+// Messages estimated to serialize larger than this are encoded off the sonar
+// thread so they don't hold up everyone else's sends.
+static constexpr size_t parallelSerializationThreshold = 256 * 1024;
+static constexpr size_t serializationThreads = 2;
+// Events sent per turn of the sonar thread, so responses queued during a
+// flood of events don't wait for all of them.
+static constexpr size_t maxEventsPerDrain = 100;
+// Frames at least this large are compressed, unless the desktop asks for a
+// different threshold when enabling compression.
+static constexpr size_t defaultCompressionThreshold = 16 * 1024;
 
 namespace facebook {
 namespace sonar {
 
 bool fileExists(std::string fileName);
 
+// Rough estimate of the JSON size of value, which stops walking the tree as
+// soon as the estimate passes limit.
+static void addEstimatedSize(
+    const folly::dynamic& value,
+    size_t limit,
+    size_t& size) {
+  switch (value.type()) {
+    case folly::dynamic::STRING:
+      size += value.getString().size() + 2;
+      break;
+    case folly::dynamic::ARRAY:
+      size += value.size() + 2;
+      for (const auto& element : value) {
+        if (size > limit) {
+          return;
+        }
+        addEstimatedSize(element, limit, size);
+      }
+      break;
+    case folly::dynamic::OBJECT:
+      size += value.size() * 2 + 2;
+      for (const auto& item : value.items()) {
+        if (size > limit) {
+          return;
+        }
+        addEstimatedSize(item.first, limit, size);
+        addEstimatedSize(item.second, limit, size);
+      }
+      break;
+    default:
+      size += 8;
+      break;
+  }
+}
+
+static bool isLargerThan(const folly::dynamic& value, size_t limit) {
+  size_t size = 0;
+  addEstimatedSize(value, limit, size);
+  return size > limit;
+}
+
+// Plugin an outgoing message belongs to, for enforcing send queue quotas.
+static std::string pluginOf(const folly::dynamic& message) {
+  if (!message.isObject()) {
+    return "";
+  }
+  const auto params = message.get_ptr("params");
+  if (!params || !params->isObject()) {
+    return "";
+  }
+  const auto api = params->get_ptr("api");
+  return api && api->isString() ? api->getString() : "";
+}
+
+// Responses to the desktop's requests carry the request's id.
+static bool isResponse(const folly::dynamic& message) {
+  return message.isObject() && message.count("id");
+}
+
+// Wraps the string in an IOBuf without copying its contents.
+static std::unique_ptr<folly::IOBuf> toIOBuf(std::string&& data) {
+  auto* owned = new std::string(std::move(data));
+  return folly::IOBuf::takeOwnership(
+      &(*owned)[0],
+      owned->size(),
+      [](void*, void* userData) { delete static_cast<std::string*>(userData); },
+      owned);
+}
+
+// BSER frames start with a zero byte, JSON frames never do.
+static bool isBser(const folly::IOBuf& data) {
+  folly::io::Cursor cursor(&data);
+  return cursor.canAdvance(1) && cursor.read<uint8_t>() == 0;
+}
+
+static void inflateIfDeflated(rsocket::Payload& frame) {
+  if (frame.data && isDeflated(*frame.data)) {
+    frame.data = inflateFrame(*frame.data);
+  }
+}
+
+static folly::dynamic parseFrame(rsocket::Payload& frame) {
+  inflateIfDeflated(frame);
+  if (frame.data && isBser(*frame.data)) {
+    return folly::bser::parseBser(frame.data.get());
+  }
+  return sonarParseJson(frame.moveDataToString());
+}
+
+// Checks whether the desktop is listening with a plain TCP connection, closed
+// as soon as it is established. Deletes itself once done, done is called with
+// the error if the connection failed. Runs on evb.
+class DesktopProbe : public folly::AsyncSocket::ConnectCallback {
+ public:
+  using Done = std::function<void(folly::exception_wrapper)>;
+
+  static void
+  start(folly::EventBase* evb, folly::SocketAddress address, Done done) {
+    evb->runInEventBaseThread(
+        [evb, address = std::move(address), done = std::move(done)]() {
+          auto probe = new DesktopProbe(std::move(done));
+          probe->socket_.reset(new folly::AsyncSocket(evb));
+          probe->socket_->connect(probe, address, probeTimeoutMs);
+        });
+  }
+
+  void connectSuccess() noexcept override {
+    socket_->closeNow();
+    finish(nullptr);
+  }
+
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override {
+    finish(folly::make_exception_wrapper<folly::AsyncSocketException>(ex));
+  }
+
+ private:
+  explicit DesktopProbe(Done done) : done_(std::move(done)) {}
+
+  void finish(folly::exception_wrapper error) {
+    auto done = std::move(done_);
+    delete this;
+    done(std::move(error));
+  }
+
+  Done done_;
+  folly::AsyncSocket::UniquePtr socket_;
+};
+
 class ConnectionEvents : public rsocket::RSocketConnectionEvents {
  private:
   SonarWebSocketImpl* websocket_;
@@ -56,58 +216,382 @@ class ConnectionEvents : public rsocket::RSocketConnectionEvents {
   ConnectionEvents(SonarWebSocketImpl* websocket) : websocket_(websocket) {}
 
   void onConnected() {
-    websocket_->isOpen_ = true;
-    if (websocket_->connectionIsTrusted_) {
-      websocket_->callbacks_->onConnected();
-    }
+    websocket_->runFromConnection([websocket = websocket_]() {
+      if (websocket->resuming_) {
+        // The session resumed, plugins never saw it go.
+        return;
+      }
+      websocket->isOpen_ = true;
+      if (websocket->connectionIsTrusted_) {
+        websocket->callbacks_->onConnected();
+      }
+    });
   }
 
   void onDisconnected(const folly::exception_wrapper&) {
-    if (!websocket_->isOpen_)
+    websocket_->runFromConnection([websocket = websocket_]() {
+      if (!websocket->isOpen_ || websocket->resuming_)
+        return;
+      if (websocket->connectionIsTrusted_ &&
+          websocket->resumeBufferBytes_ > 0) {
+        // The session's streams are paused, not closed, plugins stay
+        // connected while it resumes.
+        websocket->resuming_ = true;
+        websocket->sonarEventBase_->runInEventBaseThread(
+            [websocket]() { websocket->resumeSession(); });
+        return;
+      }
+      websocket->connectionLost();
+    });
+  }
+
+  void onClosed(const folly::exception_wrapper&) {
+    websocket_->runFromConnection(
+        [websocket = websocket_]() { websocket->connectionLost(); });
+  }
+};
+
+// The response to a requestResponse from the desktop. All state is only
+// touched on the connection event base.
+class ResponseSingle : public yarpl::single::Single<rsocket::Payload> {
+ private:
+  class Subscription : public yarpl::single::SingleSubscription {
+   public:
+    Subscription(std::shared_ptr<ResponseSingle> single)
+        : single_(std::move(single)) {}
+
+    void cancel() override {
+      single_->observer_ = nullptr;
+      if (single_->finished_) {
+        return;
+      }
+      single_->finished_ = true;
+      single_->cancelled_ = true;
+      if (auto handler = std::move(single_->cancelHandler_)) {
+        handler();
+      }
+    }
+
+   private:
+    std::shared_ptr<ResponseSingle> single_;
+  };
+
+ public:
+  ResponseSingle(SonarWebSocketImpl* websocket) : websocket_(websocket) {}
+
+  void subscribe(
+      std::shared_ptr<yarpl::single::SingleObserver<rsocket::Payload>>
+          observer) override {
+    observer_ = observer;
+    observer->onSubscribe(std::make_shared<Subscription>(self()));
+    deliver();
+  }
+
+  void finish(rsocket::Payload payload, bool error) {
+    eventBase()->runInEventBaseThread(
+        [single = self(), payload = std::move(payload), error]() mutable {
+          if (single->finished_) {
+            return;
+          }
+          single->finished_ = true;
+          single->result_ = std::move(payload);
+          single->error_ = error;
+          single->deliver();
+        });
+  }
+
+  void setCancelHandler(std::function<void()> handler) {
+    eventBase()->runInEventBaseThread(
+        [single = self(), handler = std::move(handler)]() mutable {
+          if (single->cancelled_) {
+            handler();
+          } else if (!single->finished_) {
+            single->cancelHandler_ = std::move(handler);
+          }
+        });
+  }
+
+ private:
+  SonarWebSocketImpl* websocket_;
+  std::shared_ptr<yarpl::single::SingleObserver<rsocket::Payload>> observer_;
+  folly::Optional<rsocket::Payload> result_;
+  bool error_ = false;
+  bool finished_ = false;
+  bool cancelled_ = false;
+  std::function<void()> cancelHandler_;
+
+  std::shared_ptr<ResponseSingle> self() {
+    return this->ref_from_this(this);
+  }
+
+  folly::EventBase* eventBase() {
+    return websocket_->connectionEventBase_->getEventBase();
+  }
+
+  void deliver() {
+    if (!observer_ || !result_) {
       return;
-    websocket_->isOpen_ = false;
-    if (websocket_->connectionIsTrusted_) {
-      websocket_->connectionIsTrusted_ = false;
-      websocket_->callbacks_->onDisconnected();
     }
-    websocket_->reconnect();
+    auto observer = std::move(observer_);
+    auto payload = std::move(*result_);
+    result_ = folly::none;
+    cancelHandler_ = nullptr;
+    if (error_) {
+      observer->onError(
+          folly::make_exception_wrapper<rsocket::ErrorWithPayload>(
+              std::move(payload)));
+    } else {
+      observer->onSuccess(std::move(payload));
+    }
   }
+};
+
+// Responses to requestResponse are always JSON, the desktop reads them as
+// they are rather than as one of its messages.
+class SingleReply : public SonarReply {
+ public:
+  SingleReply(std::shared_ptr<ResponseSingle> single)
+      : single_(std::move(single)) {}
 
-  void onClosed(const folly::exception_wrapper& e) {
-    onDisconnected(e);
+  void success(const folly::dynamic& response) override {
+    single_->finish(rsocket::Payload(toIOBuf(sonarToJson(response))), false);
   }
+
+  void successSerialized(std::unique_ptr<folly::IOBuf> response) override {
+    single_->finish(rsocket::Payload(std::move(response)), false);
+  }
+
+  void error(const folly::dynamic& response) override {
+    single_->finish(rsocket::Payload(folly::toJson(response)), true);
+  }
+
+  void setCancelHandler(std::function<void()> handler) override {
+    single_->setCancelHandler(std::move(handler));
+  }
+
+ private:
+  std::shared_ptr<ResponseSingle> single_;
 };
 
 class Responder : public rsocket::RSocketResponder {
  private:
   SonarWebSocketImpl* websocket_;
 
+  // Malformed messages are left for the client to report.
+  static std::string rawMethod(const SonarRawJson& message) {
+    try {
+      return SonarRawJson::field(message.fields(), "method").asString();
+    } catch (std::exception&) {
+      return "";
+    }
+  }
+
  public:
   Responder(SonarWebSocketImpl* websocket) : websocket_(websocket) {}
 
   void handleFireAndForget(
       rsocket::Payload request,
       rsocket::StreamId streamId) {
-    const auto payload = request.moveDataToString();
-    websocket_->callbacks_->onMessageReceived(folly::parseJson(payload));
+    inflateIfDeflated(request);
+    const auto& recorder = websocket_->recorder_;
+    const auto& flightRecorder = websocket_->flightRecorder_;
+    if (request.data && isBser(*request.data)) {
+      auto message = folly::bser::parseBser(request.data.get());
+      if (websocket_->handleTransportMessage(message)) {
+        return;
+      }
+      if (recorder) {
+        recorder->record(
+            SonarSessionRecorder::Direction::inbound,
+            false,
+            folly::toJson(message));
+      }
+      const auto method = message.getDefault("method");
+      if (flightRecorder) {
+        flightRecorder->record(
+            SonarFlightRecorder::Direction::inbound,
+            method.isString() ? method.stringPiece() : folly::StringPiece(),
+            *request.data);
+      }
+      websocket_->runPrioritized(
+          method.isString() ? method.stringPiece() : folly::StringPiece(),
+          request.data->computeChainDataLength(),
+          [websocket = websocket_, message = std::move(message)]() {
+            websocket->callbacks_->onMessageReceived(message);
+          });
+      return;
+    }
+    // JSON frames are passed on unparsed, the client only reads what it
+    // needs to route them.
+    auto message = SonarRawJson::fromString(request.moveDataToString());
+    if (websocket_->handleTransportMessage(message)) {
+      return;
+    }
+    if (recorder) {
+      recorder->record(
+          SonarSessionRecorder::Direction::inbound, false, message.json());
+    }
+    const auto method = rawMethod(message);
+    if (flightRecorder) {
+      flightRecorder->record(
+          SonarFlightRecorder::Direction::inbound,
+          method,
+          message.json().size(),
+          message.json());
+    }
+    websocket_->runPrioritized(
+        method,
+        message.json().size(),
+        [websocket = websocket_, message = std::move(message)]() {
+          websocket->callbacks_->onRawMessageReceived(message);
+        });
+  }
+
+  std::shared_ptr<yarpl::single::Single<rsocket::Payload>>
+  handleRequestResponse(rsocket::Payload request, rsocket::StreamId streamId) {
+    inflateIfDeflated(request);
+    const size_t bytes =
+        request.data ? request.data->computeChainDataLength() : 0;
+    if (websocket_->flightRecorder_ && request.data) {
+      websocket_->flightRecorder_->record(
+          SonarFlightRecorder::Direction::inbound, "", *request.data);
+    }
+    auto message = parseFrame(request);
+    if (websocket_->recorder_) {
+      websocket_->recorder_->record(
+          SonarSessionRecorder::Direction::inbound,
+          false,
+          folly::toJson(message));
+    }
+    auto single = std::make_shared<ResponseSingle>(websocket_);
+    const auto method = message.getDefault("method");
+    websocket_->runPrioritized(
+        method.isString() ? method.stringPiece() : folly::StringPiece(),
+        bytes,
+        [websocket = websocket_,
+         message = std::move(message),
+         reply = std::make_shared<SingleReply>(single)]() {
+          websocket->callbacks_->onRequestReceived(message, reply);
+        });
+    return single;
+  }
+
+  std::shared_ptr<yarpl::flowable::Flowable<rsocket::Payload>>
+  handleRequestStream(rsocket::Payload request, rsocket::StreamId streamId) {
+    if (websocket_->flightRecorder_ && request.data) {
+      websocket_->flightRecorder_->record(
+          SonarFlightRecorder::Direction::inbound, "", *request.data);
+    }
+    auto message = parseFrame(request);
+    if (websocket_->recorder_) {
+      websocket_->recorder_->record(
+          SonarSessionRecorder::Direction::inbound,
+          true,
+          folly::toJson(message));
+    }
+    auto stream = std::make_shared<SonarResponseStream>(
+        websocket_->connectionEventBase_,
+        [websocket = websocket_](const folly::dynamic& chunk) {
+          return websocket->encode(chunk);
+        });
+    websocket_->runFromConnection(
+        [websocket = websocket_,
+         message = std::move(message),
+         responder = stream->responder()]() {
+          websocket->callbacks_->onStreamRequested(message, responder);
+        });
+    return stream;
   }
 };
 
-SonarWebSocketImpl::SonarWebSocketImpl(SonarInitConfig config, std::shared_ptr<SonarState> state)
-    : deviceData_(config.deviceData), sonarState_(state), sonarEventBase_(config.callbackWorker), connectionEventBase_(config.connectionWorker) {}
+SonarWebSocketImpl::SonarWebSocketImpl(
+    SonarInitConfig config,
+    std::shared_ptr<SonarState> state,
+    std::shared_ptr<SonarMemoryBudget> budget)
+    : deviceData_(config.deviceData),
+      resolver_(desktopHosts(config)),
+      sonarState_(state),
+      sonarEventBase_(config.callbackWorker),
+      connectionEventBase_(
+          config.connectionWorker ? config.connectionWorker
+                                  : config.callbackWorker),
+      sharedEventBase_(connectionEventBase_ == sonarEventBase_),
+      // Responses are never refused or dropped, the desktop waits for them.
+      // They all count as plugin "", so a quota would be shared by all.
+      responses_(SIZE_MAX, OverflowPolicy::dropNewest),
+      events_(
+          config.maxQueuedMessagesPerPlugin,
+          config.overflowPolicy,
+          std::move(budget),
+          config.sendWeights),
+      pauseEventsInBackground_(config.pauseEventsInBackground),
+      keepalive_(config.keepalive),
+      backgroundKeepalive_(config.backgroundKeepalive),
+      keepalivePolicy_(std::make_shared<SonarKeepalivePolicy>(
+          config.keepalive,
+          config.backgroundKeepalive)),
+      inbound_(config.inboundWeights),
+      certificateKeyType_(config.certificateKeyType),
+      pregenerateCertificateKey_(config.pregenerateCertificateKey),
+      dormant_(config.dormantUntilReachable),
+      backoff_(
+          SonarBackoff::kDefaultInitialDelay,
+          config.idleReconnectInterval.count() > 0
+              ? config.idleReconnectInterval
+              : SonarBackoff::kDefaultMaxDelay),
+      resumeBufferBytes_(config.resumeBufferBytes),
+      resumeWindow_(config.resumeWindow),
+      transportStats_(std::make_shared<SonarRSocketStats>()),
+      transport_(config.transport) {
+  if (!config.sessionRecordingPath.empty()) {
+    try {
+      recorder_ =
+          std::make_unique<SonarSessionRecorder>(config.sessionRecordingPath);
+    } catch (std::exception& e) {
+      // The session goes on without being recorded.
+      SONAR_LOG(e.what());
+    }
+  }
+  if (!config.flightRecorderPath.empty()) {
+    try {
+      flightRecorder_ = std::make_unique<SonarFlightRecorder>(
+          config.flightRecorderPath, config.flightRecorderFrames);
+    } catch (std::exception& e) {
+      SONAR_LOG(e.what());
+    }
+  }
+  std::weak_ptr<SonarRSocketStats> stats = transportStats_;
+  sonarState_->addCounterSource([stats]() {
+    const auto strong = stats.lock();
+    return strong ? strong->counters() : std::map<std::string, int64_t>();
+  });
+}
 
 SonarWebSocketImpl::~SonarWebSocketImpl() {
   stop();
 }
 
 void SonarWebSocketImpl::start() {
-  auto step = sonarState_->start("Start connection thread");
+  if (!dormant_) {
+    pregenerateKeyIfNeeded();
+  }
+  auto step = sonarState_->start(SonarStepId::startConnectionThread);
   folly::makeFuture()
       .via(sonarEventBase_->getEventBase())
       .delayed(std::chrono::milliseconds(0))
       .thenValue([this, step](auto&&){ step->complete(); startSync(); });
 }
 
+static std::vector<std::string> desktopHosts(const SonarInitConfig& config) {
+  std::vector<std::string> hosts{config.deviceData.host};
+  for (const auto& host : config.hostCandidates) {
+    if (std::find(hosts.begin(), hosts.end(), host) == hosts.end()) {
+      hosts.push_back(host);
+    }
+  }
+  return hosts;
+}
+
 void SonarWebSocketImpl::startSync() {
   if (!isRunningInOwnThread()) {
     SONAR_LOG(WRONG_THREAD_EXIT_MSG);
@@ -117,72 +601,325 @@ void SonarWebSocketImpl::startSync() {
     SONAR_LOG("Already connected");
     return;
   }
-  auto connect = sonarState_->start("Connect to desktop");
+  if (connectionState_ != ConnectionState::disconnected) {
+    SONAR_LOG("Already connecting");
+    return;
+  }
+  if (!warmStartLoaded_) {
+    loadWarmStart();
+  }
+  if (dormant_ && !(transport_ && !localTransportUnavailable_)) {
+    probeDesktop();
+    return;
+  }
+  auto connect = sonarState_->start(SonarStepId::connectToDesktop);
   try {
+    if (transport_ && !localTransportUnavailable_) {
+      // A local transport is trusted as is, no certificates involved.
+      connectLocally(connect);
+      return;
+    }
     if (isCertificateExchangeNeeded()) {
-      doCertificateExchange();
+      resolveDesktop(
+          connect, insecurePort, [this, connect](folly::SocketAddress address) {
+            doCertificateExchange(connect, std::move(address));
+          });
       return;
     }
 
-    connectSecurely();
-    connect->complete();
-  } catch (const folly::AsyncSocketException& e) {
-    if (e.getType() == folly::AsyncSocketException::NOT_OPEN) {
-      // The expected code path when flipper desktop is not running.
-      // Don't count as a failed attempt.
-      connect->fail("Port not open");
-    } else {
-      SONAR_LOG(e.what());
-      failedConnectionAttempts_++;
-      connect->fail(e.what());
-    }
-    reconnect();
+    resolveDesktop(
+        connect, securePort, [this, connect](folly::SocketAddress address) {
+          connectSecurely(connect, std::move(address));
+        });
   } catch (const std::exception& e) {
-    SONAR_LOG(e.what());
-    connect->fail(e.what());
+    connectionFailed(
+        connect, folly::exception_wrapper(std::current_exception(), e));
+  }
+}
+
+void SonarWebSocketImpl::loadWarmStart() {
+  auto step = sonarState_->start(SonarStepId::loadWarmStart);
+  warmStartLoaded_ = true;
+  warmStart_ = SonarWarmStart::load(absoluteFilePath(WARM_START_FILE_NAME));
+  // The desktop is likely where it was, skip racing the hosts. If it moved,
+  // the failed connection forgets the host as usual.
+  if (!warmStart_.host.empty() && !resolver_.prefer(warmStart_.host)) {
+    warmStart_.host.clear();
+  }
+  savedWarmStart_ = warmStart_;
+  step->complete();
+}
+
+void SonarWebSocketImpl::saveWarmStart() {
+  if (warmStart_ == savedWarmStart_) {
+    return;
+  }
+  if (!ensureSonarDirExists() ||
+      !warmStart_.save(absoluteFilePath(WARM_START_FILE_NAME))) {
+    SONAR_LOG("Unable to save the warm start cache");
+    return;
+  }
+  savedWarmStart_ = warmStart_;
+}
+
+std::string SonarWebSocketImpl::certificatesKey(
+    const std::vector<FileStamp>& stamps) {
+  std::string key;
+  for (const auto& stamp : stamps) {
+    key += folly::to<std::string>(
+        stamp.exists, ":", stamp.modified, ":", stamp.size, ";");
+  }
+  return key;
+}
+
+void SonarWebSocketImpl::pregenerateKeyIfNeeded() {
+  if (pregenerateCertificateKey_ && !transport_ &&
+      !fileExists(absoluteFilePath(PRIVATE_KEY_FILE))) {
+    pregenerateKey();
+  }
+}
+
+void SonarWebSocketImpl::probeDesktop() {
+  auto probing = sonarState_->start(SonarStepId::probeDesktop);
+  setConnectionState(ConnectionState::probing);
+  const auto probed = [this, probing](folly::exception_wrapper error) {
+    setConnectionState(ConnectionState::disconnected);
+    if (error) {
+      // Not counted as a failed attempt, nothing is wrong with the
+      // certificates.
+      probing->fail(error.what().toStdString());
+      resolver_.forgetPreferred();
+      reconnect();
+      return;
+    }
+    probing->complete();
+    dormant_ = false;
+    reconnectAttempts_ = 0;
+    pregenerateKeyIfNeeded();
+    startSync();
+  };
+  // With several hosts, racing them already probes the desktop.
+  const bool raced = resolver_.hosts().size() > 1 && !resolver_.preferredHost();
+  resolver_
+      .resolve(
+          connectionEventBase_->getEventBase(),
+          insecurePort,
+          std::chrono::milliseconds(probeTimeoutMs))
+      .via(sonarEventBase_->getEventBase())
+      .thenValue([this, raced, probed](folly::SocketAddress address) {
+        if (raced) {
+          probed(nullptr);
+          return;
+        }
+        DesktopProbe::start(
+            connectionEventBase_->getEventBase(),
+            std::move(address),
+            [this, probed](folly::exception_wrapper error) {
+              sonarEventBase_->getEventBase()->runInEventBaseThread(
+                  [probed, error]() { probed(error); });
+            });
+      })
+      .onError([probed](folly::exception_wrapper error) { probed(error); });
+}
+
+void SonarWebSocketImpl::resolveDesktop(
+    std::shared_ptr<SonarStep> connect,
+    uint16_t port,
+    folly::Function<void(folly::SocketAddress)> then) {
+  setConnectionState(ConnectionState::resolving);
+  auto resolving = connect->start(SonarStepId::resolveDesktop);
+  resolver_
+      .resolve(
+          connectionEventBase_->getEventBase(),
+          port,
+          std::chrono::milliseconds(probeTimeoutMs))
+      .via(sonarEventBase_->getEventBase())
+      .thenValue([resolving, then = std::move(then)](
+                     folly::SocketAddress address) mutable {
+        resolving->complete();
+        then(std::move(address));
+      })
+      .onError([this, connect](folly::exception_wrapper error) {
+        connectionFailed(connect, error);
+      });
+}
+
+void SonarWebSocketImpl::connectionFailed(
+    std::shared_ptr<SonarStep> connect,
+    const folly::exception_wrapper& error) {
+  const bool localTransportFailed =
+      connectionState_ == ConnectionState::connectingLocally;
+  setConnectionState(ConnectionState::disconnected);
+  // Race the hosts again, another one may be reachable by now.
+  resolver_.forgetPreferred();
+  const bool handled = error.with_exception(
+      [&](const folly::AsyncSocketException& e) {
+        if (e.getType() == folly::AsyncSocketException::NOT_OPEN) {
+          // The expected code path when flipper desktop is not running.
+          // Don't count as a failed attempt.
+          connect->fail("Port not open");
+          return;
+        }
+        SONAR_LOG(e.what());
+        connect->fail(e.what());
+        // Only a rejected handshake means our certificates are bad. Timeouts
+        // and resets just mean the network is flaky, and a new certificate
+        // exchange wouldn't help.
+        if (e.getType() == folly::AsyncSocketException::SSL_ERROR) {
+          failedConnectionAttempts_++;
+        }
+      });
+  if (!handled) {
+    // Anything else, such as unreadable certificate files, is also fixed by
+    // a new exchange.
+    const auto message = error.what().toStdString();
+    SONAR_LOG(message.c_str());
+    connect->fail(message);
     failedConnectionAttempts_++;
-    reconnect();
   }
+  if (localTransportFailed) {
+    // The local transport isn't there, e.g. the desktop doesn't offer it.
+    // Fall back to TCP and TLS straight away, until connectivity changes.
+    SONAR_LOG("Local transport unavailable, falling back to TCP");
+    localTransportUnavailable_ = true;
+    scheduleReconnect(true);
+    return;
+  }
+  reconnect();
 }
 
-void SonarWebSocketImpl::doCertificateExchange() {
+void SonarWebSocketImpl::doCertificateExchange(
+    std::shared_ptr<SonarStep> connect,
+    folly::SocketAddress address) {
 
   rsocket::SetupParameters parameters;
-  folly::SocketAddress address;
 
   parameters.payload = rsocket::Payload(
       folly::toJson(folly::dynamic::object("os", deviceData_.os)(
           "device", deviceData_.device)("app", deviceData_.app)));
-  address.setFromHostPort(deviceData_.host, insecurePort);
 
-  auto connectingInsecurely = sonarState_->start("Connect insecurely");
+  setConnectionState(ConnectionState::connectingInsecurely);
+  auto connectingInsecurely = connect->start(SonarStepId::connectInsecurely);
   connectionIsTrusted_ = false;
-  client_ =
-      rsocket::RSocket::createConnectedClient(
-          std::make_unique<rsocket::TcpConnectionFactory>(
-              *connectionEventBase_->getEventBase(), std::move(address)),
-          std::move(parameters),
-          nullptr,
-          std::chrono::seconds(connectionKeepaliveSeconds), // keepaliveInterval
-          nullptr, // stats
-          std::make_shared<ConnectionEvents>(this))
-          .get();
-  connectingInsecurely->complete();
-
-  ensureSonarDirExists();
-  requestSignedCertFromSonar();
-}
-
-void SonarWebSocketImpl::connectSecurely() {
+  rsocket::RSocket::createConnectedClient(
+      std::make_unique<rsocket::TcpConnectionFactory>(
+          *connectionEventBase_->getEventBase(), std::move(address)),
+      std::move(parameters),
+      nullptr,
+      keepaliveInterval(),
+      transportStats_,
+      std::make_shared<ConnectionEvents>(this))
+      .via(sonarEventBase_->getEventBase())
+      .thenValue([this, connectingInsecurely](
+                     std::unique_ptr<rsocket::RSocketClient> client) {
+        client_ = std::move(client);
+        connectingInsecurely->complete();
+        setConnectionState(ConnectionState::exchangingCertificate);
+        ensureSonarDirExists();
+        requestSignedCertFromSonar();
+      })
+      .onError([this, connect](folly::exception_wrapper e) {
+        connectionFailed(connect, e);
+      });
+}
+
+void SonarWebSocketImpl::connectSecurely(
+    std::shared_ptr<SonarStep> connect,
+    folly::SocketAddress address) {
+  auto sslContext = getSSLContext();
+
+  setConnectionState(ConnectionState::connectingSecurely);
+  connectTrusted(
+      std::move(connect),
+      std::make_unique<SonarConnectionFactory>(
+          *connectionEventBase_->getEventBase(),
+          std::move(address),
+          std::move(sslContext),
+          tlsSessions_,
+          sonarState_,
+          transportStats_),
+      SonarStepId::connectSecurely);
+}
+
+void SonarWebSocketImpl::connectLocally(std::shared_ptr<SonarStep> connect) {
+  setConnectionState(ConnectionState::connectingLocally);
+  connectTrusted(
+      std::move(connect),
+      transport_(*connectionEventBase_->getEventBase()),
+      SonarStepId::connectLocally);
+}
+
+void SonarWebSocketImpl::connectTrusted(
+    std::shared_ptr<SonarStep> connect,
+    std::unique_ptr<rsocket::ConnectionFactory> connectionFactory,
+    SonarStepId step) {
   rsocket::SetupParameters parameters;
-  folly::SocketAddress address;
   parameters.payload = rsocket::Payload(folly::toJson(folly::dynamic::object(
       "os", deviceData_.os)("device", deviceData_.device)(
-      "device_id", deviceData_.deviceId)("app", deviceData_.app)));
-  address.setFromHostPort(deviceData_.host, securePort);
+      "device_id", deviceData_.deviceId)("app", deviceData_.app)(
+      "capabilities", capabilities())));
+  // Capabilities are renegotiated for every connection.
+  setBatchingEnabled(false);
+  bserEnabled_ = false;
+  compressionThreshold_ = 0;
+  capabilitiesNegotiated_ = false;
 
-  std::shared_ptr<folly::SSLContext> sslContext =
-      std::make_shared<folly::SSLContext>();
+  if (resumeBufferBytes_ > 0) {
+    parameters.resumable = true;
+    parameters.token = rsocket::ResumeIdentificationToken::generateNew();
+  }
+
+  auto connecting = connect->start(step);
+  connectionIsTrusted_ = true;
+  // The connection sends keepalives as the traffic on it allows, see
+  // SonarKeepalive.
+  rsocket::RSocket::createConnectedClient(
+      std::make_unique<SonarKeepaliveConnectionFactory>(
+          std::move(connectionFactory), keepalivePolicy_, transportStats_),
+      std::move(parameters),
+      std::make_shared<Responder>(this),
+      std::chrono::seconds(0),
+      transportStats_,
+      std::make_shared<ConnectionEvents>(this),
+      resumeBufferBytes_ > 0 ? std::make_shared<rsocket::WarmResumeManager>(
+                                   transportStats_, resumeBufferBytes_)
+                             : nullptr)
+      .via(sonarEventBase_->getEventBase())
+      .thenValue([this, connect, connecting, step](
+                     std::unique_ptr<rsocket::RSocketClient> client) {
+        client_ = std::move(client);
+        connecting->complete();
+        connect->complete();
+        failedConnectionAttempts_ = 0;
+        reconnectAttempts_ = 0;
+        legacyRequestAssumed_ = false;
+        setConnectionState(ConnectionState::connected);
+        if (step != SonarStepId::connectLocally && tlsSessions_) {
+          // Having resumed the session, this is the desktop that accepted
+          // the saved capabilities, use them until it sends its own.
+          if (tlsSessions_->resumed() && !capabilitiesNegotiated_ &&
+              warmStart_.capabilities.isObject()) {
+            applyCapabilities(warmStart_.capabilities);
+          }
+          const auto host = resolver_.preferredHost();
+          warmStart_.host = host ? *host : "";
+          warmStart_.session = tlsSessions_->encoded();
+          warmStart_.certificates = certificatesKey(sslContextStamps_);
+          saveWarmStart();
+        }
+      })
+      .onError([this, connect](folly::exception_wrapper e) {
+        connectionFailed(connect, e);
+      });
+}
+
+std::shared_ptr<folly::SSLContext> SonarWebSocketImpl::getSSLContext() {
+  auto stamps = certificateStamps();
+  if (sslContext_ && stamps == sslContextStamps_) {
+    return sslContext_;
+  }
+  auto step = sonarState_->start(SonarStepId::loadCertificates);
+  auto sslContext = std::make_shared<folly::SSLContext>();
   sslContext->loadTrustedCertificates(
       absoluteFilePath(SONAR_CA_FILE_NAME).c_str());
   sslContext->setVerificationOption(
@@ -191,53 +928,534 @@ void SonarWebSocketImpl::connectSecurely() {
       absoluteFilePath(CLIENT_CERT_FILE_NAME).c_str(),
       absoluteFilePath(PRIVATE_KEY_FILE).c_str());
   sslContext->authenticate(true, false);
+  step->complete();
+  sslContext_ = sslContext;
+  sslContextStamps_ = std::move(stamps);
+  tlsSessions_ = std::make_shared<SonarTLSSessionCache>();
+  // The session saved by the previous launch is only valid with the same
+  // certificates.
+  if (!warmStart_.session.empty() &&
+      warmStart_.certificates == certificatesKey(sslContextStamps_)) {
+    tlsSessions_->setEncoded(warmStart_.session);
+  }
+  return sslContext;
+}
 
-  auto connectingSecurely = sonarState_->start("Connect securely");
-  connectionIsTrusted_ = true;
-  client_ =
-      rsocket::RSocket::createConnectedClient(
-          std::make_unique<rsocket::TcpConnectionFactory>(
-              *connectionEventBase_->getEventBase(),
-              std::move(address),
-              std::move(sslContext)),
-          std::move(parameters),
-          std::make_shared<Responder>(this),
-          std::chrono::seconds(connectionKeepaliveSeconds), // keepaliveInterval
-          nullptr, // stats
-          std::make_shared<ConnectionEvents>(this))
-          .get();
-  connectingSecurely->complete();
-  failedConnectionAttempts_ = 0;
+std::vector<SonarWebSocketImpl::FileStamp>
+SonarWebSocketImpl::certificateStamps() {
+  std::vector<FileStamp> stamps;
+  for (const auto fileName :
+       {SONAR_CA_FILE_NAME, CLIENT_CERT_FILE_NAME, PRIVATE_KEY_FILE}) {
+    FileStamp stamp;
+    struct stat info;
+    if (stat(absoluteFilePath(fileName).c_str(), &info) == 0) {
+      stamp.exists = true;
+      stamp.modified = info.st_mtime;
+      stamp.size = info.st_size;
+    }
+    stamps.push_back(stamp);
+  }
+  return stamps;
 }
 
-void SonarWebSocketImpl::reconnect() {
-  folly::makeFuture()
+void SonarWebSocketImpl::certificateExchangeCompleted() {
+  sonarEventBase_->getEventBase()->runInEventBaseThread([this]() {
+    setConnectionState(ConnectionState::disconnected);
+    // The desktop wrote new certificates, don't trust the cached context even
+    // if their timestamps happen to match.
+    sslContext_ = nullptr;
+    tlsSessions_ = nullptr;
+    scheduleReconnect(true);
+  });
+}
+
+void SonarWebSocketImpl::connectionClosed() {
+  sonarEventBase_->getEventBase()->runInEventBaseThread(
+      [this]() { setConnectionState(ConnectionState::disconnected); });
+}
+
+void SonarWebSocketImpl::connectionLost() {
+  if (!isOpen_) {
+    return;
+  }
+  isOpen_ = false;
+  resuming_ = false;
+  if (connectionIsTrusted_) {
+    connectionIsTrusted_ = false;
+    callbacks_->onDisconnected();
+  }
+  connectionClosed();
+  reconnect();
+}
+
+void SonarWebSocketImpl::resumeSession() {
+  if (!client_) {
+    // Stopped in the meantime.
+    resuming_ = false;
+    return;
+  }
+  client_->resume()
       .via(sonarEventBase_->getEventBase())
-      .delayed(std::chrono::seconds(reconnectIntervalSeconds))
-      .thenValue([this](auto&&){ startSync(); });
+      .within(resumeWindow_)
+      .thenValue([this](folly::Unit) {
+        resuming_ = false;
+        sonarState_->incrementCounter("Sessions resumed");
+        // Send what was held back meanwhile.
+        drainSendQueue();
+      })
+      .onError([this](folly::exception_wrapper e) {
+        SONAR_LOG(
+            ("Couldn't resume the session: " + e.what().toStdString())
+                .c_str());
+        sonarState_->incrementCounter("Sessions not resumed");
+        client_ = nullptr;
+        connectionLost();
+      });
+}
+
+void SonarWebSocketImpl::setConnectionState(ConnectionState state) {
+  const auto now = std::chrono::steady_clock::now();
+  if (connectionState_ != ConnectionState::disconnected) {
+    // Accumulate how long connections spend in each state, so slow
+    // handshakes show up alongside the connection steps.
+    sonarState_->incrementCounter(
+        std::string("Time ") + connectionStateName(connectionState_) +
+            " (ms)",
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - connectionStateSince_)
+            .count());
+  }
+  connectionState_ = state;
+  connectionStateSince_ = now;
+}
+
+const char* SonarWebSocketImpl::connectionStateName(ConnectionState state) {
+  switch (state) {
+    case ConnectionState::disconnected:
+      return "disconnected";
+    case ConnectionState::probing:
+      return "probing";
+    case ConnectionState::resolving:
+      return "resolving";
+    case ConnectionState::connectingInsecurely:
+      return "connecting insecurely";
+    case ConnectionState::exchangingCertificate:
+      return "exchanging certificate";
+    case ConnectionState::connectingSecurely:
+      return "connecting securely";
+    case ConnectionState::connectingLocally:
+      return "connecting locally";
+    case ConnectionState::connected:
+      return "connected";
+  }
+  return "unknown";
+}
+
+void SonarWebSocketImpl::reconnect() {
+  scheduleReconnect(false);
+}
+
+void SonarWebSocketImpl::connectivityChanged() {
+  resolver_.clear();
+  sonarEventBase_->getEventBase()->runInEventBaseThread([this]() {
+    reconnectAttempts_ = 0;
+    localTransportUnavailable_ = false;
+    if (!isOpen()) {
+      scheduleReconnect(true);
+    }
+  });
+}
+
+void SonarWebSocketImpl::setInBackground(bool background) {
+  inBackground_ = background;
+  keepalivePolicy_->setInBackground(background);
+  if (!pauseEventsInBackground_) {
+    return;
+  }
+  if (background) {
+    eventsPaused_ = true;
+    return;
+  }
+  if (eventsPaused_.exchange(false)) {
+    // Send what was held back.
+    sonarEventBase_->add([this]() { drainSendQueue(); });
+  }
+}
+
+size_t SonarWebSocketImpl::onMemoryPressure(SonarMemoryPressure level) {
+  if (level < SonarMemoryPressure::critical) {
+    return 0;
+  }
+  // Reported to the desktop as dropped with the next drain. Responses are
+  // small, and someone is waiting on them.
+  return events_.queue.discard();
+}
+
+std::chrono::seconds SonarWebSocketImpl::keepaliveInterval() const {
+  // Applies to the whole connection, one made in the background keeps the
+  // longer keepalive once in the foreground. Only used for the certificate
+  // exchange, trusted connections adapt theirs.
+  return inBackground_ ? backgroundKeepalive_ : keepalive_;
+}
+
+void SonarWebSocketImpl::scheduleReconnect(bool immediately) {
+  sonarEventBase_->getEventBase()->runInEventBaseThread([this, immediately]() {
+    const auto delay =
+        immediately ? std::chrono::milliseconds(0) : nextReconnectDelay();
+    const auto deadline = std::chrono::steady_clock::now() + delay;
+    if (reconnectPending_ && reconnectDeadline_ <= deadline) {
+      return;
+    }
+    if (!immediately) {
+      reconnectAttempts_++;
+    }
+    reconnectPending_ = true;
+    reconnectDeadline_ = deadline;
+    folly::makeFuture()
+        .via(sonarEventBase_->getEventBase())
+        .delayed(delay)
+        .thenValue([this, deadline](auto&&) {
+          if (!reconnectPending_ || reconnectDeadline_ != deadline) {
+            // Superseded by an earlier reconnect.
+            return;
+          }
+          reconnectPending_ = false;
+          startSync();
+        });
+  });
+}
+
+std::chrono::milliseconds SonarWebSocketImpl::nextReconnectDelay() {
+  return backoff_.delay(reconnectAttempts_);
 }
 
 void SonarWebSocketImpl::stop() {
-  client_->disconnect();
+  if (client_) {
+    client_->disconnect();
+  }
   client_ = nullptr;
+  resuming_ = false;
 }
 
 bool SonarWebSocketImpl::isOpen() const {
   return isOpen_ && connectionIsTrusted_;
 }
 
+bool SonarWebSocketImpl::sendsJson() const {
+  return !bserEnabled_;
+}
+
 void SonarWebSocketImpl::setCallbacks(Callbacks* callbacks) {
   callbacks_ = callbacks;
 }
 
 void SonarWebSocketImpl::sendMessage(const folly::dynamic& message) {
-  sonarEventBase_->add([this, message]() {
+  SONAR_TRACE_SECTION("SonarWebSocket::sendMessage");
+  // Serialize on the calling thread rather than deep copying the message
+  // into the queue.
+  enqueue(
+      isResponse(message) ? responses_ : events_,
+      {pluginOf(message), nullptr, encode(message)});
+}
+
+void SonarWebSocketImpl::sendMessage(folly::dynamic&& message) {
+  SONAR_TRACE_SECTION("SonarWebSocket::sendMessage");
+  auto& lane = isResponse(message) ? responses_ : events_;
+  auto plugin = pluginOf(message);
+  enqueue(lane, {std::move(plugin), std::move(message), nullptr});
+}
+
+void SonarWebSocketImpl::sendSerialized(std::unique_ptr<folly::IOBuf> message) {
+  enqueue(events_, {"", nullptr, std::move(message)});
+}
+
+void SonarWebSocketImpl::sendSerialized(
+    std::unique_ptr<folly::IOBuf> message,
+    const std::string& plugin) {
+  enqueue(events_, {plugin, nullptr, std::move(message)});
+}
+
+void SonarWebSocketImpl::sendSerializedResponse(
+    std::unique_ptr<folly::IOBuf> message) {
+  enqueue(responses_, {"", nullptr, std::move(message)});
+}
+
+std::map<std::string, size_t> SonarWebSocketImpl::droppedMessages() const {
+  std::lock_guard<std::mutex> lock(droppedMutex_);
+  return droppedTotals_;
+}
+
+folly::dynamic SonarWebSocketImpl::previousSessionFrames() const {
+  if (!flightRecorder_ || flightRecorder_->previousFrames().empty()) {
+    return nullptr;
+  }
+  return SonarFlightRecorder::toDynamic(flightRecorder_->previousFrames());
+}
+
+void SonarWebSocketImpl::enqueue(
+    SendLane& lane,
+    SonarSendQueue::Entry entry) {
+  // Events held back in the background mustn't block their sender until the
+  // app comes back.
+  const bool mayBlock = !isRunningInOwnThread() &&
+      !(&lane == &events_ && eventsPaused_.load(std::memory_order_relaxed));
+  if (lane.queue.push(std::move(entry), mayBlock)) {
+    sonarEventBase_->add([this]() { drainSendQueue(); });
+  }
+}
+
+void SonarWebSocketImpl::drainSendQueue() {
+  if (resuming_) {
+    // Queued until the session has resumed.
+    return;
+  }
+  auto responses = responses_.queue.drain();
+  // Events go out in slices, taking turns between plugins, so responses and
+  // quieter plugins aren't held back by a flood. The rest stays queued,
+  // within the queue's limits.
+  SonarSendQueue::Drained events;
+  // Once paused, the events queue isn't drained again, and doesn't schedule
+  // another drain, until resumed.
+  const bool eventsPaused = eventsPaused_.load();
+  if (!eventsPaused) {
+    // Without a client, everything is let go at once.
+    events = events_.queue.drain(client_ ? maxEventsPerDrain : SIZE_MAX);
+  }
+  if (!client_) {
+    return;
+  }
+
+  auto dropped = std::move(responses.dropped);
+  for (const auto& count : events.dropped) {
+    dropped[count.first] += count.second;
+  }
+  if (!dropped.empty()) {
+    folly::dynamic counts = folly::dynamic::object();
+    size_t total = 0;
+    {
+      std::lock_guard<std::mutex> lock(droppedMutex_);
+      for (const auto& count : dropped) {
+        droppedTotals_[count.first] += count.second;
+      }
+    }
+    for (const auto& count : dropped) {
+      counts[count.first] = count.second;
+      total += count.second;
+    }
+    sonarState_->incrementCounter("Messages dropped", total);
+    sendQueued(
+        events_,
+        {"",
+         folly::dynamic::object("method", "messagesDropped")(
+             "params", std::move(counts)),
+         nullptr});
+  }
+
+  for (auto& entry : responses.entries) {
+    sendQueued(responses_, std::move(entry));
+  }
+  for (auto& entry : events.entries) {
+    sendQueued(events_, std::move(entry));
+  }
+  if (events.more) {
+    sonarEventBase_->add([this]() { drainSendQueue(); });
+  }
+}
+
+void SonarWebSocketImpl::sendQueued(
+    SendLane& lane,
+    SonarSendQueue::Entry entry) {
+  const auto sequence = lane.nextSendSequence++;
+  if (entry.data) {
+    sendInOrder(lane, sequence, std::move(entry.data));
+    return;
+  }
+  if (!isLargerThan(entry.message, parallelSerializationThreshold)) {
+    sendInOrder(lane, sequence, encode(entry.message));
+    return;
+  }
+  serializationExecutor()->add(
+      [this, &lane, sequence, message = std::move(entry.message)]() {
+        auto data = encode(message);
+        sonarEventBase_->add(
+            [this, &lane, sequence, data = std::move(data)]() mutable {
+              sendInOrder(lane, sequence, std::move(data));
+            });
+      });
+}
+
+void SonarWebSocketImpl::sendInOrder(
+    SendLane& lane,
+    uint64_t sequence,
+    std::unique_ptr<folly::IOBuf> data) {
+  if (sequence == lane.nextSentSequence && lane.outOfOrder.empty()) {
+    lane.nextSentSequence++;
+    if (client_) {
+      sendEncoded(lane, std::move(data));
+    }
+    return;
+  }
+  // An earlier message is still being serialized, hold on to this one.
+  lane.outOfOrder.emplace(sequence, std::move(data));
+  while (!lane.outOfOrder.empty() &&
+         lane.outOfOrder.begin()->first == lane.nextSentSequence) {
+    auto next = std::move(lane.outOfOrder.begin()->second);
+    lane.outOfOrder.erase(lane.outOfOrder.begin());
+    lane.nextSentSequence++;
     if (client_) {
-      client_->getRequester()
-          ->fireAndForget(rsocket::Payload(folly::toJson(message)))
-          ->subscribe([]() {});
+      sendEncoded(lane, std::move(next));
     }
+  }
+}
+
+folly::Executor* SonarWebSocketImpl::serializationExecutor() {
+  if (!serializationExecutor_) {
+    serializationExecutor_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+        serializationThreads,
+        std::make_shared<folly::NamedThreadFactory>("SonarSerialize"));
+  }
+  return serializationExecutor_.get();
+}
+
+std::unique_ptr<folly::IOBuf> SonarWebSocketImpl::encode(
+    const folly::dynamic& message) {
+  SONAR_TRACE_SECTION("SonarWebSocket::encode");
+  if (bserEnabled_) {
+    return folly::bser::toBserIOBuf(
+        message, folly::bser::serialization_opts());
+  }
+  return toIOBuf(sonarToJson(message));
+}
+
+void SonarWebSocketImpl::sendEncoded(
+    SendLane& lane,
+    std::unique_ptr<folly::IOBuf> data) {
+  if (&lane == &responses_) {
+    // Responses don't wait for a batch of events to fill up.
+    sendFrame(std::move(data));
+    return;
+  }
+  // Batches are JSON arrays, BSER frames go out on their own.
+  if (batchingEnabled_ && !isBser(*data)) {
+    sendBatched(std::move(data));
+  } else {
+    flushBatch();
+    sendFrame(std::move(data));
+  }
+}
+
+void SonarWebSocketImpl::recordFrame(
+    SonarSessionRecorder::Direction direction,
+    bool stream,
+    const folly::IOBuf& data) {
+  if (isBser(data)) {
+    recorder_->record(
+        direction, stream, folly::toJson(folly::bser::parseBser(&data)));
+    return;
+  }
+  const auto coalesced = data.cloneCoalescedAsValue();
+  recorder_->record(
+      direction,
+      stream,
+      folly::StringPiece(
+          reinterpret_cast<const char*>(coalesced.data()), coalesced.length()));
+}
+
+void SonarWebSocketImpl::sendFrame(std::unique_ptr<folly::IOBuf> data) {
+  if (recorder_) {
+    // As the desktop will read it, batches are recorded as one frame.
+    recordFrame(SonarSessionRecorder::Direction::outbound, false, *data);
+  }
+  if (flightRecorder_) {
+    flightRecorder_->record(SonarFlightRecorder::Direction::outbound, "", *data);
+  }
+  if (compressionThreshold_ > 0) {
+    const auto length = data->computeChainDataLength();
+    if (length >= compressionThreshold_) {
+      data = deflateFrame(*data);
+      sonarState_->incrementCounter("Frame bytes before compression", length);
+      sonarState_->incrementCounter(
+          "Frame bytes after compression", data->computeChainDataLength());
+    }
+  }
+  client_->getRequester()
+      ->fireAndForget(rsocket::Payload(std::move(data)))
+      ->subscribe([]() {});
+}
+
+void SonarWebSocketImpl::sendBatched(std::unique_ptr<folly::IOBuf> data) {
+  pendingBatch_.append(pendingBatch_.empty() ? "[" : ",");
+  pendingBatch_.append(std::move(data));
+  if (pendingBatch_.chainLength() >= maxBatchBytes) {
+    flushBatch();
+  } else if (!batchFlushScheduled_) {
+    batchFlushScheduled_ = true;
+    sonarEventBase_->runInLoop([this]() {
+      batchFlushScheduled_ = false;
+      flushBatch();
+    });
+  }
+}
+
+void SonarWebSocketImpl::flushBatch() {
+  if (pendingBatch_.empty()) {
+    return;
+  }
+  pendingBatch_.append("]");
+  auto batch = pendingBatch_.move();
+  if (client_) {
+    sendFrame(std::move(batch));
+  }
+}
+
+void SonarWebSocketImpl::setBatchingEnabled(bool enabled) {
+  if (!enabled) {
+    flushBatch();
+  }
+  batchingEnabled_ = enabled;
+}
+
+folly::dynamic SonarWebSocketImpl::capabilities() {
+  return folly::dynamic::object("batching", true)("bser", true)(
+      "compression", "deflate");
+}
+
+bool SonarWebSocketImpl::handleTransportMessage(const SonarRawJson& message) {
+  const auto method = SonarRawJson::field(message.fields(), "method");
+  if (method.parse() != "setCapabilities") {
+    return false;
+  }
+  return handleTransportMessage(message.parse());
+}
+
+bool SonarWebSocketImpl::handleTransportMessage(const folly::dynamic& message) {
+  if (message.getDefault("method") != "setCapabilities") {
+    return false;
+  }
+  const auto params =
+      message.getDefault("params", folly::dynamic::object());
+  // Takes effect for the very next message.
+  bserEnabled_ = params.getDefault("bser", false).asBool();
+  sonarEventBase_->add([this, params]() {
+    applyCapabilities(params);
+    capabilitiesNegotiated_ = true;
+    warmStart_.capabilities = params;
+    saveWarmStart();
   });
+  return true;
+}
+
+void SonarWebSocketImpl::applyCapabilities(const folly::dynamic& params) {
+  setBatchingEnabled(params.getDefault("batching", false).asBool());
+  bserEnabled_ = params.getDefault("bser", false).asBool();
+  size_t compressionThreshold = 0;
+  if (params.getDefault("compression") == "deflate") {
+    compressionThreshold =
+        params
+            .getDefault("compressionThreshold", defaultCompressionThreshold)
+            .asInt();
+  }
+  compressionThreshold_ = compressionThreshold;
 }
 
 bool SonarWebSocketImpl::isCertificateExchangeNeeded() {
@@ -246,45 +1464,68 @@ bool SonarWebSocketImpl::isCertificateExchangeNeeded() {
     return true;
   }
 
-  auto step = sonarState_->start("Check required certificates are present");
-  std::string caCert = loadStringFromFile(absoluteFilePath(SONAR_CA_FILE_NAME));
-  std::string clientCert =
-      loadStringFromFile(absoluteFilePath(CLIENT_CERT_FILE_NAME));
-  std::string privateKey =
-      loadStringFromFile(absoluteFilePath(PRIVATE_KEY_FILE));
-
-  if (caCert == "" || clientCert == "" || privateKey == "") {
-    return true;
+  auto step = sonarState_->start(SonarStepId::checkCertificates);
+  // Only stat the files, they are read when the SSL context needs rebuilding.
+  for (const auto& stamp : certificateStamps()) {
+    if (!stamp.exists || stamp.size == 0) {
+      return true;
+    }
   }
   step->complete();
   return false;
 }
 
 void SonarWebSocketImpl::requestSignedCertFromSonar() {
-  auto generatingCSR = sonarState_->start("Generate CSR");
-  generateCertSigningRequest(
-      deviceData_.appId.c_str(),
-      absoluteFilePath(CSR_FILE_NAME).c_str(),
-      absoluteFilePath(PRIVATE_KEY_FILE).c_str());
-  generatingCSR->complete();
-  auto loadingCSR = sonarState_->start("Load CSR");
+  if (isValidCertSigningRequest(
+          deviceData_.appId.c_str(),
+          absoluteFilePath(CSR_FILE_NAME).c_str(),
+          absoluteFilePath(PRIVATE_KEY_FILE).c_str(),
+          certificateKeyType_)) {
+    // Generating a key is expensive, and only the desktop's signature is
+    // missing. Send the same request again.
+    sonarState_->start(SonarStepId::reuseCSR)->complete();
+  } else {
+    auto generatingCSR = sonarState_->start(SonarStepId::generateCSR);
+    generateCertSigningRequest(
+        deviceData_.appId.c_str(),
+        absoluteFilePath(CSR_FILE_NAME).c_str(),
+        absoluteFilePath(PRIVATE_KEY_FILE).c_str(),
+        certificateKeyType_,
+        takePregeneratedKey());
+    generatingCSR->complete();
+  }
+  auto loadingCSR = sonarState_->start(SonarStepId::loadCSR);
   std::string csr = loadStringFromFile(absoluteFilePath(CSR_FILE_NAME));
   loadingCSR->complete();
 
   folly::dynamic message = folly::dynamic::object("method", "signCertificate")(
       "csr", csr.c_str())("destination", absoluteFilePath("").c_str());
-  auto gettingCert = sonarState_->start("Getting cert from desktop");
+  auto gettingCert = sonarState_->start(SonarStepId::getCertFromDesktop);
 
   sonarEventBase_->add([this, message, gettingCert]() {
+    if (legacyRequestAssumed_) {
+      // The legacy request didn't get us connected last time, ask again
+      // in case the desktop has been updated since.
+      legacyRequestAssumed_ = false;
+      warmStart_.legacyCertificateRequest = false;
+      saveWarmStart();
+    } else if (warmStart_.legacyCertificateRequest) {
+      // The desktop answered "not implemented" before, don't wait for it
+      // to again.
+      legacyRequestAssumed_ = true;
+      gettingCert->complete();
+      sendLegacyCertificateRequest(message);
+      return;
+    }
     client_->getRequester()
         ->requestResponse(rsocket::Payload(folly::toJson(message)))
         ->subscribe([this, gettingCert](rsocket::Payload p) {
           gettingCert->complete();
           SONAR_LOG("Certificate exchange complete.");
-          // Disconnect after message sending is complete.
-          // This will trigger a reconnect which should use the secure channel.
-          // TODO: Connect immediately, without waiting for reconnect
+          // Disconnect after message sending is complete and connect
+          // again straight away, this time over the secure channel.
           client_ = nullptr;
+          certificateExchangeCompleted();
         },
         [this, message](folly::exception_wrapper e) {
           e.handle(
@@ -295,6 +1536,10 @@ void SonarWebSocketImpl::requestSignedCertFromSonar() {
                SONAR_LOG(("Desktop failed to provide certificates. Error from sonar desktop:\n" + errorMessage).c_str());
              } else {
               sendLegacyCertificateRequest(message);
+              sonarEventBase_->add([this]() {
+                warmStart_.legacyCertificateRequest = true;
+                saveWarmStart();
+              });
              }
             },
             [e](...) {
@@ -306,15 +1551,39 @@ void SonarWebSocketImpl::requestSignedCertFromSonar() {
   failedConnectionAttempts_ = 0;
 }
 
+void SonarWebSocketImpl::pregenerateKey() {
+  if (keyGenerationExecutor_) {
+    return;
+  }
+  keyGenerationExecutor_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+      1,
+      std::make_shared<folly::PriorityThreadFactory>(
+          std::make_shared<folly::NamedThreadFactory>("SonarKeygen"),
+          19 /* lowest priority */));
+  keyGenerationExecutor_->add([this]() {
+    folly::ssl::EvpPkeyUniquePtr key(generatePrivateKey(certificateKeyType_));
+    std::lock_guard<std::mutex> lock(pregeneratedKeyMutex_);
+    pregeneratedKey_ = std::move(key);
+  });
+}
+
+EVP_PKEY* SonarWebSocketImpl::takePregeneratedKey() {
+  // If the key isn't ready yet the exchange generates its own rather than
+  // waiting on a low priority thread.
+  std::lock_guard<std::mutex> lock(pregeneratedKeyMutex_);
+  return pregeneratedKey_.release();
+}
+
 void SonarWebSocketImpl::sendLegacyCertificateRequest(folly::dynamic message) {
   // Desktop is using an old version of Flipper.
   // Fall back to fireAndForget, instead of requestResponse.
-  auto sendingRequest = sonarState_->start("Sending fallback certificate request");
+  auto sendingRequest = sonarState_->start(SonarStepId::sendFallbackCertificateRequest);
   client_->getRequester()
    ->fireAndForget(rsocket::Payload(folly::toJson(message)))
    ->subscribe([this, sendingRequest]() {
      sendingRequest->complete();
      client_ = nullptr;
+     certificateExchangeCompleted();
    });
 }
 
@@ -360,6 +1629,33 @@ bool SonarWebSocketImpl::isRunningInOwnThread() {
   return sonarEventBase_->isInEventBaseThread();
 }
 
+void SonarWebSocketImpl::runFromConnection(folly::Function<void()> work) {
+  if (!sharedEventBase_) {
+    work();
+    return;
+  }
+  // Sharing the EventBase, rsocket may call back from within our own frames,
+  // e.g. a failed write in sendFrame or the disconnect in stop(). Deferring
+  // through the loop's queue keeps that from re-entering, and keeps inbound
+  // messages in the order they arrived.
+  sonarEventBase_->runInEventBaseThread(std::move(work));
+}
+
+void SonarWebSocketImpl::runPrioritized(
+    folly::StringPiece method,
+    size_t bytes,
+    folly::Function<void()> work) {
+  inbound_.push(inbound_.classify(method, bytes), std::move(work));
+  // One turn per message, which runs whichever is due by then. Messages
+  // that arrive while the callback worker is busy are ordered by priority
+  // rather than by arrival.
+  sonarEventBase_->runInEventBaseThread([this]() {
+    if (auto next = inbound_.pop()) {
+      next();
+    }
+  });
+}
+
 bool fileExists(std::string fileName) {
   struct stat buffer;
   return stat(fileName.c_str(), &buffer) == 0;
@@ -8,26 +8,54 @@
 
 #pragma once
 
+#include <Sonar/SonarBackoff.h>
+#include <Sonar/SonarHostResolver.h>
+#include <Sonar/SonarInboundScheduler.h>
 #include <Sonar/SonarInitConfig.h>
+#include <Sonar/SonarSendQueue.h>
+#include <Sonar/SonarFlightRecorder.h>
+#include <Sonar/SonarSessionRecorder.h>
+#include <Sonar/SonarWarmStart.h>
 #include <Sonar/SonarWebSocket.h>
 #include <Sonar/SonarState.h>
 #include <folly/Executor.h>
+#include <folly/Function.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/io/IOBufQueue.h>
 #include <folly/io/async/EventBase.h>
+#include <folly/io/async/SSLContext.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
 #include <rsocket/RSocket.h>
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <map>
 #include <mutex>
+#include <vector>
 
 namespace facebook {
 namespace sonar {
 
 class ConnectionEvents;
+class SonarTLSSessionCache;
+class SonarKeepalivePolicy;
+class SonarRSocketStats;
 class Responder;
+class ResponseSingle;
 
 class SonarWebSocketImpl : public SonarWebSocket {
   friend ConnectionEvents;
   friend Responder;
+  friend ResponseSingle;
 
  public:
-  SonarWebSocketImpl(SonarInitConfig config, std::shared_ptr<SonarState> state);
+  /**
+   With a budget, the bytes of events waiting to be sent are accounted in it.
+   */
+  SonarWebSocketImpl(
+      SonarInitConfig config,
+      std::shared_ptr<SonarState> state,
+      std::shared_ptr<SonarMemoryBudget> budget = nullptr);
 
   ~SonarWebSocketImpl();
 
@@ -37,35 +65,282 @@ class SonarWebSocketImpl : public SonarWebSocket {
 
   bool isOpen() const override;
 
+  bool sendsJson() const override;
+
+  void connectivityChanged() override;
+
+  void setInBackground(bool background) override;
+
+  size_t onMemoryPressure(SonarMemoryPressure level) override;
+
   void setCallbacks(Callbacks* callbacks) override;
 
   void sendMessage(const folly::dynamic& message) override;
 
+  void sendMessage(folly::dynamic&& message) override;
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override;
+
+  void sendSerialized(
+      std::unique_ptr<folly::IOBuf> message,
+      const std::string& plugin) override;
+
+  void sendSerializedResponse(std::unique_ptr<folly::IOBuf> message) override;
+
+  std::map<std::string, size_t> droppedMessages() const override;
+
+  folly::dynamic previousSessionFrames() const override;
+
   void reconnect();
 
  private:
+  /**
+   Connecting runs asynchronously on sonarEventBase_, advancing through these
+   states as each handshake completes, so the sonar thread is never blocked
+   waiting for the network.
+   */
+  enum class ConnectionState {
+    disconnected,
+    probing,
+    resolving,
+    connectingInsecurely,
+    exchangingCertificate,
+    connectingSecurely,
+    connectingLocally,
+    connected,
+  };
+
+  // Identifies the version of a file on disk.
+  struct FileStamp {
+    bool exists = false;
+    int64_t modified = 0;
+    int64_t size = 0;
+
+    bool operator==(const FileStamp& other) const {
+      return exists == other.exists && modified == other.modified &&
+          size == other.size;
+    }
+  };
+
   bool isOpen_ = false;
   Callbacks* callbacks_;
   DeviceData deviceData_;
+  // deviceData_.host and SonarInitConfig::hostCandidates.
+  SonarHostResolver resolver_;
   std::shared_ptr<SonarState> sonarState_;
 
   folly::EventBase* sonarEventBase_;
   folly::EventBase* connectionEventBase_;
+  // Set when one EventBase serves as both, see
+  // SonarInitConfig::connectionWorker.
+  bool sharedEventBase_;
   std::unique_ptr<rsocket::RSocketClient> client_;
   bool connectionIsTrusted_;
   int failedConnectionAttempts_ = 0;
+  // Built from the certificate files and reused across reconnects until any
+  // of them changes or an exchange completes. Only accessed on
+  // sonarEventBase_.
+  std::shared_ptr<folly::SSLContext> sslContext_;
+  std::vector<FileStamp> sslContextStamps_;
+  // TLS sessions negotiated with sslContext_, resumed on reconnect.
+  std::shared_ptr<SonarTLSSessionCache> tlsSessions_;
+
+  // What the last connections negotiated, read by the first startSync and
+  // written back whenever it changes, see SonarWarmStart. Only accessed on
+  // sonarEventBase_.
+  bool warmStartLoaded_ = false;
+  SonarWarmStart warmStart_;
+  SonarWarmStart savedWarmStart_;
+  // Set while a certificate exchange went straight to the legacy request
+  // because of warmStart_, until a connection shows that it worked.
+  bool legacyRequestAssumed_ = false;
+  // Set once the desktop sent setCapabilities on the current connection.
+  bool capabilitiesNegotiated_ = false;
+
+  // Only accessed on sonarEventBase_.
+  ConnectionState connectionState_ = ConnectionState::disconnected;
+  // Set until a probe reaches the desktop, see
+  // SonarInitConfig::dormantUntilReachable. Only accessed on sonarEventBase_.
+  bool dormant_;
+  std::chrono::steady_clock::time_point connectionStateSince_;
+
+  // Reconnect backoff, only accessed on sonarEventBase_. A newly requested
+  // reconnect replaces a pending one only if it is due earlier.
+  int reconnectAttempts_ = 0;
+  // So that an app running without the desktop doesn't keep waking up to
+  // open sockets.
+  const SonarBackoff backoff_;
+  bool reconnectPending_ = false;
+  std::chrono::steady_clock::time_point reconnectDeadline_;
+
+  // See SonarInitConfig::resumeBufferBytes. While a session resumes the
+  // connection still counts as open, and the send queues hold on to
+  // messages until it has.
+  const size_t resumeBufferBytes_;
+  const std::chrono::seconds resumeWindow_;
+  std::atomic<bool> resuming_{false};
+
+  /**
+   Outgoing messages travel in one of two lanes. Responses to the desktop's
+   requests, which someone is usually waiting on, are always sent before
+   plugin events, so that floods of events don't delay them.
+   */
+  struct SendLane {
+    SendLane(
+        size_t maxQueuedMessagesPerPlugin,
+        OverflowPolicy overflowPolicy,
+        std::shared_ptr<SonarMemoryBudget> budget = nullptr,
+        std::unordered_map<std::string, size_t> weights = {})
+        : queue(
+              maxQueuedMessagesPerPlugin,
+              overflowPolicy,
+              std::move(budget),
+              std::move(weights)) {}
+
+    // Messages wait here until the sonar thread picks them up, so that a
+    // slow desktop can't make memory grow without bound.
+    SonarSendQueue queue;
+
+    // Outgoing messages are numbered so that ones serialized on
+    // serializationExecutor_ still go out in the order they were sent.
+    // Only accessed on sonarEventBase_.
+    uint64_t nextSendSequence = 0;
+    uint64_t nextSentSequence = 0;
+    std::map<uint64_t, std::unique_ptr<folly::IOBuf>> outOfOrder;
+  };
+
+  SendLane responses_;
+  SendLane events_;
+  // Events stay in events_.queue while set, within its quotas, see
+  // SonarInitConfig::pauseEventsInBackground.
+  std::atomic<bool> eventsPaused_{false};
+  const bool pauseEventsInBackground_;
+  // Used for connections made while in the background.
+  std::atomic<bool> inBackground_{false};
+  const std::chrono::seconds keepalive_;
+  const std::chrono::seconds backgroundKeepalive_;
+  // Shared with trusted connections, which follow it as the app moves
+  // between foreground and background.
+  const std::shared_ptr<SonarKeepalivePolicy> keepalivePolicy_;
+  // Messages dropped by either queue since the start, by plugin.
+  mutable std::mutex droppedMutex_;
+  std::map<std::string, size_t> droppedTotals_;
+
+  // Messages from the desktop waiting for sonarEventBase_.
+  SonarInboundScheduler inbound_;
+
+  // Set once the desktop accepts BSER, read from any sending thread.
+  std::atomic<bool> bserEnabled_{false};
+
+  // Only accessed on sonarEventBase_.
+  bool batchingEnabled_ = false;
+  bool batchFlushScheduled_ = false;
+  // Frames of at least this many bytes are deflated, 0 disables compression.
+  size_t compressionThreshold_ = 0;
+  folly::IOBufQueue pendingBatch_{folly::IOBufQueue::cacheChainLength()};
+
+  std::unique_ptr<folly::CPUThreadPoolExecutor> serializationExecutor_;
+
+  CertificateKeyType certificateKeyType_;
+  bool pregenerateCertificateKey_;
+  std::shared_ptr<SonarRSocketStats> transportStats_;
+  // Null unless SonarInitConfig::sessionRecordingPath is set.
+  std::unique_ptr<SonarSessionRecorder> recorder_;
+  // Null unless SonarInitConfig::flightRecorderPath is set.
+  std::unique_ptr<SonarFlightRecorder> flightRecorder_;
+  SonarTransportFactory transport_;
+  // Set when transport_ couldn't connect, making the next attempts use TCP.
+  // Only accessed on sonarEventBase_.
+  bool localTransportUnavailable_ = false;
+  std::mutex pregeneratedKeyMutex_;
+  folly::ssl::EvpPkeyUniquePtr pregeneratedKey_;
+  // Declared last so it is joined before the members its task touches are
+  // destroyed.
+  std::unique_ptr<folly::CPUThreadPoolExecutor> keyGenerationExecutor_;
 
   void startSync();
-  void doCertificateExchange();
-  void connectSecurely();
+  void probeDesktop();
+  void pregenerateKeyIfNeeded();
+  void loadWarmStart();
+  void saveWarmStart();
+  static std::string certificatesKey(const std::vector<FileStamp>& stamps);
+  void recordFrame(
+      SonarSessionRecorder::Direction direction,
+      bool stream,
+      const folly::IOBuf& data);
+  void scheduleReconnect(bool immediately);
+  std::chrono::milliseconds nextReconnectDelay();
+
+  std::chrono::seconds keepaliveInterval() const;
+  // Continues with then on sonarEventBase_ once the desktop's address at
+  // port is known, see SonarHostResolver.
+  void resolveDesktop(
+      std::shared_ptr<SonarStep> connect,
+      uint16_t port,
+      folly::Function<void(folly::SocketAddress)> then);
+  void doCertificateExchange(
+      std::shared_ptr<SonarStep> connect,
+      folly::SocketAddress address);
+  void connectSecurely(
+      std::shared_ptr<SonarStep> connect,
+      folly::SocketAddress address);
+  void connectLocally(std::shared_ptr<SonarStep> connect);
+  void connectTrusted(
+      std::shared_ptr<SonarStep> connect,
+      std::unique_ptr<rsocket::ConnectionFactory> connectionFactory,
+      SonarStepId step);
+  void connectionFailed(
+      std::shared_ptr<SonarStep> connect,
+      const folly::exception_wrapper& error);
+  void connectionClosed();
+  // Tells the callbacks once a connection is gone for good, and reconnects.
+  void connectionLost();
+  void resumeSession();
+  void certificateExchangeCompleted();
+  std::shared_ptr<folly::SSLContext> getSSLContext();
+  std::vector<FileStamp> certificateStamps();
+  void setConnectionState(ConnectionState state);
+  static const char* connectionStateName(ConnectionState state);
   std::string loadCSRFromFile();
   std::string loadStringFromFile(std::string fileName);
   std::string absoluteFilePath(const char* relativeFilePath);
   bool isCertificateExchangeNeeded();
   void requestSignedCertFromSonar();
+  void pregenerateKey();
+  EVP_PKEY* takePregeneratedKey();
   bool ensureSonarDirExists();
   bool isRunningInOwnThread();
+  void runFromConnection(folly::Function<void()> work);
+  void runPrioritized(
+      folly::StringPiece method,
+      size_t bytes,
+      folly::Function<void()> work);
   void sendLegacyCertificateRequest(folly::dynamic message);
+  void enqueue(SendLane& lane, SonarSendQueue::Entry entry);
+  void drainSendQueue();
+  void sendQueued(SendLane& lane, SonarSendQueue::Entry entry);
+  void sendInOrder(
+      SendLane& lane,
+      uint64_t sequence,
+      std::unique_ptr<folly::IOBuf> data);
+  folly::Executor* serializationExecutor();
+  std::unique_ptr<folly::IOBuf> encode(const folly::dynamic& message);
+  void sendEncoded(SendLane& lane, std::unique_ptr<folly::IOBuf> data);
+  void sendFrame(std::unique_ptr<folly::IOBuf> data);
+  void sendBatched(std::unique_ptr<folly::IOBuf> data);
+  void flushBatch();
+  void setBatchingEnabled(bool enabled);
+
+  /**
+   Features this client supports, advertised in the setup payload. The desktop
+   opts in to them by sending a setCapabilities message, which is handled here
+   and not forwarded to the callbacks.
+   */
+  folly::dynamic capabilities();
+  // The params of a setCapabilities, only called on sonarEventBase_.
+  void applyCapabilities(const folly::dynamic& params);
+  bool handleTransportMessage(const folly::dynamic& message);
+  bool handleTransportMessage(const SonarRawJson& message);
 };
 
 } // namespace sonar
@@ -0,0 +1,405 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+// Benchmarks of the client's hot paths. Run with --json to get results in a
+// form that can be compared between commits, e.g. with folly's
+// benchmark_compare.
+
+#include <Sonar/SonarClient.h>
+#include <Sonar/SonarConnectionImpl.h>
+#include <Sonar/SonarJsonParser.h>
+#include <Sonar/SonarJsonWriter.h>
+#include <Sonar/SonarSendQueue.h>
+#include <Sonar/SonarSerialize.h>
+#include <Sonar/SonarState.h>
+#include <Sonar/SonarStep.h>
+#include <SonarTestLib/SonarPluginMock.h>
+#include <SonarTestLib/SonarWebSocketMock.h>
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/executors/InlineExecutor.h>
+#include <folly/experimental/bser/Bser.h>
+#include <folly/init/Init.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/json.h>
+#include <folly/synchronization/Baton.h>
+#include <atomic>
+
+namespace facebook {
+namespace sonar {
+namespace benchmark {
+
+using folly::dynamic;
+using test::SonarPluginMock;
+using test::SonarWebSocketMock;
+
+// Drops everything sent, so that only the work before the socket is measured.
+class NullWebSocket : public SonarWebSocketMock {
+ public:
+  using SonarWebSocketMock::sendMessage;
+  using SonarWebSocketMock::sendSerialized;
+
+  void sendMessage(const dynamic& message) override {
+    folly::doNotOptimizeAway(message);
+  }
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override {
+    folly::doNotOptimizeAway(message);
+  }
+};
+
+// A layout node like the inspector sends, about 400 bytes of JSON each.
+static dynamic payload(size_t nodes) {
+  dynamic children = dynamic::array();
+  for (size_t i = 0; i < nodes; i++) {
+    children.push_back(dynamic::object("id", folly::to<std::string>(i))(
+        "name", "com.facebook.litho.LithoView")(
+        "attributes",
+        dynamic::array(
+            dynamic::object("name", "width")("value", 1080),
+            dynamic::object("name", "height")("value", 1920)))(
+        "data",
+        dynamic::object(
+            "View",
+            dynamic::object("alpha", 1.0)("visibility", "VISIBLE")(
+                "translationX", 0)("translationY", 0)("padding", "0, 0, 0, 0")(
+                "layoutParams", "MATCH_PARENT x WRAP_CONTENT")))(
+        "children", dynamic::array("a", "b", "c")));
+  }
+  return dynamic::object("nodes", std::move(children));
+}
+
+struct DispatchFixture {
+  DispatchFixture() : socket(new NullWebSocket) {
+    client = std::make_unique<SonarClient>(
+        std::unique_ptr<SonarWebSocket>(socket),
+        std::make_shared<SonarState>());
+    client->addPlugin(std::make_shared<SonarPluginMock>(
+        "Test", [](std::shared_ptr<SonarConnection> conn) {
+          conn->receive(
+              "event",
+              [](const dynamic& params, std::unique_ptr<SonarResponder>) {
+                folly::doNotOptimizeAway(params);
+              });
+        }));
+    client->start();
+    socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+        "params", dynamic::object("plugin", "Test")));
+  }
+
+  NullWebSocket* socket;
+  std::unique_ptr<SonarClient> client;
+};
+
+static void dispatch(size_t iters, size_t nodes) {
+  std::unique_ptr<DispatchFixture> fixture;
+  dynamic message;
+  BENCHMARK_SUSPEND {
+    fixture = std::make_unique<DispatchFixture>();
+    message = dynamic::object("method", "execute")(
+        "params",
+        dynamic::object("api", "Test")("method", "event")(
+            "params", payload(nodes)));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    fixture->client->onMessageReceived(message);
+  }
+}
+
+static void dispatchRaw(size_t iters, size_t nodes) {
+  std::unique_ptr<DispatchFixture> fixture;
+  SonarRawJson message;
+  BENCHMARK_SUSPEND {
+    fixture = std::make_unique<DispatchFixture>();
+    message = SonarRawJson::fromString(folly::toJson(dynamic::object(
+        "method", "execute")(
+        "params",
+        dynamic::object("api", "Test")("method", "event")(
+            "params", payload(nodes)))));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    fixture->client->onRawMessageReceived(message);
+  }
+}
+
+BENCHMARK_PARAM(dispatch, 1)
+BENCHMARK_RELATIVE_PARAM(dispatchRaw, 1)
+BENCHMARK_PARAM(dispatch, 100)
+BENCHMARK_RELATIVE_PARAM(dispatchRaw, 100)
+
+BENCHMARK_DRAW_LINE();
+
+static void connectionSend(size_t iters, size_t nodes) {
+  NullWebSocket socket;
+  std::shared_ptr<SonarConnectionImpl> conn;
+  dynamic params;
+  BENCHMARK_SUSPEND {
+    conn = std::make_shared<SonarConnectionImpl>(
+        &socket, "Test", &folly::InlineExecutor::instance());
+    params = payload(nodes);
+  }
+  for (size_t i = 0; i < iters; i++) {
+    conn->send("event", params);
+  }
+}
+
+static void connectionSendRaw(size_t iters, size_t nodes) {
+  NullWebSocket socket;
+  std::shared_ptr<SonarConnectionImpl> conn;
+  std::unique_ptr<folly::IOBuf> params;
+  BENCHMARK_SUSPEND {
+    conn = std::make_shared<SonarConnectionImpl>(
+        &socket, "Test", &folly::InlineExecutor::instance());
+    params = folly::IOBuf::copyBuffer(folly::toJson(payload(nodes)));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    conn->sendRaw("event", params->clone());
+  }
+}
+
+BENCHMARK_PARAM(connectionSend, 1)
+BENCHMARK_RELATIVE_PARAM(connectionSendRaw, 1)
+BENCHMARK_PARAM(connectionSend, 100)
+BENCHMARK_RELATIVE_PARAM(connectionSendRaw, 100)
+
+BENCHMARK_DRAW_LINE();
+
+// What SonarWebSocketImpl::sendMessage does with a message before it's
+// queued: encode it as JSON, or as BSER once the desktop has asked for it.
+static void serializeJson(size_t iters, size_t nodes) {
+  dynamic message;
+  BENCHMARK_SUSPEND {
+    message = payload(nodes);
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(folly::toJson(message));
+  }
+}
+
+static void serializeBser(size_t iters, size_t nodes) {
+  dynamic message;
+  BENCHMARK_SUSPEND {
+    message = payload(nodes);
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(folly::bser::toBserIOBuf(
+        message, folly::bser::serialization_opts()));
+  }
+}
+
+static void serializeSonarJson(size_t iters, size_t nodes) {
+  dynamic message;
+  BENCHMARK_SUSPEND {
+    message = payload(nodes);
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(sonarToJson(message));
+  }
+}
+
+// A network response with a 64KB body, mostly ASCII like most bodies are.
+static void serializeBody(size_t iters, bool sonar) {
+  dynamic message;
+  BENCHMARK_SUSPEND {
+    std::string body;
+    while (body.size() < 64 * 1024) {
+      body += "<p class=content>Lorem ipsum dolor sit amet, consectetur "
+              "adipiscing elit, sed do eiusmod tempor incididunt.</p>\n";
+    }
+    message = dynamic::object("id", "1234")("data", std::move(body));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(
+        sonar ? sonarToJson(message) : folly::toJson(message));
+  }
+}
+
+BENCHMARK_PARAM(serializeJson, 1)
+BENCHMARK_RELATIVE_PARAM(serializeBser, 1)
+BENCHMARK_RELATIVE_PARAM(serializeSonarJson, 1)
+BENCHMARK_PARAM(serializeJson, 100)
+BENCHMARK_RELATIVE_PARAM(serializeBser, 100)
+BENCHMARK_RELATIVE_PARAM(serializeSonarJson, 100)
+BENCHMARK_PARAM(serializeJson, 10000)
+BENCHMARK_RELATIVE_PARAM(serializeBser, 10000)
+BENCHMARK_RELATIVE_PARAM(serializeSonarJson, 10000)
+BENCHMARK_NAMED_PARAM(serializeBody, folly, false)
+BENCHMARK_RELATIVE_NAMED_PARAM(serializeBody, sonar, true)
+
+BENCHMARK_DRAW_LINE();
+
+// What a large frame from the desktop costs to parse into a dynamic. With
+// FB_SONAR_SIMDJSON, compared with simdjson regardless of the threshold.
+static void parseFolly(size_t iters, size_t nodes) {
+  std::string json;
+  BENCHMARK_SUSPEND {
+    json = folly::toJson(payload(nodes));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(folly::parseJson(json));
+  }
+}
+
+BENCHMARK_PARAM(parseFolly, 1)
+#if FB_SONAR_SIMDJSON
+static void parseSimd(size_t iters, size_t nodes) {
+  std::string json;
+  BENCHMARK_SUSPEND {
+    json = folly::toJson(payload(nodes));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(sonarParseJsonSimd(json));
+  }
+}
+
+BENCHMARK_RELATIVE_PARAM(parseSimd, 1)
+BENCHMARK_PARAM(parseFolly, 40)
+BENCHMARK_RELATIVE_PARAM(parseSimd, 40)
+BENCHMARK_PARAM(parseFolly, 1000)
+BENCHMARK_RELATIVE_PARAM(parseSimd, 1000)
+BENCHMARK_PARAM(parseFolly, 10000)
+BENCHMARK_RELATIVE_PARAM(parseSimd, 10000)
+#else
+BENCHMARK_PARAM(parseFolly, 40)
+BENCHMARK_PARAM(parseFolly, 1000)
+BENCHMARK_PARAM(parseFolly, 10000)
+#endif
+
+BENCHMARK_DRAW_LINE();
+
+// A network request event as a plugin would build it, as a dynamic first or
+// written straight from a struct with SONAR_FIELDS.
+struct RequestEvent {
+  std::string id;
+  int64_t timestamp;
+  std::string method;
+  std::string url;
+  std::map<std::string, std::string> headers;
+  SONAR_FIELDS(
+      SONAR_FIELD(RequestEvent, id),
+      SONAR_FIELD(RequestEvent, timestamp),
+      SONAR_FIELD(RequestEvent, method),
+      SONAR_FIELD(RequestEvent, url),
+      SONAR_FIELD(RequestEvent, headers))
+};
+
+static RequestEvent requestEvent() {
+  return {"1234",
+          1530000000000,
+          "GET",
+          "https://graph.facebook.com/graphql?doc_id=1234567890",
+          {{"Accept", "*/*"},
+           {"Accept-Encoding", "gzip, deflate"},
+           {"User-Agent", "Sonar/1.0"}}};
+}
+
+BENCHMARK(serializeViaDynamic, iters) {
+  const auto event = requestEvent();
+  for (size_t i = 0; i < iters; i++) {
+    dynamic headers = dynamic::object();
+    for (const auto& header : event.headers) {
+      headers[header.first] = header.second;
+    }
+    folly::doNotOptimizeAway(folly::toJson(dynamic::object("id", event.id)(
+        "timestamp", event.timestamp)("method", event.method)(
+        "url", event.url)("headers", std::move(headers))));
+  }
+}
+
+BENCHMARK_RELATIVE(serializeTyped, iters) {
+  const auto event = requestEvent();
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(sonar::serializeJson(event));
+  }
+}
+
+BENCHMARK(sendQueuePushDrain, iters) {
+  SonarSendQueue queue(1000, OverflowPolicy::dropOldest);
+  for (size_t i = 0; i < iters; i++) {
+    queue.push({"Test", dynamic::object("value", 1), nullptr}, false);
+    if (i % 100 == 99) {
+      folly::doNotOptimizeAway(queue.drain());
+    }
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+// Requests arriving on the connection worker, handed to the callback worker
+// and answered back on the connection worker, as SonarWebSocketImpl does with
+// separate workers or with one EventBase shared by both.
+static void workerRoundTrips(size_t iters, bool shared) {
+  folly::BenchmarkSuspender setup;
+  folly::ScopedEventBaseThread callbackThread("SonarBenchCallback");
+  std::unique_ptr<folly::ScopedEventBaseThread> connectionThread;
+  if (!shared) {
+    connectionThread =
+        std::make_unique<folly::ScopedEventBaseThread>("SonarBenchConnection");
+  }
+  auto callbackWorker = callbackThread.getEventBase();
+  auto connectionWorker =
+      shared ? callbackWorker : connectionThread->getEventBase();
+  std::atomic<size_t> remaining{iters};
+  folly::Baton<> done;
+  setup.dismiss();
+
+  connectionWorker->runInEventBaseThread([&]() {
+    for (size_t i = 0; i < iters; i++) {
+      callbackWorker->runInEventBaseThread([&]() {
+        connectionWorker->runInEventBaseThread([&]() {
+          if (--remaining == 0) {
+            done.post();
+          }
+        });
+      });
+    }
+  });
+  done.wait();
+}
+
+BENCHMARK(separateWorkers, iters) {
+  workerRoundTrips(iters, false);
+}
+
+BENCHMARK_RELATIVE(sharedWorker, iters) {
+  workerRoundTrips(iters, true);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(stateStep, iters) {
+  SonarState state;
+  for (size_t i = 0; i < iters; i++) {
+    state.start(SonarStepId::connectToDesktop)->complete();
+  }
+}
+
+BENCHMARK(stateParametrizedStep, iters) {
+  SonarState state;
+  for (size_t i = 0; i < iters; i++) {
+    state.start(SonarStepId::addPlugin, "Test")->complete();
+  }
+}
+
+BENCHMARK(stateCounter, iters) {
+  SonarState state;
+  for (size_t i = 0; i < iters; i++) {
+    state.incrementCounter("Bytes sent", 100);
+  }
+}
+
+} // namespace benchmark
+} // namespace sonar
+} // namespace facebook
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
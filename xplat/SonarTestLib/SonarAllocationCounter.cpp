@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include "SonarAllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+namespace {
+
+// Plain values, so that reaching them from operator new doesn't allocate
+// or run a constructor.
+thread_local size_t allocations = 0;
+thread_local size_t allocatedBytes = 0;
+
+void* allocate(size_t size) noexcept {
+  allocations++;
+  allocatedBytes += size;
+  if (size == 0) {
+    size = 1;
+  }
+  while (true) {
+    if (void* memory = std::malloc(size)) {
+      return memory;
+    }
+    const auto handler = std::get_new_handler();
+    if (!handler) {
+      return nullptr;
+    }
+    handler();
+  }
+}
+
+void* allocateOrThrow(size_t size) {
+  if (void* memory = allocate(size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+SonarAllocationCounter::SonarAllocationCounter()
+    : startCount_(allocations), startBytes_(allocatedBytes) {}
+
+size_t SonarAllocationCounter::count() const {
+  return stopped_ ? count_ : allocations - startCount_;
+}
+
+size_t SonarAllocationCounter::bytes() const {
+  return stopped_ ? bytes_ : allocatedBytes - startBytes_;
+}
+
+void SonarAllocationCounter::stop() {
+  if (!stopped_) {
+    count_ = count();
+    bytes_ = bytes();
+    stopped_ = true;
+  }
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
+
+using facebook::sonar::test::allocate;
+using facebook::sonar::test::allocateOrThrow;
+
+void* operator new(size_t size) {
+  return allocateOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+  return allocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+  std::free(memory);
+}
@@ -0,0 +1,50 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+/**
+ Counts the allocations made with operator new on the calling thread while it
+ is alive, so that tests can hold hot paths to a budget. Only counts when
+ SonarAllocationCounter.cpp, which replaces operator new, is linked into the
+ test binary. Allocations made with malloc directly aren't counted, nor are
+ those of other threads, such as the executors a call hands work to.
+
+ Counters can be nested, each counts everything from its construction.
+ */
+class SonarAllocationCounter {
+ public:
+  SonarAllocationCounter();
+
+  // Allocations and bytes allocated on this thread so far.
+  size_t count() const;
+  size_t bytes() const;
+
+  // Stops counting, count() and bytes() keep their values from then on.
+  void stop();
+
+  SonarAllocationCounter(const SonarAllocationCounter&) = delete;
+  SonarAllocationCounter& operator=(const SonarAllocationCounter&) = delete;
+
+ private:
+  size_t startCount_;
+  size_t startBytes_;
+  bool stopped_ = false;
+  size_t count_ = 0;
+  size_t bytes_ = 0;
+};
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -11,26 +11,63 @@
 #include <Sonar/SonarConnection.h>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace facebook {
 namespace sonar {
 
 class SonarConnectionMock : public SonarConnection {
  public:
+  using SonarConnection::receive;
+  using SonarConnection::send;
+
   void send(const std::string& method, const folly::dynamic& params) override {
     sent_[method] = params;
   }
 
+  void sendRaw(const std::string& method, std::unique_ptr<folly::IOBuf> params)
+      override {
+    rawSent_.emplace_back(
+        method, params ? params->moveToFbString().toStdString() : "");
+  }
+
   void receive(const std::string& method, const SonarReceiver& receiver)
       override {
     receivers_[method] = receiver;
   }
 
+  void receiveRaw(const std::string& method, const SonarRawReceiver& receiver)
+      override {
+    rawReceivers_[method] = receiver;
+  }
+
+  void receiveStream(
+      const std::string& method,
+      const SonarStreamReceiver& receiver) override {
+    streamReceivers_[method] = receiver;
+  }
+
   void error(const std::string& message, const std::string& stacktrace)
       override {}
 
+  std::string registerBlob(std::unique_ptr<folly::IOBuf> blob) override {
+    const auto id = std::to_string(blobs_.size());
+    blobs_[id] = blob ? blob->moveToFbString().toStdString() : "";
+    return id;
+  }
+
+  void releaseBlob(const std::string& id) override {
+    blobs_.erase(id);
+  }
+
   std::map<std::string, folly::dynamic> sent_;
+  // Raw sends in the order they were made, params as sent.
+  std::vector<std::pair<std::string, std::string>> rawSent_;
   std::map<std::string, SonarReceiver> receivers_;
+  std::map<std::string, SonarRawReceiver> rawReceivers_;
+  std::map<std::string, SonarStreamReceiver> streamReceivers_;
+  std::map<std::string, std::string> blobs_;
 };
 
 } // namespace sonar
@@ -0,0 +1,42 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <SonarTestLib/SonarWebSocketMock.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+/**
+ Counts what is sent and drops it, so that neither keeping nor parsing it
+ counts against the client in allocation and operation budgets.
+ */
+class SonarCountingWebSocket : public SonarWebSocketMock {
+ public:
+  using SonarWebSocketMock::sendMessage;
+  using SonarWebSocketMock::sendSerialized;
+
+  void sendMessage(const folly::dynamic& message) override {
+    sent++;
+  }
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override {
+    sent++;
+    serialized++;
+  }
+
+  // Every send, and of those the ones that came serialized already.
+  size_t sent = 0;
+  size_t serialized = 0;
+};
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
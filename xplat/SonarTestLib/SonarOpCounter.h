@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarOpCounts.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+/**
+ Counts the JSON encodes and decodes and the lock acquisitions of the calling
+ thread while it is alive, like SonarAllocationCounter does allocations, so
+ that tests can hold hot paths to a budget that doesn't depend on how fast
+ the machine is. Counts nothing unless FB_SONAR_OP_COUNTING is set, see
+ Sonar/SonarOpCounts.h.
+
+ Counters can be nested, each counts everything from its construction.
+ */
+class SonarOpCounter {
+ public:
+  SonarOpCounter() : start_(now()) {}
+
+  uint64_t jsonEncodes() const {
+    return counts().jsonEncodes;
+  }
+
+  uint64_t jsonDecodes() const {
+    return counts().jsonDecodes;
+  }
+
+  uint64_t lockAcquisitions() const {
+    return counts().lockAcquisitions;
+  }
+
+  // Stops counting, the counts keep their values from then on.
+  void stop() {
+    if (!stopped_) {
+      stopped_ = true;
+      end_ = now();
+    }
+  }
+
+  SonarOpCounter(const SonarOpCounter&) = delete;
+  SonarOpCounter& operator=(const SonarOpCounter&) = delete;
+
+ private:
+  static SonarOpCounts now() {
+#if FB_SONAR_OP_COUNTING
+    return sonarThreadOpCounts();
+#else
+    return SonarOpCounts();
+#endif
+  }
+
+  SonarOpCounts counts() const {
+    const auto end = stopped_ ? end_ : now();
+    SonarOpCounts counts;
+    counts.jsonEncodes = end.jsonEncodes - start_.jsonEncodes;
+    counts.jsonDecodes = end.jsonDecodes - start_.jsonDecodes;
+    counts.lockAcquisitions = end.lockAcquisitions - start_.lockAcquisitions;
+    return counts;
+  }
+
+  const SonarOpCounts start_;
+  bool stopped_ = false;
+  SonarOpCounts end_;
+};
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarRawJson.h>
+#include <Sonar/SonarSessionRecorder.h>
+#include <SonarTestLib/SonarWebSocketMock.h>
+#include <folly/Optional.h>
+#include <folly/json.h>
+#include <chrono>
+#include <thread>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+/**
+ Feeds a recorded session (see SonarSessionRecorder) into the client behind a
+ SonarWebSocketMock, inbound frames only, keeping the recorded time between
+ them divided by speed. A speed of 0 replays them back to back. The
+ recording's outbound frames are what the client sent at the time, to compare
+ the mock's messages with.
+ */
+class SonarSessionReplay {
+ public:
+  struct Result {
+    size_t framesReplayed = 0;
+    // Sent by the client while the session was replayed.
+    size_t messagesSent = 0;
+    size_t recordedMessagesSent = 0;
+    std::chrono::microseconds duration{0};
+    std::chrono::microseconds recordedDuration{0};
+  };
+
+  explicit SonarSessionReplay(std::vector<SonarSessionRecorder::Frame> frames)
+      : frames_(std::move(frames)) {}
+
+  static SonarSessionReplay fromFile(const std::string& path) {
+    return SonarSessionReplay(SonarSessionRecorder::load(path));
+  }
+
+  Result replay(SonarWebSocketMock& socket, double speed = 1) {
+    Result result;
+    const auto sentBefore = socket.messages.size();
+    const auto start = std::chrono::steady_clock::now();
+    folly::Optional<std::chrono::microseconds> firstInbound;
+
+    for (const auto& frame : frames_) {
+      if (frame.direction == SonarSessionRecorder::Direction::outbound) {
+        result.recordedMessagesSent++;
+        continue;
+      }
+      if (!firstInbound) {
+        firstInbound = frame.time;
+      }
+      result.recordedDuration = frame.time - *firstInbound;
+      if (speed > 0) {
+        std::this_thread::sleep_until(
+            start +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                result.recordedDuration / speed));
+      }
+      if (frame.stream) {
+        socket.callbacks->onStreamRequested(
+            folly::parseJson(frame.data),
+            std::make_shared<DiscardingStreamResponder>());
+      } else {
+        socket.callbacks->onRawMessageReceived(
+            SonarRawJson::fromString(frame.data));
+      }
+      result.framesReplayed++;
+    }
+
+    result.duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    result.messagesSent = socket.messages.size() - sentBefore;
+    return result;
+  }
+
+ private:
+  class DiscardingStreamResponder : public SonarStreamResponder {
+   public:
+    void next(const folly::dynamic& chunk) override {}
+    void complete() override {}
+    void error(const folly::dynamic& response) override {}
+  };
+
+  std::vector<SonarSessionRecorder::Frame> frames_;
+};
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,305 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarBackoff.h>
+#include <SonarTestLib/SonarWebSocketMock.h>
+#include <folly/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+/**
+ Time for simulations that only passes when advanced, so that they are
+ deterministic and don't sleep. Tasks run in the order they are due, tasks
+ due at the same time in the order they were scheduled.
+ */
+class SonarVirtualClock {
+ public:
+  using time_point = std::chrono::steady_clock::time_point;
+  using duration = std::chrono::steady_clock::duration;
+
+  time_point now() const {
+    return now_;
+  }
+
+  void schedule(duration delay, std::function<void()> task) {
+    tasks_.emplace(
+        std::make_pair(now_ + std::max(delay, duration(0)), nextTask_++),
+        std::move(task));
+  }
+
+  /**
+   Run everything due within by, including what those tasks schedule.
+   */
+  void advance(duration by) {
+    const auto until = now_ + by;
+    while (!tasks_.empty() && tasks_.begin()->first.first <= until) {
+      auto iter = tasks_.begin();
+      now_ = iter->first.first;
+      auto task = std::move(iter->second);
+      tasks_.erase(iter);
+      task();
+    }
+    now_ = until;
+  }
+
+  // Run until nothing is scheduled, but for no longer than limit.
+  void runUntilIdle(duration limit = std::chrono::hours(1)) {
+    const auto until = now_ + limit;
+    while (!tasks_.empty() && tasks_.begin()->first.first <= until) {
+      advance(tasks_.begin()->first.first - now_);
+    }
+  }
+
+ private:
+  time_point now_;
+  uint64_t nextTask_ = 0;
+  std::map<std::pair<time_point, uint64_t>, std::function<void()>> tasks_;
+};
+
+struct SonarLinkConditions {
+  // One way, connecting takes a round trip.
+  std::chrono::milliseconds latency{0};
+  // 0 doesn't limit the bandwidth.
+  size_t bytesPerSecond = 0;
+  // Bytes waiting for the link per plugin, past which messages are dropped
+  // like a full send queue would. 0 doesn't limit them.
+  size_t maxQueuedBytes = 0;
+};
+
+/**
+ A SonarWebSocketMock whose link to the desktop is simulated on a
+ SonarVirtualClock: messages reach messages only once they have gone through
+ the link's bandwidth and latency, and the link goes down on a schedule.
+ While it is down the socket keeps reconnecting with the backoff, as the real
+ ones do, so that reconnects, batching and queue limits can be measured
+ without real sockets.
+ */
+class SonarSimulatedWebSocket : public SonarWebSocketMock {
+ public:
+  struct Stats {
+    size_t connects = 0;
+    size_t failedConnects = 0;
+    size_t messagesDelivered = 0;
+    size_t bytesDelivered = 0;
+    // Lost with the connection they were sent on.
+    size_t messagesLost = 0;
+    SonarVirtualClock::duration maxDeliveryTime{0};
+    SonarVirtualClock::duration totalDeliveryTime{0};
+    SonarVirtualClock::duration disconnectedTime{0};
+  };
+
+  SonarSimulatedWebSocket(
+      SonarVirtualClock& clock,
+      SonarLinkConditions conditions = SonarLinkConditions(),
+      SonarBackoff backoff = seededBackoff(0))
+      : clock_(clock), conditions_(conditions), backoff_(std::move(backoff)) {}
+
+  /**
+   The default backoff, with its jitter drawn from a generator seeded with
+   seed rather than at random.
+   */
+  static SonarBackoff seededBackoff(uint32_t seed) {
+    auto generator = std::make_shared<std::mt19937>(seed);
+    return SonarBackoff(
+        SonarBackoff::kDefaultInitialDelay,
+        SonarBackoff::kDefaultMaxDelay,
+        [generator]() {
+          return std::uniform_real_distribution<double>(0.5, 1.0)(*generator);
+        });
+  }
+
+  /**
+   Take the link down after delay, for downtime.
+   */
+  void disconnectAfter(
+      SonarVirtualClock::duration delay,
+      SonarVirtualClock::duration downtime) {
+    clock_.schedule(delay, [this, downtime]() {
+      linkUpAt_ = std::max(linkUpAt_, clock_.now() + downtime);
+      if (open) {
+        close();
+        scheduleConnect(backoff_.delay(attempts_++));
+      }
+    });
+  }
+
+  /**
+   Send message from the desktop, it reaches the client after the latency if
+   the connection is still open by then.
+   */
+  void receive(folly::dynamic message) {
+    const auto connection = connection_;
+    clock_.schedule(
+        conditions_.latency,
+        [this, connection, message = std::move(message)]() {
+          if (open && connection == connection_) {
+            callbacks->onMessageReceived(message);
+          }
+        });
+  }
+
+  const Stats& stats() const {
+    return stats_;
+  }
+
+  void start() override {
+    if (started_) {
+      return;
+    }
+    started_ = true;
+    scheduleConnect(SonarVirtualClock::duration(0));
+  }
+
+  void stop() override {
+    started_ = false;
+    if (open) {
+      close();
+    }
+  }
+
+  void connectivityChanged() override {
+    if (started_ && !open) {
+      attempts_ = 0;
+      scheduleConnect(SonarVirtualClock::duration(0));
+    }
+  }
+
+  using SonarWebSocket::sendMessage;
+  using SonarWebSocket::sendSerialized;
+
+  void sendMessage(const folly::dynamic& message) override {
+    sendSerialized(folly::IOBuf::copyBuffer(folly::toJson(message)), "");
+  }
+
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override {
+    sendSerialized(std::move(message), "");
+  }
+
+  void sendSerialized(
+      std::unique_ptr<folly::IOBuf> message,
+      const std::string& plugin) override {
+    const auto bytes = message->computeChainDataLength();
+    auto& queued = queuedBytes_[plugin];
+    if (!open ||
+        (conditions_.maxQueuedBytes > 0 &&
+         queued + bytes > conditions_.maxQueuedBytes)) {
+      dropped_[plugin]++;
+      return;
+    }
+    queued += bytes;
+    // Messages go out over the link one after the other.
+    const auto now = clock_.now();
+    const auto transmitted = std::max(now, linkFreeAt_) + transmitTime(bytes);
+    linkFreeAt_ = transmitted;
+    const auto connection = connection_;
+    clock_.schedule(transmitted - now, [this, connection, plugin, bytes]() {
+      if (connection == connection_) {
+        queuedBytes_[plugin] -= bytes;
+      }
+    });
+    std::shared_ptr<folly::IOBuf> shared(std::move(message));
+    clock_.schedule(
+        transmitted + conditions_.latency - now,
+        [this, connection, shared, bytes, now]() {
+          if (connection != connection_) {
+            stats_.messagesLost++;
+            return;
+          }
+          const auto deliveryTime = clock_.now() - now;
+          stats_.messagesDelivered++;
+          stats_.bytesDelivered += bytes;
+          stats_.totalDeliveryTime += deliveryTime;
+          stats_.maxDeliveryTime =
+              std::max(stats_.maxDeliveryTime, deliveryTime);
+          messages.push_back(
+              folly::parseJson(shared->cloneAsValue().moveToFbString()));
+        });
+  }
+
+  std::map<std::string, size_t> droppedMessages() const override {
+    return dropped_;
+  }
+
+ private:
+  SonarVirtualClock::duration transmitTime(size_t bytes) const {
+    if (conditions_.bytesPerSecond == 0) {
+      return SonarVirtualClock::duration(0);
+    }
+    return std::chrono::duration_cast<SonarVirtualClock::duration>(
+        std::chrono::nanoseconds(
+            int64_t(bytes) * 1000000000 / conditions_.bytesPerSecond));
+  }
+
+  void scheduleConnect(SonarVirtualClock::duration delay) {
+    const auto attempt = ++connectAttempt_;
+    clock_.schedule(delay + 2 * conditions_.latency, [this, attempt]() {
+      // Superseded by a later attempt, e.g. after connectivityChanged.
+      if (!started_ || open || attempt != connectAttempt_) {
+        return;
+      }
+      if (clock_.now() < linkUpAt_) {
+        stats_.failedConnects++;
+        scheduleConnect(backoff_.delay(attempts_++));
+        return;
+      }
+      attempts_ = 0;
+      stats_.connects++;
+      if (stats_.connects > 1) {
+        stats_.disconnectedTime += clock_.now() - closedAt_;
+      }
+      connection_++;
+      open = true;
+      if (callbacks) {
+        callbacks->onConnected();
+      }
+    });
+  }
+
+  void close() {
+    open = false;
+    // What is still on the link is lost with the connection.
+    connection_++;
+    closedAt_ = clock_.now();
+    linkFreeAt_ = closedAt_;
+    queuedBytes_.clear();
+    if (callbacks) {
+      callbacks->onDisconnected();
+    }
+  }
+
+  SonarVirtualClock& clock_;
+  const SonarLinkConditions conditions_;
+  const SonarBackoff backoff_;
+  Stats stats_;
+  bool started_ = false;
+  int attempts_ = 0;
+  uint64_t connectAttempt_ = 0;
+  uint64_t connection_ = 0;
+  SonarVirtualClock::time_point linkUpAt_;
+  SonarVirtualClock::time_point linkFreeAt_;
+  SonarVirtualClock::time_point closedAt_;
+  std::map<std::string, size_t> queuedBytes_;
+  std::map<std::string, size_t> dropped_;
+};
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,38 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <Sonar/SonarStreamResponder.h>
+#include <folly/json.h>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+
+class SonarStreamResponderMock : public SonarStreamResponder {
+ public:
+  void next(const folly::dynamic& chunk) override {
+    chunks.push_back(chunk);
+  }
+
+  void complete() override {
+    completed = true;
+  }
+
+  void error(const folly::dynamic& response) override {
+    errors.push_back(response);
+  }
+
+  std::vector<folly::dynamic> chunks;
+  std::vector<folly::dynamic> errors;
+  bool completed = false;
+};
+
+} // namespace sonar
+} // namespace facebook
@@ -36,10 +36,19 @@ class SonarWebSocketMock : public SonarWebSocket {
     return open;
   }
 
+  void connectivityChanged() override {}
+
+  using SonarWebSocket::sendMessage;
+  using SonarWebSocket::sendSerialized;
+
   void sendMessage(const folly::dynamic& message) override {
     messages.push_back(message);
   }
 
+  void sendSerialized(std::unique_ptr<folly::IOBuf> message) override {
+    messages.push_back(folly::parseJson(message->moveToFbString()));
+  }
+
   void setCallbacks(Callbacks* aCallbacks) override {
     callbacks = aCallbacks;
   }
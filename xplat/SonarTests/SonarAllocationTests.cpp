@@ -0,0 +1,181 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarClient.h>
+#include <SonarTestLib/SonarAllocationCounter.h>
+#include <SonarTestLib/SonarCountingWebSocket.h>
+#include <SonarTestLib/SonarPluginMock.h>
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+// Past the warm up of the caches and of the stats' largest messages.
+static constexpr int kWarmUpMessages = 20;
+
+struct AllocationFixture {
+  AllocationFixture() {
+    socket = new SonarCountingWebSocket;
+    client = std::make_unique<SonarClient>(
+        std::unique_ptr<SonarWebSocket>{socket},
+        std::make_shared<SonarState>());
+    const auto connectionCallback =
+        [this](std::shared_ptr<SonarConnection> conn) {
+          conn->receive(
+              "ignore", [](const dynamic&, std::unique_ptr<SonarResponder>) {});
+          connection = conn;
+        };
+    client->addPlugin(
+        std::make_shared<SonarPluginMock>("Test", connectionCallback));
+    client->start();
+    socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+        "params", dynamic::object("plugin", "Test")));
+  }
+
+  SonarCountingWebSocket* socket;
+  std::unique_ptr<SonarClient> client;
+  std::shared_ptr<SonarConnection> connection;
+};
+
+TEST(SonarAllocationTests, testCountsNew) {
+  SonarAllocationCounter counter;
+  auto value = std::make_unique<int64_t>(1);
+  std::vector<char> bytes(100);
+  EXPECT_EQ(counter.count(), 2u);
+  EXPECT_GE(counter.bytes(), sizeof(int64_t) + 100);
+
+  counter.stop();
+  std::string longer(1000, 'a');
+  EXPECT_EQ(counter.count(), 2u);
+}
+
+TEST(SonarAllocationTests, testCountsOnlyThisThread) {
+  SonarAllocationCounter counter;
+  std::thread other([]() {
+    SonarAllocationCounter otherCounter;
+    std::vector<std::unique_ptr<int>> values;
+    for (int i = 0; i < 10; i++) {
+      values.push_back(std::make_unique<int>(i));
+    }
+    EXPECT_GE(otherCounter.count(), 10u);
+  });
+  counter.stop();
+  const auto spawned = counter.count();
+  other.join();
+  EXPECT_EQ(counter.count(), spawned);
+  EXPECT_LT(spawned, 10u);
+}
+
+TEST(SonarAllocationTests, testNests) {
+  SonarAllocationCounter outer;
+  auto first = std::make_unique<int>(1);
+  {
+    SonarAllocationCounter inner;
+    auto second = std::make_unique<int>(2);
+    EXPECT_EQ(inner.count(), 1u);
+  }
+  EXPECT_EQ(outer.count(), 2u);
+}
+
+TEST(SonarAllocationTests, testRawEnvelopeBudget) {
+  AllocationFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const std::string params = "{\"value\":1}";
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.connection->sendRawAdmitted(
+        "event", folly::IOBuf::copyBuffer(params));
+  }
+
+  // The cached prefix's clone and the suffix wrapping a literal. The params
+  // are chained into the envelope, not copied.
+  auto buffer = folly::IOBuf::copyBuffer(params);
+  SonarAllocationCounter counter;
+  fixture.connection->sendRawAdmitted("event", std::move(buffer));
+  counter.stop();
+  EXPECT_LE(counter.count(), 2u);
+  EXPECT_EQ(fixture.socket->sent, size_t(kWarmUpMessages + 1));
+}
+
+TEST(SonarAllocationTests, testRawSendDoesNotCopyParams) {
+  AllocationFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const std::string small(16, 'a');
+  const std::string large(64 * 1024, 'a');
+  // Large first, so that small ones don't make the largest messages.
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.connection->sendRaw("event", folly::IOBuf::copyBuffer(large));
+  }
+
+  auto smallBuffer = folly::IOBuf::copyBuffer(small);
+  SonarAllocationCounter smallCounter;
+  fixture.connection->sendRaw("event", std::move(smallBuffer));
+  smallCounter.stop();
+
+  auto largeBuffer = folly::IOBuf::copyBuffer(large);
+  SonarAllocationCounter largeCounter;
+  fixture.connection->sendRaw("event", std::move(largeBuffer));
+  largeCounter.stop();
+
+  EXPECT_EQ(largeCounter.count(), smallCounter.count());
+  EXPECT_LT(largeCounter.bytes(), large.size());
+}
+
+TEST(SonarAllocationTests, testSendAllocationsDoNotGrow) {
+  AllocationFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const dynamic params = dynamic::object("id", 1)("name", "node")(
+      "children", dynamic::array(2, 3, 4));
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.connection->send("event", params);
+  }
+
+  SonarAllocationCounter first;
+  fixture.connection->send("event", params);
+  first.stop();
+  for (int i = 0; i < 10; i++) {
+    SonarAllocationCounter counter;
+    fixture.connection->send("event", params);
+    counter.stop();
+    EXPECT_LE(counter.count(), first.count()) << i;
+  }
+}
+
+TEST(SonarAllocationTests, testReceiveAllocationsDoNotGrow) {
+  AllocationFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const dynamic message = dynamic::object("method", "execute")(
+      "params",
+      dynamic::object("api", "Test")("method", "ignore")(
+          "params", dynamic::object("value", 1)));
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.socket->callbacks->onMessageReceived(message);
+  }
+
+  SonarAllocationCounter first;
+  fixture.socket->callbacks->onMessageReceived(message);
+  first.stop();
+  for (int i = 0; i < 10; i++) {
+    SonarAllocationCounter counter;
+    fixture.socket->callbacks->onMessageReceived(message);
+    counter.stop();
+    EXPECT_LE(counter.count(), first.count()) << i;
+  }
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,47 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarBase64.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+static std::string encode(folly::StringPiece data) {
+  return toBase64(folly::ByteRange(data));
+}
+
+TEST(SonarBase64Tests, testPadsShortInput) {
+  EXPECT_EQ(encode(""), "");
+  EXPECT_EQ(encode("f"), "Zg==");
+  EXPECT_EQ(encode("fo"), "Zm8=");
+  EXPECT_EQ(encode("foo"), "Zm9v");
+  EXPECT_EQ(encode("foob"), "Zm9vYg==");
+}
+
+TEST(SonarBase64Tests, testEncodesAllByteValues) {
+  // Long enough to go through the vectorized loop, with a remainder.
+  std::string data;
+  for (int i = 0; i < 256; i++) {
+    data.push_back(static_cast<char>(i));
+  }
+  const std::string encoded = encode(data);
+  ASSERT_EQ(encoded.size(), 344);
+  EXPECT_EQ(encoded.substr(0, 16), "AAECAwQFBgcICQoL");
+  EXPECT_EQ(encoded.substr(encoded.size() - 8), "/P3+/w==");
+
+  std::string appended = "x";
+  appendBase64(appended, folly::ByteRange(folly::StringPiece(data)));
+  EXPECT_EQ(appended, "x" + encoded);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
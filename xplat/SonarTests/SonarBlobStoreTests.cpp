@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarBlobStore.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+class ChunkCollector : public SonarStreamResponder {
+ public:
+  void next(const folly::dynamic& chunk) override {
+    json.push_back(chunk);
+  }
+
+  void nextBytes(std::unique_ptr<folly::IOBuf> chunk) override {
+    chunks.push_back(chunk->moveToFbString().toStdString());
+  }
+
+  void complete() override {
+    completed = true;
+  }
+
+  void error(const folly::dynamic& response) override {
+    errors.push_back(response);
+  }
+
+  std::vector<folly::dynamic> json;
+  std::vector<std::string> chunks;
+  std::vector<folly::dynamic> errors;
+  bool completed = false;
+};
+
+TEST(SonarBlobStoreTests, testStreamsBlobInChunks) {
+  SonarBlobStore blobs;
+  auto blob = folly::IOBuf::copyBuffer("0123456789");
+  blob->prependChain(folly::IOBuf::copyBuffer("abc"));
+  const auto id = blobs.put("Network", std::move(blob));
+  EXPECT_EQ(blobs.bytes(), 13);
+
+  ChunkCollector collector;
+  blobs.stream(id, 5, collector);
+  std::vector<std::string> expected{"01234", "56789", "abc"};
+  EXPECT_EQ(collector.chunks, expected);
+  EXPECT_TRUE(collector.json.empty());
+  EXPECT_TRUE(collector.completed);
+
+  // Blobs can be fetched again until released.
+  ChunkCollector again;
+  blobs.stream(id, 0, again);
+  EXPECT_EQ(again.chunks, std::vector<std::string>{"0123456789abc"});
+}
+
+TEST(SonarBlobStoreTests, testUnknownBlobsRespondWithError) {
+  SonarBlobStore blobs;
+  const auto id = blobs.put("Network", folly::IOBuf::copyBuffer("body"));
+  EXPECT_TRUE(blobs.release(id));
+  EXPECT_FALSE(blobs.release(id));
+
+  ChunkCollector collector;
+  blobs.stream(id, 0, collector);
+  blobs.stream("not a blob", 0, collector);
+  EXPECT_EQ(collector.errors.size(), 2);
+  EXPECT_FALSE(collector.completed);
+  EXPECT_EQ(blobs.bytes(), 0);
+}
+
+TEST(SonarBlobStoreTests, testEvictsOldestAndReleasesByPlugin) {
+  SonarBlobStore blobs(10);
+  const auto first = blobs.put("Network", folly::IOBuf::copyBuffer("12345"));
+  blobs.put("Inspector", folly::IOBuf::copyBuffer("12345"));
+  blobs.put("Network", folly::IOBuf::copyBuffer("12345"));
+  EXPECT_EQ(blobs.size(), 2);
+  EXPECT_EQ(blobs.bytes(), 10);
+  EXPECT_FALSE(blobs.release(first));
+
+  blobs.releaseAll("Network");
+  EXPECT_EQ(blobs.size(), 1);
+  EXPECT_EQ(blobs.bytes(), 5);
+}
+
+TEST(SonarBlobStoreTests, testShedsOldestFirst) {
+  SonarBlobStore blobs;
+  const auto first = blobs.put("Network", folly::IOBuf::copyBuffer("123"));
+  const auto second = blobs.put("Network", folly::IOBuf::copyBuffer("123"));
+  const auto third = blobs.put("Network", folly::IOBuf::copyBuffer("123"));
+
+  EXPECT_EQ(blobs.shed(4), 6);
+  EXPECT_FALSE(blobs.release(first));
+  EXPECT_FALSE(blobs.release(second));
+  EXPECT_EQ(blobs.shed(100), 3);
+  EXPECT_FALSE(blobs.release(third));
+}
+
+TEST(SonarBlobStoreTests, testJsonOnlyRespondersGetBase64) {
+  class JsonOnly : public ChunkCollector {
+   public:
+    void nextBytes(std::unique_ptr<folly::IOBuf> chunk) override {
+      SonarStreamResponder::nextBytes(std::move(chunk));
+    }
+  };
+  SonarBlobStore blobs;
+  JsonOnly collector;
+  const auto id = blobs.put("Network", folly::IOBuf::copyBuffer("hi"));
+  blobs.stream(id, 0, collector);
+  ASSERT_EQ(collector.json.size(), 1);
+  EXPECT_EQ(collector.json[0], folly::dynamic::object("base64", "aGk="));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
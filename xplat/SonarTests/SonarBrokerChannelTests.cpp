@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarBrokerChannel.h>
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using namespace std::chrono_literals;
+
+// Runs the event base until done() holds.
+static void loopUntil(
+    folly::EventBase& eventBase,
+    const std::function<bool()>& done) {
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (!done()) {
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    eventBase.loopOnce(EVLOOP_NONBLOCK);
+    std::this_thread::sleep_for(1ms);
+  }
+}
+
+class SonarBrokerChannelTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    peer = fds[0];
+    channel = std::make_unique<SonarBrokerChannel>(
+        folly::AsyncSocket::UniquePtr(
+            new folly::AsyncSocket(&eventBase, fds[1])),
+        [this](std::unique_ptr<folly::IOBuf> frame) {
+          received.push_back(frame->moveToFbString().toStdString());
+        },
+        [this]() { closed = true; });
+  }
+
+  void TearDown() override {
+    channel = nullptr;
+    if (peer >= 0) {
+      close(peer);
+    }
+  }
+
+  // A channel on the other end, for frames to go both ways.
+  std::unique_ptr<SonarBrokerChannel> peerChannel(
+      std::vector<std::string>* frames) {
+    const int fd = peer;
+    peer = -1;
+    return std::make_unique<SonarBrokerChannel>(
+        folly::AsyncSocket::UniquePtr(new folly::AsyncSocket(&eventBase, fd)),
+        [frames](std::unique_ptr<folly::IOBuf> frame) {
+          frames->push_back(frame->moveToFbString().toStdString());
+        },
+        []() {});
+  }
+
+  folly::EventBase eventBase;
+  int peer = -1;
+  std::unique_ptr<SonarBrokerChannel> channel;
+  std::vector<std::string> received;
+  bool closed = false;
+};
+
+TEST_F(SonarBrokerChannelTests, testFramesRoundTrip) {
+  std::vector<std::string> peerReceived;
+  auto other = peerChannel(&peerReceived);
+
+  // Bigger than a single read.
+  std::string large(200 * 1024, '\0');
+  for (size_t i = 0; i < large.size(); i++) {
+    large[i] = static_cast<char>(i % 251);
+  }
+  const std::vector<std::string> frames = {"", "{\"id\":1}", large, "last"};
+  for (const auto& frame : frames) {
+    other->send(folly::IOBuf::copyBuffer(frame));
+  }
+  channel->send(folly::IOBuf::copyBuffer("back"));
+
+  loopUntil(eventBase, [&]() {
+    return received.size() == frames.size() && peerReceived.size() == 1;
+  });
+  EXPECT_EQ(received, frames);
+  EXPECT_EQ(peerReceived, std::vector<std::string>({"back"}));
+  EXPECT_FALSE(closed);
+}
+
+TEST_F(SonarBrokerChannelTests, testClosesOnOversizedFrame) {
+  const uint8_t header[] = {0xff, 0xff, 0xff, 0xff};
+  ASSERT_EQ(
+      write(peer, header, sizeof(header)),
+      static_cast<ssize_t>(sizeof(header)));
+
+  loopUntil(eventBase, [&]() { return closed; });
+  EXPECT_TRUE(received.empty());
+  EXPECT_FALSE(channel->isOpen());
+}
+
+TEST_F(SonarBrokerChannelTests, testClosesWhenPeerCloses) {
+  close(peer);
+  peer = -1;
+
+  loopUntil(eventBase, [&]() { return closed; });
+  EXPECT_FALSE(channel->isOpen());
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,194 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarBroker.h>
+#include <Sonar/SonarBrokerSocket.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/json.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+using namespace std::chrono_literals;
+
+// Runs the event base until done() holds.
+static void loopUntil(
+    folly::EventBase& eventBase,
+    const std::function<bool()>& done) {
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (!done()) {
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    eventBase.loopOnce(EVLOOP_NONBLOCK);
+    std::this_thread::sleep_for(1ms);
+  }
+}
+
+// Another process of the app, connected to the broker as it would be.
+class BrokerProcess : public SonarWebSocket::Callbacks {
+ public:
+  BrokerProcess(
+      folly::EventBase& eventBase,
+      const std::string& path,
+      std::vector<std::string> plugins)
+      : plugins_(std::move(plugins)) {
+    SonarInitConfig config;
+    config.callbackWorker = &eventBase;
+    socket = std::make_unique<SonarBrokerSocket>(config, path);
+    socket->setCallbacks(this);
+    socket->start();
+  }
+
+  void onConnected() override {
+    connected = true;
+  }
+
+  void onDisconnected() override {
+    connected = false;
+  }
+
+  void onMessageReceived(const dynamic& message) override {
+    if (message.getDefault("method") == "getPlugins") {
+      dynamic plugins = dynamic::array;
+      for (const auto& plugin : plugins_) {
+        plugins.push_back(plugin);
+      }
+      socket->sendMessage(dynamic::object("id", message["id"])(
+          "success", dynamic::object("plugins", plugins)));
+      return;
+    }
+    received.push_back(message);
+  }
+
+  void onRequestReceived(const dynamic&, std::shared_ptr<SonarReply>)
+      override {}
+
+  void onStreamRequested(const dynamic&, std::shared_ptr<SonarStreamResponder>)
+      override {}
+
+  std::unique_ptr<SonarBrokerSocket> socket;
+  std::vector<dynamic> received;
+  bool connected = false;
+
+ private:
+  const std::vector<std::string> plugins_;
+};
+
+class SonarBrokerTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path = "/tmp/sonar-broker-test-" + std::to_string(getpid());
+    broker = std::make_shared<SonarBroker>(&eventBase, path);
+    broker->start([this](std::unique_ptr<folly::IOBuf> message) {
+      toDesktop.push_back(folly::parseJson(message->moveToFbString()));
+    });
+    broker->setDesktopConnected(true);
+  }
+
+  void TearDown() override {
+    broker->stop();
+    eventBase.loop();
+    unlink(path.c_str());
+  }
+
+  std::vector<std::string> plugins() {
+    auto plugins = broker->plugins();
+    std::sort(plugins.begin(), plugins.end());
+    return plugins;
+  }
+
+  bool refreshed() {
+    return std::count(
+               toDesktop.begin(),
+               toDesktop.end(),
+               dynamic::object("method", "refreshPlugins")) > 0;
+  }
+
+  static std::unique_ptr<folly::IOBuf> execute(const std::string& plugin) {
+    return folly::IOBuf::copyBuffer(folly::toJson(
+        dynamic::object("id", 1)("method", "execute")(
+            "params", dynamic::object("api", plugin)("method", "ping"))));
+  }
+
+  folly::EventBase eventBase;
+  std::string path;
+  std::shared_ptr<SonarBroker> broker;
+  std::vector<dynamic> toDesktop;
+};
+
+TEST_F(SonarBrokerTests, testListsPluginsOfProcesses) {
+  BrokerProcess first(eventBase, path, {"A"});
+  loopUntil(eventBase, [&]() { return plugins().size() == 1; });
+  EXPECT_TRUE(first.connected);
+  EXPECT_TRUE(refreshed());
+
+  // The plugins a process shares with an earlier one stay with the earlier.
+  BrokerProcess second(eventBase, path, {"A", "B"});
+  loopUntil(eventBase, [&]() { return plugins().size() == 2; });
+  EXPECT_EQ(plugins(), std::vector<std::string>({"A", "B"}));
+  EXPECT_TRUE(broker->forward("A", execute("A")));
+  loopUntil(eventBase, [&]() { return first.received.size() == 1; });
+  EXPECT_TRUE(second.received.empty());
+}
+
+TEST_F(SonarBrokerTests, testForwardsCallsToOwningProcess) {
+  BrokerProcess first(eventBase, path, {"A"});
+  BrokerProcess second(eventBase, path, {"B"});
+  loopUntil(eventBase, [&]() { return plugins().size() == 2; });
+
+  EXPECT_TRUE(broker->forward("B", execute("B")));
+  EXPECT_FALSE(broker->forward("C", execute("C")));
+  loopUntil(eventBase, [&]() { return second.received.size() == 1; });
+  EXPECT_EQ(second.received[0]["params"]["api"], "B");
+  EXPECT_TRUE(first.received.empty());
+
+  broker->broadcast(folly::IOBuf::copyBuffer(
+      folly::toJson(dynamic::object("method", "cancel"))));
+  loopUntil(eventBase, [&]() {
+    return first.received.size() == 1 && second.received.size() == 2;
+  });
+  EXPECT_EQ(first.received[0]["method"], "cancel");
+}
+
+TEST_F(SonarBrokerTests, testPassesMessagesOfProcessesToDesktop) {
+  BrokerProcess process(eventBase, path, {"A"});
+  loopUntil(eventBase, [&]() { return process.connected; });
+
+  const auto event = dynamic::object("method", "event")(
+      "params", dynamic::object("api", "A"));
+  process.socket->sendMessage(event);
+  loopUntil(eventBase, [&]() {
+    return std::count(toDesktop.begin(), toDesktop.end(), event) == 1;
+  });
+}
+
+TEST_F(SonarBrokerTests, testRemovesProcessOnClose) {
+  auto process = std::make_unique<BrokerProcess>(
+      eventBase, path, std::vector<std::string>({"A"}));
+  loopUntil(eventBase, [&]() { return plugins().size() == 1; });
+  toDesktop.clear();
+
+  process = nullptr;
+  loopUntil(eventBase, [&]() { return plugins().empty(); });
+  EXPECT_TRUE(refreshed());
+  EXPECT_FALSE(broker->forward("A", execute("A")));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
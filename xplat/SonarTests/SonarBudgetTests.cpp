@@ -0,0 +1,243 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarClient.h>
+#include <Sonar/SonarEventBuffer.h>
+#include <Sonar/SonarFanOutSocket.h>
+#include <Sonar/SonarMutex.h>
+#include <Sonar/SonarRawJson.h>
+#include <SonarTestLib/SonarCountingWebSocket.h>
+#include <SonarTestLib/SonarOpCounter.h>
+#include <SonarTestLib/SonarPluginMock.h>
+
+#include <folly/io/IOBuf.h>
+#include <folly/json.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Operation counts rather than times, so that they hold on any machine. A
+// change that makes one of these paths do more fails here, raise the budget
+// only if the extra work is worth it on every message.
+#if FB_SONAR_OP_COUNTING
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+// Past the warm up of the envelope prefixes and of the stats.
+static constexpr int kWarmUpMessages = 20;
+
+static dynamic init(const std::string& plugin) {
+  return dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", plugin));
+}
+
+static std::string execute(const std::string& method) {
+  return folly::toJson(dynamic::object("method", "execute")(
+      "params",
+      dynamic::object("api", "Test")("method", method)(
+          "params", dynamic::object("value", 1))));
+}
+
+struct BudgetFixture {
+  // A single desktop, which has initialized the plugin.
+  BudgetFixture() {
+    socket = new SonarCountingWebSocket;
+    start(std::unique_ptr<SonarWebSocket>(socket));
+    socket->callbacks->onMessageReceived(init("Test"));
+  }
+
+  explicit BudgetFixture(std::unique_ptr<SonarWebSocket> desktops) {
+    start(std::move(desktops));
+  }
+
+  void start(std::unique_ptr<SonarWebSocket> desktops) {
+    client = std::make_unique<SonarClient>(
+        std::move(desktops), std::make_shared<SonarState>());
+    const auto connectionCallback =
+        [this](std::shared_ptr<SonarConnection> conn) {
+          conn->receive(
+              "ignore", [](const dynamic&, std::unique_ptr<SonarResponder>) {});
+          conn->receiveRaw(
+              "ignoreRaw",
+              [](folly::StringPiece, std::unique_ptr<SonarResponder>) {});
+          connection = conn;
+        };
+    client->addPlugin(
+        std::make_shared<SonarPluginMock>("Test", connectionCallback));
+    client->start();
+  }
+
+  // Null for several desktops.
+  SonarCountingWebSocket* socket = nullptr;
+  std::unique_ptr<SonarClient> client;
+  std::shared_ptr<SonarConnection> connection;
+};
+
+TEST(SonarBudgetTests, testSendBudget) {
+  BudgetFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const dynamic params = dynamic::object("id", 1)("name", "node")(
+      "children", dynamic::array(2, 3, 4));
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.connection->send("event", params);
+  }
+  const auto sent = fixture.socket->sent;
+  const auto serialized = fixture.socket->serialized;
+
+  // Params serialized once straight into the envelope, whose prefix is
+  // looked up under the connection's envelope lock.
+  SonarOpCounter counter;
+  fixture.connection->send("event", params);
+  counter.stop();
+  EXPECT_EQ(counter.jsonEncodes(), 1u);
+  EXPECT_EQ(counter.jsonDecodes(), 0u);
+  EXPECT_LE(counter.lockAcquisitions(), 1u);
+  EXPECT_EQ(fixture.socket->sent, sent + 1);
+  EXPECT_EQ(fixture.socket->serialized, serialized + 1);
+}
+
+TEST(SonarBudgetTests, testRawSendBudget) {
+  BudgetFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const std::string params = "{\"value\":1}";
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.connection->sendRaw("event", folly::IOBuf::copyBuffer(params));
+  }
+  const auto sent = fixture.socket->sent;
+
+  auto buffer = folly::IOBuf::copyBuffer(params);
+  SonarOpCounter counter;
+  fixture.connection->sendRaw("event", std::move(buffer));
+  counter.stop();
+  EXPECT_EQ(counter.jsonEncodes(), 0u);
+  EXPECT_EQ(counter.jsonDecodes(), 0u);
+  EXPECT_LE(counter.lockAcquisitions(), 1u);
+  EXPECT_EQ(fixture.socket->sent, sent + 1);
+}
+
+TEST(SonarBudgetTests, testDrainSendsEachEventOnce) {
+  BudgetFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  constexpr size_t kEvents = 10;
+  SonarEventBuffer buffer(1024 * 1024);
+  for (size_t i = 0; i < kEvents; i++) {
+    buffer.append("event", folly::IOBuf::copyBuffer("{\"value\":1}"));
+  }
+  const auto sent = fixture.socket->sent;
+
+  // Buffered events are already serialized, they go out as they are.
+  SonarOpCounter counter;
+  buffer.drainTo(*fixture.connection);
+  counter.stop();
+  EXPECT_EQ(counter.jsonEncodes(), 0u);
+  EXPECT_EQ(counter.jsonDecodes(), 0u);
+  EXPECT_LE(counter.lockAcquisitions(), kEvents);
+  EXPECT_EQ(fixture.socket->sent, sent + kEvents);
+}
+
+TEST(SonarBudgetTests, testReceiveBudget) {
+  BudgetFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const auto message = folly::parseJson(execute("ignore"));
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.socket->callbacks->onMessageReceived(message);
+  }
+
+  // Only the receiver's lookup is locked.
+  SonarOpCounter counter;
+  fixture.socket->callbacks->onMessageReceived(message);
+  counter.stop();
+  EXPECT_EQ(counter.jsonEncodes(), 0u);
+  EXPECT_EQ(counter.jsonDecodes(), 0u);
+  EXPECT_LE(counter.lockAcquisitions(), 1u);
+}
+
+TEST(SonarBudgetTests, testRawReceiveBudget) {
+  BudgetFixture fixture;
+  ASSERT_TRUE(fixture.connection);
+  const auto parsed = SonarRawJson::fromString(execute("ignore"));
+  const auto raw = SonarRawJson::fromString(execute("ignoreRaw"));
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.socket->callbacks->onRawMessageReceived(parsed);
+    fixture.socket->callbacks->onRawMessageReceived(raw);
+  }
+
+  // The envelope is scanned, only the params are parsed, and only for a
+  // receiver that takes them parsed.
+  SonarOpCounter parsedCounter;
+  fixture.socket->callbacks->onRawMessageReceived(parsed);
+  parsedCounter.stop();
+  EXPECT_EQ(parsedCounter.jsonEncodes(), 0u);
+  EXPECT_EQ(parsedCounter.jsonDecodes(), 1u);
+  EXPECT_LE(parsedCounter.lockAcquisitions(), 1u);
+
+  SonarOpCounter rawCounter;
+  fixture.socket->callbacks->onRawMessageReceived(raw);
+  rawCounter.stop();
+  EXPECT_EQ(rawCounter.jsonEncodes(), 0u);
+  EXPECT_EQ(rawCounter.jsonDecodes(), 0u);
+  EXPECT_LE(rawCounter.lockAcquisitions(), 1u);
+}
+
+TEST(SonarBudgetTests, testFanOutSerializesOnce) {
+  auto first = std::make_unique<SonarCountingWebSocket>();
+  auto second = std::make_unique<SonarCountingWebSocket>();
+  const auto main = first.get();
+  const auto other = second.get();
+  std::vector<std::unique_ptr<SonarWebSocket>> sockets;
+  sockets.push_back(std::move(first));
+  sockets.push_back(std::move(second));
+  BudgetFixture fixture(
+      std::make_unique<SonarFanOutSocket>(std::move(sockets)));
+  main->callbacks->onMessageReceived(init("Test"));
+  other->callbacks->onMessageReceived(init("Test"));
+  ASSERT_TRUE(fixture.connection);
+  const dynamic params = dynamic::object("value", 1);
+  for (int i = 0; i < kWarmUpMessages; i++) {
+    fixture.connection->send("event", params);
+  }
+  const auto mainSent = main->sent;
+  const auto otherSent = other->sent;
+
+  // Serialized once, each desktop sends the same buffer.
+  SonarOpCounter counter;
+  fixture.connection->send("event", params);
+  counter.stop();
+  EXPECT_EQ(counter.jsonEncodes(), 1u);
+  EXPECT_EQ(counter.jsonDecodes(), 0u);
+  EXPECT_EQ(main->sent, mainSent + 1);
+  EXPECT_EQ(other->sent, otherSent + 1);
+}
+
+TEST(SonarBudgetTests, testCountsOnlyThisThread) {
+  SonarOpCounter counter;
+  std::thread other([]() {
+    SonarMutex mutex("SonarBudgetTests");
+    SonarLockGuard lock(mutex, SONAR_LOCK_SITE);
+  });
+  other.join();
+  EXPECT_EQ(counter.lockAcquisitions(), 0u);
+
+  SonarMutex mutex("SonarBudgetTests");
+  {
+    SonarLockGuard lock(mutex, SONAR_LOCK_SITE);
+  }
+  EXPECT_EQ(counter.lockAcquisitions(), 1u);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
+
+#endif
@@ -7,11 +7,16 @@
  */
 
 #include <Sonar/SonarClient.h>
+#include <Sonar/SonarDiagnosticsPlugin.h>
+#include <Sonar/SonarOfflineCapture.h>
 #include <SonarTestLib/SonarPluginMock.h>
+#include <SonarTestLib/SonarStreamResponderMock.h>
 #include <SonarTestLib/SonarWebSocketMock.h>
 
 #include <folly/json.h>
 #include <gtest/gtest.h>
+#include <set>
+#include <vector>
 
 namespace facebook {
 namespace sonar {
@@ -70,6 +75,37 @@ TEST(SonarClientTests, testGetPluginWithDowncast) {
   EXPECT_EQ(catPlugin, client.getPlugin<SonarPluginMock>("Cat"));
 }
 
+TEST(SonarClientTests, testPluginFactoryBuildsOnInit) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  int built = 0;
+  int connected = 0;
+  client.addPluginFactory("Lazy", [&]() {
+    built++;
+    return std::make_shared<SonarPluginMock>(
+        "Lazy", [&](std::shared_ptr<SonarConnection>) { connected++; });
+  });
+
+  socket->callbacks->onMessageReceived(
+      dynamic::object("id", 1)("method", "getPlugins"));
+  EXPECT_EQ(
+      socket->messages.back()["success"]["plugins"], dynamic::array("Lazy"));
+  EXPECT_EQ(built, 0);
+
+  const auto init = dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Lazy"));
+  socket->callbacks->onMessageReceived(init);
+  socket->callbacks->onMessageReceived(dynamic::object("method", "deinit")(
+      "params", dynamic::object("plugin", "Lazy")));
+  socket->callbacks->onMessageReceived(init);
+  EXPECT_EQ(built, 1);
+  EXPECT_EQ(connected, 2);
+  EXPECT_EQ(client.getPlugin("Lazy")->identifier(), "Lazy");
+  EXPECT_EQ(built, 1);
+}
+
 TEST(SonarClientTests, testRemovePlugin) {
   auto socket = new SonarWebSocketMock;
   SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
@@ -159,6 +195,39 @@ TEST(SonarClientTests, testInitDeinit) {
   EXPECT_FALSE(pluginConnected);
 }
 
+TEST(SonarClientTests, testInitManyDeinitMany) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  std::set<std::string> connected;
+  const auto plugin = [&](const std::string& identifier) {
+    return std::make_shared<SonarPluginMock>(
+        identifier,
+        [&connected, identifier](std::shared_ptr<SonarConnection>) {
+          connected.insert(identifier);
+        },
+        [&connected, identifier]() { connected.erase(identifier); });
+  };
+  client.start();
+  client.addPlugins({plugin("A"), plugin("B"), plugin("C")});
+
+  dynamic initMany = dynamic::object("id", 1)("method", "initMany")(
+      "params", dynamic::object("plugins", dynamic::array("A", "B", "Z")));
+  socket->callbacks->onMessageReceived(initMany);
+  EXPECT_EQ(connected, (std::set<std::string>{"A", "B"}));
+  dynamic expected = dynamic::object("id", 1)(
+      "success", dynamic::object("missing", dynamic::array("Z")));
+  EXPECT_EQ(socket->messages.back(), expected);
+
+  dynamic deinitMany = dynamic::object("method", "deinitMany")(
+      "params", dynamic::object("plugins", dynamic::array("A", "C")));
+  socket->callbacks->onMessageReceived(deinitMany);
+  EXPECT_EQ(connected, std::set<std::string>{"B"});
+
+  client.stop();
+  EXPECT_TRUE(connected.empty());
+}
+
 TEST(SonarClientTests, testRemovePluginWhenConnected) {
   auto socket = new SonarWebSocketMock;
   SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
@@ -180,6 +249,26 @@ TEST(SonarClientTests, testRemovePluginWhenConnected) {
   EXPECT_EQ(socket->messages.back(), expected);
 }
 
+TEST(SonarClientTests, testAddPluginsRefreshesOnce) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  client.addPlugins({std::make_shared<SonarPluginMock>("A"),
+                     std::make_shared<SonarPluginMock>("B"),
+                     std::make_shared<SonarPluginMock>("C")});
+  EXPECT_TRUE(client.hasPlugin("A"));
+  EXPECT_TRUE(client.hasPlugin("C"));
+  dynamic expected = dynamic::object("method", "refreshPlugins");
+  ASSERT_EQ(socket->messages.size(), 1);
+  EXPECT_EQ(socket->messages.front(), expected);
+
+  // One plugin already added, none of them are.
+  client.addPlugins({std::make_shared<SonarPluginMock>("D"),
+                     std::make_shared<SonarPluginMock>("A")});
+  EXPECT_FALSE(client.hasPlugin("D"));
+}
+
 TEST(SonarClientTests, testUnhandleableMethod) {
   auto socket = new SonarWebSocketMock;
   SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
@@ -230,6 +319,158 @@ TEST(SonarClientTests, testExecute) {
   EXPECT_EQ(socket->messages.back(), expected);
 }
 
+class BackgroundPluginMock : public SonarPluginMock {
+ public:
+  using SonarPluginMock::SonarPluginMock;
+
+  bool runInBackground() override {
+    return true;
+  }
+};
+
+TEST(SonarClientTests, testReplaysCapturedEventsOnInit) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.enableOfflineCapture(
+      std::make_shared<SonarOfflineCapture>("SonarClientTestsCapture", 4096),
+      nullptr,
+      0);
+
+  std::shared_ptr<SonarConnection> connection;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    connection = conn;
+  };
+  auto plugin =
+      std::make_shared<BackgroundPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+  ASSERT_NE(connection, nullptr);
+  connection->send("captured", dynamic::object("value", 1));
+  EXPECT_TRUE(socket->messages.empty());
+
+  client.start();
+  dynamic messageInit = dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test"));
+  socket->callbacks->onMessageReceived(messageInit);
+
+  dynamic expected = dynamic::object("method", "execute")(
+      "params",
+      dynamic::object("api", "Test")("method", "captured")(
+          "params", dynamic::object("value", 1)));
+  EXPECT_EQ(socket->messages.back(), expected);
+}
+
+TEST(SonarClientTests, testSendsOnlySubscribedEvents) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  std::shared_ptr<SonarConnection> connection;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    connection = conn;
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  ASSERT_NE(connection, nullptr);
+  EXPECT_TRUE(connection->isSubscribed("ignored"));
+
+  socket->callbacks->onMessageReceived(
+      dynamic::object("method", "setSubscriptions")(
+          "params",
+          dynamic::object("plugin", "Test")(
+              "methods", dynamic::array("wanted"))));
+  EXPECT_FALSE(connection->isSubscribed("ignored"));
+  const auto sentBefore = socket->messages.size();
+  connection->send("ignored", dynamic::object("value", 1));
+  connection->send("wanted", dynamic::object("value", 2));
+  ASSERT_EQ(socket->messages.size(), sentBefore + 1);
+  EXPECT_EQ(socket->messages.back()["params"]["method"], "wanted");
+
+  socket->callbacks->onMessageReceived(
+      dynamic::object("method", "setSubscriptions")(
+          "params", dynamic::object("plugin", "Test")("methods", nullptr)));
+  EXPECT_TRUE(connection->isSubscribed("ignored"));
+}
+
+TEST(SonarClientTests, testSendsDeltas) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  std::shared_ptr<SonarConnection> connection;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    connection = conn;
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  ASSERT_NE(connection, nullptr);
+  connection->sendDeltas("frame", 2);
+
+  const auto frame = [](int fps) {
+    return dynamic::object("fps", fps)("device", "Pixel")(
+        "memory", dynamic::object("heap", 100)("native", 50));
+  };
+  connection->send("frame", frame(60));
+  EXPECT_EQ(socket->messages.back()["params"]["params"], frame(60));
+  EXPECT_EQ(
+      socket->messages.back()["params"]["delta"],
+      dynamic::object("sequence", 1)("keyframe", true));
+
+  connection->send("frame", frame(58));
+  EXPECT_EQ(
+      socket->messages.back()["params"]["params"], dynamic::object("fps", 58));
+  EXPECT_EQ(socket->messages.back()["params"]["delta"]["keyframe"], false);
+
+  // Every second event is a keyframe.
+  connection->send("frame", frame(57));
+  EXPECT_EQ(socket->messages.back()["params"]["params"], frame(57));
+
+  // Other methods go out as they are.
+  connection->send("other", dynamic::object("value", 1));
+  EXPECT_EQ(socket->messages.back()["params"].count("delta"), 0);
+}
+
+TEST(SonarClientTests, testSendLazyOnlyBuildsWantedEvents) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  std::shared_ptr<SonarConnection> connection;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    connection = conn;
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  socket->callbacks->onMessageReceived(
+      dynamic::object("method", "setSubscriptions")(
+          "params",
+          dynamic::object("plugin", "Test")(
+              "methods", dynamic::array("wanted"))));
+  ASSERT_NE(connection, nullptr);
+
+  int built = 0;
+  const auto builder = [&]() {
+    built++;
+    return dynamic::object("value", built);
+  };
+  const auto sentBefore = socket->messages.size();
+  connection->sendLazy("ignored", builder);
+  EXPECT_EQ(built, 0);
+  connection->sendLazy("wanted", builder);
+  EXPECT_EQ(built, 1);
+  ASSERT_EQ(socket->messages.size(), sentBefore + 1);
+  EXPECT_EQ(socket->messages.back()["params"]["params"]["value"], 1);
+
+  socket->open = false;
+  connection->sendLazy("wanted", builder);
+  EXPECT_EQ(built, 1);
+}
+
 TEST(SonarClientTests, testExecuteWithParams) {
   auto socket = new SonarWebSocketMock;
   SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
@@ -263,6 +504,551 @@ TEST(SonarClientTests, testExecuteWithParams) {
   EXPECT_EQ(socket->messages.back(), expected);
 }
 
+TEST(SonarClientTests, testExecuteRawMessage) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    const auto receiver = [](const dynamic &params,
+                             std::unique_ptr<SonarResponder> responder) {
+      responder->success(dynamic::object("echo", params["value"]));
+    };
+    conn->receive("echo", receiver);
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+
+  socket->callbacks->onRawMessageReceived(SonarRawJson::fromString(
+      R"({"method": "init", "params": {"plugin": "Test"}})"));
+  socket->callbacks->onRawMessageReceived(SonarRawJson::fromString(
+      R"({"id": 1, "method": "execute", "params": {"api": "Test",)"
+      R"( "method": "echo", "params": {"value": [1, "}"]}}})"));
+
+  dynamic expected = dynamic::object("id", 1)(
+      "success", dynamic::object("echo", dynamic::array(1, "}")));
+  EXPECT_EQ(socket->messages.back(), expected);
+}
+
+TEST(SonarClientTests, testExecuteRawReceiver) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    const auto receiver = [](folly::StringPiece params,
+                             std::unique_ptr<SonarResponder> responder) {
+      responder->success(dynamic::object("raw", params.str()));
+    };
+    conn->receiveRaw("echo", receiver);
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+
+  socket->callbacks->onRawMessageReceived(SonarRawJson::fromString(
+      R"({"method": "init", "params": {"plugin": "Test"}})"));
+  socket->callbacks->onRawMessageReceived(SonarRawJson::fromString(
+      R"({"id": 1, "method": "execute", "params": {"api": "Test",)"
+      R"( "method": "echo", "params": {"value":  1}}})"));
+
+  dynamic expected = dynamic::object("id", 1)(
+      "success", dynamic::object("raw", R"({"value":  1})"));
+  EXPECT_EQ(socket->messages.back(), expected);
+}
+
+TEST(SonarClientTests, testExecuteAsyncReceiver) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  std::vector<folly::Promise<dynamic>> pending;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    conn->receiveAsync("later", [&](const dynamic& params) {
+      pending.emplace_back();
+      return pending.back().getSemiFuture();
+    });
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  for (int id : {1, 2}) {
+    socket->callbacks->onMessageReceived(
+        dynamic::object("id", id)("method", "execute")(
+            "params", dynamic::object("api", "Test")("method", "later")));
+  }
+  const auto sent = socket->messages.size();
+  ASSERT_EQ(pending.size(), 2);
+
+  // Answered when their futures complete, in whatever order that is.
+  pending[1].setValue(dynamic::object("value", 2));
+  EXPECT_EQ(socket->messages.size(), sent + 1);
+  EXPECT_EQ(
+      socket->messages.back(),
+      dynamic::object("id", 2)("success", dynamic::object("value", 2)));
+
+  pending[0].setException(std::runtime_error("gone"));
+  EXPECT_EQ(socket->messages.back().getDefault("id"), 1);
+  EXPECT_TRUE(socket->messages.back().count("error"));
+}
+
+static dynamic streamRequest(
+    const std::string& api,
+    const std::string& method) {
+  return dynamic::object("method", "execute")(
+      "params",
+      dynamic::object("api", api)("method", method)(
+          "params", dynamic::object("count", 2)));
+}
+
+TEST(SonarClientTests, testStreamRequestRoutedToReceiver) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    conn->receiveStream(
+        "count",
+        [](const dynamic& params,
+           std::shared_ptr<SonarStreamResponder> responder) {
+          for (int i = 0; i < params["count"].asInt(); i++) {
+            responder->next(i);
+          }
+          responder->complete();
+        });
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+
+  auto responder = std::make_shared<SonarStreamResponderMock>();
+  socket->callbacks->onStreamRequested(
+      streamRequest("Test", "count"), responder);
+
+  EXPECT_EQ(responder->chunks, std::vector<dynamic>({0, 1}));
+  EXPECT_TRUE(responder->completed);
+  EXPECT_TRUE(responder->errors.empty());
+}
+
+TEST(SonarClientTests, testStreamRequestForUnknownPlugin) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  auto responder = std::make_shared<SonarStreamResponderMock>();
+  socket->callbacks->onStreamRequested(
+      streamRequest("Missing", "count"), responder);
+
+  ASSERT_EQ(responder->errors.size(), 1);
+  EXPECT_EQ(
+      responder->errors[0],
+      dynamic::object(
+          "message", "connection Missing not found for stream request"));
+}
+
+TEST(SonarClientTests, testStreamRequestForUnknownReceiver) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  client.addPlugin(std::make_shared<SonarPluginMock>("Test"));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+
+  auto responder = std::make_shared<SonarStreamResponderMock>();
+  socket->callbacks->onStreamRequested(
+      streamRequest("Test", "count"), responder);
+
+  ASSERT_EQ(responder->errors.size(), 1);
+  EXPECT_EQ(
+      responder->errors[0],
+      dynamic::object("message", "stream receiver count not found."));
+  EXPECT_TRUE(responder->chunks.empty());
+}
+
+TEST(SonarClientTests, testCancelInFlightRequest) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  std::unique_ptr<SonarResponder> pending;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    conn->receive(
+        "slow",
+        [&](const dynamic& params, std::unique_ptr<SonarResponder> responder) {
+          pending = std::move(responder);
+        });
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  socket->callbacks->onMessageReceived(
+      dynamic::object("id", 1)("method", "execute")(
+          "params", dynamic::object("api", "Test")("method", "slow")));
+  ASSERT_TRUE(pending != nullptr);
+  const auto token = pending->cancellationToken();
+  EXPECT_FALSE(token.isCancellationRequested());
+
+  socket->callbacks->onMessageReceived(dynamic::object("id", 2)(
+      "method", "cancel")("params", dynamic::object("id", 1)));
+  EXPECT_TRUE(token.isCancellationRequested());
+  const auto count = socket->messages.size();
+  ASSERT_TRUE(count >= 2);
+  EXPECT_EQ(socket->messages[count - 2].getDefault("id"), 1);
+  EXPECT_EQ(
+      socket->messages[count - 2]["error"].getDefault("cancelled"), true);
+  EXPECT_EQ(
+      socket->messages.back(),
+      dynamic::object("id", 2)("success", dynamic::object("cancelled", true)));
+
+  // The abandoned receiver's late response isn't sent.
+  pending->success(dynamic::object());
+  EXPECT_EQ(socket->messages.size(), count);
+}
+
+class ReplyMock : public SonarReply {
+ public:
+  void success(const dynamic& response) override {
+    responses.push_back(dynamic::object("success", response));
+  }
+
+  void successSerialized(std::unique_ptr<folly::IOBuf> response) override {
+    success(folly::parseJson(response->moveToFbString()));
+  }
+
+  void error(const dynamic& response) override {
+    responses.push_back(dynamic::object("error", response));
+  }
+
+  void setCancelHandler(std::function<void()> handler) override {
+    cancel = std::move(handler);
+  }
+
+  std::vector<dynamic> responses;
+  std::function<void()> cancel;
+};
+
+TEST(SonarClientTests, testExecuteRequestResponse) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  const auto connectionCallback = [](std::shared_ptr<SonarConnection> conn) {
+    conn->receive(
+        "hello",
+        [](const dynamic& params, std::unique_ptr<SonarResponder> responder) {
+          responder->success(dynamic::object("message", "hi"));
+        });
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  const auto count = socket->messages.size();
+
+  auto reply = std::make_shared<ReplyMock>();
+  socket->callbacks->onRequestReceived(
+      dynamic::object("method", "execute")(
+          "params", dynamic::object("api", "Test")("method", "hello")),
+      reply);
+
+  // Answered through the reply, not with a message of its own.
+  EXPECT_EQ(socket->messages.size(), count);
+  ASSERT_EQ(reply->responses.size(), 1);
+  EXPECT_EQ(
+      reply->responses[0],
+      dynamic::object("success", dynamic::object("message", "hi")));
+}
+
+TEST(SonarClientTests, testCancelRequestResponse) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  std::unique_ptr<SonarResponder> pending;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    conn->receive(
+        "slow",
+        [&](const dynamic& params, std::unique_ptr<SonarResponder> responder) {
+          pending = std::move(responder);
+        });
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+
+  auto reply = std::make_shared<ReplyMock>();
+  socket->callbacks->onRequestReceived(
+      dynamic::object("method", "execute")(
+          "params", dynamic::object("api", "Test")("method", "slow")),
+      reply);
+  ASSERT_TRUE(pending != nullptr);
+  ASSERT_TRUE(reply->cancel != nullptr);
+  const auto token = pending->cancellationToken();
+
+  reply->cancel();
+  EXPECT_TRUE(token.isCancellationRequested());
+  pending->success(dynamic::object());
+  pending = nullptr;
+  // Completed as dropped, which the cancelled request ignores.
+  ASSERT_EQ(reply->responses.size(), 1);
+  EXPECT_TRUE(reply->responses[0].count("error"));
+}
+
+TEST(SonarClientTests, testGetTimeline) {
+  auto socket = new SonarWebSocketMock;
+  auto timelineState = std::make_shared<SonarState>();
+  SonarClient client(
+      std::unique_ptr<SonarWebSocketMock>{socket}, timelineState);
+  timelineState->start("Connect")->complete();
+  timelineState->start("Exchange certificates")->fail("Refused");
+  timelineState->start("Connect")->complete();
+
+  socket->callbacks->onMessageReceived(
+      dynamic::object("id", 1)("method", "getTimeline"));
+  const auto timeline = socket->messages.back()["success"];
+  const auto& names = timeline["names"];
+  const auto& steps = timeline["steps"];
+  ASSERT_EQ(steps.size() % SonarClient::kTimelineFields, 0);
+  const auto count = steps.size() / SonarClient::kTimelineFields;
+  ASSERT_GE(count, 3);
+  // The steps recorded here are the last ones, names are listed once.
+  const auto last = [&](size_t fromEnd, size_t field) {
+    return steps[(count - fromEnd) * SonarClient::kTimelineFields + field];
+  };
+  EXPECT_EQ(names[last(3, 0).asInt()], "Connect");
+  EXPECT_EQ(last(3, 0), last(1, 0));
+  EXPECT_EQ(names[last(2, 0).asInt()], "Exchange certificates");
+  EXPECT_EQ(last(2, 1), static_cast<int64_t>(State::failed));
+  EXPECT_EQ(
+      timeline["errors"][folly::to<std::string>(count - 2)], "Refused");
+  EXPECT_LE(last(3, 2).asInt(), last(1, 2).asInt());
+  EXPECT_GE(last(1, 3).asInt(), 0);
+  EXPECT_GT(timeline["origin"].asInt(), 0);
+}
+
+TEST(SonarClientTests, testAnswersEvictedRequest) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.setInFlightRequests(std::make_shared<SonarInFlightRequests>(
+      1, std::chrono::milliseconds(0)));
+
+  std::vector<std::unique_ptr<SonarResponder>> pending;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    conn->receive(
+        "slow",
+        [&](const dynamic& params, std::unique_ptr<SonarResponder> responder) {
+          pending.push_back(std::move(responder));
+        });
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  for (int64_t id = 1; id <= 2; id++) {
+    socket->callbacks->onMessageReceived(
+        dynamic::object("id", id)("method", "execute")(
+            "params", dynamic::object("api", "Test")("method", "slow")));
+  }
+  ASSERT_EQ(pending.size(), 2);
+  EXPECT_TRUE(pending[0]->cancellationToken().isCancellationRequested());
+  EXPECT_EQ(socket->messages.back().getDefault("id"), 1);
+  EXPECT_EQ(
+      socket->messages.back()["error"],
+      dynamic::object("message", "Too many requests in flight")(
+          "method", "Test.slow")("expired", true));
+
+  const auto count = socket->messages.size();
+  pending[0]->success(dynamic::object());
+  EXPECT_EQ(socket->messages.size(), count);
+  pending[1]->success(dynamic::object());
+  EXPECT_EQ(socket->messages.back().getDefault("id"), 2);
+  EXPECT_EQ(
+      client.getMetrics()["requests"]["methods"]["Test.slow"]["count"], 1);
+}
+
+TEST(SonarClientTests, testCachedResponses) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  int calls = 0;
+  std::shared_ptr<SonarConnection> connection;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    connection = conn;
+    conn->cacheResponses("getRoot");
+    conn->receive(
+        "getRoot",
+        [&](const dynamic& params, std::unique_ptr<SonarResponder> responder) {
+          responder->success(dynamic::object("calls", ++calls));
+        });
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  const auto getRoot = [&](int id) {
+    socket->callbacks->onMessageReceived(
+        dynamic::object("id", id)("method", "execute")(
+            "params", dynamic::object("api", "Test")("method", "getRoot")));
+    return socket->messages.back();
+  };
+
+  EXPECT_EQ(
+      getRoot(1),
+      dynamic::object("id", 1)("success", dynamic::object("calls", 1)));
+  EXPECT_EQ(
+      getRoot(2),
+      dynamic::object("id", 2)("success", dynamic::object("calls", 1)));
+  EXPECT_EQ(calls, 1);
+
+  connection->invalidateCachedResponses("getRoot");
+  EXPECT_EQ(
+      getRoot(3),
+      dynamic::object("id", 3)("success", dynamic::object("calls", 2)));
+}
+
+TEST(SonarClientTests, testDiagnosticsPluginReportsMetrics) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    const auto receiver = [](folly::StringPiece params,
+                             std::unique_ptr<SonarResponder> responder) {
+      responder->success(dynamic::object());
+    };
+    conn->receiveRaw("echo", receiver);
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  client.addPlugin(std::make_shared<SonarDiagnosticsPlugin>(
+      [&]() { return client.getMetrics(); }));
+
+  for (const auto& plugin : {"Test", "Diagnostics"}) {
+    socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+        "params", dynamic::object("plugin", plugin)));
+  }
+  socket->callbacks->onRawMessageReceived(SonarRawJson::fromString(
+      R"({"id": 1, "method": "execute", "params": {"api": "Test",)"
+      R"( "method": "echo", "params": {"value": 1}}})"));
+  socket->callbacks->onMessageReceived(dynamic::object("id", 2)(
+      "method", "execute")(
+      "params", dynamic::object("api", "Diagnostics")("method", "getMetrics")));
+
+  const auto& metrics = socket->messages.back()["success"]["plugins"]["Test"];
+  EXPECT_EQ(metrics["messagesIn"], 1);
+  EXPECT_EQ(metrics["bytesIn"], 12);
+  EXPECT_EQ(metrics["responses"], 1);
+  EXPECT_EQ(metrics["errors"], 0);
+  EXPECT_EQ(metrics["queueDepth"], 0);
+  EXPECT_EQ(metrics["maxQueueDepth"], 1);
+  EXPECT_EQ(metrics["dropped"], 0);
+  EXPECT_EQ(
+      metrics["responseLatency"].size(), SonarConnectionStats::kLatencyBuckets);
+  EXPECT_EQ(metrics["methods"]["echo"]["calls"], 1);
+  EXPECT_GE(metrics["methods"]["echo"]["cpuMicros"].asInt(), 0);
+}
+
+TEST(SonarClientTests, testReportsLargestMessages) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  std::shared_ptr<SonarConnection> connection;
+  client.addPlugin(std::make_shared<SonarPluginMock>(
+      "Test", [&](std::shared_ptr<SonarConnection> conn) {
+        connection = conn;
+      }));
+  socket->callbacks->onMessageReceived(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  ASSERT_NE(connection, nullptr);
+
+  connection->send("small", dynamic::object("value", 1));
+  connection->send("large", dynamic::object("value", std::string(1000, 'x')));
+
+  const auto metrics = client.getMetrics();
+  const auto& largest = metrics["largestMessages"];
+  ASSERT_EQ(largest.size(), 2);
+  EXPECT_EQ(largest[0]["plugin"], "Test");
+  EXPECT_EQ(largest[0]["method"], "large");
+  EXPECT_GT(largest[0]["bytes"].asInt(), 1000);
+  EXPECT_EQ(largest[1]["method"], "small");
+  const auto& sizes =
+      metrics["plugins"]["Test"]["methods"]["large"]["sentSizes"];
+  EXPECT_EQ(sizes.size(), SonarConnectionStats::kSizeBuckets);
+  // The 1012 bytes of params are between 512 and 1024.
+  EXPECT_EQ(sizes[4], 1);
+  EXPECT_EQ(sizes[5], 0);
+}
+
+TEST(SonarClientTests, testReceiverRunsOutsideClientLock) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    const auto receiver = [&](const dynamic &params,
+                              std::unique_ptr<SonarResponder> responder) {
+      // Would deadlock if receivers were still called under the client lock.
+      dynamic payload = dynamic::object("hasPlugin", client.hasPlugin("Test"));
+      responder->success(payload);
+    };
+    conn->receive("lookup", receiver);
+  };
+  auto plugin = std::make_shared<SonarPluginMock>("Test", connectionCallback);
+  client.addPlugin(plugin);
+
+  dynamic messageInit = dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test"));
+  socket->callbacks->onMessageReceived(messageInit);
+
+  dynamic messageExecute = dynamic::object("id", 1)("method", "execute")(
+      "params", dynamic::object("api", "Test")("method", "lookup"));
+  socket->callbacks->onMessageReceived(messageExecute);
+
+  dynamic expected = dynamic::object("id", 1)(
+      "success", dynamic::object("hasPlugin", true));
+  EXPECT_EQ(socket->messages.back(), expected);
+}
+
+TEST(SonarClientTests, testDisconnectRunsOutsideClientLock) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  const auto disconnectionCallback = [&]() {
+    // Would deadlock if plugins were still disconnected under the client
+    // lock.
+    client.addPlugin(std::make_shared<SonarPluginMock>("Other"));
+  };
+  auto plugin = std::make_shared<SonarPluginMock>(
+      "Test", [](std::shared_ptr<SonarConnection>) {}, disconnectionCallback);
+  client.addPlugin(plugin);
+
+  dynamic messageInit = dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test"));
+  socket->callbacks->onMessageReceived(messageInit);
+
+  client.stop();
+  EXPECT_TRUE(client.hasPlugin("Other"));
+}
+
+TEST(SonarClientTests, testExceptionUnknownReceiver) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
+  client.start();
+
+  auto plugin = std::make_shared<SonarPluginMock>("Test");
+  client.addPlugin(plugin);
+
+  dynamic messageInit = dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test"));
+  socket->callbacks->onMessageReceived(messageInit);
+
+  dynamic messageExecute = dynamic::object("id", 1)("method", "execute")(
+      "params", dynamic::object("api", "Test")("method", "unknown"));
+  socket->callbacks->onMessageReceived(messageExecute);
+
+  EXPECT_EQ(socket->messages.back()["error"]["message"],
+            "receiver unknown not found.");
+}
+
 TEST(SonarClientTests, testExceptionUnknownPlugin) {
   auto socket = new SonarWebSocketMock;
   SonarClient client(std::unique_ptr<SonarWebSocketMock>{socket}, state);
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarDeltaEncoder.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+TEST(SonarDeltaEncoderTests, testPatchesChangedFields) {
+  const dynamic from = dynamic::object("fps", 60)("name", "main")(
+      "memory", dynamic::object("heap", 100)("native", 50))(
+      "removed", true)("list", dynamic::array(1, 2));
+  const dynamic to = dynamic::object("fps", 58)("name", "main")(
+      "memory", dynamic::object("heap", 120)("native", 50))(
+      "list", dynamic::array(1, 2, 3))("added", "yes");
+
+  const auto patch = SonarDeltaEncoder::diff(from, to);
+  ASSERT_TRUE(patch.hasValue());
+  EXPECT_EQ(
+      *patch,
+      dynamic::object("fps", 58)("memory", dynamic::object("heap", 120))(
+          "removed", nullptr)("list", dynamic::array(1, 2, 3))("added", "yes"));
+
+  auto applied = from;
+  SonarDeltaEncoder::apply(applied, *patch);
+  EXPECT_EQ(applied, to);
+}
+
+TEST(SonarDeltaEncoderTests, testNullsNeedKeyframes) {
+  EXPECT_FALSE(SonarDeltaEncoder::diff(
+                   dynamic::object("value", 1), dynamic::object("value", nullptr))
+                   .hasValue());
+  EXPECT_FALSE(SonarDeltaEncoder::diff(
+                   dynamic::object("value", 1),
+                   dynamic::object("value", dynamic::array(nullptr)))
+                   .hasValue());
+  EXPECT_FALSE(
+      SonarDeltaEncoder::diff(dynamic::array(1), dynamic::array(2)).hasValue());
+
+  SonarDeltaEncoder encoder;
+  encoder.encode(dynamic::object("value", 1));
+  const auto encoded = encoder.encode(dynamic::object("value", nullptr));
+  EXPECT_TRUE(encoded.keyframe);
+  EXPECT_EQ(encoded.params, dynamic::object("value", nullptr));
+}
+
+TEST(SonarDeltaEncoderTests, testKeyframeInterval) {
+  SonarDeltaEncoder encoder(3);
+  std::vector<bool> keyframes;
+  dynamic reassembled = nullptr;
+  for (int i = 0; i < 7; i++) {
+    const auto params = dynamic::object("count", i)("constant", "x");
+    const auto encoded = encoder.encode(params);
+    EXPECT_EQ(encoded.sequence, i + 1);
+    keyframes.push_back(encoded.keyframe);
+    if (encoded.keyframe) {
+      reassembled = encoded.params;
+    } else {
+      SonarDeltaEncoder::apply(reassembled, encoded.params);
+    }
+    EXPECT_EQ(reassembled, params);
+  }
+  EXPECT_EQ(
+      keyframes,
+      std::vector<bool>({true, false, false, true, false, false, true}));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
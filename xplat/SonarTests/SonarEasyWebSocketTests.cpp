@@ -0,0 +1,202 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarEasyWebSocket.h>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/json.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using namespace std::chrono_literals;
+
+class RecordingCallbacks : public SonarWebSocket::Callbacks {
+ public:
+  void onConnected() override {
+    connected.post();
+  }
+
+  void onDisconnected() override {}
+
+  void onMessageReceived(const folly::dynamic& message) override {
+    received = message;
+    receivedMessage.post();
+  }
+
+  void onRequestReceived(const folly::dynamic&, std::shared_ptr<SonarReply>)
+      override {}
+
+  void onStreamRequested(
+      const folly::dynamic&,
+      std::shared_ptr<SonarStreamResponder>) override {}
+
+  folly::Baton<> connected;
+  folly::Baton<> receivedMessage;
+  folly::dynamic received;
+};
+
+// Just enough of a WebSocket server on the loopback interface for one client,
+// with frames of up to 125 bytes.
+class LoopbackServer {
+ public:
+  LoopbackServer() {
+    listener_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(listener_, 1);
+    socklen_t length = sizeof(address);
+    getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+    port = ntohs(address.sin_port);
+  }
+
+  ~LoopbackServer() {
+    if (client_ >= 0) {
+      close(client_);
+    }
+    close(listener_);
+  }
+
+  // Returns the request line of the handshake, without answering it.
+  std::string accept() {
+    client_ = ::accept(listener_, nullptr, nullptr);
+    std::string request;
+    char c;
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           recv(client_, &c, 1, 0) == 1) {
+      request.push_back(c);
+    }
+    return request.substr(0, request.find("\r\n"));
+  }
+
+  void answer() {
+    writeAll(
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\nConnection: Upgrade\r\n\r\n");
+  }
+
+  void sendText(const std::string& text) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x81));
+    frame.push_back(static_cast<char>(text.size()));
+    writeAll(frame + text);
+  }
+
+  // Clients mask what they send.
+  std::string receiveText() {
+    uint8_t header[6];
+    readAll(header, sizeof(header));
+    std::string text(header[1] & 0x7f, '\0');
+    readAll(reinterpret_cast<uint8_t*>(&text[0]), text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+      text[i] ^= header[2 + i % 4];
+    }
+    return text;
+  }
+
+  uint16_t port;
+
+ private:
+  void writeAll(const std::string& data) {
+    ASSERT_EQ(
+        send(client_, data.data(), data.size(), 0),
+        static_cast<ssize_t>(data.size()));
+  }
+
+  void readAll(uint8_t* data, size_t size) {
+    size_t read = 0;
+    while (read < size) {
+      const auto ret = recv(client_, data + read, size - read, 0);
+      ASSERT_GT(ret, 0);
+      read += ret;
+    }
+  }
+
+  int listener_;
+  int client_ = -1;
+};
+
+static SonarInitConfig config(folly::EventBase* eventBase) {
+  SonarInitConfig config;
+  config.deviceData.host = "127.0.0.1";
+  config.deviceData.os = "Android";
+  config.deviceData.device = "Pixel 2";
+  config.deviceData.deviceId = "serial";
+  config.deviceData.app = "Test";
+  config.callbackWorker = eventBase;
+  return config;
+}
+
+TEST(SonarEasyWebSocketTests, testExchangesMessages) {
+  folly::ScopedEventBaseThread thread;
+  LoopbackServer server;
+  RecordingCallbacks callbacks;
+  SonarEasyWebSocket socket(
+      config(thread.getEventBase()),
+      std::make_shared<SonarState>(),
+      server.port);
+  socket.setCallbacks(&callbacks);
+  socket.start();
+
+  EXPECT_EQ(
+      server.accept(),
+      "GET /sonar?os=Android&device=Pixel+2&device_id=serial&app=Test "
+      "HTTP/1.1");
+  server.answer();
+  ASSERT_TRUE(callbacks.connected.try_wait_for(5s));
+  EXPECT_TRUE(socket.isOpen());
+
+  server.sendText("{\"method\":\"getPlugins\",\"id\":1}");
+  ASSERT_TRUE(callbacks.receivedMessage.try_wait_for(5s));
+  EXPECT_EQ(
+      callbacks.received,
+      folly::dynamic::object("method", "getPlugins")("id", 1));
+
+  socket.sendMessage(folly::dynamic::object("id", 1)("success", true));
+  EXPECT_EQ(
+      folly::parseJson(server.receiveText()),
+      folly::dynamic::object("id", 1)("success", true));
+}
+
+TEST(SonarEasyWebSocketTests, testHandshakeDoesntBlockEventBase) {
+  folly::ScopedEventBaseThread thread;
+  LoopbackServer server;
+  RecordingCallbacks callbacks;
+  SonarEasyWebSocket socket(
+      config(thread.getEventBase()),
+      std::make_shared<SonarState>(),
+      server.port);
+  socket.setCallbacks(&callbacks);
+  socket.start();
+
+  // The desktop hasn't answered the handshake yet.
+  server.accept();
+  folly::Baton<> ran;
+  thread.getEventBase()->runInEventBaseThread([&]() { ran.post(); });
+  EXPECT_TRUE(ran.try_wait_for(1s));
+  EXPECT_FALSE(socket.isOpen());
+
+  server.answer();
+  EXPECT_TRUE(callbacks.connected.try_wait_for(5s));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
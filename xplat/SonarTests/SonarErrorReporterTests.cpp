@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarErrorReporter.h>
+#include <SonarTestLib/SonarWebSocketMock.h>
+#include <folly/Conv.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+static dynamic error(const std::string& message) {
+  return dynamic::object(
+      "error", dynamic::object("message", message)("stacktrace", "<none>"));
+}
+
+static dynamic error(const std::string& message, size_t count) {
+  auto aggregated = error(message);
+  aggregated["error"]["count"] = count;
+  return aggregated;
+}
+
+TEST(SonarErrorReporterTests, testCountsRepeatedErrors) {
+  SonarWebSocketMock socket;
+  socket.open = true;
+  auto errors = std::make_shared<SonarErrorReporter>(&socket);
+  const auto start = SonarErrorReporter::Clock::now();
+
+  for (int i = 0; i < 10; i++) {
+    errors->report("Test", "failed", "<none>", start);
+  }
+  errors->report("Other", "failed", "<none>", start);
+  EXPECT_EQ(socket.messages.size(), 2);
+  EXPECT_EQ(socket.messages[0], error("failed"));
+  EXPECT_EQ(socket.messages[1], error("failed"));
+  EXPECT_EQ(errors->suppressed(), 9);
+
+  errors->flush(start);
+  EXPECT_EQ(socket.messages.size(), 3);
+  EXPECT_EQ(socket.messages[2], error("failed", 9));
+}
+
+TEST(SonarErrorReporterTests, testFlushesWithErrorAfterWindow) {
+  SonarWebSocketMock socket;
+  socket.open = true;
+  auto errors = std::make_shared<SonarErrorReporter>(
+      &socket, std::chrono::milliseconds(1000));
+  const auto start = SonarErrorReporter::Clock::now();
+
+  errors->report("Test", "failed", "<none>", start);
+  errors->report("Test", "failed", "<none>", start);
+  errors->report("Test", "failed", "<none>", start + std::chrono::seconds(2));
+  EXPECT_EQ(socket.messages.size(), 2);
+  EXPECT_EQ(socket.messages[1], error("failed", 1));
+
+  // Still repeating, so it stays counted.
+  errors->flush(start + std::chrono::seconds(3));
+  EXPECT_EQ(socket.messages.size(), 3);
+  EXPECT_EQ(socket.messages[2], error("failed", 1));
+
+  // Gone quiet for a window, so the next one is sent right away.
+  errors->flush(start + std::chrono::seconds(4));
+  errors->report("Test", "failed", "<none>", start + std::chrono::seconds(4));
+  EXPECT_EQ(socket.messages.size(), 4);
+  EXPECT_EQ(socket.messages[3], error("failed"));
+}
+
+TEST(SonarErrorReporterTests, testCountsErrorsPastMaxFingerprints) {
+  SonarWebSocketMock socket;
+  socket.open = true;
+  auto errors = std::make_shared<SonarErrorReporter>(&socket);
+  const auto start = SonarErrorReporter::Clock::now();
+
+  for (size_t i = 0; i < SonarErrorReporter::kMaxFingerprints + 3; i++) {
+    errors->report("Test", folly::to<std::string>(i), "<none>", start);
+  }
+  EXPECT_EQ(socket.messages.size(), SonarErrorReporter::kMaxFingerprints);
+
+  errors->flush(start);
+  EXPECT_EQ(
+      socket.messages.back(),
+      error("3 errors of other kinds were not reported", 3));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarEventBaseThread.h>
+
+#include <gtest/gtest.h>
+#include <future>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+TEST(SonarEventBaseThreadTests, testRunsOnItsOwnLoop) {
+  SonarEventBaseThread thread({"SonarTest"});
+  std::promise<bool> ran;
+  thread.eventBase()->runInEventBaseThread([&]() {
+    ran.set_value(thread.eventBase()->isInEventBaseThread());
+  });
+  EXPECT_TRUE(ran.get_future().get());
+  EXPECT_EQ(thread.report()["name"], "SonarTest");
+}
+
+#ifdef __linux__
+TEST(SonarEventBaseThreadTests, testAppliesNiceValue) {
+  SonarThreadOptions options{"SonarTest"};
+  options.niceValue = 19;
+  SonarEventBaseThread thread(options);
+  EXPECT_TRUE(thread.fullyApplied()) << folly::toJson(thread.report());
+  EXPECT_EQ(thread.report()["nice"], 19);
+}
+#endif
+
+TEST(SonarEventBaseThreadTests, testRecordsQoS) {
+  SonarThreadOptions options{"SonarTest"};
+  options.qos = SonarThreadQoS::utility;
+  SonarEventBaseThread thread(options);
+  // Only applied on Apple platforms, but never an error elsewhere.
+  EXPECT_TRUE(thread.fullyApplied()) << folly::toJson(thread.report());
+  EXPECT_EQ(thread.report()["requestedQoS"], "utility");
+#ifdef __APPLE__
+  EXPECT_EQ(thread.report()["qos"], "utility");
+#endif
+}
+
+TEST(SonarEventBaseThreadTests, testRecordsMissingLittleCores) {
+  SonarThreadOptions options{"SonarTest"};
+  options.littleCores = true;
+  SonarEventBaseThread thread(options);
+  // Whether there are any depends on the machine, but without any that is
+  // recorded rather than failing.
+  EXPECT_EQ(
+      thread.fullyApplied(),
+      !SonarEventBaseThread::littleCores().empty());
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
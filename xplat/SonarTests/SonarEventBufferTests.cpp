@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarEventBuffer.h>
+#include <SonarTestLib/SonarConnectionMock.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+static std::unique_ptr<folly::IOBuf> json(const std::string& value) {
+  return folly::IOBuf::copyBuffer(value);
+}
+
+TEST(SonarEventBufferTests, testDrainsInOrder) {
+  SonarEventBuffer buffer(1024);
+  buffer.append("a", json("{\"value\":1}"));
+  buffer.append("b", json("{\"value\":2}"));
+  EXPECT_EQ(buffer.size(), 2);
+  EXPECT_EQ(buffer.bytes(), 2 + 2 * 11);
+
+  SonarConnectionMock connection;
+  buffer.drainTo(connection);
+  ASSERT_EQ(connection.rawSent_.size(), 2);
+  EXPECT_EQ(connection.rawSent_[0].first, "a");
+  EXPECT_EQ(connection.rawSent_[0].second, "{\"value\":1}");
+  EXPECT_EQ(connection.rawSent_[1].first, "b");
+  EXPECT_EQ(connection.rawSent_[1].second, "{\"value\":2}");
+  EXPECT_EQ(buffer.size(), 0);
+  EXPECT_EQ(buffer.bytes(), 0);
+}
+
+TEST(SonarEventBufferTests, testDropsOldestOverByteCap) {
+  // Each event takes 1 + 4 bytes.
+  SonarEventBuffer buffer(12);
+  buffer.append("a", json("\"11\""));
+  buffer.append("b", json("\"22\""));
+  buffer.append("c", json("\"33\""));
+
+  EXPECT_EQ(buffer.size(), 2);
+  EXPECT_EQ(buffer.bytes(), 10);
+  EXPECT_EQ(buffer.dropped(), 1);
+  auto events = buffer.takeAll();
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].method, "b");
+  EXPECT_EQ(events[1].method, "c");
+}
+
+TEST(SonarEventBufferTests, testDropsEventsBiggerThanCap) {
+  SonarEventBuffer buffer(8);
+  buffer.append("a", json("\"1\""));
+  buffer.append("b", json("\"too big\""));
+
+  EXPECT_EQ(buffer.size(), 1);
+  EXPECT_EQ(buffer.dropped(), 1);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
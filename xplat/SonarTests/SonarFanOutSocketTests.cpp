@@ -0,0 +1,185 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarFanOutSocket.h>
+#include <SonarTestLib/SonarWebSocketMock.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+class CallbacksMock : public SonarWebSocket::Callbacks {
+ public:
+  void onConnected() override {
+    connected++;
+  }
+
+  void onDisconnected() override {
+    disconnected++;
+  }
+
+  void onMessageReceived(const dynamic& message) override {
+    messages.push_back(message);
+  }
+
+  void onRequestReceived(const dynamic&, std::shared_ptr<SonarReply>)
+      override {}
+
+  void onStreamRequested(const dynamic&, std::shared_ptr<SonarStreamResponder>)
+      override {}
+
+  int connected = 0;
+  int disconnected = 0;
+  std::vector<dynamic> messages;
+};
+
+class SonarFanOutSocketTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto first = std::make_unique<SonarWebSocketMock>();
+    auto second = std::make_unique<SonarWebSocketMock>();
+    main = first.get();
+    other = second.get();
+    std::vector<std::unique_ptr<SonarWebSocket>> sockets;
+    sockets.push_back(std::move(first));
+    sockets.push_back(std::move(second));
+    socket = std::make_unique<SonarFanOutSocket>(std::move(sockets));
+    socket->setCallbacks(&callbacks);
+    socket->start();
+  }
+
+  static dynamic init(const std::string& plugin) {
+    return dynamic::object("method", "init")(
+        "params", dynamic::object("plugin", plugin));
+  }
+
+  static dynamic deinit(const std::string& plugin) {
+    return dynamic::object("method", "deinit")(
+        "params", dynamic::object("plugin", plugin));
+  }
+
+  static std::unique_ptr<folly::IOBuf> event(const std::string& plugin) {
+    return folly::IOBuf::copyBuffer(folly::toJson(
+        dynamic::object("method", "execute")(
+            "params",
+            dynamic::object("api", plugin)("method", "event")("params", 1))));
+  }
+
+  SonarWebSocketMock* main;
+  SonarWebSocketMock* other;
+  std::unique_ptr<SonarFanOutSocket> socket;
+  CallbacksMock callbacks;
+};
+
+TEST_F(SonarFanOutSocketTests, testConnectedWhileAnyDesktopIs) {
+  EXPECT_EQ(callbacks.connected, 1);
+
+  other->stop();
+  EXPECT_EQ(callbacks.disconnected, 0);
+
+  main->stop();
+  EXPECT_EQ(callbacks.disconnected, 1);
+}
+
+TEST_F(SonarFanOutSocketTests, testPluginInitializedOnceForAllDesktops) {
+  main->callbacks->onMessageReceived(init("Test"));
+  other->callbacks->onMessageReceived(init("Test"));
+  EXPECT_EQ(callbacks.messages, std::vector<dynamic>{init("Test")});
+
+  main->callbacks->onMessageReceived(deinit("Test"));
+  EXPECT_EQ(callbacks.messages.size(), 1);
+
+  other->callbacks->onMessageReceived(deinit("Test"));
+  EXPECT_EQ(
+      callbacks.messages, (std::vector<dynamic>{init("Test"), deinit("Test")}));
+}
+
+TEST_F(SonarFanOutSocketTests, testInitManyOnlyPassesOnPluginsNotYetUsed) {
+  const auto many = [](const std::string& method, dynamic plugins) {
+    return dynamic::object("method", method)(
+        "params", dynamic::object("plugins", std::move(plugins)));
+  };
+  main->callbacks->onMessageReceived(init("A"));
+  other->callbacks->onMessageReceived(
+      many("initMany", dynamic::array("A", "B")));
+  ASSERT_EQ(callbacks.messages.size(), 2);
+  EXPECT_EQ(callbacks.messages[1], many("initMany", dynamic::array("B")));
+
+  // Nothing left to pass on, nor a response to wait for.
+  other->callbacks->onMessageReceived(many("initMany", dynamic::array("A")));
+  EXPECT_EQ(callbacks.messages.size(), 2);
+
+  other->callbacks->onMessageReceived(
+      many("deinitMany", dynamic::array("A", "B")));
+  ASSERT_EQ(callbacks.messages.size(), 3);
+  EXPECT_EQ(callbacks.messages[2], many("deinitMany", dynamic::array("B")));
+
+  socket->sendSerialized(event("A"), "A");
+  EXPECT_EQ(main->messages.size(), 1);
+  EXPECT_TRUE(other->messages.empty());
+}
+
+TEST_F(SonarFanOutSocketTests, testEventsOnlyGoToDesktopsWithThePlugin) {
+  main->callbacks->onMessageReceived(init("Both"));
+  other->callbacks->onMessageReceived(init("Both"));
+  other->callbacks->onMessageReceived(init("Other"));
+
+  socket->sendSerialized(event("Both"), "Both");
+  socket->sendSerialized(event("Other"), "Other");
+
+  EXPECT_EQ(main->messages.size(), 1);
+  EXPECT_EQ(main->messages[0]["params"]["api"], "Both");
+  EXPECT_EQ(other->messages.size(), 2);
+  EXPECT_EQ(other->messages[0]["params"]["api"], "Both");
+  EXPECT_EQ(other->messages[1]["params"]["api"], "Other");
+}
+
+TEST_F(SonarFanOutSocketTests, testResponsesGoBackToTheRequestingDesktop) {
+  const auto request = [](int id) {
+    return dynamic::object("id", id)("method", "getPlugins");
+  };
+  main->callbacks->onMessageReceived(request(1));
+  other->callbacks->onMessageReceived(request(1));
+  ASSERT_EQ(callbacks.messages.size(), 2);
+  const auto mainId = callbacks.messages[0]["id"].getInt();
+  const auto otherId = callbacks.messages[1]["id"].getInt();
+  EXPECT_EQ(mainId, 1);
+  EXPECT_NE(otherId, mainId);
+
+  socket->sendMessage(dynamic::object("id", otherId)("success", "other"));
+  socket->sendSerializedResponse(folly::IOBuf::copyBuffer(
+      folly::to<std::string>("{\"id\":", mainId, ",\"success\":\"main\"}")));
+
+  EXPECT_EQ(
+      main->messages,
+      std::vector<dynamic>{dynamic::object("id", 1)("success", "main")});
+  EXPECT_EQ(
+      other->messages,
+      std::vector<dynamic>{dynamic::object("id", 1)("success", "other")});
+}
+
+TEST_F(SonarFanOutSocketTests, testDisconnectDeinitsPluginsOnlyItUsed) {
+  main->callbacks->onMessageReceived(init("Both"));
+  other->callbacks->onMessageReceived(init("Both"));
+  other->callbacks->onMessageReceived(init("Other"));
+
+  other->stop();
+
+  EXPECT_EQ(
+      callbacks.messages,
+      (std::vector<dynamic>{init("Both"), init("Other"), deinit("Other")}));
+  EXPECT_EQ(callbacks.disconnected, 0);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarFlightRecorder.h>
+
+#include <gtest/gtest.h>
+#include <cstdio>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using Direction = SonarFlightRecorder::Direction;
+
+static const std::string kRing = "SonarFlightRecorderTestsRing";
+
+TEST(SonarFlightRecorderTests, testKeepsTheLastFrames) {
+  std::remove(kRing.c_str());
+  {
+    SonarFlightRecorder recorder(kRing, 3);
+    EXPECT_TRUE(recorder.previousFrames().empty());
+    for (int i = 0; i < 5; i++) {
+      const auto payload = std::to_string(i);
+      recorder.record(Direction::inbound, "execute", 100 + i, payload);
+    }
+  }
+
+  const auto frames = SonarFlightRecorder::load(kRing);
+  ASSERT_EQ(frames.size(), 3);
+  EXPECT_EQ(frames[0].payload, "2");
+  EXPECT_EQ(frames[1].payload, "3");
+  EXPECT_EQ(frames[2].payload, "4");
+  EXPECT_EQ(frames[2].size, 104);
+  EXPECT_EQ(frames[2].method, "execute");
+  EXPECT_EQ(frames[2].direction, Direction::inbound);
+  EXPECT_LE(frames[0].time, frames[2].time);
+}
+
+TEST(SonarFlightRecorderTests, testTruncatesFrames) {
+  std::remove(kRing.c_str());
+  {
+    SonarFlightRecorder recorder(kRing, 4);
+    const std::string method(SonarFlightRecorder::kMethodBytes + 10, 'm');
+    const std::string payload(SonarFlightRecorder::kPayloadBytes * 2, 'p');
+    recorder.record(
+        Direction::outbound,
+        method,
+        *folly::IOBuf::copyBuffer(payload.data(), payload.size()));
+  }
+
+  const auto frames = SonarFlightRecorder::load(kRing);
+  ASSERT_EQ(frames.size(), 1);
+  EXPECT_EQ(frames[0].direction, Direction::outbound);
+  EXPECT_EQ(frames[0].size, SonarFlightRecorder::kPayloadBytes * 2);
+  EXPECT_EQ(
+      frames[0].payload, std::string(SonarFlightRecorder::kPayloadBytes, 'p'));
+  EXPECT_EQ(
+      frames[0].method, std::string(SonarFlightRecorder::kMethodBytes, 'm'));
+}
+
+TEST(SonarFlightRecorderTests, testExposesThePreviousSession) {
+  std::remove(kRing.c_str());
+  {
+    SonarFlightRecorder recorder(kRing, 8);
+    recorder.record(Direction::inbound, "getPlugins", 24, "{}");
+  }
+
+  SonarFlightRecorder recorder(kRing, 8);
+  ASSERT_EQ(recorder.previousFrames().size(), 1);
+  EXPECT_EQ(recorder.previousFrames()[0].method, "getPlugins");
+  // The new session starts over.
+  EXPECT_TRUE(SonarFlightRecorder::load(kRing).empty());
+
+  const auto frames =
+      SonarFlightRecorder::toDynamic(recorder.previousFrames());
+  EXPECT_EQ(frames[0]["direction"], "in");
+  EXPECT_EQ(frames[0]["size"], 24);
+}
+
+TEST(SonarFlightRecorderTests, testIgnoresOtherFiles) {
+  std::remove(kRing.c_str());
+  EXPECT_TRUE(SonarFlightRecorder::load(kRing).empty());
+  FILE* file = std::fopen(kRing.c_str(), "w");
+  std::fputs("not a ring", file);
+  std::fclose(file);
+  EXPECT_TRUE(SonarFlightRecorder::load(kRing).empty());
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
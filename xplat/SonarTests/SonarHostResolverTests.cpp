@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarHostResolver.h>
+
+#include <folly/io/async/AsyncServerSocket.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using namespace std::chrono_literals;
+
+class AcceptAll : public folly::AsyncServerSocket::AcceptCallback {
+ public:
+  void connectionAccepted(
+      int fd,
+      const folly::SocketAddress&) noexcept override {
+    close(fd);
+  }
+
+  void acceptError(const std::exception&) noexcept override {}
+};
+
+TEST(SonarHostResolverTests, testSingleLiteralIsntRaced) {
+  folly::ScopedEventBaseThread thread;
+  SonarHostResolver resolver({"10.0.2.2"});
+  const auto address =
+      resolver.resolve(thread.getEventBase(), 8088, 100ms).get(1s);
+  EXPECT_EQ(address, folly::SocketAddress("10.0.2.2", 8088));
+  EXPECT_FALSE(resolver.preferredHost());
+}
+
+TEST(SonarHostResolverTests, testKeepsFirstHostToConnect) {
+  folly::ScopedEventBaseThread thread;
+  auto evb = thread.getEventBase();
+  AcceptAll acceptor;
+  folly::AsyncServerSocket::UniquePtr server(new folly::AsyncServerSocket());
+  evb->runInEventBaseThreadAndWait([&]() {
+    server->attachEventBase(evb);
+    server->bind(folly::SocketAddress("127.0.0.1", 0));
+    server->listen(1);
+    server->addAcceptCallback(&acceptor, evb);
+    server->startAccepting();
+  });
+  uint16_t port = server->getAddress().getPort();
+
+  // Nothing listens on the first host's port, it is refused.
+  SonarHostResolver resolver({"127.0.0.2", "127.0.0.1"});
+  const auto address = resolver.resolve(evb, port, 1s).get(5s);
+  EXPECT_EQ(address, folly::SocketAddress("127.0.0.1", port));
+  EXPECT_EQ(resolver.preferredHost(), std::string("127.0.0.1"));
+
+  resolver.forgetPreferred();
+  EXPECT_FALSE(resolver.preferredHost());
+  evb->runInEventBaseThreadAndWait([&]() { server.reset(); });
+}
+
+TEST(SonarHostResolverTests, testPrefersOnlyKnownHosts) {
+  SonarHostResolver resolver({"10.0.2.2", "localhost"});
+  EXPECT_FALSE(resolver.prefer("192.168.1.2"));
+  EXPECT_FALSE(resolver.preferredHost());
+
+  EXPECT_TRUE(resolver.prefer("localhost"));
+  EXPECT_EQ(resolver.preferredHost(), std::string("localhost"));
+}
+
+TEST(SonarHostResolverTests, testFailsOnceEveryHostFailed) {
+  folly::ScopedEventBaseThread thread;
+  SonarHostResolver resolver({"127.0.0.1", "127.0.0.2"});
+  // Port 1 is reserved and not listened on.
+  EXPECT_THROW(
+      resolver.resolve(thread.getEventBase(), 1, 1s).get(5s),
+      folly::AsyncSocketException);
+  EXPECT_FALSE(resolver.preferredHost());
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
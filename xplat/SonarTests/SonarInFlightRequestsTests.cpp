@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarInFlightRequests.h>
+
+#include <gtest/gtest.h>
+#include <tuple>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using Clock = SonarInFlightRequests::Clock;
+using Expired = std::tuple<int64_t, std::string, std::string>;
+
+TEST(SonarInFlightRequestsTests, testExpiresPastDeadline) {
+  SonarInFlightRequests requests(10, std::chrono::milliseconds(100));
+  std::vector<Expired> expired;
+  requests.setExpiredHandler(
+      [&](int64_t id, const std::string& method, const std::string& reason) {
+        expired.emplace_back(id, method, reason);
+      });
+  const auto start = Clock::now();
+  const auto first = requests.start(1, "Test.slow", start);
+  requests.start(2, "Test.slow", start + std::chrono::milliseconds(50));
+
+  const auto next = requests.expire(start + std::chrono::milliseconds(99));
+  EXPECT_TRUE(expired.empty());
+  ASSERT_TRUE(next.hasValue());
+  EXPECT_EQ(*next, start + std::chrono::milliseconds(100));
+
+  EXPECT_EQ(
+      requests.expire(start + std::chrono::milliseconds(100)),
+      start + std::chrono::milliseconds(150));
+  ASSERT_EQ(expired.size(), 1);
+  EXPECT_EQ(expired[0], Expired(1, "Test.slow", "Timed out"));
+  EXPECT_TRUE(first.isCancellationRequested());
+  EXPECT_EQ(requests.size(), 1);
+
+  // Its late response isn't sent.
+  EXPECT_FALSE(requests.finish(1));
+  EXPECT_TRUE(requests.finish(2));
+  EXPECT_FALSE(requests.expire(start + std::chrono::seconds(1)).hasValue());
+  EXPECT_EQ(requests.toDynamic()["timedOut"], 1);
+}
+
+TEST(SonarInFlightRequestsTests, testNoTimeoutNeverExpires) {
+  SonarInFlightRequests requests(10, std::chrono::milliseconds(0));
+  const auto start = Clock::now();
+  requests.start(1, "Test.slow", start);
+  EXPECT_FALSE(requests.expire(start + std::chrono::hours(1)).hasValue());
+  EXPECT_EQ(requests.size(), 1);
+}
+
+TEST(SonarInFlightRequestsTests, testEvictsOldestOverMaximum) {
+  SonarInFlightRequests requests(2, std::chrono::milliseconds(100));
+  std::vector<Expired> expired;
+  requests.setExpiredHandler(
+      [&](int64_t id, const std::string& method, const std::string& reason) {
+        expired.emplace_back(id, method, reason);
+      });
+  const auto start = Clock::now();
+  requests.start(1, "Test.a", start);
+  requests.start(2, "Test.b", start + std::chrono::milliseconds(1));
+  // Replacing a tracked id doesn't evict.
+  requests.start(2, "Test.b", start + std::chrono::milliseconds(2));
+  EXPECT_TRUE(expired.empty());
+
+  requests.start(3, "Test.c", start + std::chrono::milliseconds(3));
+  ASSERT_EQ(expired.size(), 1);
+  EXPECT_EQ(expired[0], Expired(1, "Test.a", "Too many requests in flight"));
+  EXPECT_EQ(requests.size(), 2);
+  EXPECT_EQ(requests.toDynamic()["evicted"], 1);
+}
+
+TEST(SonarInFlightRequestsTests, testLatencyPercentilesByMethod) {
+  SonarInFlightRequests requests;
+  const auto start = Clock::now();
+  for (int64_t id = 0; id < 100; id++) {
+    requests.start(id, "Test.get", start);
+    // 90 responses within 3ms, 9 within 100ms and one after a second.
+    const auto latency = id < 90 ? std::chrono::milliseconds(3)
+        : id < 99                ? std::chrono::milliseconds(100)
+                                 : std::chrono::milliseconds(1000);
+    EXPECT_TRUE(requests.finish(id, start + latency));
+  }
+  const auto metrics = requests.toDynamic()["methods"]["Test.get"];
+  EXPECT_EQ(metrics["count"], 100);
+  EXPECT_EQ(metrics["p50Ms"], 4);
+  EXPECT_EQ(metrics["p90Ms"], 4);
+  EXPECT_EQ(metrics["p99Ms"], 128);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
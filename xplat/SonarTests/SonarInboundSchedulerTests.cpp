@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarInboundScheduler.h>
+
+#include <gtest/gtest.h>
+#include <string>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+static void push(
+    SonarInboundScheduler& scheduler,
+    SonarInboundPriority priority,
+    std::string& ran,
+    char name,
+    SonarInboundScheduler::Clock::time_point now) {
+  scheduler.push(priority, [&ran, name]() { ran += name; }, now);
+}
+
+static void runAll(
+    SonarInboundScheduler& scheduler,
+    SonarInboundScheduler::Clock::time_point now) {
+  while (auto task = scheduler.pop(now)) {
+    task();
+  }
+}
+
+TEST(SonarInboundSchedulerTests, testClassifiesByMethodAndSize) {
+  SonarInboundWeights weights;
+  weights.bulkBytes = 100;
+  SonarInboundScheduler scheduler(weights);
+  EXPECT_EQ(scheduler.classify("init", 1000), SonarInboundPriority::control);
+  EXPECT_EQ(
+      scheduler.classify("execute", 99), SonarInboundPriority::interactive);
+  EXPECT_EQ(scheduler.classify("execute", 100), SonarInboundPriority::bulk);
+}
+
+TEST(SonarInboundSchedulerTests, testRunsUrgentMessagesFirst) {
+  SonarInboundScheduler scheduler;
+  const auto now = SonarInboundScheduler::Clock::now();
+  std::string ran;
+  push(scheduler, SonarInboundPriority::bulk, ran, 'b', now);
+  push(scheduler, SonarInboundPriority::interactive, ran, 'i', now);
+  push(scheduler, SonarInboundPriority::control, ran, 'c', now);
+  runAll(scheduler, now);
+  EXPECT_EQ(ran, "cib");
+  EXPECT_EQ(scheduler.size(), 0);
+}
+
+TEST(SonarInboundSchedulerTests, testInterleavesByWeight) {
+  SonarInboundWeights weights;
+  weights.control = 0;
+  weights.interactive = 2;
+  weights.bulk = 1;
+  weights.maxWait = std::chrono::hours(1);
+  SonarInboundScheduler scheduler(weights);
+  const auto now = SonarInboundScheduler::Clock::now();
+  std::string ran;
+  for (int i = 0; i < 4; i++) {
+    push(scheduler, SonarInboundPriority::interactive, ran, 'i', now);
+    push(scheduler, SonarInboundPriority::bulk, ran, 'b', now);
+  }
+  push(scheduler, SonarInboundPriority::control, ran, 'c', now);
+  runAll(scheduler, now);
+  EXPECT_EQ(ran, "iibiibbbc");
+}
+
+TEST(SonarInboundSchedulerTests, testRunsStarvedMessages) {
+  SonarInboundWeights weights;
+  weights.bulk = 0;
+  weights.maxWait = std::chrono::milliseconds(100);
+  SonarInboundScheduler scheduler(weights);
+  const auto start = SonarInboundScheduler::Clock::now();
+  std::string ran;
+  push(scheduler, SonarInboundPriority::bulk, ran, 'b', start);
+  const auto later = start + std::chrono::milliseconds(50);
+  push(scheduler, SonarInboundPriority::interactive, ran, 'i', later);
+  push(scheduler, SonarInboundPriority::interactive, ran, 'j', later);
+
+  scheduler.pop(later)();
+  EXPECT_EQ(ran, "i");
+  scheduler.pop(start + std::chrono::milliseconds(100))();
+  EXPECT_EQ(ran, "ib");
+  runAll(scheduler, later);
+  EXPECT_EQ(ran, "ibj");
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarJsonParser.h>
+
+#include <folly/json.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+TEST(SonarJsonParserTests, testParsesLikeFolly) {
+  dynamic nodes = dynamic::array();
+  while (folly::toJson(nodes).size() < 2 * kSimdJsonThreshold) {
+    nodes.push_back(dynamic::object("id", nodes.size())(
+        "name", "com.facebook.litho.LithoView é\n\"quoted\"")(
+        "alpha", 0.5)("visible", true)("parent", nullptr)(
+        "children", dynamic::array(-1, 2, dynamic::array())));
+  }
+  const auto large = folly::toJson(dynamic::object("method", "setData")(
+      "params", dynamic::object("nodes", nodes)));
+  EXPECT_EQ(sonarParseJson(large), folly::parseJson(large));
+
+  const std::string small = R"({"a": [1, 2.5, "b"], "a": {"c": null}})";
+  EXPECT_EQ(sonarParseJson(small), folly::parseJson(small));
+}
+
+TEST(SonarJsonParserTests, testRejectsMalformedLikeFolly) {
+  std::string large(kSimdJsonThreshold, ' ');
+  large += "{\"a\": [1, 2,}";
+  EXPECT_THROW(sonarParseJson(large), folly::json::parse_error);
+  EXPECT_THROW(sonarParseJson("{\"a\":"), folly::json::parse_error);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarJsonWriter.h>
+
+#include <folly/json.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+static std::string quoted(folly::StringPiece value) {
+  std::string out;
+  sonarAppendJsonString(value, out);
+  return out;
+}
+
+TEST(SonarJsonWriterTests, testWritesLikeFolly) {
+  std::string body;
+  for (int i = 0; i < 100; i++) {
+    body += "plain text of a response body, then\t\"quotes\" \\ and\n";
+  }
+  const auto message = dynamic::object("id", 1)(
+      "success",
+      dynamic::object("body", body)("status", 200)("ratio", 0.25)(
+          "ok", true)("error", nullptr)(
+          "headers", dynamic::array("café", "€ 10", "\x01\x1f\x7f")));
+  EXPECT_EQ(sonarToJson(message), folly::toJson(message));
+}
+
+TEST(SonarJsonWriterTests, testEscapesAtEveryOffset) {
+  // Characters to escape at each position of a block, and on either side
+  // of block boundaries.
+  for (size_t offset = 0; offset < 40; offset++) {
+    std::string value(offset, 'a');
+    value += "\"\xe2\x82\xac\n";
+    value += std::string(40 - offset, 'b');
+    EXPECT_EQ(quoted(value), folly::toJson(value));
+  }
+}
+
+TEST(SonarJsonWriterTests, testReplacesInvalidUtf8) {
+  EXPECT_EQ(quoted("ab\xff"), "\"ab\xef\xbf\xbd\"");
+  // Truncated, overlong and surrogate sequences.
+  EXPECT_EQ(quoted("\xe2\x82"), "\"\xef\xbf\xbd\xef\xbf\xbd\"");
+  EXPECT_EQ(quoted("\xc0\xaf"), "\"\xef\xbf\xbd\xef\xbf\xbd\"");
+  EXPECT_EQ(
+      quoted("\xed\xa0\x80"), "\"\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd\"");
+  EXPECT_EQ(quoted("\xf0\x9f\x98\x80"), "\"\xf0\x9f\x98\x80\"");
+}
+
+TEST(SonarJsonWriterTests, testRejectsWhatFollyRejects) {
+  EXPECT_THROW(sonarToJson(dynamic(NAN)), std::invalid_argument);
+  EXPECT_THROW(
+      sonarToJson(dynamic::object(1, "value")), std::invalid_argument);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
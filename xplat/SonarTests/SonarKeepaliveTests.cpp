@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarKeepalive.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using Action = SonarKeepalive::Action;
+
+TEST(SonarKeepaliveTests, testBusyLinkSendsNothing) {
+  const auto start = SonarKeepalive::Clock::now();
+  SonarKeepalive keepalive(seconds(60), start);
+  milliseconds next;
+
+  for (int i = 1; i <= 100; i++) {
+    const auto now = start + seconds(i);
+    keepalive.onRead(now);
+    EXPECT_EQ(keepalive.check(now, &next), Action::wait);
+  }
+}
+
+TEST(SonarKeepaliveTests, testIdleLinkSendsAfterMinInterval) {
+  const auto start = SonarKeepalive::Clock::now();
+  SonarKeepalive keepalive(seconds(60), start);
+  milliseconds next;
+
+  EXPECT_EQ(keepalive.check(start + seconds(1), &next), Action::wait);
+  EXPECT_GE(next, seconds(4));
+  EXPECT_EQ(keepalive.check(start + seconds(5), &next), Action::send);
+  EXPECT_EQ(next, SonarKeepalive::kMaxTimeout);
+}
+
+TEST(SonarKeepaliveTests, testAnswersBackOffUpToCeiling) {
+  auto now = SonarKeepalive::Clock::now();
+  SonarKeepalive keepalive(seconds(30), now);
+  milliseconds next;
+
+  for (const auto expected : {10, 20, 30, 30}) {
+    now += keepalive.interval();
+    EXPECT_EQ(keepalive.check(now, &next), Action::send);
+    now += milliseconds(50);
+    keepalive.onRead(now);
+    EXPECT_EQ(keepalive.interval(), seconds(expected));
+  }
+
+  keepalive.setCeiling(seconds(10));
+  EXPECT_EQ(keepalive.interval(), seconds(10));
+}
+
+TEST(SonarKeepaliveTests, testFailsWithoutAnswer) {
+  const auto start = SonarKeepalive::Clock::now();
+  SonarKeepalive keepalive(seconds(60), start);
+  milliseconds next;
+
+  EXPECT_EQ(keepalive.check(start + seconds(5), &next), Action::send);
+  EXPECT_EQ(keepalive.check(start + seconds(10), &next), Action::wait);
+  EXPECT_EQ(keepalive.check(start + seconds(15), &next), Action::fail);
+}
+
+TEST(SonarKeepaliveTests, testTimeoutFollowsRoundTrips) {
+  auto now = SonarKeepalive::Clock::now();
+  SonarKeepalive keepalive(seconds(60), now);
+  milliseconds next;
+  EXPECT_EQ(keepalive.timeout(), SonarKeepalive::kMaxTimeout);
+
+  // Fast answers, the timeout stays above kMinTimeout.
+  now += keepalive.interval();
+  keepalive.check(now, &next);
+  keepalive.onRead(now + milliseconds(20));
+  EXPECT_EQ(keepalive.timeout(), SonarKeepalive::kMinTimeout);
+
+  // Slow ones raise it, up to kMaxTimeout.
+  for (int i = 0; i < 20; i++) {
+    now += keepalive.interval();
+    keepalive.check(now, &next);
+    now += seconds(2);
+    keepalive.onRead(now);
+  }
+  EXPECT_GT(keepalive.timeout(), seconds(7));
+  EXPECT_LE(keepalive.timeout(), SonarKeepalive::kMaxTimeout);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarEventBuffer.h>
+#include <Sonar/SonarMemoryBudget.h>
+#include <Sonar/SonarSendQueue.h>
+
+#include <folly/executors/ManualExecutor.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+static std::unique_ptr<folly::IOBuf> bytes(size_t size) {
+  return folly::IOBuf::copyBuffer(std::string(size, 'x'));
+}
+
+TEST(SonarMemoryBudgetTests, testRefusesOverHardLimit) {
+  folly::ManualExecutor executor;
+  auto budget = std::make_shared<SonarMemoryBudget>(0, 100, &executor);
+
+  EXPECT_TRUE(budget->reserve("A", 60));
+  EXPECT_FALSE(budget->reserve("B", 50));
+  EXPECT_TRUE(budget->reserve("B", 40));
+  EXPECT_EQ(budget->bytes(), 100);
+
+  budget->release("A", 60);
+  EXPECT_EQ(budget->bytes(), 40);
+  EXPECT_EQ(budget->bytes("A"), 0);
+  EXPECT_EQ(budget->usage()["refused"], 1);
+}
+
+TEST(SonarMemoryBudgetTests, testShedsBiggestUsersOverSoftLimit) {
+  folly::ManualExecutor executor;
+  auto budget = std::make_shared<SonarMemoryBudget>(100, 0, &executor);
+  std::map<std::string, size_t> asked;
+  for (const auto& plugin : {"A", "B", "C"}) {
+    budget->setShedHandler(
+        plugin, [&asked, plugin](size_t bytes) { asked[plugin] = bytes; });
+  }
+
+  budget->reserve("A", 30);
+  budget->reserve("B", 60);
+  budget->reserve("C", 40);
+  // Never inline with the reservation.
+  EXPECT_TRUE(asked.empty());
+
+  executor.drain();
+  std::map<std::string, size_t> expected{{"B", 30}};
+  EXPECT_EQ(asked, expected);
+}
+
+TEST(SonarMemoryBudgetTests, testEventBufferAccountsAndSheds) {
+  folly::ManualExecutor executor;
+  auto budget = std::make_shared<SonarMemoryBudget>(0, 20, &executor);
+  {
+    SonarEventBuffer buffer(1024, budget, "Test");
+    buffer.append("a", bytes(9));
+    buffer.append("b", bytes(9));
+    EXPECT_EQ(budget->bytes("Test"), 20);
+
+    // Over the budget, dropped.
+    buffer.append("c", bytes(9));
+    EXPECT_EQ(buffer.size(), 2);
+    EXPECT_EQ(buffer.dropped(), 1);
+
+    EXPECT_EQ(buffer.shed(1), 10);
+    EXPECT_EQ(budget->bytes("Test"), 10);
+    EXPECT_EQ(buffer.takeAll()[0].method, "b");
+    EXPECT_EQ(budget->bytes(), 0);
+
+    buffer.append("d", bytes(9));
+  }
+  EXPECT_EQ(budget->bytes(), 0);
+}
+
+TEST(SonarMemoryBudgetTests, testSendQueueReleasesOnDrain) {
+  folly::ManualExecutor executor;
+  auto budget = std::make_shared<SonarMemoryBudget>(0, 30, &executor);
+  SonarSendQueue queue(1, OverflowPolicy::dropOldest, budget);
+
+  queue.push({"Test", nullptr, bytes(10)}, false);
+  // Replaces the first one.
+  queue.push({"Test", nullptr, bytes(20)}, false);
+  EXPECT_EQ(budget->bytes("Test"), 20);
+  // Over the budget, dropped.
+  queue.push({"Other", nullptr, bytes(11)}, false);
+
+  auto drained = queue.drain();
+  EXPECT_EQ(drained.entries.size(), 1);
+  EXPECT_EQ(drained.dropped["Test"], 1);
+  EXPECT_EQ(drained.dropped["Other"], 1);
+  EXPECT_EQ(budget->bytes(), 0);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,194 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarConnectionImpl.h>
+#include <Sonar/SonarMetrics.h>
+#include <SonarTestLib/SonarWebSocketMock.h>
+
+#include <folly/executors/InlineExecutor.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+using Sent = std::vector<std::pair<std::string, dynamic>>;
+
+static std::shared_ptr<SonarMetrics> recordingMetrics(Sent& sent) {
+  return std::make_shared<SonarMetrics>(
+      [&sent](const std::string& method, dynamic params) {
+        sent.emplace_back(method, std::move(params));
+      });
+}
+
+TEST(SonarMetricsTests, testBucketsAreContiguous) {
+  for (uint64_t value = 0; value < 16; value++) {
+    EXPECT_EQ(SonarHistogram::bucketOf(value), value);
+  }
+  for (size_t bucket = 0; bucket + 1 < SonarHistogram::kBuckets; bucket++) {
+    const auto lower = SonarHistogram::lowerBound(bucket);
+    const auto next = SonarHistogram::lowerBound(bucket + 1);
+    ASSERT_LT(lower, next) << bucket;
+    EXPECT_EQ(SonarHistogram::bucketOf(lower), bucket);
+    EXPECT_EQ(SonarHistogram::bucketOf(next - 1), bucket);
+    // Never wider than a 16th of its values.
+    EXPECT_LE((next - lower) * 16, std::max<uint64_t>(lower, 16)) << bucket;
+  }
+  EXPECT_EQ(
+      SonarHistogram::bucketOf(INT64_MAX), SonarHistogram::kBuckets - 1);
+}
+
+TEST(SonarMetricsTests, testSummarizesSamples) {
+  SonarHistogram histogram;
+  for (int64_t value = 1; value <= 1000; value++) {
+    histogram.record(value);
+  }
+  histogram.record(-5);
+
+  const auto summary = histogram.take();
+  EXPECT_EQ(summary.count, 1001);
+  EXPECT_EQ(summary.sum, 500500);
+  EXPECT_EQ(summary.min, 0);
+  EXPECT_EQ(summary.max, 1000);
+  // Within a bucket's width of the exact percentiles.
+  EXPECT_NEAR(summary.percentile(0.5), 500, 500 / 16);
+  EXPECT_NEAR(summary.percentile(0.9), 900, 900 / 16);
+  EXPECT_NEAR(summary.percentile(0.99), 990, 990 / 16);
+  EXPECT_EQ(summary.percentile(1), 1000);
+
+  uint64_t bucketed = 0;
+  for (const auto& bucket : summary.buckets) {
+    bucketed += bucket.second;
+  }
+  EXPECT_EQ(bucketed, 1001);
+
+  // Taking starts over.
+  EXPECT_EQ(histogram.take().count, 0);
+}
+
+TEST(SonarMetricsTests, testMergesSummaries) {
+  SonarHistogram first;
+  SonarHistogram second;
+  SonarHistogram both;
+  for (int64_t value = 0; value < 500; value++) {
+    first.record(value);
+    second.record(value * 3);
+    both.record(value);
+    both.record(value * 3);
+  }
+
+  auto merged = first.take();
+  merged.merge(second.take());
+  const auto expected = both.take();
+  EXPECT_EQ(merged.count, expected.count);
+  EXPECT_EQ(merged.sum, expected.sum);
+  EXPECT_EQ(merged.min, expected.min);
+  EXPECT_EQ(merged.max, expected.max);
+  EXPECT_EQ(merged.buckets, expected.buckets);
+
+  SonarHistogram::Summary empty;
+  empty.merge(expected);
+  EXPECT_EQ(empty.toDynamic(), expected.toDynamic());
+}
+
+TEST(SonarMetricsTests, testRecordsFromManyThreads) {
+  constexpr int kThreads = 4;
+  constexpr int kSamples = 10000;
+  SonarHistogram histogram;
+  SonarCounter counter;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&histogram, &counter]() {
+      for (int i = 0; i < kSamples; i++) {
+        histogram.record(i);
+        counter.add();
+      }
+    });
+  }
+  // Taking meanwhile loses nothing, samples land in one interval or the
+  // next.
+  uint64_t taken = 0;
+  int64_t counted = 0;
+  for (int i = 0; i < 10; i++) {
+    taken += histogram.take().count;
+    counted += counter.take();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  taken += histogram.take().count;
+  counted += counter.take();
+  EXPECT_EQ(taken, kThreads * kSamples);
+  EXPECT_EQ(counted, kThreads * kSamples);
+}
+
+TEST(SonarMetricsTests, testFlushesEachMetricOncePerInterval) {
+  Sent sent;
+  auto metrics = recordingMetrics(sent);
+  const auto frames = metrics->histogram("frameTimes");
+  const auto misses = metrics->counter("cacheMisses");
+  EXPECT_EQ(metrics->histogram("frameTimes"), frames);
+  EXPECT_EQ(metrics->counter("cacheMisses"), misses);
+  metrics->histogram("idle");
+
+  const auto start = SonarMetrics::Clock::now();
+  metrics->flush(start);
+  EXPECT_TRUE(sent.empty());
+
+  for (int i = 0; i < 1000; i++) {
+    frames->record(16);
+    misses->add(2);
+  }
+  metrics->flush(start + std::chrono::seconds(1));
+  ASSERT_EQ(sent.size(), 2);
+  EXPECT_EQ(sent[0].first, "frameTimes");
+  EXPECT_EQ(
+      sent[0].second,
+      dynamic::object("count", 1000)("sum", 16000)("min", 16)("max", 16)(
+          "p50", 16)("p90", 16)("p99", 16)(
+          "buckets", dynamic::array(dynamic::array(16, 1000)))(
+          "intervalMs", 1000));
+  EXPECT_EQ(sent[1].first, "cacheMisses");
+  EXPECT_EQ(
+      sent[1].second, dynamic::object("count", 2000)("intervalMs", 1000));
+
+  metrics->flush(start + std::chrono::seconds(2));
+  EXPECT_EQ(sent.size(), 2);
+}
+
+TEST(SonarMetricsTests, testConnectionSendsMetricsAsEvents) {
+  SonarWebSocketMock socket;
+  socket.open = true;
+  auto conn = std::make_shared<SonarConnectionImpl>(
+      &socket, "Test", &folly::InlineExecutor::instance());
+  const auto frames = conn->histogram("frameTimes");
+  EXPECT_EQ(conn->histogram("frameTimes"), frames);
+  for (int i = 0; i < 100; i++) {
+    frames->record(i);
+  }
+  EXPECT_TRUE(socket.messages.empty());
+
+  conn->flushMetrics();
+  ASSERT_EQ(socket.messages.size(), 1);
+  const auto& message = socket.messages[0];
+  EXPECT_EQ(message["method"], "execute");
+  EXPECT_EQ(message["params"]["api"], "Test");
+  EXPECT_EQ(message["params"]["method"], "frameTimes");
+  EXPECT_EQ(message["params"]["params"]["count"], 100);
+  EXPECT_EQ(message["params"]["params"]["max"], 99);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,46 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarMutex.h>
+
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+TEST(SonarMutexTests, testGuardExcludesOtherThreads) {
+  SonarMutex mutex("SonarMutexTests::mutex");
+  int counter = 0;
+  const auto increment = [&]() {
+    for (int i = 0; i < 1000; i++) {
+      SonarLockGuard lock(mutex, SONAR_LOCK_SITE);
+      counter++;
+    }
+  };
+  std::thread other(increment);
+  increment();
+  other.join();
+  EXPECT_EQ(counter, 2000);
+
+#if FB_SONAR_LOCK_PROFILING
+  const auto profile = sonarLockProfile()["SonarMutexTests::mutex"];
+  ASSERT_EQ(profile.size(), 1);
+  EXPECT_EQ(profile[0]["acquisitions"], 2000);
+  EXPECT_NE(
+      profile[0]["site"].getString().find("SonarMutexTests.cpp"),
+      std::string::npos);
+#else
+  EXPECT_TRUE(sonarLockProfile().isNull());
+#endif
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
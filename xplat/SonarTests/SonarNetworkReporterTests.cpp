@@ -0,0 +1,220 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarNetworkReporter.h>
+#include <SonarTestLib/SonarConnectionMock.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using Request = SonarNetworkReporter::Request;
+using Response = SonarNetworkReporter::Response;
+
+static Request request(int64_t id) {
+  Request request;
+  request.id = id;
+  request.timestamp = 10;
+  request.method = std::string("GET");
+  request.url = std::string("https://example.com/\"a\"");
+  request.headers = {{"Accept", "*/*"}};
+  return request;
+}
+
+static Response response(int64_t id) {
+  Response response;
+  response.id = id;
+  response.timestamp = 20;
+  response.status = 200;
+  return response;
+}
+
+TEST(SonarNetworkReporterTests, testSerializesRequest) {
+  SonarNetworkReporter reporter({});
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+
+  auto sent = request(1);
+  const std::string body = "body";
+  sent.body = folly::ByteRange(folly::StringPiece(body));
+  reporter.reportRequest(sent);
+
+  ASSERT_EQ(connection->rawSent_.size(), 1);
+  EXPECT_EQ(connection->rawSent_[0].first, "newRequest");
+  EXPECT_EQ(
+      folly::parseJson(connection->rawSent_[0].second),
+      folly::dynamic::object("id", 1)("timestamp", 10)("method", "GET")(
+          "url", "https://example.com/\"a\"")(
+          "headers",
+          folly::dynamic::array(
+              folly::dynamic::object("key", "Accept")("value", "*/*")))(
+          "data", "Ym9keQ=="));
+}
+
+TEST(SonarNetworkReporterTests, testSerializesResponseWithoutBody) {
+  SonarNetworkReporter reporter({});
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+
+  reporter.reportResponse(response(1));
+
+  ASSERT_EQ(connection->rawSent_.size(), 1);
+  EXPECT_EQ(connection->rawSent_[0].first, "newResponse");
+  EXPECT_EQ(
+      folly::parseJson(connection->rawSent_[0].second),
+      folly::dynamic::object("id", 1)("timestamp", 20)("status", 200)(
+          "reason", nullptr)("headers", folly::dynamic::array)(
+          "data", nullptr));
+}
+
+TEST(SonarNetworkReporterTests, testTruncatesBodies) {
+  SonarNetworkReporter::Options options;
+  options.maxBodyBytes = 3;
+  SonarNetworkReporter reporter(options);
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+
+  auto sent = response(1);
+  const std::string body = "abcdef";
+  sent.body = folly::ByteRange(folly::StringPiece(body));
+  reporter.reportResponse(sent);
+
+  ASSERT_EQ(connection->rawSent_.size(), 1);
+  EXPECT_EQ(
+      folly::parseJson(connection->rawSent_[0].second)["data"], "YWJj");
+}
+
+TEST(SonarNetworkReporterTests, testBuffersUntilConnected) {
+  SonarNetworkReporter reporter({});
+  reporter.reportRequest(request(1));
+  reporter.reportResponse(response(1));
+
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+  ASSERT_EQ(connection->rawSent_.size(), 2);
+  EXPECT_EQ(connection->rawSent_[0].first, "newRequest");
+  EXPECT_EQ(connection->rawSent_[1].first, "newResponse");
+
+  reporter.setConnection(nullptr);
+  reporter.reportRequest(request(2));
+  EXPECT_EQ(connection->rawSent_.size(), 2);
+  EXPECT_EQ(reporter.takeBuffered().size(), 1);
+}
+
+TEST(SonarNetworkReporterTests, testRateLimitsRequestsWithTheirResponses) {
+  SonarNetworkReporter::Options options;
+  options.maxRequestsPerSecond = 2;
+  SonarNetworkReporter reporter(options);
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+
+  for (int64_t id = 1; id <= 3; id++) {
+    reporter.reportRequest(request(id));
+  }
+  for (int64_t id = 1; id <= 3; id++) {
+    reporter.reportResponse(response(id));
+  }
+
+  EXPECT_EQ(reporter.rateLimitedRequests(), 1);
+  ASSERT_EQ(connection->rawSent_.size(), 4);
+  for (const auto& sent : connection->rawSent_) {
+    EXPECT_NE(folly::parseJson(sent.second)["id"], 3);
+  }
+}
+
+TEST(SonarNetworkReporterTests, testRateLimitsResponsesReportedTwice) {
+  SonarNetworkReporter::Options options;
+  options.maxRequestsPerSecond = 1;
+  SonarNetworkReporter reporter(options);
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+
+  reporter.reportRequest(request(1));
+  reporter.reportRequest(request(2));
+  for (int64_t id = 1; id <= 2; id++) {
+    auto headers = response(id);
+    headers.bodyPending = true;
+    reporter.reportResponse(headers);
+  }
+  for (int64_t id = 1; id <= 2; id++) {
+    reporter.reportResponse(response(id));
+  }
+
+  ASSERT_EQ(connection->rawSent_.size(), 3);
+  for (const auto& sent : connection->rawSent_) {
+    EXPECT_EQ(folly::parseJson(sent.second)["id"], 1);
+  }
+}
+
+TEST(SonarNetworkReporterTests, testFiltersRequestsWithTheirResponses) {
+  SonarNetworkReporter reporter({});
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+  SonarUrlFilter::Patterns patterns;
+  patterns.excludeHosts = {"example.com"};
+  reporter.setUrlFilter(std::make_shared<SonarUrlFilter>(patterns));
+  EXPECT_FALSE(reporter.shouldCapture("https://example.com/a"));
+  EXPECT_TRUE(reporter.shouldCapture("https://example.org/a"));
+
+  auto kept = request(2);
+  kept.url = std::string("https://example.org/");
+  reporter.reportRequest(request(1));
+  reporter.reportRequest(kept);
+  reporter.reportResponse(response(1));
+  reporter.reportResponse(response(2));
+
+  EXPECT_EQ(reporter.filteredRequests(), 1);
+  ASSERT_EQ(connection->rawSent_.size(), 2);
+  for (const auto& sent : connection->rawSent_) {
+    EXPECT_EQ(folly::parseJson(sent.second)["id"], 2);
+  }
+
+  // The next desktop starts without it.
+  reporter.setConnection(connection);
+  EXPECT_TRUE(reporter.shouldCapture("https://example.com/a"));
+}
+
+TEST(SonarNetworkReporterTests, testSendsHeadersThroughTable) {
+  SonarNetworkReporter reporter({});
+  auto connection = std::make_shared<SonarConnectionMock>();
+  reporter.setConnection(connection);
+  EXPECT_EQ(reporter.enableHeaderTable(), 1);
+
+  reporter.reportRequest(request(1));
+  reporter.reportRequest(request(2));
+  reporter.reportRequest(request(3));
+
+  ASSERT_EQ(connection->rawSent_.size(), 3);
+  auto first = folly::parseJson(connection->rawSent_[0].second);
+  // Values only go in the table once they repeat.
+  EXPECT_EQ(first["headers"], folly::dynamic::array(0, "*/*"));
+  EXPECT_EQ(
+      first["headerTable"],
+      folly::dynamic::object("generation", 1)("first", 0)(
+          "strings", folly::dynamic::array("Accept")));
+  auto second = folly::parseJson(connection->rawSent_[1].second);
+  EXPECT_EQ(second["headers"], folly::dynamic::array(0, 1));
+  EXPECT_EQ(second["headerTable"]["first"], 1);
+  EXPECT_EQ(second["headerTable"]["strings"], folly::dynamic::array("*/*"));
+  auto third = folly::parseJson(connection->rawSent_[2].second);
+  EXPECT_EQ(third["headers"], folly::dynamic::array(0, 1));
+  EXPECT_EQ(third["headerTable"]["strings"], folly::dynamic::array());
+
+  // A new connection starts without one.
+  reporter.setConnection(connection);
+  reporter.reportRequest(request(4));
+  auto plain = folly::parseJson(connection->rawSent_[3].second);
+  EXPECT_EQ(plain.count("headerTable"), 0);
+  EXPECT_EQ(plain["headers"][0]["key"], "Accept");
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarResponseStream.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/json.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+class RecordingSubscriber
+    : public yarpl::flowable::Subscriber<rsocket::Payload> {
+ public:
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> aSubscription) override {
+    subscription = std::move(aSubscription);
+  }
+
+  void onNext(rsocket::Payload payload) override {
+    chunks.push_back(payload.moveDataToString());
+  }
+
+  void onComplete() override {
+    completed = true;
+  }
+
+  void onError(folly::exception_wrapper aError) override {
+    aError.with_exception([this](rsocket::ErrorWithPayload& e) {
+      error = e.payload.moveDataToString();
+    });
+  }
+
+  std::shared_ptr<yarpl::flowable::Subscription> subscription;
+  std::vector<std::string> chunks;
+  std::string error;
+  bool completed = false;
+};
+
+class SonarResponseStreamTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stream = std::make_shared<SonarResponseStream>(
+        &eventBase, [](const dynamic& chunk) {
+          return folly::IOBuf::copyBuffer(folly::toJson(chunk));
+        });
+    responder = stream->responder();
+    subscriber = std::make_shared<RecordingSubscriber>();
+    stream->subscribe(subscriber);
+  }
+
+  void send(std::initializer_list<int> chunks) {
+    for (const auto chunk : chunks) {
+      responder->next(chunk);
+    }
+    eventBase.loop();
+  }
+
+  folly::EventBase eventBase;
+  std::shared_ptr<SonarResponseStream> stream;
+  std::shared_ptr<SonarStreamResponder> responder;
+  std::shared_ptr<RecordingSubscriber> subscriber;
+};
+
+TEST_F(SonarResponseStreamTests, testBuffersUntilRequested) {
+  send({1, 2, 3});
+  EXPECT_TRUE(subscriber->chunks.empty());
+
+  subscriber->subscription->request(2);
+  EXPECT_EQ(subscriber->chunks, std::vector<std::string>({"1", "2"}));
+  subscriber->subscription->request(1);
+  EXPECT_EQ(subscriber->chunks, std::vector<std::string>({"1", "2", "3"}));
+
+  // Credits left over are used by chunks to come.
+  subscriber->subscription->request(1);
+  send({4, 5});
+  EXPECT_EQ(
+      subscriber->chunks, std::vector<std::string>({"1", "2", "3", "4"}));
+}
+
+TEST_F(SonarResponseStreamTests, testIgnoresRequestsForNothing) {
+  send({1});
+  subscriber->subscription->request(0);
+  subscriber->subscription->request(-1);
+  EXPECT_TRUE(subscriber->chunks.empty());
+}
+
+TEST_F(SonarResponseStreamTests, testUnboundedRequestDoesntOverflow) {
+  subscriber->subscription->request(2);
+  subscriber->subscription->request(SonarResponseStream::kUnbounded);
+  subscriber->subscription->request(SonarResponseStream::kUnbounded);
+  send({1, 2, 3, 4});
+  EXPECT_EQ(subscriber->chunks.size(), 4);
+}
+
+TEST_F(SonarResponseStreamTests, testCancelDropsBufferedChunks) {
+  send({1, 2});
+  subscriber->subscription->cancel();
+  subscriber->subscription->request(5);
+  send({3});
+  responder->complete();
+  eventBase.loop();
+
+  EXPECT_TRUE(subscriber->chunks.empty());
+  EXPECT_FALSE(subscriber->completed);
+}
+
+TEST_F(SonarResponseStreamTests, testErrorWaitsForBufferedChunks) {
+  send({1});
+  responder->error(dynamic::object("message", "failed"));
+  eventBase.loop();
+  EXPECT_TRUE(subscriber->error.empty());
+
+  subscriber->subscription->request(1);
+  EXPECT_EQ(subscriber->chunks, std::vector<std::string>({"1"}));
+  EXPECT_EQ(
+      folly::parseJson(subscriber->error),
+      dynamic::object("message", "failed"));
+}
+
+TEST_F(SonarResponseStreamTests, testCompletesOnceDrained) {
+  send({1});
+  responder->complete();
+  send({2});
+  EXPECT_FALSE(subscriber->completed);
+
+  subscriber->subscription->request(SonarResponseStream::kUnbounded);
+  EXPECT_EQ(subscriber->chunks, std::vector<std::string>({"1"}));
+  EXPECT_TRUE(subscriber->completed);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarSendLimiter.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+static SonarSendLimit limit(double maxPerSecond, double sampleRate) {
+  SonarSendLimit limit;
+  limit.maxPerSecond = maxPerSecond;
+  limit.sampleRate = sampleRate;
+  return limit;
+}
+
+TEST(SonarSendLimiterTests, testAdmitsWithoutLimit) {
+  SonarSendLimiter limiter;
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(limiter.admit("event"));
+  }
+  EXPECT_EQ(limiter.suppressed(), dynamic::object());
+}
+
+TEST(SonarSendLimiterTests, testLimitsRate) {
+  SonarSendLimiter limiter;
+  const auto start = SonarSendLimiter::Clock::now();
+  limiter.setLimit("event", limit(2, 1));
+
+  EXPECT_TRUE(limiter.admit("event", start));
+  EXPECT_TRUE(limiter.admit("event", start));
+  EXPECT_FALSE(limiter.admit("event", start));
+  EXPECT_TRUE(limiter.admit("other", start));
+
+  EXPECT_TRUE(
+      limiter.admit("event", start + std::chrono::milliseconds(500)));
+  EXPECT_FALSE(
+      limiter.admit("event", start + std::chrono::milliseconds(500)));
+  EXPECT_EQ(limiter.suppressed(), dynamic::object("event", 2));
+}
+
+TEST(SonarSendLimiterTests, testSamples) {
+  SonarSendLimiter limiter;
+  limiter.setLimit("event", limit(0, 0.25));
+  int admitted = 0;
+  for (int i = 0; i < 100; i++) {
+    admitted += limiter.admit("event") ? 1 : 0;
+  }
+  EXPECT_EQ(admitted, 25);
+  EXPECT_EQ(limiter.suppressed(), dynamic::object("event", 75));
+}
+
+TEST(SonarSendLimiterTests, testOverrideTakesPrecedence) {
+  SonarSendLimiter limiter;
+  limiter.setLimit("event", limit(0, 0));
+  EXPECT_FALSE(limiter.admit("event"));
+
+  limiter.overrideLimit("event", limit(0, 1));
+  EXPECT_TRUE(limiter.admit("event"));
+
+  limiter.overrideLimit("event", folly::none);
+  EXPECT_FALSE(limiter.admit("event"));
+}
+
+TEST(SonarSendLimiterTests, testBackgroundLimitAppliesToEveryMethod) {
+  SonarSendLimiter limiter;
+  limiter.setLimit("limited", limit(0, 0.5));
+  limiter.setBackgroundLimit(limit(0, 0.5));
+  int limited = 0;
+  int unlimited = 0;
+  for (int i = 0; i < 100; i++) {
+    limited += limiter.admit("limited") ? 1 : 0;
+    unlimited += limiter.admit("unlimited") ? 1 : 0;
+  }
+  // The background limit samples what the method's own limit kept.
+  EXPECT_EQ(limited, 25);
+  EXPECT_EQ(unlimited, 50);
+
+  limiter.setBackgroundLimit(folly::none);
+  EXPECT_TRUE(limiter.admit("unlimited"));
+  EXPECT_TRUE(limiter.admit("unlimited"));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
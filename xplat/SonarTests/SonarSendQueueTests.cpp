@@ -0,0 +1,192 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarSendQueue.h>
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+static SonarSendQueue::Entry entry(const std::string& plugin, int value) {
+  return {plugin, dynamic::object("value", value), nullptr};
+}
+
+TEST(SonarSendQueueTests, testSchedulesDrainOnce) {
+  SonarSendQueue queue(10, OverflowPolicy::dropNewest);
+  EXPECT_TRUE(queue.push(entry("Test", 1), false));
+  EXPECT_FALSE(queue.push(entry("Test", 2), false));
+
+  auto drained = queue.drain();
+  EXPECT_EQ(drained.entries.size(), 2);
+  EXPECT_TRUE(drained.dropped.empty());
+  EXPECT_TRUE(queue.push(entry("Test", 3), false));
+}
+
+TEST(SonarSendQueueTests, testDropNewest) {
+  SonarSendQueue queue(2, OverflowPolicy::dropNewest);
+  queue.push(entry("Test", 1), false);
+  queue.push(entry("Test", 2), false);
+  queue.push(entry("Test", 3), false);
+  queue.push(entry("Other", 4), false);
+
+  auto drained = queue.drain();
+  ASSERT_EQ(drained.entries.size(), 3);
+  // Plugins take turns.
+  EXPECT_EQ(drained.entries[0].message["value"], 1);
+  EXPECT_EQ(drained.entries[1].message["value"], 4);
+  EXPECT_EQ(drained.entries[2].message["value"], 2);
+  EXPECT_EQ(drained.dropped["Test"], 1);
+  EXPECT_EQ(drained.dropped.count("Other"), 0);
+}
+
+TEST(SonarSendQueueTests, testDropOldest) {
+  SonarSendQueue queue(2, OverflowPolicy::dropOldest);
+  queue.push(entry("Test", 1), false);
+  queue.push(entry("Other", 2), false);
+  queue.push(entry("Test", 3), false);
+  queue.push(entry("Test", 4), false);
+
+  auto drained = queue.drain();
+  ASSERT_EQ(drained.entries.size(), 3);
+  EXPECT_EQ(drained.entries[0].message["value"], 3);
+  EXPECT_EQ(drained.entries[1].message["value"], 2);
+  EXPECT_EQ(drained.entries[2].message["value"], 4);
+  EXPECT_EQ(drained.dropped["Test"], 1);
+}
+
+TEST(SonarSendQueueTests, testUnboundedQueueNeverDrops) {
+  // As used for responses.
+  SonarSendQueue queue(SIZE_MAX, OverflowPolicy::dropNewest);
+  for (int i = 0; i < 5000; i++) {
+    queue.push(entry("", i), false);
+  }
+
+  auto drained = queue.drain();
+  ASSERT_EQ(drained.entries.size(), 5000);
+  EXPECT_TRUE(drained.dropped.empty());
+  EXPECT_EQ(drained.entries.back().message["value"], 4999);
+}
+
+TEST(SonarSendQueueTests, testBlockFallsBackToDropWhenNotAllowed) {
+  SonarSendQueue queue(1, OverflowPolicy::block);
+  queue.push(entry("Test", 1), false);
+  queue.push(entry("Test", 2), false);
+
+  auto drained = queue.drain();
+  ASSERT_EQ(drained.entries.size(), 1);
+  EXPECT_EQ(drained.dropped["Test"], 1);
+}
+
+TEST(SonarSendQueueTests, testDiscardCountsAsDropped) {
+  SonarSendQueue queue(10, OverflowPolicy::dropNewest);
+  queue.push(entry("Test", 1), false);
+  queue.push({"Test", nullptr, folly::IOBuf::copyBuffer("12345")}, false);
+
+  EXPECT_EQ(queue.discard(), 5);
+  auto drained = queue.drain();
+  EXPECT_TRUE(drained.entries.empty());
+  EXPECT_EQ(drained.dropped["Test"], 2);
+}
+
+TEST(SonarSendQueueTests, testKeepsEachProducersOrder) {
+  const int producers = 4;
+  const int pushes = 1000;
+  SonarSendQueue queue(producers * pushes, OverflowPolicy::dropNewest);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; i++) {
+    threads.emplace_back([&queue, i]() {
+      for (int value = 0; value < pushes; value++) {
+        queue.push(entry(std::to_string(i), value), true);
+      }
+    });
+  }
+  std::vector<int> next(producers, 0);
+  int drainedCount = 0;
+  const auto check = [&](const SonarSendQueue::Drained& drained) {
+    EXPECT_TRUE(drained.dropped.empty());
+    for (const auto& drainedEntry : drained.entries) {
+      auto& expected = next[std::stoi(drainedEntry.plugin)];
+      EXPECT_EQ(drainedEntry.message["value"], expected++);
+      drainedCount++;
+    }
+  };
+  while (drainedCount < producers * pushes / 2) {
+    check(queue.drain());
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  check(queue.drain());
+  EXPECT_EQ(drainedCount, producers * pushes);
+}
+
+TEST(SonarSendQueueTests, testQuotaAppliesToLockFreePushes) {
+  SonarSendQueue queue(2, OverflowPolicy::dropNewest);
+  EXPECT_TRUE(queue.push(entry("Test", 1), false));
+  EXPECT_FALSE(queue.push(entry("Test", 2), false));
+  EXPECT_FALSE(queue.push(entry("Test", 3), false));
+
+  auto drained = queue.drain();
+  ASSERT_EQ(drained.entries.size(), 2);
+  EXPECT_EQ(drained.entries[1].message["value"], 2);
+  EXPECT_EQ(drained.dropped["Test"], 1);
+  // Drained entries no longer count.
+  EXPECT_TRUE(queue.push(entry("Test", 4), false));
+  EXPECT_FALSE(queue.push(entry("Test", 5), false));
+  EXPECT_EQ(queue.drain().entries.size(), 2);
+}
+
+TEST(SonarSendQueueTests, testBurstDoesNotHoldBackOtherPlugins) {
+  SonarSendQueue queue(1000, OverflowPolicy::dropNewest);
+  for (int value = 0; value < 500; value++) {
+    queue.push(entry("Burst", value), false);
+  }
+  queue.push(entry("Quiet", 0), false);
+
+  auto drained = queue.drain(10);
+  ASSERT_EQ(drained.entries.size(), 10);
+  EXPECT_TRUE(drained.more);
+  EXPECT_EQ(drained.entries[0].plugin, "Burst");
+  EXPECT_EQ(drained.entries[1].plugin, "Quiet");
+  for (size_t i = 2; i < drained.entries.size(); i++) {
+    EXPECT_EQ(drained.entries[i].message["value"], i - 1);
+  }
+  // Drains left to the caller don't get scheduled by pushes.
+  EXPECT_FALSE(queue.push(entry("Quiet", 1), false));
+  drained = queue.drain(2);
+  EXPECT_EQ(drained.entries[0].message["value"], 9);
+  EXPECT_EQ(drained.entries[1].plugin, "Quiet");
+  EXPECT_EQ(queue.drain().entries.size(), 490);
+  EXPECT_TRUE(queue.push(entry("Quiet", 2), false));
+}
+
+TEST(SonarSendQueueTests, testWeightedTurns) {
+  SonarSendQueue queue(
+      100, OverflowPolicy::dropNewest, nullptr, {{"Heavy", 3}});
+  for (int value = 0; value < 6; value++) {
+    queue.push(entry("Heavy", value), false);
+    queue.push(entry("Light", value), false);
+  }
+
+  const auto drained = queue.drain(8);
+  std::string order;
+  for (const auto& drainedEntry : drained.entries) {
+    order += drainedEntry.plugin[0];
+  }
+  EXPECT_EQ(order, "HHHLHHHL");
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarSerialize.h>
+#include <SonarTestLib/SonarConnectionMock.h>
+#include <SonarTestLib/SonarResponderMock.h>
+
+#include <folly/json.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+struct Header {
+  std::string key;
+  std::string value;
+  SONAR_FIELDS(SONAR_FIELD(Header, key), SONAR_FIELD(Header, value))
+};
+
+struct Request {
+  std::string url;
+  int64_t startTime;
+  double ratio;
+  bool cached;
+  std::vector<Header> headers;
+  std::map<std::string, int> counts;
+  folly::Optional<std::string> body;
+  dynamic extra;
+  SONAR_FIELDS(
+      SONAR_FIELD(Request, url),
+      SONAR_FIELD(Request, startTime),
+      SONAR_FIELD(Request, ratio),
+      SONAR_FIELD(Request, cached),
+      SONAR_FIELD(Request, headers),
+      SONAR_FIELD(Request, counts),
+      SONAR_FIELD(Request, body),
+      SONAR_FIELD(Request, extra))
+};
+
+static Request request() {
+  Request request;
+  request.url = "https://example.com/?q=\"quoted\"";
+  request.startTime = 1530000000000;
+  request.ratio = 0.25;
+  request.cached = true;
+  request.headers = {{"Accept", "*/*"}, {"Host", "example.com"}};
+  request.counts = {{"retries", 2}};
+  request.extra = dynamic::object("nested", dynamic::array(1, 2));
+  return request;
+}
+
+TEST(SonarSerializeTests, testWritesFieldsInOrder) {
+  const auto json = serializeJson(request());
+  EXPECT_EQ(json.find("{\"url\":"), 0);
+  EXPECT_EQ(
+      folly::parseJson(json),
+      dynamic::object("url", "https://example.com/?q=\"quoted\"")(
+          "startTime", 1530000000000)("ratio", 0.25)("cached", true)(
+          "headers",
+          dynamic::array(
+              dynamic::object("key", "Accept")("value", "*/*"),
+              dynamic::object("key", "Host")("value", "example.com")))(
+          "counts", dynamic::object("retries", 2))("body", nullptr)(
+          "extra", dynamic::object("nested", dynamic::array(1, 2))));
+}
+
+TEST(SonarSerializeTests, testRejectsNonFiniteNumbers) {
+  auto invalid = request();
+  invalid.ratio = std::nan("");
+  EXPECT_THROW(serializeJson(invalid), std::invalid_argument);
+}
+
+TEST(SonarSerializeTests, testSendWritesStructs) {
+  SonarConnectionMock connection;
+  connection.send("newRequest", request());
+  ASSERT_EQ(connection.rawSent_.size(), 1);
+  EXPECT_EQ(connection.rawSent_[0].first, "newRequest");
+  EXPECT_EQ(connection.rawSent_[0].second, serializeJson(request()));
+
+  // Dynamics still take the regular path.
+  connection.send("newRequest", dynamic::object("url", "a"));
+  EXPECT_EQ(connection.sent_["newRequest"], dynamic::object("url", "a"));
+}
+
+TEST(SonarSerializeTests, testReadsWhatItWrites) {
+  const auto read = deserializeJson<Request>(serializeJson(request()));
+  EXPECT_EQ(serializeJson(read), serializeJson(request()));
+  EXPECT_EQ(read.headers[1].value, "example.com");
+  EXPECT_FALSE(read.body);
+}
+
+TEST(SonarSerializeTests, testSkipsUnknownAndMissingOptionalFields) {
+  const auto header = deserializeJson<Header>(
+      R"({"ignored": {"nested": ["}", 1]}, "key": "Host", "value": "a"})");
+  EXPECT_EQ(header.key, "Host");
+  EXPECT_EQ(header.value, "a");
+
+  auto json = folly::parseJson(serializeJson(request()));
+  json.erase("body");
+  json.erase("extra");
+  const auto read = deserializeJson<Request>(folly::toJson(json));
+  EXPECT_FALSE(read.body);
+  EXPECT_TRUE(read.extra.isNull());
+}
+
+TEST(SonarSerializeTests, testRejectsParamsThatDontFit) {
+  EXPECT_THROW(
+      deserializeJson<Header>(R"({"key": "Host"})"), std::invalid_argument);
+  EXPECT_ANY_THROW(
+      deserializeJson<Header>(R"({"key": "Host", "value": 1})"));
+}
+
+TEST(SonarSerializeTests, testReceiveReadsStructs) {
+  SonarConnectionMock connection;
+  std::vector<Header> received;
+  connection.receive<Header>(
+      "setHeader",
+      [&](const Header& header, std::unique_ptr<SonarResponder> responder) {
+        received.push_back(header);
+        responder->success(dynamic::object());
+      });
+  ASSERT_EQ(connection.rawReceivers_.count("setHeader"), 1);
+
+  std::vector<dynamic> successes;
+  connection.rawReceivers_["setHeader"](
+      R"({"key": "Accept", "value": "*/*"})",
+      std::make_unique<SonarResponderMock>(&successes));
+  ASSERT_EQ(received.size(), 1);
+  EXPECT_EQ(received[0].key, "Accept");
+  EXPECT_EQ(received[0].value, "*/*");
+  EXPECT_EQ(successes.size(), 1);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarClient.h>
+#include <Sonar/SonarSessionRecorder.h>
+#include <SonarTestLib/SonarPluginMock.h>
+#include <SonarTestLib/SonarSessionReplay.h>
+
+#include <folly/json.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+using Direction = SonarSessionRecorder::Direction;
+
+static const std::string kRecording = "SonarSessionReplayTestsRecording";
+
+TEST(SonarSessionReplayTests, testLoadsRecordedFrames) {
+  {
+    SonarSessionRecorder recorder(kRecording);
+    recorder.record(Direction::inbound, false, "{\"method\":\"getPlugins\"}");
+    recorder.record(Direction::outbound, false, "{\"success\":{}}");
+    recorder.record(Direction::inbound, true, "{\"method\":\"stream\"}");
+  }
+
+  const auto frames = SonarSessionRecorder::load(kRecording);
+  ASSERT_EQ(frames.size(), 3);
+  EXPECT_EQ(frames[0].direction, Direction::inbound);
+  EXPECT_FALSE(frames[0].stream);
+  EXPECT_EQ(frames[0].data, "{\"method\":\"getPlugins\"}");
+  EXPECT_EQ(frames[1].direction, Direction::outbound);
+  EXPECT_TRUE(frames[2].stream);
+  EXPECT_LE(frames[0].time, frames[2].time);
+}
+
+TEST(SonarSessionReplayTests, testReplaysInboundFrames) {
+  auto socket = new SonarWebSocketMock;
+  SonarClient client(
+      std::unique_ptr<SonarWebSocketMock>{socket},
+      std::make_shared<SonarState>());
+  int calls = 0;
+  const auto connectionCallback = [&](std::shared_ptr<SonarConnection> conn) {
+    conn->receive(
+        "ping",
+        [&](const dynamic& params, std::unique_ptr<SonarResponder> responder) {
+          calls++;
+          responder->success(dynamic::object("pong", params["value"]));
+        });
+  };
+  client.addPlugin(
+      std::make_shared<SonarPluginMock>("Test", connectionCallback));
+  client.start();
+
+  using std::chrono::microseconds;
+  SonarSessionReplay replay({
+      {microseconds(0),
+       Direction::inbound,
+       false,
+       "{\"method\":\"init\",\"params\":{\"plugin\":\"Test\"}}"},
+      {microseconds(10),
+       Direction::inbound,
+       false,
+       "{\"id\":1,\"method\":\"execute\",\"params\":"
+       "{\"api\":\"Test\",\"method\":\"ping\",\"params\":{\"value\":1}}}"},
+      {microseconds(20), Direction::outbound, false, "{}"},
+  });
+  const auto result = replay.replay(*socket, 0);
+
+  EXPECT_EQ(result.framesReplayed, 2);
+  EXPECT_EQ(result.recordedMessagesSent, 1);
+  EXPECT_EQ(result.recordedDuration, microseconds(10));
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(
+      socket->messages.back(),
+      dynamic::object("id", 1)("success", dynamic::object("pong", 1)));
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarSimd.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <initializer_list>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+// Every level this machine runs, scalar included.
+static std::vector<const SonarSimdKernels*> supportedKernels() {
+  std::vector<const SonarSimdKernels*> kernels;
+  for (const auto level : {SonarSimdLevel::scalar,
+                           SonarSimdLevel::ssse3,
+                           SonarSimdLevel::avx2,
+                           SonarSimdLevel::neon}) {
+    if (const auto k = sonarSimdKernels(level)) {
+      kernels.push_back(k);
+    }
+  }
+  return kernels;
+}
+
+// Lengths around every block size the kernels use, then some longer ones.
+static std::vector<size_t> lengths() {
+  std::vector<size_t> result;
+  for (size_t n = 0; n <= 100; n++) {
+    result.push_back(n);
+  }
+  for (const size_t n : {127, 128, 129, 255, 256, 1000, 4099}) {
+    result.push_back(n);
+  }
+  return result;
+}
+
+static std::vector<uint8_t> randomBytes(std::mt19937& random, size_t size) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<uint8_t> bytes(size);
+  for (auto& b : bytes) {
+    b = static_cast<uint8_t>(byte(random));
+  }
+  return bytes;
+}
+
+TEST(SonarSimdTests, testPicksASupportedLevel) {
+  const auto& best = sonarSimdKernels();
+  EXPECT_EQ(sonarSimdKernels(best.level), &best);
+  EXPECT_NE(sonarSimdKernels(SonarSimdLevel::scalar), nullptr);
+#if defined(__aarch64__)
+  EXPECT_EQ(best.level, SonarSimdLevel::neon);
+#endif
+  const auto& cpu = sonarCpuFeatures();
+  if (!cpu.neon) {
+    EXPECT_EQ(sonarSimdKernels(SonarSimdLevel::neon), nullptr);
+  }
+  if (!cpu.avx2) {
+    EXPECT_EQ(sonarSimdKernels(SonarSimdLevel::avx2), nullptr);
+  }
+}
+
+TEST(SonarSimdTests, testJsonPlainPrefixMatchesScalar) {
+  std::mt19937 random(42);
+  const auto scalar = sonarSimdKernels(SonarSimdLevel::scalar);
+  for (const auto kernels : supportedKernels()) {
+    SCOPED_TRACE(sonarSimdLevelName(kernels->level));
+    for (const auto length : lengths()) {
+      // Plain text with a single special byte at each position in turn, at
+      // every offset from an aligned start.
+      for (const char special : {'"', '\\', '\n', '\0', '\x80', '\xff'}) {
+        std::string text(length + 16, 'a');
+        for (size_t offset = 0; offset < 16; offset += 5) {
+          for (size_t at = 0; at <= length; at += 7) {
+            std::string copy = text;
+            if (at < length) {
+              copy[offset + at] = special;
+            }
+            const char* data = copy.data() + offset;
+            EXPECT_EQ(
+                kernels->jsonPlainPrefix(data, length), std::min(at, length));
+            EXPECT_EQ(
+                kernels->jsonPlainPrefix(data, length),
+                scalar->jsonPlainPrefix(data, length));
+          }
+        }
+      }
+      // Mostly plain random text.
+      std::uniform_int_distribution<int> ascii(0x20, 0x7e);
+      std::string text(length, 'a');
+      for (auto& c : text) {
+        c = static_cast<char>(ascii(random));
+      }
+      EXPECT_EQ(
+          kernels->jsonPlainPrefix(text.data(), length),
+          scalar->jsonPlainPrefix(text.data(), length));
+    }
+  }
+}
+
+TEST(SonarSimdTests, testBase64GroupsMatchScalar) {
+  std::mt19937 random(7);
+  const auto scalar = sonarSimdKernels(SonarSimdLevel::scalar);
+  for (const auto kernels : supportedKernels()) {
+    SCOPED_TRACE(sonarSimdLevelName(kernels->level));
+    for (const auto length : lengths()) {
+      const auto bytes = randomBytes(random, length);
+      std::string expected(length / 3 * 4, '?');
+      std::string encoded(length / 3 * 4, '?');
+      EXPECT_EQ(
+          scalar->base64Groups(bytes.data(), length, &expected[0]),
+          length / 3 * 3);
+      EXPECT_EQ(
+          kernels->base64Groups(bytes.data(), length, &encoded[0]),
+          length / 3 * 3);
+      EXPECT_EQ(encoded, expected) << length;
+    }
+  }
+
+  // Every 6 bit index, in place of the random bytes' uneven spread.
+  const uint8_t allIndexes[] = {0x00, 0x10, 0x83, 0x10, 0x51, 0x87, 0x20,
+                                0x92, 0x8b, 0x30, 0xd3, 0x8f, 0x41, 0x14,
+                                0x93, 0x51, 0x55, 0x97, 0x61, 0x96, 0x9b,
+                                0x71, 0xd7, 0x9f, 0x82, 0x18, 0xa3, 0x92,
+                                0x59, 0xa7, 0xa2, 0x9a, 0xab, 0xb2, 0xdb,
+                                0xaf, 0xc3, 0x1c, 0xb3, 0xd3, 0x5d, 0xb7,
+                                0xe3, 0x9e, 0xbb, 0xf3, 0xdf, 0xbf};
+  for (const auto kernels : supportedKernels()) {
+    std::string encoded(64, '?');
+    kernels->base64Groups(allIndexes, sizeof(allIndexes), &encoded[0]);
+    EXPECT_EQ(
+        encoded,
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/")
+        << sonarSimdLevelName(kernels->level);
+  }
+}
+
+TEST(SonarSimdTests, testMaskMatchesScalar) {
+  std::mt19937 random(3);
+  const auto scalar = sonarSimdKernels(SonarSimdLevel::scalar);
+  const uint8_t key[4] = {0x12, 0x34, 0x56, 0x78};
+  for (const auto kernels : supportedKernels()) {
+    SCOPED_TRACE(sonarSimdLevelName(kernels->level));
+    for (const auto length : lengths()) {
+      const auto bytes = randomBytes(random, length + 3);
+      for (size_t offset = 0; offset < 4; offset += 3) {
+        const uint8_t* src = bytes.data() + offset;
+        std::vector<uint8_t> expected(length);
+        for (size_t i = 0; i < length; i++) {
+          expected[i] = src[i] ^ key[i % 4];
+        }
+        std::vector<uint8_t> masked(length);
+        std::vector<uint8_t> scalarMasked(length);
+        kernels->mask(masked.data(), src, length, key);
+        scalar->mask(scalarMasked.data(), src, length, key);
+        EXPECT_EQ(masked, expected) << length;
+        EXPECT_EQ(scalarMasked, expected) << length;
+
+        // In place, as the websocket unmasks what it receives.
+        std::vector<uint8_t> inPlace(src, src + length);
+        kernels->mask(inPlace.data(), inPlace.data(), length, key);
+        EXPECT_EQ(inPlace, expected) << length;
+      }
+    }
+  }
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
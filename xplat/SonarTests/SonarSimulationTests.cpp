@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarClient.h>
+#include <SonarTestLib/SonarPluginMock.h>
+#include <SonarTestLib/SonarSimulatedWebSocket.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+static std::unique_ptr<folly::IOBuf> event(int n) {
+  // 7 bytes.
+  return folly::IOBuf::copyBuffer(folly::toJson(dynamic::object("n", n)));
+}
+
+TEST(SonarSimulationTests, testDeliversThroughBandwidthAndLatency) {
+  SonarVirtualClock clock;
+  SonarLinkConditions conditions;
+  conditions.latency = milliseconds(50);
+  conditions.bytesPerSecond = 100;
+  SonarSimulatedWebSocket socket(clock, conditions);
+
+  socket.start();
+  clock.advance(milliseconds(100));
+  EXPECT_TRUE(socket.isOpen());
+
+  for (int i = 0; i < 3; i++) {
+    socket.sendSerialized(event(i));
+  }
+  clock.advance(milliseconds(150));
+  EXPECT_EQ(socket.messages.size(), 1);
+  clock.advance(milliseconds(110));
+  ASSERT_EQ(socket.messages.size(), 3);
+  EXPECT_EQ(socket.messages[2], dynamic::object("n", 2));
+  EXPECT_EQ(socket.stats().messagesDelivered, 3);
+  EXPECT_EQ(socket.stats().maxDeliveryTime, milliseconds(260));
+}
+
+TEST(SonarSimulationTests, testReconnectsWithBackoff) {
+  SonarVirtualClock clock;
+  auto socket = new SonarSimulatedWebSocket(
+      clock,
+      SonarLinkConditions(),
+      SonarBackoff(seconds(2), seconds(60), []() { return 1.0; }));
+  SonarClient client(
+      std::unique_ptr<SonarSimulatedWebSocket>{socket},
+      std::make_shared<SonarState>());
+
+  bool pluginConnected = false;
+  auto plugin = std::make_shared<SonarPluginMock>(
+      "Test",
+      [&](std::shared_ptr<SonarConnection>) { pluginConnected = true; },
+      [&]() { pluginConnected = false; });
+  client.addPlugin(plugin);
+
+  client.start();
+  socket->receive(dynamic::object("method", "init")(
+      "params", dynamic::object("plugin", "Test")));
+  clock.advance(seconds(0));
+  EXPECT_TRUE(pluginConnected);
+
+  socket->disconnectAfter(seconds(1), seconds(10));
+  clock.advance(seconds(1));
+  EXPECT_FALSE(pluginConnected);
+
+  // Retried after 2s and 4s while the link is down, then 8s later.
+  clock.advance(seconds(13));
+  EXPECT_FALSE(socket->isOpen());
+  clock.advance(seconds(1));
+  EXPECT_TRUE(socket->isOpen());
+  EXPECT_EQ(socket->stats().connects, 2);
+  EXPECT_EQ(socket->stats().failedConnects, 2);
+  EXPECT_EQ(socket->stats().disconnectedTime, seconds(14));
+}
+
+TEST(SonarSimulationTests, testDropsPastQueueLimit) {
+  SonarVirtualClock clock;
+  SonarLinkConditions conditions;
+  conditions.bytesPerSecond = 100;
+  conditions.maxQueuedBytes = 20;
+  SonarSimulatedWebSocket socket(clock, conditions);
+  socket.start();
+  clock.advance(seconds(0));
+
+  for (int i = 0; i < 5; i++) {
+    socket.sendSerialized(event(i), "Test");
+  }
+  EXPECT_EQ(socket.droppedMessages()["Test"], 3);
+
+  clock.advance(seconds(1));
+  EXPECT_EQ(socket.messages.size(), 2);
+  socket.sendSerialized(event(5), "Test");
+  clock.runUntilIdle();
+  EXPECT_EQ(socket.messages.size(), 3);
+}
+
+TEST(SonarSimulationTests, testLosesMessagesInFlightOnDisconnect) {
+  SonarVirtualClock clock;
+  SonarLinkConditions conditions;
+  conditions.latency = milliseconds(100);
+  SonarSimulatedWebSocket socket(clock, conditions);
+  socket.start();
+  clock.advance(milliseconds(200));
+
+  socket.sendSerialized(event(0));
+  socket.disconnectAfter(milliseconds(50), seconds(1));
+  clock.advance(milliseconds(100));
+  EXPECT_TRUE(socket.messages.empty());
+  EXPECT_EQ(socket.stats().messagesLost, 1);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/CompressionUtils.h>
+#include <Sonar/SonarSnapshotWriter.h>
+#include <SonarTestLib/SonarConnectionMock.h>
+
+#include <folly/String.h>
+#include <folly/json.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using folly::dynamic;
+
+class SnapshotCollector : public SonarStreamResponder {
+ public:
+  void next(const dynamic& chunk) override {}
+
+  void nextBytes(std::unique_ptr<folly::IOBuf> chunk) override {
+    chunkSizes.push_back(chunk->computeChainDataLength());
+    data.append(chunk->moveToFbString().toStdString());
+  }
+
+  void complete() override {
+    completed = true;
+  }
+
+  void error(const dynamic& response) override {
+    errors.push_back(response);
+  }
+
+  // The parts written, read back from the compressed stream.
+  std::vector<dynamic> parts() const {
+    const auto inflated =
+        inflateFrame(*folly::IOBuf::copyBuffer(data))->moveToFbString();
+    std::vector<folly::StringPiece> lines;
+    folly::split('\n', inflated, lines, true);
+    std::vector<dynamic> result;
+    for (const auto& line : lines) {
+      result.push_back(folly::parseJson(line));
+    }
+    return result;
+  }
+
+  std::string data;
+  std::vector<size_t> chunkSizes;
+  std::vector<dynamic> errors;
+  bool completed = false;
+};
+
+TEST(SonarSnapshotWriterTests, testStreamsCompressedParts) {
+  auto collector = std::make_shared<SnapshotCollector>();
+  {
+    SonarSnapshotWriter writer(collector, 256);
+    for (int i = 0; i < 1000; i++) {
+      writer.write(dynamic::object("id", i)("name", "View" + std::to_string(i)));
+    }
+    writer.finish();
+    EXPECT_LT(writer.bytesOut(), writer.bytesIn());
+    EXPECT_EQ(writer.bytesOut(), collector->data.size());
+  }
+
+  EXPECT_TRUE(collector->completed);
+  EXPECT_TRUE(collector->errors.empty());
+  EXPECT_GT(collector->chunkSizes.size(), 1);
+  for (const auto size : collector->chunkSizes) {
+    EXPECT_LE(size, 256);
+  }
+  const auto parts = collector->parts();
+  ASSERT_EQ(parts.size(), 1000);
+  EXPECT_EQ(parts[999]["name"], "View999");
+}
+
+TEST(SonarSnapshotWriterTests, testAbandonedSnapshotIsAnError) {
+  auto collector = std::make_shared<SnapshotCollector>();
+  {
+    SonarSnapshotWriter writer(collector);
+    writer.write(dynamic::object("id", 1));
+  }
+  EXPECT_FALSE(collector->completed);
+  EXPECT_EQ(collector->errors.size(), 1);
+}
+
+TEST(SonarSnapshotWriterTests, testReceiveSnapshot) {
+  SonarConnectionMock connection;
+  connection.receiveSnapshot([](SonarSnapshotWriter& writer) {
+    writer.write(dynamic::object("key", "a"));
+    writer.write(dynamic::object("key", "b"));
+  });
+  auto collector = std::make_shared<SnapshotCollector>();
+  connection.streamReceivers_["snapshot"](
+      dynamic::object("chunkSize", 16), collector);
+  EXPECT_TRUE(collector->completed);
+  const auto parts = collector->parts();
+  ASSERT_EQ(parts.size(), 2);
+  EXPECT_EQ(parts[1]["key"], "b");
+
+  connection.receiveSnapshot(
+      [](SonarSnapshotWriter&) { throw std::runtime_error("Not ready"); });
+  auto failed = std::make_shared<SnapshotCollector>();
+  connection.streamReceivers_["snapshot"](nullptr, failed);
+  EXPECT_FALSE(failed->completed);
+  ASSERT_EQ(failed->errors.size(), 1);
+  EXPECT_EQ(failed->errors[0]["message"], "Not ready");
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
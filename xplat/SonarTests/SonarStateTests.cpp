@@ -0,0 +1,50 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarState.h>
+#include <Sonar/SonarStep.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+TEST(SonarStateTests, testLogNamesSteps) {
+  SonarState state;
+  state.start(SonarStepId::connectToDesktop)->complete();
+  state.start(SonarStepId::addPlugin, "Inspector")->complete();
+  state.start("Custom step")->fail("broken");
+
+  const auto entries = state.getLogEntries();
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(
+      entries[0].step, sonarStepInfo(SonarStepId::connectToDesktop).name);
+  EXPECT_EQ(
+      entries[1].step,
+      std::string(sonarStepInfo(SonarStepId::addPlugin).name) + "Inspector");
+  EXPECT_EQ(entries[2].step, "Custom step");
+  EXPECT_EQ(entries[2].state, State::failed);
+  EXPECT_EQ(entries[2].message, "broken");
+}
+
+TEST(SonarStateTests, testLogKeepsTheLastEntries) {
+  SonarState state;
+  for (int i = 0; i < 300; i++) {
+    state.start(std::to_string(i))->complete();
+  }
+
+  const auto entries = state.getLogEntries();
+  ASSERT_EQ(entries.size(), 256);
+  EXPECT_EQ(entries.front().step, "44");
+  EXPECT_EQ(entries.back().step, "299");
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarUrlFilter.h>
+
+#include <folly/json.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using Patterns = SonarUrlFilter::Patterns;
+
+static Patterns includeUrls(std::vector<std::string> urls) {
+  Patterns patterns;
+  patterns.includeUrls = std::move(urls);
+  return patterns;
+}
+
+TEST(SonarUrlFilterTests, testEmptyMatchesEverything) {
+  SonarUrlFilter filter(Patterns{});
+  EXPECT_TRUE(filter.empty());
+  EXPECT_TRUE(filter.matches("https://example.com/"));
+  EXPECT_TRUE(filter.matches(""));
+}
+
+TEST(SonarUrlFilterTests, testGlobs) {
+  SonarUrlFilter filter(includeUrls({"https://*.example.com/api/*",
+                                     "*/graphql?q=*",
+                                     "http://exact.com/",
+                                     "*.png"}));
+  EXPECT_FALSE(filter.empty());
+  EXPECT_TRUE(filter.matches("https://www.example.com/api/users"));
+  EXPECT_TRUE(filter.matches("https://a.b.example.com/api/"));
+  EXPECT_FALSE(filter.matches("https://example.com/api/users"));
+  EXPECT_FALSE(filter.matches("http://www.example.com/api/users"));
+  EXPECT_TRUE(filter.matches("https://x.com/graphql?q=1"));
+  EXPECT_TRUE(filter.matches("https://x.com/graphql!q=1"));
+  EXPECT_TRUE(filter.matches("http://exact.com/"));
+  EXPECT_FALSE(filter.matches("http://exact.com/a"));
+  EXPECT_TRUE(filter.matches("https://cdn.com/a.png"));
+  EXPECT_FALSE(filter.matches("https://cdn.com/a.png?size=2"));
+}
+
+TEST(SonarUrlFilterTests, testPiecesDontOverlap) {
+  SonarUrlFilter filter(includeUrls({"ab*ba", "a*a*a"}));
+  EXPECT_TRUE(filter.matches("abba"));
+  EXPECT_FALSE(filter.matches("aba"));
+  EXPECT_TRUE(filter.matches("aaa"));
+  EXPECT_FALSE(filter.matches("aa"));
+  EXPECT_TRUE(filter.matches("a-a-a"));
+}
+
+TEST(SonarUrlFilterTests, testExcludeWinsOverInclude) {
+  Patterns patterns;
+  patterns.includeHosts = {"*.example.com"};
+  patterns.excludeUrls = {"*/logging/*"};
+  patterns.excludeHosts = {"ads.example.com"};
+  SonarUrlFilter filter(patterns);
+  EXPECT_TRUE(filter.matches("https://www.example.com/feed"));
+  EXPECT_FALSE(filter.matches("https://www.example.com/logging/event"));
+  EXPECT_FALSE(filter.matches("https://ADS.example.com/banner"));
+  EXPECT_FALSE(filter.matches("https://example.org/feed"));
+}
+
+TEST(SonarUrlFilterTests, testHostsIgnoreCase) {
+  Patterns patterns;
+  patterns.includeHosts = {"API.Example.com"};
+  SonarUrlFilter filter(patterns);
+  EXPECT_TRUE(filter.matches("https://api.example.COM:8443/path"));
+  EXPECT_TRUE(filter.matches("https://user:pw@api.example.com"));
+  EXPECT_FALSE(filter.matches("https://api.example.com.evil.org/"));
+  EXPECT_FALSE(filter.matches("api.example.com/path"));
+}
+
+TEST(SonarUrlFilterTests, testHost) {
+  EXPECT_EQ(SonarUrlFilter::host("https://example.com"), "example.com");
+  EXPECT_EQ(SonarUrlFilter::host("https://example.com:80/a"), "example.com");
+  EXPECT_EQ(SonarUrlFilter::host("http://a@b@example.com?q"), "example.com");
+  EXPECT_EQ(SonarUrlFilter::host("http://[::1]:8080/"), "[::1]");
+  EXPECT_EQ(SonarUrlFilter::host("https://example.com#x"), "example.com");
+  EXPECT_EQ(SonarUrlFilter::host("file:///tmp/a"), "");
+  EXPECT_EQ(SonarUrlFilter::host("example.com"), "");
+}
+
+TEST(SonarUrlFilterTests, testPatternsFromDynamic) {
+  const auto patterns = SonarUrlFilter::patternsFromDynamic(folly::parseJson(
+      R"({"includeUrls": ["a*"], "excludeHosts": ["b", "c"], "other": 1})"));
+  EXPECT_EQ(patterns.includeUrls, std::vector<std::string>{"a*"});
+  EXPECT_TRUE(patterns.excludeUrls.empty());
+  EXPECT_TRUE(patterns.includeHosts.empty());
+  EXPECT_EQ(patterns.excludeHosts, (std::vector<std::string>{"b", "c"}));
+
+  EXPECT_THROW(
+      SonarUrlFilter::patternsFromDynamic(
+          folly::parseJson(R"({"includeUrls": "a"})")),
+      std::invalid_argument);
+  EXPECT_THROW(
+      SonarUrlFilter::patternsFromDynamic(
+          folly::parseJson(R"({"includeUrls": [1]})")),
+      std::invalid_argument);
+  EXPECT_THROW(
+      SonarUrlFilter::patternsFromDynamic(folly::parseJson("[]")),
+      std::invalid_argument);
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarWarmStart.h>
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+static const std::string kFile = "SonarWarmStartTestsFile";
+
+static void write(const std::string& contents) {
+  std::ofstream file(kFile, std::ios::trunc);
+  file << contents;
+}
+
+TEST(SonarWarmStartTests, testRoundTrip) {
+  std::remove(kFile.c_str());
+  SonarWarmStart warmStart;
+  warmStart.host = "10.0.2.2";
+  warmStart.legacyCertificateRequest = true;
+  warmStart.capabilities =
+      folly::dynamic::object("batching", true)("bser", false);
+  warmStart.session = std::string("\x30\x82\x00\xff", 4);
+  warmStart.certificates = "1:10:20;";
+  ASSERT_TRUE(warmStart.save(kFile));
+
+  EXPECT_EQ(SonarWarmStart::load(kFile), warmStart);
+  std::remove(kFile.c_str());
+}
+
+TEST(SonarWarmStartTests, testMissingFileIsEmpty) {
+  std::remove(kFile.c_str());
+  EXPECT_EQ(SonarWarmStart::load(kFile), SonarWarmStart());
+}
+
+TEST(SonarWarmStartTests, testCorruptFileIsIgnored) {
+  write("{\"version\": 1, \"host\": ");
+  EXPECT_EQ(SonarWarmStart::load(kFile), SonarWarmStart());
+
+  write("{\"version\": 1, \"host\": 42}");
+  EXPECT_EQ(SonarWarmStart::load(kFile), SonarWarmStart());
+  std::remove(kFile.c_str());
+}
+
+TEST(SonarWarmStartTests, testOtherVersionIsIgnored) {
+  write("{\"version\": 2, \"host\": \"localhost\"}");
+  EXPECT_EQ(SonarWarmStart::load(kFile), SonarWarmStart());
+  std::remove(kFile.c_str());
+}
+
+TEST(SonarWarmStartTests, testBadSessionIsDropped) {
+  write(
+      "{\"version\": 1, \"host\": \"localhost\", \"session\": \"xyz\", "
+      "\"capabilities\": \"bser\"}");
+  const auto warmStart = SonarWarmStart::load(kFile);
+  EXPECT_EQ(warmStart.host, "localhost");
+  EXPECT_TRUE(warmStart.session.empty());
+  EXPECT_TRUE(warmStart.capabilities.isNull());
+  std::remove(kFile.c_str());
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *
+ *  This source code is licensed under the MIT license found in the LICENSE
+ *  file in the root directory of this source tree.
+ *
+ */
+
+#include <Sonar/SonarWatchdog.h>
+
+#include <gtest/gtest.h>
+#include <future>
+
+namespace facebook {
+namespace sonar {
+namespace test {
+
+using namespace std::chrono_literals;
+
+static size_t unwindFixedFrames(uintptr_t* frames, size_t max) {
+  frames[0] = 1;
+  frames[1] = 2;
+  return 2;
+}
+
+TEST(SonarWatchdogTests, testReportsBlockedTaskOnce) {
+  std::promise<SonarWatchdog::Report> reported;
+  int reports = 0;
+  SonarWatchdog watchdog(
+      50ms, unwindFixedFrames, [&](const SonarWatchdog::Report& report) {
+        if (reports++ == 0) {
+          reported.set_value(report);
+        }
+      });
+  {
+    SonarWatchdog::Scope watched(&watchdog, "Blocking");
+    ASSERT_EQ(reported.get_future().wait_for(5s), std::future_status::ready);
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(reports, 1);
+  const auto recent = watchdog.reports();
+  ASSERT_EQ(recent.size(), 1);
+  EXPECT_EQ(recent[0]["task"], "Blocking");
+  EXPECT_GE(recent[0]["blockedMs"].asInt(), 50);
+  EXPECT_EQ(recent[0]["stack"].size(), 2);
+}
+
+TEST(SonarWatchdogTests, testIgnoresQuickTasks) {
+  int reports = 0;
+  {
+    SonarWatchdog watchdog(
+        1s, unwindFixedFrames, [&](const SonarWatchdog::Report&) {
+          reports++;
+        });
+    for (int i = 0; i < 100; i++) {
+      SonarWatchdog::Scope watched(&watchdog, "Quick");
+    }
+    EXPECT_EQ(watchdog.reports().size(), 0);
+  }
+  EXPECT_EQ(reports, 0);
+}
+
+TEST(SonarWatchdogTests, testScopeWithoutWatchdog) {
+  SonarWatchdog::Scope watched(nullptr, "Unwatched");
+}
+
+} // namespace test
+} // namespace sonar
+} // namespace facebook